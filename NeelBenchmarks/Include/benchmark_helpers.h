@@ -0,0 +1,11 @@
+#pragma once
+
+#include <memory>
+
+class ThreadPool;
+
+// Pool for num_threads threads including the calling thread, nullptr for a single thread. 0 uses all hardware threads.
+std::unique_ptr<ThreadPool> CreateThreadPool(uint32_t num_threads);
+
+// printf to the console and the debugger output.
+void Report(const char* format, ...);
@@ -0,0 +1,470 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mesh_optimizer.h"
+
+/**
+* CPU side benchmarks of the engine. None of them needs a device, they load scenes (or build
+* synthetic ones) and time the systems that run before and between GPU submissions.
+* Results are returned and also printed by every benchmark.
+*/
+class Benchmarks
+{
+public:
+	enum class ImportMode
+	{
+		ReadBuffers,	// glTF with buffers read into memory.
+		MapBuffers,		// glTF with memory mapped buffers.
+		Cooked			// Cooked .neelscene.
+	};
+
+	struct ImportTiming
+	{
+		uint32_t	NumThreads;
+		ImportMode	Mode;
+		double		Milliseconds;
+
+		// Growth of private (committed) memory while the imported data is alive.
+		size_t		PrivateBytes;
+		// Process wide peak working set after the import.
+		size_t		PeakWorkingSetBytes;
+	};
+
+	struct Base64Result
+	{
+		// "scalar", "sse4.1" or "avx2".
+		const char*	Decoder;
+		// Of base64 text.
+		double		MegabytesPerSecond;
+		// The decoded bytes match the encoded ones.
+		bool		Matches;
+	};
+
+	struct GltfParseResult
+	{
+		double	JsonMegabytes;
+
+		// Time to parse the JSON into a document with the DOM of fx-gltf and with SaxDocumentParser.
+		double	DomMilliseconds;
+		double	SaxMilliseconds;
+
+		// Both parsers produced the same document.
+		bool	DocumentsEqual;
+	};
+
+	struct MeshOptimizationResult
+	{
+		std::string				MeshName;
+		uint32_t				PrimitiveIndex;
+		uint32_t				NumTriangles;
+
+		// Welding drops duplicate vertices, primitives with too many vertices for 16-bit indices are split.
+		uint32_t				NumVerticesBefore;
+		uint32_t				NumVerticesAfter;
+		uint32_t				NumSubMeshesAfter;
+		uint64_t				IndexBytesBefore;
+		uint64_t				IndexBytesAfter;
+
+		MeshOptimizer::Stats	Before;
+		MeshOptimizer::Stats	After;
+
+		// Time spent in MeshOptimizer::OptimizePrimitive.
+		double					Milliseconds;
+	};
+
+	struct MeshletBuildResult
+	{
+		uint32_t	NumSubMeshes;
+		uint64_t	NumTriangles;
+		uint64_t	NumMeshlets;
+
+		// Fill of the meshlets, at most MeshletBuilder::max_vertices_ and max_triangles_.
+		double		AverageVertices;
+		double		AverageTriangles;
+
+		// Time spent in MeshletBuilder::Build, for all submeshes and per million triangles.
+		double		Milliseconds;
+		double		MillisecondsPerMillionTriangles;
+	};
+
+	struct LodSelectionResult
+	{
+		uint32_t				NumFrames;
+		uint32_t				NumInstances;
+
+		// Triangles of all instances at full resolution, the same for every frame.
+		uint64_t				FullDetailTriangles;
+
+		// Triangles submitted with the levels picked by LodSelector, per frame of the camera path.
+		std::vector<uint64_t>	TrianglesPerFrame;
+		double					AverageTriangles;
+		uint64_t				MinTriangles;
+		uint64_t				MaxTriangles;
+
+		// Time spent building the levels on import (MeshSimplifier::BuildLodChain) and selecting them per frame.
+		double					BuildMilliseconds;
+		double					SelectMillisecondsPerFrame;
+	};
+
+	struct GeometryLayoutResult
+	{
+		uint32_t	NumSubMeshes;
+
+		// Every submesh with a vertex and an index buffer of its own, each a default heap and an upload heap resource.
+		size_t		PerSubMeshAllocations;
+		uint64_t	PerSubMeshStagingBytes;
+		uint64_t	PerSubMeshCommittedBytes;
+
+		// Submeshes suballocated from the buffers planned by GeometryLayout.
+		uint32_t	NumVertexBuffers;
+		uint32_t	NumIndexBuffers;
+		size_t		Allocations;
+		uint64_t	StagingBytes;
+		uint64_t	CommittedBytes;
+
+		// Time spent planning the layout and writing the staging memory.
+		double		PlanMilliseconds;
+		double		WriteMilliseconds;
+	};
+
+	struct TransformUpdateResult
+	{
+		uint32_t	NumNodes;
+		uint32_t	NumThreads;
+		uint32_t	NumFrames;
+
+		// Nodes whose local transform changes every frame, and the nodes below them that are recomputed as well.
+		uint32_t	DirtyNodesPerFrame;
+		double		UpdatedNodesPerFrame;
+
+		double		MillisecondsPerFrame;
+		// Update of every node, as after a load.
+		double		FullUpdateMilliseconds;
+	};
+
+	struct AnimationSampleResult
+	{
+		uint32_t	NumChannels;
+		uint32_t	NumKeys;
+		uint32_t	NumThreads;
+		bool		Slerp;
+
+		// Time spent in Animation::Sample, including the writes into the hierarchy.
+		double		MillisecondsPerFrame;
+		double		NanosecondsPerChannel;
+	};
+
+	struct SkinningResult
+	{
+		uint32_t	NumMeshes;
+		uint32_t	NumVertices;
+		uint32_t	NumJoints;
+		uint32_t	NumThreads;
+		bool		Quantized;
+
+		// Largest difference of the last pose to a scalar reference, in mesh units and degrees.
+		double		MaxPositionError;
+		double		MaxNormalDegrees;
+
+		// Time spent in Skinning::Update.
+		double		MillisecondsPerFrame;
+		double		VerticesPerSecond;
+		double		VerticesPerSecondPerThread;
+	};
+
+	struct InstanceBatchingResult
+	{
+		uint32_t	NumMeshes;
+		uint32_t	NumInstances;
+		uint32_t	SubMeshesPerMesh;
+		uint32_t	NumFrames;
+
+		// Draw calls per frame with a draw per submesh of every instance, and with the instanced draws of InstanceBatcher.
+		uint64_t	DrawsPerFrame;
+		double		BatchesPerFrame;
+		double		DrawCallReduction;
+
+		// Time spent adding the transforms and draws of all instances and building the batches.
+		double		MillisecondsPerFrame;
+	};
+
+	struct RenderQueueResult
+	{
+		uint32_t	NumDraws;
+		uint32_t	NumPasses;
+		uint32_t	NumPipelines;
+		uint32_t	NumMaterials;
+		uint32_t	NumFrames;
+
+		// State changes per frame when the draws are submitted in the order they were added and in key order.
+		double		UnsortedPipelineChanges;
+		double		UnsortedMaterialChanges;
+		double		SortedPipelineChanges;
+		double		SortedMaterialChanges;
+
+		// Time spent building the keys, and sorting them with RenderQueue::Sort and with std::stable_sort.
+		double		KeyMillisecondsPerFrame;
+		double		RadixSortMillisecondsPerFrame;
+		double		StdSortMillisecondsPerFrame;
+
+		// The radix sort produced the same order as std::stable_sort in every frame.
+		bool		MatchesStdSort;
+	};
+
+	struct FrustumCullingResult
+	{
+		uint32_t	NumInstances;
+		uint32_t	NumThreads;
+		uint32_t	NumFrames;
+
+		// Visible instances per frame over all instances.
+		double		VisibleFraction;
+
+		// Time spent adding the world space boxes with FrustumCuller::AddBounds and in FrustumCuller::Cull.
+		double		TransformMillisecondsPerFrame;
+		double		CullMillisecondsPerFrame;
+		double		InstancesPerMillisecond;
+
+		// Instances whose visibility differs from a scalar test of the same boxes, and instances with a corner inside
+		// the view that were culled. Both are 0 unless culling is broken.
+		uint64_t	Mismatches;
+		uint64_t	FalselyCulled;
+	};
+
+	struct RayTracingResult
+	{
+		uint32_t	Width;
+		uint32_t	Height;
+		uint32_t	NumThreads;
+		uint64_t	NumTriangles;
+
+		// Time spent in CpuRayTracer::Build (hierarchy and texture decoding) and CpuRayTracer::Render.
+		double		BuildMilliseconds;
+		double		RenderMilliseconds;
+
+		uint64_t	PrimaryRays;
+		uint64_t	ShadowRays;
+		uint64_t	ReflectionRays;
+		double		RaysPerSecond;
+
+		// Difference to the golden image, 0 when the golden image was written by this run.
+		float		MaxError;
+		double		MeanError;
+		uint64_t	NumPixelsOff;
+		bool		GoldenWritten;
+
+		// The image is identical to the one rendered on a single thread.
+		bool		MatchesSingleThread;
+	};
+
+	struct BvhBuildResult
+	{
+		uint64_t	NumTriangles;
+		uint32_t	NumThreads;
+		uint64_t	NumNodes;
+
+		double		BuildMilliseconds;
+		double		MillisecondsPerMillionTriangles;
+		// See Bvh::GetSahCost.
+		double		SahCost;
+
+		// Random rays whose closest hit differs from intersecting every triangle, 0 unless the hierarchy is broken.
+		uint32_t	NumRays;
+		uint64_t	Mismatches;
+
+		// The nodes are identical to the ones built on a single thread.
+		bool		MatchesSingleThread;
+	};
+
+	struct WideBvhResult
+	{
+		// Children per node, 2 for the binary Bvh.
+		uint32_t	Width;
+		// Primary rays of a camera, random rays through the scene otherwise.
+		bool		Coherent;
+		uint32_t	NumThreads;
+		uint64_t	NumRays;
+
+		uint64_t	NumNodes;
+		uint64_t	NodeBytes;
+		// Time to collapse the binary hierarchy, 0 for the binary Bvh.
+		double		BuildMilliseconds;
+
+		double		RaysPerSecond;
+		double		OcclusionRaysPerSecond;
+
+		// Rays whose closest hit or occlusion differs from the binary Bvh, 0 unless the hierarchy is broken.
+		uint64_t	Mismatches;
+	};
+
+	struct RayQueryResult
+	{
+		// "primary", "shadow" or "reflection".
+		const char*	RaySet;
+		// "single", "packet8", "packet16" or "stream", see WideBvh::QueryMode.
+		const char*	Mode;
+		uint32_t	NumThreads;
+		uint64_t	NumRays;
+		double		RaysPerSecond;
+
+		// Rays whose closest hit or occlusion differs from tracing them one at a time, 0 unless the mode is broken.
+		uint64_t	Mismatches;
+	};
+
+	struct RaySortingResult
+	{
+		// "mirror", "rough" or "rough second bounce".
+		const char*	RaySet;
+		// See RayQueryResult.
+		const char*	Mode;
+		bool		Sorted;
+		uint32_t	NumThreads;
+		uint64_t	NumRays;
+
+		// Time to key, sort and gather the rays, part of RaysPerSecond.
+		double		SortMilliseconds;
+		double		RaysPerSecond;
+		// Processor cycles of all threads per ray, stands in for cache misses, which Windows does not count for applications.
+		double		CyclesPerRay;
+
+		// Sorted rays whose closest hit differs from the unsorted ones, 0 unless sorting is broken.
+		uint64_t	Mismatches;
+	};
+
+	/**
+	* Time the CPU side of loading a scene (parsing, texture decoding and vertex packing) up to the
+	* point where GPU resources would be created, with 1, 2, 4, ... up to max_threads threads for
+	* every ImportMode.
+	*/
+	static std::vector<ImportTiming> BenchmarkImport(const std::string& filename, uint32_t max_threads = 0);
+
+	/**
+	* Time parsing the JSON of a .gltf or .glb file num_iterations times with the DOM of fx-gltf and with
+	* SaxDocumentParser, and compare the documents.
+	*/
+	static GltfParseResult BenchmarkGltfParse(const std::string& filename, uint32_t num_iterations = 10);
+
+	/**
+	* Time decoding megabytes of random data encoded as base64, as in data URIs of glTF buffers, num_iterations times
+	* with the scalar decoder of fx-gltf and every vectorized decoder the CPU supports.
+	*/
+	static std::vector<Base64Result> BenchmarkBase64(uint32_t megabytes = 64, uint32_t num_iterations = 10);
+
+	/**
+	* Measure vertex and index counts, vertex cache efficiency (ACMR, ATVR) and overdraw of every triangle list submesh
+	* in the order of the glTF file and after MeshOptimizer::OptimizePrimitive.
+	*/
+	static std::vector<MeshOptimizationResult> BenchmarkMeshOptimization(const std::string& filename);
+
+	/**
+	* Time building the meshlets of every triangle list submesh after MeshOptimizer::OptimizePrimitive, repeated
+	* num_iterations times.
+	*/
+	static MeshletBuildResult BenchmarkMeshletBuild(const std::string& filename, uint32_t num_iterations = 10);
+
+	/**
+	* Count the triangles that are submitted per frame when every instance draws the levels of detail picked by LodSelector,
+	* along a camera path that spirals out from the center of the scene to four times its bounding radius.
+	* @param fovy The vertical field of view in degrees.
+	*/
+	static LodSelectionResult BenchmarkLodSelection(const std::string& filename, uint32_t num_frames = 256, float fovy = 45.0f,
+		float render_height = 1080.0f, float pixel_error = 1.0f);
+
+	/**
+	* Count the GPU allocations and staged bytes of uploading the vertex and index data of a scene, with a vertex and an
+	* index buffer per submesh and with the buffers planned by GeometryLayout. Committed bytes are rounded up to the
+	* 64 KB placement alignment of committed resources.
+	* @param max_buffer_megabytes Size at which GeometryLayout starts a new buffer.
+	*/
+	static GeometryLayoutResult BenchmarkGeometryLayout(const std::string& filename, uint32_t max_buffer_megabytes = 128);
+
+	/**
+	* Time TransformHierarchy::Update on a random hierarchy of num_nodes nodes where the rotation of dirty_fraction of the
+	* nodes changes every frame, with 1 and num_threads threads (0 uses all hardware threads).
+	*/
+	static std::vector<TransformUpdateResult> BenchmarkTransformUpdate(uint32_t num_nodes = 1000000, float dirty_fraction = 0.01f,
+		uint32_t num_frames = 100, uint32_t num_threads = 0);
+
+	/**
+	* Time sampling a synthetic animation with num_channels channels of num_keys keys, spread over the translation, rotation
+	* and scale of num_channels / 3 nodes and over all interpolation modes. Runs with nlerp and slerp rotations, on 1 and
+	* num_threads threads (0 uses all hardware threads).
+	*/
+	static std::vector<AnimationSampleResult> BenchmarkAnimation(uint32_t num_channels = 10000, uint32_t num_keys = 64,
+		uint32_t num_frames = 240, uint32_t num_threads = 0);
+
+	/**
+	* Time skinning num_meshes synthetic meshes of vertices_per_mesh vertices, each bent by a chain of num_joints joints
+	* with four influences per vertex, in the float and the quantized vertex format on 1 and num_threads threads (0 uses
+	* all hardware threads). The last pose is checked against a scalar reference.
+	*/
+	static std::vector<SkinningResult> BenchmarkSkinning(uint32_t num_meshes = 64, uint32_t vertices_per_mesh = 16384,
+		uint32_t num_joints = 32, uint32_t num_frames = 100, uint32_t num_threads = 0);
+
+	/**
+	* Count the draw calls of num_instances instances of num_meshes synthetic meshes with sub_meshes_per_mesh submeshes of
+	* num_lods levels each, scattered around a camera that circles the center, before and after InstanceBatcher groups
+	* them, and time building the batches. Levels are picked per instance with LodSelector.
+	*/
+	static InstanceBatchingResult BenchmarkInstanceBatching(uint32_t num_meshes = 64, uint32_t num_instances = 100000,
+		uint32_t sub_meshes_per_mesh = 4, uint32_t num_lods = 4, uint32_t num_frames = 100);
+
+	/**
+	* Time building and sorting the RenderQueue keys of num_draws draws with random passes, pipelines, materials and
+	* positions, seen from a camera that circles the center, and count the pipeline and material changes before and after
+	* sorting. The order is checked against std::stable_sort.
+	*/
+	static RenderQueueResult BenchmarkRenderQueue(uint32_t num_draws = 100000, uint32_t num_passes = 2, uint32_t num_pipelines = 16,
+		uint32_t num_materials = 512, uint32_t num_frames = 100);
+
+	/**
+	* Time culling num_instances randomly rotated and scaled unit boxes, scattered around a camera that turns in place,
+	* against its frustum with FrustumCuller on 1 and num_threads threads (0 uses all hardware threads). The visibility is
+	* checked against a scalar reference and the corners of the boxes.
+	*/
+	static std::vector<FrustumCullingResult> BenchmarkFrustumCulling(uint32_t num_instances = 100000, uint32_t num_frames = 100,
+		uint32_t num_threads = 0);
+
+	/**
+	* Render the raytraced pass of ReflectionsDemo from its start camera and sun with CpuRayTracer on 1 and num_threads
+	* threads (0 uses all hardware threads), and count rays per second. The image is compared with golden_filename when
+	* it exists and written to it otherwise, an empty name skips the comparison.
+	*/
+	static std::vector<RayTracingResult> BenchmarkRayTracing(const std::string& filename, const std::string& golden_filename, uint32_t width = 640,
+		uint32_t height = 360, uint32_t num_threads = 0);
+
+	/**
+	* Time building a Bvh over the full resolution triangles of every mesh with its base transform on 1 and num_threads
+	* threads (0 uses all hardware threads), and report its SAH cost. The closest hits of num_rays random rays through
+	* the scene bounds are checked against intersecting every triangle.
+	*/
+	static std::vector<BvhBuildResult> BenchmarkBvhBuild(const std::string& filename, uint32_t num_rays = 256, uint32_t num_threads = 0);
+
+	/**
+	* Trace width * height closest hit and occlusion rays against the binary Bvh of the full resolution triangles and
+	* against WideBvh collapsed to 4 and 8 children, on num_threads threads (0 uses all hardware threads), and count
+	* rays per second. Coherent rays are the primary rays of the start camera of ReflectionsDemo, incoherent rays start
+	* at random points in the scene bounds in random directions. The hits are checked against the binary Bvh.
+	*/
+	static std::vector<WideBvhResult> BenchmarkWideBvh(const std::string& filename, uint32_t width = 640, uint32_t height = 360, uint32_t num_threads = 0);
+
+	/**
+	* Trace the rays of a frame of the start camera of ReflectionsDemo against the WideBvh of CpuRayTracer with every
+	* WideBvh::QueryMode on num_threads threads (0 uses all hardware threads), and count rays per second. The primary
+	* rays of width * height pixels are traced in the tiles of CpuRayTracer. Where they hit, shadow rays towards the sun
+	* and rays reflected about the triangle normal start. Primary and reflection rays look for the closest hit, shadow
+	* rays for any hit. The hits are checked against single rays.
+	*/
+	static std::vector<RayQueryResult> BenchmarkRayQueries(const std::string& filename, uint32_t width = 640, uint32_t height = 360, uint32_t num_threads = 0);
+
+	/**
+	* Trace incoherent reflection rays of the start camera of ReflectionsDemo against the WideBvh of CpuRayTracer in the
+	* order of their pixels and sorted by RaySorter, with every WideBvh::QueryMode on num_threads threads (0 uses all
+	* hardware threads), and count rays per second and processor cycles per ray. The rays reflect off the primary hits
+	* of width * height pixels, about the triangle normal and about randomly tilted normals, and the tilted ones bounce
+	* a second time. The sorted hits are checked against the unsorted ones.
+	*/
+	static std::vector<RaySortingResult> BenchmarkRaySorting(const std::string& filename, uint32_t width = 640, uint32_t height = 360, uint32_t num_threads = 0);
+};
@@ -0,0 +1,459 @@
+#include "neel_engine_pch.h"
+
+#include "benchmarks.h"
+#include "benchmark_helpers.h"
+#include "transform_hierarchy.h"
+#include "animation.h"
+#include "skinning.h"
+#include "vertex_quantization.h"
+#include "thread_pool.h"
+#include "high_resolution_clock.h"
+
+#include <random>
+
+std::vector<Benchmarks::TransformUpdateResult> Benchmarks::BenchmarkTransformUpdate(uint32_t num_nodes, float dirty_fraction, uint32_t num_frames, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	num_nodes	= std::max(num_nodes, 1u);
+	num_frames	= std::max(num_frames, 1u);
+
+	std::vector<TransformUpdateResult> results;
+
+	for (uint32_t threads : { 1u, num_threads })
+	{
+		if (!results.empty() && threads == results.back().NumThreads)
+			break;
+
+		std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(threads);
+
+		// The same hierarchy and dirty nodes for every thread count.
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+		auto random_rotation = [&random, &uniform]()
+		{
+			XMFLOAT4 rotation;
+			XMStoreFloat4(&rotation, XMQuaternionNormalize(XMVectorSet(uniform(random), uniform(random), uniform(random), uniform(random))));
+			return rotation;
+		};
+
+		// Random depth first hierarchy, the parent of a node is a random ancestor of the previous node or none.
+		TransformHierarchy transforms;
+		transforms.Reserve(num_nodes);
+
+		std::vector<int32_t> path;
+		for (uint32_t node = 0; node < num_nodes; node++)
+		{
+			while (!path.empty() && random() % 5 < 3)
+			{
+				path.pop_back();
+			}
+
+			const int32_t parent = path.empty() ? TransformHierarchy::no_parent_ : path.back();
+			const XMFLOAT3 translation(uniform(random), uniform(random), uniform(random));
+
+			path.push_back(static_cast<int32_t>(transforms.AddNode(parent, translation, random_rotation())));
+		}
+
+		TransformUpdateResult result = {};
+		result.NumNodes				= num_nodes;
+		result.NumThreads			= threads;
+		result.NumFrames			= num_frames;
+		result.DirtyNodesPerFrame	= std::max(1u, static_cast<uint32_t>(num_nodes * dirty_fraction));
+
+		{
+			HighResolutionClock clock;
+			transforms.Update(thread_pool.get());
+			clock.Tick();
+
+			result.FullUpdateMilliseconds = clock.GetDeltaMilliseconds();
+		}
+
+		std::vector<std::pair<uint32_t, XMFLOAT4>> changes(result.DirtyNodesPerFrame);
+		uint64_t updated_nodes = 0;
+
+		for (uint32_t frame = 0; frame < num_frames; frame++)
+		{
+			for (auto& change : changes)
+			{
+				change = std::make_pair(static_cast<uint32_t>(random() % num_nodes), random_rotation());
+			}
+
+			HighResolutionClock clock;
+
+			for (const auto& change : changes)
+			{
+				transforms.SetRotation(change.first, change.second);
+			}
+
+			updated_nodes += transforms.Update(thread_pool.get());
+
+			clock.Tick();
+			result.MillisecondsPerFrame += clock.GetDeltaMilliseconds();
+		}
+
+		result.MillisecondsPerFrame	/= num_frames;
+		result.UpdatedNodesPerFrame	= static_cast<double>(updated_nodes) / num_frames;
+
+		Report("Transform update: %u nodes, %u threads, %u dirty -> %.0f updated nodes per frame, %.3f ms per frame, %.2f ms full update\n",
+			result.NumNodes, result.NumThreads, result.DirtyNodesPerFrame, result.UpdatedNodesPerFrame, result.MillisecondsPerFrame, result.FullUpdateMilliseconds);
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::AnimationSampleResult> Benchmarks::BenchmarkAnimation(uint32_t num_channels, uint32_t num_keys, uint32_t num_frames, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	num_channels	= std::max(num_channels, 1u);
+	num_keys		= std::max(num_keys, 2u);
+	num_frames		= std::max(num_frames, 1u);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+	const uint32_t num_nodes = (num_channels + 2) / 3;
+
+	TransformHierarchy transforms;
+	transforms.Reserve(num_nodes);
+	for (uint32_t node = 0; node < num_nodes; node++)
+	{
+		transforms.AddNode(TransformHierarchy::no_parent_);
+	}
+
+	// Channels of a clip share a few key time tracks with jittered spacing, as exported clips do.
+	Animation animation("Benchmark");
+
+	const uint32_t num_tracks = 16;
+	for (uint32_t track = 0; track < num_tracks; track++)
+	{
+		std::vector<float> times(num_keys);
+		for (uint32_t key = 0; key < num_keys; key++)
+		{
+			times[key] = (key + 0.25f * uniform(random) * (key > 0)) / 30.0f;
+		}
+
+		animation.AddTrack(times.data(), times.size());
+	}
+
+	std::vector<float> values(num_keys * 3 * 4);
+
+	for (uint32_t channel = 0; channel < num_channels; channel++)
+	{
+		const Animation::Path path = static_cast<Animation::Path>(channel % 3);
+		const Animation::Interpolation interpolation = static_cast<Animation::Interpolation>((channel / 3) % 3);
+
+		const uint32_t num_components = path == Animation::Path::Rotation ? 4 : 3;
+		const uint32_t num_values = num_keys * (interpolation == Animation::Interpolation::CubicSpline ? 3 : 1);
+
+		for (uint32_t value = 0; value < num_values; value++)
+		{
+			XMFLOAT4 components(uniform(random), uniform(random), uniform(random), uniform(random));
+			if (path == Animation::Path::Rotation)
+			{
+				XMStoreFloat4(&components, XMQuaternionNormalize(XMLoadFloat4(&components)));
+			}
+
+			std::memcpy(&values[value * num_components], &components, num_components * sizeof(float));
+		}
+
+		animation.AddChannel(channel % num_tracks, channel / 3, path, interpolation, values.data());
+	}
+
+	std::vector<AnimationSampleResult> results;
+
+	for (uint32_t threads : { 1u, num_threads })
+	{
+		if (!results.empty() && threads == results.back().NumThreads)
+			break;
+
+		std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(threads);
+
+		for (bool slerp : { false, true })
+		{
+			AnimationSampleResult result = {};
+			result.NumChannels	= num_channels;
+			result.NumKeys		= num_keys;
+			result.NumThreads	= threads;
+			result.Slerp		= slerp;
+
+			// Play the clip once at 60 frames per second, looping when there are more frames than keys.
+			for (uint32_t frame = 0; frame < num_frames; frame++)
+			{
+				const float time = std::fmod(frame / 60.0f, animation.GetDuration());
+
+				HighResolutionClock clock;
+				animation.Sample(time, transforms, thread_pool.get(), slerp);
+				clock.Tick();
+
+				result.MillisecondsPerFrame += clock.GetDeltaMilliseconds();
+
+				transforms.Update(thread_pool.get());
+			}
+
+			result.MillisecondsPerFrame		/= num_frames;
+			result.NanosecondsPerChannel	= result.MillisecondsPerFrame * 1000000.0 / num_channels;
+
+			Report("Animation sampling: %u channels, %u keys, %u threads, %s: %.3f ms per frame, %.1f ns per channel\n",
+				result.NumChannels, result.NumKeys, result.NumThreads, slerp ? "slerp" : "nlerp", result.MillisecondsPerFrame, result.NanosecondsPerChannel);
+
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::SkinningResult> Benchmarks::BenchmarkSkinning(uint32_t num_meshes, uint32_t vertices_per_mesh, uint32_t num_joints, uint32_t num_frames,
+	uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	num_meshes			= std::max(num_meshes, 1u);
+	vertices_per_mesh	= std::max(vertices_per_mesh, 1u);
+	num_joints			= std::min(std::max(num_joints, 1u), 65536u);
+	num_frames			= std::max(num_frames, 1u);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+	// Every mesh is a column from y = -1 to 1 under its own node, bent by a chain of joints along its length.
+	TransformHierarchy transforms;
+	transforms.Reserve(num_meshes * (num_joints + 1));
+
+	const float joint_length = 2.0f / num_joints;
+
+	std::vector<uint32_t> mesh_nodes(num_meshes);
+	std::vector<Skinning::Skin> skins(num_meshes);
+
+	for (uint32_t mesh = 0; mesh < num_meshes; mesh++)
+	{
+		mesh_nodes[mesh] = transforms.AddNode(TransformHierarchy::no_parent_, XMFLOAT3(mesh * 3.0f, 0.0f, 0.0f));
+
+		int32_t parent = static_cast<int32_t>(mesh_nodes[mesh]);
+		for (uint32_t joint = 0; joint < num_joints; joint++)
+		{
+			parent = static_cast<int32_t>(transforms.AddNode(parent, XMFLOAT3(0.0f, joint == 0 ? -1.0f : joint_length, 0.0f)));
+			skins[mesh].Joints.push_back(static_cast<uint32_t>(parent));
+		}
+	}
+
+	transforms.Update();
+
+	// The bind pose is the pose the hierarchy was created with.
+	for (uint32_t mesh = 0; mesh < num_meshes; mesh++)
+	{
+		const XMMATRIX inverse_mesh = XMMatrixInverse(nullptr, transforms.GetWorldMatrix(mesh_nodes[mesh]));
+
+		for (const uint32_t joint : skins[mesh].Joints)
+		{
+			XMFLOAT4X4 inverse_bind_matrix;
+			XMStoreFloat4x4(&inverse_bind_matrix, XMMatrixInverse(nullptr, transforms.GetWorldMatrix(joint) * inverse_mesh));
+			skins[mesh].InverseBindMatrices.push_back(inverse_bind_matrix);
+		}
+	}
+
+	// Float and quantized copies of the same random vertices, influenced by the four joints around their height.
+	std::vector<std::vector<Mesh::PrimitiveData>> float_meshes(num_meshes);
+	std::vector<std::vector<Mesh::PrimitiveData>> quantized_meshes(num_meshes);
+
+	for (uint32_t mesh = 0; mesh < num_meshes; mesh++)
+	{
+		Mesh::PrimitiveData primitive;
+		primitive.Storage.resize(vertices_per_mesh * 6 * sizeof(float));
+		primitive.Skin.resize(vertices_per_mesh);
+
+		float* positions	= reinterpret_cast<float*>(primitive.Storage.data());
+		float* normals		= positions + vertices_per_mesh * 3;
+
+		for (uint32_t v = 0; v < vertices_per_mesh; v++)
+		{
+			const XMFLOAT3 position(0.3f * uniform(random), uniform(random), 0.3f * uniform(random));
+			std::memcpy(&positions[v * 3], &position, sizeof(position));
+
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&normals[v * 3]), XMVector3Normalize(XMVectorSet(uniform(random), uniform(random), uniform(random) + 0.01f, 0.0f)));
+
+			const int32_t nearest = std::min(static_cast<int32_t>((position.y + 1.0f) / joint_length), static_cast<int32_t>(num_joints) - 1);
+
+			Mesh::SkinVertex& influence = primitive.Skin[v];
+			float sum = 0.0f;
+			for (int32_t i = 0; i < 4; i++)
+			{
+				influence.Joints[i]		= static_cast<uint16_t>(std::min(std::max(nearest + i - 1, 0), static_cast<int32_t>(num_joints) - 1));
+				influence.Weights[i]	= uniform(random) + 1.0f;
+				sum += influence.Weights[i];
+			}
+
+			for (float& weight : influence.Weights)
+			{
+				weight /= sum;
+			}
+		}
+
+		primitive.Streams[Mesh::vertex_slot_]		= primitive.Storage.data();
+		primitive.Streams[Mesh::normal_slot_]		= primitive.Storage.data() + vertices_per_mesh * 3 * sizeof(float);
+		primitive.NumElements[Mesh::vertex_slot_]	= vertices_per_mesh;
+		primitive.NumElements[Mesh::normal_slot_]	= vertices_per_mesh;
+		primitive.ElementSize[Mesh::vertex_slot_]	= 3 * sizeof(float);
+		primitive.ElementSize[Mesh::normal_slot_]	= 3 * sizeof(float);
+
+		float_meshes[mesh].push_back(std::move(primitive));
+
+		// The copied streams still point into the float storage until QuantizeMesh replaces them.
+		quantized_meshes[mesh].push_back(float_meshes[mesh].back());
+		VertexQuantization::QuantizeMesh(quantized_meshes[mesh]);
+	}
+
+	std::vector<SkinningResult> results;
+
+	for (bool quantized : { false, true })
+	{
+		const auto& meshes = quantized ? quantized_meshes : float_meshes;
+
+		Skinning skinning;
+		for (uint32_t mesh = 0; mesh < num_meshes; mesh++)
+		{
+			skinning.AddInstance(meshes[mesh], skins[mesh], mesh_nodes[mesh]);
+		}
+
+		for (uint32_t threads : { 1u, num_threads })
+		{
+			if (!results.empty() && results.back().Quantized == quantized && threads == results.back().NumThreads)
+				break;
+
+			std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(threads);
+
+			SkinningResult result = {};
+			result.NumMeshes	= num_meshes;
+			result.NumVertices	= static_cast<uint32_t>(skinning.GetNumVertices());
+			result.NumJoints	= num_joints;
+			result.NumThreads	= threads;
+			result.Quantized	= quantized;
+
+			// The same poses for every run: every joint bends by up to about 17 degrees.
+			std::mt19937 pose_random(5678);
+			std::uniform_real_distribution<float> angle(-0.3f, 0.3f);
+
+			for (uint32_t frame = 0; frame < num_frames; frame++)
+			{
+				for (const auto& skin : skins)
+				{
+					for (const uint32_t joint : skin.Joints)
+					{
+						XMFLOAT4 rotation;
+						XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(angle(pose_random), angle(pose_random), angle(pose_random)));
+						transforms.SetRotation(joint, rotation);
+					}
+				}
+
+				transforms.Update(thread_pool.get());
+
+				HighResolutionClock clock;
+				skinning.Update(transforms, thread_pool.get());
+				clock.Tick();
+
+				result.MillisecondsPerFrame += clock.GetDeltaMilliseconds();
+			}
+
+			result.MillisecondsPerFrame			/= num_frames;
+			result.VerticesPerSecond			= result.NumVertices / (result.MillisecondsPerFrame / 1000.0);
+			result.VerticesPerSecondPerThread	= result.VerticesPerSecond / threads;
+
+			// Scalar reference of the last pose, from the same (decoded) bind pose the skinning started with.
+			for (uint32_t mesh = 0; mesh < num_meshes; mesh++)
+			{
+				const Mesh::PrimitiveData& primitive = meshes[mesh].front();
+				const XMMATRIX inverse_mesh = XMMatrixInverse(nullptr, transforms.GetWorldMatrix(mesh_nodes[mesh]));
+
+				std::vector<XMFLOAT4X4> joint_matrices(num_joints);
+				for (uint32_t joint = 0; joint < num_joints; joint++)
+				{
+					XMStoreFloat4x4(&joint_matrices[joint], XMLoadFloat4x4(&skins[mesh].InverseBindMatrices[joint]) *
+						transforms.GetWorldMatrix(skins[mesh].Joints[joint]) * inverse_mesh);
+				}
+
+				const XMFLOAT3& scale	= skinning.GetPositionScale(mesh);
+				const XMFLOAT3& offset	= skinning.GetPositionOffset(mesh);
+
+				for (uint32_t v = 0; v < vertices_per_mesh; v++)
+				{
+					float position[3];
+					float normal[3];
+					float skinned_position[3];
+					float skinned_normal[3];
+
+					if (quantized)
+					{
+						const int16_t* encoded = reinterpret_cast<const int16_t*>(primitive.Streams[Mesh::vertex_slot_]) + v * 4;
+						position[0] = primitive.PositionOffset.x + VertexQuantization::DecodeSnorm16(encoded[0]) * primitive.PositionScale.x;
+						position[1] = primitive.PositionOffset.y + VertexQuantization::DecodeSnorm16(encoded[1]) * primitive.PositionScale.y;
+						position[2] = primitive.PositionOffset.z + VertexQuantization::DecodeSnorm16(encoded[2]) * primitive.PositionScale.z;
+						VertexQuantization::DecodeOctahedral(reinterpret_cast<const int16_t*>(primitive.Streams[Mesh::normal_slot_]) + v * 2, normal);
+
+						const int16_t* skinned = reinterpret_cast<const int16_t*>(skinning.GetPositions(mesh, 0)) + v * 4;
+						skinned_position[0] = offset.x + VertexQuantization::DecodeSnorm16(skinned[0]) * scale.x;
+						skinned_position[1] = offset.y + VertexQuantization::DecodeSnorm16(skinned[1]) * scale.y;
+						skinned_position[2] = offset.z + VertexQuantization::DecodeSnorm16(skinned[2]) * scale.z;
+						VertexQuantization::DecodeOctahedral(reinterpret_cast<const int16_t*>(skinning.GetNormals(mesh, 0)) + v * 2, skinned_normal);
+					}
+					else
+					{
+						std::memcpy(position, primitive.Streams[Mesh::vertex_slot_] + v * sizeof(position), sizeof(position));
+						std::memcpy(normal, primitive.Streams[Mesh::normal_slot_] + v * sizeof(normal), sizeof(normal));
+						std::memcpy(skinned_position, skinning.GetPositions(mesh, 0) + v * sizeof(position), sizeof(position));
+						std::memcpy(skinned_normal, skinning.GetNormals(mesh, 0) + v * sizeof(normal), sizeof(normal));
+					}
+
+					double reference_position[3] = { 0.0, 0.0, 0.0 };
+					double reference_normal[3] = { 0.0, 0.0, 0.0 };
+
+					const Mesh::SkinVertex& influence = primitive.Skin[v];
+					for (size_t i = 0; i < 4; i++)
+					{
+						const XMFLOAT4X4& m = joint_matrices[influence.Joints[i]];
+						const double weight = influence.Weights[i];
+
+						for (size_t c = 0; c < 3; c++)
+						{
+							reference_position[c] += weight * (position[0] * m.m[0][c] + position[1] * m.m[1][c] + position[2] * m.m[2][c] + m.m[3][c]);
+							reference_normal[c] += weight * (normal[0] * m.m[0][c] + normal[1] * m.m[1][c] + normal[2] * m.m[2][c]);
+						}
+					}
+
+					double normal_length = 0.0;
+					double cosine = 0.0;
+					for (size_t c = 0; c < 3; c++)
+					{
+						result.MaxPositionError = std::max(result.MaxPositionError, std::abs(skinned_position[c] - reference_position[c]));
+						normal_length += reference_normal[c] * reference_normal[c];
+						cosine += skinned_normal[c] * reference_normal[c];
+					}
+
+					cosine /= std::max(std::sqrt(normal_length), 1e-30);
+					result.MaxNormalDegrees = std::max(result.MaxNormalDegrees, std::acos(std::min(1.0, std::max(-1.0, cosine))) * 180.0 / XM_PI);
+				}
+			}
+
+			Report("Skinning: %u meshes, %u vertices, %u joints, %u threads, %s: %.3f ms per frame, %.1f M vertices/s, %.1f M vertices/s per thread, max error %g, %.3f degrees\n",
+				result.NumMeshes, result.NumVertices, result.NumJoints, result.NumThreads, quantized ? "quantized" : "float", result.MillisecondsPerFrame,
+				result.VerticesPerSecond / 1000000.0, result.VerticesPerSecondPerThread / 1000000.0, result.MaxPositionError, result.MaxNormalDegrees);
+
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
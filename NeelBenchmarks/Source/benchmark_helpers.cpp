@@ -0,0 +1,29 @@
+#include "neel_engine_pch.h"
+
+#include "benchmark_helpers.h"
+#include "thread_pool.h"
+
+#include <cstdarg>
+
+std::unique_ptr<ThreadPool> CreateThreadPool(uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	return num_threads > 1 ? std::make_unique<ThreadPool>(num_threads - 1) : nullptr;
+}
+
+void Report(const char* format, ...)
+{
+	char buffer[1024];
+
+	va_list arguments;
+	va_start(arguments, format);
+	vsprintf_s(buffer, _countof(buffer), format, arguments);
+	va_end(arguments);
+
+	fputs(buffer, stdout);
+	OutputDebugStringA(buffer);
+}
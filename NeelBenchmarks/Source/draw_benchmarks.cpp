@@ -0,0 +1,394 @@
+#include "neel_engine_pch.h"
+
+#include "benchmarks.h"
+#include "benchmark_helpers.h"
+#include "mesh.h"
+#include "lod_selector.h"
+#include "instance_batcher.h"
+#include "render_queue.h"
+#include "frustum_culler.h"
+#include "thread_pool.h"
+#include "high_resolution_clock.h"
+
+#include <random>
+
+Benchmarks::InstanceBatchingResult Benchmarks::BenchmarkInstanceBatching(uint32_t num_meshes, uint32_t num_instances, uint32_t sub_meshes_per_mesh,
+	uint32_t num_lods, uint32_t num_frames)
+{
+	num_meshes			= std::min(std::max(num_meshes, 1u), InstanceBatcher::max_meshes_ + 1);
+	num_instances		= std::max(num_instances, 1u);
+	sub_meshes_per_mesh	= std::min(std::max(sub_meshes_per_mesh, 1u), InstanceBatcher::max_sub_meshes_ + 1);
+	num_lods			= std::min(std::max(num_lods, 1u), InstanceBatcher::max_lods_ + 1);
+	num_frames			= std::max(num_frames, 1u);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+	// Every level doubles the error of the previous one, like the chains of MeshSimplifier.
+	std::vector<Mesh::LevelOfDetail> lods(num_lods);
+	for (uint32_t i = 0; i < num_lods; i++)
+	{
+		lods[i] = { 0, 0, i == 0 ? 0.0f : 0.002f * static_cast<float>(1u << std::min(i, 30u)) };
+	}
+
+	// Unit meshes spread over a cube whose side grows with the instance count, about 4 units apart.
+	const float extent = 2.0f * std::cbrt(static_cast<float>(num_instances));
+	const XMFLOAT4 bounding_sphere(0.0f, 0.0f, 0.0f, 1.0f);
+
+	std::vector<uint32_t> meshes(num_instances);
+	std::vector<XMFLOAT4X4> model_matrices(num_instances);
+
+	for (uint32_t i = 0; i < num_instances; i++)
+	{
+		meshes[i] = static_cast<uint32_t>(random() % num_meshes);
+
+		const XMMATRIX model = XMMatrixRotationY(uniform(random) * XM_PI) * XMMatrixTranslation(uniform(random) * extent, uniform(random) * extent,
+			uniform(random) * extent);
+		XMStoreFloat4x4(&model_matrices[i], model);
+	}
+
+	const LodSelector lod_selector(45.0f, 1080.0f);
+
+	InstanceBatchingResult result = {};
+	result.NumMeshes		= num_meshes;
+	result.NumInstances		= num_instances;
+	result.SubMeshesPerMesh	= sub_meshes_per_mesh;
+	result.NumFrames		= num_frames;
+	result.DrawsPerFrame	= static_cast<uint64_t>(num_instances) * sub_meshes_per_mesh;
+
+	InstanceBatcher batcher;
+	uint64_t num_batches = 0;
+
+	for (uint32_t frame = 0; frame < num_frames; frame++)
+	{
+		const float angle = XM_2PI * frame / num_frames;
+		const XMVECTOR eye = XMVectorSet(std::cos(angle) * extent * 0.5f, 0.0f, std::sin(angle) * extent * 0.5f, 1.0f);
+
+		HighResolutionClock clock;
+
+		batcher.Clear();
+
+		for (uint32_t i = 0; i < num_instances; i++)
+		{
+			const XMMATRIX model = XMLoadFloat4x4(&model_matrices[i]);
+
+			const float max_error = lod_selector.GetMaxError(model, bounding_sphere, eye);
+			const uint32_t lod = static_cast<uint32_t>(Mesh::SelectLodIndex(lods, max_error));
+			const uint32_t transform = batcher.AddTransform(model);
+
+			for (uint32_t sub_mesh = 0; sub_mesh < sub_meshes_per_mesh; sub_mesh++)
+			{
+				batcher.AddDraw(meshes[i], sub_mesh, lod, transform);
+			}
+		}
+
+		batcher.Build();
+
+		clock.Tick();
+		result.MillisecondsPerFrame += clock.GetDeltaMilliseconds();
+
+		num_batches += batcher.GetBatches().size();
+	}
+
+	result.MillisecondsPerFrame	/= num_frames;
+	result.BatchesPerFrame		= static_cast<double>(num_batches) / num_frames;
+	result.DrawCallReduction	= result.DrawsPerFrame / result.BatchesPerFrame;
+
+	Report("Instance batching: %u instances of %u meshes, %u submeshes, %u levels -> %llu draws, %.1f batches per frame (%.1fx fewer), %.3f ms per frame\n",
+		result.NumInstances, result.NumMeshes, result.SubMeshesPerMesh, num_lods, result.DrawsPerFrame, result.BatchesPerFrame,
+		result.DrawCallReduction, result.MillisecondsPerFrame);
+
+	return result;
+}
+
+Benchmarks::RenderQueueResult Benchmarks::BenchmarkRenderQueue(uint32_t num_draws, uint32_t num_passes, uint32_t num_pipelines, uint32_t num_materials,
+	uint32_t num_frames)
+{
+	num_draws		= std::max(num_draws, 1u);
+	num_passes		= std::min(std::max(num_passes, 1u), RenderQueue::max_pass_ + 1);
+	num_pipelines	= std::min(std::max(num_pipelines, 1u), RenderQueue::max_pipeline_ + 1);
+	num_materials	= std::min(std::max(num_materials, 1u), RenderQueue::max_material_ + 1);
+	num_frames		= std::max(num_frames, 1u);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+	struct Draw
+	{
+		uint32_t	Pass;
+		uint32_t	Pipeline;
+		uint32_t	Material;
+		XMFLOAT3	Position;
+	};
+
+	// Draws spread over a cube about 2 units apart, in random order like glTF nodes.
+	const float extent = std::cbrt(static_cast<float>(num_draws));
+	const float near_clip = 0.1f;
+	const float far_clip = extent * 4.0f;
+
+	std::vector<Draw> draws(num_draws);
+	for (auto& draw : draws)
+	{
+		draw.Pass		= static_cast<uint32_t>(random() % num_passes);
+		draw.Pipeline	= static_cast<uint32_t>(random() % num_pipelines);
+		draw.Material	= static_cast<uint32_t>(random() % num_materials);
+		draw.Position	= XMFLOAT3(uniform(random) * extent, uniform(random) * extent, uniform(random) * extent);
+	}
+
+	// Pipeline and material changes when the draws are submitted in the order of the values.
+	auto count_changes = [&draws](const std::vector<uint32_t>& order, uint64_t& pipeline_changes, uint64_t& material_changes)
+	{
+		const Draw* previous = nullptr;
+		for (uint32_t i : order)
+		{
+			const Draw& draw = draws[i];
+			if (!previous || draw.Pass != previous->Pass || draw.Pipeline != previous->Pipeline)
+			{
+				pipeline_changes++;
+				material_changes++;
+			}
+			else if (draw.Material != previous->Material)
+			{
+				material_changes++;
+			}
+
+			previous = &draw;
+		}
+	};
+
+	RenderQueueResult result = {};
+	result.NumDraws			= num_draws;
+	result.NumPasses		= num_passes;
+	result.NumPipelines		= num_pipelines;
+	result.NumMaterials		= num_materials;
+	result.NumFrames		= num_frames;
+	result.MatchesStdSort	= true;
+
+	std::vector<uint32_t> unsorted(num_draws);
+	for (uint32_t i = 0; i < num_draws; i++)
+	{
+		unsorted[i] = i;
+	}
+
+	uint64_t unsorted_pipeline_changes = 0, unsorted_material_changes = 0;
+	count_changes(unsorted, unsorted_pipeline_changes, unsorted_material_changes);
+
+	RenderQueue queue;
+	queue.Reserve(num_draws);
+
+	std::vector<std::pair<uint64_t, uint32_t>> reference;
+	reference.reserve(num_draws);
+
+	uint64_t sorted_pipeline_changes = 0, sorted_material_changes = 0;
+
+	for (uint32_t frame = 0; frame < num_frames; frame++)
+	{
+		const float angle = XM_2PI * frame / num_frames;
+		const XMVECTOR eye = XMVectorSet(std::cos(angle) * extent * 2.0f, 0.0f, std::sin(angle) * extent * 2.0f, 1.0f);
+		const XMMATRIX view = XMMatrixLookAtLH(eye, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+		HighResolutionClock clock;
+
+		queue.Clear();
+		for (uint32_t i = 0; i < num_draws; i++)
+		{
+			const Draw& draw = draws[i];
+
+			const float depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&draw.Position), view));
+			const uint32_t depth_bucket = RenderQueue::QuantizeDepth(depth, near_clip, far_clip);
+
+			queue.Add(RenderQueue::MakeKey(draw.Pass, draw.Pipeline, draw.Material, depth_bucket), i);
+		}
+
+		clock.Tick();
+		result.KeyMillisecondsPerFrame += clock.GetDeltaMilliseconds();
+
+		reference.clear();
+		for (size_t i = 0; i < queue.GetSize(); i++)
+		{
+			reference.emplace_back(queue.GetKeys()[i], queue.GetValues()[i]);
+		}
+
+		clock.Tick();
+		queue.Sort();
+		clock.Tick();
+		result.RadixSortMillisecondsPerFrame += clock.GetDeltaMilliseconds();
+
+		std::stable_sort(reference.begin(), reference.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b)
+		{
+			return a.first < b.first;
+		});
+		clock.Tick();
+		result.StdSortMillisecondsPerFrame += clock.GetDeltaMilliseconds();
+
+		for (size_t i = 0; i < reference.size(); i++)
+		{
+			result.MatchesStdSort &= reference[i].first == queue.GetKeys()[i] && reference[i].second == queue.GetValues()[i];
+		}
+
+		count_changes(queue.GetValues(), sorted_pipeline_changes, sorted_material_changes);
+	}
+
+	result.UnsortedPipelineChanges			= static_cast<double>(unsorted_pipeline_changes);
+	result.UnsortedMaterialChanges			= static_cast<double>(unsorted_material_changes);
+	result.SortedPipelineChanges			= static_cast<double>(sorted_pipeline_changes) / num_frames;
+	result.SortedMaterialChanges			= static_cast<double>(sorted_material_changes) / num_frames;
+	result.KeyMillisecondsPerFrame			/= num_frames;
+	result.RadixSortMillisecondsPerFrame	/= num_frames;
+	result.StdSortMillisecondsPerFrame		/= num_frames;
+
+	Report("Render queue: %u draws, %u passes, %u pipelines, %u materials -> pipeline changes %.0f -> %.0f, material changes %.0f -> %.0f, "
+		"keys %.3f ms, radix sort %.3f ms, std::stable_sort %.3f ms per frame%s\n",
+		result.NumDraws, result.NumPasses, result.NumPipelines, result.NumMaterials, result.UnsortedPipelineChanges, result.SortedPipelineChanges,
+		result.UnsortedMaterialChanges, result.SortedMaterialChanges, result.KeyMillisecondsPerFrame, result.RadixSortMillisecondsPerFrame,
+		result.StdSortMillisecondsPerFrame, result.MatchesStdSort ? "" : ", ORDER MISMATCH");
+
+	return result;
+}
+
+std::vector<Benchmarks::FrustumCullingResult> Benchmarks::BenchmarkFrustumCulling(uint32_t num_instances, uint32_t num_frames, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	num_instances	= std::max(num_instances, 1u);
+	num_frames		= std::max(num_frames, 1u);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+	// Unit boxes spread over a cube about 4 units apart, the camera sits in the middle.
+	const float extent = 2.0f * std::cbrt(static_cast<float>(num_instances));
+
+	Mesh::BoundingVolume bounds;
+	bounds.Center	= XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.Extents	= XMFLOAT3(1.0f, 1.0f, 1.0f);
+	bounds.Radius	= std::sqrt(3.0f);
+
+	std::vector<XMFLOAT4X4> model_matrices(num_instances);
+	for (auto& model_matrix : model_matrices)
+	{
+		const XMMATRIX model = XMMatrixScaling(1.0f + uniform(random) * 0.5f, 1.0f + uniform(random) * 0.5f, 1.0f + uniform(random) * 0.5f) *
+			XMMatrixRotationRollPitchYaw(uniform(random) * XM_PI, uniform(random) * XM_PI, uniform(random) * XM_PI) *
+			XMMatrixTranslation(uniform(random) * extent, uniform(random) * extent, uniform(random) * extent);
+		XMStoreFloat4x4(&model_matrix, model);
+	}
+
+	const XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), 16.0f / 9.0f, 0.1f, extent * 2.0f);
+
+	std::vector<FrustumCullingResult> results;
+
+	for (uint32_t threads : { 1u, num_threads })
+	{
+		if (!results.empty() && threads == results.back().NumThreads)
+			break;
+
+		std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(threads);
+
+		FrustumCullingResult result = {};
+		result.NumInstances	= num_instances;
+		result.NumThreads	= threads;
+		result.NumFrames	= num_frames;
+
+		FrustumCuller culler;
+		culler.Reserve(num_instances);
+
+		uint64_t num_visible = 0;
+
+		for (uint32_t frame = 0; frame < num_frames; frame++)
+		{
+			const float angle = XM_2PI * frame / num_frames;
+			const XMVECTOR focus = XMVectorSet(std::cos(angle), 0.0f, std::sin(angle), 1.0f);
+			const XMMATRIX view_projection = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), focus, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * projection;
+
+			HighResolutionClock clock;
+
+			culler.SetFrustum(view_projection);
+			culler.Clear();
+
+			for (const auto& model_matrix : model_matrices)
+			{
+				culler.AddBounds(XMLoadFloat4x4(&model_matrix), bounds);
+			}
+
+			clock.Tick();
+			result.TransformMillisecondsPerFrame += clock.GetDeltaMilliseconds();
+
+			num_visible += culler.Cull(thread_pool.get());
+
+			clock.Tick();
+			result.CullMillisecondsPerFrame += clock.GetDeltaMilliseconds();
+
+			// The same test with scalar math, boxes within a small distance of a plane may go either way.
+			XMFLOAT4 planes[6];
+			FrustumCuller::ExtractPlanes(view_projection, planes);
+
+			for (uint32_t i = 0; i < num_instances; i++)
+			{
+				const XMFLOAT4X4& m = model_matrices[i];
+
+				const float center[3] = { m._41, m._42, m._43 };
+				const float extents[3] =
+				{
+					std::abs(m._11) + std::abs(m._21) + std::abs(m._31),
+					std::abs(m._12) + std::abs(m._22) + std::abs(m._32),
+					std::abs(m._13) + std::abs(m._23) + std::abs(m._33)
+				};
+
+				float min_distance = FLT_MAX;
+				for (const XMFLOAT4& plane : planes)
+				{
+					const float distance = plane.x * center[0] + plane.y * center[1] + plane.z * center[2] + plane.w +
+						std::abs(plane.x) * extents[0] + std::abs(plane.y) * extents[1] + std::abs(plane.z) * extents[2];
+					min_distance = std::min(min_distance, distance);
+				}
+
+				if (std::abs(min_distance) > 1e-3f && (min_distance >= 0.0f) != culler.IsVisible(i))
+				{
+					result.Mismatches++;
+				}
+			}
+
+			// A box with a corner inside of the clip volume is visible whatever the planes say.
+			if (frame + 1 == num_frames)
+			{
+				for (uint32_t i = 0; i < num_instances; i++)
+				{
+					if (culler.IsVisible(i))
+						continue;
+
+					const XMMATRIX model_view_projection = XMLoadFloat4x4(&model_matrices[i]) * view_projection;
+
+					for (uint32_t corner = 0; corner < 8; corner++)
+					{
+						const XMVECTOR position = XMVectorSet(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f, 1.0f);
+
+						XMFLOAT4 clip;
+						XMStoreFloat4(&clip, XMVector4Transform(position, model_view_projection));
+
+						if (clip.w > 0.0f && std::abs(clip.x) < clip.w && std::abs(clip.y) < clip.w && clip.z > 0.0f && clip.z < clip.w)
+						{
+							result.FalselyCulled++;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		result.VisibleFraction					= static_cast<double>(num_visible) / (static_cast<double>(num_instances) * num_frames);
+		result.TransformMillisecondsPerFrame	/= num_frames;
+		result.CullMillisecondsPerFrame			/= num_frames;
+		result.InstancesPerMillisecond			= num_instances / std::max(result.CullMillisecondsPerFrame, 1e-6);
+
+		Report("Frustum culling: %u instances, %u threads, %.1f%% visible: transform %.3f ms, cull %.3f ms per frame, %.0f instances per ms, %llu mismatches, %llu falsely culled\n",
+			result.NumInstances, result.NumThreads, result.VisibleFraction * 100.0, result.TransformMillisecondsPerFrame, result.CullMillisecondsPerFrame,
+			result.InstancesPerMillisecond, result.Mismatches, result.FalselyCulled);
+
+		results.push_back(result);
+	}
+
+	return results;
+}
@@ -0,0 +1,596 @@
+#include "neel_engine_pch.h"
+
+#include "benchmarks.h"
+#include "benchmark_helpers.h"
+#include "gltf_scene.h"
+#include "scene_cache.h"
+#include "gltf_sax_parser.h"
+#include "memory_mapped_file.h"
+#include "meshlet_builder.h"
+#include "mesh_simplifier.h"
+#include "lod_selector.h"
+#include "geometry_layout.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+#include "high_resolution_clock.h"
+
+#include <psapi.h>
+#include <functional>
+#include <random>
+
+std::vector<Benchmarks::ImportTiming> Benchmarks::BenchmarkImport(const std::string& filename, uint32_t max_threads)
+{
+	if (max_threads == 0)
+	{
+		max_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Make sure an up to date cook exists before timing it.
+	{
+		SceneData scene_data;
+		if (!SceneCache::Load(filename, false, scene_data))
+		{
+			Scene::ImportGltf(filename, true, false, nullptr, scene_data);
+			SceneCache::Save(filename, scene_data);
+		}
+	}
+
+	std::vector<ImportTiming> timings;
+
+	for (ImportMode mode : { ImportMode::ReadBuffers, ImportMode::MapBuffers, ImportMode::Cooked })
+	{
+		const size_t first_timing = timings.size();
+
+		for (uint32_t num_threads = 1; ; num_threads = std::min(num_threads * 2, max_threads))
+		{
+			PROCESS_MEMORY_COUNTERS_EX memory_before = {};
+			GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory_before), sizeof(memory_before));
+
+			HighResolutionClock clock;
+
+			std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(num_threads);
+
+			SceneData scene_data;
+			if (mode == ImportMode::Cooked)
+			{
+				SceneCache::Load(filename, false, scene_data);
+			}
+			else
+			{
+				Scene::ImportGltf(filename, mode == ImportMode::MapBuffers, false, thread_pool.get(), scene_data);
+			}
+
+			TextureCache texture_cache;
+			texture_cache.DecodeImages(scene_data.TextureRequests, thread_pool.get());
+
+			// Touch all vertex and index data once, like the upload to the GPU does.
+			uint64_t checksum = 0;
+			for (const auto& mesh : scene_data.Primitives)
+			{
+				for (const auto& primitive : mesh)
+				{
+					for (size_t slot = 0; slot < primitive.Streams.size(); slot++)
+					{
+						for (size_t j = 0; primitive.Streams[slot] && j < primitive.StreamSize(slot); j += 64)
+						{
+							checksum += primitive.Streams[slot][j];
+						}
+					}
+				}
+			}
+
+			clock.Tick();
+
+			PROCESS_MEMORY_COUNTERS_EX memory_after = {};
+			GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory_after), sizeof(memory_after));
+
+			ImportTiming timing;
+			timing.NumThreads			= num_threads;
+			timing.Mode					= mode;
+			timing.Milliseconds			= clock.GetDeltaMilliseconds();
+			timing.PrivateBytes			= memory_after.PrivateUsage > memory_before.PrivateUsage ? memory_after.PrivateUsage - memory_before.PrivateUsage : 0;
+			timing.PeakWorkingSetBytes	= memory_after.PeakWorkingSetSize;
+			timings.push_back(timing);
+
+			const char* mode_names[] = { "read", "mapped", "cooked" };
+
+			Report("Scene import benchmark %s (%s): %u thread(s) %.2f ms (%.2fx), %.1f MB private, %.1f MB peak working set [%llu]\n",
+				filename.c_str(), mode_names[static_cast<int>(mode)], num_threads, timing.Milliseconds, timings[first_timing].Milliseconds / timing.Milliseconds,
+				timing.PrivateBytes / (1024.0 * 1024.0), timing.PeakWorkingSetBytes / (1024.0 * 1024.0), checksum);
+
+			if (num_threads == max_threads)
+				break;
+		}
+	}
+
+	return timings;
+}
+
+// Stats of the chunks an optimized primitive was split into, weighted by triangles (ACMR, overdraw) and vertices (ATVR).
+static MeshOptimizer::Stats AnalyzeChunks(const std::vector<Mesh::PrimitiveData>& chunks)
+{
+	MeshOptimizer::Stats total;
+	size_t triangles = 0;
+	size_t vertices = 0;
+
+	for (const auto& chunk : chunks)
+	{
+		const size_t chunk_triangles	= chunk.IndexCount / 3;
+		const size_t chunk_vertices		= chunk.NumElements[Mesh::vertex_slot_];
+
+		const MeshOptimizer::Stats stats = MeshOptimizer::Analyze(MeshOptimizer::ReadIndices(chunk), reinterpret_cast<const float*>(chunk.Streams[Mesh::vertex_slot_]), chunk_vertices);
+
+		total.Acmr		+= stats.Acmr * chunk_triangles;
+		total.Atvr		+= stats.Atvr * chunk_vertices;
+		total.Overdraw	+= stats.Overdraw * chunk_triangles;
+
+		triangles	+= chunk_triangles;
+		vertices	+= chunk_vertices;
+	}
+
+	total.Acmr		/= std::max<size_t>(triangles, 1);
+	total.Atvr		/= std::max<size_t>(vertices, 1);
+	total.Overdraw	/= std::max<size_t>(triangles, 1);
+
+	return total;
+}
+
+std::vector<Benchmarks::MeshOptimizationResult> Benchmarks::BenchmarkMeshOptimization(const std::string& filename)
+{
+	MappedDocument document(filename, true);
+	const fx::gltf::Document& doc = document.GetDocument();
+
+	std::vector<MeshOptimizationResult> results;
+	MeshOptimizationResult total = {};
+
+	for (size_t i = 0; i < doc.meshes.size(); i++)
+	{
+		for (size_t j = 0; j < doc.meshes[i].primitives.size(); j++)
+		{
+			Mesh::PrimitiveData primitive;
+			Mesh::PackPrimitive(doc, i, j, primitive, &document.GetBufferData());
+
+			if (primitive.Topology != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST || primitive.IndexCount == 0)
+				continue;
+
+			const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+			MeshOptimizationResult result = {};
+			result.MeshName				= doc.meshes[i].name;
+			result.PrimitiveIndex		= static_cast<uint32_t>(j);
+			result.NumTriangles			= primitive.IndexCount / 3;
+			result.NumVerticesBefore	= static_cast<uint32_t>(vertex_count);
+			result.IndexBytesBefore		= primitive.IndexDataSize();
+			result.Before				= MeshOptimizer::Analyze(MeshOptimizer::ReadIndices(primitive), reinterpret_cast<const float*>(primitive.Streams[Mesh::vertex_slot_]), vertex_count);
+
+			HighResolutionClock clock;
+			const std::vector<Mesh::PrimitiveData> chunks = MeshOptimizer::OptimizePrimitive(primitive);
+			clock.Tick();
+
+			result.Milliseconds			= clock.GetDeltaMilliseconds();
+			result.NumSubMeshesAfter	= static_cast<uint32_t>(chunks.size());
+			result.After				= AnalyzeChunks(chunks);
+
+			for (const auto& chunk : chunks)
+			{
+				result.NumVerticesAfter	+= static_cast<uint32_t>(chunk.NumElements[Mesh::vertex_slot_]);
+				result.IndexBytesAfter	+= chunk.IndexDataSize();
+			}
+
+			Report("Mesh optimization %s[%u]: %u triangles, %u -> %u vertices, %llu -> %llu index bytes, %u submesh(es), ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f, %.2f ms\n",
+				result.MeshName.c_str(), result.PrimitiveIndex, result.NumTriangles, result.NumVerticesBefore, result.NumVerticesAfter,
+				result.IndexBytesBefore, result.IndexBytesAfter, result.NumSubMeshesAfter, result.Before.Acmr, result.After.Acmr,
+				result.Before.Atvr, result.After.Atvr, result.Before.Overdraw, result.After.Overdraw, result.Milliseconds);
+
+			// Totals are weighted by the number of triangles.
+			for (auto stats : { std::make_pair(&total.Before, &result.Before), std::make_pair(&total.After, &result.After) })
+			{
+				stats.first->Acmr		+= stats.second->Acmr * result.NumTriangles;
+				stats.first->Atvr		+= stats.second->Atvr * result.NumTriangles;
+				stats.first->Overdraw	+= stats.second->Overdraw * result.NumTriangles;
+			}
+
+			total.NumTriangles		+= result.NumTriangles;
+			total.NumVerticesBefore	+= result.NumVerticesBefore;
+			total.NumVerticesAfter	+= result.NumVerticesAfter;
+			total.NumSubMeshesAfter	+= result.NumSubMeshesAfter;
+			total.IndexBytesBefore	+= result.IndexBytesBefore;
+			total.IndexBytesAfter	+= result.IndexBytesAfter;
+			total.Milliseconds		+= result.Milliseconds;
+
+			results.push_back(result);
+		}
+	}
+
+	if (total.NumTriangles > 0)
+	{
+		for (auto* stats : { &total.Before, &total.After })
+		{
+			stats->Acmr		/= total.NumTriangles;
+			stats->Atvr		/= total.NumTriangles;
+			stats->Overdraw	/= total.NumTriangles;
+		}
+	}
+
+	Report("Mesh optimization %s: %zu -> %u submeshes, %u triangles, %u -> %u vertices, %.2f -> %.2f MB index data, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f, %.2f ms\n",
+		filename.c_str(), results.size(), total.NumSubMeshesAfter, total.NumTriangles, total.NumVerticesBefore, total.NumVerticesAfter,
+		total.IndexBytesBefore / (1024.0 * 1024.0), total.IndexBytesAfter / (1024.0 * 1024.0), total.Before.Acmr, total.After.Acmr,
+		total.Before.Atvr, total.After.Atvr, total.Before.Overdraw, total.After.Overdraw, total.Milliseconds);
+
+	return results;
+}
+
+Benchmarks::MeshletBuildResult Benchmarks::BenchmarkMeshletBuild(const std::string& filename, uint32_t num_iterations)
+{
+	MappedDocument document(filename, true);
+	const fx::gltf::Document& doc = document.GetDocument();
+
+	// Meshlets are built from optimized submeshes on import.
+	std::vector<Mesh::PrimitiveData> primitives;
+	for (size_t i = 0; i < doc.meshes.size(); i++)
+	{
+		for (size_t j = 0; j < doc.meshes[i].primitives.size(); j++)
+		{
+			Mesh::PrimitiveData primitive;
+			Mesh::PackPrimitive(doc, i, j, primitive, &document.GetBufferData());
+
+			for (auto& chunk : MeshOptimizer::OptimizePrimitive(primitive))
+			{
+				if (chunk.Topology == D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST && chunk.IndexCount > 0)
+				{
+					primitives.push_back(std::move(chunk));
+				}
+			}
+		}
+	}
+
+	num_iterations = std::max(num_iterations, 1u);
+
+	MeshletBuildResult result = {};
+	result.NumSubMeshes = static_cast<uint32_t>(primitives.size());
+
+	uint64_t num_vertices = 0;
+
+	for (uint32_t iteration = 0; iteration < num_iterations; iteration++)
+	{
+		for (const auto& primitive : primitives)
+		{
+			HighResolutionClock clock;
+			const MeshletData meshlets = MeshletBuilder::Build(primitive);
+			clock.Tick();
+
+			result.Milliseconds += clock.GetDeltaMilliseconds();
+
+			if (iteration == 0)
+			{
+				result.NumTriangles	+= primitive.IndexCount / 3;
+				result.NumMeshlets	+= meshlets.Meshlets.size();
+				num_vertices		+= meshlets.Vertices.size();
+			}
+		}
+	}
+
+	result.Milliseconds						/= num_iterations;
+	result.MillisecondsPerMillionTriangles	= result.NumTriangles > 0 ? result.Milliseconds * 1000000.0 / result.NumTriangles : 0.0;
+	result.AverageVertices					= result.NumMeshlets > 0 ? static_cast<double>(num_vertices) / result.NumMeshlets : 0.0;
+	result.AverageTriangles					= result.NumMeshlets > 0 ? static_cast<double>(result.NumTriangles) / result.NumMeshlets : 0.0;
+
+	Report("Meshlet build %s: %u submeshes, %llu triangles, %llu meshlets (%.1f vertices, %.1f triangles on average), %.2f ms, %.2f ms per million triangles\n",
+		filename.c_str(), result.NumSubMeshes, result.NumTriangles, result.NumMeshlets, result.AverageVertices, result.AverageTriangles,
+		result.Milliseconds, result.MillisecondsPerMillionTriangles);
+
+	return result;
+}
+
+Benchmarks::LodSelectionResult Benchmarks::BenchmarkLodSelection(const std::string& filename, uint32_t num_frames, float fovy, float render_height, float pixel_error)
+{
+	// Levels of detail are built from the float positions on import.
+	SceneData scene_data;
+	Scene::ImportGltf(filename, true, false, nullptr, scene_data);
+
+	LodSelectionResult result = {};
+	result.NumFrames	= std::max(num_frames, 1u);
+	result.NumInstances	= static_cast<uint32_t>(scene_data.Instances.size());
+
+	// Rebuild the levels from the full resolution indices to time the simplifier on its own.
+	for (const auto& primitives : scene_data.Primitives)
+	{
+		for (const auto& primitive : primitives)
+		{
+			if (primitive.Lods.empty())
+				continue;
+
+			Mesh::PrimitiveData full_detail = primitive;
+			full_detail.IndexCount = primitive.Lods[0].IndexCount;
+			full_detail.Lods.clear();
+
+			HighResolutionClock clock;
+			MeshSimplifier::BuildLodChain(full_detail);
+			clock.Tick();
+
+			result.BuildMilliseconds += clock.GetDeltaMilliseconds();
+		}
+	}
+
+	std::vector<XMFLOAT4> bounding_spheres(scene_data.Primitives.size());
+	for (size_t i = 0; i < scene_data.Primitives.size(); i++)
+	{
+		bounding_spheres[i] = Mesh::ComputeBoundingSphere(scene_data.Primitives[i]);
+	}
+
+	// The camera path is scaled to the bounds of all instances.
+	XMVECTOR scene_min = XMVectorReplicate(FLT_MAX);
+	XMVECTOR scene_max = XMVectorReplicate(-FLT_MAX);
+
+	for (const auto& instance : scene_data.Instances)
+	{
+		const XMFLOAT4& sphere = bounding_spheres[instance.MeshIndex];
+		const XMVECTOR center = XMVector3TransformCoord(XMLoadFloat4(&sphere), scene_data.Transforms.GetWorldMatrix(instance.NodeIndex));
+
+		scene_min = XMVectorMin(scene_min, center);
+		scene_max = XMVectorMax(scene_max, center);
+
+		for (const auto& primitive : scene_data.Primitives[instance.MeshIndex])
+		{
+			result.FullDetailTriangles += (primitive.Lods.empty() ? primitive.IndexCount : primitive.Lods[0].IndexCount) / 3;
+		}
+	}
+
+	if (result.NumInstances == 0)
+	{
+		scene_min = scene_max = XMVectorZero();
+	}
+
+	const XMVECTOR scene_center = (scene_min + scene_max) * 0.5f;
+	const float scene_radius = std::max(XMVectorGetX(XMVector3Length(scene_max - scene_center)), 1.0f);
+
+	const LodSelector selector(fovy, render_height, pixel_error);
+
+	result.TrianglesPerFrame.resize(result.NumFrames);
+	result.MinTriangles = UINT64_MAX;
+
+	double select_milliseconds = 0.0;
+
+	for (uint32_t frame = 0; frame < result.NumFrames; frame++)
+	{
+		const float t = result.NumFrames > 1 ? frame / static_cast<float>(result.NumFrames - 1) : 0.0f;
+		const float angle = XM_2PI * 2.0f * t;
+		const float distance = scene_radius * (0.1f + 3.9f * t);
+
+		const XMVECTOR eye = scene_center + XMVectorSet(std::cos(angle) * distance, 0.25f * distance, std::sin(angle) * distance, 0.0f);
+
+		HighResolutionClock clock;
+
+		uint64_t triangles = 0;
+		for (const auto& instance : scene_data.Instances)
+		{
+			const float max_error = selector.GetMaxError(scene_data.Transforms.GetWorldMatrix(instance.NodeIndex), bounding_spheres[instance.MeshIndex], eye);
+
+			for (const auto& primitive : scene_data.Primitives[instance.MeshIndex])
+			{
+				triangles += LodSelector::GetTriangleCount(primitive.Lods, primitive.IndexCount, max_error);
+			}
+		}
+
+		clock.Tick();
+		select_milliseconds += clock.GetDeltaMilliseconds();
+
+		result.TrianglesPerFrame[frame]	= triangles;
+		result.AverageTriangles			+= static_cast<double>(triangles) / result.NumFrames;
+		result.MinTriangles				= std::min(result.MinTriangles, triangles);
+		result.MaxTriangles				= std::max(result.MaxTriangles, triangles);
+	}
+
+	result.SelectMillisecondsPerFrame = select_milliseconds / result.NumFrames;
+
+	Report("LOD selection %s: %u instances, %llu triangles at full detail, %.0f (%llu - %llu) triangles per frame over %u frames (%.1f%%), %.2f ms build, %.4f ms select per frame\n",
+		filename.c_str(), result.NumInstances, result.FullDetailTriangles, result.AverageTriangles, result.MinTriangles, result.MaxTriangles, result.NumFrames,
+		result.FullDetailTriangles > 0 ? 100.0 * result.AverageTriangles / result.FullDetailTriangles : 0.0, result.BuildMilliseconds, result.SelectMillisecondsPerFrame);
+
+	return result;
+}
+
+// Size of a committed buffer in GPU memory.
+static uint64_t CommittedSize(uint64_t size)
+{
+	const uint64_t alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+Benchmarks::GeometryLayoutResult Benchmarks::BenchmarkGeometryLayout(const std::string& filename, uint32_t max_buffer_megabytes)
+{
+	SceneData scene_data;
+	Scene::ImportGltf(filename, true, false, nullptr, scene_data);
+
+	GeometryLayoutResult result = {};
+
+	HighResolutionClock clock;
+
+	GeometryLayout layout(std::max(max_buffer_megabytes, 1u) * 1024ull * 1024ull);
+
+	for (const auto& primitives : scene_data.Primitives)
+	{
+		for (const auto& primitive : primitives)
+		{
+			std::array<const void*, GeometryLayout::num_streams_> streams;
+			std::array<uint64_t, GeometryLayout::num_streams_> stream_sizes;
+			for (size_t slot = 0; slot < GeometryLayout::num_streams_; slot++)
+			{
+				streams[slot]		= primitive.Streams[slot];
+				stream_sizes[slot]	= primitive.StreamSize(slot);
+			}
+
+			layout.AddSubMesh(streams, stream_sizes, primitive.Indices, primitive.IndexDataSize());
+
+			// The vertex and the index buffer are each created in the default heap and staged in an upload heap resource.
+			result.PerSubMeshAllocations	+= 4;
+			result.PerSubMeshStagingBytes	+= primitive.VertexDataSize() + primitive.IndexDataSize();
+			result.PerSubMeshCommittedBytes	+= 2 * (CommittedSize(primitive.VertexDataSize()) + CommittedSize(primitive.IndexDataSize()));
+		}
+	}
+
+	clock.Tick();
+	result.PlanMilliseconds = clock.GetDeltaMilliseconds();
+
+	result.NumSubMeshes		= static_cast<uint32_t>(layout.GetNumSubMeshes());
+	result.NumVertexBuffers	= static_cast<uint32_t>(layout.GetVertexBuffers().size());
+	result.NumIndexBuffers	= static_cast<uint32_t>(layout.GetIndexBuffers().size());
+	result.Allocations		= layout.GetNumAllocations();
+	result.StagingBytes		= layout.GetStagingSize();
+	result.CommittedBytes	= CommittedSize(result.StagingBytes);
+
+	for (const auto* buffers : { &layout.GetVertexBuffers(), &layout.GetIndexBuffers() })
+	{
+		for (const auto& buffer : *buffers)
+		{
+			result.CommittedBytes += CommittedSize(buffer.Size);
+		}
+	}
+
+	// The staging memory is written like the mapped upload buffer.
+	std::vector<uint8_t> staging(result.StagingBytes);
+
+	clock.Tick();
+	layout.WriteStaging(staging.data());
+	clock.Tick();
+	result.WriteMilliseconds = clock.GetDeltaMilliseconds();
+
+	const double megabyte = 1024.0 * 1024.0;
+
+	Report("Geometry layout %s: %u submeshes, per submesh buffers %zu allocations, %.2f MB staged, %.2f MB committed; "
+		"GeometryLayout (%u MB buffers) %u vertex and %u index buffer(s), %zu allocations, %.2f MB staged, %.2f MB committed, %.3f ms plan, %.2f ms write\n",
+		filename.c_str(), result.NumSubMeshes, result.PerSubMeshAllocations, result.PerSubMeshStagingBytes / megabyte, result.PerSubMeshCommittedBytes / megabyte,
+		std::max(max_buffer_megabytes, 1u), result.NumVertexBuffers, result.NumIndexBuffers, result.Allocations, result.StagingBytes / megabyte,
+		result.CommittedBytes / megabyte, result.PlanMilliseconds, result.WriteMilliseconds);
+
+	return result;
+}
+
+std::vector<Benchmarks::Base64Result> Benchmarks::BenchmarkBase64(uint32_t megabytes, uint32_t num_iterations)
+{
+	num_iterations = std::max(num_iterations, 1u);
+
+	std::mt19937 random(1234);
+
+	std::vector<uint8_t> bytes(std::max(megabytes, 1u) * 1024ull * 1024ull);
+	for (auto& byte : bytes)
+	{
+		byte = static_cast<uint8_t>(random());
+	}
+
+	const std::string encoded = fx::base64::Encode(bytes);
+	const double encoded_megabytes = encoded.size() / (1024.0 * 1024.0);
+
+	std::vector<std::pair<const char*, std::function<bool(std::vector<uint8_t>&)>>> decoders =
+	{
+		{ "scalar", [&](std::vector<uint8_t>& out) { return fx::base64::TryDecodeScalar(encoded, out); } },
+	};
+
+#if defined(FX_GLTF_BASE64_SIMD)
+	const fx::base64::detail::DecodeIsa isa = fx::base64::detail::GetDecodeIsa();
+	if (isa != fx::base64::detail::DecodeIsa::Scalar)
+	{
+		decoders.push_back({ "sse4.1", [&](std::vector<uint8_t>& out) { return fx::base64::detail::TryDecodeWith(fx::base64::detail::DecodeIsa::SSE41, encoded, out); } });
+	}
+
+	if (isa == fx::base64::detail::DecodeIsa::AVX2)
+	{
+		decoders.push_back({ "avx2", [&](std::vector<uint8_t>& out) { return fx::base64::detail::TryDecodeWith(fx::base64::detail::DecodeIsa::AVX2, encoded, out); } });
+	}
+#endif
+
+	std::vector<Base64Result> results;
+
+	for (const auto& decoder : decoders)
+	{
+		std::vector<uint8_t> decoded;
+		bool matches = true;
+
+		HighResolutionClock clock;
+
+		for (uint32_t i = 0; i < num_iterations; i++)
+		{
+			matches = decoder.second(decoded) && matches;
+		}
+
+		clock.Tick();
+
+		Base64Result result;
+		result.Decoder				= decoder.first;
+		result.MegabytesPerSecond	= encoded_megabytes * num_iterations / clock.GetDeltaSeconds();
+		result.Matches				= matches && decoded == bytes;
+		results.push_back(result);
+
+		Report("Base64 decode (%.1f MB): %s %.1f MB/s (%.2fx)%s\n", encoded_megabytes, result.Decoder, result.MegabytesPerSecond,
+			result.MegabytesPerSecond / results[0].MegabytesPerSecond, result.Matches ? "" : ", output DIFFERS");
+	}
+
+	return results;
+}
+
+// JSON text of a .gltf file or the JSON chunk of a .glb file.
+static std::pair<const uint8_t*, const uint8_t*> GetJsonText(const std::string& filename, const MemoryMappedFile& file)
+{
+	if (!StringEndsWith(filename, ".glb"))
+	{
+		return { file.Data(), file.Data() + file.Size() };
+	}
+
+	fx::gltf::detail::GLBHeader header{};
+	if (file.Size() < fx::gltf::detail::HeaderSize)
+	{
+		throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+	}
+
+	std::memcpy(&header, file.Data(), fx::gltf::detail::HeaderSize);
+	if (header.magic != fx::gltf::detail::GLBHeaderMagic ||
+		header.jsonHeader.chunkType != fx::gltf::detail::GLBChunkJSON ||
+		fx::gltf::detail::HeaderSize + header.jsonHeader.chunkLength > file.Size())
+	{
+		throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+	}
+
+	const uint8_t* json_begin = file.Data() + fx::gltf::detail::HeaderSize;
+	return { json_begin, json_begin + header.jsonHeader.chunkLength };
+}
+
+Benchmarks::GltfParseResult Benchmarks::BenchmarkGltfParse(const std::string& filename, uint32_t num_iterations)
+{
+	MemoryMappedFile file(filename);
+	const auto json_text = GetJsonText(filename, file);
+
+	num_iterations = std::max(num_iterations, 1u);
+
+	GltfParseResult result = {};
+	result.JsonMegabytes = (json_text.second - json_text.first) / (1024.0 * 1024.0);
+
+	fx::gltf::Document dom_document;
+	fx::gltf::Document sax_document;
+
+	HighResolutionClock clock;
+
+	for (uint32_t i = 0; i < num_iterations; i++)
+	{
+		dom_document = nlohmann::json::parse(json_text.first, json_text.second);
+	}
+
+	clock.Tick();
+	result.DomMilliseconds = clock.GetDeltaMilliseconds() / num_iterations;
+
+	for (uint32_t i = 0; i < num_iterations; i++)
+	{
+		SaxDocumentParser::Parse(json_text.first, json_text.second, sax_document);
+	}
+
+	clock.Tick();
+	result.SaxMilliseconds = clock.GetDeltaMilliseconds() / num_iterations;
+
+	// fx-gltf documents have no comparison operator, compare their serialized form instead.
+	result.DocumentsEqual = nlohmann::json(dom_document) == nlohmann::json(sax_document);
+
+	Report("glTF parse %s (%.2f MB JSON): DOM %.3f ms (%.1f MB/s), SAX %.3f ms (%.1f MB/s), documents %s\n",
+		filename.c_str(), result.JsonMegabytes, result.DomMilliseconds, result.JsonMegabytes / (result.DomMilliseconds / 1000.0),
+		result.SaxMilliseconds, result.JsonMegabytes / (result.SaxMilliseconds / 1000.0), result.DocumentsEqual ? "equal" : "DIFFER");
+
+	return result;
+}
@@ -0,0 +1,164 @@
+#include "neel_engine_pch.h"
+
+#include "benchmarks.h"
+
+#include <functional>
+#include <iostream>
+
+// Positional arguments of a benchmark, after its name.
+class Arguments
+{
+public:
+	Arguments(int argc, char** argv)
+		: arguments_(argv, argv + argc)
+	{
+	}
+
+	std::string GetString(size_t index) const
+	{
+		if (index >= arguments_.size())
+		{
+			throw std::invalid_argument("Missing argument " + std::to_string(index + 1));
+		}
+
+		return arguments_[index];
+	}
+
+	std::string GetString(size_t index, const std::string& default_value) const
+	{
+		return index < arguments_.size() ? arguments_[index] : default_value;
+	}
+
+	uint32_t GetUint(size_t index, uint32_t default_value) const
+	{
+		return index < arguments_.size() ? static_cast<uint32_t>(std::stoul(arguments_[index])) : default_value;
+	}
+
+	float GetFloat(size_t index, float default_value) const
+	{
+		return index < arguments_.size() ? std::stof(arguments_[index]) : default_value;
+	}
+
+private:
+	std::vector<std::string> arguments_;
+};
+
+struct Benchmark
+{
+	const char* Name;
+	const char* Usage;
+	std::function<void(const Arguments&)> Run;
+};
+
+static const Benchmark benchmarks[] =
+{
+	{ "import", "<gltf file> [max threads]",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkImport(arguments.GetString(0), arguments.GetUint(1, 0)); } },
+	{ "gltf_parse", "<gltf file> [iterations]",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkGltfParse(arguments.GetString(0), arguments.GetUint(1, 10)); } },
+	{ "base64", "[megabytes] [iterations]",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkBase64(arguments.GetUint(0, 64), arguments.GetUint(1, 10)); } },
+	{ "mesh_optimization", "<gltf file>",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkMeshOptimization(arguments.GetString(0)); } },
+	{ "meshlet_build", "<gltf file> [iterations]",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkMeshletBuild(arguments.GetString(0), arguments.GetUint(1, 10)); } },
+	{ "lod_selection", "<gltf file> [frames] [fovy] [render height] [pixel error]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkLodSelection(arguments.GetString(0), arguments.GetUint(1, 256), arguments.GetFloat(2, 45.0f), arguments.GetFloat(3, 1080.0f),
+				arguments.GetFloat(4, 1.0f));
+		} },
+	{ "geometry_layout", "<gltf file> [max buffer megabytes]",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkGeometryLayout(arguments.GetString(0), arguments.GetUint(1, 128)); } },
+	{ "transform_update", "[nodes] [dirty fraction] [frames] [threads]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkTransformUpdate(arguments.GetUint(0, 1000000), arguments.GetFloat(1, 0.01f), arguments.GetUint(2, 100), arguments.GetUint(3, 0));
+		} },
+	{ "animation", "[channels] [keys] [frames] [threads]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkAnimation(arguments.GetUint(0, 10000), arguments.GetUint(1, 64), arguments.GetUint(2, 240), arguments.GetUint(3, 0));
+		} },
+	{ "skinning", "[meshes] [vertices per mesh] [joints] [frames] [threads]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkSkinning(arguments.GetUint(0, 64), arguments.GetUint(1, 16384), arguments.GetUint(2, 32), arguments.GetUint(3, 100),
+				arguments.GetUint(4, 0));
+		} },
+	{ "instance_batching", "[meshes] [instances] [submeshes per mesh] [lods] [frames]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkInstanceBatching(arguments.GetUint(0, 64), arguments.GetUint(1, 100000), arguments.GetUint(2, 4), arguments.GetUint(3, 4),
+				arguments.GetUint(4, 100));
+		} },
+	{ "render_queue", "[draws] [passes] [pipelines] [materials] [frames]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkRenderQueue(arguments.GetUint(0, 100000), arguments.GetUint(1, 2), arguments.GetUint(2, 16), arguments.GetUint(3, 512),
+				arguments.GetUint(4, 100));
+		} },
+	{ "frustum_culling", "[instances] [frames] [threads]",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkFrustumCulling(arguments.GetUint(0, 100000), arguments.GetUint(1, 100), arguments.GetUint(2, 0)); } },
+	{ "ray_tracing", "<gltf file> [golden image] [width] [height] [threads]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkRayTracing(arguments.GetString(0), arguments.GetString(1, ""), arguments.GetUint(2, 640), arguments.GetUint(3, 360),
+				arguments.GetUint(4, 0));
+		} },
+	{ "bvh_build", "<gltf file> [rays] [threads]",
+		[](const Arguments& arguments) { Benchmarks::BenchmarkBvhBuild(arguments.GetString(0), arguments.GetUint(1, 256), arguments.GetUint(2, 0)); } },
+	{ "wide_bvh", "<gltf file> [width] [height] [threads]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkWideBvh(arguments.GetString(0), arguments.GetUint(1, 640), arguments.GetUint(2, 360), arguments.GetUint(3, 0));
+		} },
+	{ "ray_queries", "<gltf file> [width] [height] [threads]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkRayQueries(arguments.GetString(0), arguments.GetUint(1, 640), arguments.GetUint(2, 360), arguments.GetUint(3, 0));
+		} },
+	{ "ray_sorting", "<gltf file> [width] [height] [threads]",
+		[](const Arguments& arguments)
+		{
+			Benchmarks::BenchmarkRaySorting(arguments.GetString(0), arguments.GetUint(1, 640), arguments.GetUint(2, 360), arguments.GetUint(3, 0));
+		} },
+};
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: NeelBenchmarks <benchmark> [arguments]\n";
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		std::cerr << "  " << benchmark.Name << " " << benchmark.Usage << "\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const Benchmark* benchmark = argc < 2 ? std::end(benchmarks) :
+		std::find_if(std::begin(benchmarks), std::end(benchmarks), [&](const Benchmark& b) { return b.Name == std::string(argv[1]); });
+
+	if (benchmark == std::end(benchmarks))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Images are decoded with WIC on this thread as well as on the thread pool.
+	ThrowIfFailed(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+
+	int result = 0;
+	try
+	{
+		benchmark->Run(Arguments(argc - 2, argv + 2));
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << benchmark->Name << " failed: " << exception.what() << "\n";
+		result = 1;
+	}
+
+	CoUninitialize();
+	return result;
+}
@@ -0,0 +1,869 @@
+#include "neel_engine_pch.h"
+
+#include "benchmarks.h"
+#include "benchmark_helpers.h"
+#include "gltf_scene.h"
+#include "bvh.h"
+#include "wide_bvh.h"
+#include "ray_sorter.h"
+#include "cpu_ray_tracer.h"
+#include "thread_pool.h"
+#include "high_resolution_clock.h"
+
+#include <random>
+
+std::vector<Benchmarks::RayTracingResult> Benchmarks::BenchmarkRayTracing(const std::string& filename, const std::string& golden_filename, uint32_t width,
+	uint32_t height, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	width	= std::max(width, 1u);
+	height	= std::max(height, 1u);
+
+	// The demo raytraces the quantized vertex streams.
+	SceneData scene_data;
+	Scene::ImportGltf(filename, true, true, nullptr, scene_data);
+
+	// Start camera and sun of ReflectionsDemo.
+	const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(9.0f, 1.5f, -0.09f, 1.0f), XMVectorSet(0.0f, 1.5f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const XMMATRIX view_projection = view * XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), width / static_cast<float>(height), 0.1f, 100.0f);
+
+	SceneConstantBuffer scene_constants;
+	scene_constants.InverseViewProj	= XMMatrixInverse(nullptr, view_projection);
+	scene_constants.ViewProj		= view_projection;
+	scene_constants.CamPos			= XMVectorSet(9.0f, 1.5f, -0.09f, 1.0f);
+	scene_constants.VFOV			= 45.0f;
+	scene_constants.PixelHeight		= static_cast<float>(height);
+
+	DirectionalLight light;
+	light.DirectionWS	= XMFLOAT4(20.0f, 40.0f, 10.0f, 1.0f);
+	light.Color			= XMFLOAT4(15.0f, 15.0f, 15.0f, 1.0f);
+	XMStoreFloat4(&light.DirectionVS, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat4(&light.DirectionWS), view)));
+
+	std::vector<XMFLOAT4> golden;
+	uint32_t golden_width = 0, golden_height = 0;
+
+	const bool has_golden = !golden_filename.empty() && CpuRayTracer::ReadImage(golden_filename, golden, golden_width, golden_height);
+	if (has_golden && (golden_width != width || golden_height != height))
+	{
+		throw std::runtime_error("Golden image " + golden_filename + " has a different size than the benchmark.");
+	}
+
+	std::vector<RayTracingResult> results;
+	std::vector<XMFLOAT4> single_thread_image;
+
+	for (uint32_t threads : { 1u, num_threads })
+	{
+		if (!results.empty() && threads == results.back().NumThreads)
+			break;
+
+		std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(threads);
+
+		RayTracingResult result = {};
+		result.Width		= width;
+		result.Height		= height;
+		result.NumThreads	= threads;
+
+		HighResolutionClock clock;
+
+		CpuRayTracer ray_tracer;
+		ray_tracer.Build(scene_data, thread_pool.get());
+
+		clock.Tick();
+		result.BuildMilliseconds = clock.GetDeltaMilliseconds();
+		result.NumTriangles = ray_tracer.GetNumTriangles();
+
+		std::vector<XMFLOAT4> image;
+		const CpuRayTracer::Stats stats = ray_tracer.Render(scene_constants, light, width, height, image, thread_pool.get());
+
+		clock.Tick();
+		result.RenderMilliseconds = clock.GetDeltaMilliseconds();
+
+		result.PrimaryRays		= stats.PrimaryRays;
+		result.ShadowRays		= stats.ShadowRays;
+		result.ReflectionRays	= stats.ReflectionRays;
+		result.RaysPerSecond	= stats.GetNumRays() * 1000.0 / std::max(result.RenderMilliseconds, 1e-6);
+
+		if (has_golden)
+		{
+			const CpuRayTracer::ImageDifference difference = CpuRayTracer::CompareImages(image, golden, 1e-3f);
+
+			result.MaxError		= difference.MaxError;
+			result.MeanError	= difference.MeanError;
+			result.NumPixelsOff	= difference.NumPixelsOff;
+		}
+		else if (!golden_filename.empty() && results.empty())
+		{
+			CpuRayTracer::WriteImage(golden_filename, image, width, height);
+			result.GoldenWritten = true;
+		}
+
+		// Pixels are traced independently, the number of threads must not change a single bit.
+		if (results.empty())
+		{
+			single_thread_image = std::move(image);
+			result.MatchesSingleThread = true;
+		}
+		else
+		{
+			result.MatchesSingleThread = std::memcmp(image.data(), single_thread_image.data(), image.size() * sizeof(XMFLOAT4)) == 0;
+		}
+
+		Report("Ray tracing %s: %ux%u, %llu triangles, %u threads: build %.2f ms, render %.2f ms, %llu primary, %llu shadow, %llu reflection rays, %.2f Mrays/s, golden %s (max error %g, %llu pixels off), %s single thread image\n",
+			filename.c_str(), result.Width, result.Height, result.NumTriangles, result.NumThreads, result.BuildMilliseconds, result.RenderMilliseconds,
+			result.PrimaryRays, result.ShadowRays, result.ReflectionRays, result.RaysPerSecond / 1000000.0,
+			result.GoldenWritten ? "written" : (has_golden ? "compared" : "skipped"), result.MaxError, result.NumPixelsOff,
+			result.MatchesSingleThread ? "matches" : "differs from");
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::BvhBuildResult> Benchmarks::BenchmarkBvhBuild(const std::string& filename, uint32_t num_rays, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	SceneData scene_data;
+	Scene::ImportGltf(filename, true, true, nullptr, scene_data);
+
+	std::vector<XMFLOAT3> positions;
+	for (size_t mesh = 0; mesh < scene_data.Primitives.size(); mesh++)
+	{
+		for (const auto& primitive : scene_data.Primitives[mesh])
+		{
+			Bvh::AppendTriangles(primitive, XMLoadFloat4x4(&scene_data.BaseTransforms[mesh]), positions);
+		}
+	}
+
+	const size_t num_triangles = positions.size() / 3;
+
+	XMVECTOR scene_min = XMVectorReplicate(FLT_MAX);
+	XMVECTOR scene_max = XMVectorReplicate(-FLT_MAX);
+
+	for (const XMFLOAT3& position : positions)
+	{
+		scene_min = XMVectorMin(scene_min, XMLoadFloat3(&position));
+		scene_max = XMVectorMax(scene_max, XMLoadFloat3(&position));
+	}
+
+	// Rays from random points in the scene bounds in random directions, half of them limited to a tenth of the diagonal.
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+	const float diagonal = num_triangles > 0 ? XMVectorGetX(XMVector3Length(scene_max - scene_min)) : 1.0f;
+
+	std::vector<Bvh::Ray> rays(num_rays);
+	for (uint32_t i = 0; i < num_rays; i++)
+	{
+		Bvh::Ray& ray = rays[i];
+
+		XMStoreFloat3(&ray.Origin, XMVectorLerpV(scene_min, scene_max, XMVectorSet(uniform(random), uniform(random), uniform(random), 0.0f)));
+		XMStoreFloat3(&ray.Direction, XMVector3Normalize(XMVectorSet(uniform(random) - 0.5f, uniform(random) - 0.5f, uniform(random) - 0.5f, 0.0f)));
+		ray.TMin = 0.0f;
+		ray.TMax = i % 2 == 0 ? FLT_MAX : diagonal * 0.1f;
+	}
+
+	// Closest hits of intersecting every triangle.
+	std::vector<float> reference_hits(num_rays, FLT_MAX);
+	for (uint32_t i = 0; i < num_rays; i++)
+	{
+		const Bvh::Ray& ray = rays[i];
+		const XMVECTOR origin = XMLoadFloat3(&ray.Origin);
+		const XMVECTOR direction = XMLoadFloat3(&ray.Direction);
+
+		for (size_t triangle = 0; triangle < num_triangles; triangle++)
+		{
+			const XMVECTOR v0 = XMLoadFloat3(&positions[triangle * 3]);
+			const XMVECTOR edge1 = XMLoadFloat3(&positions[triangle * 3 + 1]) - v0;
+			const XMVECTOR edge2 = XMLoadFloat3(&positions[triangle * 3 + 2]) - v0;
+
+			const XMVECTOR p = XMVector3Cross(direction, edge2);
+			const float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+			if (determinant == 0.0f)
+				continue;
+
+			const XMVECTOR s = origin - v0;
+			const XMVECTOR q = XMVector3Cross(s, edge1);
+			const float u = XMVectorGetX(XMVector3Dot(s, p)) / determinant;
+			const float v = XMVectorGetX(XMVector3Dot(direction, q)) / determinant;
+			const float t = XMVectorGetX(XMVector3Dot(edge2, q)) / determinant;
+
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= ray.TMin && t <= ray.TMax)
+			{
+				reference_hits[i] = std::min(reference_hits[i], t);
+			}
+		}
+	}
+
+	std::vector<BvhBuildResult> results;
+	std::vector<Bvh::Node> single_thread_nodes;
+
+	for (uint32_t threads : { 1u, num_threads })
+	{
+		if (!results.empty() && threads == results.back().NumThreads)
+			break;
+
+		std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(threads);
+
+		BvhBuildResult result = {};
+		result.NumTriangles	= num_triangles;
+		result.NumThreads	= threads;
+		result.NumRays		= num_rays;
+
+		HighResolutionClock clock;
+
+		Bvh bvh;
+		bvh.Build(positions, thread_pool.get());
+
+		clock.Tick();
+		result.BuildMilliseconds				= clock.GetDeltaMilliseconds();
+		result.MillisecondsPerMillionTriangles	= num_triangles > 0 ? result.BuildMilliseconds * 1000000.0 / num_triangles : 0.0;
+		result.NumNodes							= bvh.GetNodes().size();
+		result.SahCost							= bvh.GetSahCost();
+
+		// Hits within a small distance of the reference may go either way at the edges of triangles.
+		for (uint32_t i = 0; i < num_rays; i++)
+		{
+			Bvh::Hit hit;
+			const bool is_hit = bvh.Intersect(rays[i], hit);
+			const float t = is_hit ? hit.T : FLT_MAX;
+
+			if (std::abs(t - reference_hits[i]) > 1e-4f * std::max(1.0f, std::abs(reference_hits[i])) || is_hit != bvh.Occluded(rays[i]))
+			{
+				result.Mismatches++;
+			}
+		}
+
+		if (results.empty())
+		{
+			single_thread_nodes = bvh.GetNodes();
+			result.MatchesSingleThread = true;
+		}
+		else
+		{
+			result.MatchesSingleThread = bvh.GetNodes().size() == single_thread_nodes.size() &&
+				std::memcmp(bvh.GetNodes().data(), single_thread_nodes.data(), single_thread_nodes.size() * sizeof(Bvh::Node)) == 0;
+		}
+
+		Report("BVH build %s: %llu triangles, %u threads: %llu nodes, %.2f ms, %.2f ms per million triangles, SAH cost %.2f, %llu of %u rays mismatched, %s single thread nodes\n",
+			filename.c_str(), result.NumTriangles, result.NumThreads, result.NumNodes, result.BuildMilliseconds, result.MillisecondsPerMillionTriangles,
+			result.SahCost, result.Mismatches, result.NumRays, result.MatchesSingleThread ? "matches" : "differs from");
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::WideBvhResult> Benchmarks::BenchmarkWideBvh(const std::string& filename, uint32_t width, uint32_t height, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	width	= std::max(width, 1u);
+	height	= std::max(height, 1u);
+
+	SceneData scene_data;
+	Scene::ImportGltf(filename, true, true, nullptr, scene_data);
+
+	std::vector<XMFLOAT3> positions;
+	for (size_t mesh = 0; mesh < scene_data.Primitives.size(); mesh++)
+	{
+		for (const auto& primitive : scene_data.Primitives[mesh])
+		{
+			Bvh::AppendTriangles(primitive, XMLoadFloat4x4(&scene_data.BaseTransforms[mesh]), positions);
+		}
+	}
+
+	std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(num_threads);
+
+	Bvh bvh;
+	bvh.Build(positions, thread_pool.get());
+
+	XMVECTOR scene_min = XMVectorReplicate(FLT_MAX);
+	XMVECTOR scene_max = XMVectorReplicate(-FLT_MAX);
+
+	for (const XMFLOAT3& position : positions)
+	{
+		scene_min = XMVectorMin(scene_min, XMLoadFloat3(&position));
+		scene_max = XMVectorMax(scene_max, XMLoadFloat3(&position));
+	}
+
+	const size_t num_rays = static_cast<size_t>(width) * height;
+
+	// Primary rays of the start camera of ReflectionsDemo, like CpuRayTracer.
+	const XMVECTOR camera_position = XMVectorSet(9.0f, 1.5f, -0.09f, 1.0f);
+	const XMMATRIX view = XMMatrixLookAtLH(camera_position, XMVectorSet(0.0f, 1.5f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const XMMATRIX inverse_view_projection = XMMatrixInverse(nullptr, view * XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), width / static_cast<float>(height), 0.1f, 100.0f));
+
+	std::vector<Bvh::Ray> coherent_rays(num_rays);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const float screen_x = (x + 0.5f) / width * 2.0f - 1.0f;
+			const float screen_y = -((y + 0.5f) / height * 2.0f - 1.0f);
+			const XMVECTOR near_point = XMVector3TransformCoord(XMVectorSet(screen_x, screen_y, 0.0f, 1.0f), inverse_view_projection);
+
+			Bvh::Ray& ray = coherent_rays[static_cast<size_t>(y) * width + x];
+			XMStoreFloat3(&ray.Origin, camera_position);
+			XMStoreFloat3(&ray.Direction, XMVector3Normalize(near_point - camera_position));
+			ray.TMin = 0.0f;
+			ray.TMax = FLT_MAX;
+		}
+	}
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+	std::vector<Bvh::Ray> incoherent_rays(num_rays);
+	for (Bvh::Ray& ray : incoherent_rays)
+	{
+		XMStoreFloat3(&ray.Origin, XMVectorLerpV(scene_min, scene_max, XMVectorSet(uniform(random), uniform(random), uniform(random), 0.0f)));
+		XMStoreFloat3(&ray.Direction, XMVector3Normalize(XMVectorSet(uniform(random) - 0.5f, uniform(random) - 0.5f, uniform(random) - 0.5f, 0.0f)));
+		ray.TMin = 0.0f;
+		ray.TMax = FLT_MAX;
+	}
+
+	// Invoke function(begin, end) over ranges of the rays on the pool.
+	auto for_each_range = [&](const std::function<void(size_t, size_t)>& function)
+	{
+		if (thread_pool)
+		{
+			thread_pool->ParallelForRange(num_rays, 1024, function);
+		}
+		else
+		{
+			function(0, num_rays);
+		}
+	};
+
+	std::vector<WideBvhResult> results;
+
+	// Hits of the binary Bvh, the reference of the wide layouts.
+	std::vector<Bvh::Hit> reference_hits[2];
+	std::vector<uint8_t> reference_occluded[2];
+
+	for (uint32_t bvh_width : { 2u, 4u, 8u })
+	{
+		HighResolutionClock clock;
+
+		WideBvh wide_bvh;
+		if (bvh_width > 2)
+		{
+			wide_bvh.Build(bvh, bvh_width);
+		}
+
+		clock.Tick();
+		const double build_milliseconds = bvh_width > 2 ? clock.GetDeltaMilliseconds() : 0.0;
+
+		for (int coherent = 1; coherent >= 0; coherent--)
+		{
+			const std::vector<Bvh::Ray>& rays = coherent ? coherent_rays : incoherent_rays;
+
+			WideBvhResult result = {};
+			result.Width				= bvh_width;
+			result.Coherent				= coherent != 0;
+			result.NumThreads			= num_threads;
+			result.NumRays				= num_rays;
+			result.NumNodes				= bvh_width > 2 ? wide_bvh.GetNumNodes() : bvh.GetNodes().size();
+			result.NodeBytes			= bvh_width > 2 ? wide_bvh.GetNodeBytes() : bvh.GetNodes().size() * sizeof(Bvh::Node);
+			result.BuildMilliseconds	= build_milliseconds;
+
+			std::vector<Bvh::Hit> hits(num_rays);
+			std::vector<uint8_t> occluded(num_rays);
+
+			clock.Tick();
+
+			for_each_range([&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					if (bvh_width > 2)
+					{
+						wide_bvh.Intersect(rays[i], hits[i]);
+					}
+					else
+					{
+						bvh.Intersect(rays[i], hits[i]);
+					}
+				}
+			});
+
+			clock.Tick();
+			result.RaysPerSecond = num_rays * 1000.0 / std::max(clock.GetDeltaMilliseconds(), 1e-6);
+
+			for_each_range([&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					occluded[i] = bvh_width > 2 ? wide_bvh.Occluded(rays[i]) : bvh.Occluded(rays[i]);
+				}
+			});
+
+			clock.Tick();
+			result.OcclusionRaysPerSecond = num_rays * 1000.0 / std::max(clock.GetDeltaMilliseconds(), 1e-6);
+
+			// Every layout runs the same triangle test, the closest distance must match exactly.
+			if (bvh_width == 2)
+			{
+				reference_hits[coherent] = std::move(hits);
+				reference_occluded[coherent] = std::move(occluded);
+			}
+			else
+			{
+				for (size_t i = 0; i < num_rays; i++)
+				{
+					const Bvh::Hit& reference = reference_hits[coherent][i];
+					const bool reference_is_hit = reference.Triangle != Bvh::no_hit_;
+
+					if (reference_is_hit != (hits[i].Triangle != Bvh::no_hit_) || (reference_is_hit && reference.T != hits[i].T) ||
+						reference_occluded[coherent][i] != occluded[i])
+					{
+						result.Mismatches++;
+					}
+				}
+			}
+
+			Report("BVH%u %s, %s rays: %llu rays, %u threads, %llu nodes, %llu node bytes, build %.2f ms: %.2f Mrays/s closest hit, %.2f Mrays/s occlusion, %llu mismatches\n",
+				result.Width, filename.c_str(), result.Coherent ? "coherent" : "incoherent", result.NumRays, result.NumThreads, result.NumNodes, result.NodeBytes,
+				result.BuildMilliseconds, result.RaysPerSecond / 1000000.0, result.OcclusionRaysPerSecond / 1000000.0, result.Mismatches);
+
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
+
+// Primary rays of the start camera of ReflectionsDemo, tile by tile like CpuRayTracer::Render.
+static void GetStartCameraRays(uint32_t width, uint32_t height, std::vector<Bvh::Ray>& rays)
+{
+	const XMVECTOR camera_position = XMVectorSet(9.0f, 1.5f, -0.09f, 1.0f);
+	const XMMATRIX view = XMMatrixLookAtLH(camera_position, XMVectorSet(0.0f, 1.5f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const XMMATRIX inverse_view_projection = XMMatrixInverse(nullptr, view * XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), width / static_cast<float>(height), 0.1f, 100.0f));
+
+	const uint32_t tile_size = CpuRayTracer::tile_size_;
+
+	rays.clear();
+	rays.reserve(static_cast<size_t>(width) * height);
+
+	for (uint32_t tile_y = 0; tile_y < height; tile_y += tile_size)
+	{
+		for (uint32_t tile_x = 0; tile_x < width; tile_x += tile_size)
+		{
+			for (uint32_t y = tile_y; y < std::min(tile_y + tile_size, height); y++)
+			{
+				for (uint32_t x = tile_x; x < std::min(tile_x + tile_size, width); x++)
+				{
+					const float screen_x = (x + 0.5f) / width * 2.0f - 1.0f;
+					const float screen_y = -((y + 0.5f) / height * 2.0f - 1.0f);
+					const XMVECTOR near_point = XMVector3TransformCoord(XMVectorSet(screen_x, screen_y, 0.0f, 1.0f), inverse_view_projection);
+
+					Bvh::Ray ray;
+					XMStoreFloat3(&ray.Origin, camera_position);
+					XMStoreFloat3(&ray.Direction, XMVector3Normalize(near_point - camera_position));
+					ray.TMin = 0.0f;
+					ray.TMax = FLT_MAX;
+
+					rays.push_back(ray);
+				}
+			}
+		}
+	}
+}
+
+static bool GetBounceRay(const Bvh::Ray& ray, const Bvh::Hit& hit, const std::vector<XMFLOAT3>& positions, Bvh::Ray& bounce_ray, XMVECTOR& normal)
+{
+	if (hit.Triangle == Bvh::no_hit_)
+		return false;
+
+	const XMVECTOR direction = XMLoadFloat3(&ray.Direction);
+	const XMVECTOR v0 = XMLoadFloat3(&positions[hit.Triangle * 3]);
+	normal = XMVector3Normalize(XMVector3Cross(XMLoadFloat3(&positions[hit.Triangle * 3 + 1]) - v0, XMLoadFloat3(&positions[hit.Triangle * 3 + 2]) - v0));
+	normal = XMVectorSelect(normal, -normal, XMVectorGreater(XMVector3Dot(normal, direction), XMVectorZero()));
+
+	XMStoreFloat3(&bounce_ray.Origin, XMLoadFloat3(&ray.Origin) + direction * hit.T + normal * 1e-3f);
+	bounce_ray.TMin = 0.0f;
+	bounce_ray.TMax = FLT_MAX;
+
+	return true;
+}
+
+std::vector<Benchmarks::RayQueryResult> Benchmarks::BenchmarkRayQueries(const std::string& filename, uint32_t width, uint32_t height, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	width	= std::max(width, 1u);
+	height	= std::max(height, 1u);
+
+	SceneData scene_data;
+	Scene::ImportGltf(filename, true, true, nullptr, scene_data);
+
+	std::vector<XMFLOAT3> positions;
+	for (size_t mesh = 0; mesh < scene_data.Primitives.size(); mesh++)
+	{
+		for (const auto& primitive : scene_data.Primitives[mesh])
+		{
+			Bvh::AppendTriangles(primitive, XMLoadFloat4x4(&scene_data.BaseTransforms[mesh]), positions);
+		}
+	}
+
+	std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(num_threads);
+
+	Bvh bvh;
+	bvh.Build(positions, thread_pool.get());
+
+	WideBvh wide_bvh;
+	wide_bvh.Build(bvh, CpuRayTracer::bvh_width_);
+
+	const uint32_t tile_size = CpuRayTracer::tile_size_;
+
+	std::vector<Bvh::Ray> primary_rays;
+	GetStartCameraRays(width, height, primary_rays);
+
+	std::vector<Bvh::Hit> primary_hits(primary_rays.size());
+	wide_bvh.Intersect(primary_rays.data(), primary_rays.size(), primary_hits.data(), WideBvh::QueryMode::Single, true);
+
+	// Secondary rays start slightly off the hit triangle, on the side of the camera.
+	const XMVECTOR light_direction = XMVector3Normalize(XMVectorSet(20.0f, 40.0f, 10.0f, 0.0f));
+
+	std::vector<Bvh::Ray> shadow_rays;
+	std::vector<Bvh::Ray> reflection_rays;
+
+	for (size_t i = 0; i < primary_rays.size(); i++)
+	{
+		Bvh::Ray ray;
+		XMVECTOR normal;
+
+		if (!GetBounceRay(primary_rays[i], primary_hits[i], positions, ray, normal))
+			continue;
+
+		const XMVECTOR direction = XMLoadFloat3(&primary_rays[i].Direction);
+
+		XMStoreFloat3(&ray.Direction, light_direction);
+		shadow_rays.push_back(ray);
+
+		XMStoreFloat3(&ray.Direction, XMVector3Normalize(XMVector3Reflect(direction, normal)));
+		reflection_rays.push_back(ray);
+	}
+
+	struct RaySet
+	{
+		const char*						Name;
+		const std::vector<Bvh::Ray>*	Rays;
+		bool							Occlusion;
+	};
+
+	const RaySet ray_sets[] =
+	{
+		{ "primary", &primary_rays, false },
+		{ "shadow", &shadow_rays, true },
+		{ "reflection", &reflection_rays, false },
+	};
+
+	const std::pair<const char*, WideBvh::QueryMode> modes[] =
+	{
+		{ "single", WideBvh::QueryMode::Single },
+		{ "packet8", WideBvh::QueryMode::Packet8 },
+		{ "packet16", WideBvh::QueryMode::Packet16 },
+		{ "stream", WideBvh::QueryMode::Stream },
+	};
+
+	std::vector<RayQueryResult> results;
+
+	for (const RaySet& ray_set : ray_sets)
+	{
+		const std::vector<Bvh::Ray>& rays = *ray_set.Rays;
+
+		std::vector<Bvh::Hit> reference_hits;
+		std::vector<uint8_t> reference_occluded;
+
+		for (const auto& mode : modes)
+		{
+			RayQueryResult result = {};
+			result.RaySet		= ray_set.Name;
+			result.Mode			= mode.first;
+			result.NumThreads	= num_threads;
+			result.NumRays		= rays.size();
+
+			std::vector<Bvh::Hit> hits(rays.size());
+			std::vector<uint8_t> occluded(rays.size());
+
+			// Batches of a tile, like CpuRayTracer::Render.
+			auto trace = [&](size_t begin, size_t end)
+			{
+				if (ray_set.Occlusion)
+				{
+					wide_bvh.Occluded(rays.data() + begin, end - begin, occluded.data() + begin, mode.second);
+				}
+				else
+				{
+					wide_bvh.Intersect(rays.data() + begin, end - begin, hits.data() + begin, mode.second, true);
+				}
+			};
+
+			HighResolutionClock clock;
+
+			if (thread_pool)
+			{
+				thread_pool->ParallelForRange(rays.size(), tile_size * tile_size, trace);
+			}
+			else
+			{
+				for (size_t begin = 0; begin < rays.size(); begin += tile_size * tile_size)
+				{
+					trace(begin, std::min<size_t>(begin + tile_size * tile_size, rays.size()));
+				}
+			}
+
+			clock.Tick();
+			result.RaysPerSecond = rays.size() * 1000.0 / std::max(clock.GetDeltaMilliseconds(), 1e-6);
+
+			if (mode.second == WideBvh::QueryMode::Single)
+			{
+				reference_hits = std::move(hits);
+				reference_occluded = std::move(occluded);
+			}
+			else
+			{
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					const bool reference_is_hit = reference_hits[i].Triangle != Bvh::no_hit_;
+					const bool is_hit = hits[i].Triangle != Bvh::no_hit_;
+
+					if (ray_set.Occlusion ? occluded[i] != reference_occluded[i] : is_hit != reference_is_hit || (is_hit && hits[i].T != reference_hits[i].T))
+					{
+						result.Mismatches++;
+					}
+				}
+			}
+
+			Report("Ray queries %s, %s rays, %s: %llu rays, %u threads: %.2f Mrays/s, %llu mismatches\n",
+				filename.c_str(), result.RaySet, result.Mode, result.NumRays, result.NumThreads, result.RaysPerSecond / 1000000.0, result.Mismatches);
+
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
+
+std::vector<Benchmarks::RaySortingResult> Benchmarks::BenchmarkRaySorting(const std::string& filename, uint32_t width, uint32_t height, uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	width	= std::max(width, 1u);
+	height	= std::max(height, 1u);
+
+	SceneData scene_data;
+	Scene::ImportGltf(filename, true, true, nullptr, scene_data);
+
+	std::vector<XMFLOAT3> positions;
+	for (size_t mesh = 0; mesh < scene_data.Primitives.size(); mesh++)
+	{
+		for (const auto& primitive : scene_data.Primitives[mesh])
+		{
+			Bvh::AppendTriangles(primitive, XMLoadFloat4x4(&scene_data.BaseTransforms[mesh]), positions);
+		}
+	}
+
+	std::unique_ptr<ThreadPool> thread_pool = CreateThreadPool(num_threads);
+
+	Bvh bvh;
+	bvh.Build(positions, thread_pool.get());
+
+	WideBvh wide_bvh;
+	wide_bvh.Build(bvh, CpuRayTracer::bvh_width_);
+
+	// Origins are sorted within the bounds of the scene, like CpuRayTracer::Render.
+	const Bvh::Node root = bvh.GetNodes().empty() ? Bvh::Node() : bvh.GetNodes()[0];
+
+	std::vector<Bvh::Ray> primary_rays;
+	GetStartCameraRays(width, height, primary_rays);
+
+	std::vector<Bvh::Hit> primary_hits(primary_rays.size());
+	wide_bvh.Intersect(primary_rays.data(), primary_rays.size(), primary_hits.data(), WideBvh::QueryMode::Single, true);
+
+	// Mirror reflections of the primary hits, and reflections about randomly tilted normals like rough surfaces would
+	// scatter them, for two bounces. Every set is in the order of the pixels it came from, like the waves of Render.
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> tilt(-0.5f, 0.5f);
+
+	auto bounce = [&](const std::vector<Bvh::Ray>& rays, const std::vector<Bvh::Hit>& hits, bool rough, std::vector<Bvh::Ray>& bounce_rays)
+	{
+		bounce_rays.clear();
+
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			Bvh::Ray ray;
+			XMVECTOR normal;
+
+			if (!GetBounceRay(rays[i], hits[i], positions, ray, normal))
+				continue;
+
+			XMVECTOR reflection_normal = normal;
+			if (rough)
+			{
+				reflection_normal = XMVector3Normalize(normal + XMVectorSet(tilt(random), tilt(random), tilt(random), 0.0f));
+			}
+
+			// Tilted normals can reflect into the surface, those rays are mirrored back out.
+			XMVECTOR direction = XMVector3Reflect(XMLoadFloat3(&rays[i].Direction), reflection_normal);
+			if (XMVectorGetX(XMVector3Dot(direction, normal)) < 0.0f)
+			{
+				direction = XMVector3Reflect(direction, normal);
+			}
+
+			XMStoreFloat3(&ray.Direction, XMVector3Normalize(direction));
+			bounce_rays.push_back(ray);
+		}
+	};
+
+	std::vector<Bvh::Ray> mirror_rays;
+	std::vector<Bvh::Ray> rough_rays;
+	std::vector<Bvh::Ray> rough_bounce_rays;
+
+	bounce(primary_rays, primary_hits, false, mirror_rays);
+	bounce(primary_rays, primary_hits, true, rough_rays);
+
+	std::vector<Bvh::Hit> rough_hits(rough_rays.size());
+	wide_bvh.Intersect(rough_rays.data(), rough_rays.size(), rough_hits.data(), WideBvh::QueryMode::Single, true);
+
+	bounce(rough_rays, rough_hits, true, rough_bounce_rays);
+
+	const std::pair<const char*, const std::vector<Bvh::Ray>*> ray_sets[] =
+	{
+		{ "mirror", &mirror_rays },
+		{ "rough", &rough_rays },
+		{ "rough second bounce", &rough_bounce_rays },
+	};
+
+	const std::pair<const char*, WideBvh::QueryMode> modes[] =
+	{
+		{ "single", WideBvh::QueryMode::Single },
+		{ "packet8", WideBvh::QueryMode::Packet8 },
+		{ "packet16", WideBvh::QueryMode::Packet16 },
+		{ "stream", WideBvh::QueryMode::Stream },
+	};
+
+	const size_t batch_size = CpuRayTracer::reflection_batch_size_;
+
+	std::vector<RaySortingResult> results;
+	RaySorter sorter;
+
+	for (const auto& ray_set : ray_sets)
+	{
+		const std::vector<Bvh::Ray>& rays = *ray_set.second;
+
+		std::vector<Bvh::Ray> sorted_rays(rays.size());
+		std::vector<Bvh::Hit> sorted_hits(rays.size());
+
+		for (const auto& mode : modes)
+		{
+			std::vector<Bvh::Hit> unsorted_hits;
+
+			for (int sorted = 0; sorted < 2; sorted++)
+			{
+				RaySortingResult result = {};
+				result.RaySet		= ray_set.first;
+				result.Mode			= mode.first;
+				result.Sorted		= sorted != 0;
+				result.NumThreads	= num_threads;
+				result.NumRays		= rays.size();
+
+				std::vector<Bvh::Hit> hits(rays.size());
+
+				const Bvh::Ray* traced_rays = sorted ? sorted_rays.data() : rays.data();
+				Bvh::Hit* traced_hits = sorted ? sorted_hits.data() : hits.data();
+
+				// Cycles of all threads of the process, Windows does not count cache misses for applications.
+				ULONG64 cycles_begin = 0;
+				QueryProcessCycleTime(GetCurrentProcess(), &cycles_begin);
+
+				HighResolutionClock clock;
+
+				if (sorted)
+				{
+					sorter.Sort(rays.data(), rays.size(), root.BoundsMin, root.BoundsMax);
+					sorter.Gather(rays.data(), sorted_rays.data());
+
+					clock.Tick();
+					result.SortMilliseconds = clock.GetDeltaMilliseconds();
+				}
+
+				auto trace = [&](size_t begin, size_t end)
+				{
+					wide_bvh.Intersect(traced_rays + begin, end - begin, traced_hits + begin, mode.second, true);
+				};
+
+				if (thread_pool)
+				{
+					thread_pool->ParallelForRange(rays.size(), batch_size, trace);
+				}
+				else
+				{
+					for (size_t begin = 0; begin < rays.size(); begin += batch_size)
+					{
+						trace(begin, std::min(begin + batch_size, rays.size()));
+					}
+				}
+
+				if (sorted)
+				{
+					sorter.Scatter(sorted_hits.data(), hits.data());
+				}
+
+				clock.Tick();
+
+				ULONG64 cycles_end = 0;
+				QueryProcessCycleTime(GetCurrentProcess(), &cycles_end);
+
+				const double milliseconds = result.SortMilliseconds + clock.GetDeltaMilliseconds();
+				result.RaysPerSecond = rays.size() * 1000.0 / std::max(milliseconds, 1e-6);
+				result.CyclesPerRay = static_cast<double>(cycles_end - cycles_begin) / std::max<size_t>(rays.size(), 1);
+
+				if (!sorted)
+				{
+					unsorted_hits = std::move(hits);
+				}
+				else
+				{
+					for (size_t i = 0; i < rays.size(); i++)
+					{
+						const bool is_hit = hits[i].Triangle != Bvh::no_hit_;
+
+						if (is_hit != (unsorted_hits[i].Triangle != Bvh::no_hit_) || (is_hit && hits[i].T != unsorted_hits[i].T))
+						{
+							result.Mismatches++;
+						}
+					}
+				}
+
+				Report("Ray sorting %s, %s rays, %s, %s: %llu rays, %u threads: sort %.2f ms, %.2f Mrays/s, %.0f cycles/ray, %llu mismatches\n",
+					filename.c_str(), result.RaySet, result.Mode, result.Sorted ? "sorted" : "unsorted", result.NumRays, result.NumThreads, result.SortMilliseconds,
+					result.RaysPerSecond / 1000000.0, result.CyclesPerRay, result.Mismatches);
+
+				results.push_back(result);
+			}
+		}
+	}
+
+	return results;
+}
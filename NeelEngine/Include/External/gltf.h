@@ -18,6 +18,22 @@
 #include <string_view>
 #endif
 
+// Vectorized base64 decoding on x86, define FX_GLTF_NO_SIMD to only use the scalar decoder.
+// FX_GLTF_BASE64_SIMD stays defined for code that calls the decoders in fx::base64::detail directly.
+#if !defined(FX_GLTF_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define FX_GLTF_BASE64_SIMD
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define FX_GLTF_TARGET_SSE41
+#define FX_GLTF_TARGET_AVX2
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define FX_GLTF_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define FX_GLTF_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 namespace fx
 {
 	namespace base64
@@ -94,10 +110,171 @@ namespace fx
 			return out;
 		}
 
+		namespace detail
+		{
+			// Decodes length characters (a multiple of 4) that end the input, so padding is only accepted at the end.
+			inline bool DecodeScalar(char const* in, std::size_t length, uint8_t* out, std::size_t& outLength)
+			{
+				uint32_t value = 0;
+				int32_t bitCount = -8;
+				for (std::size_t i = 0; i < length; i++)
+				{
+					const uint8_t c = static_cast<uint8_t>(in[i]);
+					const char map = DecodeMap[c];
+					if (map == -1)
+					{
+						if (c != '=') // Non base64 character
+						{
+							return false;
+						}
+
+						// Padding characters not where they should be
+						const std::size_t remaining = length - i - 1;
+						return !(remaining > 1 || (remaining == 1 ? in[i + 1] != '=' : false));
+					}
+
+					value = (value << 6u) + map;
+					bitCount += 6;
+					if (bitCount >= 0)
+					{
+						const uint32_t shiftOperand = bitCount;
+						out[outLength++] = static_cast<uint8_t>(value >> shiftOperand);
+						bitCount -= 8;
+					}
+				}
+
+				return true;
+			}
+
+#if defined(FX_GLTF_BASE64_SIMD)
+			// Bytes the vectorized decoders may write past the decoded data.
+			constexpr std::size_t SimdOutputPadding = 8;
+
+			enum class DecodeIsa
+			{
+				Scalar,
+				SSE41,
+				AVX2
+			};
+
+			inline DecodeIsa DetectDecodeIsa() noexcept
+			{
+#if defined(_MSC_VER) && !defined(__clang__)
+				int info[4]{};
+				__cpuid(info, 0);
+				const int maxLeaf = info[0];
+
+				__cpuid(info, 1);
+				const bool sse41 = (info[2] & (1 << 19)) != 0;
+				const bool osxsave = (info[2] & (1 << 27)) != 0;
+				const bool avx = (info[2] & (1 << 28)) != 0;
+
+				bool avx2 = false;
+				if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+				{
+					__cpuidex(info, 7, 0);
+					avx2 = (info[1] & (1 << 5)) != 0;
+				}
+#else
+				__builtin_cpu_init();
+				const bool sse41 = __builtin_cpu_supports("sse4.1");
+				const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+				return avx2 ? DecodeIsa::AVX2 : (sse41 ? DecodeIsa::SSE41 : DecodeIsa::Scalar);
+			}
+
+			inline DecodeIsa GetDecodeIsa() noexcept
+			{
+				static const DecodeIsa isa = DetectDecodeIsa();
+				return isa;
+			}
+
+			// Decodes blocks of 16 characters until the input ends or a block contains a character that is
+			// not in the base64 alphabet (including padding). Returns the number of characters consumed,
+			// every 16 characters produce 12 bytes. See http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+			FX_GLTF_TARGET_SSE41 inline std::size_t DecodeSSE41(char const* in, std::size_t length, uint8_t* out)
+			{
+				const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+				const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+				const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+				const __m128i packBytes = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+				const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+				const __m128i slash = _mm_set1_epi8(0x2F);
+
+				std::size_t i = 0;
+				for (; i + 16 <= length; i += 16)
+				{
+					const __m128i input = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i));
+
+					const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(input, 4), nibbleMask);
+					const __m128i loNibbles = _mm_and_si128(input, nibbleMask);
+					if (!_mm_testz_si128(_mm_shuffle_epi8(lutLo, loNibbles), _mm_shuffle_epi8(lutHi, hiNibbles)))
+					{
+						break;
+					}
+
+					const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(input, slash), hiNibbles));
+					const __m128i sextets = _mm_add_epi8(input, roll);
+
+					const __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+					const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out + (i / 4) * 3), _mm_shuffle_epi8(words, packBytes));
+				}
+
+				return i;
+			}
+
+			// Same as DecodeSSE41 for blocks of 32 characters.
+			FX_GLTF_TARGET_AVX2 inline std::size_t DecodeAVX2(char const* in, std::size_t length, uint8_t* out)
+			{
+				const __m256i lutLo = _mm256_setr_epi8(
+					0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+					0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+				const __m256i lutHi = _mm256_setr_epi8(
+					0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+					0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+				const __m256i lutRoll = _mm256_setr_epi8(
+					0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+					0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+				const __m256i packBytes = _mm256_setr_epi8(
+					2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+					2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+				const __m256i packLanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+				const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+				const __m256i slash = _mm256_set1_epi8(0x2F);
+
+				std::size_t i = 0;
+				for (; i + 32 <= length; i += 32)
+				{
+					const __m256i input = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(in + i));
+
+					const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(input, 4), nibbleMask);
+					const __m256i loNibbles = _mm256_and_si256(input, nibbleMask);
+					if (!_mm256_testz_si256(_mm256_shuffle_epi8(lutLo, loNibbles), _mm256_shuffle_epi8(lutHi, hiNibbles)))
+					{
+						break;
+					}
+
+					const __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(input, slash), hiNibbles));
+					const __m256i sextets = _mm256_add_epi8(input, roll);
+
+					const __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+					const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+					const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, packBytes), packLanes);
+
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (i / 4) * 3), packed);
+				}
+
+				return i;
+			}
+#endif
+		} // namespace detail
+
 #if defined(FX_GLTF_HAS_CPP_17)
-    inline bool TryDecode(std::string_view in, std::vector<uint8_t> & out)
+    inline bool TryDecodeScalar(std::string_view in, std::vector<uint8_t> & out)
 #else
-		inline bool TryDecode(std::string const& in, std::vector<uint8_t>& out)
+		inline bool TryDecodeScalar(std::string const& in, std::vector<uint8_t>& out)
 #endif
 		{
 			out.clear();
@@ -113,50 +290,79 @@ namespace fx
 				return false;
 			}
 
-			out.reserve((length / 4) * 3);
+			out.resize((length / 4) * 3);
 
-			bool invalid = false;
-			uint32_t value = 0;
-			int32_t bitCount = -8;
-			for (std::size_t i = 0; i < length; i++)
+			std::size_t outLength = 0;
+			if (!detail::DecodeScalar(in.data(), length, out.data(), outLength))
+			{
+				out.clear();
+				return false;
+			}
+
+			out.resize(outLength);
+			return true;
+		}
+
+#if defined(FX_GLTF_BASE64_SIMD)
+		namespace detail
+		{
+			// Decodes with the vectorized decoder for isa and finishes the input with the scalar decoder.
+#if defined(FX_GLTF_HAS_CPP_17)
+			inline bool TryDecodeWith(DecodeIsa isa, std::string_view in, std::vector<uint8_t> & out)
+#else
+			inline bool TryDecodeWith(DecodeIsa isa, std::string const& in, std::vector<uint8_t>& out)
+#endif
 			{
-				const uint8_t c = static_cast<uint8_t>(in[i]);
-				const char map = detail::DecodeMap.at(c);
-				if (map == -1)
+				if (isa == DecodeIsa::Scalar)
 				{
-					if (c != '=') // Non base64 character
-					{
-						invalid = true;
-					}
-					else
-					{
-						// Padding characters not where they should be
-						const std::size_t remaining = length - i - 1;
-						if (remaining > 1 || (remaining == 1 ? in[i + 1] != '=' : false))
-						{
-							invalid = true;
-						}
-					}
+					return TryDecodeScalar(in, out);
+				}
 
-					break;
+				out.clear();
+
+				const std::size_t length = in.length();
+				if (length == 0)
+				{
+					return true;
 				}
 
-				value = (value << 6u) + map;
-				bitCount += 6;
-				if (bitCount >= 0)
+				if (length % 4 != 0)
 				{
-					const uint32_t shiftOperand = bitCount;
-					out.push_back(static_cast<uint8_t>(value >> shiftOperand));
-					bitCount -= 8;
+					return false;
 				}
-			}
 
-			if (invalid)
-			{
-				out.clear();
+				out.resize((length / 4) * 3 + SimdOutputPadding);
+
+				// Blocks with padding or invalid characters are left to the scalar decoder, which reports the error.
+				const std::size_t consumed = isa == DecodeIsa::AVX2
+					                             ? DecodeAVX2(in.data(), length, out.data())
+					                             : DecodeSSE41(in.data(), length, out.data());
+
+				std::size_t outLength = (consumed / 4) * 3;
+				if (!DecodeScalar(in.data() + consumed, length - consumed, out.data(), outLength))
+				{
+					out.clear();
+					return false;
+				}
+
+				out.resize(outLength);
+				return true;
 			}
+		} // namespace detail
+#endif
 
-			return !invalid;
+		// Uses the widest vectorized decoder the CPU supports and finishes the input with the scalar decoder.
+#if defined(FX_GLTF_HAS_CPP_17)
+    inline bool TryDecode(std::string_view in, std::vector<uint8_t> & out)
+#else
+		inline bool TryDecode(std::string const& in, std::vector<uint8_t>& out)
+#endif
+		{
+#if defined(FX_GLTF_BASE64_SIMD)
+			return detail::TryDecodeWith(detail::GetDecodeIsa(), in, out);
+#else
+			return TryDecodeScalar(in, out);
+#endif
 		}
 	} // namespace base64
 
@@ -1950,3 +2156,5 @@ namespace fx
 } // namespace fx
 
 #undef FX_GLTF_HAS_CPP_17
+#undef FX_GLTF_TARGET_SSE41
+#undef FX_GLTF_TARGET_AVX2
@@ -11,7 +11,15 @@ public:
 	// Inherited from Buffer
 	virtual void CreateViews(size_t num_elements, size_t element_size) override;
 
-	void CreateViews(uint32_t num_elements, uint32_t total_size, DXGI_FORMAT format);
+	/**
+	 * Create the view for indices that start buffer_offset bytes into the resource (which may be shared with other index buffers).
+	 */
+	void CreateViews(uint32_t num_elements, uint32_t total_size, DXGI_FORMAT format, uint64_t buffer_offset = 0);
+
+	/**
+	 * Point the view at another resource that holds the same data at the same offset (e.g. a shared buffer that has grown).
+	 */
+	void MoveViews(Microsoft::WRL::ComPtr<ID3D12Resource> d3d12_resource);
 
 	size_t GetNumIndicies() const
 	{
@@ -23,6 +31,14 @@ public:
 		return index_format_;
 	}
 
+	/**
+	 * Start of the index data within the resource.
+	 */
+	uint64_t GetBufferOffset() const
+	{
+		return buffer_offset_;
+	}
+
 	/**
 	 * Get the index buffer view for biding to the Input Assembler stage.
 	 */
@@ -48,6 +64,7 @@ protected:
 private:
 	size_t num_indicies_;
 	DXGI_FORMAT index_format_;
+	uint64_t buffer_offset_;
 
 	D3D12_INDEX_BUFFER_VIEW index_buffer_view_;
 };
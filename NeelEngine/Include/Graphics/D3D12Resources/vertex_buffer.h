@@ -12,7 +12,16 @@ public:
 
 	void CreateViews(size_t num_elements, size_t element_size) override;
 
-	void CreateViews(std::array<size_t, 4> num_elements, std::array<size_t, 4> element_size);
+	/**
+	 * Create a view per vertex stream. The streams are stored back to back in slot order,
+	 * starting buffer_offset bytes into the resource (which may be shared with other vertex buffers).
+	 */
+	void CreateViews(std::array<size_t, 4> num_elements, std::array<size_t, 4> element_size, uint64_t buffer_offset = 0);
+
+	/**
+	 * Point the views at another resource that holds the same data at the same offset (e.g. a shared buffer that has grown).
+	 */
+	void MoveViews(Microsoft::WRL::ComPtr<ID3D12Resource> d3d12_resource);
 
 	/**
 	 * Get the vertex buffer view for binding to the Input Assembler stage.
@@ -27,6 +36,19 @@ public:
 		return num_vertices_;
 	}
 
+	/**
+	 * Start and size of the vertex data within the resource.
+	 */
+	uint64_t GetBufferOffset() const
+	{
+		return gpu_offset_;
+	}
+
+	uint64_t GetSizeInBytes() const
+	{
+		return size_in_bytes_;
+	}
+
 
 	/**
 	* Get the SRV for a resource.
@@ -44,7 +66,8 @@ private:
 	uint32_t num_vertices_;
 	uint32_t vertex_stride_;
 
-	uint32_t gpu_offset_;
+	uint64_t gpu_offset_;
+	uint64_t size_in_bytes_;
 
 	std::array<D3D12_VERTEX_BUFFER_VIEW, 4> vertex_buffer_views_;
 };
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "memory_mapped_file.h"
+
+#include <gltf.h>
+
+/**
+* glTF 2.0 document together with the storage of its buffers.
+* When memory mapping is enabled the GLB binary chunk and external .bin files are mapped
+* instead of being read into fx::gltf::Buffer::data, and GetBufferData points straight
+* into the mapping. Embedded (base64) buffers are always decoded into memory.
+*
+* The same holds for images stored inside the document: images in a buffer view point into
+* the buffer data and data URI images are decoded into memory.
+*/
+class MappedDocument
+{
+public:
+	MappedDocument(const std::string& filename, bool memory_map = true);
+
+	MappedDocument(const MappedDocument&) = delete;
+	MappedDocument& operator=(const MappedDocument&) = delete;
+
+	const fx::gltf::Document& GetDocument() const { return document_; }
+
+	/**
+	* Start of the data of a buffer, valid for the lifetime of the document.
+	*/
+	const uint8_t* GetBufferData(uint32_t buffer_index) const { return buffer_data_[buffer_index]; }
+
+	const std::vector<const uint8_t*>& GetBufferData() const { return buffer_data_; }
+
+	/**
+	* Encoded (PNG, JPEG, ...) data of an image stored inside the document.
+	* @returns nullptr for images that reference an external file.
+	*/
+	const uint8_t* GetImageData(uint32_t image_index) const { return image_data_[image_index]; }
+	size_t GetImageSize(uint32_t image_index) const { return image_sizes_[image_index]; }
+
+	bool IsMemoryMapped() const { return !mapped_files_.empty(); }
+
+private:
+	void LoadMapped(const std::string& filename);
+	void LoadImages();
+
+	fx::gltf::Document				document_;
+	std::vector<MemoryMappedFile>	mapped_files_;
+	std::vector<const uint8_t*>		buffer_data_;
+
+	std::vector<const uint8_t*>		image_data_;
+	std::vector<size_t>				image_sizes_;
+	std::vector<std::vector<uint8_t>>	embedded_images_;
+};
@@ -11,7 +11,9 @@ public:
 		const fx::gltf::Accessor* Accessor;
 
 		uint8_t const* Data;
+		// Bytes between two elements, larger than ElementSize for strided buffer views.
 		uint32_t DataStride;
+		uint32_t ElementSize;
 		uint32_t TotalSize;
 
 		bool HasData() const noexcept
@@ -45,14 +47,34 @@ public:
 		return tex_coord0_buffer_;
 	}
 
+	const BufferInfo& Joints0Buffer() const noexcept
+	{
+		return joints0_buffer_;
+	}
+
+	const BufferInfo& Weights0Buffer() const noexcept
+	{
+		return weights0_buffer_;
+	}
+
 	const int& Material() const noexcept
 	{
 		return material_index_;
 	}
 
+	/**
+	* Location of the elements of an accessor.
+	* buffer_data holds the start of every document buffer (see MappedDocument), when omitted fx::gltf::Buffer::data is used.
+	*/
+	static BufferInfo GetData(fx::gltf::Document const& doc, fx::gltf::Accessor const& accessor, std::vector<const uint8_t*> const* buffer_data);
+
 protected:
 	MeshData() = delete;
-	MeshData(fx::gltf::Document const& doc, std::size_t mesh_index, std::size_t primitve_index);
+	/**
+	* buffer_data holds the start of every document buffer (see MappedDocument).
+	* When omitted the data of fx::gltf::Buffer::data is used.
+	*/
+	MeshData(fx::gltf::Document const& doc, std::size_t mesh_index, std::size_t primitve_index, std::vector<const uint8_t*> const* buffer_data = nullptr);
 	virtual ~MeshData();
 
 private:
@@ -61,9 +83,10 @@ private:
 	BufferInfo normal_buffer_{};
 	BufferInfo tangent_buffer_{};
 	BufferInfo tex_coord0_buffer_{};
+	BufferInfo joints0_buffer_{};
+	BufferInfo weights0_buffer_{};
 
 	int material_index_ = -1;
 
-	static BufferInfo GetData(fx::gltf::Document const& doc, fx::gltf::Accessor const& accessor);
 	static uint32_t CalculateDataTypeSize(fx::gltf::Accessor const& accessor) noexcept;
 };
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <gltf.h>
+
+/**
+* Streaming (SAX) parser for the JSON part of a glTF 2.0 document.
+*
+* Instead of building a DOM of the whole JSON text and converting it afterwards, the top level
+* arrays (accessors, bufferViews, nodes, meshes, ...) are converted one element at a time while
+* the text is being parsed. Only the JSON of a single element is alive at any point, so the peak
+* memory use no longer scales with the size of the document.
+*
+* Elements are converted with the from_json functions of fx-gltf, the resulting document is
+* identical to the one fx::gltf::LoadFromText produces (before any buffers are loaded). The parser
+* only depends on fx-gltf and builds without the engine's precompiled header, see NeelEngineTests.
+*/
+class SaxDocumentParser
+{
+public:
+	/**
+	* Parse the JSON text in [begin, end) into document. Throws fx::gltf::invalid_gltf_document on
+	* malformed JSON and the same exceptions as fx-gltf for an invalid document.
+	*/
+	static void Parse(const uint8_t* begin, const uint8_t* end, fx::gltf::Document& document);
+};
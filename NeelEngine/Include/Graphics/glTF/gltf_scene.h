@@ -1,9 +1,16 @@
 #pragma once
 
-#include "node.h"
 #include "mesh.h"
 #include "commandlist.h"
 #include "mesh_instance.h"
+#include "scene_data.h"
+#include "transform_hierarchy.h"
+#include "animation.h"
+#include "skinning.h"
+#include "texture_cache.h"
+#include "geometry_pool.h"
+
+class ThreadPool;
 
 class Scene
 {
@@ -14,6 +21,34 @@ public:
 	// Load glTF 2.0 scene from file.
 	void LoadFromFile(const std::string& filename, CommandList& command_list, bool load_basic_geometry = false);
 
+	/**
+	* Number of threads used to decode textures and pack vertex data during LoadFromFile.
+	* 0 uses all hardware threads, 1 imports serially on the calling thread.
+	*/
+	void SetImportThreadCount(uint32_t num_threads) { import_thread_count_ = num_threads; }
+
+	/**
+	* Memory map .glb and external .bin files instead of reading them into memory (default).
+	* Vertex and index data is then copied straight from the mapping into the upload heap.
+	*/
+	void SetMemoryMapBuffers(bool memory_map) { memory_map_buffers_ = memory_map; }
+
+	/**
+	* Load the cooked .neelscene next to the glTF file when it is up to date, and (re)write it
+	* after importing the glTF file when it is not (default).
+	*/
+	void SetUseSceneCache(bool use_scene_cache) { use_scene_cache_ = use_scene_cache; }
+
+	/**
+	* Quantize vertex data on import (see VertexQuantization): 20 instead of 48 bytes per vertex.
+	* Pipelines and acceleration structures have to use the formats that match GetQuantizeVertices.
+	*/
+	void SetQuantizeVertices(bool quantize_vertices) { quantize_vertices_ = quantize_vertices; }
+	bool GetQuantizeVertices() const { return quantize_vertices_; }
+
+	// Parse a glTF file into scene data. Only touches CPU memory, so it runs without a device.
+	static void ImportGltf(const std::string& filename, bool memory_map, bool quantize_vertices, ThreadPool* thread_pool, SceneData& scene_data);
+
 	void LoadBasicGeometry(CommandList& command_list);
 
 	std::vector<Mesh>& GetMeshes() { return meshes_; }
@@ -21,9 +56,39 @@ public:
 	std::vector<MeshMaterialData>& GetMaterialData() { return material_data_; }
 
 	std::vector<Texture>& GetTextures() { return textures_; }
+
+	const GeometryPool& GetGeometryPool() const { return geometry_pool_; }
 	
 	const std::vector<MeshInstance>& GetInstances() const { return mesh_instances_; }
 
+	/**
+	* Node transforms of the scene, instances are drawn with GetWorldMatrix(instance.NodeIndex).
+	* Changes to local transforms take effect after UpdateTransforms.
+	*/
+	TransformHierarchy& GetTransforms() { return transforms_; }
+	const TransformHierarchy& GetTransforms() const { return transforms_; }
+
+	// Recompute the world matrices of the nodes that changed, large hierarchies are updated on import_thread_count_ threads.
+	void UpdateTransforms();
+
+	std::vector<Animation>& GetAnimations() { return animations_; }
+
+	/**
+	* Sample all animations at a time in seconds, looping each over its duration, and write them into GetTransforms.
+	* @param slerp Interpolate rotations with slerp instead of normalized lerp.
+	*/
+	void Animate(float time, bool slerp = false);
+
+	// Skinned instances (MeshInstance::SkinnedIndex) of the scene, their streams are drawn after Skinning::Upload.
+	Skinning& GetSkinning() { return skinning_; }
+	const Skinning& GetSkinning() const { return skinning_; }
+
+	// Skin all skinned instances with the current world matrices, many vertices are skinned on import_thread_count_ threads.
+	void UpdateSkinning();
+
+	// Threads of the per frame updates, nullptr until an update was large enough to need them.
+	ThreadPool* GetUpdateThreadPool() const { return update_thread_pool_.get(); }
+
 	const bool BasicGeometryLoaded() const { return basic_geometry_loaded_; }
 	const int GetTotalMeshes() const { return total_number_meshes_; }
 
@@ -31,11 +96,22 @@ public:
 	std::unique_ptr<Mesh> SphereMesh;
 	std::unique_ptr<Mesh> ConeMesh;
 protected:
+	// Create the GPU resources for the scene data on the calling thread. Textures have to be decoded by texture_cache_ first.
+	void CreateResources(SceneData& scene_data, CommandList& command_list);
 
 	std::unique_ptr<Mesh> LoadBasicGeometry(std::string& filepath, CommandList& command_list);
+
+	// Upload the submeshes that were added to the geometry pool, moving the views of existing meshes when the pool has grown.
+	void UploadGeometry(CommandList& command_list);
 	
 	std::string name_;
 	std::vector<MeshInstance> mesh_instances_;
+	TransformHierarchy transforms_;
+	std::vector<Animation> animations_;
+	Skinning skinning_;
+
+	// Created for the first transform update, animation or skinning that is large enough to split.
+	std::unique_ptr<ThreadPool> update_thread_pool_;
 
 	/**
 	* Data extracted from the glTF 2.0 file
@@ -44,7 +120,18 @@ protected:
 	std::vector<Material> materials_;
 	std::vector<MeshMaterialData> material_data_;
 	std::vector<Texture> textures_;
+
+	// Vertex and index data of all submeshes, shared by rasterization and ray tracing.
+	GeometryPool geometry_pool_;
+
+	// Textures created by this scene, shared between materials and across loads.
+	TextureCache texture_cache_;
 	
 	int total_number_meshes_;
 	bool basic_geometry_loaded_;
+
+	uint32_t import_thread_count_;
+	bool memory_map_buffers_;
+	bool use_scene_cache_;
+	bool quantize_vertices_;
 };
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+* Decoder of the PNG and JPEG images that glTF files use, into 8 bit RGBA.
+*
+* PNG supports every color type at bit depths of 1 to 8, palettes, transparency (tRNS) and Adam7 interlacing, the
+* zlib stream is inflated with table driven Huffman decoding. JPEG supports baseline and extended sequential Huffman
+* coded images with 8 bit samples: grayscale or YCbCr (or RGB, see the Adobe marker) components, any sampling
+* factors and restart intervals. Chroma is upsampled by replication.
+*
+* Images the decoder does not handle, like 16 bit PNGs or progressive JPEGs, are left to another decoder: Decode
+* returns false for them. Corrupt data throws std::runtime_error.
+*
+* The decoder only depends on the standard library and builds without the engine's precompiled header, see
+* NeelEngineTests. CommandList::DecodeTextureFromMemory uses it before falling back to DirectXTex.
+*/
+class ImageDecoder
+{
+public:
+	enum class Format
+	{
+		Unknown,
+		Png,
+		Jpeg
+	};
+
+	struct Image
+	{
+		uint32_t				Width = 0;
+		uint32_t				Height = 0;
+		// Four bytes per pixel, rows from top to bottom without padding. Images without alpha are opaque.
+		std::vector<uint8_t>	Pixels;
+	};
+
+	// Images larger than this in either dimension are rejected as corrupt.
+	static const uint32_t max_dimension_ = 32768;
+
+	// Container of an encoded image, from its signature.
+	static Format GetFormat(const void* data, size_t size);
+
+	/**
+	* Decode a PNG or JPEG image.
+	* @returns false for other formats and for the variants of PNG and JPEG the decoder does not handle.
+	*/
+	static bool Decode(const void* data, size_t size, Image& image);
+
+	static bool DecodePng(const uint8_t* data, size_t size, Image& image);
+	static bool DecodeJpeg(const uint8_t* data, size_t size, Image& image);
+
+	/**
+	* Inflate a zlib stream (RFC 1950), the checksum is not verified.
+	* @param expected_size Size of the inflated data when known, to allocate the output once.
+	*/
+	static std::vector<uint8_t> Inflate(const uint8_t* data, size_t size, size_t expected_size = 0);
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include <gltf.h>
+
+class ThreadPool;
+class TransformHierarchy;
+
+/**
+* Keyframe animation of the local transforms in a TransformHierarchy (glTF animations).
+*
+* Key times are stored once per track and shared by all channels that use them, glTF exporters usually write one input
+* accessor for every channel of a clip. Sample looks up the key pair of every track once, starting at the key of the
+* previous sample, and then interpolates all channels. The values of a channel are consecutive aligned float4s, so a
+* channel reads two adjacent keys and interpolates all of their components with single vector operations.
+*/
+class Animation
+{
+	friend class SceneCache;
+public:
+	enum class Path : uint8_t
+	{
+		Translation,
+		Rotation,
+		Scale
+	};
+
+	enum class Interpolation : uint8_t
+	{
+		Step,
+		Linear,
+		CubicSpline		// Every key has an in tangent, a value and an out tangent.
+	};
+
+	// Key times of a track are times_[FirstTime, FirstTime + NumTimes).
+	struct Track
+	{
+		uint32_t	FirstTime;
+		uint32_t	NumTimes;
+	};
+
+	// Values of a channel start at values_[FirstValue].
+	struct Channel
+	{
+		uint32_t		Track;
+		uint32_t		Node;
+		uint32_t		FirstValue;
+		Path			Target;
+		Interpolation	Mode;
+		uint16_t		Padding;
+	};
+
+	// Channels are interpolated by one thread up to this many.
+	static const size_t parallel_grain_size_ = 1024;
+
+	Animation() = default;
+	explicit Animation(const std::string& name);
+
+	/**
+	* Load a glTF animation. Channels that animate morph target weights or nodes that are not in node_map are skipped.
+	* @param node_map TransformHierarchy node of every glTF node, UINT32_MAX for nodes that are not in the hierarchy.
+	* @param buffer_data Start of every document buffer (see MappedDocument), when omitted fx::gltf::Buffer::data is used.
+	*/
+	static Animation Load(const fx::gltf::Document& doc, size_t animation_index, const std::vector<uint32_t>& node_map,
+		const std::vector<const uint8_t*>* buffer_data = nullptr);
+
+	/**
+	* Add key times in ascending order.
+	* @returns Index of the track for AddChannel.
+	*/
+	uint32_t AddTrack(const float* times, size_t num_times);
+
+	/**
+	* Add a channel with a value for every key of the track, three values per key for cubic splines.
+	* Values have 3 floats for translations and scales and 4 (a quaternion) for rotations.
+	*/
+	void AddChannel(uint32_t track, uint32_t node, Path path, Interpolation interpolation, const float* values);
+
+	const std::string& GetName() const { return name_; }
+	size_t GetNumChannels() const { return channels_.size(); }
+
+	// Time of the last key.
+	float GetDuration() const { return duration_; }
+
+	/**
+	* Evaluate all channels at a time in seconds and write the results into the local transforms of their nodes.
+	* Times outside of the keys hold the first or last value.
+	* @param thread_pool Pool to interpolate many channels on, everything runs on the calling thread when omitted.
+	* @param slerp Interpolate linear rotations with slerp instead of normalized lerp.
+	*/
+	void Sample(float time, TransformHierarchy& transforms, ThreadPool* thread_pool = nullptr, bool slerp = false);
+
+private:
+	// Keys around the sampled time of a track.
+	struct TrackKey
+	{
+		uint32_t	Key;
+		uint32_t	Next;
+		float		T;
+		float		Duration;
+	};
+
+	void FindKeys(float time);
+
+	void InterpolateRange(size_t begin, size_t end, bool slerp);
+
+	std::string								name_;
+
+	std::vector<Track>						tracks_;
+	std::vector<Channel>					channels_;
+	std::vector<float>						times_;
+	std::vector<DirectX::XMFLOAT4A>			values_;
+
+	float									duration_ = 0.0f;
+
+	// Key lookup of the last sample, and the interpolated channels.
+	std::vector<TrackKey>					track_keys_;
+	std::vector<DirectX::XMFLOAT4A>			sampled_;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "mesh.h"
+
+class ThreadPool;
+
+/**
+* Bounding volume hierarchy over triangles for ray queries on the CPU.
+*
+* Build splits the triangles top down with the surface area heuristic (SAH): the centroids of the boxes of the
+* triangles of a node are sorted into num_bins_ bins along each axis, and the node is split at the bin boundary that
+* minimizes the area of each side times its number of triangles, until at most max_leaf_triangles_ are left. With a
+* thread pool the two halves of large nodes are built as separate tasks and the binning of very large nodes is split
+* over the threads. Nodes are renumbered depth first afterwards, so the hierarchy does not depend on the number of
+* threads.
+*
+* Nodes are 32 bytes and the two children of a node are next to each other, so a node only stores the index of its
+* first child. The triangles are copied in the order of the leaves, a leaf reads its vertices from one contiguous range.
+*
+* Intersect finds the closest hit, visiting the nearer child first, and Occluded stops at the first hit like
+* RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH. Triangles are front facing when their vertices are clockwise seen from the
+* ray origin, like triangles without D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE in DXR.
+*/
+class Bvh
+{
+public:
+	static const uint32_t max_leaf_triangles_	= 4;
+	static const uint32_t num_bins_				= 16;
+	// Nodes deeper than this are leaves whatever their size, it bounds the traversal stack.
+	static const uint32_t max_depth_			= 64;
+	static const uint32_t no_hit_				= 0xffffffff;
+
+	// Nodes with at least this many triangles build their children as separate tasks.
+	static const uint32_t parallel_task_triangles_		= 4096;
+	// Nodes with at least this many triangles are binned by several threads.
+	static const uint32_t parallel_binning_triangles_	= 262144;
+
+	struct Node
+	{
+		DirectX::XMFLOAT3	BoundsMin;
+		// Index of the first child of an inner node, or of the first triangle of a leaf.
+		uint32_t			FirstChildOrTriangle;
+		DirectX::XMFLOAT3	BoundsMax;
+		// 0 for inner nodes.
+		uint32_t			NumTriangles;
+	};
+
+	// Hits are accepted in [TMin, TMax], like RayDesc.
+	struct Ray
+	{
+		DirectX::XMFLOAT3	Origin;
+		float				TMin;
+		DirectX::XMFLOAT3	Direction;
+		float				TMax;
+	};
+
+	struct Hit
+	{
+		float		T;
+		// Barycentrics of the second and third vertex, like BuiltInTriangleIntersectionAttributes.
+		float		U;
+		float		V;
+		// Index of the triangle passed to Build, no_hit_ on a miss.
+		uint32_t	Triangle;
+	};
+
+	/**
+	* Append the triangles of the full resolution level of a submesh, transformed by transform, three vertices per
+	* triangle. Quantized positions are decoded. Primitives that are not indexed triangle lists add nothing.
+	* @param indices Receives the level 0 indices of the appended triangles when given.
+	* @return The number of appended triangles.
+	*/
+	static size_t XM_CALLCONV AppendTriangles(const Mesh::PrimitiveData& primitive, DirectX::FXMMATRIX transform, std::vector<DirectX::XMFLOAT3>& positions,
+		std::vector<uint32_t>* indices = nullptr);
+
+	/**
+	* Build the hierarchy over triangles.
+	* @param positions Three vertices per triangle.
+	* @param thread_pool Pool to build on, everything runs on the calling thread when omitted.
+	*/
+	void Build(const std::vector<DirectX::XMFLOAT3>& positions, ThreadPool* thread_pool = nullptr);
+
+	void Clear();
+
+	// Closest hit of a ray. Back facing triangles are skipped with cull_back_faces, like RAY_FLAG_CULL_BACK_FACING_TRIANGLES.
+	bool Intersect(const Ray& ray, Hit& hit, bool cull_back_faces = false) const;
+
+	// Whether any triangle is hit.
+	bool Occluded(const Ray& ray) const;
+
+	/**
+	* Intersect a ray with the triangle of three vertices, hits are accepted in [ray.TMin, t_max].
+	* @param t Distance of the hit, u and v its barycentrics like Hit.
+	*/
+	static bool IntersectTriangle(const DirectX::XMFLOAT3* vertices, const Ray& ray, bool cull_back_faces, float t_max, float& t, float& u, float& v);
+
+	/**
+	* Expected cost of a ray that hits the root: the surface area of every node relative to the root, plus the relative
+	* area of every leaf times its triangles. Visiting a node costs as much as intersecting a triangle.
+	*/
+	double GetSahCost() const;
+
+	size_t GetNumTriangles() const { return triangle_indices_.size(); }
+	const std::vector<Node>& GetNodes() const { return nodes_; }
+
+	// Vertices of the triangles in the order of the leaves, and the index passed to Build of each of them.
+	const std::vector<DirectX::XMFLOAT3>& GetPositions() const { return positions_; }
+	const std::vector<uint32_t>& GetTriangleIndices() const { return triangle_indices_; }
+
+private:
+	struct BuildState;
+
+	void XM_CALLCONV BuildNode(BuildState& state, uint32_t node_index, uint32_t first, uint32_t count, DirectX::FXMVECTOR centroid_min,
+		DirectX::FXMVECTOR centroid_max, uint32_t depth);
+
+	template <bool any_hit>
+	bool Traverse(const Ray& ray, Hit& hit, bool cull_back_faces) const;
+
+	std::vector<Node>				nodes_;
+	std::vector<DirectX::XMFLOAT3>	positions_;
+	std::vector<uint32_t>			triangle_indices_;
+};
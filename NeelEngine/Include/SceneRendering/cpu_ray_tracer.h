@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "bvh.h"
+#include "wide_bvh.h"
+#include "shader_data.h"
+
+struct SceneData;
+class ThreadPool;
+
+/**
+* Reference implementation of the raytraced pass of ReflectionsDemo (Raytracing.hlsl) on the CPU, without a device.
+*
+* Build gathers the triangles of every submesh the way the bottom level acceleration structure of the demo holds them:
+* one copy of every mesh, at full resolution, placed with its base transform. Their world space positions go into a
+* Bvh, which is collapsed into a WideBvh of bvh_width_ for the ray queries, and the materials and textures are kept
+* for shading. Textures are decoded once and sampled at full resolution
+* with bilinear filtering and wrapping, like SampleLevel(..., 0), albedo textures are sRGB.
+*
+* Render replaces the geometry pass by a primary ray per pixel, which samples the material like GeometryPass_PS into
+* the values of the geometry buffer, and then follows RaygenShader and ClosesthitShader: a shadow ray towards the first
+* directional light, and reflection rays that bounce off smooth surfaces up to SceneConstantBuffer::RayBounces times.
+* The result is the render target of the pass, shading in rgb and the shadow mask of the primary surface in w.
+*
+* The image is rendered in tiles of tile_size_ pixels, handed out to the threads of a pool. The primary rays of a tile
+* are traced as one batch, and so are its shadow rays, which all point towards the light. Reflection rays bounce off
+* in all directions, so they are traced in waves over the whole image afterwards: every wave holds one bounce of all
+* pixels that still reflect. The rays of a wave are sorted by a RaySorter, so rays that start close to each other in
+* the same direction are traced after each other, and their hits are put back in the order of the pixels for shading.
+*/
+class CpuRayTracer
+{
+public:
+	static const uint32_t tile_size_	= 16;
+	// Children per node of the hierarchy the rays are traced against, see Benchmarks::BenchmarkWideBvh in NeelBenchmarks.
+	static const uint32_t bvh_width_	= 4;
+	// How the primary and shadow rays of a tile are traced, see Benchmarks::BenchmarkRayQueries in NeelBenchmarks.
+	static const WideBvh::QueryMode query_mode_ = WideBvh::QueryMode::Packet16;
+	// Reflection rays traced by a task, see Benchmarks::BenchmarkRaySorting in NeelBenchmarks.
+	static const uint32_t reflection_batch_size_ = 1024;
+	// Single rays report the same triangle for ties in any order, so sorting does not change the image.
+	static const WideBvh::QueryMode reflection_query_mode_ = WideBvh::QueryMode::Single;
+
+	// Rays traced by a Render.
+	struct Stats
+	{
+		uint64_t	PrimaryRays		= 0;
+		uint64_t	ShadowRays		= 0;
+		uint64_t	ReflectionRays	= 0;
+
+		uint64_t GetNumRays() const { return PrimaryRays + ShadowRays + ReflectionRays; }
+	};
+
+	// Difference of two images, see CompareImages.
+	struct ImageDifference
+	{
+		float		MaxError;
+		double		MeanError;
+		// Pixels with a component that differs by more than the tolerance.
+		uint64_t	NumPixelsOff;
+	};
+
+	/**
+	* Gather the geometry and materials of a scene and decode its textures. The primitives of scene_data are only
+	* read during Build.
+	* @param thread_pool Pool to decode textures on, everything runs on the calling thread when omitted.
+	*/
+	void Build(const SceneData& scene_data, ThreadPool* thread_pool = nullptr);
+
+	void Clear();
+
+	/**
+	* Render the raytraced pass.
+	* @param image Resized to width * height pixels, rows from top to bottom.
+	* @param thread_pool Pool to render the tiles on, everything runs on the calling thread when omitted.
+	*/
+	Stats Render(const SceneConstantBuffer& scene_constants, const DirectionalLight& light, uint32_t width, uint32_t height,
+		std::vector<DirectX::XMFLOAT4>& image, ThreadPool* thread_pool = nullptr) const;
+
+	// Whether Render sorts the reflection rays of a wave before tracing them, on by default. The image is the same either way.
+	void SetSortReflectionRays(bool sort_reflection_rays) { sort_reflection_rays_ = sort_reflection_rays; }
+	bool GetSortReflectionRays() const { return sort_reflection_rays_; }
+
+	const Bvh& GetBvh() const { return bvh_; }
+	const WideBvh& GetWideBvh() const { return wide_bvh_; }
+	size_t GetNumTriangles() const { return bvh_.GetNumTriangles(); }
+
+	// Write an image as a DDS file with 32 bit float components, for golden images.
+	static void WriteImage(const std::string& filename, const std::vector<DirectX::XMFLOAT4>& image, uint32_t width, uint32_t height);
+
+	// Read an image of WriteImage. Returns false when the file does not exist.
+	static bool ReadImage(const std::string& filename, std::vector<DirectX::XMFLOAT4>& image, uint32_t& width, uint32_t& height);
+
+	// Per component difference of two images of the same size, std::invalid_argument otherwise.
+	static ImageDifference CompareImages(const std::vector<DirectX::XMFLOAT4>& a, const std::vector<DirectX::XMFLOAT4>& b, float tolerance);
+
+private:
+	// Texture decoded to 8 bits per component.
+	struct CpuTexture
+	{
+		uint32_t				Width	= 0;
+		uint32_t				Height	= 0;
+		bool					Srgb	= false;
+		std::vector<uint32_t>	Texels;
+	};
+
+	// A submesh in the acceleration structure.
+	struct Geometry
+	{
+		// Streams and indices of level 0 are copied, the scene data does not have to outlive the tracer.
+		std::vector<uint8_t>	Streams[4];
+		uint32_t				Strides[4];
+		std::vector<uint32_t>	Indices;
+
+		bool					Quantized;
+		DirectX::XMFLOAT3		PositionScale;
+		DirectX::XMFLOAT3		PositionOffset;
+		bool					HasTangents;
+		int						MaterialIndex;
+
+		// First triangle of the geometry in the input of the Bvh.
+		uint32_t				FirstTriangle;
+
+		DirectX::XMFLOAT4X4		ModelMatrix;
+		DirectX::XMFLOAT4X4		InverseTransposeModelMatrix;
+	};
+
+	// Interpolated vertex attributes of a hit in mesh space.
+	struct Surface
+	{
+		DirectX::XMFLOAT3	Normal;
+		DirectX::XMFLOAT4	Tangent;
+		DirectX::XMFLOAT2	TexCoord;
+		const Geometry*		Source;
+	};
+
+	// Values of the geometry buffer of a pixel.
+	struct GeometrySample
+	{
+		DirectX::XMFLOAT3	World;
+		DirectX::XMFLOAT3	Normal;
+		// Roughness and metalness.
+		DirectX::XMFLOAT2	MetalRough;
+	};
+
+	// Material of the closest hit of a reflection ray, like the values ClosesthitShader samples.
+	struct ReflectionSample
+	{
+		DirectX::XMFLOAT3	Position;
+		DirectX::XMFLOAT3	Normal;
+		// Direction of the reflection ray.
+		DirectX::XMFLOAT3	Direction;
+		// Base color with w = 0.
+		DirectX::XMFLOAT4	Diffuse;
+		float				Roughness;
+		float				Metallic;
+	};
+
+	Surface GetSurface(const Bvh::Hit& hit) const;
+
+	// Texel of a texture, fallback for materials without the texture.
+	DirectX::XMVECTOR XM_CALLCONV Sample(int texture_index, DirectX::FXMVECTOR fallback, float u, float v) const;
+
+	// Primary ray of GenerateCameraRay through the center of a pixel.
+	static Bvh::Ray GetPrimaryRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const SceneConstantBuffer& scene_constants);
+
+	// GeometryPass_PS at the closest hit of the primary ray of a pixel, the cleared geometry buffer on a miss.
+	GeometrySample ShadeGeometry(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const SceneConstantBuffer& scene_constants,
+		const Bvh::Ray& primary_ray, const Bvh::Hit& hit) const;
+
+	// Shadow ray of RaygenShader and ClosesthitShader from a surface towards the light.
+	static Bvh::Ray GetShadowRay(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& normal, const DirectionalLight& light);
+
+	// Reflection ray of RaygenShader, false when the surface of the pixel does not reflect.
+	static bool GetReflectionRay(const GeometrySample& sample, const SceneConstantBuffer& scene_constants, Bvh::Ray& reflection_ray);
+
+	// Material sampling of ClosesthitShader at the closest hit of a reflection ray.
+	ReflectionSample ShadeReflectionHit(const Bvh::Ray& ray, const Bvh::Hit& hit) const;
+
+	/**
+	* Lighting of ClosesthitShader once the shadow ray of the hit was traced, the color is written to pixel.
+	* @param bounce Bounces of the ray so far, including this hit.
+	* @return Whether the ray bounces on, next_ray is the reflection ray then.
+	*/
+	static bool ShadeReflection(const ReflectionSample& sample, bool shadowed, int bounce, const SceneConstantBuffer& scene_constants, const DirectionalLight& light,
+		DirectX::XMFLOAT4& pixel, Bvh::Ray& next_ray);
+
+	/**
+	* Trace reflection rays in waves until none bounces on.
+	* @param pixels, rays Pixel and reflection ray of every pixel that reflects, used for the waves.
+	*/
+	void TraceReflections(std::vector<uint32_t>& pixels, std::vector<Bvh::Ray>& rays, const SceneConstantBuffer& scene_constants,
+		const DirectionalLight& light, std::vector<DirectX::XMFLOAT4>& image, ThreadPool* thread_pool, Stats& stats) const;
+
+	Bvh								bvh_;
+	WideBvh							wide_bvh_;
+	std::vector<Geometry>			geometries_;
+	std::vector<MeshMaterialData>	materials_;
+	std::vector<CpuTexture>			textures_;
+
+	bool							sort_reflection_rays_ = true;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "mesh.h"
+
+class ThreadPool;
+
+/**
+* Culling of world space boxes against the six planes of a view frustum.
+*
+* Boxes are stored as structures of arrays, one array per component of their centers and extents, so Cull tests four
+* boxes against a plane with a few vector operations: a box is outside of a plane when the distance of its center is
+* less than minus the projection of its extents on the plane normal. Boxes that cross a corner of the frustum outside
+* of it can pass every plane, so a few invisible boxes are kept, visible boxes are never culled.
+*
+* AddBounds transforms the mesh space box of a submesh into the world space box around it, so every instance is tested
+* with its own transform.
+*/
+class FrustumCuller
+{
+public:
+	// Boxes are culled by one thread up to this many.
+	static const size_t parallel_grain_size_ = 16384;
+
+	/**
+	* Planes (a, b, c, d) of a view projection matrix with a depth range of [0, 1], normalized so a * x + b * y + c * z + d
+	* is the distance to the plane, positive inside. Order: left, right, bottom, top, near, far.
+	*/
+	static void XM_CALLCONV ExtractPlanes(DirectX::FXMMATRIX view_projection, DirectX::XMFLOAT4 planes[6]);
+
+	// Cull against the frustum of a view projection matrix.
+	void XM_CALLCONV SetFrustum(DirectX::FXMMATRIX view_projection);
+
+	// Cull against planes with normals that point inside, the planes are normalized.
+	void SetPlanes(const DirectX::XMFLOAT4 planes[6]);
+
+	void Clear();
+	void Reserve(size_t num_boxes);
+
+	/**
+	* Add a world space box.
+	* @returns Index of the box for IsVisible.
+	*/
+	uint32_t AddBox(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+
+	/**
+	* Add the world space box around mesh space bounds.
+	* @param model_matrix Transform from mesh space to world space.
+	* @returns Index of the box for IsVisible.
+	*/
+	uint32_t XM_CALLCONV AddBounds(DirectX::FXMMATRIX model_matrix, const Mesh::BoundingVolume& bounds);
+
+	/**
+	* Test all boxes against the planes.
+	* @param thread_pool Pool to cull many boxes on, everything runs on the calling thread when omitted.
+	* @returns Number of visible boxes.
+	*/
+	size_t Cull(ThreadPool* thread_pool = nullptr);
+
+	size_t GetNumBoxes() const { return num_boxes_; }
+
+	// Results of the last Cull.
+	bool IsVisible(uint32_t box) const { return visibility_[box] != 0; }
+
+	// Flag of every box, at least GetNumBoxes of them, 1 for visible boxes.
+	const std::vector<uint8_t>& GetVisibility() const { return visibility_; }
+
+private:
+	// Cull boxes [begin, end), begin is a multiple of 4.
+	void CullRange(size_t begin, size_t end);
+
+	DirectX::XMFLOAT4		planes_[6];
+
+	size_t					num_boxes_ = 0;
+
+	// Components of the box centers and extents, padded to a multiple of 4 boxes.
+	std::vector<float>		centers_[3];
+	std::vector<float>		extents_[3];
+
+	std::vector<uint8_t>	visibility_;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+* Plans where the vertex and index data of a batch of submeshes ends up on the GPU.
+*
+* Submeshes are suballocated from a small number of vertex and index buffers (a new buffer is
+* only started when the current one would exceed the maximum buffer size). The staging (upload)
+* memory mirrors the destination buffers: all vertex buffers back to back, followed by all index
+* buffers. Every destination buffer can therefore be filled with a single CopyBufferRegion.
+*
+* GeometryPool plans a single vertex and index buffer (its buffers grow instead), the layouts with
+* several buffers are measured against per submesh buffers by the geometry_layout benchmark.
+*
+* The planner only deals with sizes, offsets and CPU memory, it does not touch the device and builds
+* without the engine's precompiled header.
+*/
+class GeometryLayout
+{
+public:
+	static const size_t num_streams_ = 4;
+
+	struct SubMesh
+	{
+		// Vertex streams are stored back to back in slot order.
+		uint32_t							VertexBuffer;
+		uint64_t							VertexOffset;
+		uint64_t							VertexSize;
+		std::array<uint64_t, num_streams_>	StreamSizes;
+
+		uint32_t							IndexBuffer;
+		uint64_t							IndexOffset;
+		uint64_t							IndexSize;
+
+		// Source data, copied into the staging memory by WriteStaging.
+		std::array<const void*, num_streams_>	Streams;
+		const void*								Indices;
+	};
+
+	struct BufferRange
+	{
+		uint64_t Size;
+		// Start of the buffer in the staging memory.
+		uint64_t StagingOffset;
+	};
+
+	/**
+	* @param max_buffer_size Size at which a new destination buffer is started. Submeshes that are larger get a buffer of their own.
+	* @param alignment Alignment of the start of every submesh region within a buffer.
+	*/
+	explicit GeometryLayout(uint64_t max_buffer_size = 128ull * 1024 * 1024, uint64_t alignment = 16);
+
+	/**
+	* Add a submesh. Streams without data have a size of 0.
+	* @returns Index of the submesh in the layout.
+	*/
+	uint32_t AddSubMesh(const std::array<const void*, num_streams_>& streams, const std::array<uint64_t, num_streams_>& stream_sizes,
+		const void* indices, uint64_t index_size);
+
+	const SubMesh& GetSubMesh(uint32_t index) const { return sub_meshes_[index]; }
+	size_t GetNumSubMeshes() const { return sub_meshes_.size(); }
+
+	const std::vector<BufferRange>& GetVertexBuffers() const { return vertex_buffers_; }
+	const std::vector<BufferRange>& GetIndexBuffers() const { return index_buffers_; }
+
+	/**
+	* Total amount of staging memory needed to upload all buffers.
+	*/
+	uint64_t GetStagingSize() const;
+
+	/**
+	* Number of GPU allocations the upload needs: one per destination buffer plus the staging buffer.
+	*/
+	size_t GetNumAllocations() const;
+
+	/**
+	* Copy the source data of all submeshes into mapped staging memory of GetStagingSize() bytes.
+	*/
+	void WriteStaging(uint8_t* staging) const;
+
+	/**
+	* Copy the source data of the submeshes from first_sub_mesh on, for a layout with a single vertex and index buffer.
+	* vertex_data and index_data receive the buffer contents starting at the vertex and index offset of first_sub_mesh.
+	*/
+	void WriteStaging(uint32_t first_sub_mesh, uint8_t* vertex_data, uint8_t* index_data) const;
+
+private:
+	static void WriteSubMesh(const SubMesh& sub_mesh, uint8_t* vertex_data, uint8_t* index_data);
+
+	// Reserve size bytes in the last buffer of buffers, or start a new one. Returns the offset within the buffer.
+	uint64_t Allocate(std::vector<BufferRange>& buffers, uint64_t size, uint32_t& buffer_index);
+
+	void UpdateStagingOffsets();
+
+	uint64_t max_buffer_size_;
+	uint64_t alignment_;
+
+	std::vector<SubMesh>		sub_meshes_;
+	std::vector<BufferRange>	vertex_buffers_;
+	std::vector<BufferRange>	index_buffers_;
+};
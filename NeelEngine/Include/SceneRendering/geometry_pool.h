@@ -0,0 +1,69 @@
+#pragma once
+
+#include "byte_address_buffer.h"
+#include "geometry_layout.h"
+
+class CommandList;
+
+/**
+* Vertex and index data of a scene, stored once in a single vertex and a single index buffer.
+*
+* Every submesh is a region of the two buffers. The Input Assembler reads a region through the vertex
+* and index buffer views of the submesh, ray tracing shaders read the same region through the raw
+* buffers at the byte offsets returned by GetStreamOffset and GetIndexOffset.
+*
+* Submeshes can be added after an upload. The next upload grows the buffers (at least doubling them),
+* data that was uploaded before is copied on the GPU and keeps its offsets.
+*/
+class GeometryPool
+{
+public:
+	// Raw buffer loads need 4 byte aligned addresses, DXR vertex buffers need their components aligned.
+	static const uint64_t alignment_ = 16;
+
+	GeometryPool();
+	~GeometryPool();
+
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	/**
+	* Add a submesh. Its source data has to stay valid until the next Upload.
+	* @returns Index of the submesh in the pool.
+	*/
+	uint32_t AddSubMesh(const std::array<const void*, GeometryLayout::num_streams_>& streams, const std::array<uint64_t, GeometryLayout::num_streams_>& stream_sizes,
+		const void* indices, uint64_t index_size);
+
+	/**
+	* Upload the submeshes that were added since the last upload.
+	* @returns true when the buffers were recreated. The views of submeshes that were uploaded before then have to be moved to the new buffers.
+	*/
+	bool Upload(CommandList& command_list);
+
+	// Remove all submeshes and release the buffers.
+	void Reset();
+
+	const GeometryLayout::SubMesh& GetSubMesh(uint32_t index) const { return layout_.GetSubMesh(index); }
+	size_t GetNumSubMeshes() const { return layout_.GetNumSubMeshes(); }
+
+	// Byte offset of a vertex stream of a submesh in the vertex buffer.
+	uint64_t GetStreamOffset(uint32_t index, size_t slot) const;
+	// Byte offset of the indices of a submesh in the index buffer.
+	uint64_t GetIndexOffset(uint32_t index) const { return layout_.GetSubMesh(index).IndexOffset; }
+
+	// Bytes of vertex and index data in the pool, including alignment padding.
+	uint64_t GetVertexDataSize() const;
+	uint64_t GetIndexDataSize() const;
+
+	const ByteAddressBuffer& GetVertexBuffer() const { return vertex_buffer_; }
+	const ByteAddressBuffer& GetIndexBuffer() const { return index_buffer_; }
+
+private:
+	// Single buffer layout, never split into multiple buffers.
+	GeometryLayout layout_;
+
+	uint32_t num_uploaded_;
+
+	ByteAddressBuffer vertex_buffer_;
+	ByteAddressBuffer index_buffer_;
+};
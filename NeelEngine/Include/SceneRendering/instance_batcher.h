@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "shader_data.h"
+
+/**
+* Grouping of the draws of a frame into instanced draws.
+*
+* Every draw of a submesh at a level of detail references a transform. Build sorts the draws by mesh, submesh and level
+* with a single 64 bit key and merges the runs of equal keys into batches. The transforms of the draws of a batch are
+* copied next to each other into one array of InstanceData, so a batch is drawn with DrawIndexedInstanced and reads
+* its transforms at FirstInstance + SV_InstanceID from one structured buffer that is bound once per frame.
+*
+* Transforms are added once per instance and shared by all of its submeshes, the inverse transpose is only computed
+* there. Nothing touches the device, the batches can be built and inspected without a command list.
+*/
+class InstanceBatcher
+{
+public:
+	// Draws with the same mesh, submesh and level of detail.
+	struct Batch
+	{
+		uint32_t	Mesh;
+		uint32_t	SubMesh;
+		uint32_t	Lod;
+		// Range of GetInstanceData.
+		uint32_t	FirstInstance;
+		uint32_t	NumInstances;
+	};
+
+	// Largest indices that fit into the sort key.
+	static const uint32_t max_meshes_		= (1u << 24) - 1;
+	static const uint32_t max_sub_meshes_	= (1u << 24) - 1;
+	static const uint32_t max_lods_			= (1u << 16) - 1;
+
+	void Clear();
+
+	/**
+	* Add the transform of an instance.
+	* @param model_matrix Transform from mesh space to world space.
+	* @returns Index of the transform for AddDraw.
+	*/
+	uint32_t XM_CALLCONV AddTransform(DirectX::FXMMATRIX model_matrix);
+
+	// Draw a submesh at a level of detail with a transform of AddTransform.
+	void AddDraw(uint32_t mesh, uint32_t sub_mesh, uint32_t lod, uint32_t transform);
+
+	/**
+	* Sort the draws and build the batches and their instance data. Draws of a batch keep the order they were added in.
+	* @param visibility Flag of every draw in the order they were added, draws with a flag of 0 are left out. All draws
+	* are kept when omitted.
+	*/
+	void Build(const std::vector<uint8_t>* visibility = nullptr);
+
+	size_t GetNumDraws() const { return draws_.size(); }
+	size_t GetNumTransforms() const { return transforms_.size(); }
+
+	// Results of the last Build.
+	const std::vector<Batch>& GetBatches() const { return batches_; }
+	const std::vector<InstanceData>& GetInstanceData() const { return instance_data_; }
+
+private:
+	struct Draw
+	{
+		uint64_t	Key;
+		uint32_t	Transform;
+		uint32_t	Order;
+	};
+
+	std::vector<InstanceData>	transforms_;
+	std::vector<Draw>			draws_;
+
+	std::vector<Batch>			batches_;
+	std::vector<InstanceData>	instance_data_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "mesh.h"
+
+class Camera;
+
+/**
+* Selection of the levels of detail of a mesh (see MeshSimplifier) by their projected screen space error.
+*
+* An error e at distance d covers e * render_height / (2 * d * tan(fovy / 2)) pixels. The selector turns the largest
+* error in pixels that may be visible into the largest error in mesh units for the nearest point of a mesh's bounding
+* sphere, which is passed to Mesh::Render.
+*/
+class LodSelector
+{
+public:
+	/**
+	* @param fovy The vertical field of view in degrees.
+	* @param render_height Height of the render target in pixels.
+	* @param pixel_error Largest projected error in pixels.
+	*/
+	LodSelector(float fovy, float render_height, float pixel_error = 1.0f);
+
+	// Selector for the field of view of the camera.
+	LodSelector(const Camera& camera, float render_height, float pixel_error = 1.0f);
+
+	/**
+	* Largest error in mesh units that projects to at most pixel_error pixels anywhere on the bounding sphere.
+	* @param model_matrix Transform from mesh space to world space.
+	* @param bounding_sphere Mesh space bounding sphere, center in xyz and radius in w.
+	* @param eye World space position of the camera.
+	* @param near_clip Distances are clamped to the near clip, the camera can be inside the sphere.
+	*/
+	float XM_CALLCONV GetMaxError(DirectX::FXMMATRIX model_matrix, const DirectX::XMFLOAT4& bounding_sphere, DirectX::FXMVECTOR eye,
+		float near_clip = 0.1f) const;
+
+	// Largest error for the model matrix and bounding sphere of a mesh.
+	float XM_CALLCONV GetMaxError(const Mesh& mesh, DirectX::FXMVECTOR eye, float near_clip = 0.1f) const;
+
+	/**
+	* Triangles drawn for a submesh at max_error.
+	* @param lods Levels of the submesh, empty when all of its indices form a single level.
+	*/
+	static uint32_t GetTriangleCount(const std::vector<Mesh::LevelOfDetail>& lods, uint32_t index_count, float max_error);
+
+private:
+	// World space error that projects to pixel_error pixels at a distance of 1.
+	float error_per_distance_;
+};
@@ -4,16 +4,36 @@
 #include "commandlist.h"
 #include "texture.h"
 
-#include "gltf.h"
+#include "gltf_mapped_document.h"
+
+/**
+* Texture referenced by a material. Requests are collected while loading materials
+* so the image files can be decoded in parallel before the textures are created.
+*/
+struct TextureLoadRequest
+{
+	int				TextureIndex;
+	std::string		Filename;
+	TextureUsage	Usage;
+
+	// Encoded image for images stored inside the glTF file, Filename then only identifies the image.
+	const uint8_t*	Data = nullptr;
+	size_t			DataSize = 0;
+};
 
 class Material
 {
 	friend class Mesh;
 public:
 	Material();
+	explicit Material(const MeshMaterialData& material_data);
 	~Material();
 
-	void Load(const fx::gltf::Document& document, int material_index, CommandList& command_list, std::vector<Texture>& texture_store, const std::string& filename);
+	/**
+	* Read material properties from the document and append a request for every texture it uses.
+	* Only touches CPU memory.
+	*/
+	void Load(const MappedDocument& document, int material_index, const std::string& filename, std::vector<TextureLoadRequest>& texture_requests);
 
 	const MeshMaterialData& GetMaterialData() const { return material_data_; }
 	
@@ -21,5 +41,7 @@ protected:
 	// For Light source visualization.
 	void SetEmissive(DirectX::XMFLOAT3 color) { material_data_.EmissiveFactor = color; }	
 private:
+	static void AddTextureRequest(const MappedDocument& document, int texture_index, TextureUsage texture_usage, const std::string& filename, std::vector<TextureLoadRequest>& texture_requests);
+
 	MeshMaterialData	material_data_;
 };
\ No newline at end of file
@@ -5,11 +5,49 @@
 #include "DirectXMath.h"
 #include "commandlist.h"
 #include "material.h"
+#include "geometry_layout.h"
+#include "geometry_pool.h"
+#include "meshlet.h"
 
 #include "gltf.h"
 
+class Skinning;
+
 class Mesh
 {
+public:
+	/**
+	* A level of detail of a submesh: a range of its indices that references the same vertices as the full resolution
+	* level (see MeshSimplifier). Levels are sorted from fine to coarse, level 0 is the full resolution mesh.
+	*/
+	struct LevelOfDetail
+	{
+		uint32_t	FirstIndex;
+		uint32_t	IndexCount;
+		// Estimate of the distance between this level and the full resolution surface, in mesh units.
+		float		Error;
+	};
+
+	/**
+	* Joints that move a vertex of a skinned mesh (glTF JOINTS_0 and WEIGHTS_0). Joints index into the joints of the skin,
+	* the weights add up to 1.
+	*/
+	struct SkinVertex
+	{
+		uint16_t	Joints[4];
+		float		Weights[4];
+	};
+
+	/**
+	* Mesh space bounds of a submesh: an axis aligned box, and a sphere around the center of the box.
+	*/
+	struct BoundingVolume
+	{
+		DirectX::XMFLOAT3	Center;
+		DirectX::XMFLOAT3	Extents;	// Half the size of the box.
+		float				Radius;		// At most the length of Extents.
+	};
+
 private:
 	friend class Scene;
 
@@ -18,6 +56,11 @@ private:
 		SubMesh()
 			: IndexCount(0)
 			, Topology(D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
+			, Material(nullptr)
+			, MaterialCB{}
+			, HasTangents(false)
+			, GeometryIndex(invalid_geometry_index_)
+			, Bounds{}
 		{}
 
 		VertexBuffer			VBuffer;
@@ -29,36 +72,179 @@ private:
 		MaterialConstantBuffer	MaterialCB;
 
 		bool HasTangents;
+
+		// Index of the submesh in the scene's GeometryPool, invalid_geometry_index_ until Create places it in the pool.
+		uint32_t GeometryIndex;
+
+		// Clusters of the triangles for culling, empty for other topologies.
+		MeshletData Meshlets;
+
+		// At least one level, IndexCount is the index count of level 0.
+		std::vector<LevelOfDetail> Lods;
+
+		BoundingVolume Bounds;
 	};
 public:
+	/**
+	* A glTF primitive ready for upload. The position, normal, tangent and texcoord streams
+	* are uploaded back to back in slot order, followed by the indices. Streams and indices
+	* point into the document buffers (memory mapped when possible) or into Storage, so the
+	* source data is only touched once on its way to the upload heap.
+	*/
+	struct PrimitiveData
+	{
+		std::array<const uint8_t*, 4>	Streams{ nullptr, nullptr, nullptr, nullptr };
+		const uint8_t*					Indices = nullptr;
+
+		// Backing memory for streams that were converted or generated during import.
+		std::vector<uint8_t>			Storage;
+
+		std::array<size_t, 4>			NumElements{ 0, 0, 0, 0 };
+		std::array<size_t, 4>			ElementSize{ 0, 0, 0, 0 };
+
+		uint32_t						IndexCount = 0;
+		DXGI_FORMAT						IndexFormat = DXGI_FORMAT_R32_UINT;
+		D3D_PRIMITIVE_TOPOLOGY			Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+		int								MaterialIndex = -1;
+		bool							HasTangents = false;
+
+		// Streams use the quantized vertex format, positions are PositionOffset + PositionScale * position (see VertexQuantization).
+		bool							Quantized = false;
+		DirectX::XMFLOAT3				PositionScale{ 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT3				PositionOffset{ 0.0f, 0.0f, 0.0f };
+
+		// Built from the float positions before quantization (see MeshletBuilder). Only cover level 0.
+		MeshletData						Meshlets;
+
+		// Index ranges of the levels of detail (see MeshSimplifier), IndexCount covers all of them.
+		// Empty when all indices form a single level.
+		std::vector<LevelOfDetail>		Lods;
+
+		// Joint influences of every vertex, empty for rigid primitives. Only used by CPU skinning (see Skinning), not uploaded.
+		std::vector<SkinVertex>			Skin;
+
+		// Bounds of the positions in mesh space, see ComputeBounds.
+		BoundingVolume					Bounds{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 0.0f };
+
+		size_t StreamSize(size_t slot) const { return NumElements[slot] * ElementSize[slot]; }
+		size_t VertexDataSize() const { return StreamSize(0) + StreamSize(1) + StreamSize(2) + StreamSize(3); }
+		size_t IndexDataSize() const { return IndexCount * (IndexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4); }
+	};
+
 	Mesh();
 	~Mesh();
 
+	/**
+	* Resolve the vertex and index streams of a primitive without copying them.
+	* buffer_data holds the start of every document buffer (see MappedDocument), when omitted
+	* fx::gltf::Buffer::data is used. Does not touch the device, so it is safe to call from worker threads.
+	*/
+	static void PackPrimitive(const fx::gltf::Document& doc, std::size_t mesh_index, std::size_t primitive_index, PrimitiveData& primitive_data,
+		const std::vector<const uint8_t*>* buffer_data = nullptr);
+
 	void SetBaseTransform(const DirectX::XMMATRIX& base_transform);
 
 	void SetWorldMatrix(const DirectX::XMFLOAT3& translation, const float rotation_y, float scale);
 	void SetWorldMatrix(const DirectX::XMMATRIX& world_matrix);
 
-	void Render(CommandList& command_list);
+	/**
+	* Draw all submeshes.
+	* @param max_error Largest error in mesh units of the levels of detail that are drawn, see LodSelector.
+	*/
+	void Render(CommandList& command_list, float max_error = 0.0f);
+
+	/**
+	* Draw all submeshes with the positions and normals of a skinned instance, see Skinning::Upload.
+	* The model matrix has to be the world matrix of the node of the instance.
+	*/
+	void Render(CommandList& command_list, const Skinning& skinning, uint32_t skinned_instance, float max_error = 0.0f);
+
+	/**
+	* Draw instances of a submesh at a level of detail with one instanced draw.
+	* The instance data has to be bound to root parameter 2 (see InstanceBatcher), the draw reads
+	* [first_instance, first_instance + num_instances) of it.
+	*/
+	void RenderInstances(CommandList& command_list, size_t sub_mesh, size_t lod, uint32_t first_instance, uint32_t num_instances) const;
 
 	static const UINT vertex_slot_		= 0;
 	static const UINT normal_slot_		= 1;
 	static const UINT tangent_slot_		= 2;
 	static const UINT texcoord0_slot_	= 3;
 
+	static const uint32_t invalid_geometry_index_ = UINT32_MAX;
+
 	std::vector<SubMesh>& GetSubMeshes() { return sub_meshes_; }
 
 	const DirectX::XMMATRIX& GetBaseTransform() const { return base_transform_; }
 
+	// Transform from the stored (possibly quantized) positions to mesh space.
+	DirectX::XMMATRIX GetDequantizeTransform() const;
+
+	// Transform from mesh space to world space that Render draws with.
+	DirectX::XMMATRIX GetModelMatrix() const { return base_transform_ * world_matrix_; }
+
+	// Mesh space bounding sphere of all submeshes, center in xyz and radius in w.
+	const DirectX::XMFLOAT4& GetBoundingSphere() const { return bounding_sphere_; }
+
+	// Bounding sphere of the mesh space positions of packed primitives, center in xyz and radius in w.
+	static DirectX::XMFLOAT4 ComputeBoundingSphere(const std::vector<PrimitiveData>& primitives);
+
+	/**
+	* Bounds of the positions of a primitive. Float positions are visited once for the radius, and once more for the box
+	* unless its corners are passed in (the min and max of a glTF POSITION accessor). Quantized positions are bounded by
+	* their quantization range.
+	*/
+	static BoundingVolume ComputeBounds(const PrimitiveData& primitive, const float* position_min = nullptr, const float* position_max = nullptr);
+
+	// Mesh space bounds of a submesh.
+	const BoundingVolume& GetSubMeshBounds(size_t sub_mesh) const { return sub_meshes_[sub_mesh].Bounds; }
+
+	/**
+	* Coarsest level whose error does not exceed max_error.
+	* @param lods Levels of a submesh sorted from fine to coarse, must not be empty.
+	*/
+	static const LevelOfDetail& SelectLod(const std::vector<LevelOfDetail>& lods, float max_error);
+
+	// Index of the level SelectLod returns.
+	static size_t SelectLodIndex(const std::vector<LevelOfDetail>& lods, float max_error);
+
 	void SetEmissive(DirectX::XMFLOAT3 color);
 
 protected:
-	void Load(const fx::gltf::Document& doc, std::size_t mesh_index, CommandList& command_list, std::vector<Material>* scene_materials = nullptr);
+	/**
+	* Add the primitives to the geometry pool of a scene.
+	* @returns Index of the first primitive in the pool.
+	*/
+	static uint32_t AddToPool(const std::vector<PrimitiveData>& primitives, GeometryPool& pool);
+
+	/**
+	* Create the submeshes for primitives that were added to a pool with AddToPool and uploaded with GeometryPool::Upload.
+	*/
+	void Create(const std::string& name, const std::vector<PrimitiveData>& primitives, const GeometryPool& pool, uint32_t first_sub_mesh,
+		std::vector<Material>* scene_materials = nullptr);
+
+	// Move the views of the pooled submeshes to the current buffers of the pool, after an upload recreated them.
+	void MoveGeometry(const GeometryPool& pool);
 
 	void Unload();
 private:
+	// Take the vertex format of the primitives the submeshes are created from.
+	void SetVertexFormat(const std::vector<PrimitiveData>& primitives);
+
+	// Set the view projection matrix of the constant data for the current camera and bind it.
+	void SetConstantData(CommandList& command_list, MeshConstantData& constant_data) const;
+
+	// Bind the model matrix as the only instance of the following draws.
+	void SetInstanceData(CommandList& command_list) const;
+
+	// Draw instances of a level of a submesh whose vertex buffers are bound.
+	void DrawSubMesh(CommandList& command_list, const SubMesh& submesh, size_t lod, uint32_t num_instances) const;
+
 	DirectX::XMMATRIX	base_transform_;
 	std::string			name_;
+
+	DirectX::XMFLOAT4	bounding_sphere_;
 	
 	std::vector<SubMesh> sub_meshes_;
 
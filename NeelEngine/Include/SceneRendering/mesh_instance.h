@@ -1,9 +1,15 @@
 #pragma once
 
-#include <DirectXMath.h>
+#include <cstdint>
 
+// A mesh drawn with the world matrix of a node of the scene's TransformHierarchy.
 struct MeshInstance
 {
-	DirectX::XMMATRIX Transform;
+	uint32_t NodeIndex;
 	int32_t MeshIndex;
+
+	// Skin of the mesh in SceneData::Skins, -1 for rigid instances.
+	int32_t SkinIndex = -1;
+	// Instance in the scene's Skinning, set when the GPU resources are created.
+	int32_t SkinnedIndex = -1;
 };
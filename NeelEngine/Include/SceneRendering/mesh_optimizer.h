@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mesh.h"
+
+/**
+* Import time welding, reordering and splitting of indexed triangle lists, run on every primitive before it is uploaded.
+*
+* 0. WeldVertices: vertices with identical attributes are merged, so exporter duplicates are transformed once.
+* 1. OptimizeVertexCache: Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+*    and Reduced Overdraw"). Triangles are emitted in fans around vertices that are still in a FIFO
+*    post-transform cache of cache_size_ entries.
+* 2. OptimizeOverdraw: the vertex cache order is cut into clusters that can be reordered without losing much
+*    cache efficiency. Clusters facing away from the center of the mesh are likely to occlude the others and
+*    are drawn first.
+* 3. OptimizeVertexFetch: vertices are renumbered in the order they are first referenced, so the vertex
+*    fetches of a draw walk linearly through the vertex buffers.
+* 4. SplitPrimitive: primitives that reference more vertices than 16-bit indices can address are split into
+*    chunks, so every optimized primitive has 16-bit indices (which the ray tracing shaders rely on).
+*/
+class MeshOptimizer
+{
+public:
+	// Entries of the simulated FIFO post-transform cache.
+	static const uint32_t cache_size_ = 16;
+
+	// Vertices a chunk with 16-bit indices can address.
+	static const size_t max_chunk_vertices_ = 65536;
+
+	struct Stats
+	{
+		// Average cache miss ratio: vertex shader invocations per triangle, 3 without any reuse.
+		double Acmr = 0.0;
+		// Average transform to vertex ratio: vertex shader invocations per referenced vertex, 1 is optimal.
+		double Atvr = 0.0;
+		// Shaded pixels per covered pixel, averaged over views from both sides along the three axes. 1 is optimal.
+		double Overdraw = 0.0;
+	};
+
+	// Estimate the vertex cache efficiency and the overdraw of a triangle list.
+	static Stats Analyze(const std::vector<uint32_t>& indices, const float* positions, size_t vertex_count);
+
+	/**
+	* Reorder the triangles for the post-transform vertex cache.
+	* @param clusters Receives the first index of every run of triangles Tipsify emitted without a restart.
+	*/
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count, std::vector<size_t>& clusters);
+
+	/**
+	* Reorder the clusters of a vertex cache optimized triangle list to reduce overdraw. Clusters are split further
+	* as long as their cache miss ratio stays within threshold times the ratio of the whole cluster.
+	*/
+	static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<size_t>& clusters, const float* positions, size_t vertex_count,
+		float threshold = 1.05f);
+
+	/**
+	* Renumber the vertices in the order they are first referenced, unreferenced vertices are moved to the end.
+	* @returns The new index of every vertex.
+	*/
+	static std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertex_count);
+
+	/**
+	* Merge vertices whose attributes are bit identical, or equal within epsilon when epsilon is larger than 0.
+	* Only for float streams. Joint influences (PrimitiveData::Skin) always have to be bit identical.
+	* @returns For every vertex the first vertex that is equal to it.
+	*/
+	static std::vector<uint32_t> WeldVertices(const Mesh::PrimitiveData& primitive, float epsilon = 0.0f);
+
+	/**
+	* Copy the vertices referenced by indices (a triangle list into the streams of primitive) into chunks of at most
+	* max_chunk_vertices_ vertices with 16-bit indices. Vertices are numbered by first use within a chunk.
+	*/
+	static std::vector<Mesh::PrimitiveData> SplitPrimitive(const Mesh::PrimitiveData& primitive, const std::vector<uint32_t>& indices);
+
+	/**
+	* Run all stages on a packed primitive.
+	* @returns The primitives that replace it, with their streams and indices in PrimitiveData::Storage. Primitives that are
+	*	not indexed triangle lists with float streams are returned as they are.
+	*/
+	static std::vector<Mesh::PrimitiveData> OptimizePrimitive(Mesh::PrimitiveData& primitive, float weld_epsilon = 0.0f);
+
+	// Indices of a primitive widened to 32 bits.
+	static std::vector<uint32_t> ReadIndices(const Mesh::PrimitiveData& primitive);
+};
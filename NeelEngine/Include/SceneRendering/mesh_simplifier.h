@@ -0,0 +1,36 @@
+#pragma once
+
+#include "mesh.h"
+
+/**
+* Level of detail generation for indexed triangle lists.
+*
+* Simplify collapses edges in the order of their quadric error (Garland and Heckbert, "Surface Simplification
+* Using Quadric Error Metrics"). A vertex is always collapsed onto one of its neighbours, so simplified index lists
+* reference the vertices of the original and all levels of a submesh share its vertex buffer. Vertices on borders
+* and on attribute seams (vertices that share a position) are never removed.
+*/
+class MeshSimplifier
+{
+public:
+	// Levels per submesh, including the full resolution level.
+	static const size_t max_lods_ = 8;
+
+	// Levels stop when a level would have fewer triangles.
+	static const size_t min_lod_triangles_ = 32;
+
+	/**
+	* Collapse edges of a triangle list until it has at most target_index_count indices, or until the next collapse
+	* would move the surface by more than target_error. May stop earlier when no more edges can be collapsed.
+	* @param result_error Receives an upper bound of the distance from the input vertices to the result, in mesh units.
+	*/
+	static std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices, const float* positions, size_t vertex_count,
+		size_t target_index_count, float target_error = FLT_MAX, float* result_error = nullptr);
+
+	/**
+	* Append the levels of detail of an optimized primitive to its indices and fill PrimitiveData::Lods. Every level has
+	* about half the triangles of the previous one and is optimized for the vertex cache. Primitives that are not indexed
+	* triangle lists with float positions, or that already have levels, are left as they are.
+	*/
+	static void BuildLodChain(Mesh::PrimitiveData& primitive);
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+/**
+* A cluster of at most MeshletBuilder::max_vertices_ vertices and MeshletBuilder::max_triangles_ triangles of a submesh.
+* Offsets index into the arrays of the MeshletData the meshlet belongs to.
+*/
+struct Meshlet
+{
+	uint32_t VertexOffset;
+	uint32_t VertexCount;
+	// Offset of the first local index in MeshletData::Triangles, 3 per triangle.
+	uint32_t TriangleOffset;
+	uint32_t TriangleCount;
+};
+
+/**
+* Bounds of a meshlet in mesh space (before quantization).
+*
+* The meshlet faces away from a camera at position c when dot(normalize(ConeApex - c), ConeAxis) >= ConeCutoff.
+* ConeCutoff is larger than 1 when the normals of the meshlet are spread too wide to ever cull it.
+*/
+struct MeshletBounds
+{
+	DirectX::XMFLOAT3	Center;
+	float				Radius;
+
+	DirectX::XMFLOAT3	AabbMin;
+	DirectX::XMFLOAT3	AabbMax;
+
+	DirectX::XMFLOAT3	ConeApex;
+	DirectX::XMFLOAT3	ConeAxis;
+	float				ConeCutoff;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet>		Meshlets;
+	std::vector<MeshletBounds>	Bounds;
+
+	// Submesh vertex of every meshlet vertex.
+	std::vector<uint32_t>		Vertices;
+	// Triangles as indices into the vertices of their meshlet. The triangles of a meshlet start at a multiple of 4 bytes.
+	std::vector<uint8_t>		Triangles;
+
+	bool Empty() const { return Meshlets.empty(); }
+};
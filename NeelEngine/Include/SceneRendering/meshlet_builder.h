@@ -0,0 +1,38 @@
+#pragma once
+
+#include "mesh.h"
+
+/**
+* Partitioning of triangle lists into meshlets (see Meshlet) for cluster culling on the CPU, and later for mesh shaders
+* or indirect draws.
+*
+* Triangles are added to the current meshlet in index order until it runs out of vertices or triangles, so the result only
+* depends on the input and clusters are as coherent as the triangle order. Run it on lists that went through MeshOptimizer,
+* whose vertex cache order keeps neighbouring triangles together.
+*/
+class MeshletBuilder
+{
+public:
+	// Limits that suit mesh shader thread groups of 64 or 128 threads (124 triangles keep the local indices of a meshlet within 372 bytes).
+	static const size_t max_vertices_	= 64;
+	static const size_t max_triangles_	= 124;
+
+	/**
+	* Build the meshlets of a triangle list with float3 positions.
+	* max_vertices must not exceed 256, local indices are 8-bit.
+	*/
+	static MeshletData Build(const std::vector<uint32_t>& indices, const float* positions, size_t vertex_count,
+		size_t max_vertices = max_vertices_, size_t max_triangles = max_triangles_);
+
+	/**
+	* Build the meshlets of a primitive.
+	* @returns No meshlets when the primitive is not an indexed triangle list with float positions.
+	*/
+	static MeshletData Build(const Mesh::PrimitiveData& primitive);
+
+	// Bounding sphere, box and normal cone of a meshlet.
+	static MeshletBounds ComputeBounds(const MeshletData& data, const Meshlet& meshlet, const float* positions);
+
+	// True when all triangles of the meshlet are back facing as seen from camera_position (in mesh space).
+	static bool IsBackFacing(const MeshletBounds& bounds, DirectX::FXMVECTOR camera_position);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "bvh.h"
+
+/**
+* Order of rays for tracing that keeps rays with similar origins and directions together.
+*
+* The key of a ray is the octant of its direction above a Morton code of its origin, quantized to morton_bits_ per axis
+* within the bounds of the scene. Sorting by key bins the rays by octant, and sorts each bin along a space filling
+* curve. Rays of one octant visit the children of a node in the same order, and rays that start close to each other
+* visit the same nodes, so consecutive rays find more of their nodes and triangles in the cache. The keys are sorted
+* with RenderQueue::RadixSort, which skips the bytes that all keys share.
+*
+* Rays are traced in sorted order, see Gather, and their results are put back at the index of their ray with Scatter.
+*/
+class RaySorter
+{
+public:
+	static const uint32_t morton_bits_ = 10;
+
+	/**
+	* Key of a ray: the Morton code of its origin in the low 3 * morton_bits_ bits, and a bit per negative direction
+	* component above. Origins outside of the bounds are clamped.
+	* @param inverse_extent Reciprocal of the size of the bounds.
+	*/
+	static uint64_t XM_CALLCONV MakeKey(const Bvh::Ray& ray, DirectX::FXMVECTOR bounds_min, DirectX::FXMVECTOR inverse_extent);
+
+	// Interleaves the low morton_bits_ bits of the cell coordinates, x in the lowest bit.
+	static uint32_t GetMortonCode(uint32_t x, uint32_t y, uint32_t z);
+
+	/**
+	* Sort count rays by key.
+	* @param bounds_min, bounds_max Bounds the origins are quantized in, usually the ones of the scene.
+	*/
+	void Sort(const Bvh::Ray* rays, size_t count, const DirectX::XMFLOAT3& bounds_min, const DirectX::XMFLOAT3& bounds_max);
+
+	// Copy the sorted rays to sorted_rays, the rays passed to Sort.
+	void Gather(const Bvh::Ray* rays, Bvh::Ray* sorted_rays) const;
+
+	// Move the results of the sorted rays to the index of their ray.
+	template <typename Result>
+	void Scatter(const Result* sorted_results, Result* results) const
+	{
+		for (size_t i = 0; i < order_.size(); i++)
+		{
+			results[order_[i]] = sorted_results[i];
+		}
+	}
+
+	// Index of the ray at every sorted position.
+	const std::vector<uint32_t>& GetOrder() const { return order_; }
+
+private:
+	std::vector<uint64_t>	keys_;
+	std::vector<uint32_t>	order_;
+
+	// Scratch buffers of the sort, kept to not allocate for every batch.
+	std::vector<uint64_t>	temp_keys_;
+	std::vector<uint32_t>	temp_order_;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+* Draws of a frame in the order that changes the least state.
+*
+* Every draw gets a 64 bit key of its pass, pipeline state, material and depth bucket, from the most to the least
+* significant bits, and a 32 bit value that identifies the draw for the caller. Sort orders the keys with a stable
+* LSD radix sort over bytes. Bytes that are the same for all keys, like the pass and pipeline of a frame with a single
+* pass, are skipped after the histograms are built, so a frame usually costs a few passes over the queue.
+*
+* Submitting the draws in key order keeps draws with the same pipeline and material together, and CommandList skips
+* binding the same pipeline state and constant buffer data again (see CommandListStateCache).
+*
+* The queue builds without the engine's precompiled header.
+*/
+class RenderQueue
+{
+public:
+	// Bits of the fields of a key, from the most significant field to the least significant one.
+	static constexpr uint32_t pass_bits_		= 8;
+	static constexpr uint32_t pipeline_bits_	= 16;
+	static constexpr uint32_t material_bits_	= 24;
+	static constexpr uint32_t depth_bits_		= 16;
+
+	static constexpr uint32_t max_pass_			= (1u << pass_bits_) - 1;
+	static constexpr uint32_t max_pipeline_		= (1u << pipeline_bits_) - 1;
+	static constexpr uint32_t max_material_		= (1u << material_bits_) - 1;
+	static constexpr uint32_t max_depth_bucket_	= (1u << depth_bits_) - 1;
+
+	/**
+	* Key of a draw. Fields that do not fit throw std::invalid_argument.
+	* @param depth_bucket Front to back within a material, see QuantizeDepth. Pass max_depth_bucket_ - bucket to sort back to front.
+	*/
+	static uint64_t MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t depth_bucket);
+
+	static uint32_t GetPass(uint64_t key) { return static_cast<uint32_t>(key >> (pipeline_bits_ + material_bits_ + depth_bits_)); }
+	static uint32_t GetPipeline(uint64_t key) { return static_cast<uint32_t>(key >> (material_bits_ + depth_bits_)) & max_pipeline_; }
+	static uint32_t GetMaterial(uint64_t key) { return static_cast<uint32_t>(key >> depth_bits_) & max_material_; }
+	static uint32_t GetDepthBucket(uint64_t key) { return static_cast<uint32_t>(key) & max_depth_bucket_; }
+
+	/**
+	* Bucket of a view space depth. Buckets are spaced logarithmically between the near and far clip, so they are
+	* equally fine relative to the depth. Depths outside of the range are clamped.
+	*/
+	static uint32_t QuantizeDepth(float depth, float near_clip, float far_clip);
+
+	/**
+	* Stable sort of keys and their values in place.
+	* @param temp_keys, temp_values Scratch buffers, resized to the size of keys. They may swap storage with keys and values.
+	*/
+	static void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& temp_keys,
+		std::vector<uint32_t>& temp_values);
+
+	void Clear();
+	void Reserve(size_t num_draws);
+
+	void Add(uint64_t key, uint32_t value);
+
+	// Sort the draws by key, draws with the same key keep the order they were added in.
+	void Sort();
+
+	size_t GetSize() const { return keys_.size(); }
+
+	const std::vector<uint64_t>& GetKeys() const { return keys_; }
+	const std::vector<uint32_t>& GetValues() const { return values_; }
+
+private:
+	std::vector<uint64_t>	keys_;
+	std::vector<uint32_t>	values_;
+
+	// Scratch buffers of Sort, kept to not allocate every frame.
+	std::vector<uint64_t>	temp_keys_;
+	std::vector<uint32_t>	temp_values_;
+};
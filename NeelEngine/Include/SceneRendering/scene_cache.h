@@ -0,0 +1,41 @@
+#pragma once
+
+#include "scene_data.h"
+
+/**
+* Cooked binary scene format (.neelscene).
+*
+* A cooked scene stores the packed vertex and index data of every submesh in the layout
+* that is uploaded to the GPU, the meshlets, levels of detail and joint influences of every submesh, the material data, the node hierarchy, the animations,
+* the skins and the texture references of a glTF scene. The file is memory mapped on load and primitives
+* point straight into the mapping, so there is no per-element parsing.
+*
+* The cook is tagged with a hash of the glTF file and the buffers it references and is
+* ignored as soon as any of them changes.
+*/
+class SceneCache
+{
+public:
+	/**
+	* Path of the cooked scene for a glTF file, e.g. Assets/Sponza/Sponza.neelscene.
+	*/
+	static std::string GetCachePath(const std::string& filename);
+
+	/**
+	* Load the cooked version of a glTF file.
+	* @param quantize_vertices Vertex format that is requested, a cook in the other format is not used.
+	* @returns false if there is no cook, if it is out of date or if it has the wrong vertex format.
+	*/
+	static bool Load(const std::string& filename, bool quantize_vertices, SceneData& scene_data);
+
+	/**
+	* Write the cooked version of a glTF file. scene_data.Document must be the imported glTF document.
+	*/
+	static void Save(const std::string& filename, const SceneData& scene_data);
+
+private:
+	// Files (besides the glTF file itself) whose contents end up in the cook.
+	static std::vector<std::string> GetDependencies(const MappedDocument& document);
+
+	static uint64_t HashSource(const std::string& filename, const std::vector<std::string>& dependencies);
+};
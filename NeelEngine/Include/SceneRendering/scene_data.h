@@ -0,0 +1,47 @@
+#pragma once
+
+#include "mesh.h"
+#include "mesh_instance.h"
+#include "transform_hierarchy.h"
+#include "animation.h"
+#include "skinning.h"
+#include "material.h"
+#include "memory_mapped_file.h"
+#include "gltf_mapped_document.h"
+
+/**
+* CPU side representation of a scene. Produced either by importing a glTF file or by loading
+* a cooked .neelscene file, the GPU resources of a Scene are created from it.
+*/
+struct SceneData
+{
+	std::string										Name;
+
+	std::vector<MeshMaterialData>					Materials;
+
+	// Number of glTF textures, texture indices in the material data index into this range.
+	uint32_t										NumTextures = 0;
+	std::vector<TextureLoadRequest>					TextureRequests;
+
+	// Per mesh.
+	std::vector<std::string>						MeshNames;
+	std::vector<DirectX::XMFLOAT4X4>				BaseTransforms;
+	std::vector<std::vector<Mesh::PrimitiveData>>	Primitives;
+
+	// Vertex streams are in the quantized format of VertexQuantization.
+	bool											QuantizedVertices = false;
+
+	// Nodes of the glTF scene, world matrices are up to date.
+	TransformHierarchy								Transforms;
+	std::vector<MeshInstance>						Instances;
+
+	// Animations of the nodes in Transforms.
+	std::vector<Animation>							Animations;
+
+	// Skins of the instances, joints are nodes in Transforms.
+	std::vector<Skinning::Skin>						Skins;
+
+	// Keep the memory the primitives point into alive.
+	std::unique_ptr<MappedDocument>					Document;
+	MemoryMappedFile								CookedFile;
+};
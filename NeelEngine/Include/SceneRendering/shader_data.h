@@ -75,24 +75,42 @@ struct DirectionalLight
 	// Total:                              16 * 3 = 48 bytes 
 };
 
-struct MeshConstantData
+struct InstanceData
 {
-	MeshConstantData()
+	InstanceData()
 		: ModelMatrix{DirectX::XMMatrixIdentity()}
-		  , ModelViewMatrix{DirectX::XMMatrixIdentity()}
 		  , InverseTransposeModelMatrix{DirectX::XMMatrixIdentity()}
-		  , ModelViewProjectionMatrix{DirectX::XMMatrixIdentity()}
 	{}
 
 	DirectX::XMMATRIX ModelMatrix;
 	//----------------------------------- (64 byte boundary)
-	DirectX::XMMATRIX ModelViewMatrix;
-	//----------------------------------- (64 byte boundary)
 	DirectX::XMMATRIX InverseTransposeModelMatrix;
 	//----------------------------------- (64 byte boundary)
-	DirectX::XMMATRIX ModelViewProjectionMatrix;
+	// Total:                              64 * 2 = 128 bytes
+};
+
+struct MeshConstantData
+{
+	MeshConstantData()
+		: ViewProjectionMatrix{DirectX::XMMatrixIdentity()}
+		  , PositionScale(1.0f, 1.0f, 1.0f, 0.0f)
+		  , PositionOffset(0.0f, 0.0f, 0.0f, 0.0f)
+		  , QuantizedVertices(0)
+		  , FirstInstance(0)
+		  , Padding{0, 0}
+	{}
+
+	DirectX::XMMATRIX ViewProjectionMatrix;
 	//----------------------------------- (64 byte boundary)
-	// Total:                              64 * 4 = 256 bytes
+	DirectX::XMFLOAT4 PositionScale;	// Vertex positions are PositionOffset + PositionScale * position.
+	//----------------------------------- (16 byte boundary)
+	DirectX::XMFLOAT4 PositionOffset;
+	//----------------------------------- (16 byte boundary)
+	uint32_t QuantizedVertices;			// Octahedral normals and tangents, bitangent sign in position.w.
+	uint32_t FirstInstance;				// InstanceData of a draw is at FirstInstance + SV_InstanceID.
+	uint32_t Padding[2];
+	//----------------------------------- (16 byte boundary)
+	// Total:                              64 + 16 * 3 = 112 bytes
 };
 
 struct MeshMaterialData
@@ -139,3 +157,29 @@ struct MaterialConstantBuffer
 	//----------------------------------- (16 byte boundary)
 	// Total:                              16 * 1 = 16 bytes 
 };
+
+struct SceneConstantBuffer
+{
+	SceneConstantBuffer()
+		: InverseViewProj{DirectX::XMMatrixIdentity()}
+		  , ViewProj{DirectX::XMMatrixIdentity()}
+		  , CamPos{DirectX::XMVectorZero()}
+		  , VFOV(45.0f)
+		  , PixelHeight(0.0f)
+		  , RayBounces(2)
+		  , Padding1(0.0f)
+	{}
+
+	DirectX::XMMATRIX InverseViewProj;
+	//----------------------------------- (64 byte boundary)
+	DirectX::XMMATRIX ViewProj;
+	//----------------------------------- (64 byte boundary)
+	DirectX::XMVECTOR CamPos;
+	//----------------------------------- (16 byte boundary)
+	float VFOV;			// Vertical field of view in degrees.
+	float PixelHeight;
+	int RayBounces;		// Reflection rays traced from a reflective hit, after the one of the ray generation shader.
+	float Padding1;
+	//----------------------------------- (16 byte boundary)
+	// Total:                              64 * 2 + 16 * 2 = 160 bytes
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "mesh.h"
+
+class CommandList;
+class ThreadPool;
+class TransformHierarchy;
+
+/**
+* CPU linear blend skinning of skinned mesh instances (glTF skins).
+*
+* Every frame Update blends the joint matrices of every vertex, four influences at a time, and writes positions and
+* normals in the vertex format of the mesh into a stream per submesh. Upload copies the streams into a vertex buffer
+* once per frame; the views are bound in place of the pool's position and normal streams by Mesh::Render, and they can
+* be used as the vertex buffers of a bottom level acceleration structure update once GetVertexBuffer is transitioned
+* to D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE.
+*
+* Positions are written in the space of the node of the instance, so instances are drawn with its world matrix like
+* rigid ones. Quantized meshes are quantized relative to the bounds of the current pose. Those come from the bind pose
+* bounds of the vertices of every joint moved by the joint: a blended position is a convex combination of positions
+* inside those moved bounds, so the vertices never have to be visited twice. Tangents are not skinned.
+*
+* Instances are split into ranges of at most parallel_grain_size_ vertices, so both many small meshes and a few large
+* meshes are spread over the threads.
+*/
+class Skinning
+{
+public:
+	// Vertices are skinned by one thread up to this many.
+	static const size_t parallel_grain_size_ = 4096;
+
+	struct Skin
+	{
+		// TransformHierarchy node of every joint.
+		std::vector<uint32_t>				Joints;
+		// Transform from mesh space to the bind pose space of every joint.
+		std::vector<DirectX::XMFLOAT4X4>	InverseBindMatrices;
+	};
+
+	/**
+	* Load a glTF skin.
+	* @param node_map TransformHierarchy node of every glTF node, UINT32_MAX for nodes that are not in the hierarchy.
+	* @param buffer_data Start of every document buffer (see MappedDocument), when omitted fx::gltf::Buffer::data is used.
+	*/
+	static Skin LoadSkin(const fx::gltf::Document& doc, size_t skin_index, const std::vector<uint32_t>& node_map,
+		const std::vector<const uint8_t*>* buffer_data = nullptr);
+
+	/**
+	* Add an instance of a skinned mesh. The bind pose and the influences of the primitives are copied, every primitive
+	* needs PrimitiveData::Skin.
+	* @param node Node the instance is drawn with.
+	* @returns Index of the skinned instance.
+	*/
+	uint32_t AddInstance(const std::vector<Mesh::PrimitiveData>& primitives, const Skin& skin, uint32_t node);
+
+	void Clear();
+
+	size_t GetNumInstances() const { return instances_.size(); }
+	size_t GetNumVertices() const { return influences_.size(); }
+
+	/**
+	* Skin all instances with the world matrices of the joints.
+	* @param thread_pool Pool to skin on, everything runs on the calling thread when omitted.
+	*/
+	void Update(const TransformHierarchy& transforms, ThreadPool* thread_pool = nullptr);
+
+	/**
+	* Copy the skinned streams of the last Update into the vertex buffer, for GetPositionView and GetNormalView.
+	* The buffer is left in the copy destination state.
+	*/
+	void Upload(CommandList& command_list);
+
+	uint32_t GetNode(uint32_t instance) const { return instances_[instance].Node; }
+	size_t GetNumSubMeshes(uint32_t instance) const { return instances_[instance].SubMeshVertices.size() - 1; }
+	bool GetQuantized(uint32_t instance) const { return instances_[instance].Quantized; }
+
+	// Vertex format of the streams, like the pool's streams of the mesh (see VertexQuantization).
+	uint32_t GetPositionStride(uint32_t instance) const;
+	uint32_t GetNormalStride(uint32_t instance) const;
+
+	// Skinned vertices of a submesh as of the last Update.
+	uint32_t GetNumVertices(uint32_t instance, size_t sub_mesh) const;
+	const uint8_t* GetPositions(uint32_t instance, size_t sub_mesh) const;
+	const uint8_t* GetNormals(uint32_t instance, size_t sub_mesh) const;
+
+	// Positions are PositionOffset + PositionScale * position, for the pose of the last Update.
+	const DirectX::XMFLOAT3& GetPositionScale(uint32_t instance) const { return instances_[instance].PositionScale; }
+	const DirectX::XMFLOAT3& GetPositionOffset(uint32_t instance) const { return instances_[instance].PositionOffset; }
+	DirectX::XMMATRIX GetDequantizeTransform(uint32_t instance) const;
+
+	// Bounding sphere of the pose of the last Update in the space of the node, center in xyz and radius in w.
+	const DirectX::XMFLOAT4& GetBoundingSphere(uint32_t instance) const { return instances_[instance].BoundingSphere; }
+
+	// Views of the last Upload.
+	const D3D12_VERTEX_BUFFER_VIEW& GetPositionView(uint32_t instance, size_t sub_mesh) const;
+	const D3D12_VERTEX_BUFFER_VIEW& GetNormalView(uint32_t instance, size_t sub_mesh) const;
+
+	// Buffer the views point into.
+	const VertexBuffer& GetVertexBuffer() const { return vertex_buffer_; }
+
+private:
+	struct Instance
+	{
+		uint32_t							Node;
+		uint32_t							FirstJoint;
+		uint32_t							NumJoints;
+		uint32_t							FirstVertex;
+		bool								Quantized;
+
+		// First vertex of every submesh relative to FirstVertex, followed by the number of vertices.
+		std::vector<uint32_t>				SubMeshVertices;
+
+		DirectX::XMFLOAT3					PositionScale;
+		DirectX::XMFLOAT3					PositionOffset;
+		DirectX::XMFLOAT4					BoundingSphere;
+
+		std::vector<uint8_t>				Positions;
+		std::vector<uint8_t>				Normals;
+
+		std::vector<D3D12_VERTEX_BUFFER_VIEW>	PositionViews;
+		std::vector<D3D12_VERTEX_BUFFER_VIEW>	NormalViews;
+	};
+
+	// Vertices [Begin, End) of an instance, relative to its FirstVertex.
+	struct Range
+	{
+		uint32_t	Instance;
+		uint32_t	Begin;
+		uint32_t	End;
+	};
+
+	// Compute the joint matrices, the bounds and the quantization of an instance.
+	void UpdateJoints(uint32_t instance, const TransformHierarchy& transforms);
+
+	void SkinRange(const Range& range);
+
+	std::vector<Instance>					instances_;
+	std::vector<Range>						ranges_;
+
+	// Per joint of all instances.
+	std::vector<uint32_t>					joint_nodes_;
+	std::vector<DirectX::XMFLOAT4X4A>		inverse_bind_matrices_;
+	std::vector<DirectX::XMFLOAT4X4A>		joint_matrices_;
+	// Bind pose bounds of the vertices a joint moves, center and extents. Joints that move no vertex have negative extents.
+	std::vector<DirectX::XMFLOAT4A>			joint_centers_;
+	std::vector<DirectX::XMFLOAT4A>			joint_extents_;
+
+	// Per vertex of all instances. Bind pose positions hold the bitangent sign in w.
+	std::vector<DirectX::XMFLOAT4A>			bind_positions_;
+	std::vector<DirectX::XMFLOAT4A>			bind_normals_;
+	std::vector<Mesh::SkinVertex>			influences_;
+
+	// Skinned streams of all instances, 16 byte aligned for acceleration structure builds.
+	VertexBuffer							vertex_buffer_;
+};
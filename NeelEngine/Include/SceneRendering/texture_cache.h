@@ -0,0 +1,67 @@
+#pragma once
+
+#include "material.h"
+#include "texture.h"
+
+#include <unordered_map>
+
+namespace DirectX
+{
+	class ScratchImage;
+}
+
+class CommandList;
+class ThreadPool;
+
+/**
+* Textures of loaded scenes, keyed by resolved image path and TextureUsage.
+*
+* Every unique image file is decoded once, even when it is referenced by several glTF textures
+* or materials, and every unique (image, usage) pair is uploaded once. Requests that hit the
+* cache get a Texture that shares the already created resource.
+*/
+class TextureCache
+{
+public:
+	TextureCache();
+	~TextureCache();
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	/**
+	* Decode the images of all requests that are not in the cache yet. Only touches CPU memory.
+	*/
+	void DecodeImages(const std::vector<TextureLoadRequest>& texture_requests, ThreadPool* thread_pool);
+
+	/**
+	* Assign a texture to textures[request.TextureIndex] for every request, creating the ones that
+	* are not in the cache yet from the decoded images. Decoded images are released afterwards.
+	*/
+	void CreateTextures(const std::vector<TextureLoadRequest>& texture_requests, CommandList& command_list, std::vector<Texture>& textures);
+
+	void Clear();
+
+	// Number of texture requests handled by the cache.
+	uint32_t GetNumRequested() const { return num_requested_; }
+	// Number of image files that were decoded.
+	uint32_t GetNumDecoded() const { return num_decoded_; }
+	// Number of textures that were created on the GPU.
+	uint32_t GetNumCreated() const { return num_created_; }
+
+private:
+	// Different relative paths to the same file resolve to the same key.
+	static std::string ResolvePath(const std::string& filename);
+
+	static std::string GetTextureKey(const std::string& resolved_path, TextureUsage texture_usage);
+
+	std::unordered_map<std::string, Texture>	textures_;
+
+	// Images decoded by DecodeImages, waiting for CreateTextures.
+	std::unordered_map<std::string, size_t>		image_indices_;
+	std::vector<DirectX::ScratchImage>			images_;
+
+	uint32_t num_requested_;
+	uint32_t num_decoded_;
+	uint32_t num_created_;
+};
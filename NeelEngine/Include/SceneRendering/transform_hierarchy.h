@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <DirectXMath.h>
+
+class ThreadPool;
+
+/**
+* Flat transform hierarchy with the node data in separate arrays (structure of arrays).
+*
+* Nodes are stored in depth first order: a parent comes before its children and the subtree of a node is the contiguous
+* range [node, node + GetSubtreeSize(node)). Changing the local transform of a node only flags it, Update then recomputes
+* the world matrices of the flagged subtrees and nothing else. Local transforms are composed four nodes at a time from
+* the translation, rotation and scale arrays, and large updates are split over the children of their roots so
+* disjoint subtrees run on different threads.
+*/
+class TransformHierarchy
+{
+public:
+	static const int32_t no_parent_ = -1;
+
+	// Subtrees are updated by one thread up to this many nodes.
+	static const size_t parallel_grain_size_ = 4096;
+
+	/**
+	* Append a node with a local transform. The parent must be no_parent_ or the last added node or one of its
+	* ancestors, which keeps the nodes in depth first order.
+	* @param rotation Normalized rotation quaternion.
+	* @returns Index of the node.
+	*/
+	uint32_t AddNode(int32_t parent, const DirectX::XMFLOAT3& translation = { 0.0f, 0.0f, 0.0f },
+		const DirectX::XMFLOAT4& rotation = { 0.0f, 0.0f, 0.0f, 1.0f }, const DirectX::XMFLOAT3& scale = { 1.0f, 1.0f, 1.0f });
+
+	// Append a node with a local transform matrix, which is decomposed into translation, rotation and scale.
+	uint32_t XM_CALLCONV AddNode(int32_t parent, DirectX::FXMMATRIX local_transform);
+
+	void Reserve(size_t num_nodes);
+	void Clear();
+
+	size_t GetNumNodes() const { return parents_.size(); }
+	int32_t GetParent(uint32_t node) const { return parents_[node]; }
+	uint32_t GetSubtreeSize(uint32_t node) const { return subtree_sizes_[node]; }
+
+	void SetTranslation(uint32_t node, const DirectX::XMFLOAT3& translation);
+	void SetRotation(uint32_t node, const DirectX::XMFLOAT4& rotation);
+	void SetScale(uint32_t node, const DirectX::XMFLOAT3& scale);
+
+	DirectX::XMFLOAT3 GetTranslation(uint32_t node) const;
+	DirectX::XMFLOAT4 GetRotation(uint32_t node) const;
+	DirectX::XMFLOAT3 GetScale(uint32_t node) const;
+
+	// Nodes whose local transform changed since the last Update.
+	size_t GetNumDirtyNodes() const { return dirty_nodes_.size(); }
+
+	/**
+	* World matrix of a node as of the last Update.
+	*/
+	DirectX::XMMATRIX GetWorldMatrix(uint32_t node) const { return DirectX::XMLoadFloat4x4A(&world_matrices_[node]); }
+
+	/**
+	* Recompute the world matrices of all nodes below (and including) the nodes that changed.
+	* @param thread_pool Pool to update large hierarchies on, the update runs on the calling thread when omitted.
+	* @returns Number of world matrices that were recomputed.
+	*/
+	size_t Update(ThreadPool* thread_pool = nullptr);
+
+private:
+	void MarkDirty(uint32_t node);
+
+	// Recompute the world matrices of [begin, end). Parents outside of the range must be up to date.
+	void UpdateRange(uint32_t begin, uint32_t end);
+
+	// Split a dirty subtree into ranges of whole sibling subtrees that can be updated independently.
+	void SplitRange(uint32_t begin, uint32_t end, std::vector<std::pair<uint32_t, uint32_t>>& ranges);
+
+	std::vector<int32_t>					parents_;
+	std::vector<uint32_t>					subtree_sizes_;
+
+	// Local transforms, one array per component.
+	std::array<std::vector<float>, 3>		translations_;
+	std::array<std::vector<float>, 4>		rotations_;
+	std::array<std::vector<float>, 3>		scales_;
+
+	std::vector<DirectX::XMFLOAT4X4A>		world_matrices_;
+
+	std::vector<uint8_t>					dirty_;
+	std::vector<uint32_t>					dirty_nodes_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "mesh.h"
+
+/**
+* Conversion of glTF vertex attributes to the vertex formats used on the GPU.
+*
+* Float format (default): float3 positions and normals, float4 tangents and float2 texcoords, 48 bytes per vertex.
+*
+* Quantized format (Scene::SetQuantizeVertices), 20 bytes per vertex:
+*	position	R16G16B16A16_SNORM	xyz relative to the bounds of the mesh, w holds the bitangent sign.
+*	normal		R16G16_SNORM		octahedral encoded.
+*	tangent		R16G16_SNORM		octahedral encoded.
+*	texcoord	R16G16_FLOAT
+* Positions are decoded as PrimitiveData::PositionOffset + PrimitiveData::PositionScale * position.
+*/
+class VertexQuantization
+{
+public:
+	static const size_t quantized_position_size_	= 8;
+	static const size_t quantized_normal_size_		= 4;
+	static const size_t quantized_tangent_size_		= 4;
+	static const size_t quantized_texcoord_size_	= 4;
+
+	// Round trip error and memory usage of quantized meshes.
+	struct Stats
+	{
+		uint64_t	NumVertices			= 0;
+		uint64_t	FloatBytes			= 0;
+		uint64_t	QuantizedBytes		= 0;
+
+		// In mesh units.
+		double		MaxPositionError	= 0.0;
+		double		MaxNormalDegrees	= 0.0;
+		double		MaxTangentDegrees	= 0.0;
+		double		MaxTexCoordError	= 0.0;
+	};
+
+	/**
+	* Convert count elements of num_components components to float. Integer components are normalized
+	* when the accessor is normalized (KHR_mesh_quantization) and converted as is otherwise.
+	*/
+	static void DecodeComponents(const uint8_t* data, uint32_t stride, size_t count, uint32_t num_components,
+		fx::gltf::Accessor::ComponentType component_type, bool normalized, float* output);
+
+	/**
+	* Replace the float streams of all primitives of a mesh by quantized streams. Positions of all primitives
+	* are quantized relative to the bounds of the whole mesh, so they share PositionScale and PositionOffset.
+	* The quantized streams are stored in PrimitiveData::Storage.
+	*/
+	static Stats QuantizeMesh(std::vector<Mesh::PrimitiveData>& primitives);
+
+	static int16_t EncodeSnorm16(float value);
+	static float DecodeSnorm16(int16_t value);
+
+	// Unit vector to two SNORM16 values.
+	static void EncodeOctahedral(const float* normal, int16_t* encoded);
+	static void DecodeOctahedral(const int16_t* encoded, float* normal);
+};
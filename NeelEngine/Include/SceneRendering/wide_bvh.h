@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "bvh.h"
+
+/**
+* Bounding volume hierarchy with 4 or 8 children per node, collapsed from a binary Bvh.
+*
+* Build pulls the children of a binary node up into its wide node, always opening the child with the largest surface
+* area, until the node has width children or only leaves are left. The leaves and triangles of the binary hierarchy are
+* kept as they are.
+*
+* The boxes of the children are stored as structures of arrays in groups of four, so a ray is tested against four
+* children with a few vector operations, and an 8 wide node is two groups. A group is two cache lines: the six bound
+* components, the child indices and the triangle counts of four children. Nodes are aligned to cache lines.
+*
+* Intersect and Occluded behave like the ones of Bvh and return the same hits. The children a ray hits are visited in
+* the order of their entry distances.
+*
+* The batched Intersect and Occluded trace arrays of rays in one of the QueryModes. Packets keep their rays in vectors
+* of four, so a child box and a triangle are tested against four rays at a time, and when all rays of a packet point
+* into the same octant the bounds of their origins and directions form a frustum that rejects four children at a time
+* before any ray is tested. A stream sends its rays down the hierarchy together and every node passes on only the rays
+* that hit its children, which suits rays that are too incoherent for packets. Closest hit distances and occlusion are
+* the same in every mode, only the triangle that is reported for hits at the same distance may differ.
+*/
+class WideBvh
+{
+public:
+	static const uint32_t max_width_	= 8;
+	static const uint32_t no_child_		= 0xffffffff;
+	// Rays traced together by QueryMode::Stream.
+	static const uint32_t stream_size_	= 256;
+
+	enum class QueryMode
+	{
+		// Every ray on its own.
+		Single,
+		// Packets of 8 or 16 rays.
+		Packet8,
+		Packet16,
+		// Up to stream_size_ rays that are filtered at every node.
+		Stream,
+	};
+
+	// Four children of a node, empty slots are no_child_.
+	struct alignas(64) NodeGroup
+	{
+		float		BoundsMinX[4];
+		float		BoundsMinY[4];
+		float		BoundsMinZ[4];
+		float		BoundsMaxX[4];
+		float		BoundsMaxY[4];
+		float		BoundsMaxZ[4];
+		// Index of the node of an inner child, or of the first triangle of a leaf.
+		uint32_t	Children[4];
+		// 0 for inner children.
+		uint32_t	NumTriangles[4];
+	};
+
+	/**
+	* Collapse a binary hierarchy, the triangles are copied. A binary hierarchy that is a single leaf becomes a root
+	* node with one child.
+	* @param width 4 or 8, std::invalid_argument otherwise.
+	*/
+	void Build(const Bvh& bvh, uint32_t width);
+
+	void Clear();
+
+	// Closest hit of a ray. Back facing triangles are skipped with cull_back_faces, like RAY_FLAG_CULL_BACK_FACING_TRIANGLES.
+	bool Intersect(const Bvh::Ray& ray, Bvh::Hit& hit, bool cull_back_faces = false) const;
+
+	// Whether any triangle is hit.
+	bool Occluded(const Bvh::Ray& ray) const;
+
+	// Closest hits of count rays, consecutive rays are traced together by the packet and stream modes.
+	void Intersect(const Bvh::Ray* rays, size_t count, Bvh::Hit* hits, QueryMode mode, bool cull_back_faces = false) const;
+
+	// Whether any triangle is hit by each of count rays, 1 when it is.
+	void Occluded(const Bvh::Ray* rays, size_t count, uint8_t* occluded, QueryMode mode) const;
+
+	uint32_t GetWidth() const { return width_; }
+	size_t GetNumNodes() const { return groups_.size() / (width_ / 4); }
+	size_t GetNumTriangles() const { return triangle_indices_.size(); }
+	size_t GetNodeBytes() const { return groups_.size() * sizeof(NodeGroup); }
+
+private:
+	template <bool any_hit>
+	bool Traverse(const Bvh::Ray& ray, Bvh::Hit& hit, bool cull_back_faces) const;
+
+	template <bool any_hit>
+	void Trace(const Bvh::Ray* rays, size_t count, Bvh::Hit* hits, QueryMode mode, bool cull_back_faces) const;
+
+	// At most packet_size rays.
+	template <bool any_hit, uint32_t packet_size>
+	void TracePacket(const Bvh::Ray* rays, uint32_t count, Bvh::Hit* hits, bool cull_back_faces) const;
+
+	// At most stream_size_ rays.
+	template <bool any_hit>
+	void TraceStream(const Bvh::Ray* rays, uint32_t count, Bvh::Hit* hits, bool cull_back_faces) const;
+
+	uint32_t						width_ = 4;
+
+	// width_ / 4 groups per node, the root is node 0.
+	std::vector<NodeGroup>			groups_;
+
+	// Triangles in the order of the leaves, like Bvh::GetPositions.
+	std::vector<DirectX::XMFLOAT3>	positions_;
+	std::vector<uint32_t>			triangle_indices_;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Read-only view of a file mapped into the address space of the process.
+ * Pages are loaded by the OS on first access, so only the parts of the file
+ * that are actually read are brought into memory.
+ */
+class MemoryMappedFile
+{
+public:
+	MemoryMappedFile();
+	explicit MemoryMappedFile(const std::string& filename);
+	~MemoryMappedFile();
+
+	MemoryMappedFile(const MemoryMappedFile&) = delete;
+	MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+	MemoryMappedFile(MemoryMappedFile&& other) noexcept;
+	MemoryMappedFile& operator=(MemoryMappedFile&& other) noexcept;
+
+	/**
+	 * Map a file. Throws if the file cannot be opened or is empty.
+	 */
+	void Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen() const { return data_ != nullptr; }
+
+	const uint8_t* Data() const { return data_; }
+	size_t Size() const { return size_; }
+
+private:
+	HANDLE			file_;
+	HANDLE			mapping_;
+	const uint8_t*	data_;
+	size_t			size_;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed size pool of worker threads used for CPU side work such as scene import.
+ * Worker threads initialize COM so WIC based image decoding can run on them.
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * Create a pool with the given number of worker threads.
+	 * A thread count of 0 uses the number of hardware threads.
+	 */
+	explicit ThreadPool(uint32_t num_threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * Queue a task for execution on one of the worker threads.
+	 * Exceptions thrown by the task are rethrown by std::future::get.
+	 */
+	template <typename Function>
+	std::future<void> Submit(Function&& function);
+
+	/**
+	 * Invoke function(index) for every index in [0, count) and block until all
+	 * invocations have finished. The calling thread participates in the work, so
+	 * it is safe to call ParallelFor from a task that runs on the pool.
+	 * The first exception thrown by any invocation is rethrown on the calling thread.
+	 */
+	void ParallelFor(size_t count, const std::function<void(size_t)>& function);
+
+	/**
+	 * Same as ParallelFor but hands out contiguous ranges of at most grain_size
+	 * indices as function(begin, end) to reduce scheduling overhead for small work items.
+	 */
+	void ParallelForRange(size_t count, size_t grain_size, const std::function<void(size_t, size_t)>& function);
+
+	uint32_t GetNumThreads() const { return static_cast<uint32_t>(threads_.size()); }
+
+private:
+	void WorkerThread();
+
+	std::vector<std::thread> threads_;
+	std::queue<std::function<void()>> tasks_;
+
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	bool stop_;
+};
+
+template <typename Function>
+std::future<void> ThreadPool::Submit(Function&& function)
+{
+	auto task = std::make_shared<std::packaged_task<void()>>(std::forward<Function>(function));
+	std::future<void> future = task->get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.emplace([task]() { (*task)(); });
+	}
+	condition_.notify_one();
+
+	return future;
+}
+
+/**
+ * Run function(index) for every index in [0, count) on the thread pool,
+ * or serially on the calling thread when no thread pool is given.
+ */
+inline void ParallelFor(ThreadPool* thread_pool, size_t count, const std::function<void(size_t)>& function)
+{
+	if (thread_pool)
+	{
+		thread_pool->ParallelFor(count, function);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		function(i);
+	}
+}
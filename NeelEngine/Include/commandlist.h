@@ -11,6 +11,7 @@
 #include "texture_usage.h"
 
 class Buffer;
+class CommandListStateCache;
 class ByteAddressBuffer;
 class ConstantBuffer;
 class DynamicDescriptorHeap;
@@ -24,8 +25,14 @@ class Texture;
 class UploadBuffer;
 class VertexBuffer;
 class GenerateMipsPSO;
+class GeometryLayout;
 class ShaderTable;
 
+namespace DirectX
+{
+	class ScratchImage;
+}
+
 class CommandList
 {
 public:
@@ -121,6 +128,9 @@ public:
 	// Copy gpu buffer region to other gpu buffer.
 	void CopyBufferRegion(Buffer& dst_buffer, UINT64 dst_offset, Buffer& src_buffer, UINT64 src_offset, UINT64 num_bytes);
 
+	// Copy CPU data to a region of a gpu buffer through the upload heap, without recreating the buffer.
+	void CopyBufferRegion(Buffer& dst_buffer, UINT64 dst_offset, const void* buffer_data, UINT64 num_bytes);
+
 	
 	// Copy the contents of a CPU buffer to a GPU buffer (possibly replacing the previous buffer contents).
 	void CopyBuffer(Buffer& buffer, size_t num_elements, size_t element_size, const void* buffer_data,
@@ -134,6 +144,14 @@ public:
 	 */
 	void CopyShaderTable(ShaderTable& shader_table, UINT shader_record_size, const std::string& resource_name = "ShaderTable");
 
+	/**
+	 * Append the submeshes of a layout with a single vertex and index buffer, starting at first_sub_mesh, to vertex_buffer and index_buffer.
+	 * A buffer that is too small is recreated with at least twice its size and the data in front of the appended submeshes is copied over from the old resource,
+	 * so offsets of previously appended submeshes stay valid. Views of the buffers are not (re)created.
+	 */
+	void CopyGeometry(const GeometryLayout& layout, uint32_t first_sub_mesh, Buffer& vertex_buffer, Buffer& index_buffer,
+	                  D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
+
 	/**
 	 * Copy the contents to a vertex buffer in GPU memory.
 	 */
@@ -194,6 +212,30 @@ public:
 	*/
 	void LoadTextureFromFile(Texture& texture, const std::string& filename, TextureUsage texture_usage = TextureUsage::Albedo);
 
+	/**
+	* Decode a texture file into system memory.
+	* Does not touch the device, so it is safe to call from worker threads.
+	*/
+	static void DecodeTextureFromFile(const std::string& filename, DirectX::ScratchImage& scratch_image);
+
+	/**
+	* Load a texture from an encoded image (DDS, HDR or any WIC format such as PNG and JPEG) in memory.
+	* The name is used as debug name of the texture.
+	*/
+	void LoadTextureFromMemory(Texture& texture, const void* data, size_t size, const std::string& name, TextureUsage texture_usage = TextureUsage::Albedo);
+
+	/**
+	* Decode an encoded image in memory into system memory.
+	* PNG and JPEG are decoded with ImageDecoder into R8G8B8A8_UNORM, other formats and the variants it does not
+	* handle go through DirectXTex. Does not touch the device, so it is safe to call from worker threads.
+	*/
+	static void DecodeTextureFromMemory(const void* data, size_t size, DirectX::ScratchImage& scratch_image);
+
+	/**
+	* Create a texture from an image that was decoded with DecodeTextureFromFile or DecodeTextureFromMemory.
+	*/
+	void LoadTextureFromScratchImage(Texture& texture, const DirectX::ScratchImage& scratch_image, const std::string& filename, TextureUsage texture_usage = TextureUsage::Albedo);
+
 	/**
 	 * Clear a texture.
 	 */
@@ -220,7 +262,8 @@ public:
 
 	/**
 	 * Set a dynamic constant buffer data to an inline descriptor in the root
-	 * signature.
+	 * signature. Data that is the same as the data last bound to the root
+	 * parameter is not uploaded and bound again, until the root signature changes.
 	 */
 	void SetGraphicsDynamicConstantBuffer(uint32_t root_parameter_index, size_t size_in_bytes, const void* buffer_data);
 
@@ -343,6 +386,7 @@ public:
 
 	/**
 	 * Set the pipeline State object on the command list.
+	 * Setting the pipeline State that is already bound does nothing.
 	 */
 	void SetPipelineState(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline_state);
 
@@ -486,6 +530,9 @@ private:
 	// signature changes.
 	ID3D12RootSignature* root_signature_{};
 
+	// Keep track of the currently bound pipeline State, topology and constant buffers to skip setting them again.
+	std::unique_ptr<CommandListStateCache> state_cache_;
+
 	// Resource created in an upload heap. Useful for drawing of dynamic geometry
 	// or for uploading constant buffer data that changes every draw call.
 	std::unique_ptr<UploadBuffer> upload_buffer_;
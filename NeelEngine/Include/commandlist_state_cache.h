@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+* State that is bound on a command list, to skip setting the same state again.
+*
+* Every Set function records the state and returns whether it differs from the bound state, only then the caller
+* sets it on the D3D12 command list. Consecutive draws with the same pipeline or material, like the draws of a
+* sorted RenderQueue, then bind their state once.
+*
+* The cache only compares handles and bytes, it does not touch the device and builds without the engine's
+* precompiled header.
+*/
+class CommandListStateCache
+{
+public:
+	bool SetPipelineState(const void* pipeline_state);
+
+	// Topologies are D3D_PRIMITIVE_TOPOLOGY values, 0 is D3D_PRIMITIVE_TOPOLOGY_UNDEFINED.
+	bool SetPrimitiveTopology(uint32_t primitive_topology);
+
+	/**
+	* Data of the dynamic constant buffer of a root parameter of the graphics root signature. The data is compared
+	* with a CPU copy of the bound data, because reading back from the upload heap is slow.
+	*/
+	bool SetGraphicsConstantBuffer(uint32_t root_parameter_index, size_t size_in_bytes, const void* buffer_data);
+
+	// Forget the pipeline state when it was replaced without SetPipelineState, like by a state object.
+	void InvalidatePipelineState();
+
+	// Forget the root arguments when the root signature changes.
+	void InvalidateRootArguments();
+
+	// Forget all state when the command list is reset.
+	void Reset();
+
+private:
+	const void*	pipeline_state_{};
+	uint32_t	primitive_topology_{};
+
+	// Data bound to every root parameter, empty when none is bound.
+	std::vector<std::vector<uint8_t>> graphics_constant_buffers_;
+};
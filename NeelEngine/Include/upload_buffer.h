@@ -17,6 +17,10 @@ public:
 	{
 		uint8_t* CPU;
 		D3D12_GPU_VIRTUAL_ADDRESS GPU;
+
+		// Page the memory is in and its offset in the page, to copy from it on the GPU.
+		ID3D12Resource* Resource;
+		size_t Offset;
 	};
 
 	/**
@@ -27,13 +31,13 @@ public:
 	virtual ~UploadBuffer();
 
 	/**
-	 * The maximum size of an allocation is the size of a single page.
+	 * Allocations up to this size share pages.
 	 */
 	size_t GetPageSize() const { return page_size_; }
 
 	/**
 	 * Allocate memory in an Upload heap.
-	 * An allocation must not exceed the size of a page.
+	 * An allocation that exceeds the size of a page gets a page of its own, which is released on Reset.
 	 * Use a memcpy or similar method to copy the
 	 * buffer data to CPU pointer in the Allocation structure returned from
 	 * this function.
@@ -90,6 +94,9 @@ private:
 	PagePool page_pool_;
 	PagePool available_pages_;
 
+	// Pages of single allocations larger than page_size_.
+	PagePool large_pages_;
+
 	std::shared_ptr<Page> current_page_;
 
 	// The size of each page of memory.
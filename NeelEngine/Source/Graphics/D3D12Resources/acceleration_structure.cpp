@@ -26,7 +26,9 @@ void AccelerationStructure::AllocateAccelerationStructureBuffer(D3D12_BUILD_RAYT
 	ThrowIfFalse(acceleration_structure_prebuild_info.ResultDataMaxSizeInBytes > 0);
 
 	command_list.AllocateUAVBuffer(acceleration_structure_prebuild_info.ResultDataMaxSizeInBytes, &d3d12_resource_, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
-	command_list.AllocateUAVBuffer(acceleration_structure_prebuild_info.ScratchDataSizeInBytes, &scratch_resource_, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	// Structures that allow updates are refit with the same scratch buffer.
+	const UINT64 scratch_size = std::max(acceleration_structure_prebuild_info.ScratchDataSizeInBytes, acceleration_structure_prebuild_info.UpdateScratchDataSizeInBytes);
+	command_list.AllocateUAVBuffer(scratch_size, &scratch_resource_, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
 	scratch_resource_->SetName(L"ScratchResource");
 }
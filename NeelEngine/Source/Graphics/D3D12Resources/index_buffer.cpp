@@ -5,6 +5,7 @@ IndexBuffer::IndexBuffer(const std::string& name)
 	: Buffer(name)
 	  , num_indicies_(0)
 	  , index_format_(DXGI_FORMAT_UNKNOWN)
+	  , buffer_offset_(0)
 	  , index_buffer_view_({})
 {
 }
@@ -19,22 +20,34 @@ void IndexBuffer::CreateViews(size_t num_elements, size_t element_size)
 
 	num_indicies_ = num_elements;
 	index_format_ = (element_size == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	buffer_offset_ = 0;
 
 	index_buffer_view_.BufferLocation = d3d12_resource_->GetGPUVirtualAddress();
 	index_buffer_view_.SizeInBytes = static_cast<UINT>(num_elements * element_size);
 	index_buffer_view_.Format = index_format_;
 }
 
-void IndexBuffer::CreateViews(uint32_t num_elements, uint32_t total_size, DXGI_FORMAT format)
+void IndexBuffer::CreateViews(uint32_t num_elements, uint32_t total_size, DXGI_FORMAT format, uint64_t buffer_offset)
 {
 	num_indicies_ = num_elements;
 	index_format_ = format;
+	buffer_offset_ = buffer_offset;
 
-	index_buffer_view_.BufferLocation = d3d12_resource_->GetGPUVirtualAddress();
+	index_buffer_view_.BufferLocation = d3d12_resource_->GetGPUVirtualAddress() + buffer_offset_;
 	index_buffer_view_.SizeInBytes = static_cast<UINT>(total_size);
 	index_buffer_view_.Format = index_format_;
 }
 
+void IndexBuffer::MoveViews(Microsoft::WRL::ComPtr<ID3D12Resource> d3d12_resource)
+{
+	if (d3d12_resource == d3d12_resource_)
+		return;
+
+	SetD3D12Resource(d3d12_resource);
+
+	index_buffer_view_.BufferLocation = d3d12_resource_->GetGPUVirtualAddress() + buffer_offset_;
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE IndexBuffer::GetShaderResourceView(const D3D12_SHADER_RESOURCE_VIEW_DESC* srv_desc) const
 {
 	throw std::exception("IndexBuffer::GetShaderResourceView should not be called.");
@@ -6,6 +6,7 @@ VertexBuffer::VertexBuffer(const std::string& name)
 	  , num_vertices_(0)
 	  , vertex_stride_(0)
 	  , gpu_offset_(0)
+	  , size_in_bytes_(0)
 	  , vertex_buffer_views_({})
 {
 }
@@ -18,6 +19,8 @@ void VertexBuffer::CreateViews(size_t num_elements, size_t element_size)
 {
 	num_vertices_ = num_elements;
 	vertex_stride_ = element_size;
+	gpu_offset_ = 0;
+	size_in_bytes_ = num_elements * element_size;
 
 
 	vertex_buffer_views_[0].BufferLocation = d3d12_resource_->GetGPUVirtualAddress();
@@ -25,24 +28,44 @@ void VertexBuffer::CreateViews(size_t num_elements, size_t element_size)
 	vertex_buffer_views_[0].StrideInBytes = static_cast<UINT>(vertex_stride_);
 }
 
-void VertexBuffer::CreateViews(std::array<size_t, 4> num_elements, std::array<size_t, 4> element_size)
+void VertexBuffer::CreateViews(std::array<size_t, 4> num_elements, std::array<size_t, 4> element_size, uint64_t buffer_offset)
 {
+	gpu_offset_ = buffer_offset;
+	size_in_bytes_ = 0;
+
 	for (int i = 0; i < num_elements.size(); i++)
 	{
 		size_t num_vertices	= num_elements[i];
 		size_t elem_size	= element_size[i];
 
-		vertex_buffer_views_[i].BufferLocation = d3d12_resource_->GetGPUVirtualAddress() + gpu_offset_;
+		vertex_buffer_views_[i].BufferLocation = d3d12_resource_->GetGPUVirtualAddress() + gpu_offset_ + size_in_bytes_;
 		vertex_buffer_views_[i].SizeInBytes = static_cast<UINT>(num_vertices * elem_size);
 		vertex_buffer_views_[i].StrideInBytes = static_cast<UINT>(elem_size);
 
-		gpu_offset_ += num_vertices * elem_size;
+		size_in_bytes_ += num_vertices * elem_size;
 	}
 
 	num_vertices_ = num_elements[0];
 	vertex_stride_ = 0;
 }
 
+void VertexBuffer::MoveViews(Microsoft::WRL::ComPtr<ID3D12Resource> d3d12_resource)
+{
+	if (d3d12_resource == d3d12_resource_)
+		return;
+
+	const D3D12_GPU_VIRTUAL_ADDRESS old_address = d3d12_resource_->GetGPUVirtualAddress();
+
+	SetD3D12Resource(d3d12_resource);
+
+	const D3D12_GPU_VIRTUAL_ADDRESS new_address = d3d12_resource_->GetGPUVirtualAddress();
+
+	for (auto& view : vertex_buffer_views_)
+	{
+		view.BufferLocation = new_address + (view.BufferLocation - old_address);
+	}
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE VertexBuffer::GetShaderResourceView(const D3D12_SHADER_RESOURCE_VIEW_DESC* srv_desc) const
 {
 	throw std::exception("VertexBuffer::GetShaderResourceView should not be called.");
@@ -0,0 +1,160 @@
+#include "neel_engine_pch.h"
+
+#include "gltf_mapped_document.h"
+#include "gltf_sax_parser.h"
+
+MappedDocument::MappedDocument(const std::string& filename, bool memory_map)
+{
+	if (memory_map)
+	{
+		LoadMapped(filename);
+	}
+	else
+	{
+		if (StringEndsWith(filename, ".gltf"))
+			document_ = fx::gltf::LoadFromText(filename);
+		if (StringEndsWith(filename, ".glb"))
+			document_ = fx::gltf::LoadFromBinary(filename);
+
+		for (const auto& buffer : document_.buffers)
+		{
+			buffer_data_.push_back(buffer.data.data());
+		}
+	}
+
+	LoadImages();
+}
+
+void MappedDocument::LoadMapped(const std::string& filename)
+{
+	const std::string root_path = fx::gltf::detail::GetDocumentRootPath(filename);
+
+	const uint8_t* binary_chunk = nullptr;
+	size_t binary_chunk_size = 0;
+
+	if (StringEndsWith(filename, ".glb"))
+	{
+		mapped_files_.emplace_back(filename);
+
+		const uint8_t* data = mapped_files_.back().Data();
+		const size_t size = mapped_files_.back().Size();
+
+		fx::gltf::detail::GLBHeader header{};
+		if (size < fx::gltf::detail::HeaderSize)
+		{
+			throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+		}
+
+		std::memcpy(&header, data, fx::gltf::detail::HeaderSize);
+		if (header.magic != fx::gltf::detail::GLBHeaderMagic ||
+			header.jsonHeader.chunkType != fx::gltf::detail::GLBChunkJSON ||
+			fx::gltf::detail::HeaderSize + header.jsonHeader.chunkLength > size)
+		{
+			throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+		}
+
+		const uint8_t* json_begin = data + fx::gltf::detail::HeaderSize;
+		SaxDocumentParser::Parse(json_begin, json_begin + header.jsonHeader.chunkLength, document_);
+
+		// The binary chunk is optional.
+		const size_t binary_header_offset = fx::gltf::detail::HeaderSize + header.jsonHeader.chunkLength;
+		if (binary_header_offset + fx::gltf::detail::ChunkHeaderSize <= size)
+		{
+			fx::gltf::detail::ChunkHeader binary_header{};
+			std::memcpy(&binary_header, data + binary_header_offset, fx::gltf::detail::ChunkHeaderSize);
+
+			const size_t binary_offset = binary_header_offset + fx::gltf::detail::ChunkHeaderSize;
+			if (binary_header.chunkType != fx::gltf::detail::GLBChunkBIN ||
+				binary_offset + binary_header.chunkLength > size)
+			{
+				throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+			}
+
+			binary_chunk = data + binary_offset;
+			binary_chunk_size = binary_header.chunkLength;
+		}
+	}
+	else
+	{
+		// The JSON text is only needed while parsing.
+		const MemoryMappedFile text(filename);
+		SaxDocumentParser::Parse(text.Data(), text.Data() + text.Size(), document_);
+	}
+
+	buffer_data_.resize(document_.buffers.size(), nullptr);
+
+	for (size_t i = 0; i < document_.buffers.size(); i++)
+	{
+		fx::gltf::Buffer& buffer = document_.buffers[i];
+
+		if (buffer.byteLength == 0)
+		{
+			throw fx::gltf::invalid_gltf_document("Invalid buffer.byteLength value : 0");
+		}
+
+		if (buffer.uri.empty())
+		{
+			if (!binary_chunk || binary_chunk_size < buffer.byteLength)
+			{
+				throw fx::gltf::invalid_gltf_document("Invalid GLB buffer data");
+			}
+
+			buffer_data_[i] = binary_chunk;
+		}
+		else if (buffer.IsEmbeddedResource())
+		{
+			fx::gltf::detail::MaterializeData(buffer);
+			buffer_data_[i] = buffer.data.data();
+		}
+		else
+		{
+			mapped_files_.emplace_back(fx::gltf::detail::CreateBufferUriPath(root_path, buffer.uri));
+
+			if (mapped_files_.back().Size() < buffer.byteLength)
+			{
+				throw fx::gltf::invalid_gltf_document("Invalid buffer.uri value", buffer.uri);
+			}
+
+			buffer_data_[i] = mapped_files_.back().Data();
+		}
+	}
+}
+
+void MappedDocument::LoadImages()
+{
+	image_data_.resize(document_.images.size(), nullptr);
+	image_sizes_.resize(document_.images.size(), 0);
+	embedded_images_.reserve(document_.images.size());
+
+	for (size_t i = 0; i < document_.images.size(); i++)
+	{
+		const fx::gltf::Image& image = document_.images[i];
+
+		if (image.IsEmbeddedResource())
+		{
+			embedded_images_.emplace_back();
+			image.MaterializeData(embedded_images_.back());
+
+			image_data_[i]	= embedded_images_.back().data();
+			image_sizes_[i]	= embedded_images_.back().size();
+		}
+		else if (image.uri.empty())
+		{
+			// Image stored in a buffer view, e.g. in the binary chunk of a .glb file.
+			if (image.bufferView < 0 || image.bufferView >= document_.bufferViews.size())
+			{
+				throw fx::gltf::invalid_gltf_document("Invalid image.bufferView value");
+			}
+
+			const fx::gltf::BufferView& buffer_view = document_.bufferViews[image.bufferView];
+			if (buffer_view.buffer < 0 || buffer_view.buffer >= document_.buffers.size() ||
+				static_cast<uint64_t>(buffer_view.byteOffset) + buffer_view.byteLength > document_.buffers[buffer_view.buffer].byteLength)
+			{
+				throw fx::gltf::invalid_gltf_document("Invalid bufferView for image", image.name);
+			}
+
+			image_data_[i]	= buffer_data_[buffer_view.buffer] + buffer_view.byteOffset;
+			image_sizes_[i]	= buffer_view.byteLength;
+		}
+	}
+}
@@ -2,7 +2,7 @@
 
 #include "gltf_mesh_data.h"
 
-MeshData::MeshData(fx::gltf::Document const& doc, std::size_t mesh_index, std::size_t primitve_index)
+MeshData::MeshData(fx::gltf::Document const& doc, std::size_t mesh_index, std::size_t primitve_index, std::vector<const uint8_t*> const* buffer_data)
 {
 	const fx::gltf::Mesh& mesh = doc.meshes[mesh_index];
 	const fx::gltf::Primitive& primitive = mesh.primitives[primitve_index];
@@ -11,23 +11,31 @@ MeshData::MeshData(fx::gltf::Document const& doc, std::size_t mesh_index, std::s
 	{
 		if (attrib.first == "POSITION")
 		{
-			vertex_buffer_ = GetData(doc, doc.accessors[attrib.second]);
+			vertex_buffer_ = GetData(doc, doc.accessors[attrib.second], buffer_data);
 		}
 		else if (attrib.first == "NORMAL")
 		{
-			normal_buffer_ = GetData(doc, doc.accessors[attrib.second]);
+			normal_buffer_ = GetData(doc, doc.accessors[attrib.second], buffer_data);
 		}
 		else if (attrib.first == "TANGENT")
 		{
-			tangent_buffer_ = GetData(doc, doc.accessors[attrib.second]);
+			tangent_buffer_ = GetData(doc, doc.accessors[attrib.second], buffer_data);
 		}
 		else if (attrib.first == "TEXCOORD_0")
 		{
-			tex_coord0_buffer_ = GetData(doc, doc.accessors[attrib.second]);
+			tex_coord0_buffer_ = GetData(doc, doc.accessors[attrib.second], buffer_data);
+		}
+		else if (attrib.first == "JOINTS_0")
+		{
+			joints0_buffer_ = GetData(doc, doc.accessors[attrib.second], buffer_data);
+		}
+		else if (attrib.first == "WEIGHTS_0")
+		{
+			weights0_buffer_ = GetData(doc, doc.accessors[attrib.second], buffer_data);
 		}
 	}
 
-	index_buffer_ = GetData(doc, doc.accessors[primitive.indices]);
+	index_buffer_ = GetData(doc, doc.accessors[primitive.indices], buffer_data);
 
 	if (primitive.material >= 0)
 	{
@@ -39,18 +47,30 @@ MeshData::~MeshData()
 {
 }
 
-MeshData::BufferInfo MeshData::GetData(fx::gltf::Document const& doc, fx::gltf::Accessor const& accessor)
+MeshData::BufferInfo MeshData::GetData(fx::gltf::Document const& doc, fx::gltf::Accessor const& accessor, std::vector<const uint8_t*> const* buffer_data)
 {
 	const fx::gltf::BufferView& buffer_view = doc.bufferViews[accessor.bufferView];
-	const fx::gltf::Buffer& buffer = doc.buffers[buffer_view.buffer];
+
+	const uint8_t* data = buffer_data
+		? (*buffer_data)[buffer_view.buffer]
+		: doc.buffers[buffer_view.buffer].data.data();
 
 	const uint32_t data_type_size = CalculateDataTypeSize(accessor);
+
+	// Strided data (e.g. padded KHR_mesh_quantization attributes) is converted by Mesh::PackPrimitive.
+	const uint32_t data_stride = buffer_view.byteStride != 0 ? buffer_view.byteStride : data_type_size;
+	if (data_stride < data_type_size)
+	{
+		throw std::runtime_error("glTF buffer view stride is smaller than its elements");
+	}
+
 	return BufferInfo
 	{
 		&accessor
-		, &buffer.data[static_cast<uint64_t>(buffer_view.byteOffset) + accessor.byteOffset]
+		, data + static_cast<uint64_t>(buffer_view.byteOffset) + accessor.byteOffset
+		, data_stride
 		, data_type_size
-		,accessor.count * data_type_size
+		, accessor.count * data_type_size
 	};
 }
 
@@ -61,7 +81,7 @@ uint32_t MeshData::CalculateDataTypeSize(fx::gltf::Accessor const& accessor) noe
 	{
 		case fx::gltf::Accessor::ComponentType::Byte:
 		case fx::gltf::Accessor::ComponentType::UnsignedByte:
-			element_size = 2;
+			element_size = 1;
 			break;
 		case fx::gltf::Accessor::ComponentType::Short:
 		case fx::gltf::Accessor::ComponentType::UnsignedShort:
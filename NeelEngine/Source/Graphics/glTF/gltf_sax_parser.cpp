@@ -0,0 +1,249 @@
+#include "gltf_sax_parser.h"
+
+using AppendFunction = void(*)(const nlohmann::json& json, fx::gltf::Document& document);
+
+template <typename T, std::vector<T> fx::gltf::Document::*Collection>
+static void AppendElement(const nlohmann::json& json, fx::gltf::Document& document)
+{
+	(document.*Collection).push_back(json.get<T>());
+}
+
+struct CollectionParser
+{
+	const char*		Key;
+	AppendFunction	Append;
+	void			(*Clear)(fx::gltf::Document& document);
+};
+
+template <typename T, std::vector<T> fx::gltf::Document::*Collection>
+static void ClearCollection(fx::gltf::Document& document)
+{
+	(document.*Collection).clear();
+}
+
+#define COLLECTION_PARSER(key, type, member) { key, &AppendElement<type, &fx::gltf::Document::member>, &ClearCollection<type, &fx::gltf::Document::member> }
+
+// Top level arrays that are converted element by element.
+static const CollectionParser collection_parsers[] =
+{
+	COLLECTION_PARSER("accessors",		fx::gltf::Accessor,		accessors),
+	COLLECTION_PARSER("animations",		fx::gltf::Animation,	animations),
+	COLLECTION_PARSER("buffers",		fx::gltf::Buffer,		buffers),
+	COLLECTION_PARSER("bufferViews",	fx::gltf::BufferView,	bufferViews),
+	COLLECTION_PARSER("cameras",		fx::gltf::Camera,		cameras),
+	COLLECTION_PARSER("materials",		fx::gltf::Material,		materials),
+	COLLECTION_PARSER("meshes",			fx::gltf::Mesh,			meshes),
+	COLLECTION_PARSER("nodes",			fx::gltf::Node,			nodes),
+	COLLECTION_PARSER("images",			fx::gltf::Image,		images),
+	COLLECTION_PARSER("samplers",		fx::gltf::Sampler,		samplers),
+	COLLECTION_PARSER("scenes",			fx::gltf::Scene,		scenes),
+	COLLECTION_PARSER("skins",			fx::gltf::Skin,			skins),
+	COLLECTION_PARSER("textures",		fx::gltf::Texture,		textures),
+};
+
+#undef COLLECTION_PARSER
+
+static const CollectionParser* FindCollectionParser(const std::string& key)
+{
+	for (const auto& parser : collection_parsers)
+	{
+		if (key == parser.Key)
+			return &parser;
+	}
+
+	return nullptr;
+}
+
+/**
+* Receives the SAX events of the glTF JSON.
+* Elements of the top level collections are built into a small JSON value that is converted and
+* discarded as soon as the element is complete. All other top level values (asset, scene,
+* extensionsUsed, extensions, ...) are small and are collected in header_, which is converted
+* with the regular fx-gltf document conversion at the end.
+*/
+class DocumentSaxHandler : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+	explicit DocumentSaxHandler(fx::gltf::Document& document)
+		: document_(document)
+		, header_(nlohmann::json::object())
+		, collection_(nullptr)
+		, depth_(0)
+	{}
+
+	void Finish()
+	{
+		// Converts asset and the other non-collection fields, collections are not part of header_ and are left untouched.
+		fx::gltf::from_json(header_, document_);
+	}
+
+	bool null() override { return Value(nullptr); }
+	bool boolean(bool val) override { return Value(val); }
+	bool number_integer(number_integer_t val) override { return Value(val); }
+	bool number_unsigned(number_unsigned_t val) override { return Value(val); }
+	bool number_float(number_float_t val, const string_t&) override { return Value(val); }
+	bool string(string_t& val) override { return Value(std::move(val)); }
+
+	bool start_object(std::size_t) override
+	{
+		if (depth_ == 0)
+		{
+			depth_ = 1;
+			return true;
+		}
+
+		nlohmann::json* object = BuildValue(nlohmann::json::object());
+		stack_.push_back(object);
+		return true;
+	}
+
+	bool key(string_t& val) override
+	{
+		if (stack_.empty())
+		{
+			// Top level field.
+			key_ = std::move(val);
+			return true;
+		}
+
+		object_key_ = std::move(val);
+		return true;
+	}
+
+	bool end_object() override
+	{
+		if (stack_.empty())
+		{
+			// End of the document.
+			depth_ = 0;
+			return true;
+		}
+
+		stack_.pop_back();
+		if (stack_.empty())
+		{
+			ValueComplete();
+		}
+		return true;
+	}
+
+	bool start_array(std::size_t) override
+	{
+		if (depth_ == 0)
+		{
+			throw fx::gltf::invalid_gltf_document("Required field not found", "asset");
+		}
+
+		if (depth_ == 1 && stack_.empty())
+		{
+			collection_ = FindCollectionParser(key_);
+			if (collection_)
+			{
+				// A field that occurs multiple times keeps its last value, just like the DOM.
+				collection_->Clear(document_);
+				header_.erase(key_);
+
+				depth_ = 2;
+				return true;
+			}
+		}
+
+		nlohmann::json* array = BuildValue(nlohmann::json::array());
+		stack_.push_back(array);
+		return true;
+	}
+
+	bool end_array() override
+	{
+		if (stack_.empty())
+		{
+			// End of a top level collection.
+			collection_ = nullptr;
+			depth_ = 1;
+			return true;
+		}
+
+		stack_.pop_back();
+		if (stack_.empty())
+		{
+			ValueComplete();
+		}
+		return true;
+	}
+
+	bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override
+	{
+		throw fx::gltf::invalid_gltf_document("Invalid glTF document", ex.what());
+	}
+
+private:
+	bool Value(nlohmann::json&& value)
+	{
+		if (depth_ == 0)
+		{
+			throw fx::gltf::invalid_gltf_document("Required field not found", "asset");
+		}
+
+		BuildValue(std::move(value));
+		if (stack_.empty())
+		{
+			ValueComplete();
+		}
+		return true;
+	}
+
+	// Insert a value into the JSON value that is currently being built.
+	nlohmann::json* BuildValue(nlohmann::json&& value)
+	{
+		if (stack_.empty())
+		{
+			nlohmann::json& target = collection_ ? element_ : header_[key_];
+			target = std::move(value);
+			return &target;
+		}
+
+		nlohmann::json& parent = *stack_.back();
+		if (parent.is_array())
+		{
+			parent.emplace_back(std::move(value));
+			return &parent.back();
+		}
+
+		nlohmann::json& member = parent[object_key_];
+		member = std::move(value);
+		return &member;
+	}
+
+	void ValueComplete()
+	{
+		if (collection_)
+		{
+			collection_->Append(element_, document_);
+			element_ = nullptr;
+		}
+	}
+
+	fx::gltf::Document&				document_;
+
+	nlohmann::json					header_;
+	nlohmann::json					element_;
+
+	const CollectionParser*			collection_;
+	std::vector<nlohmann::json*>	stack_;
+
+	std::string						key_;
+	std::string						object_key_;
+
+	// 0 outside the document, 1 inside the top level object, 2 inside a top level collection.
+	int								depth_;
+};
+
+void SaxDocumentParser::Parse(const uint8_t* begin, const uint8_t* end, fx::gltf::Document& document)
+{
+	document = fx::gltf::Document();
+
+	DocumentSaxHandler handler(document);
+	nlohmann::json::sax_parse(begin, end, &handler);
+
+	handler.Finish();
+}
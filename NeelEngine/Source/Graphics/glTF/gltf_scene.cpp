@@ -2,6 +2,53 @@
 
 #include "gltf_scene.h"
 #include "camera.h"
+#include "scene_cache.h"
+#include "vertex_quantization.h"
+#include "mesh_optimizer.h"
+#include "meshlet_builder.h"
+#include "mesh_simplifier.h"
+#include "thread_pool.h"
+
+// The calling thread participates in the work, a single thread imports without a pool.
+static std::unique_ptr<ThreadPool> CreateImportThreadPool(uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	return num_threads > 1 ? std::make_unique<ThreadPool>(num_threads - 1) : nullptr;
+}
+
+// Add a glTF node and its children to the hierarchy in depth first order, node_map receives the hierarchy node of every glTF node.
+static void LoadNode(const fx::gltf::Document& document, uint32_t node_index, int32_t parent, TransformHierarchy& transforms,
+	std::vector<MeshInstance>& instances, std::vector<uint32_t>& node_map)
+{
+	const fx::gltf::Node& node = document.nodes[node_index];
+
+	uint32_t hierarchy_node;
+	if (node.matrix != fx::gltf::defaults::IdentityMatrix)
+	{
+		const XMFLOAT4X4 transform(node.matrix.data());
+		hierarchy_node = transforms.AddNode(parent, XMLoadFloat4x4(&transform));
+	}
+	else
+	{
+		hierarchy_node = transforms.AddNode(parent, XMFLOAT3(node.translation.data()), XMFLOAT4(node.rotation.data()), XMFLOAT3(node.scale.data()));
+	}
+
+	node_map[node_index] = hierarchy_node;
+
+	if (node.mesh >= 0)
+	{
+		instances.push_back({ hierarchy_node, node.mesh, node.skin });
+	}
+
+	for (const uint32_t child : node.children)
+	{
+		LoadNode(document, child, static_cast<int32_t>(hierarchy_node), transforms, instances, node_map);
+	}
+}
 
 Scene::Scene()
 	: CubeMesh(nullptr)
@@ -10,43 +57,92 @@ Scene::Scene()
 	, name_("Scene")
 	, total_number_meshes_(0)
 	, basic_geometry_loaded_(false)
+	, import_thread_count_(0)
+	, memory_map_buffers_(true)
+	, use_scene_cache_(true)
+	, quantize_vertices_(false)
 {}
 
 Scene::~Scene()
 {}
 
-void Scene::LoadFromFile(const std::string& filename, CommandList& command_list, bool load_basic_geometry)
+void Scene::ImportGltf(const std::string& filename, bool memory_map, bool quantize_vertices, ThreadPool* thread_pool, SceneData& scene_data)
 {
-	// Load glTF 2.0 document.
-	fx::gltf::Document document;
-
-	if (StringEndsWith(filename, ".gltf"))
-		document = fx::gltf::LoadFromText(filename);
-	if (StringEndsWith(filename, ".glb"))
-		document = fx::gltf::LoadFromBinary(filename);
+	// Vertex and index data is referenced in place, the document has to outlive the upload.
+	scene_data.Document = std::make_unique<MappedDocument>(filename, memory_map);
+	const fx::gltf::Document& document = scene_data.Document->GetDocument();
 
 	// Generate material data for current document.
 	{
-		materials_.resize(document.materials.size());
-		material_data_.resize(document.materials.size());
-		textures_.resize(document.textures.size());
-	
-		for(int i = 0; i < document.materials.size(); i++)
+		scene_data.Materials.resize(document.materials.size());
+		for (int i = 0; i < document.materials.size(); i++)
 		{
-			const fx::gltf::Material& material = document.materials[i];
-			materials_[i].Load(document, i, command_list, textures_, filename);
-			material_data_[i] = materials_[i].GetMaterialData();
+			Material material;
+			material.Load(*scene_data.Document, i, filename, scene_data.TextureRequests);
+			scene_data.Materials[i] = material.GetMaterialData();
 		}
+
+		// Textures shared between materials are only decoded and created once by the texture cache.
+		scene_data.NumTextures = static_cast<uint32_t>(document.textures.size());
 	}
-	
+
 	// Generate mesh data for current document.
 	{
-		meshes_.resize(document.meshes.size());
+		std::vector<std::pair<size_t, size_t>> primitive_jobs;
 
-		for (int i = 0; i < document.meshes.size(); i++)
+		scene_data.MeshNames.resize(document.meshes.size());
+		scene_data.BaseTransforms.resize(document.meshes.size());
+		scene_data.Primitives.resize(document.meshes.size());
+
+		for (size_t i = 0; i < document.meshes.size(); i++)
 		{
-			meshes_[i].Load(document, i, command_list, &materials_);
-			total_number_meshes_ += meshes_[i].GetSubMeshes().size();
+			scene_data.MeshNames[i] = document.meshes[i].name;
+			XMStoreFloat4x4(&scene_data.BaseTransforms[i], XMMatrixIdentity());
+			scene_data.Primitives[i].reserve(document.meshes[i].primitives.size());
+
+			for (size_t j = 0; j < document.meshes[i].primitives.size(); j++)
+			{
+				primitive_jobs.emplace_back(i, j);
+			}
+		}
+
+		// The optimizer can split a primitive into multiple submeshes.
+		std::vector<std::vector<Mesh::PrimitiveData>> job_primitives(primitive_jobs.size());
+
+		ParallelFor(thread_pool, primitive_jobs.size(), [&](size_t index)
+		{
+			const auto& job = primitive_jobs[index];
+
+			Mesh::PrimitiveData primitive;
+			Mesh::PackPrimitive(document, job.first, job.second, primitive, &scene_data.Document->GetBufferData());
+
+			job_primitives[index] = MeshOptimizer::OptimizePrimitive(primitive);
+
+			// Meshlets and levels of detail are built from the float positions, before quantization.
+			for (auto& chunk : job_primitives[index])
+			{
+				chunk.Meshlets = MeshletBuilder::Build(chunk);
+				MeshSimplifier::BuildLodChain(chunk);
+			}
+		});
+
+		for (size_t index = 0; index < primitive_jobs.size(); index++)
+		{
+			for (auto& primitive : job_primitives[index])
+			{
+				scene_data.Primitives[primitive_jobs[index].first].push_back(std::move(primitive));
+			}
+		}
+
+		if (quantize_vertices)
+		{
+			// Primitives of a mesh share the quantization bounds, so meshes are quantized as a whole.
+			ParallelFor(thread_pool, scene_data.Primitives.size(), [&](size_t index)
+			{
+				VertexQuantization::QuantizeMesh(scene_data.Primitives[index]);
+			});
+
+			scene_data.QuantizedVertices = true;
 		}
 	}
 
@@ -55,50 +151,212 @@ void Scene::LoadFromFile(const std::string& filename, CommandList& command_list,
 		// RESTRICTION: only load document.scenes[0] .
 		if (!document.scenes.empty())
 		{
-			const XMMATRIX root_transform = DirectX::XMMatrixIdentity();
-
-			std::vector<Node> nodes(document.nodes.size());
-
 			if (!document.scenes[0].name.empty())
 			{
-				name_ = document.scenes[0].name;
+				scene_data.Name = document.scenes[0].name;
 			}
 
+			scene_data.Transforms.Reserve(document.nodes.size());
+
+			std::vector<uint32_t> node_map(document.nodes.size(), UINT32_MAX);
+
 			for (const uint32_t scene_node : document.scenes[0].nodes)
 			{
-				Node::Load(document, scene_node, root_transform, nodes);
+				LoadNode(document, scene_node, TransformHierarchy::no_parent_, scene_data.Transforms, scene_data.Instances, node_map);
+			}
+
+			scene_data.Transforms.Update(thread_pool);
+
+			for (size_t i = 0; i < document.animations.size(); i++)
+			{
+				scene_data.Animations.push_back(Animation::Load(document, i, node_map, &scene_data.Document->GetBufferData()));
 			}
 
-			for (auto& node : nodes)
+			for (size_t i = 0; i < document.skins.size(); i++)
 			{
-				if (node.MeshIndex() >= 0)
-				{
-					mesh_instances_.push_back({ node.Transform(), node.MeshIndex() });
+				scene_data.Skins.push_back(Skinning::LoadSkin(document, i, node_map, &scene_data.Document->GetBufferData()));
+			}
 
-					// Set base transform for mesh.			
-					meshes_[node.mesh_index_].SetBaseTransform(node.Transform());
-				}
+			// Set base transform for mesh.
+			for (const auto& instance : scene_data.Instances)
+			{
+				XMStoreFloat4x4(&scene_data.BaseTransforms[instance.MeshIndex], scene_data.Transforms.GetWorldMatrix(instance.NodeIndex));
 			}
 		}
 		// If no scene graph is present, display all individual meshes.
 		else
 		{
 			static uint32_t scene_number = 0;
-			name_ = "Scene " + std::to_string(scene_number);
+			scene_data.Name = "Scene " + std::to_string(scene_number);
 
 			// No scene data - display individual meshes.
 			for (int32_t i = 0; i < document.meshes.size(); i++)
 			{
-				mesh_instances_.push_back({ XMMatrixIdentity(), i });
+				scene_data.Instances.push_back({ scene_data.Transforms.AddNode(TransformHierarchy::no_parent_), i });
+			}
+
+			scene_data.Transforms.Update(thread_pool);
+		}
+	}
+}
+
+void Scene::CreateResources(SceneData& scene_data, CommandList& command_list)
+{
+	if (!scene_data.Name.empty())
+	{
+		name_ = scene_data.Name;
+	}
+
+	// Generate material data for current document.
+	{
+		material_data_ = scene_data.Materials;
+
+		materials_.clear();
+		for (const auto& material_data : scene_data.Materials)
+		{
+			materials_.emplace_back(material_data);
+		}
+
+		textures_.resize(scene_data.NumTextures);
+		texture_cache_.CreateTextures(scene_data.TextureRequests, command_list, textures_);
+	}
+
+	// Generate mesh data for current document.
+	{
+		// The new scene replaces all meshes, including the basic geometry.
+		meshes_.clear();
+		meshes_.resize(scene_data.Primitives.size());
+
+		CubeMesh.reset();
+		SphereMesh.reset();
+		ConeMesh.reset();
+		basic_geometry_loaded_ = false;
+		total_number_meshes_ = 0;
+
+		// All geometry is uploaded in one batch into the pool, which is also read by ray tracing.
+		geometry_pool_.Reset();
+
+		std::vector<uint32_t> first_sub_meshes(scene_data.Primitives.size());
+
+		for (size_t i = 0; i < scene_data.Primitives.size(); i++)
+		{
+			first_sub_meshes[i] = Mesh::AddToPool(scene_data.Primitives[i], geometry_pool_);
+		}
+
+		UploadGeometry(command_list);
+
+		for (size_t i = 0; i < scene_data.Primitives.size(); i++)
+		{
+			meshes_[i].Create(scene_data.MeshNames[i], scene_data.Primitives[i], geometry_pool_, first_sub_meshes[i], &materials_);
+			meshes_[i].SetBaseTransform(XMLoadFloat4x4(&scene_data.BaseTransforms[i]));
+
+			total_number_meshes_ += meshes_[i].GetSubMeshes().size();
+		}
+	}
+
+	// Skinned instances copy their bind pose, instances of meshes without influences are drawn rigid.
+	{
+		skinning_.Clear();
+
+		for (auto& instance : scene_data.Instances)
+		{
+			instance.SkinnedIndex = -1;
+
+			if (instance.SkinIndex < 0 || instance.SkinIndex >= static_cast<int32_t>(scene_data.Skins.size()))
+				continue;
+
+			const auto& primitives = scene_data.Primitives[instance.MeshIndex];
+			const bool skinned = !primitives.empty() && std::all_of(primitives.begin(), primitives.end(), [](const Mesh::PrimitiveData& primitive)
+			{
+				return !primitive.Skin.empty();
+			});
+
+			if (skinned)
+			{
+				instance.SkinnedIndex = static_cast<int32_t>(skinning_.AddInstance(primitives, scene_data.Skins[instance.SkinIndex], instance.NodeIndex));
 			}
 		}
 	}
 
-	// Sort mesh instances based on pipelinestate object.
+	transforms_		= std::move(scene_data.Transforms);
+	mesh_instances_	= scene_data.Instances;
+	animations_		= std::move(scene_data.Animations);
+}
+
+void Scene::UpdateTransforms()
+{
+	if (!update_thread_pool_ && transforms_.GetNumDirtyNodes() > 0 && transforms_.GetNumNodes() > TransformHierarchy::parallel_grain_size_)
+	{
+		update_thread_pool_ = CreateImportThreadPool(import_thread_count_);
+	}
+
+	transforms_.Update(update_thread_pool_.get());
+}
+
+void Scene::UpdateSkinning()
+{
+	if (!update_thread_pool_ && skinning_.GetNumVertices() > Skinning::parallel_grain_size_)
+	{
+		update_thread_pool_ = CreateImportThreadPool(import_thread_count_);
+	}
+
+	skinning_.Update(transforms_, update_thread_pool_.get());
+}
+
+void Scene::Animate(float time, bool slerp)
+{
+	size_t num_channels = 0;
+	for (const auto& animation : animations_)
+	{
+		num_channels += animation.GetNumChannels();
+	}
+
+	if (!update_thread_pool_ && num_channels > Animation::parallel_grain_size_)
+	{
+		update_thread_pool_ = CreateImportThreadPool(import_thread_count_);
+	}
+
+	// Every animation loops over its own duration.
+	for (auto& animation : animations_)
+	{
+		const float duration = animation.GetDuration();
+		animation.Sample(duration > 0.0f ? std::fmod(time, duration) : 0.0f, transforms_, update_thread_pool_.get(), slerp);
+	}
+}
+
+void Scene::LoadFromFile(const std::string& filename, CommandList& command_list, bool load_basic_geometry)
+{
+	std::unique_ptr<ThreadPool> thread_pool = CreateImportThreadPool(import_thread_count_);
+
+	SceneData scene_data;
+
+	const bool cooked = use_scene_cache_ && SceneCache::Load(filename, quantize_vertices_, scene_data);
+	if (!cooked)
+	{
+		ImportGltf(filename, memory_map_buffers_, quantize_vertices_, thread_pool.get(), scene_data);
+
+		if (use_scene_cache_)
+		{
+			try
+			{
+				SceneCache::Save(filename, scene_data);
+			}
+			catch (const std::exception& e)
+			{
+				// Not being able to cook is not fatal, the scene is loaded from the glTF file next time as well.
+				OutputDebugStringA((std::string("Failed to write scene cache: ") + e.what() + "\n").c_str());
+			}
+		}
+	}
+
+	// Decode textures on the CPU first, all GPU resources are created afterwards on the calling thread.
+	texture_cache_.DecodeImages(scene_data.TextureRequests, thread_pool.get());
+
+	CreateResources(scene_data, command_list);
 
 	if(load_basic_geometry)
 	{
-		LoadBasicGeometry(command_list);		
+		LoadBasicGeometry(command_list);
 	}
 }
 
@@ -119,17 +377,35 @@ void Scene::LoadBasicGeometry(CommandList& command_list)
 
 std::unique_ptr<Mesh> Scene::LoadBasicGeometry(std::string& filepath, CommandList& command_list)
 {
-	// Load glTF 2.0 document.
-	fx::gltf::Document document;
+	MappedDocument document(filepath, memory_map_buffers_);
+	const fx::gltf::Document& doc = document.GetDocument();
+
+	std::vector<Mesh::PrimitiveData> primitives;
+	for (std::size_t i = 0; i < doc.meshes[0].primitives.size(); i++)
+	{
+		Mesh::PrimitiveData primitive;
+		Mesh::PackPrimitive(doc, 0, i, primitive, &document.GetBufferData());
+
+		for (auto& chunk : MeshOptimizer::OptimizePrimitive(primitive))
+		{
+			chunk.Meshlets = MeshletBuilder::Build(chunk);
+			MeshSimplifier::BuildLodChain(chunk);
+			primitives.push_back(std::move(chunk));
+		}
+	}
+
+	// Basic geometry is drawn with the same pipelines as the scene.
+	if (quantize_vertices_)
+	{
+		VertexQuantization::QuantizeMesh(primitives);
+	}
 
-	if (StringEndsWith(filepath, ".gltf"))
-		document = fx::gltf::LoadFromText(filepath);
-	if (StringEndsWith(filepath, ".glb"))
-		document = fx::gltf::LoadFromBinary(filepath);
+	const uint32_t first_sub_mesh = Mesh::AddToPool(primitives, geometry_pool_);
+	UploadGeometry(command_list);
 
 	Mesh m;
-	m.Load(document, 0, command_list);
-	
+	m.Create(doc.meshes[0].name, primitives, geometry_pool_, first_sub_mesh);
+
 	meshes_.push_back(m);
 
 	total_number_meshes_++;
@@ -137,6 +413,27 @@ std::unique_ptr<Mesh> Scene::LoadBasicGeometry(std::string& filepath, CommandLis
 	return std::make_unique<Mesh>(meshes_.back());
 }
 
+void Scene::UploadGeometry(CommandList& command_list)
+{
+	if (!geometry_pool_.Upload(command_list))
+		return;
 
+	for (auto& mesh : meshes_)
+	{
+		mesh.MoveGeometry(geometry_pool_);
+	}
 
+	for (auto* mesh : { CubeMesh.get(), SphereMesh.get(), ConeMesh.get() })
+	{
+		if (mesh)
+		{
+			mesh->MoveGeometry(geometry_pool_);
+		}
+	}
+}
 
+/**
+* Start a secondary ray slightly off the triangle a ray hit, on the side the ray came from. The direction is left to the caller.
+* @param normal Normal of the triangle that faces the ray.
+* @return False on a miss.
+*/
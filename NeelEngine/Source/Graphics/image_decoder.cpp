@@ -0,0 +1,1486 @@
+#include "image_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+static const uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+static uint32_t ReadBigEndian16(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0]) << 8 | data[1];
+}
+
+static uint32_t ReadBigEndian32(const uint8_t* data)
+{
+	return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 | static_cast<uint32_t>(data[2]) << 8 | data[3];
+}
+
+static void CheckDimensions(uint32_t width, uint32_t height)
+{
+	if (width == 0 || height == 0 || width > ImageDecoder::max_dimension_ || height > ImageDecoder::max_dimension_)
+	{
+		throw std::runtime_error("Invalid image dimensions.");
+	}
+}
+
+// Reads the bits of a deflate stream, least significant bit first.
+class DeflateBitReader
+{
+public:
+	DeflateBitReader(const uint8_t* data, size_t size)
+		: data_(data)
+		, end_(data + size)
+	{
+	}
+
+	// Buffer as many bytes as fit, at least 57 bits unless the data ends.
+	void Refill()
+	{
+		while (count_ <= 56 && data_ < end_)
+		{
+			bits_ |= static_cast<uint64_t>(*data_++) << count_;
+			count_ += 8;
+		}
+	}
+
+	uint32_t GetCount() const { return count_; }
+
+	// Bits past the end of the data are 0, consuming them throws.
+	uint32_t Peek(uint32_t num_bits) const { return static_cast<uint32_t>(bits_ & ((1ull << num_bits) - 1)); }
+
+	void Consume(uint32_t num_bits)
+	{
+		if (num_bits > count_)
+		{
+			throw std::runtime_error("Unexpected end of deflate data.");
+		}
+
+		bits_ >>= num_bits;
+		count_ -= num_bits;
+	}
+
+	uint32_t Read(uint32_t num_bits)
+	{
+		if (count_ < num_bits)
+		{
+			Refill();
+		}
+
+		const uint32_t value = Peek(num_bits);
+		Consume(num_bits);
+
+		return value;
+	}
+
+	// Skip to the next byte boundary, stored blocks start there.
+	void AlignToByte()
+	{
+		Consume(count_ % 8);
+	}
+
+	// Copy whole bytes, the reader has to be at a byte boundary.
+	void ReadBytes(uint8_t* output, size_t size)
+	{
+		for (; size > 0 && count_ >= 8; size--)
+		{
+			*output++ = static_cast<uint8_t>(bits_);
+			Consume(8);
+		}
+
+		if (size > static_cast<size_t>(end_ - data_))
+		{
+			throw std::runtime_error("Unexpected end of deflate data.");
+		}
+
+		std::memcpy(output, data_, size);
+		data_ += size;
+	}
+
+private:
+	const uint8_t*	data_;
+	const uint8_t*	end_;
+
+	uint64_t		bits_ = 0;
+	uint32_t		count_ = 0;
+};
+
+// Canonical Huffman code of deflate, codes up to fast_bits_ long are decoded with a single table lookup.
+struct DeflateHuffman
+{
+	static const uint32_t fast_bits_	= 10;
+	static const uint32_t max_bits_		= 15;
+	static const uint32_t max_symbols_	= 288;
+
+	// Symbol << 4 | length of the codes up to fast_bits_ long, indexed by the next fast_bits_ bits of the stream,
+	// 0 for longer codes.
+	uint16_t Fast[1 << fast_bits_];
+
+	// Number of codes of every length and the symbols in the order of their codes.
+	uint16_t Counts[max_bits_ + 1];
+	uint16_t Symbols[max_symbols_];
+
+	// Build the code of the lengths of num_symbols symbols, 0 for unused symbols.
+	void Build(const uint8_t* lengths, uint32_t num_symbols)
+	{
+		std::fill(std::begin(Counts), std::end(Counts), uint16_t(0));
+		for (uint32_t symbol = 0; symbol < num_symbols; symbol++)
+		{
+			Counts[lengths[symbol]]++;
+		}
+		Counts[0] = 0;
+
+		// Incomplete codes are allowed, like a distance code of a single symbol, over subscribed ones are not.
+		int32_t left = 1;
+		uint16_t offsets[max_bits_ + 2] = {};
+		for (uint32_t length = 1; length <= max_bits_; length++)
+		{
+			left = (left << 1) - Counts[length];
+			if (left < 0)
+			{
+				throw std::runtime_error("Invalid deflate Huffman code.");
+			}
+
+			offsets[length + 1] = offsets[length] + Counts[length];
+		}
+
+		for (uint32_t symbol = 0; symbol < num_symbols; symbol++)
+		{
+			if (lengths[symbol] != 0)
+			{
+				Symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+			}
+		}
+
+		// Codes are stored most significant bit first, so the table is indexed by the reversed code.
+		std::fill(std::begin(Fast), std::end(Fast), uint16_t(0));
+
+		uint32_t code = 0;
+		uint32_t index = 0;
+		for (uint32_t length = 1; length <= fast_bits_; length++)
+		{
+			for (uint32_t i = 0; i < Counts[length]; i++, index++, code++)
+			{
+				uint32_t reversed = 0;
+				for (uint32_t bit = 0; bit < length; bit++)
+				{
+					reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+				}
+
+				for (uint32_t entry = reversed; entry < (1u << fast_bits_); entry += 1u << length)
+				{
+					Fast[entry] = static_cast<uint16_t>(Symbols[index] << 4 | length);
+				}
+			}
+
+			code <<= 1;
+		}
+	}
+
+	uint32_t Decode(DeflateBitReader& reader) const
+	{
+		if (reader.GetCount() < max_bits_)
+		{
+			reader.Refill();
+		}
+
+		const uint32_t entry = Fast[reader.Peek(fast_bits_)];
+		if (entry != 0)
+		{
+			reader.Consume(entry & 15);
+			return entry >> 4;
+		}
+
+		// Longer codes are decoded a bit at a time, the first code of every length is the one after the codes of the
+		// previous length.
+		const uint32_t bits = reader.Peek(max_bits_);
+
+		int32_t code = 0;
+		int32_t first = 0;
+		int32_t index = 0;
+		for (uint32_t length = 1; length <= max_bits_; length++)
+		{
+			code |= (bits >> (length - 1)) & 1;
+
+			const int32_t count = Counts[length];
+			if (code - first < count)
+			{
+				reader.Consume(length);
+				return Symbols[index + code - first];
+			}
+
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+
+		throw std::runtime_error("Invalid deflate Huffman code.");
+	}
+};
+
+static const DeflateHuffman& GetFixedLiteralCode()
+{
+	static const DeflateHuffman code = []
+	{
+		uint8_t lengths[DeflateHuffman::max_symbols_];
+		std::fill(lengths, lengths + 144, uint8_t(8));
+		std::fill(lengths + 144, lengths + 256, uint8_t(9));
+		std::fill(lengths + 256, lengths + 280, uint8_t(7));
+		std::fill(lengths + 280, lengths + 288, uint8_t(8));
+
+		DeflateHuffman huffman;
+		huffman.Build(lengths, DeflateHuffman::max_symbols_);
+		return huffman;
+	}();
+
+	return code;
+}
+
+static const DeflateHuffman& GetFixedDistanceCode()
+{
+	static const DeflateHuffman code = []
+	{
+		uint8_t lengths[30];
+		std::fill(std::begin(lengths), std::end(lengths), uint8_t(5));
+
+		DeflateHuffman huffman;
+		huffman.Build(lengths, 30);
+		return huffman;
+	}();
+
+	return code;
+}
+
+// Read the literal/length and distance codes of a block with dynamic Huffman codes.
+static void ReadDynamicCodes(DeflateBitReader& reader, DeflateHuffman& literals, DeflateHuffman& distances)
+{
+	static const uint8_t length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	const uint32_t num_literals		= reader.Read(5) + 257;
+	const uint32_t num_distances	= reader.Read(5) + 1;
+	const uint32_t num_lengths		= reader.Read(4) + 4;
+
+	if (num_literals > 286 || num_distances > 30)
+	{
+		throw std::runtime_error("Invalid deflate block header.");
+	}
+
+	uint8_t code_lengths[19] = {};
+	for (uint32_t i = 0; i < num_lengths; i++)
+	{
+		code_lengths[length_order[i]] = static_cast<uint8_t>(reader.Read(3));
+	}
+
+	DeflateHuffman length_code;
+	length_code.Build(code_lengths, 19);
+
+	// The lengths of both codes are a single sequence, repeats may cross from one code to the other.
+	uint8_t lengths[286 + 30] = {};
+	uint32_t count = 0;
+	while (count < num_literals + num_distances)
+	{
+		const uint32_t symbol = length_code.Decode(reader);
+
+		if (symbol < 16)
+		{
+			lengths[count++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		uint8_t value = 0;
+		uint32_t repeat;
+		if (symbol == 16)
+		{
+			if (count == 0)
+			{
+				throw std::runtime_error("Invalid deflate code lengths.");
+			}
+
+			value = lengths[count - 1];
+			repeat = 3 + reader.Read(2);
+		}
+		else if (symbol == 17)
+		{
+			repeat = 3 + reader.Read(3);
+		}
+		else
+		{
+			repeat = 11 + reader.Read(7);
+		}
+
+		if (count + repeat > num_literals + num_distances)
+		{
+			throw std::runtime_error("Invalid deflate code lengths.");
+		}
+
+		std::fill(lengths + count, lengths + count + repeat, value);
+		count += repeat;
+	}
+
+	if (lengths[256] == 0)
+	{
+		throw std::runtime_error("Deflate block without end of block code.");
+	}
+
+	literals.Build(lengths, num_literals);
+	distances.Build(lengths + num_literals, num_distances);
+}
+
+// Decode the symbols of a compressed block up to its end of block code.
+static void InflateBlock(DeflateBitReader& reader, const DeflateHuffman& literals, const DeflateHuffman& distances, std::vector<uint8_t>& output)
+{
+	static const uint16_t length_base[29] =
+	{
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+	static const uint8_t length_extra_bits[29] =
+	{
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+	static const uint16_t distance_base[30] =
+	{
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+		8193, 12289, 16385, 24577
+	};
+	static const uint8_t distance_extra_bits[30] =
+	{
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+
+	for (;;)
+	{
+		const uint32_t symbol = literals.Decode(reader);
+
+		if (symbol < 256)
+		{
+			output.push_back(static_cast<uint8_t>(symbol));
+			continue;
+		}
+
+		if (symbol == 256)
+			return;
+
+		const uint32_t length_symbol = symbol - 257;
+		if (length_symbol >= 29)
+		{
+			throw std::runtime_error("Invalid deflate length.");
+		}
+
+		const uint32_t length = length_base[length_symbol] + reader.Read(length_extra_bits[length_symbol]);
+
+		const uint32_t distance_symbol = distances.Decode(reader);
+		if (distance_symbol >= 30)
+		{
+			throw std::runtime_error("Invalid deflate distance.");
+		}
+
+		const uint32_t distance = distance_base[distance_symbol] + reader.Read(distance_extra_bits[distance_symbol]);
+		if (distance > output.size())
+		{
+			throw std::runtime_error("Deflate distance before the start of the data.");
+		}
+
+		// The source may overlap the copy, which repeats the last distance bytes.
+		const size_t size = output.size();
+		output.resize(size + length);
+
+		uint8_t* destination = output.data() + size;
+		const uint8_t* source = destination - distance;
+		for (uint32_t i = 0; i < length; i++)
+		{
+			destination[i] = source[i];
+		}
+	}
+}
+
+std::vector<uint8_t> ImageDecoder::Inflate(const uint8_t* data, size_t size, size_t expected_size)
+{
+	// Deflate compression with a window of at most 32 KB and no preset dictionary.
+	if (size < 2 || (data[0] & 0x0f) != 8 || (data[0] >> 4) > 7 || ReadBigEndian16(data) % 31 != 0 || (data[1] & 0x20) != 0)
+	{
+		throw std::runtime_error("Invalid zlib header.");
+	}
+
+	DeflateBitReader reader(data + 2, size - 2);
+
+	std::vector<uint8_t> output;
+	output.reserve(expected_size);
+
+	DeflateHuffman literals, distances;
+
+	bool final_block;
+	do
+	{
+		final_block = reader.Read(1) != 0;
+
+		switch (reader.Read(2))
+		{
+		case 0:
+		{
+			reader.AlignToByte();
+
+			const uint32_t length = reader.Read(16);
+			if (reader.Read(16) != (~length & 0xffff))
+			{
+				throw std::runtime_error("Invalid deflate stored block.");
+			}
+
+			const size_t offset = output.size();
+			output.resize(offset + length);
+			reader.ReadBytes(output.data() + offset, length);
+			break;
+		}
+		case 1:
+			InflateBlock(reader, GetFixedLiteralCode(), GetFixedDistanceCode(), output);
+			break;
+		case 2:
+			ReadDynamicCodes(reader, literals, distances);
+			InflateBlock(reader, literals, distances, output);
+			break;
+		default:
+			throw std::runtime_error("Invalid deflate block type.");
+		}
+	} while (!final_block);
+
+	return output;
+}
+
+// Predict a byte from its left, upper and upper left neighbors, whichever is closest to left + up - up_left.
+static uint8_t PaethPredictor(int32_t left, int32_t up, int32_t up_left)
+{
+	const int32_t estimate = left + up - up_left;
+	const int32_t distance_left = std::abs(estimate - left);
+	const int32_t distance_up = std::abs(estimate - up);
+	const int32_t distance_up_left = std::abs(estimate - up_left);
+
+	if (distance_left <= distance_up && distance_left <= distance_up_left)
+		return static_cast<uint8_t>(left);
+
+	return static_cast<uint8_t>(distance_up <= distance_up_left ? up : up_left);
+}
+
+// Undo the filter of a row in place, previous is the unfiltered row above or zeros for the first row.
+static void UnfilterPngRow(uint32_t filter, uint8_t* row, const uint8_t* previous, size_t row_size, size_t pixel_size)
+{
+	switch (filter)
+	{
+	case 0:
+		break;
+	case 1:
+		for (size_t i = pixel_size; i < row_size; i++)
+		{
+			row[i] = static_cast<uint8_t>(row[i] + row[i - pixel_size]);
+		}
+		break;
+	case 2:
+		for (size_t i = 0; i < row_size; i++)
+		{
+			row[i] = static_cast<uint8_t>(row[i] + previous[i]);
+		}
+		break;
+	case 3:
+		for (size_t i = 0; i < row_size; i++)
+		{
+			const uint32_t left = i >= pixel_size ? row[i - pixel_size] : 0;
+			row[i] = static_cast<uint8_t>(row[i] + ((left + previous[i]) >> 1));
+		}
+		break;
+	case 4:
+		for (size_t i = 0; i < row_size; i++)
+		{
+			const int32_t left = i >= pixel_size ? row[i - pixel_size] : 0;
+			const int32_t up_left = i >= pixel_size ? previous[i - pixel_size] : 0;
+			row[i] = static_cast<uint8_t>(row[i] + PaethPredictor(left, previous[i], up_left));
+		}
+		break;
+	default:
+		throw std::runtime_error("Invalid PNG filter.");
+	}
+}
+
+// Color and transparency of a PNG, to expand the samples of its rows to RGBA.
+struct PngFormat
+{
+	uint32_t					ColorType;
+	uint32_t					BitDepth;
+	uint32_t					NumChannels;
+
+	std::array<uint8_t, 256 * 4>	Palette;
+	uint32_t					PaletteSize = 0;
+
+	// Gray or RGB sample values of transparent pixels from tRNS.
+	bool						HasColorKey = false;
+	uint32_t					ColorKey[3] = {};
+};
+
+// Expand the unfiltered row of a pass to RGBA pixels at x, x + step, ...
+static void ExpandPngRow(const PngFormat& format, const uint8_t* row, uint32_t width, uint8_t* pixels, uint32_t step)
+{
+	const uint32_t max_sample = (1u << format.BitDepth) - 1;
+
+	for (uint32_t x = 0; x < width; x++, pixels += step * 4)
+	{
+		if (format.BitDepth < 8)
+		{
+			// Samples are packed from the most significant bit, only gray and palette images have less than 8 bits.
+			const uint32_t bit = x * format.BitDepth;
+			const uint32_t sample = (row[bit / 8] >> (8 - format.BitDepth - bit % 8)) & max_sample;
+
+			if (format.ColorType == 3)
+			{
+				if (sample >= format.PaletteSize)
+				{
+					throw std::runtime_error("PNG palette index out of range.");
+				}
+
+				std::memcpy(pixels, &format.Palette[sample * 4], 4);
+			}
+			else
+			{
+				const uint8_t gray = static_cast<uint8_t>(sample * 255 / max_sample);
+				pixels[0] = pixels[1] = pixels[2] = gray;
+				pixels[3] = format.HasColorKey && sample == format.ColorKey[0] ? 0 : 255;
+			}
+
+			continue;
+		}
+
+		const uint8_t* samples = row + x * format.NumChannels;
+
+		switch (format.ColorType)
+		{
+		case 0:
+			pixels[0] = pixels[1] = pixels[2] = samples[0];
+			pixels[3] = format.HasColorKey && samples[0] == format.ColorKey[0] ? 0 : 255;
+			break;
+		case 2:
+			pixels[0] = samples[0];
+			pixels[1] = samples[1];
+			pixels[2] = samples[2];
+			pixels[3] = format.HasColorKey && samples[0] == format.ColorKey[0] && samples[1] == format.ColorKey[1] &&
+				samples[2] == format.ColorKey[2] ? 0 : 255;
+			break;
+		case 3:
+			if (samples[0] >= format.PaletteSize)
+			{
+				throw std::runtime_error("PNG palette index out of range.");
+			}
+
+			std::memcpy(pixels, &format.Palette[samples[0] * 4], 4);
+			break;
+		case 4:
+			pixels[0] = pixels[1] = pixels[2] = samples[0];
+			pixels[3] = samples[1];
+			break;
+		default:
+			std::memcpy(pixels, samples, 4);
+			break;
+		}
+	}
+}
+
+bool ImageDecoder::DecodePng(const uint8_t* data, size_t size, Image& image)
+{
+	if (GetFormat(data, size) != Format::Png)
+		return false;
+
+	PngFormat format;
+	uint32_t width = 0, height = 0;
+	bool interlaced = false;
+	bool has_header = false;
+
+	std::vector<uint8_t> compressed;
+
+	size_t position = sizeof(png_signature);
+	for (;;)
+	{
+		if (size - position < 12)
+		{
+			throw std::runtime_error("Unexpected end of PNG data.");
+		}
+
+		const uint32_t length = ReadBigEndian32(data + position);
+		const uint8_t* type = data + position + 4;
+		const uint8_t* chunk = data + position + 8;
+
+		if (length > size - position - 12)
+		{
+			throw std::runtime_error("Unexpected end of PNG data.");
+		}
+
+		position += 12 + static_cast<size_t>(length);
+
+		if (std::memcmp(type, "IHDR", 4) == 0)
+		{
+			if (length != 13)
+			{
+				throw std::runtime_error("Invalid PNG header.");
+			}
+
+			width				= ReadBigEndian32(chunk);
+			height				= ReadBigEndian32(chunk + 4);
+			format.BitDepth		= chunk[8];
+			format.ColorType	= chunk[9];
+			interlaced			= chunk[12] == 1;
+
+			CheckDimensions(width, height);
+
+			// Bit depths that are allowed for each color type, 16 bits are left to another decoder.
+			static const uint8_t bit_depths[7] = { 1 | 2 | 4 | 8 | 16, 0, 8 | 16, 1 | 2 | 4 | 8, 8 | 16, 0, 8 | 16 };
+			static const uint8_t num_channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+
+			if (format.ColorType > 6 || format.BitDepth > 16 || (format.BitDepth & (format.BitDepth - 1)) != 0 ||
+				((format.BitDepth == 16 ? 16 : format.BitDepth) & bit_depths[format.ColorType]) == 0 || chunk[10] != 0 || chunk[11] != 0 || chunk[12] > 1)
+			{
+				throw std::runtime_error("Invalid PNG header.");
+			}
+
+			if (format.BitDepth == 16)
+				return false;
+
+			format.NumChannels = num_channels[format.ColorType];
+			has_header = true;
+		}
+		else if (std::memcmp(type, "PLTE", 4) == 0)
+		{
+			if (length % 3 != 0 || length > 256 * 3)
+			{
+				throw std::runtime_error("Invalid PNG palette.");
+			}
+
+			format.PaletteSize = length / 3;
+			for (uint32_t i = 0; i < format.PaletteSize; i++)
+			{
+				format.Palette[i * 4]		= chunk[i * 3];
+				format.Palette[i * 4 + 1]	= chunk[i * 3 + 1];
+				format.Palette[i * 4 + 2]	= chunk[i * 3 + 2];
+				format.Palette[i * 4 + 3]	= 255;
+			}
+		}
+		else if (std::memcmp(type, "tRNS", 4) == 0 && has_header)
+		{
+			if (format.ColorType == 3)
+			{
+				// Alpha of the first palette entries, the rest stays opaque.
+				for (uint32_t i = 0; i < std::min(length, format.PaletteSize); i++)
+				{
+					format.Palette[i * 4 + 3] = chunk[i];
+				}
+			}
+			else if ((format.ColorType == 0 && length == 2) || (format.ColorType == 2 && length == 6))
+			{
+				format.HasColorKey = true;
+				for (uint32_t i = 0; i < length / 2; i++)
+				{
+					format.ColorKey[i] = ReadBigEndian16(chunk + i * 2);
+				}
+			}
+		}
+		else if (std::memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}
+		else if (std::memcmp(type, "IEND", 4) == 0)
+		{
+			break;
+		}
+	}
+
+	if (!has_header || compressed.empty() || (format.ColorType == 3 && format.PaletteSize == 0))
+	{
+		throw std::runtime_error("Incomplete PNG data.");
+	}
+
+	// Passes of Adam7 interlacing: first pixel and distance between the pixels in x and y.
+	static const uint32_t adam7_passes[7][4] =
+	{
+		{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 }
+	};
+	static const uint32_t single_pass[1][4] = { { 0, 0, 1, 1 } };
+
+	const uint32_t (*passes)[4] = interlaced ? adam7_passes : single_pass;
+	const uint32_t num_passes = interlaced ? 7 : 1;
+
+	const size_t bits_per_pixel = static_cast<size_t>(format.NumChannels) * format.BitDepth;
+	const size_t pixel_size = std::max<size_t>(bits_per_pixel / 8, 1);
+
+	const auto get_pass_size = [&](uint32_t pass, uint32_t& pass_width, uint32_t& pass_height)
+	{
+		pass_width	= width > passes[pass][0] ? (width - passes[pass][0] + passes[pass][2] - 1) / passes[pass][2] : 0;
+		pass_height	= height > passes[pass][1] ? (height - passes[pass][1] + passes[pass][3] - 1) / passes[pass][3] : 0;
+	};
+
+	// Every row of a pass starts with its filter type.
+	size_t filtered_size = 0;
+	for (uint32_t pass = 0; pass < num_passes; pass++)
+	{
+		uint32_t pass_width, pass_height;
+		get_pass_size(pass, pass_width, pass_height);
+
+		if (pass_width > 0 && pass_height > 0)
+		{
+			filtered_size += pass_height * (1 + (pass_width * bits_per_pixel + 7) / 8);
+		}
+	}
+
+	std::vector<uint8_t> filtered = Inflate(compressed.data(), compressed.size(), filtered_size);
+	if (filtered.size() < filtered_size)
+	{
+		throw std::runtime_error("Unexpected end of PNG image data.");
+	}
+
+	image.Width		= width;
+	image.Height	= height;
+	image.Pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	std::vector<uint8_t> previous;
+	uint8_t* row = filtered.data();
+
+	for (uint32_t pass = 0; pass < num_passes; pass++)
+	{
+		uint32_t pass_width, pass_height;
+		get_pass_size(pass, pass_width, pass_height);
+
+		if (pass_width == 0 || pass_height == 0)
+			continue;
+
+		const size_t row_size = (pass_width * bits_per_pixel + 7) / 8;
+		previous.assign(row_size, 0);
+
+		for (uint32_t y = 0; y < pass_height; y++, row += 1 + row_size)
+		{
+			UnfilterPngRow(row[0], row + 1, previous.data(), row_size, pixel_size);
+			std::memcpy(previous.data(), row + 1, row_size);
+
+			const size_t image_y = passes[pass][1] + static_cast<size_t>(y) * passes[pass][3];
+			ExpandPngRow(format, row + 1, pass_width, &image.Pixels[(image_y * width + passes[pass][0]) * 4], passes[pass][2]);
+		}
+	}
+
+	return true;
+}
+
+// Order of the coefficients of a block in the data, index of the coefficient in row major order.
+static const uint8_t jpeg_zigzag[64] =
+{
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// Reads the entropy coded data of a scan, most significant bit first, removing the 0 bytes stuffed after 0xff.
+class JpegBitReader
+{
+public:
+	JpegBitReader(const uint8_t* data, const uint8_t* end)
+		: data_(data)
+		, end_(end)
+	{
+	}
+
+	// Buffer at least 25 bits, a marker ends the data and the bits after it are 0.
+	void Refill()
+	{
+		while (count_ <= 24)
+		{
+			uint32_t byte = 0;
+
+			if (data_ < end_ && !at_marker_)
+			{
+				byte = *data_;
+
+				if (byte != 0xff)
+				{
+					data_++;
+				}
+				else if (data_ + 1 < end_ && data_[1] == 0)
+				{
+					data_ += 2;
+				}
+				else
+				{
+					at_marker_ = true;
+					byte = 0;
+				}
+			}
+
+			bits_ |= byte << (24 - count_);
+			count_ += 8;
+		}
+	}
+
+	uint32_t GetCount() const { return count_; }
+	uint32_t Peek() const { return bits_; }
+
+	void Consume(uint32_t num_bits)
+	{
+		bits_ <<= num_bits;
+		count_ -= num_bits;
+	}
+
+	uint32_t Read(uint32_t num_bits)
+	{
+		if (num_bits == 0)
+			return 0;
+
+		if (count_ < num_bits)
+		{
+			Refill();
+		}
+
+		const uint32_t value = bits_ >> (32 - num_bits);
+		Consume(num_bits);
+
+		return value;
+	}
+
+	// Skip the restart marker at the end of an interval, the next interval starts at a byte boundary.
+	void Restart()
+	{
+		bits_		= 0;
+		count_		= 0;
+		at_marker_	= false;
+
+		while (data_ < end_ && *data_ == 0xff && data_ + 1 < end_ && data_[1] == 0xff)
+		{
+			data_++;
+		}
+
+		if (data_ + 1 >= end_ || data_[0] != 0xff || data_[1] < 0xd0 || data_[1] > 0xd7)
+		{
+			throw std::runtime_error("Missing JPEG restart marker.");
+		}
+
+		data_ += 2;
+	}
+
+	const uint8_t* GetPosition() const { return data_; }
+
+private:
+	const uint8_t*	data_;
+	const uint8_t*	end_;
+
+	// Buffered bits from the most significant bit on.
+	uint32_t		bits_ = 0;
+	uint32_t		count_ = 0;
+	bool			at_marker_ = false;
+};
+
+// Huffman code of a JPEG table, codes up to fast_bits_ long are decoded with a single table lookup.
+struct JpegHuffman
+{
+	static const uint32_t fast_bits_ = 9;
+
+	// Length << 8 | symbol of the codes up to fast_bits_ long, indexed by the next fast_bits_ bits, 0 for longer codes.
+	uint16_t	Fast[1 << fast_bits_] = {};
+
+	// Largest code of every length, -1 for lengths without codes, and the index of its first symbol minus its first code.
+	int32_t		MaxCode[17] = {};
+	int32_t		SymbolOffset[17] = {};
+	uint8_t		Symbols[256] = {};
+
+	bool		Defined = false;
+
+	// Build the code of a DHT table: the number of codes of every length and the symbols in the order of their codes.
+	void Build(const uint8_t counts[16], const uint8_t* symbols, uint32_t num_symbols)
+	{
+		std::copy(symbols, symbols + num_symbols, Symbols);
+		std::fill(std::begin(Fast), std::end(Fast), uint16_t(0));
+
+		int32_t code = 0;
+		int32_t index = 0;
+		for (uint32_t length = 1; length <= 16; length++)
+		{
+			SymbolOffset[length] = index - code;
+
+			for (uint32_t i = 0; i < counts[length - 1]; i++, index++, code++)
+			{
+				if (length <= fast_bits_)
+				{
+					const uint32_t first = static_cast<uint32_t>(code) << (fast_bits_ - length);
+					for (uint32_t entry = first; entry < first + (1u << (fast_bits_ - length)); entry++)
+					{
+						Fast[entry] = static_cast<uint16_t>(length << 8 | Symbols[index]);
+					}
+				}
+			}
+
+			MaxCode[length] = counts[length - 1] > 0 ? code - 1 : -1;
+
+			if (code > (1 << length))
+			{
+				throw std::runtime_error("Invalid JPEG Huffman table.");
+			}
+
+			code <<= 1;
+		}
+
+		Defined = true;
+	}
+
+	uint32_t Decode(JpegBitReader& reader) const
+	{
+		if (reader.GetCount() < 16)
+		{
+			reader.Refill();
+		}
+
+		const uint32_t entry = Fast[reader.Peek() >> (32 - fast_bits_)];
+		if (entry != 0)
+		{
+			reader.Consume(entry >> 8);
+			return entry & 0xff;
+		}
+
+		for (uint32_t length = fast_bits_ + 1; length <= 16; length++)
+		{
+			const int32_t code = static_cast<int32_t>(reader.Peek() >> (32 - length));
+			if (code <= MaxCode[length])
+			{
+				reader.Consume(length);
+				return Symbols[SymbolOffset[length] + code];
+			}
+		}
+
+		throw std::runtime_error("Invalid JPEG Huffman code.");
+	}
+};
+
+struct JpegComponent
+{
+	uint32_t				Id;
+	uint32_t				SamplingX;
+	uint32_t				SamplingY;
+	uint32_t				QuantizationTable;
+
+	uint32_t				DcTable = 0;
+	uint32_t				AcTable = 0;
+	int32_t					DcPrediction = 0;
+
+	// Decoded samples, whole blocks of whole MCUs.
+	uint32_t				BlocksX = 0;
+	uint32_t				BlocksY = 0;
+	std::vector<uint8_t>	Samples;
+};
+
+// Value of a coefficient of size bits, the values with a leading 0 bit are negative.
+static int32_t ExtendJpegValue(uint32_t value, uint32_t size)
+{
+	return size == 0 || value >= (1u << (size - 1)) ? static_cast<int32_t>(value) : static_cast<int32_t>(value) - static_cast<int32_t>((1u << size) - 1);
+}
+
+/**
+* One dimensional inverse DCT of 8 values with the factorization of Arai, Agui and Nakajima (AAN), as in the floating
+* point IDCT of the IJG library. The inputs have to be scaled by the AAN factors of their frequencies.
+*/
+static void InverseDct8(const float* input, size_t input_stride, float* output, size_t output_stride)
+{
+	// Even part.
+	const float even10 = input[0] + input[input_stride * 4];
+	const float even11 = input[0] - input[input_stride * 4];
+	const float even13 = input[input_stride * 2] + input[input_stride * 6];
+	const float even12 = (input[input_stride * 2] - input[input_stride * 6]) * 1.414213562f - even13;
+
+	const float even0 = even10 + even13;
+	const float even3 = even10 - even13;
+	const float even1 = even11 + even12;
+	const float even2 = even11 - even12;
+
+	// Odd part.
+	const float z13 = input[input_stride * 5] + input[input_stride * 3];
+	const float z10 = input[input_stride * 5] - input[input_stride * 3];
+	const float z11 = input[input_stride] + input[input_stride * 7];
+	const float z12 = input[input_stride] - input[input_stride * 7];
+
+	const float odd7 = z11 + z13;
+	const float odd11 = (z11 - z13) * 1.414213562f;
+	const float z5 = (z10 + z12) * 1.847759065f;
+	const float odd10 = 1.082392200f * z12 - z5;
+	const float odd12 = -2.613125930f * z10 + z5;
+
+	const float odd6 = odd12 - odd7;
+	const float odd5 = odd11 - odd6;
+	const float odd4 = odd10 + odd5;
+
+	output[0]					= even0 + odd7;
+	output[output_stride * 7]	= even0 - odd7;
+	output[output_stride]		= even1 + odd6;
+	output[output_stride * 6]	= even1 - odd6;
+	output[output_stride * 2]	= even2 + odd5;
+	output[output_stride * 5]	= even2 - odd5;
+	output[output_stride * 4]	= even3 + odd4;
+	output[output_stride * 3]	= even3 - odd4;
+}
+
+// Inverse DCT of the dequantized and scaled coefficients of a block in row major order into samples.
+static void InverseDct(const float coefficients[64], uint8_t* samples, size_t stride)
+{
+	float columns[64];
+	for (size_t x = 0; x < 8; x++)
+	{
+		InverseDct8(coefficients + x, 8, columns + x, 8);
+	}
+
+	float rows[8];
+	for (size_t y = 0; y < 8; y++)
+	{
+		InverseDct8(columns + y * 8, 1, rows, 1);
+
+		for (size_t x = 0; x < 8; x++)
+		{
+			const float sample = rows[x] + 128.5f;
+			samples[y * stride + x] = static_cast<uint8_t>(std::min(std::max(sample, 0.0f), 255.0f));
+		}
+	}
+}
+
+// Decode the entropy coded data of a scan into the samples of its components.
+static const uint8_t* DecodeJpegScan(const uint8_t* data, const uint8_t* end, const std::vector<JpegComponent*>& components,
+	const JpegHuffman dc_tables[4], const JpegHuffman ac_tables[4], const std::array<std::array<float, 64>, 4>& quantization,
+	uint32_t mcus_x, uint32_t mcus_y, uint32_t restart_interval, uint32_t width, uint32_t height, uint32_t max_sampling_x, uint32_t max_sampling_y)
+{
+	JpegBitReader reader(data, end);
+
+	// A scan of a single component is not interleaved, its MCUs are single blocks that cover the component.
+	const bool interleaved = components.size() > 1;
+	if (!interleaved)
+	{
+		const JpegComponent& component = *components[0];
+		const uint32_t component_width = (width * component.SamplingX + max_sampling_x - 1) / max_sampling_x;
+		const uint32_t component_height = (height * component.SamplingY + max_sampling_y - 1) / max_sampling_y;
+
+		mcus_x = (component_width + 7) / 8;
+		mcus_y = (component_height + 7) / 8;
+	}
+
+	for (JpegComponent* component : components)
+	{
+		component->DcPrediction = 0;
+	}
+
+	const uint32_t num_mcus = mcus_x * mcus_y;
+	float coefficients[64];
+
+	for (uint32_t mcu = 0; mcu < num_mcus; mcu++)
+	{
+		if (restart_interval != 0 && mcu != 0 && mcu % restart_interval == 0)
+		{
+			reader.Restart();
+
+			for (JpegComponent* component : components)
+			{
+				component->DcPrediction = 0;
+			}
+		}
+
+		const uint32_t mcu_x = mcu % mcus_x;
+		const uint32_t mcu_y = mcu / mcus_x;
+
+		for (JpegComponent* component : components)
+		{
+			const uint32_t blocks_x = interleaved ? component->SamplingX : 1;
+			const uint32_t blocks_y = interleaved ? component->SamplingY : 1;
+
+			const JpegHuffman& dc_table = dc_tables[component->DcTable];
+			const JpegHuffman& ac_table = ac_tables[component->AcTable];
+			const float* quantization_table = quantization[component->QuantizationTable].data();
+
+			for (uint32_t block_y = 0; block_y < blocks_y; block_y++)
+			{
+				for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+				{
+					std::fill(std::begin(coefficients), std::end(coefficients), 0.0f);
+
+					const uint32_t dc_size = dc_table.Decode(reader);
+					if (dc_size > 11)
+					{
+						throw std::runtime_error("Invalid JPEG DC coefficient.");
+					}
+
+					component->DcPrediction += ExtendJpegValue(reader.Read(dc_size), dc_size);
+					coefficients[0] = component->DcPrediction * quantization_table[0];
+
+					for (uint32_t k = 1; k < 64; k++)
+					{
+						const uint32_t run_size = ac_table.Decode(reader);
+						const uint32_t run = run_size >> 4;
+						const uint32_t size = run_size & 15;
+
+						if (size == 0)
+						{
+							// End of block, or a run of 16 zeros.
+							if (run != 15)
+								break;
+
+							k += 15;
+							continue;
+						}
+
+						k += run;
+						if (k > 63)
+						{
+							throw std::runtime_error("Invalid JPEG AC coefficient.");
+						}
+
+						coefficients[jpeg_zigzag[k]] = ExtendJpegValue(reader.Read(size), size) * quantization_table[jpeg_zigzag[k]];
+					}
+
+					const size_t x = static_cast<size_t>(interleaved ? mcu_x * component->SamplingX + block_x : mcu_x) * 8;
+					const size_t y = static_cast<size_t>(interleaved ? mcu_y * component->SamplingY + block_y : mcu_y) * 8;
+					const size_t stride = static_cast<size_t>(component->BlocksX) * 8;
+
+					InverseDct(coefficients, &component->Samples[y * stride + x], stride);
+				}
+			}
+		}
+	}
+
+	return reader.GetPosition();
+}
+
+bool ImageDecoder::DecodeJpeg(const uint8_t* data, size_t size, Image& image)
+{
+	if (GetFormat(data, size) != Format::Jpeg)
+		return false;
+
+	// Quantization tables in row major order, scaled for the AAN inverse DCT.
+	std::array<std::array<float, 64>, 4> quantization{};
+	bool quantization_defined[4] = {};
+
+	JpegHuffman dc_tables[4], ac_tables[4];
+
+	std::vector<JpegComponent> components;
+	uint32_t width = 0, height = 0;
+	uint32_t max_sampling_x = 1, max_sampling_y = 1;
+	uint32_t mcus_x = 0, mcus_y = 0;
+	uint32_t restart_interval = 0;
+	int32_t adobe_transform = -1;
+	bool has_scan = false;
+
+	static const double aan_scale[8] =
+	{
+		1.0, 1.387039845, 1.306562965, 1.175875602, 1.0, 0.785694958, 0.541196100, 0.275899379
+	};
+
+	size_t position = 2;
+	for (;;)
+	{
+		// Markers may be preceded by any number of 0xff fill bytes.
+		while (position < size && data[position] == 0xff && position + 1 < size && data[position + 1] == 0xff)
+		{
+			position++;
+		}
+
+		if (size - position < 2 || data[position] != 0xff)
+		{
+			throw std::runtime_error("Invalid JPEG marker.");
+		}
+
+		const uint8_t marker = data[position + 1];
+		position += 2;
+
+		// End of image, and markers without a segment.
+		if (marker == 0xd9)
+			break;
+
+		if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+			continue;
+
+		if (size - position < 2)
+		{
+			throw std::runtime_error("Unexpected end of JPEG data.");
+		}
+
+		const size_t length = ReadBigEndian16(data + position);
+		if (length < 2 || length > size - position)
+		{
+			throw std::runtime_error("Unexpected end of JPEG data.");
+		}
+
+		const uint8_t* segment = data + position + 2;
+		const uint8_t* segment_end = data + position + length;
+		position += length;
+
+		switch (marker)
+		{
+		case 0xdb:
+			// Quantization tables, 8 or 16 bit values in zigzag order.
+			while (segment < segment_end)
+			{
+				const uint32_t value_size = (segment[0] >> 4) + 1;
+				const uint32_t table = segment[0] & 15;
+				segment++;
+
+				if (table > 3 || value_size > 2 || segment_end - segment < 64 * value_size)
+				{
+					throw std::runtime_error("Invalid JPEG quantization table.");
+				}
+
+				for (uint32_t k = 0; k < 64; k++)
+				{
+					const uint32_t value = value_size == 2 ? ReadBigEndian16(segment + k * 2) : segment[k];
+					const uint32_t index = jpeg_zigzag[k];
+
+					// The inverse DCT leaves a factor of 8 and the AAN factors of both frequencies to the coefficients.
+					quantization[table][index] = static_cast<float>(value * aan_scale[index / 8] * aan_scale[index % 8] / 8.0);
+				}
+
+				segment += 64 * value_size;
+				quantization_defined[table] = true;
+			}
+			break;
+		case 0xc4:
+			// Huffman tables.
+			while (segment < segment_end)
+			{
+				if (segment_end - segment < 17)
+				{
+					throw std::runtime_error("Invalid JPEG Huffman table.");
+				}
+
+				const uint32_t table_class = segment[0] >> 4;
+				const uint32_t table = segment[0] & 15;
+				const uint8_t* counts = segment + 1;
+
+				uint32_t num_symbols = 0;
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					num_symbols += counts[i];
+				}
+
+				if (table_class > 1 || table > 3 || num_symbols > 256 || static_cast<size_t>(segment_end - segment) < 17 + num_symbols)
+				{
+					throw std::runtime_error("Invalid JPEG Huffman table.");
+				}
+
+				(table_class == 0 ? dc_tables : ac_tables)[table].Build(counts, segment + 17, num_symbols);
+				segment += 17 + num_symbols;
+			}
+			break;
+		case 0xc0:
+		case 0xc1:
+		{
+			// Baseline and extended sequential frames with Huffman coding.
+			if (segment_end - segment < 6 || !components.empty())
+			{
+				throw std::runtime_error("Invalid JPEG frame.");
+			}
+
+			const uint32_t precision = segment[0];
+			height	= ReadBigEndian16(segment + 1);
+			width	= ReadBigEndian16(segment + 3);
+			const uint32_t num_components = segment[5];
+
+			// 12 bit samples, heights defined after the first scan and CMYK images are left to another decoder.
+			if (precision != 8 || height == 0 || (num_components != 1 && num_components != 3))
+				return false;
+
+			CheckDimensions(width, height);
+
+			if (segment_end - segment < 6 + 3 * num_components)
+			{
+				throw std::runtime_error("Invalid JPEG frame.");
+			}
+
+			components.resize(num_components);
+			for (uint32_t i = 0; i < num_components; i++)
+			{
+				JpegComponent& component = components[i];
+				component.Id				= segment[6 + i * 3];
+				component.SamplingX			= segment[7 + i * 3] >> 4;
+				component.SamplingY			= segment[7 + i * 3] & 15;
+				component.QuantizationTable	= segment[8 + i * 3];
+
+				if (component.SamplingX < 1 || component.SamplingX > 4 || component.SamplingY < 1 || component.SamplingY > 4 ||
+					component.QuantizationTable > 3)
+				{
+					throw std::runtime_error("Invalid JPEG frame.");
+				}
+
+				max_sampling_x = std::max(max_sampling_x, component.SamplingX);
+				max_sampling_y = std::max(max_sampling_y, component.SamplingY);
+			}
+
+			mcus_x = (width + max_sampling_x * 8 - 1) / (max_sampling_x * 8);
+			mcus_y = (height + max_sampling_y * 8 - 1) / (max_sampling_y * 8);
+
+			for (JpegComponent& component : components)
+			{
+				component.BlocksX = mcus_x * component.SamplingX;
+				component.BlocksY = mcus_y * component.SamplingY;
+				component.Samples.assign(static_cast<size_t>(component.BlocksX) * component.BlocksY * 64, 0);
+			}
+			break;
+		}
+		case 0xc2: case 0xc3: case 0xc5: case 0xc6: case 0xc7:
+		case 0xc9: case 0xca: case 0xcb: case 0xcd: case 0xce: case 0xcf:
+			// Progressive, lossless, hierarchical and arithmetic coded frames.
+			return false;
+		case 0xdd:
+			if (segment_end - segment < 2)
+			{
+				throw std::runtime_error("Invalid JPEG restart interval.");
+			}
+
+			restart_interval = ReadBigEndian16(segment);
+			break;
+		case 0xee:
+			// The Adobe marker tells whether 3 components are YCbCr or RGB.
+			if (segment_end - segment >= 12 && std::memcmp(segment, "Adobe", 5) == 0)
+			{
+				adobe_transform = segment[11];
+			}
+			break;
+		case 0xda:
+		{
+			if (components.empty() || segment_end - segment < 1)
+			{
+				throw std::runtime_error("JPEG scan before the frame.");
+			}
+
+			const uint32_t num_scan_components = segment[0];
+			if (num_scan_components < 1 || num_scan_components > components.size() || segment_end - segment < 4 + 2 * num_scan_components)
+			{
+				throw std::runtime_error("Invalid JPEG scan.");
+			}
+
+			std::vector<JpegComponent*> scan_components;
+			for (uint32_t i = 0; i < num_scan_components; i++)
+			{
+				const uint32_t id = segment[1 + i * 2];
+				const auto component = std::find_if(components.begin(), components.end(), [id](const JpegComponent& c) { return c.Id == id; });
+				if (component == components.end())
+				{
+					throw std::runtime_error("Invalid JPEG scan component.");
+				}
+
+				component->DcTable = segment[2 + i * 2] >> 4;
+				component->AcTable = segment[2 + i * 2] & 15;
+
+				if (component->DcTable > 3 || component->AcTable > 3 || !dc_tables[component->DcTable].Defined ||
+					!ac_tables[component->AcTable].Defined || !quantization_defined[component->QuantizationTable])
+				{
+					throw std::runtime_error("JPEG scan without tables.");
+				}
+
+				scan_components.push_back(&*component);
+			}
+
+			const uint8_t* scan_end = DecodeJpegScan(segment_end, data + size, scan_components, dc_tables, ac_tables, quantization,
+				mcus_x, mcus_y, restart_interval, width, height, max_sampling_x, max_sampling_y);
+
+			// Continue at the marker after the entropy coded data, skipping restart markers and stuffed bytes.
+			position = scan_end - data;
+			while (position + 1 < size && (data[position] != 0xff || data[position + 1] == 0 || data[position + 1] == 0xff ||
+				(data[position + 1] >= 0xd0 && data[position + 1] <= 0xd7)))
+			{
+				position++;
+			}
+
+			has_scan = true;
+			break;
+		}
+		default:
+			// Application data and comments.
+			break;
+		}
+	}
+
+	if (!has_scan)
+	{
+		throw std::runtime_error("JPEG without image data.");
+	}
+
+	image.Width		= width;
+	image.Height	= height;
+	image.Pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	// Subsampled components are replicated to the size of the image.
+	const auto get_sample = [&](const JpegComponent& component, uint32_t x, uint32_t y)
+	{
+		const size_t component_x = x * component.SamplingX / max_sampling_x;
+		const size_t component_y = y * component.SamplingY / max_sampling_y;
+
+		return component.Samples[component_y * component.BlocksX * 8 + component_x];
+	};
+
+	const bool ycbcr = components.size() == 3 && adobe_transform != 0 &&
+		!(components[0].Id == 'R' && components[1].Id == 'G' && components[2].Id == 'B');
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint8_t* pixel = &image.Pixels[static_cast<size_t>(y) * width * 4];
+
+		for (uint32_t x = 0; x < width; x++, pixel += 4)
+		{
+			pixel[3] = 255;
+
+			if (components.size() == 1)
+			{
+				pixel[0] = pixel[1] = pixel[2] = get_sample(components[0], x, y);
+				continue;
+			}
+
+			const float c0 = get_sample(components[0], x, y);
+			const float c1 = get_sample(components[1], x, y);
+			const float c2 = get_sample(components[2], x, y);
+
+			if (!ycbcr)
+			{
+				pixel[0] = static_cast<uint8_t>(c0);
+				pixel[1] = static_cast<uint8_t>(c1);
+				pixel[2] = static_cast<uint8_t>(c2);
+				continue;
+			}
+
+			// JFIF YCbCr to RGB.
+			const float cb = c1 - 128.0f;
+			const float cr = c2 - 128.0f;
+
+			const float rgb[3] =
+			{
+				c0 + 1.402f * cr,
+				c0 - 0.344136f * cb - 0.714136f * cr,
+				c0 + 1.772f * cb
+			};
+
+			for (size_t i = 0; i < 3; i++)
+			{
+				pixel[i] = static_cast<uint8_t>(std::min(std::max(rgb[i] + 0.5f, 0.0f), 255.0f));
+			}
+		}
+	}
+
+	return true;
+}
+
+ImageDecoder::Format ImageDecoder::GetFormat(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	if (bytes && size >= sizeof(png_signature) && std::memcmp(bytes, png_signature, sizeof(png_signature)) == 0)
+		return Format::Png;
+
+	if (bytes && size >= 3 && bytes[0] == 0xff && bytes[1] == 0xd8 && bytes[2] == 0xff)
+		return Format::Jpeg;
+
+	return Format::Unknown;
+}
+
+bool ImageDecoder::Decode(const void* data, size_t size, Image& image)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	switch (GetFormat(data, size))
+	{
+	case Format::Png:
+		return DecodePng(bytes, size, image);
+	case Format::Jpeg:
+		return DecodeJpeg(bytes, size, image);
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,294 @@
+#include "neel_engine_pch.h"
+
+#include "animation.h"
+#include "transform_hierarchy.h"
+#include "vertex_quantization.h"
+#include "gltf_mesh_data.h"
+#include "thread_pool.h"
+
+// Components of the values of a path.
+static uint32_t GetNumComponents(Animation::Path path)
+{
+	return path == Animation::Path::Rotation ? 4 : 3;
+}
+
+// Elements of an accessor as floats, normalized integers (KHR_mesh_quantization) are converted.
+static std::vector<float> ReadAccessor(const fx::gltf::Document& doc, int32_t accessor_index, uint32_t num_components,
+	const std::vector<const uint8_t*>* buffer_data)
+{
+	if (accessor_index < 0 || accessor_index >= static_cast<int32_t>(doc.accessors.size()))
+	{
+		throw std::runtime_error("glTF animation sampler references a missing accessor");
+	}
+
+	const fx::gltf::Accessor& accessor = doc.accessors[accessor_index];
+	const MeshData::BufferInfo buffer = MeshData::GetData(doc, accessor, buffer_data);
+
+	std::vector<float> values(static_cast<size_t>(accessor.count) * num_components);
+	VertexQuantization::DecodeComponents(buffer.Data, buffer.DataStride, accessor.count, num_components, accessor.componentType,
+		accessor.normalized, values.data());
+
+	return values;
+}
+
+Animation::Animation(const std::string& name)
+	: name_(name)
+{
+}
+
+Animation Animation::Load(const fx::gltf::Document& doc, size_t animation_index, const std::vector<uint32_t>& node_map,
+	const std::vector<const uint8_t*>* buffer_data)
+{
+	const fx::gltf::Animation& gltf_animation = doc.animations[animation_index];
+
+	Animation animation(gltf_animation.name);
+
+	// Samplers that share an input accessor share a track.
+	std::unordered_map<int32_t, uint32_t> tracks;
+
+	for (const auto& gltf_channel : gltf_animation.channels)
+	{
+		const int32_t gltf_node = gltf_channel.target.node;
+		if (gltf_node < 0 || gltf_node >= static_cast<int32_t>(node_map.size()) || node_map[gltf_node] == UINT32_MAX)
+			continue;
+
+		Path path;
+		if (gltf_channel.target.path == "translation")
+		{
+			path = Path::Translation;
+		}
+		else if (gltf_channel.target.path == "rotation")
+		{
+			path = Path::Rotation;
+		}
+		else if (gltf_channel.target.path == "scale")
+		{
+			path = Path::Scale;
+		}
+		else
+		{
+			continue;
+		}
+
+		if (gltf_channel.sampler < 0 || gltf_channel.sampler >= static_cast<int32_t>(gltf_animation.samplers.size()))
+		{
+			throw std::runtime_error("glTF animation channel references a missing sampler");
+		}
+
+		const fx::gltf::Animation::Sampler& sampler = gltf_animation.samplers[gltf_channel.sampler];
+
+		auto track = tracks.find(sampler.input);
+		if (track == tracks.end())
+		{
+			const std::vector<float> times = ReadAccessor(doc, sampler.input, 1, buffer_data);
+			track = tracks.emplace(sampler.input, animation.AddTrack(times.data(), times.size())).first;
+		}
+
+		Interpolation interpolation = Interpolation::Linear;
+		if (sampler.interpolation == fx::gltf::Animation::Sampler::Type::Step)
+		{
+			interpolation = Interpolation::Step;
+		}
+		else if (sampler.interpolation == fx::gltf::Animation::Sampler::Type::CubicSpline)
+		{
+			interpolation = Interpolation::CubicSpline;
+		}
+
+		const std::vector<float> values = ReadAccessor(doc, sampler.output, GetNumComponents(path), buffer_data);
+
+		const size_t keys_per_time = interpolation == Interpolation::CubicSpline ? 3 : 1;
+		if (values.size() != animation.tracks_[track->second].NumTimes * keys_per_time * GetNumComponents(path))
+		{
+			throw std::runtime_error("glTF animation sampler has a different number of inputs and outputs");
+		}
+
+		animation.AddChannel(track->second, node_map[gltf_node], path, interpolation, values.data());
+	}
+
+	return animation;
+}
+
+uint32_t Animation::AddTrack(const float* times, size_t num_times)
+{
+	if (num_times == 0)
+	{
+		throw std::invalid_argument("Animation tracks need at least one key.");
+	}
+
+	const Track track = { static_cast<uint32_t>(times_.size()), static_cast<uint32_t>(num_times) };
+
+	times_.insert(times_.end(), times, times + num_times);
+	duration_ = std::max(duration_, times[num_times - 1]);
+
+	tracks_.push_back(track);
+	track_keys_.push_back({ 0, 0, 0.0f, 0.0f });
+
+	return static_cast<uint32_t>(tracks_.size() - 1);
+}
+
+void Animation::AddChannel(uint32_t track, uint32_t node, Path path, Interpolation interpolation, const float* values)
+{
+	if (track >= tracks_.size())
+	{
+		throw std::invalid_argument("Animation channel references a missing track.");
+	}
+
+	const uint32_t num_components	= GetNumComponents(path);
+	const size_t num_values			= tracks_[track].NumTimes * (interpolation == Interpolation::CubicSpline ? 3 : 1);
+
+	Channel channel = {};
+	channel.Track		= track;
+	channel.Node		= node;
+	channel.FirstValue	= static_cast<uint32_t>(values_.size());
+	channel.Target		= path;
+	channel.Mode		= interpolation;
+
+	for (size_t i = 0; i < num_values; i++)
+	{
+		const float* value = values + i * num_components;
+		values_.push_back(XMFLOAT4A(value[0], value[1], value[2], num_components == 4 ? value[3] : 0.0f));
+	}
+
+	channels_.push_back(channel);
+	sampled_.resize(channels_.size());
+}
+
+void Animation::FindKeys(float time)
+{
+	for (size_t i = 0; i < tracks_.size(); i++)
+	{
+		const Track& track = tracks_[i];
+		const float* times = times_.data() + track.FirstTime;
+
+		TrackKey& key = track_keys_[i];
+
+		if (time <= times[0] || track.NumTimes == 1)
+		{
+			key = { 0, 0, 0.0f, 0.0f };
+			continue;
+		}
+
+		if (time >= times[track.NumTimes - 1])
+		{
+			key = { track.NumTimes - 1, track.NumTimes - 1, 0.0f, 0.0f };
+			continue;
+		}
+
+		// Playback usually moves forward by a key or less, otherwise search.
+		uint32_t k = key.Key;
+		if (!(times[k] <= time))
+		{
+			k = static_cast<uint32_t>(std::upper_bound(times, times + track.NumTimes, time) - times) - 1;
+		}
+		else if (!(time < times[k + 1]))
+		{
+			k++;
+			if (!(time < times[k + 1]))
+			{
+				k = static_cast<uint32_t>(std::upper_bound(times + k, times + track.NumTimes, time) - times) - 1;
+			}
+		}
+
+		const float duration = times[k + 1] - times[k];
+		key = { k, k + 1, duration > 0.0f ? (time - times[k]) / duration : 0.0f, duration };
+	}
+}
+
+void Animation::InterpolateRange(size_t begin, size_t end, bool slerp)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		const Channel& channel = channels_[i];
+		const TrackKey& key = track_keys_[channel.Track];
+		const XMFLOAT4A* values = values_.data() + channel.FirstValue;
+
+		XMVECTOR value;
+
+		if (channel.Mode == Interpolation::CubicSpline)
+		{
+			// In tangent, value and out tangent per key.
+			const XMVECTOR v0 = XMLoadFloat4A(&values[key.Key * 3 + 1]);
+
+			if (key.Key == key.Next)
+			{
+				value = v0;
+			}
+			else
+			{
+				const XMVECTOR duration = XMVectorReplicate(key.Duration);
+				const XMVECTOR out_tangent = XMLoadFloat4A(&values[key.Key * 3 + 2]) * duration;
+				const XMVECTOR in_tangent = XMLoadFloat4A(&values[key.Next * 3]) * duration;
+
+				value = XMVectorHermite(v0, out_tangent, XMLoadFloat4A(&values[key.Next * 3 + 1]), in_tangent, key.T);
+			}
+
+			if (channel.Target == Path::Rotation)
+			{
+				value = XMQuaternionNormalize(value);
+			}
+		}
+		else if (channel.Mode == Interpolation::Step || key.Key == key.Next)
+		{
+			value = XMLoadFloat4A(&values[key.Key]);
+		}
+		else
+		{
+			const XMVECTOR v0 = XMLoadFloat4A(&values[key.Key]);
+			XMVECTOR v1 = XMLoadFloat4A(&values[key.Next]);
+
+			if (channel.Target != Path::Rotation)
+			{
+				value = XMVectorLerp(v0, v1, key.T);
+			}
+			else if (slerp)
+			{
+				value = XMQuaternionSlerp(v0, v1, key.T);
+			}
+			else
+			{
+				// Take the shorter arc, q and -q are the same rotation.
+				v1 = XMVectorSelect(v1, -v1, XMVectorLess(XMVector4Dot(v0, v1), XMVectorZero()));
+				value = XMQuaternionNormalize(XMVectorLerp(v0, v1, key.T));
+			}
+		}
+
+		XMStoreFloat4A(&sampled_[i], value);
+	}
+}
+
+void Animation::Sample(float time, TransformHierarchy& transforms, ThreadPool* thread_pool, bool slerp)
+{
+	FindKeys(time);
+
+	if (thread_pool && channels_.size() > parallel_grain_size_)
+	{
+		thread_pool->ParallelForRange(channels_.size(), parallel_grain_size_, [this, slerp](size_t begin, size_t end)
+		{
+			InterpolateRange(begin, end, slerp);
+		});
+	}
+	else
+	{
+		InterpolateRange(0, channels_.size(), slerp);
+	}
+
+	// The hierarchy tracks changed nodes, so results are written on the calling thread.
+	for (size_t i = 0; i < channels_.size(); i++)
+	{
+		const Channel& channel = channels_[i];
+		const XMFLOAT4A& value = sampled_[i];
+
+		switch (channel.Target)
+		{
+			case Path::Translation:
+				transforms.SetTranslation(channel.Node, XMFLOAT3(value.x, value.y, value.z));
+				break;
+			case Path::Rotation:
+				transforms.SetRotation(channel.Node, value);
+				break;
+			case Path::Scale:
+				transforms.SetScale(channel.Node, XMFLOAT3(value.x, value.y, value.z));
+				break;
+		}
+	}
+}
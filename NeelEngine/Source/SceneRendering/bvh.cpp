@@ -0,0 +1,622 @@
+#include "neel_engine_pch.h"
+
+#include "bvh.h"
+#include "thread_pool.h"
+#include "vertex_quantization.h"
+
+#include <array>
+#include <numeric>
+
+// Entry distance of a ray into the box of a node within [t_min, t_max].
+static bool IntersectBox(const Bvh::Node& node, const XMFLOAT3& origin, const XMFLOAT3& inverse_direction, float t_min, float t_max, float& t_entry)
+{
+	const float tx0 = (node.BoundsMin.x - origin.x) * inverse_direction.x;
+	const float tx1 = (node.BoundsMax.x - origin.x) * inverse_direction.x;
+	const float ty0 = (node.BoundsMin.y - origin.y) * inverse_direction.y;
+	const float ty1 = (node.BoundsMax.y - origin.y) * inverse_direction.y;
+	const float tz0 = (node.BoundsMin.z - origin.z) * inverse_direction.z;
+	const float tz1 = (node.BoundsMax.z - origin.z) * inverse_direction.z;
+
+	t_entry = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), t_min));
+	const float t_exit = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), t_max));
+
+	return t_entry <= t_exit;
+}
+
+// Moller-Trumbore. Front faces have a positive determinant, their vertices are clockwise seen from the origin.
+bool Bvh::IntersectTriangle(const XMFLOAT3* vertices, const Ray& ray, bool cull_back_faces, float t_max, float& t, float& u, float& v)
+{
+	const XMVECTOR v0 = XMLoadFloat3(&vertices[0]);
+	const XMVECTOR edge1 = XMLoadFloat3(&vertices[1]) - v0;
+	const XMVECTOR edge2 = XMLoadFloat3(&vertices[2]) - v0;
+	const XMVECTOR direction = XMLoadFloat3(&ray.Direction);
+
+	const XMVECTOR p = XMVector3Cross(direction, edge2);
+	const float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+
+	if (cull_back_faces ? !(determinant > 0.0f) : determinant == 0.0f)
+		return false;
+
+	const float inverse_determinant = 1.0f / determinant;
+
+	const XMVECTOR s = XMLoadFloat3(&ray.Origin) - v0;
+	u = XMVectorGetX(XMVector3Dot(s, p)) * inverse_determinant;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	const XMVECTOR q = XMVector3Cross(s, edge1);
+	v = XMVectorGetX(XMVector3Dot(direction, q)) * inverse_determinant;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	t = XMVectorGetX(XMVector3Dot(edge2, q)) * inverse_determinant;
+
+	return t >= ray.TMin && t <= t_max;
+}
+
+// Shared by the tasks of a build.
+struct Bvh::BuildState
+{
+	// Box and box center of every triangle.
+	std::vector<XMFLOAT3>	BoundsMin;
+	std::vector<XMFLOAT3>	BoundsMax;
+	std::vector<XMFLOAT3>	Centroids;
+
+	std::atomic<uint32_t>	NumNodes{ 1 };
+	ThreadPool*				Pool;
+};
+
+// Triangles whose centroids fall into a bin along one axis.
+struct SahBin
+{
+	XMVECTOR	BoundsMin;
+	XMVECTOR	BoundsMax;
+	XMVECTOR	CentroidMin;
+	XMVECTOR	CentroidMax;
+	uint32_t	Count;
+};
+
+using SahBins = std::array<std::array<SahBin, Bvh::num_bins_>, 3>;
+
+static void ClearBins(SahBins& bins)
+{
+	for (auto& axis_bins : bins)
+	{
+		for (SahBin& bin : axis_bins)
+		{
+			bin.BoundsMin = bin.CentroidMin = XMVectorReplicate(FLT_MAX);
+			bin.BoundsMax = bin.CentroidMax = XMVectorReplicate(-FLT_MAX);
+			bin.Count = 0;
+		}
+	}
+}
+
+static void MergeBin(SahBin& bin, const SahBin& other)
+{
+	bin.BoundsMin	= XMVectorMin(bin.BoundsMin, other.BoundsMin);
+	bin.BoundsMax	= XMVectorMax(bin.BoundsMax, other.BoundsMax);
+	bin.CentroidMin	= XMVectorMin(bin.CentroidMin, other.CentroidMin);
+	bin.CentroidMax	= XMVectorMax(bin.CentroidMax, other.CentroidMax);
+	bin.Count		+= other.Count;
+}
+
+// Half the surface area of a box, empty boxes have none.
+static float XM_CALLCONV GetHalfArea(FXMVECTOR bounds_min, FXMVECTOR bounds_max)
+{
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, XMVectorMax(bounds_max - bounds_min, XMVectorZero()));
+
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+static uint32_t GetBin(float centroid, float centroid_min, float scale)
+{
+	return std::min(Bvh::num_bins_ - 1, static_cast<uint32_t>((centroid - centroid_min) * scale));
+}
+
+size_t XM_CALLCONV Bvh::AppendTriangles(const Mesh::PrimitiveData& primitive, FXMMATRIX transform, std::vector<XMFLOAT3>& positions, std::vector<uint32_t>* indices)
+{
+	if (primitive.Topology != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST || !primitive.Streams[Mesh::vertex_slot_] || !primitive.Indices)
+		return 0;
+
+	// Coarser levels follow level 0 in the index buffer.
+	const uint32_t first_index = primitive.Lods.empty() ? 0 : primitive.Lods[0].FirstIndex;
+	const uint32_t index_count = primitive.Lods.empty() ? primitive.IndexCount : primitive.Lods[0].IndexCount;
+	const uint32_t num_indices = index_count - index_count % 3;
+
+	const size_t num_vertices = primitive.NumElements[Mesh::vertex_slot_];
+	const size_t stride = primitive.ElementSize[Mesh::vertex_slot_];
+	const uint8_t* stream = primitive.Streams[Mesh::vertex_slot_];
+
+	const XMVECTOR position_scale = XMLoadFloat3(&primitive.PositionScale);
+	const XMVECTOR position_offset = XMLoadFloat3(&primitive.PositionOffset);
+
+	positions.reserve(positions.size() + num_indices);
+	if (indices)
+	{
+		indices->reserve(indices->size() + num_indices);
+	}
+
+	for (uint32_t i = first_index; i < first_index + num_indices; i++)
+	{
+		const uint32_t index = primitive.IndexFormat == DXGI_FORMAT_R16_UINT ?
+			reinterpret_cast<const uint16_t*>(primitive.Indices)[i] : reinterpret_cast<const uint32_t*>(primitive.Indices)[i];
+
+		if (index >= num_vertices)
+		{
+			throw std::runtime_error("Primitive index references a missing vertex.");
+		}
+
+		XMVECTOR position;
+		if (primitive.Quantized)
+		{
+			const int16_t* quantized = reinterpret_cast<const int16_t*>(stream + index * stride);
+
+			position = position_offset + position_scale * XMVectorSet(VertexQuantization::DecodeSnorm16(quantized[0]),
+				VertexQuantization::DecodeSnorm16(quantized[1]), VertexQuantization::DecodeSnorm16(quantized[2]), 0.0f);
+		}
+		else
+		{
+			position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(stream + index * stride));
+		}
+
+		positions.emplace_back();
+		XMStoreFloat3(&positions.back(), XMVector3TransformCoord(position, transform));
+
+		if (indices)
+		{
+			indices->push_back(index);
+		}
+	}
+
+	return num_indices / 3;
+}
+
+void Bvh::Build(const std::vector<XMFLOAT3>& positions, ThreadPool* thread_pool)
+{
+	Clear();
+
+	const size_t num_triangles = positions.size() / 3;
+	if (num_triangles == 0)
+		return;
+
+	if (num_triangles >= no_hit_ / 2)
+	{
+		throw std::invalid_argument("Too many triangles for a BVH.");
+	}
+
+	auto parallel_for_range = [thread_pool](size_t count, size_t grain_size, const std::function<void(size_t, size_t)>& function)
+	{
+		if (thread_pool)
+		{
+			thread_pool->ParallelForRange(count, grain_size, function);
+		}
+		else
+		{
+			function(0, count);
+		}
+	};
+
+	BuildState state;
+	state.Pool = thread_pool;
+	state.BoundsMin.resize(num_triangles);
+	state.BoundsMax.resize(num_triangles);
+	state.Centroids.resize(num_triangles);
+
+	// Bounds of the root, reduced per range.
+	const size_t grain_size = 65536;
+	const size_t num_ranges = (num_triangles + grain_size - 1) / grain_size;
+
+	std::vector<SahBin> range_bounds(num_ranges);
+
+	parallel_for_range(num_triangles, grain_size, [&](size_t begin, size_t end)
+	{
+		SahBin bounds;
+		bounds.BoundsMin = bounds.CentroidMin = XMVectorReplicate(FLT_MAX);
+		bounds.BoundsMax = bounds.CentroidMax = XMVectorReplicate(-FLT_MAX);
+		bounds.Count = static_cast<uint32_t>(end - begin);
+
+		for (size_t i = begin; i < end; i++)
+		{
+			const XMVECTOR p0 = XMLoadFloat3(&positions[i * 3]);
+			const XMVECTOR p1 = XMLoadFloat3(&positions[i * 3 + 1]);
+			const XMVECTOR p2 = XMLoadFloat3(&positions[i * 3 + 2]);
+
+			const XMVECTOR bounds_min = XMVectorMin(XMVectorMin(p0, p1), p2);
+			const XMVECTOR bounds_max = XMVectorMax(XMVectorMax(p0, p1), p2);
+			const XMVECTOR centroid = (bounds_min + bounds_max) * 0.5f;
+
+			XMStoreFloat3(&state.BoundsMin[i], bounds_min);
+			XMStoreFloat3(&state.BoundsMax[i], bounds_max);
+			XMStoreFloat3(&state.Centroids[i], centroid);
+
+			bounds.BoundsMin	= XMVectorMin(bounds.BoundsMin, bounds_min);
+			bounds.BoundsMax	= XMVectorMax(bounds.BoundsMax, bounds_max);
+			bounds.CentroidMin	= XMVectorMin(bounds.CentroidMin, centroid);
+			bounds.CentroidMax	= XMVectorMax(bounds.CentroidMax, centroid);
+		}
+
+		range_bounds[begin / grain_size] = bounds;
+	});
+
+	SahBin root = range_bounds[0];
+	for (size_t i = 1; i < num_ranges; i++)
+	{
+		MergeBin(root, range_bounds[i]);
+	}
+
+	triangle_indices_.resize(num_triangles);
+	std::iota(triangle_indices_.begin(), triangle_indices_.end(), 0u);
+
+	// Every split leaves triangles on both sides, so there are at most 2n - 1 nodes.
+	nodes_.resize(2 * num_triangles - 1);
+	XMStoreFloat3(&nodes_[0].BoundsMin, root.BoundsMin);
+	XMStoreFloat3(&nodes_[0].BoundsMax, root.BoundsMax);
+
+	BuildNode(state, 0, 0, static_cast<uint32_t>(num_triangles), root.CentroidMin, root.CentroidMax, 0);
+
+	// Children were numbered in the order the tasks ran, renumber them depth first.
+	std::vector<Node> nodes;
+	nodes.reserve(state.NumNodes);
+	nodes.push_back(nodes_[0]);
+
+	std::vector<std::pair<uint32_t, uint32_t>> stack(1, { 0, 0 });
+
+	while (!stack.empty())
+	{
+		const uint32_t node_index = stack.back().first;
+		const uint32_t new_index = stack.back().second;
+		stack.pop_back();
+
+		const Node& node = nodes_[node_index];
+		if (node.NumTriangles > 0)
+			continue;
+
+		const uint32_t first_child = static_cast<uint32_t>(nodes.size());
+
+		nodes[new_index].FirstChildOrTriangle = first_child;
+		nodes.push_back(nodes_[node.FirstChildOrTriangle]);
+		nodes.push_back(nodes_[node.FirstChildOrTriangle + 1]);
+
+		stack.push_back({ node.FirstChildOrTriangle + 1, first_child + 1 });
+		stack.push_back({ node.FirstChildOrTriangle, first_child });
+	}
+
+	nodes_ = std::move(nodes);
+
+	// Vertices in the order of the leaves.
+	positions_.resize(num_triangles * 3);
+	parallel_for_range(num_triangles, grain_size, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			std::memcpy(&positions_[i * 3], &positions[triangle_indices_[i] * 3], 3 * sizeof(XMFLOAT3));
+		}
+	});
+}
+
+void XM_CALLCONV Bvh::BuildNode(BuildState& state, uint32_t node_index, uint32_t first, uint32_t count, FXMVECTOR centroid_min, FXMVECTOR centroid_max,
+	uint32_t depth)
+{
+	if (count <= max_leaf_triangles_ || depth + 1 >= max_depth_)
+	{
+		nodes_[node_index].FirstChildOrTriangle	= first;
+		nodes_[node_index].NumTriangles			= count;
+		return;
+	}
+
+	XMFLOAT3 centroid_min_3, extent;
+	XMStoreFloat3(&centroid_min_3, centroid_min);
+	XMStoreFloat3(&extent, centroid_max - centroid_min);
+
+	// Axes without extent are not binned.
+	const float* axis_min = &centroid_min_3.x;
+	float scales[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float scale = num_bins_ / (&extent.x)[axis];
+		scales[axis] = (&extent.x)[axis] > 0.0f && scale <= FLT_MAX ? scale : 0.0f;
+	}
+
+	auto bin_triangles = [&](uint32_t begin, uint32_t end, SahBins& bins)
+	{
+		ClearBins(bins);
+
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const uint32_t triangle = triangle_indices_[i];
+			const XMFLOAT3& centroid = state.Centroids[triangle];
+
+			const XMVECTOR bounds_min = XMLoadFloat3(&state.BoundsMin[triangle]);
+			const XMVECTOR bounds_max = XMLoadFloat3(&state.BoundsMax[triangle]);
+			const XMVECTOR centroid_vector = XMLoadFloat3(&centroid);
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (scales[axis] == 0.0f)
+					continue;
+
+				SahBin& bin = bins[axis][GetBin((&centroid.x)[axis], axis_min[axis], scales[axis])];
+				bin.BoundsMin	= XMVectorMin(bin.BoundsMin, bounds_min);
+				bin.BoundsMax	= XMVectorMax(bin.BoundsMax, bounds_max);
+				bin.CentroidMin	= XMVectorMin(bin.CentroidMin, centroid_vector);
+				bin.CentroidMax	= XMVectorMax(bin.CentroidMax, centroid_vector);
+				bin.Count++;
+			}
+		}
+	};
+
+	SahBins bins;
+
+	if (state.Pool && count >= parallel_binning_triangles_)
+	{
+		const uint32_t grain_size = parallel_binning_triangles_ / 4;
+		std::vector<SahBins> range_bins((count + grain_size - 1) / grain_size);
+
+		state.Pool->ParallelForRange(count, grain_size, [&](size_t begin, size_t end)
+		{
+			bin_triangles(first + static_cast<uint32_t>(begin), first + static_cast<uint32_t>(end), range_bins[begin / grain_size]);
+		});
+
+		// Merged in range order, the bounds do not depend on the order anyway.
+		bins = range_bins[0];
+		for (size_t range = 1; range < range_bins.size(); range++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (uint32_t i = 0; i < num_bins_; i++)
+				{
+					MergeBin(bins[axis][i], range_bins[range][axis][i]);
+				}
+			}
+		}
+	}
+	else
+	{
+		bin_triangles(first, first + count, bins);
+	}
+
+	// Sweep the bins from both sides, a split after bin i costs area(left) * count(left) + area(right) * count(right).
+	float best_cost = FLT_MAX;
+	int best_axis = -1;
+	uint32_t best_bin = 0;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (scales[axis] == 0.0f)
+			continue;
+
+		float right_costs[num_bins_];
+		SahBin right = bins[axis][num_bins_ - 1];
+
+		for (uint32_t i = num_bins_ - 1; i > 0; i--)
+		{
+			right_costs[i - 1] = right.Count > 0 ? GetHalfArea(right.BoundsMin, right.BoundsMax) * right.Count : FLT_MAX;
+			MergeBin(right, bins[axis][i - 1]);
+		}
+
+		SahBin left = bins[axis][0];
+
+		for (uint32_t i = 0; i + 1 < num_bins_; i++)
+		{
+			if (i > 0)
+			{
+				MergeBin(left, bins[axis][i]);
+			}
+
+			if (left.Count == 0 || right_costs[i] == FLT_MAX)
+				continue;
+
+			const float cost = GetHalfArea(left.BoundsMin, left.BoundsMax) * left.Count + right_costs[i];
+			if (cost < best_cost)
+			{
+				best_cost	= cost;
+				best_axis	= axis;
+				best_bin	= i;
+			}
+		}
+	}
+
+	uint32_t middle;
+	SahBin left, right;
+
+	if (best_axis >= 0)
+	{
+		const float scale = scales[best_axis];
+		const float minimum = axis_min[best_axis];
+
+		middle = static_cast<uint32_t>(std::partition(triangle_indices_.begin() + first, triangle_indices_.begin() + first + count,
+			[&state, best_axis, scale, minimum, best_bin](uint32_t triangle)
+		{
+			return GetBin((&state.Centroids[triangle].x)[best_axis], minimum, scale) <= best_bin;
+		}) - triangle_indices_.begin());
+
+		left = bins[best_axis][0];
+		right = bins[best_axis][num_bins_ - 1];
+
+		for (uint32_t i = 1; i <= best_bin; i++)
+		{
+			MergeBin(left, bins[best_axis][i]);
+		}
+
+		for (uint32_t i = best_bin + 1; i + 1 < num_bins_; i++)
+		{
+			MergeBin(right, bins[best_axis][i]);
+		}
+	}
+	else
+	{
+		// All centroids coincide, split the range in half.
+		middle = first + count / 2;
+
+		SahBins halves;
+		ClearBins(halves);
+
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const uint32_t triangle = triangle_indices_[i];
+			SahBin& half = halves[0][i < middle ? 0 : 1];
+
+			half.BoundsMin		= XMVectorMin(half.BoundsMin, XMLoadFloat3(&state.BoundsMin[triangle]));
+			half.BoundsMax		= XMVectorMax(half.BoundsMax, XMLoadFloat3(&state.BoundsMax[triangle]));
+			half.CentroidMin	= XMVectorMin(half.CentroidMin, XMLoadFloat3(&state.Centroids[triangle]));
+			half.CentroidMax	= XMVectorMax(half.CentroidMax, XMLoadFloat3(&state.Centroids[triangle]));
+		}
+
+		left = halves[0][0];
+		right = halves[0][1];
+	}
+
+	const uint32_t first_child = state.NumNodes.fetch_add(2);
+
+	XMStoreFloat3(&nodes_[first_child].BoundsMin, left.BoundsMin);
+	XMStoreFloat3(&nodes_[first_child].BoundsMax, left.BoundsMax);
+	XMStoreFloat3(&nodes_[first_child + 1].BoundsMin, right.BoundsMin);
+	XMStoreFloat3(&nodes_[first_child + 1].BoundsMax, right.BoundsMax);
+
+	nodes_[node_index].FirstChildOrTriangle	= first_child;
+	nodes_[node_index].NumTriangles			= 0;
+
+	auto build_child = [&](size_t child)
+	{
+		if (child == 0)
+		{
+			BuildNode(state, first_child, first, middle - first, left.CentroidMin, left.CentroidMax, depth + 1);
+		}
+		else
+		{
+			BuildNode(state, first_child + 1, middle, first + count - middle, right.CentroidMin, right.CentroidMax, depth + 1);
+		}
+	};
+
+	if (state.Pool && count >= parallel_task_triangles_)
+	{
+		state.Pool->ParallelFor(2, build_child);
+	}
+	else
+	{
+		build_child(0);
+		build_child(1);
+	}
+}
+
+void Bvh::Clear()
+{
+	nodes_.clear();
+	positions_.clear();
+	triangle_indices_.clear();
+}
+
+double Bvh::GetSahCost() const
+{
+	if (nodes_.empty())
+		return 0.0;
+
+	const double root_area = GetHalfArea(XMLoadFloat3(&nodes_[0].BoundsMin), XMLoadFloat3(&nodes_[0].BoundsMax));
+
+	double cost = 0.0;
+	for (const Node& node : nodes_)
+	{
+		const double area = GetHalfArea(XMLoadFloat3(&node.BoundsMin), XMLoadFloat3(&node.BoundsMax));
+		cost += area * (node.NumTriangles > 0 ? 1.0 + node.NumTriangles : 1.0);
+	}
+
+	return root_area > 0.0 ? cost / root_area : static_cast<double>(nodes_.size() + triangle_indices_.size());
+}
+
+bool Bvh::Intersect(const Ray& ray, Hit& hit, bool cull_back_faces) const
+{
+	return Traverse<false>(ray, hit, cull_back_faces);
+}
+
+bool Bvh::Occluded(const Ray& ray) const
+{
+	Hit hit;
+	return Traverse<true>(ray, hit, false);
+}
+
+template <bool any_hit>
+bool Bvh::Traverse(const Ray& ray, Hit& hit, bool cull_back_faces) const
+{
+	hit.Triangle = no_hit_;
+
+	if (nodes_.empty())
+		return false;
+
+	const XMFLOAT3 inverse_direction(1.0f / ray.Direction.x, 1.0f / ray.Direction.y, 1.0f / ray.Direction.z);
+	float t_max = ray.TMax;
+
+	struct Entry
+	{
+		uint32_t	Node;
+		float		TEntry;
+	};
+
+	// At most one sibling per level waits on the stack.
+	Entry stack[max_depth_];
+	uint32_t stack_size = 0;
+
+	float t_entry;
+	if (IntersectBox(nodes_[0], ray.Origin, inverse_direction, ray.TMin, t_max, t_entry))
+	{
+		stack[stack_size++] = { 0, t_entry };
+	}
+
+	while (stack_size > 0)
+	{
+		const Entry entry = stack[--stack_size];
+
+		// A closer hit was found after the node was pushed.
+		if (entry.TEntry > t_max)
+			continue;
+
+		const Node& node = nodes_[entry.Node];
+
+		if (node.NumTriangles > 0)
+		{
+			for (uint32_t i = node.FirstChildOrTriangle; i < node.FirstChildOrTriangle + node.NumTriangles; i++)
+			{
+				float t, u, v;
+				if (!IntersectTriangle(&positions_[i * 3], ray, cull_back_faces, t_max, t, u, v))
+					continue;
+
+				hit.T			= t;
+				hit.U			= u;
+				hit.V			= v;
+				hit.Triangle	= triangle_indices_[i];
+
+				if (any_hit)
+					return true;
+
+				t_max = t;
+			}
+
+			continue;
+		}
+
+		const uint32_t children[2] = { node.FirstChildOrTriangle, node.FirstChildOrTriangle + 1 };
+		float t_entries[2];
+		bool hits[2];
+
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			hits[i] = IntersectBox(nodes_[children[i]], ray.Origin, inverse_direction, ray.TMin, t_max, t_entries[i]);
+		}
+
+		// The nearer child is pushed last and visited first.
+		const uint32_t near_child = hits[1] && (!hits[0] || t_entries[1] < t_entries[0]) ? 1 : 0;
+		const uint32_t far_child = 1 - near_child;
+
+		if (hits[far_child])
+		{
+			stack[stack_size++] = { children[far_child], t_entries[far_child] };
+		}
+
+		if (hits[near_child])
+		{
+			stack[stack_size++] = { children[near_child], t_entries[near_child] };
+		}
+	}
+
+	return hit.Triangle != no_hit_;
+}
@@ -0,0 +1,831 @@
+#include "neel_engine_pch.h"
+
+#include "cpu_ray_tracer.h"
+#include "ray_sorter.h"
+#include "scene_data.h"
+#include "commandlist.h"
+#include "thread_pool.h"
+#include "vertex_quantization.h"
+
+#include "DirectXTex.h"
+#include <DirectXPackedVector.h>
+
+#include <array>
+
+// Constants of Common.hlsli and Raytracing.hlsl.
+static const float pi				= 3.141592653589793f;
+static const float ray_t_min		= 0.01f;
+static const float offset_origin	= 1.0f / 32.0f;
+static const float float_scale		= 1.0f / 65536.0f;
+static const float int_scale		= 256.0f;
+
+// Clear values of the geometry buffer of ReflectionsDemo, pixels without geometry read them.
+static const XMFLOAT3 clear_normal(0.4f, 0.6f, 0.9f);
+static const XMFLOAT2 clear_metal_rough(0.4f, 0.6f);
+
+// OffsetRay of Common.hlsli, moves a hit point off its surface by a few ulps along the normal.
+static XMFLOAT3 OffsetRay(const XMFLOAT3& position, const XMFLOAT3& normal)
+{
+	const float* p = &position.x;
+	const float* n = &normal.x;
+
+	XMFLOAT3 offset_position;
+	float* o = &offset_position.x;
+
+	for (int i = 0; i < 3; i++)
+	{
+		const int32_t of_i = static_cast<int32_t>(int_scale * n[i]);
+
+		int32_t bits;
+		std::memcpy(&bits, &p[i], sizeof(bits));
+		bits += p[i] < 0.0f ? -of_i : of_i;
+
+		float p_i;
+		std::memcpy(&p_i, &bits, sizeof(p_i));
+
+		o[i] = std::abs(p[i]) < offset_origin ? p[i] + float_scale * n[i] : p_i;
+	}
+
+	return offset_position;
+}
+
+static float DistributionGGX(FXMVECTOR n, FXMVECTOR h, float roughness)
+{
+	const float a = roughness * roughness;
+	const float a2 = a * a;
+	const float n_dot_h = std::max(XMVectorGetX(XMVector3Dot(n, h)), 0.0f);
+
+	const float denominator = n_dot_h * n_dot_h * (a2 - 1.0f) + 1.0f;
+
+	return a2 / (pi * denominator * denominator);
+}
+
+static float GeometrySchlickGGX(float n_dot_v, float roughness)
+{
+	const float r = roughness + 1.0f;
+	const float k = r * r / 8.0f;
+
+	return n_dot_v / (n_dot_v * (1.0f - k) + k);
+}
+
+static float GeometrySmith(FXMVECTOR n, FXMVECTOR v, FXMVECTOR l, float roughness)
+{
+	const float n_dot_v = std::max(XMVectorGetX(XMVector3Dot(n, v)), 0.0f);
+	const float n_dot_l = std::max(XMVectorGetX(XMVector3Dot(n, l)), 0.0f);
+
+	return GeometrySchlickGGX(n_dot_l, roughness) * GeometrySchlickGGX(n_dot_v, roughness);
+}
+
+static XMVECTOR XM_CALLCONV FresnelSchlick(float cos_theta, FXMVECTOR f0)
+{
+	return f0 + (XMVectorReplicate(1.0f) - f0) * std::pow(1.0f - cos_theta, 5.0f);
+}
+
+// Any unit vector perpendicular to n.
+static XMVECTOR XM_CALLCONV GetPerpendicular(FXMVECTOR n)
+{
+	const XMVECTOR axis = std::abs(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	return XMVector3Normalize(XMVector3Cross(n, axis));
+}
+
+// Blender exports use +z as up, ClosesthitShader swaps the axes of normals and tangents.
+static XMVECTOR XM_CALLCONV SwizzleBlenderAxes(FXMVECTOR v)
+{
+	return XMVectorSet(XMVectorGetX(v), -XMVectorGetZ(v), XMVectorGetY(v), XMVectorGetW(v));
+}
+
+void CpuRayTracer::Build(const SceneData& scene_data, ThreadPool* thread_pool)
+{
+	Clear();
+
+	materials_ = scene_data.Materials;
+
+	std::vector<XMFLOAT3> positions;
+
+	for (size_t mesh = 0; mesh < scene_data.Primitives.size(); mesh++)
+	{
+		const XMMATRIX base_transform = XMLoadFloat4x4(&scene_data.BaseTransforms[mesh]);
+
+		for (const auto& primitive : scene_data.Primitives[mesh])
+		{
+			const uint32_t first_triangle = static_cast<uint32_t>(positions.size() / 3);
+
+			std::vector<uint32_t> indices;
+			if (Bvh::AppendTriangles(primitive, base_transform, positions, &indices) == 0)
+				continue;
+
+			geometries_.emplace_back();
+			Geometry& geometry = geometries_.back();
+
+			for (size_t slot = 0; slot < 4; slot++)
+			{
+				if (primitive.Streams[slot])
+				{
+					geometry.Streams[slot].assign(primitive.Streams[slot], primitive.Streams[slot] + primitive.StreamSize(slot));
+				}
+
+				geometry.Strides[slot] = static_cast<uint32_t>(primitive.ElementSize[slot]);
+			}
+
+			geometry.Indices		= std::move(indices);
+			geometry.Quantized		= primitive.Quantized;
+			geometry.PositionScale	= primitive.PositionScale;
+			geometry.PositionOffset	= primitive.PositionOffset;
+			geometry.HasTangents	= primitive.HasTangents && primitive.Streams[Mesh::tangent_slot_];
+			geometry.MaterialIndex	= primitive.MaterialIndex;
+			geometry.FirstTriangle	= first_triangle;
+
+			XMStoreFloat4x4(&geometry.ModelMatrix, base_transform);
+			XMStoreFloat4x4(&geometry.InverseTransposeModelMatrix, XMMatrixTranspose(XMMatrixInverse(nullptr, base_transform)));
+		}
+	}
+
+	bvh_.Build(positions, thread_pool);
+	wide_bvh_.Build(bvh_, bvh_width_);
+
+	// Decode every texture to 8 bits per component, keeping the encoding of the texels.
+	textures_.resize(scene_data.NumTextures);
+
+	ParallelFor(thread_pool, scene_data.TextureRequests.size(), [&](size_t index)
+	{
+		const TextureLoadRequest& request = scene_data.TextureRequests[index];
+		if (request.TextureIndex < 0 || request.TextureIndex >= static_cast<int>(textures_.size()))
+			return;
+
+		ScratchImage image;
+		if (request.Data)
+		{
+			CommandList::DecodeTextureFromMemory(request.Data, request.DataSize, image);
+		}
+		else
+		{
+			CommandList::DecodeTextureFromFile(request.Filename, image);
+		}
+
+		const Image* source = image.GetImage(0, 0, 0);
+		const bool srgb = IsSRGB(source->format);
+		const DXGI_FORMAT format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+
+		ScratchImage converted;
+		if (IsCompressed(source->format))
+		{
+			ThrowIfFailed(Decompress(*source, format, converted));
+			source = converted.GetImage(0, 0, 0);
+		}
+		else if (source->format != format)
+		{
+			ThrowIfFailed(Convert(*source, format, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, converted));
+			source = converted.GetImage(0, 0, 0);
+		}
+
+		CpuTexture& texture = textures_[request.TextureIndex];
+		texture.Width	= static_cast<uint32_t>(source->width);
+		texture.Height	= static_cast<uint32_t>(source->height);
+		texture.Srgb	= srgb || request.Usage == TextureUsage::Albedo;
+		texture.Texels.resize(static_cast<size_t>(texture.Width) * texture.Height);
+
+		for (uint32_t y = 0; y < texture.Height; y++)
+		{
+			std::memcpy(&texture.Texels[static_cast<size_t>(y) * texture.Width], source->pixels + y * source->rowPitch, texture.Width * sizeof(uint32_t));
+		}
+	});
+}
+
+void CpuRayTracer::Clear()
+{
+	bvh_.Clear();
+	wide_bvh_.Clear();
+	geometries_.clear();
+	materials_.clear();
+	textures_.clear();
+}
+
+CpuRayTracer::Surface CpuRayTracer::GetSurface(const Bvh::Hit& hit) const
+{
+	// Last geometry that starts at or before the triangle.
+	const auto geometry = std::upper_bound(geometries_.begin(), geometries_.end(), hit.Triangle, [](uint32_t triangle, const Geometry& g)
+	{
+		return triangle < g.FirstTriangle;
+	}) - 1;
+
+	const uint32_t* indices = &geometry->Indices[(hit.Triangle - geometry->FirstTriangle) * 3];
+	const float weights[3] = { 1.0f - hit.U - hit.V, hit.U, hit.V };
+
+	XMVECTOR normal = XMVectorZero(), tangent = XMVectorZero(), tex_coord = XMVectorZero();
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const uint32_t index = indices[i];
+
+		const uint8_t* normal_data		= geometry->Streams[Mesh::normal_slot_].data() + index * geometry->Strides[Mesh::normal_slot_];
+		const uint8_t* tangent_data		= geometry->Streams[Mesh::tangent_slot_].data() + index * geometry->Strides[Mesh::tangent_slot_];
+		const uint8_t* tex_coord_data	= geometry->Streams[Mesh::texcoord0_slot_].data() + index * geometry->Strides[Mesh::texcoord0_slot_];
+
+		XMFLOAT3 vertex_normal(0.0f, 0.0f, 1.0f);
+		XMFLOAT4 vertex_tangent(1.0f, 0.0f, 0.0f, 1.0f);
+		XMFLOAT2 vertex_tex_coord(0.0f, 0.0f);
+
+		if (geometry->Quantized)
+		{
+			if (!geometry->Streams[Mesh::normal_slot_].empty())
+			{
+				VertexQuantization::DecodeOctahedral(reinterpret_cast<const int16_t*>(normal_data), &vertex_normal.x);
+			}
+
+			if (geometry->HasTangents)
+			{
+				// The bitangent sign is the w component of the position.
+				const int16_t* position = reinterpret_cast<const int16_t*>(geometry->Streams[Mesh::vertex_slot_].data() + index * geometry->Strides[Mesh::vertex_slot_]);
+
+				VertexQuantization::DecodeOctahedral(reinterpret_cast<const int16_t*>(tangent_data), &vertex_tangent.x);
+				vertex_tangent.w = VertexQuantization::DecodeSnorm16(position[3]);
+			}
+
+			if (!geometry->Streams[Mesh::texcoord0_slot_].empty())
+			{
+				const PackedVector::HALF* half = reinterpret_cast<const PackedVector::HALF*>(tex_coord_data);
+				vertex_tex_coord = XMFLOAT2(PackedVector::XMConvertHalfToFloat(half[0]), PackedVector::XMConvertHalfToFloat(half[1]));
+			}
+		}
+		else
+		{
+			if (!geometry->Streams[Mesh::normal_slot_].empty())
+			{
+				std::memcpy(&vertex_normal, normal_data, sizeof(vertex_normal));
+			}
+
+			if (geometry->HasTangents)
+			{
+				std::memcpy(&vertex_tangent, tangent_data, sizeof(vertex_tangent));
+			}
+
+			if (!geometry->Streams[Mesh::texcoord0_slot_].empty())
+			{
+				std::memcpy(&vertex_tex_coord, tex_coord_data, sizeof(vertex_tex_coord));
+			}
+		}
+
+		normal		+= XMLoadFloat3(&vertex_normal) * weights[i];
+		tangent		+= XMLoadFloat4(&vertex_tangent) * weights[i];
+		tex_coord	+= XMLoadFloat2(&vertex_tex_coord) * weights[i];
+	}
+
+	// Without tangents the shaders read whatever follows the normals, any tangent of the normal stands in for it.
+	if (!geometry->HasTangents)
+	{
+		tangent = XMVectorSetW(GetPerpendicular(XMVector3Normalize(normal)), 1.0f);
+	}
+
+	Surface surface;
+	XMStoreFloat3(&surface.Normal, normal);
+	XMStoreFloat4(&surface.Tangent, tangent);
+	XMStoreFloat2(&surface.TexCoord, tex_coord);
+	surface.Source = &*geometry;
+
+	return surface;
+}
+
+XMVECTOR XM_CALLCONV CpuRayTracer::Sample(int texture_index, FXMVECTOR fallback, float u, float v) const
+{
+	if (texture_index < 0 || texture_index >= static_cast<int>(textures_.size()) || textures_[texture_index].Texels.empty())
+		return fallback;
+
+	const CpuTexture& texture = textures_[texture_index];
+
+	// sRGB texels are converted before they are filtered, like the texture units do.
+	static const auto srgb_to_linear = []()
+	{
+		std::array<float, 256> table;
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			const float c = i / 255.0f;
+			table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return table;
+	}();
+
+	auto load = [&texture](int64_t x, int64_t y)
+	{
+		const uint32_t texel = texture.Texels[static_cast<size_t>(y) * texture.Width + static_cast<size_t>(x)];
+
+		XMFLOAT4 color(static_cast<float>(texel & 0xff), static_cast<float>((texel >> 8) & 0xff), static_cast<float>((texel >> 16) & 0xff),
+			static_cast<float>(texel >> 24) / 255.0f);
+
+		if (texture.Srgb)
+		{
+			color.x = srgb_to_linear[texel & 0xff];
+			color.y = srgb_to_linear[(texel >> 8) & 0xff];
+			color.z = srgb_to_linear[(texel >> 16) & 0xff];
+		}
+		else
+		{
+			color.x /= 255.0f;
+			color.y /= 255.0f;
+			color.z /= 255.0f;
+		}
+
+		return XMLoadFloat4(&color);
+	};
+
+	// Texel centers are at half integer coordinates.
+	const float x = std::isfinite(u) ? u * texture.Width - 0.5f : 0.0f;
+	const float y = std::isfinite(v) ? v * texture.Height - 0.5f : 0.0f;
+	const float x_floor = std::floor(x);
+	const float y_floor = std::floor(y);
+
+	const int64_t width = texture.Width;
+	const int64_t height = texture.Height;
+
+	const int64_t x0 = ((static_cast<int64_t>(x_floor) % width) + width) % width;
+	const int64_t y0 = ((static_cast<int64_t>(y_floor) % height) + height) % height;
+	const int64_t x1 = (x0 + 1) % width;
+	const int64_t y1 = (y0 + 1) % height;
+
+	const XMVECTOR top = XMVectorLerp(load(x0, y0), load(x1, y0), x - x_floor);
+	const XMVECTOR bottom = XMVectorLerp(load(x0, y1), load(x1, y1), x - x_floor);
+
+	return XMVectorLerp(top, bottom, y - y_floor);
+}
+
+CpuRayTracer::ReflectionSample CpuRayTracer::ShadeReflectionHit(const Bvh::Ray& ray, const Bvh::Hit& hit) const
+{
+	const Surface surface = GetSurface(hit);
+
+	// The closest hit shader uses the mesh space attributes without the transform of the mesh.
+	const XMVECTOR ws_normal = XMVector3Normalize(SwizzleBlenderAxes(XMLoadFloat3(&surface.Normal)));
+	const XMVECTOR ws_tangent = XMVector4Normalize(SwizzleBlenderAxes(XMLoadFloat4(&surface.Tangent)));
+	const XMVECTOR ws_bitangent = XMVector3Normalize(XMVector3Cross(ws_normal, ws_tangent)) * XMVectorGetW(ws_tangent);
+
+	ReflectionSample sample;
+	sample.Direction = ray.Direction;
+	XMStoreFloat3(&sample.Position, XMLoadFloat3(&ray.Origin) + XMLoadFloat3(&ray.Direction) * hit.T);
+
+	// Material sampling.
+	static const MeshMaterialData default_material = []()
+	{
+		MeshMaterialData material;
+		material.BaseColorIndex = material.NormalIndex = material.MetalRoughIndex = material.OcclusionIndex = material.EmissiveIndex = -1;
+		material.BaseColorFactor = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		material.NormalScale = material.RoughnessFactor = material.MetallicFactor = 1.0f;
+		return material;
+	}();
+
+	const int material_index = surface.Source->MaterialIndex;
+	const MeshMaterialData& material = material_index >= 0 && material_index < static_cast<int>(materials_.size()) ? materials_[material_index] : default_material;
+
+	const float u = surface.TexCoord.x;
+	const float v = surface.TexCoord.y;
+
+	XMStoreFloat4(&sample.Diffuse, XMVectorSetW(Sample(material.BaseColorIndex, XMLoadFloat4(&material.BaseColorFactor), u, v), 0.0f));
+
+	const XMVECTOR metal_rough = Sample(material.MetalRoughIndex, XMVectorReplicate(1.0f), u, v);
+	sample.Roughness = XMVectorGetY(metal_rough) * material.RoughnessFactor;
+	sample.Metallic = XMVectorGetZ(metal_rough) * material.MetallicFactor;
+
+	XMFLOAT4 normal_map_sample;
+	XMStoreFloat4(&normal_map_sample, Sample(material.NormalIndex, XMVectorSet(0.5f, 0.5f, 1.0f, 1.0f), u, v));
+	normal_map_sample.y = 1.0f - normal_map_sample.y;
+
+	const XMVECTOR normal = (XMVectorSet(normal_map_sample.x, normal_map_sample.y, normal_map_sample.z, 0.0f) * 2.0f - XMVectorReplicate(1.0f)) * material.NormalScale;
+	XMStoreFloat3(&sample.Normal, XMVector3Normalize(XMVectorSplatX(normal) * ws_tangent + XMVectorSplatY(normal) * ws_bitangent + XMVectorSplatZ(normal) * ws_normal));
+
+	return sample;
+}
+
+bool CpuRayTracer::ShadeReflection(const ReflectionSample& sample, bool shadowed, int bounce, const SceneConstantBuffer& scene_constants,
+	const DirectionalLight& light, XMFLOAT4& pixel, Bvh::Ray& next_ray)
+{
+	const XMVECTOR direction = XMLoadFloat3(&sample.Direction);
+	const XMVECTOR world_normal = XMLoadFloat3(&sample.Normal);
+	const XMVECTOR light_direction = XMVector3Normalize(XMLoadFloat4(&light.DirectionWS));
+
+	const float roughness = sample.Roughness;
+	const float shadow = shadowed ? 0.0f : 1.0f;
+
+	// The shader tests !roughness < 0.1, which holds for every roughness but 0.
+	if (roughness != 0.0f)
+	{
+		const XMVECTOR diffuse_sample = XMLoadFloat4(&sample.Diffuse);
+		const XMVECTOR n = world_normal;
+		const XMVECTOR view = XMVector3Normalize(-direction);
+		const XMVECTOR h = XMVector3Normalize(view + light_direction);
+
+		const XMVECTOR radiance = XMVectorSetW(XMLoadFloat4(&light.Color), 0.0f);
+
+		const float perceptual_roughness = std::min(std::max(roughness, 0.04f), 1.0f);
+		const float metallic_clamped = std::min(std::max(sample.Metallic, 0.0f), 1.0f);
+
+		const XMVECTOR specular_color = XMVectorLerp(XMVectorReplicate(0.04f), diffuse_sample, metallic_clamped);
+
+		// Cook-Torrance BRDF.
+		const float ndf = DistributionGGX(n, h, perceptual_roughness);
+		const float g = GeometrySmith(n, view, light_direction, perceptual_roughness);
+		const XMVECTOR f = FresnelSchlick(std::min(std::max(XMVectorGetX(XMVector3Dot(h, view)), 0.0f), 1.0f), specular_color);
+
+		const float n_dot_v = std::max(XMVectorGetX(XMVector3Dot(n, view)), 0.0f);
+		const float n_dot_l = std::max(XMVectorGetX(XMVector3Dot(n, light_direction)), 0.0f);
+
+		const XMVECTOR specular = f * (ndf * g) / std::max(4.0f * n_dot_v * n_dot_l, 0.001f);
+
+		const XMVECTOR lo = (diffuse_sample / pi + specular) * radiance * n_dot_l;
+		const XMVECTOR ambient = diffuse_sample * 0.03f;
+
+		XMFLOAT3 color;
+		XMStoreFloat3(&color, ambient + lo * shadow);
+
+		pixel.x = color.x;
+		pixel.y = color.y;
+		pixel.z = color.z;
+	}
+
+	if (!(roughness < 0.1f && bounce < scene_constants.RayBounces))
+		return false;
+
+	next_ray.Origin	= OffsetRay(sample.Position, sample.Normal);
+	next_ray.TMin	= ray_t_min;
+	next_ray.TMax	= FLT_MAX;
+	XMStoreFloat3(&next_ray.Direction, XMVector3Normalize(XMVector3Reflect(direction, world_normal)));
+
+	return true;
+}
+
+Bvh::Ray CpuRayTracer::GetPrimaryRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const SceneConstantBuffer& scene_constants)
+{
+	// Center of the pixel in normalized device coordinates, y up.
+	const float screen_x = (x + 0.5f) / width * 2.0f - 1.0f;
+	const float screen_y = -((y + 0.5f) / height * 2.0f - 1.0f);
+
+	// Primary ray of GenerateCameraRay, through the near plane.
+	const XMVECTOR camera_position = scene_constants.CamPos;
+	const XMVECTOR near_point = XMVector3TransformCoord(XMVectorSet(screen_x, screen_y, 0.0f, 1.0f), scene_constants.InverseViewProj);
+
+	Bvh::Ray primary_ray;
+	primary_ray.TMin = 0.0f;
+	primary_ray.TMax = FLT_MAX;
+	XMStoreFloat3(&primary_ray.Origin, camera_position);
+	XMStoreFloat3(&primary_ray.Direction, XMVector3Normalize(near_point - camera_position));
+
+	return primary_ray;
+}
+
+CpuRayTracer::GeometrySample CpuRayTracer::ShadeGeometry(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const SceneConstantBuffer& scene_constants,
+	const Bvh::Ray& primary_ray, const Bvh::Hit& hit) const
+{
+	GeometrySample sample;
+
+	if (hit.Triangle != Bvh::no_hit_)
+	{
+		const Surface surface = GetSurface(hit);
+		const Geometry& geometry = *surface.Source;
+
+		XMStoreFloat3(&sample.World, XMLoadFloat3(&primary_ray.Origin) + XMLoadFloat3(&primary_ray.Direction) * hit.T);
+
+		// GeometryPass_VS transforms the attributes into world space.
+		const XMMATRIX model_matrix = XMLoadFloat4x4(&geometry.ModelMatrix);
+		const XMVECTOR normal_w = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&surface.Normal), XMLoadFloat4x4(&geometry.InverseTransposeModelMatrix)));
+		const XMVECTOR tangent_w = XMVector3TransformNormal(XMLoadFloat4(&surface.Tangent), model_matrix);
+		const XMVECTOR binormal_w = XMVector3Normalize(XMVector3Cross(normal_w, tangent_w) * surface.Tangent.w);
+
+		const int material_index = geometry.MaterialIndex;
+		const MeshMaterialData* material = material_index >= 0 && material_index < static_cast<int>(materials_.size()) ? &materials_[material_index] : nullptr;
+
+		// GeometryPass_PS.
+		XMVECTOR n = normal_w;
+		sample.MetalRough = XMFLOAT2(1.0f, 1.0f);
+
+		if (material)
+		{
+			const float u = surface.TexCoord.x;
+			const float v = surface.TexCoord.y;
+
+			if (material->MetalRoughIndex >= 0)
+			{
+				const XMVECTOR metal_rough = Sample(material->MetalRoughIndex, XMVectorReplicate(1.0f), u, v);
+				sample.MetalRough = XMFLOAT2(XMVectorGetY(metal_rough) * material->RoughnessFactor, XMVectorGetZ(metal_rough) * material->MetallicFactor);
+			}
+			else
+			{
+				sample.MetalRough = XMFLOAT2(material->RoughnessFactor, material->MetallicFactor);
+			}
+
+			if (material->NormalIndex >= 0)
+			{
+				XMFLOAT4 normal_map_sample;
+				XMStoreFloat4(&normal_map_sample, Sample(material->NormalIndex, XMVectorSet(0.5f, 0.5f, 1.0f, 1.0f), u, v));
+				normal_map_sample.y = 1.0f - normal_map_sample.y;
+
+				const XMVECTOR normal = (XMVectorSet(normal_map_sample.x, normal_map_sample.y, normal_map_sample.z, 0.0f) * 2.0f - XMVectorReplicate(1.0f)) * material->NormalScale;
+				n = XMVector3Normalize(XMVectorSplatX(normal) * XMVector3Normalize(tangent_w) + XMVectorSplatY(normal) * binormal_w + XMVectorSplatZ(normal) * normal_w);
+			}
+		}
+
+		XMStoreFloat3(&sample.Normal, n);
+	}
+	else
+	{
+		// Cleared pixels are at the far plane.
+		const float screen_x = (x + 0.5f) / width * 2.0f - 1.0f;
+		const float screen_y = -((y + 0.5f) / height * 2.0f - 1.0f);
+
+		XMStoreFloat3(&sample.World, XMVector3TransformCoord(XMVectorSet(screen_x, screen_y, 1.0f, 1.0f), scene_constants.InverseViewProj));
+		sample.Normal = clear_normal;
+		sample.MetalRough = clear_metal_rough;
+	}
+
+	return sample;
+}
+
+Bvh::Ray CpuRayTracer::GetShadowRay(const XMFLOAT3& position, const XMFLOAT3& normal, const DirectionalLight& light)
+{
+	Bvh::Ray shadow_ray;
+	shadow_ray.Origin	= OffsetRay(position, normal);
+	shadow_ray.TMin		= ray_t_min;
+	shadow_ray.TMax		= FLT_MAX;
+	XMStoreFloat3(&shadow_ray.Direction, XMVector3Normalize(XMLoadFloat4(&light.DirectionWS)));
+
+	return shadow_ray;
+}
+
+bool CpuRayTracer::GetReflectionRay(const GeometrySample& sample, const SceneConstantBuffer& scene_constants, Bvh::Ray& reflection_ray)
+{
+	// The shader tests !roughness < 0.3, only surfaces with a roughness of 0 reflect.
+	if (sample.MetalRough.x != 0.0f)
+		return false;
+
+	const XMVECTOR view_direction = XMVector3Normalize(XMLoadFloat3(&sample.World) - scene_constants.CamPos);
+
+	reflection_ray.Origin	= OffsetRay(sample.World, sample.Normal);
+	reflection_ray.TMin		= ray_t_min;
+	reflection_ray.TMax		= FLT_MAX;
+	XMStoreFloat3(&reflection_ray.Direction, XMVector3Normalize(XMVector3Reflect(view_direction, XMLoadFloat3(&sample.Normal))));
+
+	return true;
+}
+
+void CpuRayTracer::TraceReflections(std::vector<uint32_t>& pixels, std::vector<Bvh::Ray>& rays, const SceneConstantBuffer& scene_constants,
+	const DirectionalLight& light, std::vector<XMFLOAT4>& image, ThreadPool* thread_pool, Stats& stats) const
+{
+	// Origins are quantized within the bounds of the scene.
+	const std::vector<Bvh::Node>& nodes = bvh_.GetNodes();
+	const bool sort = sort_reflection_rays_ && !nodes.empty();
+
+	RaySorter sorter;
+	std::vector<Bvh::Ray> sorted_rays;
+	std::vector<Bvh::Hit> sorted_hits;
+
+	std::vector<Bvh::Hit> hits;
+	std::vector<uint32_t> hit_rays;
+	std::vector<Bvh::Ray> next_rays;
+	std::vector<uint8_t> bounces_on;
+
+	for (int bounce = 1; !rays.empty(); bounce++)
+	{
+		const size_t count = rays.size();
+		stats.ReflectionRays += count;
+
+		hits.resize(count);
+
+		const Bvh::Ray* traced_rays = rays.data();
+		Bvh::Hit* traced_hits = hits.data();
+
+		if (sort)
+		{
+			sorter.Sort(rays.data(), count, nodes[0].BoundsMin, nodes[0].BoundsMax);
+
+			sorted_rays.resize(count);
+			sorted_hits.resize(count);
+			sorter.Gather(rays.data(), sorted_rays.data());
+
+			traced_rays = sorted_rays.data();
+			traced_hits = sorted_hits.data();
+		}
+
+		ParallelFor(thread_pool, (count + reflection_batch_size_ - 1) / reflection_batch_size_, [&](size_t batch)
+		{
+			const size_t first = batch * reflection_batch_size_;
+			wide_bvh_.Intersect(traced_rays + first, std::min<size_t>(reflection_batch_size_, count - first), traced_hits + first, reflection_query_mode_, true);
+		});
+
+		if (sort)
+		{
+			sorter.Scatter(sorted_hits.data(), hits.data());
+		}
+
+		// MissShader, the rays that hit something are shaded below.
+		hit_rays.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (hits[i].Triangle != Bvh::no_hit_)
+			{
+				hit_rays.push_back(static_cast<uint32_t>(i));
+			}
+			else
+			{
+				XMFLOAT4& pixel = image[pixels[i]];
+				pixel.x = pixel.y = pixel.z = 0.0f;
+			}
+		}
+
+		stats.ShadowRays += hit_rays.size();
+
+		next_rays.resize(count);
+		bounces_on.assign(count, 0);
+
+		// ClosesthitShader, the shadow rays of a batch of hits are traced together.
+		ParallelFor(thread_pool, (hit_rays.size() + reflection_batch_size_ - 1) / reflection_batch_size_, [&](size_t batch)
+		{
+			const size_t first = batch * reflection_batch_size_;
+			const size_t batch_count = std::min<size_t>(reflection_batch_size_, hit_rays.size() - first);
+
+			std::vector<ReflectionSample> samples(batch_count);
+			std::vector<Bvh::Ray> shadow_rays(batch_count);
+			std::vector<uint8_t> shadowed(batch_count);
+
+			for (size_t i = 0; i < batch_count; i++)
+			{
+				const uint32_t ray = hit_rays[first + i];
+				samples[i] = ShadeReflectionHit(rays[ray], hits[ray]);
+				shadow_rays[i] = GetShadowRay(samples[i].Position, samples[i].Normal, light);
+			}
+
+			wide_bvh_.Occluded(shadow_rays.data(), batch_count, shadowed.data(), query_mode_);
+
+			for (size_t i = 0; i < batch_count; i++)
+			{
+				const uint32_t ray = hit_rays[first + i];
+				bounces_on[ray] = ShadeReflection(samples[i], shadowed[i] != 0, bounce, scene_constants, light, image[pixels[ray]], next_rays[ray]) ? 1 : 0;
+			}
+		});
+
+		// The next wave keeps the pixels in order.
+		size_t next_count = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (bounces_on[i])
+			{
+				pixels[next_count] = pixels[i];
+				rays[next_count] = next_rays[i];
+				next_count++;
+			}
+		}
+
+		pixels.resize(next_count);
+		rays.resize(next_count);
+	}
+}
+
+CpuRayTracer::Stats CpuRayTracer::Render(const SceneConstantBuffer& scene_constants, const DirectionalLight& light, uint32_t width, uint32_t height,
+	std::vector<XMFLOAT4>& image, ThreadPool* thread_pool) const
+{
+	image.assign(static_cast<size_t>(width) * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	const uint32_t tiles_x = (width + tile_size_ - 1) / tile_size_;
+	const uint32_t tiles_y = (height + tile_size_ - 1) / tile_size_;
+
+	std::vector<Stats> tile_stats(static_cast<size_t>(tiles_x) * tiles_y);
+
+	// Reflection ray of every pixel whose surface reflects, traced once all tiles are done.
+	std::vector<Bvh::Ray> pixel_reflection_rays(image.size());
+	std::vector<uint8_t> reflects(image.size(), 0);
+
+	ParallelFor(thread_pool, tile_stats.size(), [&](size_t tile)
+	{
+		const uint32_t x_begin = static_cast<uint32_t>(tile % tiles_x) * tile_size_;
+		const uint32_t y_begin = static_cast<uint32_t>(tile / tiles_x) * tile_size_;
+		const uint32_t x_end = std::min(x_begin + tile_size_, width);
+		const uint32_t y_end = std::min(y_begin + tile_size_, height);
+		const uint32_t tile_width = x_end - x_begin;
+		const uint32_t num_pixels = tile_width * (y_end - y_begin);
+
+		Bvh::Ray rays[tile_size_ * tile_size_];
+		Bvh::Hit hits[tile_size_ * tile_size_];
+		GeometrySample samples[tile_size_ * tile_size_];
+		uint8_t shadowed[tile_size_ * tile_size_];
+
+		// The primary rays and then the shadow rays of the tile are traced together, rows of pixels are coherent.
+		for (uint32_t i = 0; i < num_pixels; i++)
+		{
+			rays[i] = GetPrimaryRay(x_begin + i % tile_width, y_begin + i / tile_width, width, height, scene_constants);
+		}
+
+		wide_bvh_.Intersect(rays, num_pixels, hits, query_mode_, true);
+
+		for (uint32_t i = 0; i < num_pixels; i++)
+		{
+			samples[i] = ShadeGeometry(x_begin + i % tile_width, y_begin + i / tile_width, width, height, scene_constants, rays[i], hits[i]);
+			rays[i] = GetShadowRay(samples[i].World, samples[i].Normal, light);
+		}
+
+		wide_bvh_.Occluded(rays, num_pixels, shadowed, query_mode_);
+
+		Stats& stats = tile_stats[tile];
+		stats.PrimaryRays	+= num_pixels;
+		stats.ShadowRays	+= num_pixels;
+
+		for (uint32_t i = 0; i < num_pixels; i++)
+		{
+			const size_t pixel = static_cast<size_t>(y_begin + i / tile_width) * width + x_begin + i % tile_width;
+
+			image[pixel] = XMFLOAT4(0.0f, 0.0f, 0.0f, shadowed[i] ? 0.0f : 1.0f);
+			reflects[pixel] = GetReflectionRay(samples[i], scene_constants, pixel_reflection_rays[pixel]) ? 1 : 0;
+		}
+	});
+
+	Stats stats;
+	for (const Stats& tile : tile_stats)
+	{
+		stats.PrimaryRays		+= tile.PrimaryRays;
+		stats.ShadowRays		+= tile.ShadowRays;
+		stats.ReflectionRays	+= tile.ReflectionRays;
+	}
+
+	std::vector<uint32_t> pixels;
+	std::vector<Bvh::Ray> rays;
+
+	for (size_t pixel = 0; pixel < image.size(); pixel++)
+	{
+		if (reflects[pixel])
+		{
+			pixels.push_back(static_cast<uint32_t>(pixel));
+			rays.push_back(pixel_reflection_rays[pixel]);
+		}
+	}
+
+	TraceReflections(pixels, rays, scene_constants, light, image, thread_pool, stats);
+
+	return stats;
+}
+
+void CpuRayTracer::WriteImage(const std::string& filename, const std::vector<XMFLOAT4>& image, uint32_t width, uint32_t height)
+{
+	if (image.size() != static_cast<size_t>(width) * height)
+	{
+		throw std::invalid_argument("Image size does not match its dimensions.");
+	}
+
+	Image source = {};
+	source.width		= width;
+	source.height		= height;
+	source.format		= DXGI_FORMAT_R32G32B32A32_FLOAT;
+	source.rowPitch		= width * sizeof(XMFLOAT4);
+	source.slicePitch	= source.rowPitch * height;
+	source.pixels		= reinterpret_cast<uint8_t*>(const_cast<XMFLOAT4*>(image.data()));
+
+	ThrowIfFailed(SaveToDDSFile(source, DDS_FLAGS_NONE, utf8_to_utf16(filename).c_str()));
+}
+
+bool CpuRayTracer::ReadImage(const std::string& filename, std::vector<XMFLOAT4>& image, uint32_t& width, uint32_t& height)
+{
+	if (!std::filesystem::exists(filename))
+		return false;
+
+	ScratchImage scratch_image;
+	ThrowIfFailed(LoadFromDDSFile(utf8_to_utf16(filename).c_str(), DDS_FLAGS_NONE, nullptr, scratch_image));
+
+	const Image* source = scratch_image.GetImage(0, 0, 0);
+	if (source->format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+	{
+		throw std::runtime_error("Golden image is not in the format of CpuRayTracer::WriteImage.");
+	}
+
+	width	= static_cast<uint32_t>(source->width);
+	height	= static_cast<uint32_t>(source->height);
+	image.resize(static_cast<size_t>(width) * height);
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		std::memcpy(&image[static_cast<size_t>(y) * width], source->pixels + y * source->rowPitch, width * sizeof(XMFLOAT4));
+	}
+
+	return true;
+}
+
+CpuRayTracer::ImageDifference CpuRayTracer::CompareImages(const std::vector<XMFLOAT4>& a, const std::vector<XMFLOAT4>& b, float tolerance)
+{
+	if (a.size() != b.size())
+	{
+		throw std::invalid_argument("Compared images differ in size.");
+	}
+
+	ImageDifference difference = {};
+	double error_sum = 0.0;
+
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		const float errors[4] = { std::abs(a[i].x - b[i].x), std::abs(a[i].y - b[i].y), std::abs(a[i].z - b[i].z), std::abs(a[i].w - b[i].w) };
+		const float max_error = std::max(std::max(errors[0], errors[1]), std::max(errors[2], errors[3]));
+
+		// NaN differs from everything.
+		const bool off = !(max_error <= tolerance);
+
+		difference.MaxError = std::max(difference.MaxError, off && !(max_error <= FLT_MAX) ? FLT_MAX : max_error);
+		difference.NumPixelsOff += off ? 1 : 0;
+
+		error_sum += errors[0] + errors[1] + errors[2] + errors[3];
+	}
+
+	difference.MeanError = a.empty() ? 0.0 : error_sum / (a.size() * 4.0);
+
+	return difference;
+}
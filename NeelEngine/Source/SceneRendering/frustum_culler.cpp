@@ -0,0 +1,176 @@
+#include "neel_engine_pch.h"
+
+#include "frustum_culler.h"
+#include "thread_pool.h"
+
+void XM_CALLCONV FrustumCuller::ExtractPlanes(FXMMATRIX view_projection, XMFLOAT4 planes[6])
+{
+	// Row vectors: clip space x, y, z and w are dot products of the position with the columns of the matrix.
+	const XMMATRIX columns = XMMatrixTranspose(view_projection);
+
+	const XMVECTOR clip_planes[6] =
+	{
+		columns.r[3] + columns.r[0],	// -w <= x
+		columns.r[3] - columns.r[0],	// x <= w
+		columns.r[3] + columns.r[1],	// -w <= y
+		columns.r[3] - columns.r[1],	// y <= w
+		columns.r[2],					// 0 <= z
+		columns.r[3] - columns.r[2]		// z <= w
+	};
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(clip_planes[i]));
+	}
+}
+
+void XM_CALLCONV FrustumCuller::SetFrustum(FXMMATRIX view_projection)
+{
+	ExtractPlanes(view_projection, planes_);
+}
+
+void FrustumCuller::SetPlanes(const XMFLOAT4 planes[6])
+{
+	for (size_t i = 0; i < 6; i++)
+	{
+		XMStoreFloat4(&planes_[i], XMPlaneNormalize(XMLoadFloat4(&planes[i])));
+	}
+}
+
+void FrustumCuller::Clear()
+{
+	num_boxes_ = 0;
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		centers_[i].clear();
+		extents_[i].clear();
+	}
+}
+
+void FrustumCuller::Reserve(size_t num_boxes)
+{
+	const size_t padded = (num_boxes + 3) & ~size_t(3);
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		centers_[i].reserve(padded);
+		extents_[i].reserve(padded);
+	}
+
+	visibility_.reserve(padded);
+}
+
+uint32_t FrustumCuller::AddBox(const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	// The arrays always hold whole groups of 4, the boxes past num_boxes_ are empty.
+	if (num_boxes_ % 4 == 0)
+	{
+		for (size_t i = 0; i < 3; i++)
+		{
+			centers_[i].resize(num_boxes_ + 4, 0.0f);
+			extents_[i].resize(num_boxes_ + 4, 0.0f);
+		}
+	}
+
+	centers_[0][num_boxes_] = center.x;
+	centers_[1][num_boxes_] = center.y;
+	centers_[2][num_boxes_] = center.z;
+	extents_[0][num_boxes_] = extents.x;
+	extents_[1][num_boxes_] = extents.y;
+	extents_[2][num_boxes_] = extents.z;
+
+	return static_cast<uint32_t>(num_boxes_++);
+}
+
+uint32_t XM_CALLCONV FrustumCuller::AddBounds(FXMMATRIX model_matrix, const Mesh::BoundingVolume& bounds)
+{
+	// Every axis of the box moves the world space corners by the absolute value of its transformed axis.
+	const XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+
+	const XMVECTOR world_extents =
+		XMVectorAbs(model_matrix.r[0]) * XMVectorSplatX(extents) +
+		XMVectorAbs(model_matrix.r[1]) * XMVectorSplatY(extents) +
+		XMVectorAbs(model_matrix.r[2]) * XMVectorSplatZ(extents);
+
+	XMFLOAT3 world_center, world_extents_3;
+	XMStoreFloat3(&world_center, XMVector3TransformCoord(XMLoadFloat3(&bounds.Center), model_matrix));
+	XMStoreFloat3(&world_extents_3, world_extents);
+
+	return AddBox(world_center, world_extents_3);
+}
+
+void FrustumCuller::CullRange(size_t begin, size_t end)
+{
+	XMVECTOR plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	XMVECTOR abs_x[6], abs_y[6], abs_z[6];
+
+	for (size_t p = 0; p < 6; p++)
+	{
+		const XMVECTOR plane = XMLoadFloat4(&planes_[p]);
+
+		plane_x[p] = XMVectorSplatX(plane);
+		plane_y[p] = XMVectorSplatY(plane);
+		plane_z[p] = XMVectorSplatZ(plane);
+		plane_w[p] = XMVectorSplatW(plane);
+
+		abs_x[p] = XMVectorAbs(plane_x[p]);
+		abs_y[p] = XMVectorAbs(plane_y[p]);
+		abs_z[p] = XMVectorAbs(plane_z[p]);
+	}
+
+	for (size_t i = begin; i < end; i += 4)
+	{
+		const XMVECTOR center_x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centers_[0][i]));
+		const XMVECTOR center_y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centers_[1][i]));
+		const XMVECTOR center_z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centers_[2][i]));
+		const XMVECTOR extent_x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&extents_[0][i]));
+		const XMVECTOR extent_y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&extents_[1][i]));
+		const XMVECTOR extent_z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&extents_[2][i]));
+
+		XMVECTOR outside = XMVectorFalseInt();
+
+		for (size_t p = 0; p < 6; p++)
+		{
+			const XMVECTOR distance = XMVectorMultiplyAdd(plane_x[p], center_x,
+				XMVectorMultiplyAdd(plane_y[p], center_y, XMVectorMultiplyAdd(plane_z[p], center_z, plane_w[p])));
+			const XMVECTOR radius = XMVectorMultiplyAdd(abs_x[p], extent_x, XMVectorMultiplyAdd(abs_y[p], extent_y, abs_z[p] * extent_z));
+
+			outside = XMVectorOrInt(outside, XMVectorLess(distance + radius, XMVectorZero()));
+		}
+
+		XMUINT4 mask;
+		XMStoreUInt4(&mask, outside);
+
+		visibility_[i]		= mask.x == 0 ? 1 : 0;
+		visibility_[i + 1]	= mask.y == 0 ? 1 : 0;
+		visibility_[i + 2]	= mask.z == 0 ? 1 : 0;
+		visibility_[i + 3]	= mask.w == 0 ? 1 : 0;
+	}
+}
+
+size_t FrustumCuller::Cull(ThreadPool* thread_pool)
+{
+	const size_t padded = centers_[0].size();
+	visibility_.resize(padded);
+
+	if (thread_pool && padded > parallel_grain_size_)
+	{
+		thread_pool->ParallelForRange(padded / 4, parallel_grain_size_ / 4, [this](size_t begin, size_t end)
+		{
+			CullRange(begin * 4, end * 4);
+		});
+	}
+	else
+	{
+		CullRange(0, padded);
+	}
+
+	size_t num_visible = 0;
+	for (size_t i = 0; i < num_boxes_; i++)
+	{
+		num_visible += visibility_[i];
+	}
+
+	return num_visible;
+}
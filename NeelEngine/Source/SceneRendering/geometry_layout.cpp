@@ -0,0 +1,144 @@
+#include "geometry_layout.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+GeometryLayout::GeometryLayout(uint64_t max_buffer_size, uint64_t alignment)
+	: max_buffer_size_(max_buffer_size)
+	, alignment_(alignment)
+{
+}
+
+uint32_t GeometryLayout::AddSubMesh(const std::array<const void*, num_streams_>& streams, const std::array<uint64_t, num_streams_>& stream_sizes,
+	const void* indices, uint64_t index_size)
+{
+	SubMesh sub_mesh = {};
+	sub_mesh.Streams		= streams;
+	sub_mesh.StreamSizes	= stream_sizes;
+	sub_mesh.Indices		= indices;
+	sub_mesh.IndexSize		= index_size;
+
+	for (const uint64_t stream_size : stream_sizes)
+	{
+		sub_mesh.VertexSize += stream_size;
+	}
+
+	sub_mesh.VertexOffset	= Allocate(vertex_buffers_, sub_mesh.VertexSize, sub_mesh.VertexBuffer);
+	sub_mesh.IndexOffset	= Allocate(index_buffers_, sub_mesh.IndexSize, sub_mesh.IndexBuffer);
+
+	sub_meshes_.push_back(sub_mesh);
+
+	UpdateStagingOffsets();
+
+	return static_cast<uint32_t>(sub_meshes_.size() - 1);
+}
+
+uint64_t GeometryLayout::Allocate(std::vector<BufferRange>& buffers, uint64_t size, uint32_t& buffer_index)
+{
+	if (!buffers.empty())
+	{
+		BufferRange& buffer = buffers.back();
+
+		const uint64_t offset = AlignUp(buffer.Size, alignment_);
+		if (offset + size <= max_buffer_size_)
+		{
+			buffer.Size = offset + size;
+			buffer_index = static_cast<uint32_t>(buffers.size() - 1);
+			return offset;
+		}
+	}
+
+	buffers.push_back({ size, 0 });
+	buffer_index = static_cast<uint32_t>(buffers.size() - 1);
+	return 0;
+}
+
+void GeometryLayout::UpdateStagingOffsets()
+{
+	uint64_t staging_offset = 0;
+
+	for (auto* buffers : { &vertex_buffers_, &index_buffers_ })
+	{
+		for (auto& buffer : *buffers)
+		{
+			buffer.StagingOffset = staging_offset;
+			staging_offset = AlignUp(staging_offset + buffer.Size, alignment_);
+		}
+	}
+}
+
+uint64_t GeometryLayout::GetStagingSize() const
+{
+	const BufferRange* last = !index_buffers_.empty() ? &index_buffers_.back() : (!vertex_buffers_.empty() ? &vertex_buffers_.back() : nullptr);
+
+	return last ? last->StagingOffset + last->Size : 0;
+}
+
+size_t GeometryLayout::GetNumAllocations() const
+{
+	size_t num_allocations = 0;
+
+	for (auto* buffers : { &vertex_buffers_, &index_buffers_ })
+	{
+		for (const auto& buffer : *buffers)
+		{
+			num_allocations += buffer.Size > 0 ? 1 : 0;
+		}
+	}
+
+	return num_allocations + (num_allocations > 0 ? 1 : 0);
+}
+
+void GeometryLayout::WriteStaging(uint8_t* staging) const
+{
+	for (const auto& sub_mesh : sub_meshes_)
+	{
+		WriteSubMesh(sub_mesh,
+			staging + vertex_buffers_[sub_mesh.VertexBuffer].StagingOffset + sub_mesh.VertexOffset,
+			staging + index_buffers_[sub_mesh.IndexBuffer].StagingOffset + sub_mesh.IndexOffset);
+	}
+}
+
+void GeometryLayout::WriteStaging(uint32_t first_sub_mesh, uint8_t* vertex_data, uint8_t* index_data) const
+{
+	if (vertex_buffers_.size() > 1 || index_buffers_.size() > 1)
+	{
+		throw std::logic_error("Partial staging requires a layout with a single vertex and index buffer.");
+	}
+
+	if (first_sub_mesh >= sub_meshes_.size())
+		return;
+
+	const uint64_t vertex_begin	= sub_meshes_[first_sub_mesh].VertexOffset;
+	const uint64_t index_begin	= sub_meshes_[first_sub_mesh].IndexOffset;
+
+	for (size_t i = first_sub_mesh; i < sub_meshes_.size(); i++)
+	{
+		const SubMesh& sub_mesh = sub_meshes_[i];
+		WriteSubMesh(sub_mesh, vertex_data + (sub_mesh.VertexOffset - vertex_begin), index_data + (sub_mesh.IndexOffset - index_begin));
+	}
+}
+
+void GeometryLayout::WriteSubMesh(const SubMesh& sub_mesh, uint8_t* vertex_data, uint8_t* index_data)
+{
+	for (size_t slot = 0; slot < num_streams_; slot++)
+	{
+		if (sub_mesh.Streams[slot] && sub_mesh.StreamSizes[slot] > 0)
+		{
+			std::memcpy(vertex_data, sub_mesh.Streams[slot], static_cast<size_t>(sub_mesh.StreamSizes[slot]));
+		}
+
+		vertex_data += sub_mesh.StreamSizes[slot];
+	}
+
+	if (sub_mesh.Indices && sub_mesh.IndexSize > 0)
+	{
+		std::memcpy(index_data, sub_mesh.Indices, static_cast<size_t>(sub_mesh.IndexSize));
+	}
+}
@@ -0,0 +1,69 @@
+#include "neel_engine_pch.h"
+
+#include "geometry_pool.h"
+#include "commandlist.h"
+
+GeometryPool::GeometryPool()
+	: layout_(std::numeric_limits<uint64_t>::max(), alignment_)
+	, num_uploaded_(0)
+	, vertex_buffer_("Geometry Pool Vertex Buffer")
+	, index_buffer_("Geometry Pool Index Buffer")
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+}
+
+uint32_t GeometryPool::AddSubMesh(const std::array<const void*, GeometryLayout::num_streams_>& streams, const std::array<uint64_t, GeometryLayout::num_streams_>& stream_sizes,
+	const void* indices, uint64_t index_size)
+{
+	return layout_.AddSubMesh(streams, stream_sizes, indices, index_size);
+}
+
+bool GeometryPool::Upload(CommandList& command_list)
+{
+	if (num_uploaded_ == layout_.GetNumSubMeshes())
+		return false;
+
+	const auto vertex_resource	= vertex_buffer_.GetD3D12Resource();
+	const auto index_resource	= index_buffer_.GetD3D12Resource();
+
+	command_list.CopyGeometry(layout_, num_uploaded_, vertex_buffer_, index_buffer_);
+
+	num_uploaded_ = static_cast<uint32_t>(layout_.GetNumSubMeshes());
+
+	return vertex_buffer_.GetD3D12Resource() != vertex_resource || index_buffer_.GetD3D12Resource() != index_resource;
+}
+
+void GeometryPool::Reset()
+{
+	layout_ = GeometryLayout(std::numeric_limits<uint64_t>::max(), alignment_);
+	num_uploaded_ = 0;
+
+	vertex_buffer_.Reset();
+	index_buffer_.Reset();
+}
+
+uint64_t GeometryPool::GetStreamOffset(uint32_t index, size_t slot) const
+{
+	const GeometryLayout::SubMesh& sub_mesh = layout_.GetSubMesh(index);
+
+	uint64_t offset = sub_mesh.VertexOffset;
+	for (size_t i = 0; i < slot; i++)
+	{
+		offset += sub_mesh.StreamSizes[i];
+	}
+
+	return offset;
+}
+
+uint64_t GeometryPool::GetVertexDataSize() const
+{
+	return layout_.GetVertexBuffers().empty() ? 0 : layout_.GetVertexBuffers()[0].Size;
+}
+
+uint64_t GeometryPool::GetIndexDataSize() const
+{
+	return layout_.GetIndexBuffers().empty() ? 0 : layout_.GetIndexBuffers()[0].Size;
+}
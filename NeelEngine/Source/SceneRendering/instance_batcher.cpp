@@ -0,0 +1,86 @@
+#include "neel_engine_pch.h"
+
+#include "instance_batcher.h"
+
+// Mesh in the top 24 bits, then the submesh, then the level of detail in the low 16 bits.
+static uint64_t MakeKey(uint32_t mesh, uint32_t sub_mesh, uint32_t lod)
+{
+	return static_cast<uint64_t>(mesh) << 40 | static_cast<uint64_t>(sub_mesh) << 16 | lod;
+}
+
+void InstanceBatcher::Clear()
+{
+	transforms_.clear();
+	draws_.clear();
+	batches_.clear();
+	instance_data_.clear();
+}
+
+uint32_t XM_CALLCONV InstanceBatcher::AddTransform(FXMMATRIX model_matrix)
+{
+	InstanceData instance;
+	instance.ModelMatrix					= model_matrix;
+	instance.InverseTransposeModelMatrix	= XMMatrixTranspose(XMMatrixInverse(nullptr, model_matrix));
+
+	transforms_.push_back(instance);
+
+	return static_cast<uint32_t>(transforms_.size() - 1);
+}
+
+void InstanceBatcher::AddDraw(uint32_t mesh, uint32_t sub_mesh, uint32_t lod, uint32_t transform)
+{
+	if (mesh > max_meshes_ || sub_mesh > max_sub_meshes_ || lod > max_lods_)
+	{
+		throw std::invalid_argument("Instance batcher draw index does not fit into the sort key.");
+	}
+
+	if (transform >= transforms_.size())
+	{
+		throw std::invalid_argument("Instance batcher draw references a missing transform.");
+	}
+
+	draws_.push_back({ MakeKey(mesh, sub_mesh, lod), transform, static_cast<uint32_t>(draws_.size()) });
+}
+
+void InstanceBatcher::Build(const std::vector<uint8_t>* visibility)
+{
+	batches_.clear();
+	instance_data_.clear();
+	instance_data_.reserve(draws_.size());
+
+	std::sort(draws_.begin(), draws_.end(), [](const Draw& a, const Draw& b)
+	{
+		return a.Key != b.Key ? a.Key < b.Key : a.Order < b.Order;
+	});
+
+	for (size_t first = 0; first < draws_.size();)
+	{
+		const uint64_t key = draws_[first].Key;
+
+		const size_t first_instance = instance_data_.size();
+
+		size_t last = first;
+		while (last < draws_.size() && draws_[last].Key == key)
+		{
+			if (!visibility || (*visibility)[draws_[last].Order])
+			{
+				instance_data_.push_back(transforms_[draws_[last].Transform]);
+			}
+			last++;
+		}
+
+		first = last;
+
+		if (instance_data_.size() == first_instance)
+			continue;
+
+		Batch batch;
+		batch.Mesh			= static_cast<uint32_t>(key >> 40);
+		batch.SubMesh		= static_cast<uint32_t>(key >> 16) & max_sub_meshes_;
+		batch.Lod			= static_cast<uint32_t>(key) & max_lods_;
+		batch.FirstInstance	= static_cast<uint32_t>(first_instance);
+		batch.NumInstances	= static_cast<uint32_t>(instance_data_.size() - first_instance);
+
+		batches_.push_back(batch);
+	}
+}
@@ -0,0 +1,41 @@
+#include "neel_engine_pch.h"
+
+#include "lod_selector.h"
+#include "camera.h"
+
+LodSelector::LodSelector(float fovy, float render_height, float pixel_error)
+	: error_per_distance_(pixel_error * 2.0f * std::tan(XMConvertToRadians(fovy) * 0.5f) / std::max(render_height, 1.0f))
+{
+}
+
+LodSelector::LodSelector(const Camera& camera, float render_height, float pixel_error)
+	: LodSelector(camera.GetFoV(), render_height, pixel_error)
+{
+}
+
+float XM_CALLCONV LodSelector::GetMaxError(FXMMATRIX model_matrix, const XMFLOAT4& bounding_sphere, FXMVECTOR eye, float near_clip) const
+{
+	// Errors are measured in mesh units, the largest axis scale bounds how much they grow in world space.
+	const float scale = std::sqrt(std::max({
+		XMVectorGetX(XMVector3LengthSq(model_matrix.r[0])),
+		XMVectorGetX(XMVector3LengthSq(model_matrix.r[1])),
+		XMVectorGetX(XMVector3LengthSq(model_matrix.r[2])) }));
+
+	if (scale == 0.0f)
+		return FLT_MAX;
+
+	const XMVECTOR center = XMVector3TransformCoord(XMLoadFloat4(&bounding_sphere), model_matrix);
+	const float distance = XMVectorGetX(XMVector3Length(center - eye)) - bounding_sphere.w * scale;
+
+	return std::max(distance, near_clip) * error_per_distance_ / scale;
+}
+
+float XM_CALLCONV LodSelector::GetMaxError(const Mesh& mesh, FXMVECTOR eye, float near_clip) const
+{
+	return GetMaxError(mesh.GetModelMatrix(), mesh.GetBoundingSphere(), eye, near_clip);
+}
+
+uint32_t LodSelector::GetTriangleCount(const std::vector<Mesh::LevelOfDetail>& lods, uint32_t index_count, float max_error)
+{
+	return (lods.empty() ? index_count : Mesh::SelectLod(lods, max_error).IndexCount) / 3;
+}
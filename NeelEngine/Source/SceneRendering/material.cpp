@@ -6,13 +6,18 @@ Material::Material()
 {
 }
 
+Material::Material(const MeshMaterialData& material_data)
+	: material_data_(material_data)
+{
+}
+
 Material::~Material()
 {
 }
 
-void Material::Load(const fx::gltf::Document& document, int material_index, CommandList& command_list, std::vector<Texture>& texture_store, const std::string& filename)
+void Material::Load(const MappedDocument& document, int material_index, const std::string& filename, std::vector<TextureLoadRequest>& texture_requests)
 {
-	const fx::gltf::Material& material = document.materials[material_index];
+	const fx::gltf::Material& material = document.GetDocument().materials[material_index];
 	
 	if(!material.pbrMetallicRoughness.empty())
 	{
@@ -35,94 +40,11 @@ void Material::Load(const fx::gltf::Document& document, int material_index, Comm
 		material_data_.OcclusionIndex		= m.occlusionTexture.index;
 		material_data_.EmissiveIndex		= m.emissiveTexture.index;
 
-		if (m.pbrMetallicRoughness.baseColorTexture.index >= 0)
-		{
-			const fx::gltf::Image& image = document.images[document.textures[m.pbrMetallicRoughness.baseColorTexture.index].source];
-
-			std::string file_name = "";
-
-			if (!image.uri.empty() && !image.IsEmbeddedResource())
-			{
-				file_name = fx::gltf::detail::GetDocumentRootPath(filename) + "/" + image.uri;
-				command_list.LoadTextureFromFile(texture_store[m.pbrMetallicRoughness.baseColorTexture.index], file_name, TextureUsage::Albedo);
-			}
-			else
-			{
-				throw std::exception("embedded glTF textures not supported!");
-			}
-		}
-			
-		if (m.normalTexture.index >= 0)
-		{
-			const fx::gltf::Image& image = document.images[document.textures[m.normalTexture.index].source];
-
-			std::string file_name = "";
-
-			if (!image.uri.empty() && !image.IsEmbeddedResource())
-			{
-				file_name = fx::gltf::detail::GetDocumentRootPath(filename) + "/" + image.uri;
-				command_list.LoadTextureFromFile(texture_store[m.normalTexture.index], file_name, TextureUsage::Normalmap);
-			}
-			else
-			{
-				throw std::exception("embedded glTF textures not supported!");
-			}
-		}
-			
-		if (m.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0)
-		{
-			const fx::gltf::Image& image = document.images[document.textures[m.pbrMetallicRoughness.metallicRoughnessTexture.index].source];
-
-			std::string file_name = "";
-
-			if (!image.uri.empty() && !image.IsEmbeddedResource())
-			{
-				file_name = fx::gltf::detail::GetDocumentRootPath(filename) + "/" + image.uri;
-				command_list.LoadTextureFromFile(texture_store[m.pbrMetallicRoughness.metallicRoughnessTexture.index], file_name, TextureUsage::MetalRoughnessmap);
-
-			}
-			else
-			{
-				throw std::exception("embedded glTF textures not supported!");
-			}
-		}
-			
-		if (m.occlusionTexture.index >= 0)
-		{
-		
-			const fx::gltf::Image& image = document.images[document.textures[m.occlusionTexture.index].source];
-
-			std::string file_name = "";
-
-			if (!image.uri.empty() && !image.IsEmbeddedResource())
-			{
-				file_name = fx::gltf::detail::GetDocumentRootPath(filename) + "/" + image.uri;
-				command_list.LoadTextureFromFile(texture_store[m.occlusionTexture.index], file_name, TextureUsage::AmbientOcclusionmap);
-
-			}
-			else
-			{
-				throw std::exception("embedded glTF textures not supported!");
-			}
-		}
-		
-		if (m.emissiveTexture.index >= 0)
-		{
-			const fx::gltf::Image& image = document.images[document.textures[m.emissiveTexture.index].source];
-
-			std::string file_name = "";
-
-			if (!image.uri.empty() && !image.IsEmbeddedResource())
-			{
-				file_name = fx::gltf::detail::GetDocumentRootPath(filename) + "/" + image.uri;
-				command_list.LoadTextureFromFile(texture_store[m.emissiveTexture.index], file_name, TextureUsage::Emissivemap);
-
-			}
-			else
-			{
-				throw std::exception("embedded glTF textures not supported!");
-			}
-		}	
+		AddTextureRequest(document, m.pbrMetallicRoughness.baseColorTexture.index,			TextureUsage::Albedo,				filename, texture_requests);
+		AddTextureRequest(document, m.normalTexture.index,									TextureUsage::Normalmap,			filename, texture_requests);
+		AddTextureRequest(document, m.pbrMetallicRoughness.metallicRoughnessTexture.index,	TextureUsage::MetalRoughnessmap,	filename, texture_requests);
+		AddTextureRequest(document, m.occlusionTexture.index,								TextureUsage::AmbientOcclusionmap,	filename, texture_requests);
+		AddTextureRequest(document, m.emissiveTexture.index,								TextureUsage::Emissivemap,			filename, texture_requests);
 	}
 	else
 	{
@@ -133,5 +55,20 @@ void Material::Load(const fx::gltf::Document& document, int material_index, Comm
 	}
 }
 
+void Material::AddTextureRequest(const MappedDocument& document, int texture_index, TextureUsage texture_usage, const std::string& filename, std::vector<TextureLoadRequest>& texture_requests)
+{
+	if (texture_index < 0)
+		return;
+
+	const uint32_t image_index = document.GetDocument().textures[texture_index].source;
+	const fx::gltf::Image& image = document.GetDocument().images[image_index];
 
+	if (const uint8_t* image_data = document.GetImageData(image_index))
+	{
+		// Decoded from memory, the name only has to identify the image within the file.
+		texture_requests.push_back({ texture_index, filename + "#image" + std::to_string(image_index), texture_usage, image_data, document.GetImageSize(image_index) });
+		return;
+	}
 
+	texture_requests.push_back({ texture_index, fx::gltf::detail::GetDocumentRootPath(filename) + "/" + image.uri, texture_usage });
+}
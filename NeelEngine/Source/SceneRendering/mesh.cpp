@@ -3,12 +3,15 @@
 #include "neel_engine.h"
 #include "mesh.h"
 #include "gltf_mesh_data.h"
+#include "vertex_quantization.h"
+#include "skinning.h"
 #include "camera.h"
 
 Mesh::Mesh()
 	: name_("unavailable")
 	  , base_transform_{XMMatrixIdentity()}
 	  , world_matrix_{ XMMatrixIdentity()}
+	  , bounding_sphere_(0.0f, 0.0f, 0.0f, 0.0f)
 {
 }
 
@@ -21,6 +24,128 @@ void Mesh::SetBaseTransform(const DirectX::XMMATRIX& base_transform)
 	base_transform_ = base_transform;
 }
 
+DirectX::XMMATRIX Mesh::GetDequantizeTransform() const
+{
+	return XMMatrixScaling(constant_data_.PositionScale.x, constant_data_.PositionScale.y, constant_data_.PositionScale.z) *
+		XMMatrixTranslation(constant_data_.PositionOffset.x, constant_data_.PositionOffset.y, constant_data_.PositionOffset.z);
+}
+
+void Mesh::SetVertexFormat(const std::vector<PrimitiveData>& primitives)
+{
+	// Primitives of a mesh share the vertex format and position bounds.
+	static const PrimitiveData float_format;
+	const PrimitiveData& primitive_format = primitives.empty() ? float_format : primitives.front();
+
+	constant_data_.QuantizedVertices	= primitive_format.Quantized ? 1 : 0;
+	constant_data_.PositionScale		= XMFLOAT4(primitive_format.PositionScale.x, primitive_format.PositionScale.y, primitive_format.PositionScale.z, 0.0f);
+	constant_data_.PositionOffset		= XMFLOAT4(primitive_format.PositionOffset.x, primitive_format.PositionOffset.y, primitive_format.PositionOffset.z, 0.0f);
+}
+
+XMFLOAT4 Mesh::ComputeBoundingSphere(const std::vector<PrimitiveData>& primitives)
+{
+	XMVECTOR bounds_min = XMVectorReplicate(FLT_MAX);
+	XMVECTOR bounds_max = XMVectorReplicate(-FLT_MAX);
+
+	for (const auto& primitive : primitives)
+	{
+		if (primitive.Quantized)
+		{
+			// Quantized positions cover the bounds of the mesh.
+			const XMVECTOR scale	= XMLoadFloat3(&primitive.PositionScale);
+			const XMVECTOR offset	= XMLoadFloat3(&primitive.PositionOffset);
+
+			bounds_min = XMVectorMin(bounds_min, offset - scale);
+			bounds_max = XMVectorMax(bounds_max, offset + scale);
+		}
+		else if (primitive.Streams[vertex_slot_])
+		{
+			const XMFLOAT3* positions = reinterpret_cast<const XMFLOAT3*>(primitive.Streams[vertex_slot_]);
+
+			for (size_t i = 0; i < primitive.NumElements[vertex_slot_]; i++)
+			{
+				bounds_min = XMVectorMin(bounds_min, XMLoadFloat3(&positions[i]));
+				bounds_max = XMVectorMax(bounds_max, XMLoadFloat3(&positions[i]));
+			}
+		}
+	}
+
+	if (XMVector3Greater(bounds_min, bounds_max))
+		return XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	const XMVECTOR center = (bounds_min + bounds_max) * 0.5f;
+
+	XMFLOAT4 sphere;
+	XMStoreFloat4(&sphere, XMVectorSetW(center, XMVectorGetX(XMVector3Length(bounds_max - center))));
+	return sphere;
+}
+
+Mesh::BoundingVolume Mesh::ComputeBounds(const PrimitiveData& primitive, const float* position_min, const float* position_max)
+{
+	BoundingVolume bounds = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 0.0f };
+
+	if (primitive.Quantized)
+	{
+		bounds.Center	= primitive.PositionOffset;
+		bounds.Extents	= primitive.PositionScale;
+		bounds.Radius	= XMVectorGetX(XMVector3Length(XMLoadFloat3(&primitive.PositionScale)));
+		return bounds;
+	}
+
+	const size_t num_positions = primitive.NumElements[vertex_slot_];
+	if (!primitive.Streams[vertex_slot_] || num_positions == 0)
+		return bounds;
+
+	const XMFLOAT3* positions = reinterpret_cast<const XMFLOAT3*>(primitive.Streams[vertex_slot_]);
+
+	XMVECTOR bounds_min, bounds_max;
+	if (position_min && position_max)
+	{
+		bounds_min = XMVectorSet(position_min[0], position_min[1], position_min[2], 0.0f);
+		bounds_max = XMVectorSet(position_max[0], position_max[1], position_max[2], 0.0f);
+	}
+	else
+	{
+		bounds_min = XMVectorReplicate(FLT_MAX);
+		bounds_max = XMVectorReplicate(-FLT_MAX);
+
+		for (size_t i = 0; i < num_positions; i++)
+		{
+			bounds_min = XMVectorMin(bounds_min, XMLoadFloat3(&positions[i]));
+			bounds_max = XMVectorMax(bounds_max, XMLoadFloat3(&positions[i]));
+		}
+	}
+
+	const XMVECTOR center = (bounds_min + bounds_max) * 0.5f;
+
+	XMVECTOR radius_squared = XMVectorZero();
+	for (size_t i = 0; i < num_positions; i++)
+	{
+		radius_squared = XMVectorMax(radius_squared, XMVector3LengthSq(XMLoadFloat3(&positions[i]) - center));
+	}
+
+	XMStoreFloat3(&bounds.Center, center);
+	XMStoreFloat3(&bounds.Extents, XMVectorMax(bounds_max - center, XMVectorZero()));
+	bounds.Radius = XMVectorGetX(XMVectorSqrt(radius_squared));
+
+	return bounds;
+}
+
+const Mesh::LevelOfDetail& Mesh::SelectLod(const std::vector<LevelOfDetail>& lods, float max_error)
+{
+	return lods[SelectLodIndex(lods, max_error)];
+}
+
+size_t Mesh::SelectLodIndex(const std::vector<LevelOfDetail>& lods, float max_error)
+{
+	size_t level = lods.size() - 1;
+	while (level > 0 && lods[level].Error > max_error)
+	{
+		level--;
+	}
+
+	return level;
+}
+
 void Mesh::SetWorldMatrix(const DirectX::XMFLOAT3& translation, const float rotation_y, float scale)
 {
 	const XMMATRIX t = XMMatrixTranslationFromVector(DirectX::XMLoadFloat3(&translation));
@@ -43,135 +168,285 @@ void Mesh::SetEmissive(DirectX::XMFLOAT3 color)
 	}
 }
 
-void Mesh::Load(const fx::gltf::Document& doc, std::size_t mesh_index, CommandList& command_list, std::vector<Material>* scene_materials)
+void Mesh::PackPrimitive(const fx::gltf::Document& doc, std::size_t mesh_index, std::size_t primitive_index, PrimitiveData& primitive_data,
+	const std::vector<const uint8_t*>* buffer_data)
 {
-	auto device = NeelEngine::Get().GetDevice();
+	MeshData mesh(doc, mesh_index, primitive_index, buffer_data);
 
-	name_ = doc.meshes[mesh_index].name;
+	const MeshData::BufferInfo& v_buffer = mesh.VertexBuffer();
+	const MeshData::BufferInfo& n_buffer = mesh.NormalBuffer();
+	const MeshData::BufferInfo& t_buffer = mesh.TangentBuffer();
+	const MeshData::BufferInfo& c_buffer = mesh.TexCoord0Buffer();
+	const MeshData::BufferInfo& i_buffer = mesh.IndexBuffer();
 
-	sub_meshes_.resize(doc.meshes[mesh_index].primitives.size());
+	if (!v_buffer.HasData() || !n_buffer.HasData() || !i_buffer.HasData())
+	{
+		throw std::runtime_error("Only meshes with vertex, normal, and index buffers are supported");
+	}
+
+	const fx::gltf::Primitive& primitive = doc.meshes[mesh_index].primitives[primitive_index];
+
+	// Get submesh primitive topology for rendering
+	switch (primitive.mode)
+	{
+		case fx::gltf::Primitive::Mode::Points:
+			primitive_data.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_POINTLIST;
+			break;
+		case fx::gltf::Primitive::Mode::Lines:
+			primitive_data.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_LINELIST_ADJ;
+			break;
+		case fx::gltf::Primitive::Mode::LineLoop:
+			primitive_data.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_LINELIST;
+			break;
+		case fx::gltf::Primitive::Mode::LineStrip:
+			primitive_data.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_LINESTRIP;
+			break;
+		case fx::gltf::Primitive::Mode::Triangles:
+			primitive_data.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			break;
+		case fx::gltf::Primitive::Mode::TriangleStrip:
+			primitive_data.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+			break;
+		case fx::gltf::Primitive::Mode::TriangleFan:
+			primitive_data.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+			break;
+	}
+
+	// Float streams are referenced in place, quantized (KHR_mesh_quantization) or strided streams are converted to float into Storage.
+	const std::array<const MeshData::BufferInfo*, 4> buffers = { &v_buffer, &n_buffer, &t_buffer, &c_buffer };
+	const std::array<uint32_t, 4> num_components = { 3, 3, 4, 2 };
+
+	std::array<bool, 4> convert_stream = { false, false, false, false };
+	size_t storage_size = 0;
 
-	for (std::size_t i = 0; i < doc.meshes[mesh_index].primitives.size(); i++)
+	for (size_t slot = 0; slot < buffers.size(); slot++)
 	{
-		MeshData mesh(doc, mesh_index, i);
+		const MeshData::BufferInfo& buffer = *buffers[slot];
+		if (!buffer.HasData())
+			continue;
 
-		const MeshData::BufferInfo& v_buffer = mesh.VertexBuffer();
-		const MeshData::BufferInfo& n_buffer = mesh.NormalBuffer();
-		const MeshData::BufferInfo& t_buffer = mesh.TangentBuffer();
-		const MeshData::BufferInfo& c_buffer = mesh.TexCoord0Buffer();
-		const MeshData::BufferInfo& i_buffer = mesh.IndexBuffer();
+		primitive_data.NumElements[slot] = buffer.Accessor->count;
+		primitive_data.ElementSize[slot] = num_components[slot] * sizeof(float);
 
-		if (!v_buffer.HasData() || !n_buffer.HasData() || !i_buffer.HasData())
+		convert_stream[slot] = buffer.Accessor->componentType != fx::gltf::Accessor::ComponentType::Float ||
+			buffer.ElementSize != primitive_data.ElementSize[slot] || buffer.DataStride != buffer.ElementSize;
+
+		if (convert_stream[slot])
+		{
+			storage_size += primitive_data.StreamSize(slot);
+		}
+		else
 		{
-			throw std::runtime_error("Only meshes with vertex, normal, and index buffers are supported");
+			primitive_data.Streams[slot] = buffer.Data;
 		}
+	}
 
-		const fx::gltf::Primitive& primitive = doc.meshes[mesh_index].primitives[i];
+	// There are no 8-bit index buffers, those are widened to 16 bits.
+	const bool convert_indices = i_buffer.ElementSize == 1 || i_buffer.DataStride != i_buffer.ElementSize;
 
-		SubMesh& submesh = sub_meshes_[i];
+	primitive_data.IndexCount	= i_buffer.Accessor->count;
+	primitive_data.IndexFormat	= (i_buffer.ElementSize <= 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+	if (convert_indices)
+	{
+		storage_size += primitive_data.IndexDataSize();
+	}
+
+	primitive_data.Storage.resize(storage_size);
+	uint8_t* storage = primitive_data.Storage.data();
+
+	for (size_t slot = 0; slot < buffers.size(); slot++)
+	{
+		if (!convert_stream[slot])
+			continue;
+
+		const MeshData::BufferInfo& buffer = *buffers[slot];
 
-		// Get submesh primitive topology for rendering
-		switch (primitive.mode)
+		// Vec3 tangents (not allowed by glTF, but seen in the wild) get a positive bitangent sign.
+		const uint32_t accessor_components = buffer.Accessor->type == fx::gltf::Accessor::Type::Vec3 && num_components[slot] == 4 ? 3 : num_components[slot];
+
+		std::vector<float> decoded(primitive_data.NumElements[slot] * accessor_components);
+		VertexQuantization::DecodeComponents(buffer.Data, buffer.DataStride, primitive_data.NumElements[slot], accessor_components,
+			buffer.Accessor->componentType, buffer.Accessor->normalized, decoded.data());
+
+		float* output = reinterpret_cast<float*>(storage);
+		for (size_t i = 0; i < primitive_data.NumElements[slot]; i++)
+		{
+			for (uint32_t c = 0; c < num_components[slot]; c++)
+			{
+				output[i * num_components[slot] + c] = c < accessor_components ? decoded[i * accessor_components + c] : 1.0f;
+			}
+		}
+
+		primitive_data.Streams[slot] = storage;
+		storage += primitive_data.StreamSize(slot);
+	}
+
+	if (convert_indices)
+	{
+		for (size_t i = 0; i < primitive_data.IndexCount; i++)
 		{
-			case fx::gltf::Primitive::Mode::Points:
-				submesh.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_POINTLIST;
-				break;
-			case fx::gltf::Primitive::Mode::Lines:
-				submesh.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_LINELIST_ADJ;
-				break;
-			case fx::gltf::Primitive::Mode::LineLoop:
-				submesh.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_LINELIST;
-				break;
-			case fx::gltf::Primitive::Mode::LineStrip:
-				submesh.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_LINESTRIP;
-				break;
-			case fx::gltf::Primitive::Mode::Triangles:
-				submesh.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				break;
-			case fx::gltf::Primitive::Mode::TriangleStrip:
-				submesh.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
-				break;
-			case fx::gltf::Primitive::Mode::TriangleFan:
-				submesh.Topology = D3D_PRIMITIVE_TOPOLOGY::D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
-				break;
+			const uint8_t* index = i_buffer.Data + i * i_buffer.DataStride;
+
+			if (primitive_data.IndexFormat == DXGI_FORMAT_R16_UINT)
+			{
+				uint16_t value = *index;
+				if (i_buffer.ElementSize == 2)
+				{
+					std::memcpy(&value, index, sizeof(value));
+				}
+
+				std::memcpy(storage + i * 2, &value, sizeof(value));
+			}
+			else
+			{
+				std::memcpy(storage + i * 4, index, 4);
+			}
 		}
 
-		const uint32_t total_buffer_size =
-			v_buffer.TotalSize +
-			n_buffer.TotalSize +
-			t_buffer.TotalSize +
-			c_buffer.TotalSize +
-			i_buffer.TotalSize;
+		primitive_data.Indices = storage;
+	}
+	else
+	{
+		primitive_data.Indices = i_buffer.Data;
+	}
 
-		void* p_buffer = new char[total_buffer_size];
-		uint8_t* cpu = static_cast<uint8_t*>(p_buffer);
-		uint32_t offset = 0;
+	primitive_data.MaterialIndex	= mesh.Material();
+	primitive_data.HasTangents		= t_buffer.HasData();
 
-		if (!cpu)
-			throw std::bad_alloc();
+	// The min and max of a POSITION accessor are the box of its values, for integer components before they are decoded.
+	const fx::gltf::Accessor& position_accessor = *v_buffer.Accessor;
+	const bool accessor_bounds = position_accessor.componentType == fx::gltf::Accessor::ComponentType::Float &&
+		position_accessor.min.size() == 3 && position_accessor.max.size() == 3;
 
-		std::array<size_t, 4> num_elements {0, 0, 0, 0};
-		std::array<size_t, 4 > element_size {0, 0, 0, 0};
+	primitive_data.Bounds = accessor_bounds ? ComputeBounds(primitive_data, position_accessor.min.data(), position_accessor.max.data()) :
+		ComputeBounds(primitive_data);
 
-		// Copy position data to upload buffer...
-		std::memcpy(cpu, v_buffer.Data, v_buffer.TotalSize);
-		num_elements[vertex_slot_] = v_buffer.Accessor->count;
-		element_size[vertex_slot_] = v_buffer.DataStride;
-		offset += v_buffer.TotalSize;
+	// Skinned primitives keep their influences on the CPU, they are skinned by Skinning.
+	const MeshData::BufferInfo& j_buffer = mesh.Joints0Buffer();
+	const MeshData::BufferInfo& w_buffer = mesh.Weights0Buffer();
 
-		// Copy normal data to upload buffer...
-		std::memcpy(cpu + offset, n_buffer.Data, n_buffer.TotalSize);
-		num_elements[normal_slot_] = n_buffer.Accessor->count;
-		element_size[normal_slot_] = n_buffer.DataStride;
-		offset += n_buffer.TotalSize;
+	if (j_buffer.HasData() && w_buffer.HasData())
+	{
+		const size_t vertex_count = primitive_data.NumElements[vertex_slot_];
 
-		if (t_buffer.HasData())
+		if (j_buffer.Accessor->count != vertex_count || w_buffer.Accessor->count != vertex_count)
 		{
-			// Copy tangent data to upload buffer...
-			std::memcpy(cpu + offset, t_buffer.Data, t_buffer.TotalSize);
-			num_elements[tangent_slot_] = t_buffer.Accessor->count;
-			element_size[tangent_slot_] = t_buffer.DataStride;
-			offset += t_buffer.TotalSize;
+			throw std::runtime_error("glTF joints and weights need one element per vertex");
 		}
 
-		if (c_buffer.HasData())
+		std::vector<float> joints(vertex_count * 4);
+		std::vector<float> weights(vertex_count * 4);
+		VertexQuantization::DecodeComponents(j_buffer.Data, j_buffer.DataStride, vertex_count, 4, j_buffer.Accessor->componentType, false, joints.data());
+		VertexQuantization::DecodeComponents(w_buffer.Data, w_buffer.DataStride, vertex_count, 4, w_buffer.Accessor->componentType,
+			w_buffer.Accessor->normalized, weights.data());
+
+		primitive_data.Skin.resize(vertex_count);
+		for (size_t i = 0; i < vertex_count; i++)
 		{
-			// Copy texcoord data to upload buffer...
-			std::memcpy(cpu + offset, c_buffer.Data, c_buffer.TotalSize);
-			num_elements[texcoord0_slot_] = c_buffer.Accessor->count;
-			element_size[texcoord0_slot_] = c_buffer.DataStride;
-			offset += c_buffer.TotalSize;
+			SkinVertex& skin = primitive_data.Skin[i];
+
+			float weight_sum = 0.0f;
+			for (size_t j = 0; j < 4; j++)
+			{
+				skin.Joints[j]	= static_cast<uint16_t>(joints[i * 4 + j]);
+				skin.Weights[j]	= std::max(weights[i * 4 + j], 0.0f);
+				weight_sum		+= skin.Weights[j];
+			}
+
+			// Weights of normalized integer accessors do not add up to exactly 1.
+			for (size_t j = 0; j < 4; j++)
+			{
+				skin.Weights[j] = weight_sum > 0.0f ? skin.Weights[j] / weight_sum : (j == 0 ? 1.0f : 0.0f);
+			}
 		}
+	}
+}
 
-		// Copy index data to upload buffer...
-		std::memcpy(cpu + offset, i_buffer.Data, i_buffer.TotalSize);
-		submesh.IndexCount = i_buffer.Accessor->count;
-		DXGI_FORMAT index_format = (i_buffer.DataStride == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+// Vertex streams and their sizes in the form the geometry layout expects.
+static void GetStreams(const Mesh::PrimitiveData& primitive, std::array<const void*, GeometryLayout::num_streams_>& streams,
+	std::array<uint64_t, GeometryLayout::num_streams_>& stream_sizes)
+{
+	for (size_t slot = 0; slot < stream_sizes.size(); slot++)
+	{
+		stream_sizes[slot] = primitive.StreamSize(slot);
+	}
 
-		command_list.CopyBuffer(submesh.VBuffer, total_buffer_size - i_buffer.TotalSize, cpu);
-		command_list.CopyIndexBuffer(submesh.IBuffer, submesh.IndexCount, index_format, cpu + offset);
+	std::copy(primitive.Streams.begin(), primitive.Streams.end(), streams.begin());
+}
 
-		// Create views for all individual buffers
-		submesh.VBuffer.CreateViews(num_elements, element_size);
+uint32_t Mesh::AddToPool(const std::vector<PrimitiveData>& primitives, GeometryPool& pool)
+{
+	const uint32_t first_sub_mesh = static_cast<uint32_t>(pool.GetNumSubMeshes());
 
-		submesh.VBuffer.SetName(name_ + " Vertex Buffer");
-		submesh.IBuffer.SetName(name_ + " Index Buffer");
+	for (const auto& primitive : primitives)
+	{
+		std::array<const void*, GeometryLayout::num_streams_> streams;
+		std::array<uint64_t, GeometryLayout::num_streams_> stream_sizes;
+		GetStreams(primitive, streams, stream_sizes);
 
-		delete[] p_buffer;
+		pool.AddSubMesh(streams, stream_sizes, primitive.Indices, primitive.IndexDataSize());
+	}
+
+	return first_sub_mesh;
+}
+
+void Mesh::Create(const std::string& name, const std::vector<PrimitiveData>& primitives, const GeometryPool& pool, uint32_t first_sub_mesh,
+	std::vector<Material>* scene_materials)
+{
+	name_ = name;
+	SetVertexFormat(primitives);
+	bounding_sphere_ = ComputeBoundingSphere(primitives);
+
+	sub_meshes_.resize(primitives.size());
+
+	for (std::size_t i = 0; i < primitives.size(); i++)
+	{
+		const PrimitiveData& primitive = primitives[i];
+		const uint32_t geometry_index = first_sub_mesh + static_cast<uint32_t>(i);
+		const GeometryLayout::SubMesh& region = pool.GetSubMesh(geometry_index);
+		SubMesh& submesh = sub_meshes_[i];
+
+		submesh.Topology		= primitive.Topology;
+		submesh.Lods			= primitive.Lods.empty() ? std::vector<LevelOfDetail>{ { 0, primitive.IndexCount, 0.0f } } : primitive.Lods;
+		submesh.IndexCount		= submesh.Lods[0].IndexCount;
+		submesh.GeometryIndex	= geometry_index;
+
+		// Views into the pool, the data is shared with ray tracing.
+		submesh.VBuffer.SetD3D12Resource(pool.GetVertexBuffer().GetD3D12Resource());
+		submesh.VBuffer.CreateViews(primitive.NumElements, primitive.ElementSize, region.VertexOffset);
+
+		if (submesh.IndexCount > 0)
+		{
+			submesh.IBuffer.SetD3D12Resource(pool.GetIndexBuffer().GetD3D12Resource());
+			submesh.IBuffer.CreateViews(primitive.IndexCount, static_cast<uint32_t>(region.IndexSize), primitive.IndexFormat, region.IndexOffset);
+		}
 
 		// Set material for this sub mesh.
-		if(mesh.Material() >= 0)
+		if (primitive.MaterialIndex >= 0 && scene_materials)
 		{
-			if (scene_materials)
-			{
-				submesh.Material = &scene_materials->at(mesh.Material());
-				submesh.MaterialCB.MaterialIndex = mesh.Material();
-			}			
+			submesh.Material = &scene_materials->at(primitive.MaterialIndex);
+			submesh.MaterialCB.MaterialIndex = primitive.MaterialIndex;
 		}
-		
-		if(t_buffer.HasData())
+
+		submesh.HasTangents = primitive.HasTangents;
+		submesh.Meshlets	= primitive.Meshlets;
+		submesh.Bounds		= primitive.Bounds;
+	}
+}
+
+void Mesh::MoveGeometry(const GeometryPool& pool)
+{
+	for (auto& submesh : sub_meshes_)
+	{
+		if (submesh.GeometryIndex == invalid_geometry_index_)
+			continue;
+
+		submesh.VBuffer.MoveViews(pool.GetVertexBuffer().GetD3D12Resource());
+
+		if (submesh.IndexCount > 0)
 		{
-			submesh.HasTangents = true;
+			submesh.IBuffer.MoveViews(pool.GetIndexBuffer().GetD3D12Resource());
 		}
 	}
 }
@@ -185,42 +460,92 @@ void Mesh::Unload()
 	}
 }
 
-void Mesh::Render(CommandList& command_list)
+void Mesh::SetConstantData(CommandList& command_list, MeshConstantData& constant_data) const
 {
 	Camera& camera = Camera::Get();
 
-	constant_data_.ModelMatrix				= base_transform_ * world_matrix_;
-	
-	XMMATRIX model_view						= constant_data_.ModelMatrix * camera.GetViewMatrix();
-	XMMATRIX inverse_transpose_model		= XMMatrixTranspose(XMMatrixInverse(nullptr, constant_data_.ModelMatrix));
-	XMMATRIX model_view_projection			= constant_data_.ModelMatrix * camera.GetViewMatrix() * camera.GetProjectionMatrix();
-
-	constant_data_.ModelViewMatrix				= model_view;
-	constant_data_.InverseTransposeModelMatrix	= inverse_transpose_model;
-	constant_data_.ModelViewProjectionMatrix	= model_view_projection;
+	constant_data.ViewProjectionMatrix = camera.GetViewMatrix() * camera.GetProjectionMatrix();
 
 	// Bind mesh constant data
-	command_list.SetGraphicsDynamicConstantBuffer(1, constant_data_);
+	command_list.SetGraphicsDynamicConstantBuffer(1, constant_data);
+}
+
+void Mesh::SetInstanceData(CommandList& command_list) const
+{
+	InstanceData instance;
+	instance.ModelMatrix					= base_transform_ * world_matrix_;
+	instance.InverseTransposeModelMatrix	= XMMatrixTranspose(XMMatrixInverse(nullptr, instance.ModelMatrix));
+
+	command_list.SetGraphicsDynamicStructuredBuffer(2, 1, sizeof(InstanceData), &instance);
+}
+
+void Mesh::DrawSubMesh(CommandList& command_list, const SubMesh& submesh, size_t lod, uint32_t num_instances) const
+{
+	// Bind submesh material data
+	command_list.SetGraphicsDynamicConstantBuffer(0, submesh.MaterialCB);
+		
+	command_list.SetPrimitiveTopology(submesh.Topology);
+
+	if (submesh.IndexCount > 0)
+	{
+		const LevelOfDetail& level = submesh.Lods[lod];
+
+		command_list.SetIndexBuffer(submesh.IBuffer);
+		command_list.DrawIndexed(level.IndexCount, num_instances, level.FirstIndex, 0, 0);
+	}
+	else
+	{
+		command_list.Draw(submesh.VBuffer.GetNumVertices(), num_instances, 0, 0);
+	}
+}
+
+void Mesh::Render(CommandList& command_list, float max_error)
+{
+	SetConstantData(command_list, constant_data_);
+	SetInstanceData(command_list);
 
 	for (auto& submesh : sub_meshes_)
 	{
-		// Bind submesh material data
-		command_list.SetGraphicsDynamicConstantBuffer(0, submesh.MaterialCB);
-			
-		command_list.SetPrimitiveTopology(submesh.Topology);
 		command_list.SetVertexBuffer(0, submesh.VBuffer);
-
-		if (submesh.IndexCount > 0)
-		{
-			command_list.SetIndexBuffer(submesh.IBuffer);
-			command_list.DrawIndexed(submesh.IndexCount, 1, 0, 0, 0);
-		}
-		else
-		{
-			command_list.Draw(submesh.VBuffer.GetNumVertices(), 1, 0, 0);
-		}
+		DrawSubMesh(command_list, submesh, SelectLodIndex(submesh.Lods, max_error), 1);
 	}
 }
 
+void Mesh::RenderInstances(CommandList& command_list, size_t sub_mesh, size_t lod, uint32_t first_instance, uint32_t num_instances) const
+{
+	MeshConstantData constant_data = constant_data_;
+	constant_data.FirstInstance = first_instance;
 
+	SetConstantData(command_list, constant_data);
+
+	command_list.SetVertexBuffer(0, sub_meshes_[sub_mesh].VBuffer);
+	DrawSubMesh(command_list, sub_meshes_[sub_mesh], lod, num_instances);
+}
 
+void Mesh::Render(CommandList& command_list, const Skinning& skinning, uint32_t skinned_instance, float max_error)
+{
+	// Skinned positions are quantized relative to the bounds of the current pose, not of the bind pose.
+	MeshConstantData constant_data = constant_data_;
+
+	const XMFLOAT3& position_scale	= skinning.GetPositionScale(skinned_instance);
+	const XMFLOAT3& position_offset	= skinning.GetPositionOffset(skinned_instance);
+	constant_data.PositionScale		= XMFLOAT4(position_scale.x, position_scale.y, position_scale.z, 0.0f);
+	constant_data.PositionOffset	= XMFLOAT4(position_offset.x, position_offset.y, position_offset.z, 0.0f);
+
+	SetConstantData(command_list, constant_data);
+	SetInstanceData(command_list);
+
+	command_list.TransitionBarrier(skinning.GetVertexBuffer(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+
+	for (size_t i = 0; i < sub_meshes_.size(); i++)
+	{
+		// Tangents and texture coordinates come from the pool, positions and normals from the skinned streams.
+		command_list.SetVertexBuffer(0, sub_meshes_[i].VBuffer);
+
+		// The position and normal slots are adjacent, so both skinned streams are bound in one call.
+		const D3D12_VERTEX_BUFFER_VIEW skinned_views[] = { skinning.GetPositionView(skinned_instance, i), skinning.GetNormalView(skinned_instance, i) };
+		command_list.GetGraphicsCommandList()->IASetVertexBuffers(vertex_slot_, _countof(skinned_views), skinned_views);
+
+		DrawSubMesh(command_list, sub_meshes_[i], SelectLodIndex(sub_meshes_[i].Lods, max_error), 1);
+	}
+}
@@ -0,0 +1,730 @@
+#include "neel_engine_pch.h"
+
+#include "mesh_optimizer.h"
+
+#include <unordered_set>
+
+// Chunks are moved around after they are split, their streams point into Storage.
+static_assert(std::is_nothrow_move_constructible<Mesh::PrimitiveData>::value, "PrimitiveData has to keep Storage when it is moved");
+
+// Resolution of the orthographic views the overdraw is measured with.
+static const int overdraw_grid_size = 256;
+
+/**
+* FIFO post-transform cache. A vertex is cached when it was transformed during the last cache_size_ misses.
+*/
+class VertexCache
+{
+public:
+	explicit VertexCache(size_t vertex_count)
+		: timestamps_(vertex_count, 0)
+		, time_(MeshOptimizer::cache_size_ + 1)
+	{}
+
+	// @returns true when the vertex had to be transformed.
+	bool Access(uint32_t vertex)
+	{
+		if (time_ - timestamps_[vertex] <= MeshOptimizer::cache_size_)
+			return false;
+
+		timestamps_[vertex] = time_++;
+		return true;
+	}
+
+	bool Contains(uint32_t vertex) const { return time_ - timestamps_[vertex] <= MeshOptimizer::cache_size_; }
+
+	// Position of a cached vertex in the FIFO, 1 for the most recent one.
+	uint32_t Age(uint32_t vertex) const { return time_ - timestamps_[vertex]; }
+
+	void Clear() { time_ += MeshOptimizer::cache_size_ + 1; }
+
+private:
+	std::vector<uint32_t>	timestamps_;
+	uint32_t				time_;
+};
+
+static XMVECTOR LoadPosition(const float* positions, uint32_t vertex)
+{
+	return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + vertex * 3));
+}
+
+/**
+* Count the pixels of a triangle that pass the depth test, vertices are in grid coordinates with depth in z.
+* Triangles facing the other way are tested against a depth buffer of their own with the depth reversed, as if the
+* axis is viewed from both sides with back face culling.
+*/
+static uint64_t RasterizeTriangle(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c, std::vector<float>& front_depth_buffer, std::vector<float>& back_depth_buffer)
+{
+	const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (area == 0.0f)
+		return 0;
+
+	// Counter clockwise triangles face +z and are seen from +z, clockwise triangles from -z.
+	std::vector<float>& depth_buffer = area > 0.0f ? front_depth_buffer : back_depth_buffer;
+	const float depth_sign = area > 0.0f ? -1.0f : 1.0f;
+
+	const int min_x = std::max(0, static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))));
+	const int min_y = std::max(0, static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))));
+	const int max_x = std::min(overdraw_grid_size - 1, static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))));
+	const int max_y = std::min(overdraw_grid_size - 1, static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))));
+
+	const float inverse_area = 1.0f / area;
+
+	uint64_t shaded = 0;
+	for (int y = min_y; y <= max_y; y++)
+	{
+		for (int x = min_x; x <= max_x; x++)
+		{
+			const float px = x + 0.5f;
+			const float py = y + 0.5f;
+
+			// Barycentric coordinates, independent of the winding.
+			const float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) * inverse_area;
+			const float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) * inverse_area;
+			const float w2 = 1.0f - w0 - w1;
+
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			const float depth = (w0 * a.z + w1 * b.z + w2 * c.z) * depth_sign;
+
+			float& stored_depth = depth_buffer[y * overdraw_grid_size + x];
+			if (depth < stored_depth)
+			{
+				stored_depth = depth;
+				shaded++;
+			}
+		}
+	}
+
+	return shaded;
+}
+
+MeshOptimizer::Stats MeshOptimizer::Analyze(const std::vector<uint32_t>& indices, const float* positions, size_t vertex_count)
+{
+	Stats stats;
+
+	const size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return stats;
+
+	// Vertex cache.
+	{
+		VertexCache cache(vertex_count);
+		std::vector<bool> referenced(vertex_count, false);
+
+		size_t misses = 0;
+		size_t unique_vertices = 0;
+
+		for (size_t i = 0; i < triangle_count * 3; i++)
+		{
+			misses += cache.Access(indices[i]) ? 1 : 0;
+
+			if (!referenced[indices[i]])
+			{
+				referenced[indices[i]] = true;
+				unique_vertices++;
+			}
+		}
+
+		stats.Acmr = static_cast<double>(misses) / triangle_count;
+		stats.Atvr = static_cast<double>(misses) / unique_vertices;
+	}
+
+	// Overdraw, rasterized into orthographic views that fit the bounds of the mesh.
+	{
+		XMVECTOR bounds_min = g_XMFltMax;
+		XMVECTOR bounds_max = XMVectorNegate(g_XMFltMax);
+
+		for (size_t i = 0; i < triangle_count * 3; i++)
+		{
+			const XMVECTOR position = LoadPosition(positions, indices[i]);
+			bounds_min = XMVectorMin(bounds_min, position);
+			bounds_max = XMVectorMax(bounds_max, position);
+		}
+
+		XMFLOAT3 extents;
+		XMStoreFloat3(&extents, bounds_max - bounds_min);
+
+		const float extent = std::max({ extents.x, extents.y, extents.z });
+		const float scale = extent > 0.0f ? overdraw_grid_size / extent : 0.0f;
+
+		std::vector<float> front_depth_buffer(overdraw_grid_size * overdraw_grid_size);
+		std::vector<float> back_depth_buffer(overdraw_grid_size * overdraw_grid_size);
+
+		uint64_t shaded = 0;
+		uint64_t covered = 0;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			std::fill(front_depth_buffer.begin(), front_depth_buffer.end(), FLT_MAX);
+			std::fill(back_depth_buffer.begin(), back_depth_buffer.end(), FLT_MAX);
+
+			for (size_t i = 0; i < triangle_count; i++)
+			{
+				XMFLOAT3 vertices[3];
+				for (size_t k = 0; k < 3; k++)
+				{
+					XMFLOAT3 position;
+					XMStoreFloat3(&position, (LoadPosition(positions, indices[i * 3 + k]) - bounds_min) * scale);
+
+					const float* components = &position.x;
+					vertices[k] = XMFLOAT3(components[(axis + 1) % 3], components[(axis + 2) % 3], components[axis]);
+				}
+
+				shaded += RasterizeTriangle(vertices[0], vertices[1], vertices[2], front_depth_buffer, back_depth_buffer);
+			}
+
+			for (const auto* depth_buffer : { &front_depth_buffer, &back_depth_buffer })
+			{
+				covered += std::count_if(depth_buffer->begin(), depth_buffer->end(), [](float depth) { return depth != FLT_MAX; });
+			}
+		}
+
+		stats.Overdraw = covered > 0 ? static_cast<double>(shaded) / covered : 0.0;
+	}
+
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count, std::vector<size_t>& clusters)
+{
+	clusters.clear();
+
+	const size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	// Triangles around every vertex, a vertex that occurs twice in a triangle lists it twice.
+	std::vector<uint32_t> live_triangles(vertex_count, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+	{
+		live_triangles[indices[i]]++;
+	}
+
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; v++)
+	{
+		adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+	}
+
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	{
+		std::vector<uint32_t> fill = adjacency_offsets;
+		for (size_t i = 0; i < triangle_count * 3; i++)
+		{
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	VertexCache cache(vertex_count);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_end;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+
+	size_t cursor = 0;
+	int64_t fanning = indices[0];
+
+	clusters.push_back(0);
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		for (uint32_t a = adjacency_offsets[fanning]; a < adjacency_offsets[fanning + 1]; a++)
+		{
+			const uint32_t triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + k];
+
+				output.push_back(vertex);
+				dead_end.push_back(vertex);
+				candidates.push_back(vertex);
+
+				live_triangles[vertex]--;
+				cache.Access(vertex);
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// Prefer the candidate that stays in the cache while its remaining triangles are emitted, the oldest one first.
+		int64_t next = -1;
+		int64_t best_priority = -1;
+
+		for (const uint32_t vertex : candidates)
+		{
+			if (live_triangles[vertex] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (cache.Contains(vertex) && cache.Age(vertex) + 2 * live_triangles[vertex] <= cache_size_)
+			{
+				priority = cache.Age(vertex);
+			}
+
+			if (priority > best_priority)
+			{
+				best_priority = priority;
+				next = vertex;
+			}
+		}
+
+		// Dead end: continue at a recently emitted vertex, or at the next vertex in input order.
+		if (next == -1)
+		{
+			while (!dead_end.empty() && next == -1)
+			{
+				const uint32_t vertex = dead_end.back();
+				dead_end.pop_back();
+
+				if (live_triangles[vertex] > 0)
+				{
+					next = vertex;
+				}
+			}
+
+			for (; cursor < vertex_count && next == -1; cursor++)
+			{
+				if (live_triangles[cursor] > 0)
+				{
+					next = static_cast<int64_t>(cursor);
+				}
+			}
+
+			if (next >= 0 && output.size() > clusters.back())
+			{
+				clusters.push_back(output.size());
+			}
+		}
+
+		fanning = next;
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<size_t>& clusters, const float* positions, size_t vertex_count,
+	float threshold)
+{
+	const size_t index_count = indices.size() - indices.size() % 3;
+	if (index_count == 0)
+		return;
+
+	// Split the clusters where the cache miss ratio of the part so far is close to the ratio of the whole cluster.
+	std::vector<size_t> soft_clusters;
+	{
+		VertexCache cache(vertex_count);
+
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			const size_t begin	= clusters[c];
+			const size_t end	= c + 1 < clusters.size() ? clusters[c + 1] : index_count;
+
+			size_t cluster_misses = 0;
+			cache.Clear();
+			for (size_t i = begin; i < end; i++)
+			{
+				cluster_misses += cache.Access(indices[i]) ? 1 : 0;
+			}
+
+			const double cluster_threshold = threshold * static_cast<double>(cluster_misses) / ((end - begin) / 3);
+
+			soft_clusters.push_back(begin);
+
+			size_t misses = 0;
+			size_t triangles = 0;
+			cache.Clear();
+
+			for (size_t i = begin; i < end; i += 3)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					misses += cache.Access(indices[i + k]) ? 1 : 0;
+				}
+				triangles++;
+
+				if (static_cast<double>(misses) / triangles <= cluster_threshold && i + 3 < end)
+				{
+					soft_clusters.push_back(i + 3);
+
+					misses		= 0;
+					triangles	= 0;
+					cache.Clear();
+				}
+			}
+		}
+	}
+
+	// Area weighted centroid and normal of every cluster and of the whole mesh.
+	struct Cluster
+	{
+		size_t	Begin;
+		size_t	End;
+		XMVECTOR Centroid;
+		XMVECTOR Normal;
+		float	SortKey;
+	};
+
+	std::vector<Cluster> sorted(soft_clusters.size());
+
+	XMVECTOR mesh_centroid = XMVectorZero();
+	float mesh_area = 0.0f;
+
+	for (size_t c = 0; c < soft_clusters.size(); c++)
+	{
+		Cluster& cluster = sorted[c];
+		cluster.Begin		= soft_clusters[c];
+		cluster.End			= c + 1 < soft_clusters.size() ? soft_clusters[c + 1] : index_count;
+		cluster.Centroid	= XMVectorZero();
+		cluster.Normal		= XMVectorZero();
+
+		float cluster_area = 0.0f;
+
+		for (size_t i = cluster.Begin; i < cluster.End; i += 3)
+		{
+			const XMVECTOR a = LoadPosition(positions, indices[i]);
+			const XMVECTOR b = LoadPosition(positions, indices[i + 1]);
+			const XMVECTOR c = LoadPosition(positions, indices[i + 2]);
+
+			const XMVECTOR normal = XMVector3Cross(b - a, c - a);
+			const float area = XMVectorGetX(XMVector3Length(normal));
+
+			cluster.Centroid	+= (a + b + c) * (area / 3.0f);
+			cluster.Normal		+= normal;
+			cluster_area		+= area;
+		}
+
+		mesh_centroid	+= cluster.Centroid;
+		mesh_area		+= cluster_area;
+
+		cluster.Centroid = cluster_area > 0.0f ? cluster.Centroid / cluster_area : LoadPosition(positions, indices[cluster.Begin]);
+		cluster.Normal = XMVector3Normalize(cluster.Normal);
+	}
+
+	if (mesh_area > 0.0f)
+	{
+		mesh_centroid /= mesh_area;
+	}
+
+	for (auto& cluster : sorted)
+	{
+		cluster.SortKey = XMVectorGetX(XMVector3Dot(cluster.Centroid - mesh_centroid, cluster.Normal));
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.SortKey > b.SortKey; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	for (const auto& cluster : sorted)
+	{
+		output.insert(output.end(), indices.begin() + cluster.Begin, indices.begin() + cluster.End);
+	}
+
+	// Keep a trailing incomplete triangle where it was.
+	output.insert(output.end(), indices.begin() + index_count, indices.end());
+
+	indices.swap(output);
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertex_count)
+{
+	std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+	uint32_t next_vertex = 0;
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = next_vertex++;
+		}
+
+		index = remap[index];
+	}
+
+	for (auto& vertex : remap)
+	{
+		if (vertex == UINT32_MAX)
+		{
+			vertex = next_vertex++;
+		}
+	}
+
+	return remap;
+}
+
+std::vector<uint32_t> MeshOptimizer::ReadIndices(const Mesh::PrimitiveData& primitive)
+{
+	std::vector<uint32_t> indices(primitive.IndexCount);
+
+	if (primitive.IndexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			uint16_t index;
+			std::memcpy(&index, primitive.Indices + i * 2, sizeof(index));
+			indices[i] = index;
+		}
+	}
+	else
+	{
+		std::memcpy(indices.data(), primitive.Indices, indices.size() * sizeof(uint32_t));
+	}
+
+	return indices;
+}
+
+std::vector<uint32_t> MeshOptimizer::WeldVertices(const Mesh::PrimitiveData& primitive, float epsilon)
+{
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	// Key of a vertex: the bits of all its float attributes, or the attributes snapped to a grid of epsilon.
+	// Vertices are only merged when their joints and weights are bit identical as well.
+	const size_t skin_key_size = primitive.Skin.empty() ? 0 : sizeof(Mesh::SkinVertex) / sizeof(uint32_t);
+
+	size_t key_size = skin_key_size;
+	for (size_t slot = 0; slot < 4; slot++)
+	{
+		key_size += primitive.Streams[slot] ? primitive.ElementSize[slot] / sizeof(float) : 0;
+	}
+
+	std::vector<uint32_t> keys(vertex_count * key_size);
+	{
+		size_t key_offset = 0;
+		for (size_t slot = 0; slot < 4; slot++)
+		{
+			if (!primitive.Streams[slot])
+				continue;
+
+			const size_t num_components = primitive.ElementSize[slot] / sizeof(float);
+			for (size_t v = 0; v < vertex_count; v++)
+			{
+				for (size_t c = 0; c < num_components; c++)
+				{
+					uint32_t& key = keys[v * key_size + key_offset + c];
+					std::memcpy(&key, primitive.Streams[slot] + (v * num_components + c) * sizeof(float), sizeof(uint32_t));
+
+					if (epsilon > 0.0f)
+					{
+						float value;
+						std::memcpy(&value, &key, sizeof(float));
+						key = static_cast<uint32_t>(static_cast<int32_t>(std::lround(value / epsilon)));
+					}
+				}
+			}
+
+			key_offset += num_components;
+		}
+
+		for (size_t v = 0; v < vertex_count && skin_key_size > 0; v++)
+		{
+			std::memcpy(&keys[v * key_size + key_offset], &primitive.Skin[v], sizeof(Mesh::SkinVertex));
+		}
+	}
+
+	auto hash = [&keys, key_size](uint32_t vertex)
+	{
+		uint64_t h = 0xCBF29CE484222325ull;
+		for (size_t i = 0; i < key_size; i++)
+		{
+			h = (h ^ keys[vertex * key_size + i]) * 0x100000001B3ull;
+		}
+
+		return static_cast<size_t>(h);
+	};
+
+	auto equal = [&keys, key_size](uint32_t a, uint32_t b)
+	{
+		return std::memcmp(&keys[a * key_size], &keys[b * key_size], key_size * sizeof(uint32_t)) == 0;
+	};
+
+	std::unordered_set<uint32_t, decltype(hash), decltype(equal)> unique_vertices(vertex_count, hash, equal);
+
+	std::vector<uint32_t> remap(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		remap[v] = *unique_vertices.insert(v).first;
+	}
+
+	return remap;
+}
+
+std::vector<Mesh::PrimitiveData> MeshOptimizer::SplitPrimitive(const Mesh::PrimitiveData& primitive, const std::vector<uint32_t>& indices)
+{
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	// Cut the triangle list where the next triangle would reference more than max_chunk_vertices_ vertices.
+	std::vector<size_t> chunk_starts = { 0 };
+	{
+		std::vector<uint32_t> chunk_of_vertex(vertex_count, UINT32_MAX);
+		uint32_t chunk = 0;
+		size_t chunk_vertices = 0;
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			size_t new_vertices = 0;
+			for (size_t k = 0; k < 3; k++)
+			{
+				const bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+				new_vertices += chunk_of_vertex[indices[i + k]] != chunk && !repeated ? 1 : 0;
+			}
+
+			if (chunk_vertices + new_vertices > max_chunk_vertices_)
+			{
+				chunk++;
+				chunk_starts.push_back(i);
+
+				chunk_vertices = 0;
+				new_vertices = 0;
+				for (size_t k = 0; k < 3; k++)
+				{
+					const bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+					new_vertices += repeated ? 0 : 1;
+				}
+			}
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				chunk_of_vertex[indices[i + k]] = chunk;
+			}
+
+			chunk_vertices += new_vertices;
+		}
+	}
+
+	std::vector<Mesh::PrimitiveData> chunks(chunk_starts.size());
+
+	for (size_t c = 0; c < chunks.size(); c++)
+	{
+		const size_t begin	= chunk_starts[c];
+		const size_t end	= c + 1 < chunk_starts.size() ? chunk_starts[c + 1] : indices.size();
+
+		// Vertices of the chunk are numbered in the order they are first referenced, unreferenced vertices are dropped.
+		std::vector<uint32_t> chunk_indices(indices.begin() + begin, indices.begin() + end);
+		const std::vector<uint32_t> remap = OptimizeVertexFetch(chunk_indices, vertex_count);
+
+		const size_t chunk_vertex_count = chunk_indices.empty() ? 0 : *std::max_element(chunk_indices.begin(), chunk_indices.end()) + 1;
+
+		Mesh::PrimitiveData& chunk = chunks[c];
+		chunk.ElementSize		= primitive.ElementSize;
+		chunk.IndexCount		= static_cast<uint32_t>(chunk_indices.size());
+		chunk.IndexFormat		= chunk_vertex_count <= max_chunk_vertices_ ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		chunk.Topology			= primitive.Topology;
+		chunk.MaterialIndex		= primitive.MaterialIndex;
+		chunk.HasTangents		= primitive.HasTangents;
+		chunk.Quantized			= primitive.Quantized;
+		chunk.PositionScale		= primitive.PositionScale;
+		chunk.PositionOffset	= primitive.PositionOffset;
+
+		for (size_t slot = 0; slot < 4; slot++)
+		{
+			chunk.NumElements[slot] = primitive.Streams[slot] ? chunk_vertex_count : 0;
+		}
+
+		chunk.Storage.resize(chunk.VertexDataSize() + chunk.IndexDataSize());
+		uint8_t* destination = chunk.Storage.data();
+
+		for (size_t slot = 0; slot < 4; slot++)
+		{
+			if (!primitive.Streams[slot])
+				continue;
+
+			const size_t element_size = primitive.ElementSize[slot];
+			for (size_t v = 0; v < vertex_count; v++)
+			{
+				if (remap[v] < chunk_vertex_count)
+				{
+					std::memcpy(destination + remap[v] * element_size, primitive.Streams[slot] + v * element_size, element_size);
+				}
+			}
+
+			chunk.Streams[slot] = destination;
+			destination += chunk.StreamSize(slot);
+		}
+
+		if (!primitive.Skin.empty())
+		{
+			chunk.Skin.resize(chunk_vertex_count);
+			for (size_t v = 0; v < vertex_count; v++)
+			{
+				if (remap[v] < chunk_vertex_count)
+				{
+					chunk.Skin[remap[v]] = primitive.Skin[v];
+				}
+			}
+		}
+
+		for (size_t i = 0; i < chunk_indices.size(); i++)
+		{
+			if (chunk.IndexFormat == DXGI_FORMAT_R16_UINT)
+			{
+				const uint16_t index = static_cast<uint16_t>(chunk_indices[i]);
+				std::memcpy(destination + i * 2, &index, sizeof(index));
+			}
+			else
+			{
+				std::memcpy(destination + i * 4, &chunk_indices[i], sizeof(uint32_t));
+			}
+		}
+
+		chunk.Indices = destination;
+
+		// Chunks cover a part of the positions of the primitive.
+		chunk.Bounds = Mesh::ComputeBounds(chunk);
+	}
+
+	return chunks;
+}
+
+std::vector<Mesh::PrimitiveData> MeshOptimizer::OptimizePrimitive(Mesh::PrimitiveData& primitive, float weld_epsilon)
+{
+	std::vector<Mesh::PrimitiveData> chunks;
+
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	bool optimize = primitive.Topology == D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST && primitive.IndexCount >= 3 && primitive.IndexCount % 3 == 0 &&
+		!primitive.Quantized && primitive.Streams[Mesh::vertex_slot_] && primitive.Indices;
+
+	for (size_t slot = 0; slot < 4 && optimize; slot++)
+	{
+		optimize = !primitive.Streams[slot] || primitive.NumElements[slot] == vertex_count;
+	}
+
+	optimize = optimize && (primitive.Skin.empty() || primitive.Skin.size() == vertex_count);
+
+	std::vector<uint32_t> indices;
+	if (optimize)
+	{
+		indices = ReadIndices(primitive);
+		optimize = std::none_of(indices.begin(), indices.end(), [vertex_count](uint32_t index) { return index >= vertex_count; });
+	}
+
+	if (!optimize)
+	{
+		chunks.push_back(std::move(primitive));
+		return chunks;
+	}
+
+	// Reference a single copy of identical vertices, the duplicates are dropped by the split.
+	const std::vector<uint32_t> weld = WeldVertices(primitive, weld_epsilon);
+	for (auto& index : indices)
+	{
+		index = weld[index];
+	}
+
+	const float* positions = reinterpret_cast<const float*>(primitive.Streams[Mesh::vertex_slot_]);
+
+	std::vector<size_t> clusters;
+	OptimizeVertexCache(indices, vertex_count, clusters);
+	OptimizeOverdraw(indices, clusters, positions, vertex_count);
+
+	return SplitPrimitive(primitive, indices);
+}
@@ -0,0 +1,627 @@
+#include "neel_engine_pch.h"
+
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+
+#include <numeric>
+#include <unordered_set>
+
+/**
+* Sum of squared distances to a set of planes: p^T A p + 2 b^T p + c, A symmetric.
+*/
+struct Quadric
+{
+	double A00 = 0.0, A01 = 0.0, A02 = 0.0, A11 = 0.0, A12 = 0.0, A22 = 0.0;
+	double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+	double C = 0.0;
+
+	// Plane through p with unit normal n.
+	static Quadric FromPlane(const double* n, const double* p)
+	{
+		const double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+
+		Quadric q;
+		q.A00 = n[0] * n[0]; q.A01 = n[0] * n[1]; q.A02 = n[0] * n[2];
+		q.A11 = n[1] * n[1]; q.A12 = n[1] * n[2]; q.A22 = n[2] * n[2];
+		q.B0 = n[0] * d; q.B1 = n[1] * d; q.B2 = n[2] * d;
+		q.C = d * d;
+		return q;
+	}
+
+	void Add(const Quadric& other)
+	{
+		A00 += other.A00; A01 += other.A01; A02 += other.A02;
+		A11 += other.A11; A12 += other.A12; A22 += other.A22;
+		B0 += other.B0; B1 += other.B1; B2 += other.B2;
+		C += other.C;
+	}
+
+	double Evaluate(const float* p) const
+	{
+		const double x = p[0], y = p[1], z = p[2];
+
+		const double error = x * (A00 * x + 2.0 * (A01 * y + A02 * z + B0)) + y * (A11 * y + 2.0 * (A12 * z + B1)) + z * (A22 * z + 2.0 * B2) + C;
+		return std::max(error, 0.0);
+	}
+};
+
+struct Collapse
+{
+	double		Error;
+	uint32_t	From;
+	uint32_t	To;
+
+	bool operator<(const Collapse& other) const
+	{
+		return Error != other.Error ? Error < other.Error : (From != other.From ? From < other.From : To < other.To);
+	}
+};
+
+// For every vertex the first vertex with a bit identical position.
+static std::vector<uint32_t> GetPositionRemap(const float* positions, size_t vertex_count)
+{
+	auto hash = [positions](uint32_t vertex)
+	{
+		uint32_t bits[3];
+		std::memcpy(bits, positions + vertex * 3, sizeof(bits));
+
+		uint64_t h = 0xCBF29CE484222325ull;
+		for (uint32_t bit : bits)
+		{
+			h = (h ^ bit) * 0x100000001B3ull;
+		}
+
+		return static_cast<size_t>(h);
+	};
+
+	auto equal = [positions](uint32_t a, uint32_t b)
+	{
+		return std::memcmp(positions + a * 3, positions + b * 3, 3 * sizeof(float)) == 0;
+	};
+
+	std::unordered_set<uint32_t, decltype(hash), decltype(equal)> unique_positions(vertex_count, hash, equal);
+
+	std::vector<uint32_t> remap(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		remap[v] = *unique_positions.insert(v).first;
+	}
+
+	return remap;
+}
+
+static void TriangleNormal(const float* p0, const float* p1, const float* p2, double* normal)
+{
+	const double e1[3] = { static_cast<double>(p1[0]) - p0[0], static_cast<double>(p1[1]) - p0[1], static_cast<double>(p1[2]) - p0[2] };
+	const double e2[3] = { static_cast<double>(p2[0]) - p0[0], static_cast<double>(p2[1]) - p0[1], static_cast<double>(p2[2]) - p0[2] };
+
+	normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// Distance from p to the triangle abc (Ericson, "Real-Time Collision Detection", 5.1.5).
+static double PointTriangleDistance(const float* p, const float* a, const float* b, const float* c)
+{
+	double ab[3], ac[3], ap[3], bp[3], cp[3];
+	for (size_t i = 0; i < 3; i++)
+	{
+		ab[i] = static_cast<double>(b[i]) - a[i];
+		ac[i] = static_cast<double>(c[i]) - a[i];
+		ap[i] = static_cast<double>(p[i]) - a[i];
+		bp[i] = static_cast<double>(p[i]) - b[i];
+		cp[i] = static_cast<double>(p[i]) - c[i];
+	}
+
+	auto dot = [](const double* x, const double* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+
+	// Closest point a + v * ab + w * ac.
+	double v = 0.0, w = 0.0;
+
+	const double d1 = dot(ab, ap), d2 = dot(ac, ap);
+	const double d3 = dot(ab, bp), d4 = dot(ac, bp);
+	const double d5 = dot(ab, cp), d6 = dot(ac, cp);
+
+	const double edge_a = d3 * d6 - d5 * d4;
+	const double edge_b = d5 * d2 - d1 * d6;
+	const double edge_c = d1 * d4 - d3 * d2;
+
+	if (d1 <= 0.0 && d2 <= 0.0)
+	{
+	}
+	else if (d3 >= 0.0 && d4 <= d3)
+	{
+		v = 1.0;
+	}
+	else if (edge_c <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+	{
+		v = d1 / (d1 - d3);
+	}
+	else if (d6 >= 0.0 && d5 <= d6)
+	{
+		w = 1.0;
+	}
+	else if (edge_b <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+	{
+		w = d2 / (d2 - d6);
+	}
+	else if (edge_a <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+	{
+		w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		v = 1.0 - w;
+	}
+	else
+	{
+		const double denominator = 1.0 / (edge_a + edge_b + edge_c);
+		v = edge_b * denominator;
+		w = edge_c * denominator;
+	}
+
+	double distance = 0.0;
+	for (size_t i = 0; i < 3; i++)
+	{
+		const double d = ap[i] - v * ab[i] - w * ac[i];
+		distance += d * d;
+	}
+
+	return std::sqrt(distance);
+}
+
+/**
+* Edge collapse state of a triangle list. Collapses are done in passes, every pass sorts the collapses of all edges by
+* their quadric error and performs the cheapest ones that do not share triangles.
+*/
+class Simplification
+{
+public:
+	Simplification(const std::vector<uint32_t>& indices, const float* positions, size_t vertex_count)
+		: indices_(indices)
+		, positions_(positions)
+		, position_remap_(GetPositionRemap(positions, vertex_count))
+		, locked_(vertex_count, 0)
+		, quadrics_(vertex_count)
+		, vertex_target_(vertex_count)
+		, collapse_target_(vertex_count)
+		, touched_(vertex_count)
+		, triangle_offsets_(vertex_count + 1)
+		, best_collapses_(vertex_count)
+		, result_(indices)
+		, quadric_error_(0.0)
+	{
+		std::iota(vertex_target_.begin(), vertex_target_.end(), 0u);
+
+		LockVertices();
+		ComputeQuadrics();
+	}
+
+	const std::vector<uint32_t>& GetResult() const { return result_; }
+
+	/**
+	* Collapse edges until the result has at most target_index_count indices or the next collapse has an error
+	* (squared distance) larger than max_error.
+	*/
+	void Run(size_t target_index_count, double max_error)
+	{
+		while (result_.size() > target_index_count && Pass(target_index_count, max_error))
+		{
+		}
+	}
+
+	// Largest distance of an input vertex to the result triangles within two rings of the vertex it was collapsed into.
+	float MeasureError();
+
+private:
+	// Vertices on seams, borders and non-manifold edges are never removed.
+	void LockVertices();
+
+	void ComputeQuadrics();
+
+	// Triangles of the result around every position, indexed by position_remap_.
+	void BuildAdjacency();
+
+	// @returns false when no more edges could be collapsed.
+	bool Pass(size_t target_index_count, double max_error);
+
+	const std::vector<uint32_t>& indices_;
+	const float* positions_;
+
+	// Vertices are identified by their position, copies of a vertex with other attributes are on a seam.
+	std::vector<uint32_t> position_remap_;
+	std::vector<uint8_t> locked_;
+	std::vector<Quadric> quadrics_;
+
+	// Vertex every input vertex was collapsed into so far.
+	std::vector<uint32_t> vertex_target_;
+
+	std::vector<uint32_t> collapse_target_;
+	std::vector<uint8_t> touched_;
+	std::vector<uint32_t> triangle_offsets_;
+	std::vector<uint32_t> vertex_triangles_;
+	std::vector<Collapse> best_collapses_;
+	std::vector<Collapse> collapses_;
+
+	std::vector<uint32_t> result_;
+	double quadric_error_;
+};
+
+void Simplification::LockVertices()
+{
+	const size_t vertex_count = locked_.size();
+
+	std::vector<uint32_t> copies(vertex_count, 0);
+	std::vector<uint8_t> referenced(vertex_count, 0);
+	for (uint32_t index : indices_)
+	{
+		referenced[index] = 1;
+	}
+
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		copies[position_remap_[v]] += referenced[v];
+	}
+
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		locked_[v] = copies[position_remap_[v]] > 1 ? 1 : 0;
+	}
+
+	// Edges with a single triangle (borders) or more than two (non-manifold) keep their vertices.
+	std::vector<uint64_t> edges;
+	edges.reserve(indices_.size());
+	for (size_t i = 0; i + 2 < indices_.size(); i += 3)
+	{
+		for (size_t k = 0; k < 3; k++)
+		{
+			const uint32_t a = position_remap_[indices_[i + k]];
+			const uint32_t b = position_remap_[indices_[i + (k + 1) % 3]];
+			edges.push_back(static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+
+	for (size_t i = 0; i < edges.size(); )
+	{
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+		{
+			j++;
+		}
+
+		if (j - i != 2)
+		{
+			locked_[static_cast<uint32_t>(edges[i] >> 32)] = 1;
+			locked_[static_cast<uint32_t>(edges[i])] = 1;
+		}
+
+		i = j;
+	}
+
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		locked_[v] |= locked_[position_remap_[v]];
+	}
+}
+
+void Simplification::ComputeQuadrics()
+{
+	for (size_t i = 0; i + 2 < indices_.size(); i += 3)
+	{
+		const float* p0 = positions_ + indices_[i + 0] * 3;
+
+		double normal[3];
+		TriangleNormal(p0, positions_ + indices_[i + 1] * 3, positions_ + indices_[i + 2] * 3, normal);
+
+		const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length == 0.0)
+			continue;
+
+		normal[0] /= length;
+		normal[1] /= length;
+		normal[2] /= length;
+
+		const double point[3] = { p0[0], p0[1], p0[2] };
+		const Quadric quadric = Quadric::FromPlane(normal, point);
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			quadrics_[position_remap_[indices_[i + k]]].Add(quadric);
+		}
+	}
+}
+
+void Simplification::BuildAdjacency()
+{
+	std::fill(triangle_offsets_.begin(), triangle_offsets_.end(), 0);
+	for (uint32_t index : result_)
+	{
+		triangle_offsets_[position_remap_[index] + 1]++;
+	}
+
+	for (size_t v = 0; v + 1 < triangle_offsets_.size(); v++)
+	{
+		triangle_offsets_[v + 1] += triangle_offsets_[v];
+	}
+
+	vertex_triangles_.resize(result_.size());
+
+	std::vector<uint32_t> fill(triangle_offsets_.begin(), triangle_offsets_.end() - 1);
+	for (size_t i = 0; i < result_.size(); i++)
+	{
+		vertex_triangles_[fill[position_remap_[result_[i]]]++] = static_cast<uint32_t>(i / 3);
+	}
+}
+
+bool Simplification::Pass(size_t target_index_count, double max_error)
+{
+	BuildAdjacency();
+
+	// The cheapest collapse of every vertex that is free to move, edges are visited in both directions.
+	const Collapse no_collapse = { DBL_MAX, UINT32_MAX, UINT32_MAX };
+	std::fill(best_collapses_.begin(), best_collapses_.end(), no_collapse);
+
+	for (size_t i = 0; i < result_.size(); i++)
+	{
+		const uint32_t a = result_[i];
+		const uint32_t b = result_[i % 3 == 2 ? i - 2 : i + 1];
+
+		for (const auto& edge : { std::make_pair(a, b), std::make_pair(b, a) })
+		{
+			if (locked_[edge.first])
+				continue;
+
+			const Collapse collapse = { quadrics_[position_remap_[edge.first]].Evaluate(positions_ + edge.second * 3), edge.first, edge.second };
+			if (collapse < best_collapses_[edge.first])
+			{
+				best_collapses_[edge.first] = collapse;
+			}
+		}
+	}
+
+	collapses_.clear();
+	for (const auto& collapse : best_collapses_)
+	{
+		if (collapse.From != UINT32_MAX)
+		{
+			collapses_.push_back(collapse);
+		}
+	}
+
+	std::sort(collapses_.begin(), collapses_.end());
+
+	std::iota(collapse_target_.begin(), collapse_target_.end(), 0u);
+	std::fill(touched_.begin(), touched_.end(), 0);
+
+	const size_t triangles_to_remove = (result_.size() - target_index_count + 2) / 3;
+	size_t triangles_removed = 0;
+
+	for (const auto& collapse : collapses_)
+	{
+		if (triangles_removed >= triangles_to_remove || collapse.Error > max_error)
+			break;
+
+		const uint32_t from = collapse.From;
+		const uint32_t to = collapse.To;
+
+		if (touched_[from] || touched_[to])
+			continue;
+
+		// Reject collapses that flip a triangle around the removed vertex.
+		bool flips = false;
+		size_t removed = 0;
+
+		for (uint32_t t = triangle_offsets_[from]; t < triangle_offsets_[from + 1] && !flips; t++)
+		{
+			const uint32_t* triangle = &result_[vertex_triangles_[t] * 3];
+
+			if (position_remap_[triangle[0]] == position_remap_[to] || position_remap_[triangle[1]] == position_remap_[to] ||
+				position_remap_[triangle[2]] == position_remap_[to])
+			{
+				removed++;
+				continue;
+			}
+
+			const float* before[3];
+			const float* after[3];
+			for (size_t k = 0; k < 3; k++)
+			{
+				before[k]	= positions_ + triangle[k] * 3;
+				after[k]	= triangle[k] == from ? positions_ + to * 3 : before[k];
+			}
+
+			double normal_before[3], normal_after[3];
+			TriangleNormal(before[0], before[1], before[2], normal_before);
+			TriangleNormal(after[0], after[1], after[2], normal_after);
+
+			flips = normal_before[0] * normal_after[0] + normal_before[1] * normal_after[1] + normal_before[2] * normal_after[2] <= 0.0;
+		}
+
+		if (flips)
+			continue;
+
+		collapse_target_[from] = to;
+		quadrics_[position_remap_[to]].Add(quadrics_[position_remap_[from]]);
+		quadric_error_ = std::max(quadric_error_, collapse.Error);
+		triangles_removed += removed;
+
+		// Collapses of a pass do not share triangles, so they are independent of each other.
+		for (uint32_t t = triangle_offsets_[from]; t < triangle_offsets_[from + 1]; t++)
+		{
+			const uint32_t* triangle = &result_[vertex_triangles_[t] * 3];
+			touched_[triangle[0]] = touched_[triangle[1]] = touched_[triangle[2]] = 1;
+		}
+	}
+
+	if (triangles_removed == 0)
+		return false;
+
+	for (auto& target : vertex_target_)
+	{
+		target = collapse_target_[target];
+	}
+
+	// Apply the collapses and drop the triangles that became degenerate.
+	size_t write = 0;
+	for (size_t i = 0; i < result_.size(); i += 3)
+	{
+		const uint32_t a = collapse_target_[result_[i + 0]];
+		const uint32_t b = collapse_target_[result_[i + 1]];
+		const uint32_t c = collapse_target_[result_[i + 2]];
+
+		if (position_remap_[a] == position_remap_[b] || position_remap_[b] == position_remap_[c] || position_remap_[c] == position_remap_[a])
+			continue;
+
+		result_[write++] = a;
+		result_[write++] = b;
+		result_[write++] = c;
+	}
+
+	result_.resize(write);
+
+	return true;
+}
+
+float Simplification::MeasureError()
+{
+	BuildAdjacency();
+
+	std::vector<uint8_t> measured(locked_.size(), 0);
+	double error = 0.0;
+
+	for (uint32_t vertex : indices_)
+	{
+		if (measured[vertex])
+			continue;
+
+		measured[vertex] = 1;
+
+		// Copies of a seam vertex share their triangles.
+		const uint32_t target = position_remap_[vertex_target_[vertex]];
+		if (target == position_remap_[vertex])
+			continue;
+
+		// The triangles around the target can be gone when it was on a part of the mesh that collapsed completely.
+		double distance = triangle_offsets_[target] == triangle_offsets_[target + 1] ? std::sqrt(quadric_error_) : DBL_MAX;
+
+		// The closest triangle is usually around the target or one of its neighbours.
+		for (uint32_t t = triangle_offsets_[target]; t < triangle_offsets_[target + 1]; t++)
+		{
+			const uint32_t* ring = &result_[vertex_triangles_[t] * 3];
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				const uint32_t neighbour = position_remap_[ring[k]];
+
+				for (uint32_t n = triangle_offsets_[neighbour]; n < triangle_offsets_[neighbour + 1]; n++)
+				{
+					const uint32_t* triangle = &result_[vertex_triangles_[n] * 3];
+					distance = std::min(distance, PointTriangleDistance(positions_ + vertex * 3, positions_ + triangle[0] * 3,
+						positions_ + triangle[1] * 3, positions_ + triangle[2] * 3));
+				}
+			}
+		}
+
+		error = std::max(error, distance);
+	}
+
+	return static_cast<float>(error);
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<uint32_t>& indices, const float* positions, size_t vertex_count,
+	size_t target_index_count, float target_error, float* result_error)
+{
+	Simplification simplification(indices, positions, vertex_count);
+	simplification.Run(target_index_count, static_cast<double>(target_error) * target_error);
+
+	if (result_error)
+	{
+		*result_error = simplification.MeasureError();
+	}
+
+	return simplification.GetResult();
+}
+
+void MeshSimplifier::BuildLodChain(Mesh::PrimitiveData& primitive)
+{
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	if (primitive.Topology != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST || primitive.IndexCount < 3 || primitive.IndexCount % 3 != 0 ||
+		primitive.Quantized || !primitive.Streams[Mesh::vertex_slot_] || !primitive.Indices || !primitive.Lods.empty())
+	{
+		return;
+	}
+
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+	if (std::any_of(indices.begin(), indices.end(), [vertex_count](uint32_t index) { return index >= vertex_count; }))
+		return;
+
+	const float* positions = reinterpret_cast<const float*>(primitive.Streams[Mesh::vertex_slot_]);
+
+	std::vector<Mesh::LevelOfDetail> lods = { { 0, primitive.IndexCount, 0.0f } };
+	std::vector<uint32_t> lod_indices = indices;
+
+	// Every level continues simplifying where the previous one stopped.
+	Simplification simplification(indices, positions, vertex_count);
+
+	while (lods.size() < max_lods_)
+	{
+		const size_t previous_count = lods.back().IndexCount;
+		const size_t target_count = previous_count / 6 * 3;
+
+		if (target_count / 3 < min_lod_triangles_)
+			break;
+
+		simplification.Run(target_count, DBL_MAX);
+
+		// Stop when locked vertices keep the mesh from getting much simpler.
+		std::vector<uint32_t> lod = simplification.GetResult();
+		if (lod.empty() || lod.size() * 10 > previous_count * 9)
+			break;
+
+		const float error = simplification.MeasureError();
+
+		std::vector<size_t> clusters;
+		MeshOptimizer::OptimizeVertexCache(lod, vertex_count, clusters);
+
+		// Errors grow with the level, so a coarser level is never selected before a finer one.
+		lods.push_back({ static_cast<uint32_t>(lod_indices.size()), static_cast<uint32_t>(lod.size()), std::max(error, lods.back().Error) });
+		lod_indices.insert(lod_indices.end(), lod.begin(), lod.end());
+	}
+
+	if (lods.size() == 1)
+		return;
+
+	// New storage with the vertex streams followed by the indices of all levels.
+	const size_t index_size = primitive.IndexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+
+	std::vector<uint8_t> storage(primitive.VertexDataSize() + lod_indices.size() * index_size);
+	uint8_t* destination = storage.data();
+
+	for (size_t slot = 0; slot < 4; slot++)
+	{
+		if (!primitive.Streams[slot])
+			continue;
+
+		std::memcpy(destination, primitive.Streams[slot], primitive.StreamSize(slot));
+		primitive.Streams[slot] = destination;
+		destination += primitive.StreamSize(slot);
+	}
+
+	for (size_t i = 0; i < lod_indices.size(); i++)
+	{
+		if (index_size == 2)
+		{
+			const uint16_t index = static_cast<uint16_t>(lod_indices[i]);
+			std::memcpy(destination + i * 2, &index, sizeof(index));
+		}
+		else
+		{
+			std::memcpy(destination + i * 4, &lod_indices[i], sizeof(uint32_t));
+		}
+	}
+
+	primitive.Indices		= destination;
+	primitive.IndexCount	= static_cast<uint32_t>(lod_indices.size());
+	primitive.Storage.swap(storage);
+	primitive.Lods			= std::move(lods);
+}
@@ -0,0 +1,240 @@
+#include "neel_engine_pch.h"
+
+#include "meshlet_builder.h"
+#include "mesh_optimizer.h"
+
+// Meshlets that are never culled by their normal cone.
+static const float disabled_cone_cutoff = 2.0f;
+
+static XMVECTOR LoadPosition(const float* positions, uint32_t vertex)
+{
+	return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + vertex * 3));
+}
+
+MeshletData MeshletBuilder::Build(const std::vector<uint32_t>& indices, const float* positions, size_t vertex_count,
+	size_t max_vertices, size_t max_triangles)
+{
+	if (max_vertices < 3 || max_vertices > 256 || max_triangles < 1)
+	{
+		throw std::invalid_argument("Meshlets need between 3 and 256 vertices and at least one triangle.");
+	}
+
+	MeshletData data;
+
+	// Local index of every vertex in the current meshlet.
+	std::vector<uint32_t> local(vertex_count, UINT32_MAX);
+
+	Meshlet meshlet = {};
+
+	auto finish_meshlet = [&]()
+	{
+		if (meshlet.TriangleCount == 0)
+			return;
+
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+		{
+			local[data.Vertices[meshlet.VertexOffset + i]] = UINT32_MAX;
+		}
+
+		data.Meshlets.push_back(meshlet);
+
+		// Keep the triangles of every meshlet 4 byte aligned for 32-bit loads.
+		data.Triangles.resize(math::AlignUp(data.Triangles.size(), size_t(4)), 0);
+
+		meshlet.VertexOffset	= static_cast<uint32_t>(data.Vertices.size());
+		meshlet.VertexCount		= 0;
+		meshlet.TriangleOffset	= static_cast<uint32_t>(data.Triangles.size());
+		meshlet.TriangleCount	= 0;
+	};
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const uint32_t a = indices[i + 0];
+		const uint32_t b = indices[i + 1];
+		const uint32_t c = indices[i + 2];
+
+		const uint32_t new_vertices = (local[a] == UINT32_MAX) + (local[b] == UINT32_MAX && b != a) + (local[c] == UINT32_MAX && c != a && c != b);
+
+		if (meshlet.VertexCount + new_vertices > max_vertices || meshlet.TriangleCount == max_triangles)
+		{
+			finish_meshlet();
+		}
+
+		for (uint32_t vertex : { a, b, c })
+		{
+			if (local[vertex] == UINT32_MAX)
+			{
+				local[vertex] = meshlet.VertexCount++;
+				data.Vertices.push_back(vertex);
+			}
+
+			data.Triangles.push_back(static_cast<uint8_t>(local[vertex]));
+		}
+
+		meshlet.TriangleCount++;
+	}
+
+	finish_meshlet();
+
+	data.Bounds.reserve(data.Meshlets.size());
+	for (const auto& m : data.Meshlets)
+	{
+		data.Bounds.push_back(ComputeBounds(data, m, positions));
+	}
+
+	return data;
+}
+
+MeshletData MeshletBuilder::Build(const Mesh::PrimitiveData& primitive)
+{
+	if (primitive.Topology != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST || primitive.IndexCount < 3 || primitive.Quantized ||
+		!primitive.Streams[Mesh::vertex_slot_] || !primitive.Indices)
+	{
+		return MeshletData();
+	}
+
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	// Levels of detail follow the full resolution indices.
+	std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+	indices.resize(primitive.Lods.empty() ? indices.size() : primitive.Lods[0].IndexCount);
+
+	if (std::any_of(indices.begin(), indices.end(), [vertex_count](uint32_t index) { return index >= vertex_count; }))
+	{
+		return MeshletData();
+	}
+
+	return Build(indices, reinterpret_cast<const float*>(primitive.Streams[Mesh::vertex_slot_]), vertex_count);
+}
+
+MeshletBounds MeshletBuilder::ComputeBounds(const MeshletData& data, const Meshlet& meshlet, const float* positions)
+{
+	const uint32_t* vertices = data.Vertices.data() + meshlet.VertexOffset;
+	const uint8_t* triangles = data.Triangles.data() + meshlet.TriangleOffset;
+
+	MeshletBounds bounds;
+
+	// Axis aligned box.
+	XMVECTOR aabb_min = LoadPosition(positions, vertices[0]);
+	XMVECTOR aabb_max = aabb_min;
+	for (uint32_t i = 1; i < meshlet.VertexCount; i++)
+	{
+		const XMVECTOR position = LoadPosition(positions, vertices[i]);
+		aabb_min = XMVectorMin(aabb_min, position);
+		aabb_max = XMVectorMax(aabb_max, position);
+	}
+
+	XMStoreFloat3(&bounds.AabbMin, aabb_min);
+	XMStoreFloat3(&bounds.AabbMax, aabb_max);
+
+	// Ritter's bounding sphere: start from two distant vertices and grow the sphere for the ones outside of it.
+	auto farthest_from = [&](FXMVECTOR point)
+	{
+		XMVECTOR farthest = LoadPosition(positions, vertices[0]);
+		float max_distance = -1.0f;
+
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+		{
+			const XMVECTOR position = LoadPosition(positions, vertices[i]);
+			const float distance = XMVectorGetX(XMVector3LengthSq(position - point));
+
+			if (distance > max_distance)
+			{
+				max_distance = distance;
+				farthest = position;
+			}
+		}
+
+		return farthest;
+	};
+
+	const XMVECTOR first = farthest_from(LoadPosition(positions, vertices[0]));
+	const XMVECTOR second = farthest_from(first);
+
+	XMVECTOR center = (first + second) * 0.5f;
+	float radius = XMVectorGetX(XMVector3Length(second - first)) * 0.5f;
+
+	for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+	{
+		const XMVECTOR position = LoadPosition(positions, vertices[i]);
+		const float distance = XMVectorGetX(XMVector3Length(position - center));
+
+		if (distance > radius)
+		{
+			const float new_radius = (radius + distance) * 0.5f;
+			center += (position - center) * ((new_radius - radius) / distance);
+			radius = new_radius;
+		}
+	}
+
+	XMStoreFloat3(&bounds.Center, center);
+	bounds.Radius = radius;
+
+	// Normal cone around the average of the triangle normals.
+	std::vector<XMVECTOR> normals;
+	std::vector<XMVECTOR> corners;
+	normals.reserve(meshlet.TriangleCount);
+	corners.reserve(meshlet.TriangleCount);
+
+	XMVECTOR axis = XMVectorZero();
+
+	for (uint32_t i = 0; i < meshlet.TriangleCount; i++)
+	{
+		const XMVECTOR p0 = LoadPosition(positions, vertices[triangles[i * 3 + 0]]);
+		const XMVECTOR p1 = LoadPosition(positions, vertices[triangles[i * 3 + 1]]);
+		const XMVECTOR p2 = LoadPosition(positions, vertices[triangles[i * 3 + 2]]);
+
+		// Counter clockwise triangles are front facing.
+		const XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+		if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.0f)
+			continue;
+
+		normals.push_back(XMVector3Normalize(normal));
+		corners.push_back(p0);
+		axis += normals.back();
+	}
+
+	bounds.ConeApex		= bounds.Center;
+	bounds.ConeAxis		= XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.ConeCutoff	= disabled_cone_cutoff;
+
+	if (normals.empty() || XMVectorGetX(XMVector3LengthSq(axis)) == 0.0f)
+		return bounds;
+
+	axis = XMVector3Normalize(axis);
+
+	float min_dot = 1.0f;
+	for (size_t i = 0; i < normals.size(); i++)
+	{
+		min_dot = std::min(min_dot, XMVectorGetX(XMVector3Dot(normals[i], axis)));
+	}
+
+	XMStoreFloat3(&bounds.ConeAxis, axis);
+
+	// Normals spread over more than a hemisphere (with some margin), no view sees only back faces.
+	if (min_dot <= 0.1f)
+		return bounds;
+
+	// Apex on the axis behind the planes of all triangles, so cones of view directions from the apex are conservative.
+	float max_t = 0.0f;
+	for (size_t i = 0; i < normals.size(); i++)
+	{
+		const float t = XMVectorGetX(XMVector3Dot(center - corners[i], normals[i])) / XMVectorGetX(XMVector3Dot(axis, normals[i]));
+		max_t = std::max(max_t, t);
+	}
+
+	XMStoreFloat3(&bounds.ConeApex, center - axis * max_t);
+	bounds.ConeCutoff = std::sqrt(1.0f - min_dot * min_dot);
+
+	return bounds;
+}
+
+bool MeshletBuilder::IsBackFacing(const MeshletBounds& bounds, FXMVECTOR camera_position)
+{
+	if (bounds.ConeCutoff > 1.0f)
+		return false;
+
+	const XMVECTOR view = XMVector3Normalize(XMLoadFloat3(&bounds.ConeApex) - camera_position);
+
+	return XMVectorGetX(XMVector3Dot(view, XMLoadFloat3(&bounds.ConeAxis))) >= bounds.ConeCutoff;
+}
@@ -0,0 +1,59 @@
+#include "neel_engine_pch.h"
+
+#include "ray_sorter.h"
+#include "render_queue.h"
+
+// Moves the low 10 bits of a value to every third bit.
+static uint32_t SpreadBits(uint32_t value)
+{
+	value &= 0x3ff;
+	value = (value | (value << 16)) & 0x030000ff;
+	value = (value | (value << 8)) & 0x0300f00f;
+	value = (value | (value << 4)) & 0x030c30c3;
+	value = (value | (value << 2)) & 0x09249249;
+
+	return value;
+}
+
+uint32_t RaySorter::GetMortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+	return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+}
+
+uint64_t XM_CALLCONV RaySorter::MakeKey(const Bvh::Ray& ray, FXMVECTOR bounds_min, FXMVECTOR inverse_extent)
+{
+	const float max_cell = static_cast<float>((1u << morton_bits_) - 1);
+
+	XMFLOAT3 cell;
+	XMStoreFloat3(&cell, XMVectorClamp((XMLoadFloat3(&ray.Origin) - bounds_min) * inverse_extent, XMVectorZero(), XMVectorReplicate(1.0f)) * max_cell);
+
+	const uint32_t octant = (ray.Direction.x < 0.0f ? 1 : 0) | (ray.Direction.y < 0.0f ? 2 : 0) | (ray.Direction.z < 0.0f ? 4 : 0);
+
+	return static_cast<uint64_t>(octant) << (3 * morton_bits_) |
+		GetMortonCode(static_cast<uint32_t>(cell.x), static_cast<uint32_t>(cell.y), static_cast<uint32_t>(cell.z));
+}
+
+void RaySorter::Sort(const Bvh::Ray* rays, size_t count, const XMFLOAT3& bounds_min, const XMFLOAT3& bounds_max)
+{
+	const XMVECTOR minimum = XMLoadFloat3(&bounds_min);
+	const XMVECTOR inverse_extent = XMVectorReciprocal(XMVectorMax(XMLoadFloat3(&bounds_max) - minimum, XMVectorReplicate(FLT_MIN)));
+
+	keys_.resize(count);
+	order_.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		keys_[i] = MakeKey(rays[i], minimum, inverse_extent);
+		order_[i] = static_cast<uint32_t>(i);
+	}
+
+	RenderQueue::RadixSort(keys_, order_, temp_keys_, temp_order_);
+}
+
+void RaySorter::Gather(const Bvh::Ray* rays, Bvh::Ray* sorted_rays) const
+{
+	for (size_t i = 0; i < order_.size(); i++)
+	{
+		sorted_rays[i] = rays[order_[i]];
+	}
+}
@@ -0,0 +1,106 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+uint64_t RenderQueue::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t depth_bucket)
+{
+	if (pass > max_pass_ || pipeline > max_pipeline_ || material > max_material_ || depth_bucket > max_depth_bucket_)
+	{
+		throw std::invalid_argument("Render queue key field does not fit into its bits.");
+	}
+
+	return static_cast<uint64_t>(pass) << (pipeline_bits_ + material_bits_ + depth_bits_) |
+		static_cast<uint64_t>(pipeline) << (material_bits_ + depth_bits_) |
+		static_cast<uint64_t>(material) << depth_bits_ |
+		depth_bucket;
+}
+
+uint32_t RenderQueue::QuantizeDepth(float depth, float near_clip, float far_clip)
+{
+	if (!(depth > near_clip) || !(far_clip > near_clip) || near_clip <= 0.0f)
+		return 0;
+
+	if (depth >= far_clip)
+		return max_depth_bucket_;
+
+	const float t = std::log(depth / near_clip) / std::log(far_clip / near_clip);
+
+	return std::min(static_cast<uint32_t>(t * max_depth_bucket_), max_depth_bucket_);
+}
+
+void RenderQueue::RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, std::vector<uint64_t>& temp_keys,
+	std::vector<uint32_t>& temp_values)
+{
+	const size_t num_keys = keys.size();
+	if (num_keys < 2)
+		return;
+
+	temp_keys.resize(num_keys);
+	temp_values.resize(num_keys);
+
+	// Histograms of all 8 bytes in a single pass over the keys.
+	uint32_t counts[8][256] = {};
+
+	for (uint64_t key : keys)
+	{
+		for (uint32_t digit = 0; digit < 8; digit++)
+		{
+			counts[digit][(key >> (digit * 8)) & 0xff]++;
+		}
+	}
+
+	for (uint32_t digit = 0; digit < 8; digit++)
+	{
+		uint32_t* count = counts[digit];
+
+		// All keys in one bucket leave the order as it is.
+		if (count[(keys[0] >> (digit * 8)) & 0xff] == num_keys)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++)
+		{
+			const uint32_t bucket_count = count[bucket];
+			count[bucket] = offset;
+			offset += bucket_count;
+		}
+
+		for (size_t i = 0; i < num_keys; i++)
+		{
+			const uint32_t destination = count[(keys[i] >> (digit * 8)) & 0xff]++;
+
+			temp_keys[destination]		= keys[i];
+			temp_values[destination]	= values[i];
+		}
+
+		keys.swap(temp_keys);
+		values.swap(temp_values);
+	}
+}
+
+void RenderQueue::Clear()
+{
+	keys_.clear();
+	values_.clear();
+}
+
+void RenderQueue::Reserve(size_t num_draws)
+{
+	keys_.reserve(num_draws);
+	values_.reserve(num_draws);
+	temp_keys_.reserve(num_draws);
+	temp_values_.reserve(num_draws);
+}
+
+void RenderQueue::Add(uint64_t key, uint32_t value)
+{
+	keys_.push_back(key);
+	values_.push_back(value);
+}
+
+void RenderQueue::Sort()
+{
+	RadixSort(keys_, values_, temp_keys_, temp_values_);
+}
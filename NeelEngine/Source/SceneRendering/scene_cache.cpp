@@ -0,0 +1,873 @@
+#include "neel_engine_pch.h"
+
+#include "scene_cache.h"
+
+#include <fstream>
+
+static const uint32_t scene_cache_magic		= 0x4E43534E; // "NSCN"
+static const uint32_t scene_cache_version	= 11;
+
+// Sections are aligned so primitive data can be used in place.
+static const size_t scene_cache_alignment	= 16;
+
+struct CacheStringRecord
+{
+	uint32_t Offset;
+	uint32_t Length;
+};
+
+struct CacheHeader
+{
+	uint32_t			Magic;
+	uint32_t			Version;
+	uint64_t			SourceHash;
+	uint64_t			FileSize;
+
+	CacheStringRecord	Name;
+	uint32_t			NumTextures;
+
+	uint32_t			NumMaterials;
+	uint32_t			NumTextureRequests;
+	uint32_t			NumMeshes;
+	uint32_t			NumSubMeshes;
+	uint32_t			NumNodes;
+	uint32_t			NumInstances;
+	uint32_t			NumAnimations;
+	uint32_t			NumSkins;
+	uint32_t			NumDependencies;
+	// Vertex format the primitive data was cooked with, see VertexQuantization.
+	uint32_t			QuantizedVertices;
+
+	uint64_t			MaterialsOffset;
+	uint64_t			TexturesOffset;
+	uint64_t			MeshesOffset;
+	uint64_t			SubMeshesOffset;
+	uint64_t			NodesOffset;
+	uint64_t			InstancesOffset;
+	uint64_t			AnimationsOffset;
+	uint64_t			SkinsOffset;
+	uint64_t			DependenciesOffset;
+	uint64_t			StringsOffset;
+	uint64_t			StringsSize;
+	uint64_t			DataOffset;
+	uint64_t			DataSize;
+};
+
+struct CacheTextureRecord
+{
+	int32_t				TextureIndex;
+	uint32_t			Usage;
+	CacheStringRecord	Filename;
+
+	// Relative to the data section, for images stored inside the glTF file. DataSize is 0 for image files.
+	uint64_t			DataOffset;
+	uint64_t			DataSize;
+};
+
+struct CacheMeshRecord
+{
+	CacheStringRecord	Name;
+	uint32_t			FirstSubMesh;
+	uint32_t			NumSubMeshes;
+	DirectX::XMFLOAT4X4	BaseTransform;
+};
+
+struct CacheSubMeshRecord
+{
+	// Relative to the data section. Vertex streams in slot order, followed by the indices.
+	uint64_t			DataOffset;
+	uint32_t			NumElements[4];
+	uint32_t			ElementSize[4];
+	uint32_t			IndexCount;
+	uint32_t			IndexFormat;
+	uint32_t			Topology;
+	int32_t				MaterialIndex;
+	uint32_t			HasTangents;
+	uint32_t			Quantized;
+	float				PositionScale[3];
+	float				PositionOffset[3];
+	float				BoundsCenter[3];
+	float				BoundsExtents[3];
+	float				BoundsRadius;
+
+	// Relative to the data section. Meshlets, bounds, vertices and triangles of MeshletData back to back, followed by the levels of detail
+	// and the joint influences.
+	uint64_t			MeshletDataOffset;
+	uint32_t			NumMeshlets;
+	uint32_t			NumMeshletVertices;
+	uint32_t			NumMeshletTriangleBytes;
+	uint32_t			NumLods;
+	uint32_t			NumSkinVertices;
+};
+
+// Nodes are stored in the depth first order of the TransformHierarchy.
+struct CacheNodeRecord
+{
+	int32_t				Parent;
+	float				Translation[3];
+	float				Rotation[4];
+	float				Scale[3];
+};
+
+struct CacheInstanceRecord
+{
+	uint32_t			NodeIndex;
+	int32_t				MeshIndex;
+	int32_t				SkinIndex;
+};
+
+struct CacheAnimationRecord
+{
+	CacheStringRecord	Name;
+
+	// Relative to the data section. Values, tracks, channels and key times back to back.
+	uint64_t			DataOffset;
+	uint32_t			NumValues;
+	uint32_t			NumTracks;
+	uint32_t			NumChannels;
+	uint32_t			NumTimes;
+	float				Duration;
+};
+
+struct CacheSkinRecord
+{
+	// Relative to the data section. Inverse bind matrices followed by the joint nodes.
+	uint64_t			DataOffset;
+	uint32_t			NumJoints;
+};
+
+static_assert(std::is_trivially_copyable<MeshMaterialData>::value, "MeshMaterialData is written to the scene cache as is");
+static_assert(std::is_trivially_copyable<Meshlet>::value && std::is_trivially_copyable<MeshletBounds>::value, "Meshlets are written to the scene cache as is");
+static_assert(std::is_trivially_copyable<Mesh::LevelOfDetail>::value, "Levels of detail are written to the scene cache as is");
+static_assert(std::is_trivially_copyable<Mesh::SkinVertex>::value, "Joint influences are written to the scene cache as is");
+
+// 64-bit hash of a block of memory, processed a word at a time.
+static uint64_t HashMemory(const uint8_t* data, size_t size, uint64_t hash)
+{
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, data + i, sizeof(uint64_t));
+
+		hash ^= word * 0x9E3779B97F4A7C15ull;
+		hash = ((hash << 31) | (hash >> 33)) * 0xBF58476D1CE4E5B9ull;
+	}
+
+	for (; i < size; i++)
+	{
+		hash = (hash ^ data[i]) * 0x100000001B3ull;
+	}
+
+	hash ^= size;
+	hash *= 0x94D049BB133111EBull;
+	hash ^= hash >> 31;
+
+	return hash;
+}
+
+static size_t AlignOffset(size_t offset)
+{
+	return math::AlignUp(offset, scene_cache_alignment);
+}
+
+static size_t AnimationDataSize(const CacheAnimationRecord& record)
+{
+	return record.NumValues * sizeof(XMFLOAT4A) + record.NumTracks * sizeof(Animation::Track) +
+		record.NumChannels * sizeof(Animation::Channel) + record.NumTimes * sizeof(float);
+}
+
+static size_t SkinDataSize(const CacheSkinRecord& record)
+{
+	return record.NumJoints * (sizeof(XMFLOAT4X4) + sizeof(uint32_t));
+}
+
+static size_t MeshletDataSize(const MeshletData& meshlets)
+{
+	return meshlets.Meshlets.size() * sizeof(Meshlet) + meshlets.Bounds.size() * sizeof(MeshletBounds) +
+		meshlets.Vertices.size() * sizeof(uint32_t) + meshlets.Triangles.size();
+}
+
+// Topologies PackPrimitive creates from glTF primitive modes.
+static bool IsCookedTopology(uint32_t topology)
+{
+	switch (topology)
+	{
+	case D3D_PRIMITIVE_TOPOLOGY_POINTLIST:
+	case D3D_PRIMITIVE_TOPOLOGY_LINELIST:
+	case D3D_PRIMITIVE_TOPOLOGY_LINESTRIP:
+	case D3D_PRIMITIVE_TOPOLOGY_LINELIST_ADJ:
+	case D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST:
+	case D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Meshlets have to stay within the vertices and triangles of their submesh and reference its vertices.
+static bool ValidMeshlets(const MeshletData& meshlets, size_t num_vertices)
+{
+	for (const Meshlet& meshlet : meshlets.Meshlets)
+	{
+		if (static_cast<uint64_t>(meshlet.VertexOffset) + meshlet.VertexCount > meshlets.Vertices.size() ||
+			static_cast<uint64_t>(meshlet.TriangleOffset) + meshlet.TriangleCount * 3ull > meshlets.Triangles.size())
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < meshlet.TriangleCount * 3; i++)
+		{
+			if (meshlets.Triangles[meshlet.TriangleOffset + i] >= meshlet.VertexCount)
+				return false;
+		}
+	}
+
+	for (uint32_t vertex : meshlets.Vertices)
+	{
+		if (vertex >= num_vertices)
+			return false;
+	}
+
+	return true;
+}
+
+std::string SceneCache::GetCachePath(const std::string& filename)
+{
+	return std::filesystem::path(filename).replace_extension(".neelscene").string();
+}
+
+std::vector<std::string> SceneCache::GetDependencies(const MappedDocument& document)
+{
+	std::vector<std::string> dependencies;
+
+	for (const auto& buffer : document.GetDocument().buffers)
+	{
+		if (!buffer.uri.empty() && !buffer.IsEmbeddedResource())
+		{
+			dependencies.push_back(buffer.uri);
+		}
+	}
+
+	return dependencies;
+}
+
+uint64_t SceneCache::HashSource(const std::string& filename, const std::vector<std::string>& dependencies)
+{
+	const std::string root_path = fx::gltf::detail::GetDocumentRootPath(filename);
+
+	MemoryMappedFile source(filename);
+	uint64_t hash = HashMemory(source.Data(), source.Size(), 0xCBF29CE484222325ull);
+
+	for (const auto& dependency : dependencies)
+	{
+		MemoryMappedFile file(fx::gltf::detail::CreateBufferUriPath(root_path, dependency));
+		hash = HashMemory(file.Data(), file.Size(), hash);
+	}
+
+	return hash;
+}
+
+bool SceneCache::Load(const std::string& filename, bool quantize_vertices, SceneData& scene_data)
+{
+	const std::string cache_path = GetCachePath(filename);
+
+	if (!std::filesystem::exists(cache_path))
+		return false;
+
+	MemoryMappedFile file(cache_path);
+
+	const uint8_t* data = file.Data();
+	const size_t size = file.Size();
+
+	if (size < sizeof(CacheHeader))
+		return false;
+
+	const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(data);
+
+	if (header.Magic != scene_cache_magic || header.Version != scene_cache_version || header.FileSize != size)
+		return false;
+
+	if ((header.QuantizedVertices != 0) != quantize_vertices)
+		return false;
+
+	auto section_fits = [size](uint64_t offset, uint64_t section_size)
+	{
+		return offset <= size && section_size <= size - offset;
+	};
+
+	if (!section_fits(header.MaterialsOffset,		header.NumMaterials * sizeof(MeshMaterialData)) ||
+		!section_fits(header.TexturesOffset,		header.NumTextureRequests * sizeof(CacheTextureRecord)) ||
+		!section_fits(header.MeshesOffset,			header.NumMeshes * sizeof(CacheMeshRecord)) ||
+		!section_fits(header.SubMeshesOffset,		header.NumSubMeshes * sizeof(CacheSubMeshRecord)) ||
+		!section_fits(header.NodesOffset,			header.NumNodes * sizeof(CacheNodeRecord)) ||
+		!section_fits(header.InstancesOffset,		header.NumInstances * sizeof(CacheInstanceRecord)) ||
+		!section_fits(header.AnimationsOffset,		header.NumAnimations * sizeof(CacheAnimationRecord)) ||
+		!section_fits(header.SkinsOffset,			header.NumSkins * sizeof(CacheSkinRecord)) ||
+		!section_fits(header.DependenciesOffset,	header.NumDependencies * sizeof(CacheStringRecord)) ||
+		!section_fits(header.StringsOffset,			header.StringsSize) ||
+		!section_fits(header.DataOffset,			header.DataSize))
+	{
+		return false;
+	}
+
+	const char* strings = reinterpret_cast<const char*>(data + header.StringsOffset);
+	auto get_string = [&header, strings](const CacheStringRecord& record)
+	{
+		if (static_cast<uint64_t>(record.Offset) + record.Length > header.StringsSize)
+		{
+			throw std::runtime_error("Corrupt scene cache string table");
+		}
+
+		return std::string(strings + record.Offset, record.Length);
+	};
+
+	// Only use the cook when it was made from the current source files.
+	const CacheStringRecord* dependency_records = reinterpret_cast<const CacheStringRecord*>(data + header.DependenciesOffset);
+
+	std::vector<std::string> dependencies;
+	for (uint32_t i = 0; i < header.NumDependencies; i++)
+	{
+		dependencies.push_back(get_string(dependency_records[i]));
+	}
+
+	if (HashSource(filename, dependencies) != header.SourceHash)
+		return false;
+
+	// Only hand out the data once the whole cook has been validated.
+	SceneData cooked_data;
+
+	cooked_data.Name				= get_string(header.Name);
+	cooked_data.NumTextures			= header.NumTextures;
+	cooked_data.QuantizedVertices	= header.QuantizedVertices != 0;
+
+	const MeshMaterialData* materials = reinterpret_cast<const MeshMaterialData*>(data + header.MaterialsOffset);
+	cooked_data.Materials.assign(materials, materials + header.NumMaterials);
+
+	const CacheTextureRecord* textures = reinterpret_cast<const CacheTextureRecord*>(data + header.TexturesOffset);
+	cooked_data.TextureRequests.resize(header.NumTextureRequests);
+	for (uint32_t i = 0; i < header.NumTextureRequests; i++)
+	{
+		// Textures are created into a list of NumTextures by TextureIndex.
+		if (textures[i].TextureIndex < 0 || textures[i].TextureIndex >= static_cast<int32_t>(header.NumTextures) ||
+			textures[i].Usage > static_cast<uint32_t>(TextureUsage::AmbientOcclusionmap))
+		{
+			return false;
+		}
+
+		cooked_data.TextureRequests[i].TextureIndex	= textures[i].TextureIndex;
+		cooked_data.TextureRequests[i].Filename		= get_string(textures[i].Filename);
+		cooked_data.TextureRequests[i].Usage		= static_cast<TextureUsage>(textures[i].Usage);
+
+		if (textures[i].DataSize > 0)
+		{
+			if (!section_fits(header.DataOffset + textures[i].DataOffset, textures[i].DataSize))
+				return false;
+
+			cooked_data.TextureRequests[i].Data		= data + header.DataOffset + textures[i].DataOffset;
+			cooked_data.TextureRequests[i].DataSize	= static_cast<size_t>(textures[i].DataSize);
+		}
+	}
+
+	const CacheMeshRecord* meshes = reinterpret_cast<const CacheMeshRecord*>(data + header.MeshesOffset);
+	const CacheSubMeshRecord* sub_meshes = reinterpret_cast<const CacheSubMeshRecord*>(data + header.SubMeshesOffset);
+	const uint8_t* primitive_data = data + header.DataOffset;
+
+	cooked_data.MeshNames.resize(header.NumMeshes);
+	cooked_data.BaseTransforms.resize(header.NumMeshes);
+	cooked_data.Primitives.resize(header.NumMeshes);
+
+	for (uint32_t i = 0; i < header.NumMeshes; i++)
+	{
+		const CacheMeshRecord& mesh = meshes[i];
+
+		if (static_cast<uint64_t>(mesh.FirstSubMesh) + mesh.NumSubMeshes > header.NumSubMeshes)
+			return false;
+
+		cooked_data.MeshNames[i]		= get_string(mesh.Name);
+		cooked_data.BaseTransforms[i]	= mesh.BaseTransform;
+		cooked_data.Primitives[i].resize(mesh.NumSubMeshes);
+
+		for (uint32_t j = 0; j < mesh.NumSubMeshes; j++)
+		{
+			const CacheSubMeshRecord& record = sub_meshes[mesh.FirstSubMesh + j];
+			Mesh::PrimitiveData& primitive = cooked_data.Primitives[i][j];
+
+			// A negative material index means the submesh has no material.
+			if (record.MaterialIndex >= static_cast<int32_t>(header.NumMaterials))
+				return false;
+
+			if ((record.IndexFormat != DXGI_FORMAT_R16_UINT && record.IndexFormat != DXGI_FORMAT_R32_UINT) || !IsCookedTopology(record.Topology))
+				return false;
+
+			primitive.IndexCount	= record.IndexCount;
+			primitive.IndexFormat	= static_cast<DXGI_FORMAT>(record.IndexFormat);
+			primitive.Topology		= static_cast<D3D_PRIMITIVE_TOPOLOGY>(record.Topology);
+			primitive.MaterialIndex = record.MaterialIndex;
+			primitive.HasTangents	= record.HasTangents != 0;
+			primitive.Quantized		= record.Quantized != 0;
+			primitive.PositionScale	= XMFLOAT3(record.PositionScale);
+			primitive.PositionOffset	= XMFLOAT3(record.PositionOffset);
+			primitive.Bounds			= { XMFLOAT3(record.BoundsCenter), XMFLOAT3(record.BoundsExtents), record.BoundsRadius };
+
+			for (size_t slot = 0; slot < 4; slot++)
+			{
+				primitive.NumElements[slot] = record.NumElements[slot];
+				primitive.ElementSize[slot] = record.ElementSize[slot];
+			}
+
+			if (!section_fits(header.DataOffset + record.DataOffset, primitive.VertexDataSize() + primitive.IndexDataSize()))
+				return false;
+
+			const uint8_t* stream = primitive_data + record.DataOffset;
+			for (size_t slot = 0; slot < 4; slot++)
+			{
+				if (primitive.StreamSize(slot) > 0)
+				{
+					primitive.Streams[slot] = stream;
+					stream += primitive.StreamSize(slot);
+				}
+			}
+
+			primitive.Indices = stream;
+
+			if (record.NumMeshlets > 0)
+			{
+				const size_t meshlets_size = record.NumMeshlets * (sizeof(Meshlet) + sizeof(MeshletBounds)) +
+					record.NumMeshletVertices * sizeof(uint32_t) + record.NumMeshletTriangleBytes;
+
+				if (!section_fits(header.DataOffset + record.MeshletDataOffset, meshlets_size))
+					return false;
+
+				const uint8_t* meshlet_data = primitive_data + record.MeshletDataOffset;
+
+				const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(meshlet_data);
+				const MeshletBounds* bounds = reinterpret_cast<const MeshletBounds*>(meshlets + record.NumMeshlets);
+				const uint32_t* vertices = reinterpret_cast<const uint32_t*>(bounds + record.NumMeshlets);
+				const uint8_t* triangles = reinterpret_cast<const uint8_t*>(vertices + record.NumMeshletVertices);
+
+				primitive.Meshlets.Meshlets.assign(meshlets, meshlets + record.NumMeshlets);
+				primitive.Meshlets.Bounds.assign(bounds, bounds + record.NumMeshlets);
+				primitive.Meshlets.Vertices.assign(vertices, vertices + record.NumMeshletVertices);
+				primitive.Meshlets.Triangles.assign(triangles, triangles + record.NumMeshletTriangleBytes);
+
+				if (!ValidMeshlets(primitive.Meshlets, primitive.NumElements[Mesh::vertex_slot_]))
+					return false;
+			}
+
+			if (record.NumLods > 0)
+			{
+				const size_t meshlets_size = record.NumMeshlets * (sizeof(Meshlet) + sizeof(MeshletBounds)) +
+					record.NumMeshletVertices * sizeof(uint32_t) + record.NumMeshletTriangleBytes;
+
+				if (!section_fits(header.DataOffset + record.MeshletDataOffset + meshlets_size, record.NumLods * sizeof(Mesh::LevelOfDetail)))
+					return false;
+
+				// Meshlet triangles are bytes, the levels that follow them are not aligned.
+				primitive.Lods.resize(record.NumLods);
+				std::memcpy(primitive.Lods.data(), primitive_data + record.MeshletDataOffset + meshlets_size, record.NumLods * sizeof(Mesh::LevelOfDetail));
+
+				for (const Mesh::LevelOfDetail& lod : primitive.Lods)
+				{
+					if (static_cast<uint64_t>(lod.FirstIndex) + lod.IndexCount > record.IndexCount)
+						return false;
+				}
+			}
+
+			if (record.NumSkinVertices > 0)
+			{
+				const size_t skin_offset = record.NumMeshlets * (sizeof(Meshlet) + sizeof(MeshletBounds)) +
+					record.NumMeshletVertices * sizeof(uint32_t) + record.NumMeshletTriangleBytes + record.NumLods * sizeof(Mesh::LevelOfDetail);
+
+				if (record.NumSkinVertices != record.NumElements[Mesh::vertex_slot_] ||
+					!section_fits(header.DataOffset + record.MeshletDataOffset + skin_offset, record.NumSkinVertices * sizeof(Mesh::SkinVertex)))
+				{
+					return false;
+				}
+
+				primitive.Skin.resize(record.NumSkinVertices);
+				std::memcpy(primitive.Skin.data(), primitive_data + record.MeshletDataOffset + skin_offset, record.NumSkinVertices * sizeof(Mesh::SkinVertex));
+			}
+		}
+	}
+
+	const CacheNodeRecord* nodes = reinterpret_cast<const CacheNodeRecord*>(data + header.NodesOffset);
+	cooked_data.Transforms.Reserve(header.NumNodes);
+	for (uint32_t i = 0; i < header.NumNodes; i++)
+	{
+		if (nodes[i].Parent >= static_cast<int32_t>(i))
+			return false;
+
+		cooked_data.Transforms.AddNode(nodes[i].Parent, XMFLOAT3(nodes[i].Translation), XMFLOAT4(nodes[i].Rotation), XMFLOAT3(nodes[i].Scale));
+	}
+
+	cooked_data.Transforms.Update();
+
+	const CacheInstanceRecord* instances = reinterpret_cast<const CacheInstanceRecord*>(data + header.InstancesOffset);
+	cooked_data.Instances.resize(header.NumInstances);
+	for (uint32_t i = 0; i < header.NumInstances; i++)
+	{
+		if (instances[i].NodeIndex >= header.NumNodes || instances[i].SkinIndex >= static_cast<int32_t>(header.NumSkins))
+			return false;
+
+		if (instances[i].MeshIndex < 0 || instances[i].MeshIndex >= static_cast<int32_t>(header.NumMeshes))
+			return false;
+
+		cooked_data.Instances[i].NodeIndex = instances[i].NodeIndex;
+		cooked_data.Instances[i].MeshIndex = instances[i].MeshIndex;
+		cooked_data.Instances[i].SkinIndex = instances[i].SkinIndex;
+	}
+
+	const CacheAnimationRecord* animations = reinterpret_cast<const CacheAnimationRecord*>(data + header.AnimationsOffset);
+	cooked_data.Animations.resize(header.NumAnimations);
+	for (uint32_t i = 0; i < header.NumAnimations; i++)
+	{
+		const CacheAnimationRecord& record = animations[i];
+
+		if (!section_fits(header.DataOffset + record.DataOffset, AnimationDataSize(record)))
+			return false;
+
+		const XMFLOAT4A* values = reinterpret_cast<const XMFLOAT4A*>(primitive_data + record.DataOffset);
+		const Animation::Track* tracks = reinterpret_cast<const Animation::Track*>(values + record.NumValues);
+		const Animation::Channel* channels = reinterpret_cast<const Animation::Channel*>(tracks + record.NumTracks);
+		const float* times = reinterpret_cast<const float*>(channels + record.NumChannels);
+
+		for (uint32_t j = 0; j < record.NumTracks; j++)
+		{
+			if (tracks[j].NumTimes == 0 || static_cast<uint64_t>(tracks[j].FirstTime) + tracks[j].NumTimes > record.NumTimes)
+				return false;
+		}
+
+		for (uint32_t j = 0; j < record.NumChannels; j++)
+		{
+			const Animation::Channel& channel = channels[j];
+			if (channel.Track >= record.NumTracks || channel.Node >= header.NumNodes)
+				return false;
+
+			const uint64_t num_values = tracks[channel.Track].NumTimes * (channel.Mode == Animation::Interpolation::CubicSpline ? 3ull : 1ull);
+			if (channel.FirstValue + num_values > record.NumValues)
+				return false;
+		}
+
+		Animation& animation = cooked_data.Animations[i];
+		animation.name_		= get_string(record.Name);
+		animation.duration_	= record.Duration;
+		animation.values_.assign(values, values + record.NumValues);
+		animation.tracks_.assign(tracks, tracks + record.NumTracks);
+		animation.channels_.assign(channels, channels + record.NumChannels);
+		animation.times_.assign(times, times + record.NumTimes);
+		animation.track_keys_.assign(record.NumTracks, { 0, 0, 0.0f, 0.0f });
+		animation.sampled_.resize(record.NumChannels);
+	}
+
+	const CacheSkinRecord* skins = reinterpret_cast<const CacheSkinRecord*>(data + header.SkinsOffset);
+	cooked_data.Skins.resize(header.NumSkins);
+	for (uint32_t i = 0; i < header.NumSkins; i++)
+	{
+		const CacheSkinRecord& record = skins[i];
+
+		if (!section_fits(header.DataOffset + record.DataOffset, SkinDataSize(record)))
+			return false;
+
+		const XMFLOAT4X4* inverse_bind_matrices = reinterpret_cast<const XMFLOAT4X4*>(primitive_data + record.DataOffset);
+		const uint32_t* joints = reinterpret_cast<const uint32_t*>(inverse_bind_matrices + record.NumJoints);
+
+		for (uint32_t j = 0; j < record.NumJoints; j++)
+		{
+			if (joints[j] >= header.NumNodes)
+				return false;
+		}
+
+		cooked_data.Skins[i].InverseBindMatrices.assign(inverse_bind_matrices, inverse_bind_matrices + record.NumJoints);
+		cooked_data.Skins[i].Joints.assign(joints, joints + record.NumJoints);
+	}
+
+	cooked_data.CookedFile = std::move(file);
+	scene_data = std::move(cooked_data);
+
+	return true;
+}
+
+void SceneCache::Save(const std::string& filename, const SceneData& scene_data)
+{
+	if (!scene_data.Document)
+	{
+		throw std::exception("Scene cache can only be written for an imported glTF document.");
+	}
+
+	const std::vector<std::string> dependencies = GetDependencies(*scene_data.Document);
+
+	CacheHeader header = {};
+	header.Magic		= scene_cache_magic;
+	header.Version		= scene_cache_version;
+	header.SourceHash	= HashSource(filename, dependencies);
+
+	std::string strings;
+	auto add_string = [&strings](const std::string& string)
+	{
+		CacheStringRecord record{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(string.size()) };
+		strings += string;
+		return record;
+	};
+
+	header.Name					= add_string(scene_data.Name);
+	header.NumTextures			= scene_data.NumTextures;
+	header.QuantizedVertices	= scene_data.QuantizedVertices ? 1 : 0;
+
+	std::vector<CacheMeshRecord> meshes;
+	std::vector<CacheSubMeshRecord> sub_meshes;
+	uint64_t data_size = 0;
+
+	for (size_t i = 0; i < scene_data.Primitives.size(); i++)
+	{
+		CacheMeshRecord mesh = {};
+		mesh.Name			= add_string(scene_data.MeshNames[i]);
+		mesh.FirstSubMesh	= static_cast<uint32_t>(sub_meshes.size());
+		mesh.NumSubMeshes	= static_cast<uint32_t>(scene_data.Primitives[i].size());
+		mesh.BaseTransform	= scene_data.BaseTransforms[i];
+		meshes.push_back(mesh);
+
+		for (const auto& primitive : scene_data.Primitives[i])
+		{
+			CacheSubMeshRecord record = {};
+			record.DataOffset		= data_size;
+			record.IndexCount		= primitive.IndexCount;
+			record.IndexFormat		= primitive.IndexFormat;
+			record.Topology			= primitive.Topology;
+			record.MaterialIndex	= primitive.MaterialIndex;
+			record.HasTangents		= primitive.HasTangents ? 1 : 0;
+			record.Quantized		= primitive.Quantized ? 1 : 0;
+
+			std::memcpy(record.PositionScale, &primitive.PositionScale, sizeof(record.PositionScale));
+			std::memcpy(record.PositionOffset, &primitive.PositionOffset, sizeof(record.PositionOffset));
+			std::memcpy(record.BoundsCenter, &primitive.Bounds.Center, sizeof(record.BoundsCenter));
+			std::memcpy(record.BoundsExtents, &primitive.Bounds.Extents, sizeof(record.BoundsExtents));
+			record.BoundsRadius = primitive.Bounds.Radius;
+
+			for (size_t slot = 0; slot < 4; slot++)
+			{
+				record.NumElements[slot] = static_cast<uint32_t>(primitive.NumElements[slot]);
+				record.ElementSize[slot] = static_cast<uint32_t>(primitive.ElementSize[slot]);
+			}
+
+			data_size = AlignOffset(data_size + primitive.VertexDataSize() + primitive.IndexDataSize());
+
+			record.MeshletDataOffset		= data_size;
+			record.NumMeshlets				= static_cast<uint32_t>(primitive.Meshlets.Meshlets.size());
+			record.NumMeshletVertices		= static_cast<uint32_t>(primitive.Meshlets.Vertices.size());
+			record.NumMeshletTriangleBytes	= static_cast<uint32_t>(primitive.Meshlets.Triangles.size());
+			record.NumLods					= static_cast<uint32_t>(primitive.Lods.size());
+			record.NumSkinVertices			= static_cast<uint32_t>(primitive.Skin.size());
+
+			sub_meshes.push_back(record);
+
+			data_size = AlignOffset(data_size + MeshletDataSize(primitive.Meshlets) + primitive.Lods.size() * sizeof(Mesh::LevelOfDetail) +
+				primitive.Skin.size() * sizeof(Mesh::SkinVertex));
+		}
+	}
+
+	// Animations follow the primitive data, the values come first so they stay aligned.
+	std::vector<CacheAnimationRecord> animations;
+	for (const auto& animation : scene_data.Animations)
+	{
+		CacheAnimationRecord record = {};
+		record.Name			= add_string(animation.name_);
+		record.DataOffset	= data_size;
+		record.NumValues	= static_cast<uint32_t>(animation.values_.size());
+		record.NumTracks	= static_cast<uint32_t>(animation.tracks_.size());
+		record.NumChannels	= static_cast<uint32_t>(animation.channels_.size());
+		record.NumTimes		= static_cast<uint32_t>(animation.times_.size());
+		record.Duration		= animation.duration_;
+		animations.push_back(record);
+
+		data_size = AlignOffset(data_size + AnimationDataSize(record));
+	}
+
+	std::vector<CacheSkinRecord> skins;
+	for (const auto& skin : scene_data.Skins)
+	{
+		CacheSkinRecord record = {};
+		record.DataOffset	= data_size;
+		record.NumJoints	= static_cast<uint32_t>(skin.Joints.size());
+		skins.push_back(record);
+
+		data_size = AlignOffset(data_size + SkinDataSize(record));
+	}
+
+	// Images stored inside the glTF file follow the animations and skins, each image is stored once.
+	std::vector<CacheTextureRecord> textures;
+	std::vector<std::pair<const uint8_t*, size_t>> images;
+	std::unordered_map<const uint8_t*, uint64_t> image_offsets;
+
+	for (const auto& request : scene_data.TextureRequests)
+	{
+		CacheTextureRecord record = {};
+		record.TextureIndex	= request.TextureIndex;
+		record.Usage		= static_cast<uint32_t>(request.Usage);
+		record.Filename		= add_string(request.Filename);
+
+		if (request.Data)
+		{
+			auto iter = image_offsets.find(request.Data);
+			if (iter == image_offsets.end())
+			{
+				iter = image_offsets.emplace(request.Data, data_size).first;
+				images.emplace_back(request.Data, request.DataSize);
+
+				data_size = AlignOffset(data_size + request.DataSize);
+			}
+
+			record.DataOffset	= iter->second;
+			record.DataSize		= request.DataSize;
+		}
+
+		textures.push_back(record);
+	}
+
+	const TransformHierarchy& transforms = scene_data.Transforms;
+
+	std::vector<CacheNodeRecord> nodes(transforms.GetNumNodes());
+	for (uint32_t i = 0; i < transforms.GetNumNodes(); i++)
+	{
+		nodes[i].Parent = transforms.GetParent(i);
+
+		const XMFLOAT3 translation	= transforms.GetTranslation(i);
+		const XMFLOAT4 rotation		= transforms.GetRotation(i);
+		const XMFLOAT3 scale		= transforms.GetScale(i);
+
+		std::memcpy(nodes[i].Translation, &translation, sizeof(nodes[i].Translation));
+		std::memcpy(nodes[i].Rotation, &rotation, sizeof(nodes[i].Rotation));
+		std::memcpy(nodes[i].Scale, &scale, sizeof(nodes[i].Scale));
+	}
+
+	std::vector<CacheInstanceRecord> instances;
+	for (const auto& instance : scene_data.Instances)
+	{
+		CacheInstanceRecord record = {};
+		record.NodeIndex = instance.NodeIndex;
+		record.MeshIndex = instance.MeshIndex;
+		record.SkinIndex = instance.SkinIndex;
+		instances.push_back(record);
+	}
+
+	std::vector<CacheStringRecord> dependency_records;
+	for (const auto& dependency : dependencies)
+	{
+		dependency_records.push_back(add_string(dependency));
+	}
+
+	header.NumMaterials			= static_cast<uint32_t>(scene_data.Materials.size());
+	header.NumTextureRequests	= static_cast<uint32_t>(textures.size());
+	header.NumMeshes			= static_cast<uint32_t>(meshes.size());
+	header.NumSubMeshes			= static_cast<uint32_t>(sub_meshes.size());
+	header.NumNodes				= static_cast<uint32_t>(nodes.size());
+	header.NumInstances			= static_cast<uint32_t>(instances.size());
+	header.NumAnimations		= static_cast<uint32_t>(animations.size());
+	header.NumSkins				= static_cast<uint32_t>(skins.size());
+	header.NumDependencies		= static_cast<uint32_t>(dependency_records.size());
+
+	uint64_t offset = AlignOffset(sizeof(CacheHeader));
+	header.MaterialsOffset		= offset; offset = AlignOffset(offset + header.NumMaterials * sizeof(MeshMaterialData));
+	header.TexturesOffset		= offset; offset = AlignOffset(offset + textures.size() * sizeof(CacheTextureRecord));
+	header.MeshesOffset			= offset; offset = AlignOffset(offset + meshes.size() * sizeof(CacheMeshRecord));
+	header.SubMeshesOffset		= offset; offset = AlignOffset(offset + sub_meshes.size() * sizeof(CacheSubMeshRecord));
+	header.NodesOffset			= offset; offset = AlignOffset(offset + nodes.size() * sizeof(CacheNodeRecord));
+	header.InstancesOffset		= offset; offset = AlignOffset(offset + instances.size() * sizeof(CacheInstanceRecord));
+	header.AnimationsOffset		= offset; offset = AlignOffset(offset + animations.size() * sizeof(CacheAnimationRecord));
+	header.SkinsOffset			= offset; offset = AlignOffset(offset + skins.size() * sizeof(CacheSkinRecord));
+	header.DependenciesOffset	= offset; offset = AlignOffset(offset + dependency_records.size() * sizeof(CacheStringRecord));
+	header.StringsOffset		= offset; offset = AlignOffset(offset + strings.size());
+	header.StringsSize			= strings.size();
+	header.DataOffset			= offset;
+	header.DataSize				= data_size;
+	header.FileSize				= header.DataOffset + header.DataSize;
+
+	std::ofstream output(GetCachePath(filename), std::ios::binary | std::ios::trunc);
+	if (!output.good())
+	{
+		throw std::runtime_error("Failed to create scene cache for " + filename);
+	}
+
+	auto write_section = [&output](uint64_t section_offset, const void* section_data, size_t section_size)
+	{
+		static const char zeros[scene_cache_alignment] = {};
+
+		const uint64_t position = static_cast<uint64_t>(output.tellp());
+		output.write(zeros, static_cast<std::streamsize>(section_offset - position));
+		output.write(static_cast<const char*>(section_data), static_cast<std::streamsize>(section_size));
+	};
+
+	output.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+	write_section(header.MaterialsOffset,		scene_data.Materials.data(),	scene_data.Materials.size() * sizeof(MeshMaterialData));
+	write_section(header.TexturesOffset,		textures.data(),				textures.size() * sizeof(CacheTextureRecord));
+	write_section(header.MeshesOffset,			meshes.data(),					meshes.size() * sizeof(CacheMeshRecord));
+	write_section(header.SubMeshesOffset,		sub_meshes.data(),				sub_meshes.size() * sizeof(CacheSubMeshRecord));
+	write_section(header.NodesOffset,			nodes.data(),					nodes.size() * sizeof(CacheNodeRecord));
+	write_section(header.InstancesOffset,		instances.data(),				instances.size() * sizeof(CacheInstanceRecord));
+	write_section(header.AnimationsOffset,		animations.data(),				animations.size() * sizeof(CacheAnimationRecord));
+	write_section(header.SkinsOffset,			skins.data(),					skins.size() * sizeof(CacheSkinRecord));
+	write_section(header.DependenciesOffset,	dependency_records.data(),		dependency_records.size() * sizeof(CacheStringRecord));
+	write_section(header.StringsOffset,			strings.data(),					strings.size());
+
+	// Primitive data in upload layout.
+	size_t sub_mesh_index = 0;
+	for (const auto& mesh : scene_data.Primitives)
+	{
+		for (const auto& primitive : mesh)
+		{
+			const CacheSubMeshRecord& record = sub_meshes[sub_mesh_index++];
+			const uint64_t primitive_offset = header.DataOffset + record.DataOffset;
+
+			write_section(primitive_offset, nullptr, 0);
+
+			for (size_t slot = 0; slot < 4; slot++)
+			{
+				if (primitive.Streams[slot])
+				{
+					output.write(reinterpret_cast<const char*>(primitive.Streams[slot]), primitive.StreamSize(slot));
+				}
+			}
+
+			output.write(reinterpret_cast<const char*>(primitive.Indices), primitive.IndexDataSize());
+
+			const MeshletData& meshlets = primitive.Meshlets;
+
+			write_section(header.DataOffset + record.MeshletDataOffset, meshlets.Meshlets.data(), meshlets.Meshlets.size() * sizeof(Meshlet));
+			output.write(reinterpret_cast<const char*>(meshlets.Bounds.data()), meshlets.Bounds.size() * sizeof(MeshletBounds));
+			output.write(reinterpret_cast<const char*>(meshlets.Vertices.data()), meshlets.Vertices.size() * sizeof(uint32_t));
+			output.write(reinterpret_cast<const char*>(meshlets.Triangles.data()), meshlets.Triangles.size());
+			output.write(reinterpret_cast<const char*>(primitive.Lods.data()), primitive.Lods.size() * sizeof(Mesh::LevelOfDetail));
+			output.write(reinterpret_cast<const char*>(primitive.Skin.data()), primitive.Skin.size() * sizeof(Mesh::SkinVertex));
+		}
+	}
+
+	for (size_t i = 0; i < animations.size(); i++)
+	{
+		const Animation& animation = scene_data.Animations[i];
+
+		write_section(header.DataOffset + animations[i].DataOffset, animation.values_.data(), animation.values_.size() * sizeof(XMFLOAT4A));
+		output.write(reinterpret_cast<const char*>(animation.tracks_.data()), animation.tracks_.size() * sizeof(Animation::Track));
+		output.write(reinterpret_cast<const char*>(animation.channels_.data()), animation.channels_.size() * sizeof(Animation::Channel));
+		output.write(reinterpret_cast<const char*>(animation.times_.data()), animation.times_.size() * sizeof(float));
+	}
+
+	for (size_t i = 0; i < skins.size(); i++)
+	{
+		const Skinning::Skin& skin = scene_data.Skins[i];
+
+		write_section(header.DataOffset + skins[i].DataOffset, skin.InverseBindMatrices.data(), skin.InverseBindMatrices.size() * sizeof(XMFLOAT4X4));
+		output.write(reinterpret_cast<const char*>(skin.Joints.data()), skin.Joints.size() * sizeof(uint32_t));
+	}
+
+	for (const auto& image : images)
+	{
+		write_section(header.DataOffset + image_offsets[image.first], image.first, image.second);
+	}
+
+	write_section(header.FileSize, nullptr, 0);
+
+	if (!output.good())
+	{
+		throw std::runtime_error("Failed to write scene cache for " + filename);
+	}
+}
@@ -0,0 +1,442 @@
+#include "neel_engine_pch.h"
+
+#include "skinning.h"
+#include "transform_hierarchy.h"
+#include "vertex_quantization.h"
+#include "gltf_mesh_data.h"
+#include "commandlist.h"
+#include "thread_pool.h"
+
+// Octahedral encoding of a unit vector in xy, the same mapping as VertexQuantization::EncodeOctahedral.
+static XMVECTOR XM_CALLCONV EncodeOctahedral(FXMVECTOR normal)
+{
+	const XMVECTOR abs		= XMVectorAbs(normal);
+	const XMVECTOR length	= XMVectorSplatX(abs) + XMVectorSplatY(abs) + XMVectorSplatZ(abs);
+	const XMVECTOR xy		= normal / XMVectorMax(length, XMVectorReplicate(FLT_MIN));
+
+	// Fold the lower hemisphere over the diagonals.
+	const XMVECTOR sign		= XMVectorSelect(XMVectorReplicate(-1.0f), XMVectorReplicate(1.0f), XMVectorGreaterOrEqual(xy, XMVectorZero()));
+	const XMVECTOR folded	= (XMVectorReplicate(1.0f) - XMVectorAbs(XMVectorSwizzle<1, 0, 2, 3>(xy))) * sign;
+
+	return XMVectorSelect(xy, folded, XMVectorLess(XMVectorSplatZ(normal), XMVectorZero()));
+}
+
+Skinning::Skin Skinning::LoadSkin(const fx::gltf::Document& doc, size_t skin_index, const std::vector<uint32_t>& node_map,
+	const std::vector<const uint8_t*>* buffer_data)
+{
+	const fx::gltf::Skin& gltf_skin = doc.skins[skin_index];
+
+	Skin skin;
+	skin.Joints.reserve(gltf_skin.joints.size());
+
+	for (const uint32_t joint : gltf_skin.joints)
+	{
+		if (joint >= node_map.size() || node_map[joint] == UINT32_MAX)
+		{
+			throw std::runtime_error("glTF skin joint is not part of the scene");
+		}
+
+		skin.Joints.push_back(node_map[joint]);
+	}
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	skin.InverseBindMatrices.assign(skin.Joints.size(), identity);
+
+	if (gltf_skin.inverseBindMatrices >= 0)
+	{
+		const fx::gltf::Accessor& accessor = doc.accessors[gltf_skin.inverseBindMatrices];
+
+		if (accessor.type != fx::gltf::Accessor::Type::Mat4 || accessor.componentType != fx::gltf::Accessor::ComponentType::Float ||
+			accessor.count < skin.Joints.size())
+		{
+			throw std::runtime_error("glTF skin needs a float matrix per joint");
+		}
+
+		// Column major matrices for column vectors are the row major matrices for row vectors.
+		const MeshData::BufferInfo buffer = MeshData::GetData(doc, accessor, buffer_data);
+		for (size_t i = 0; i < skin.Joints.size(); i++)
+		{
+			std::memcpy(&skin.InverseBindMatrices[i], buffer.Data + i * buffer.DataStride, sizeof(XMFLOAT4X4));
+		}
+	}
+
+	return skin;
+}
+
+uint32_t Skinning::AddInstance(const std::vector<Mesh::PrimitiveData>& primitives, const Skin& skin, uint32_t node)
+{
+	if (skin.Joints.empty() || skin.Joints.size() > UINT16_MAX + 1 || skin.InverseBindMatrices.size() != skin.Joints.size())
+	{
+		throw std::invalid_argument("Skins need an inverse bind matrix for each of their 1 to 65536 joints.");
+	}
+
+	for (const auto& primitive : primitives)
+	{
+		if (primitive.Skin.size() != primitive.NumElements[Mesh::vertex_slot_] || !primitive.Streams[Mesh::vertex_slot_] ||
+			!primitive.Streams[Mesh::normal_slot_] || primitive.NumElements[Mesh::normal_slot_] != primitive.NumElements[Mesh::vertex_slot_])
+		{
+			throw std::invalid_argument("Skinned primitives need positions, normals and influences for every vertex.");
+		}
+
+		for (const auto& influence : primitive.Skin)
+		{
+			for (const uint16_t joint : influence.Joints)
+			{
+				if (joint >= skin.Joints.size())
+				{
+					throw std::invalid_argument("Skinned primitive references a joint that is not in the skin.");
+				}
+			}
+		}
+	}
+
+	Instance instance = {};
+	instance.Node			= node;
+	instance.FirstJoint		= static_cast<uint32_t>(joint_nodes_.size());
+	instance.NumJoints		= static_cast<uint32_t>(skin.Joints.size());
+	instance.FirstVertex	= static_cast<uint32_t>(influences_.size());
+	instance.Quantized		= !primitives.empty() && primitives.front().Quantized;
+	instance.PositionScale	= XMFLOAT3(1.0f, 1.0f, 1.0f);
+	instance.PositionOffset	= XMFLOAT3(0.0f, 0.0f, 0.0f);
+	instance.BoundingSphere	= XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	// Copy the bind pose as float, quantized streams are decoded.
+	uint32_t num_vertices = 0;
+	for (const auto& primitive : primitives)
+	{
+		instance.SubMeshVertices.push_back(num_vertices);
+
+		const size_t count = primitive.NumElements[Mesh::vertex_slot_];
+		for (size_t i = 0; i < count; i++)
+		{
+			XMFLOAT4A position(0.0f, 0.0f, 0.0f, 1.0f);
+			XMFLOAT4A normal(0.0f, 0.0f, 0.0f, 0.0f);
+
+			if (primitive.Quantized)
+			{
+				const int16_t* encoded_position	= reinterpret_cast<const int16_t*>(primitive.Streams[Mesh::vertex_slot_]) + i * 4;
+				const int16_t* encoded_normal	= reinterpret_cast<const int16_t*>(primitive.Streams[Mesh::normal_slot_]) + i * 2;
+
+				position.x = primitive.PositionOffset.x + VertexQuantization::DecodeSnorm16(encoded_position[0]) * primitive.PositionScale.x;
+				position.y = primitive.PositionOffset.y + VertexQuantization::DecodeSnorm16(encoded_position[1]) * primitive.PositionScale.y;
+				position.z = primitive.PositionOffset.z + VertexQuantization::DecodeSnorm16(encoded_position[2]) * primitive.PositionScale.z;
+				position.w = VertexQuantization::DecodeSnorm16(encoded_position[3]);
+
+				VertexQuantization::DecodeOctahedral(encoded_normal, &normal.x);
+			}
+			else
+			{
+				std::memcpy(&position, primitive.Streams[Mesh::vertex_slot_] + i * 3 * sizeof(float), 3 * sizeof(float));
+				std::memcpy(&normal, primitive.Streams[Mesh::normal_slot_] + i * 3 * sizeof(float), 3 * sizeof(float));
+			}
+
+			bind_positions_.push_back(position);
+			bind_normals_.push_back(normal);
+		}
+
+		influences_.insert(influences_.end(), primitive.Skin.begin(), primitive.Skin.end());
+		num_vertices += static_cast<uint32_t>(count);
+	}
+
+	instance.SubMeshVertices.push_back(num_vertices);
+
+	// Bind pose bounds of the vertices every joint moves.
+	std::vector<XMVECTOR> bounds_min(instance.NumJoints, XMVectorReplicate(FLT_MAX));
+	std::vector<XMVECTOR> bounds_max(instance.NumJoints, XMVectorReplicate(-FLT_MAX));
+
+	for (uint32_t v = instance.FirstVertex; v < instance.FirstVertex + num_vertices; v++)
+	{
+		const XMVECTOR position = XMLoadFloat4A(&bind_positions_[v]);
+
+		for (size_t j = 0; j < 4; j++)
+		{
+			if (influences_[v].Weights[j] > 0.0f)
+			{
+				const uint16_t joint = influences_[v].Joints[j];
+				bounds_min[joint] = XMVectorMin(bounds_min[joint], position);
+				bounds_max[joint] = XMVectorMax(bounds_max[joint], position);
+			}
+		}
+	}
+
+	for (uint32_t j = 0; j < instance.NumJoints; j++)
+	{
+		joint_nodes_.push_back(skin.Joints[j]);
+
+		XMFLOAT4X4A inverse_bind_matrix;
+		XMStoreFloat4x4A(&inverse_bind_matrix, XMLoadFloat4x4(&skin.InverseBindMatrices[j]));
+		inverse_bind_matrices_.push_back(inverse_bind_matrix);
+		joint_matrices_.push_back(inverse_bind_matrix);
+
+		XMFLOAT4A center, extents;
+		XMStoreFloat4A(&center, XMVectorSetW((bounds_min[j] + bounds_max[j]) * 0.5f, 1.0f));
+		XMStoreFloat4A(&extents, XMVectorSetW((bounds_max[j] - bounds_min[j]) * 0.5f, 0.0f));
+		joint_centers_.push_back(center);
+		joint_extents_.push_back(extents);
+	}
+
+	instance.Positions.resize(num_vertices * static_cast<size_t>(instance.Quantized ? VertexQuantization::quantized_position_size_ : 3 * sizeof(float)));
+	instance.Normals.resize(num_vertices * static_cast<size_t>(instance.Quantized ? VertexQuantization::quantized_normal_size_ : 3 * sizeof(float)));
+
+	const uint32_t instance_index = static_cast<uint32_t>(instances_.size());
+	for (uint32_t begin = 0; begin < num_vertices; begin += parallel_grain_size_)
+	{
+		ranges_.push_back({ instance_index, begin, std::min<uint32_t>(begin + parallel_grain_size_, num_vertices) });
+	}
+
+	instances_.push_back(std::move(instance));
+
+	return instance_index;
+}
+
+void Skinning::Clear()
+{
+	instances_.clear();
+	ranges_.clear();
+
+	joint_nodes_.clear();
+	inverse_bind_matrices_.clear();
+	joint_matrices_.clear();
+	joint_centers_.clear();
+	joint_extents_.clear();
+
+	bind_positions_.clear();
+	bind_normals_.clear();
+	influences_.clear();
+
+	vertex_buffer_.Reset();
+}
+
+uint32_t Skinning::GetPositionStride(uint32_t instance) const
+{
+	return static_cast<uint32_t>(instances_[instance].Quantized ? VertexQuantization::quantized_position_size_ : 3 * sizeof(float));
+}
+
+uint32_t Skinning::GetNormalStride(uint32_t instance) const
+{
+	return static_cast<uint32_t>(instances_[instance].Quantized ? VertexQuantization::quantized_normal_size_ : 3 * sizeof(float));
+}
+
+uint32_t Skinning::GetNumVertices(uint32_t instance, size_t sub_mesh) const
+{
+	return instances_[instance].SubMeshVertices[sub_mesh + 1] - instances_[instance].SubMeshVertices[sub_mesh];
+}
+
+const uint8_t* Skinning::GetPositions(uint32_t instance, size_t sub_mesh) const
+{
+	return instances_[instance].Positions.data() + instances_[instance].SubMeshVertices[sub_mesh] * GetPositionStride(instance);
+}
+
+const uint8_t* Skinning::GetNormals(uint32_t instance, size_t sub_mesh) const
+{
+	return instances_[instance].Normals.data() + instances_[instance].SubMeshVertices[sub_mesh] * GetNormalStride(instance);
+}
+
+XMMATRIX Skinning::GetDequantizeTransform(uint32_t instance) const
+{
+	const Instance& data = instances_[instance];
+
+	return XMMatrixScaling(data.PositionScale.x, data.PositionScale.y, data.PositionScale.z) *
+		XMMatrixTranslation(data.PositionOffset.x, data.PositionOffset.y, data.PositionOffset.z);
+}
+
+const D3D12_VERTEX_BUFFER_VIEW& Skinning::GetPositionView(uint32_t instance, size_t sub_mesh) const
+{
+	return instances_[instance].PositionViews[sub_mesh];
+}
+
+const D3D12_VERTEX_BUFFER_VIEW& Skinning::GetNormalView(uint32_t instance, size_t sub_mesh) const
+{
+	return instances_[instance].NormalViews[sub_mesh];
+}
+
+void Skinning::UpdateJoints(uint32_t instance_index, const TransformHierarchy& transforms)
+{
+	Instance& instance = instances_[instance_index];
+
+	// Joint matrices take mesh space to the space of the node the instance is drawn with.
+	const XMMATRIX inverse_node = XMMatrixInverse(nullptr, transforms.GetWorldMatrix(instance.Node));
+
+	XMVECTOR bounds_min = XMVectorReplicate(FLT_MAX);
+	XMVECTOR bounds_max = XMVectorReplicate(-FLT_MAX);
+
+	for (uint32_t j = instance.FirstJoint; j < instance.FirstJoint + instance.NumJoints; j++)
+	{
+		const XMMATRIX joint_matrix = XMLoadFloat4x4A(&inverse_bind_matrices_[j]) * transforms.GetWorldMatrix(joint_nodes_[j]) * inverse_node;
+		XMStoreFloat4x4A(&joint_matrices_[j], joint_matrix);
+
+		const XMVECTOR extents = XMLoadFloat4A(&joint_extents_[j]);
+		if (XMVector3Less(extents, XMVectorZero()))
+			continue;
+
+		// Bounds of the moved box: the moved center and the extents along the absolute rows of the matrix.
+		const XMVECTOR center = XMVector4Transform(XMLoadFloat4A(&joint_centers_[j]), joint_matrix);
+		const XMVECTOR moved_extents =
+			XMVectorAbs(joint_matrix.r[0]) * XMVectorSplatX(extents) +
+			XMVectorAbs(joint_matrix.r[1]) * XMVectorSplatY(extents) +
+			XMVectorAbs(joint_matrix.r[2]) * XMVectorSplatZ(extents);
+
+		bounds_min = XMVectorMin(bounds_min, center - moved_extents);
+		bounds_max = XMVectorMax(bounds_max, center + moved_extents);
+	}
+
+	if (XMVector3Greater(bounds_min, bounds_max))
+	{
+		bounds_min = XMVectorZero();
+		bounds_max = XMVectorZero();
+	}
+
+	const XMVECTOR center		= (bounds_min + bounds_max) * 0.5f;
+	const XMVECTOR half_extents	= (bounds_max - bounds_min) * 0.5f;
+
+	XMStoreFloat4(&instance.BoundingSphere, XMVectorSetW(center, XMVectorGetX(XMVector3Length(half_extents))));
+
+	if (instance.Quantized)
+	{
+		XMStoreFloat3(&instance.PositionScale, XMVectorMax(half_extents, XMVectorReplicate(FLT_MIN)));
+		XMStoreFloat3(&instance.PositionOffset, center);
+	}
+}
+
+void Skinning::SkinRange(const Range& range)
+{
+	const Instance& instance = instances_[range.Instance];
+
+	const XMFLOAT4X4A* joints		= joint_matrices_.data() + instance.FirstJoint;
+	const XMFLOAT4A* positions		= bind_positions_.data() + instance.FirstVertex;
+	const XMFLOAT4A* normals		= bind_normals_.data() + instance.FirstVertex;
+	const Mesh::SkinVertex* skin	= influences_.data() + instance.FirstVertex;
+
+	uint8_t* output_positions	= const_cast<uint8_t*>(instance.Positions.data());
+	uint8_t* output_normals		= const_cast<uint8_t*>(instance.Normals.data());
+
+	const XMVECTOR inverse_scale	= XMVectorReciprocal(XMLoadFloat3(&instance.PositionScale));
+	const XMVECTOR offset			= XMLoadFloat3(&instance.PositionOffset);
+
+	for (uint32_t v = range.Begin; v < range.End; v++)
+	{
+		const Mesh::SkinVertex& influence = skin[v];
+
+		// Blend the rows of the four joint matrices, the weights of unused influences are 0.
+		const XMVECTOR weights = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(influence.Weights));
+		const XMVECTOR w0 = XMVectorSplatX(weights), w1 = XMVectorSplatY(weights), w2 = XMVectorSplatZ(weights), w3 = XMVectorSplatW(weights);
+
+		const XMFLOAT4X4A& m0 = joints[influence.Joints[0]];
+		const XMFLOAT4X4A& m1 = joints[influence.Joints[1]];
+		const XMFLOAT4X4A& m2 = joints[influence.Joints[2]];
+		const XMFLOAT4X4A& m3 = joints[influence.Joints[3]];
+
+		XMVECTOR rows[4];
+		for (size_t r = 0; r < 4; r++)
+		{
+			rows[r] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(m0.m[r])) * w0;
+			rows[r] = XMVectorMultiplyAdd(XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(m1.m[r])), w1, rows[r]);
+			rows[r] = XMVectorMultiplyAdd(XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(m2.m[r])), w2, rows[r]);
+			rows[r] = XMVectorMultiplyAdd(XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(m3.m[r])), w3, rows[r]);
+		}
+
+		const XMVECTOR bind_position	= XMLoadFloat4A(&positions[v]);
+		const XMVECTOR bind_normal		= XMLoadFloat4A(&normals[v]);
+
+		XMVECTOR position = XMVectorMultiplyAdd(XMVectorSplatZ(bind_position), rows[2], rows[3]);
+		position = XMVectorMultiplyAdd(XMVectorSplatY(bind_position), rows[1], position);
+		position = XMVectorMultiplyAdd(XMVectorSplatX(bind_position), rows[0], position);
+
+		// Normals are moved by the blended matrix as well, which is exact for rigid and uniformly scaled joints.
+		XMVECTOR normal = XMVectorSplatZ(bind_normal) * rows[2];
+		normal = XMVectorMultiplyAdd(XMVectorSplatY(bind_normal), rows[1], normal);
+		normal = XMVectorMultiplyAdd(XMVectorSplatX(bind_normal), rows[0], normal);
+		normal = XMVector3Normalize(normal);
+
+		if (instance.Quantized)
+		{
+			// The bitangent sign stays in w.
+			const XMVECTOR quantized = XMVectorSelect(bind_position, (position - offset) * inverse_scale, g_XMSelect1110);
+
+			PackedVector::XMStoreShortN4(reinterpret_cast<PackedVector::XMSHORTN4*>(output_positions) + v, quantized);
+			PackedVector::XMStoreShortN2(reinterpret_cast<PackedVector::XMSHORTN2*>(output_normals) + v, EncodeOctahedral(normal));
+		}
+		else
+		{
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(output_positions) + v, position);
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(output_normals) + v, normal);
+		}
+	}
+}
+
+void Skinning::Update(const TransformHierarchy& transforms, ThreadPool* thread_pool)
+{
+	for (uint32_t i = 0; i < instances_.size(); i++)
+	{
+		UpdateJoints(i, transforms);
+	}
+
+	// Ranges of different instances write to different streams, ranges of one instance to disjoint vertices.
+	ParallelFor(influences_.size() > parallel_grain_size_ ? thread_pool : nullptr, ranges_.size(), [this](size_t index)
+	{
+		SkinRange(ranges_[index]);
+	});
+}
+
+// View of a stream at offset in the vertex buffer, the buffer location is the offset until the buffer exists.
+static D3D12_VERTEX_BUFFER_VIEW PlaceStream(uint32_t num_vertices, uint32_t stride, uint64_t& offset)
+{
+	D3D12_VERTEX_BUFFER_VIEW view = {};
+	view.BufferLocation	= offset;
+	view.SizeInBytes	= num_vertices * stride;
+	view.StrideInBytes	= stride;
+
+	offset = math::AlignUp(offset + view.SizeInBytes, 16);
+
+	return view;
+}
+
+void Skinning::Upload(CommandList& command_list)
+{
+	uint64_t buffer_size = 0;
+
+	for (uint32_t i = 0; i < instances_.size(); i++)
+	{
+		Instance& instance = instances_[i];
+
+		instance.PositionViews.resize(GetNumSubMeshes(i));
+		instance.NormalViews.resize(GetNumSubMeshes(i));
+
+		for (size_t sub_mesh = 0; sub_mesh < GetNumSubMeshes(i); sub_mesh++)
+		{
+			instance.PositionViews[sub_mesh]	= PlaceStream(GetNumVertices(i, sub_mesh), GetPositionStride(i), buffer_size);
+			instance.NormalViews[sub_mesh]		= PlaceStream(GetNumVertices(i, sub_mesh), GetNormalStride(i), buffer_size);
+		}
+	}
+
+	if (buffer_size == 0)
+		return;
+
+	// The buffer is only recreated when the streams no longer fit, growing geometrically like the geometry pool.
+	const auto resource = vertex_buffer_.GetD3D12Resource();
+	if (!resource || resource->GetDesc().Width < buffer_size)
+	{
+		const uint64_t grown_size = resource ? std::max(buffer_size, 2 * resource->GetDesc().Width) : buffer_size;
+		command_list.CopyBuffer(vertex_buffer_, static_cast<size_t>(grown_size), nullptr);
+	}
+
+	const D3D12_GPU_VIRTUAL_ADDRESS buffer_location = vertex_buffer_.GetD3D12Resource()->GetGPUVirtualAddress();
+
+	for (uint32_t i = 0; i < instances_.size(); i++)
+	{
+		Instance& instance = instances_[i];
+
+		for (size_t sub_mesh = 0; sub_mesh < GetNumSubMeshes(i); sub_mesh++)
+		{
+			D3D12_VERTEX_BUFFER_VIEW& position_view	= instance.PositionViews[sub_mesh];
+			D3D12_VERTEX_BUFFER_VIEW& normal_view	= instance.NormalViews[sub_mesh];
+
+			command_list.CopyBufferRegion(vertex_buffer_, position_view.BufferLocation, GetPositions(i, sub_mesh), position_view.SizeInBytes);
+			command_list.CopyBufferRegion(vertex_buffer_, normal_view.BufferLocation, GetNormals(i, sub_mesh), normal_view.SizeInBytes);
+
+			position_view.BufferLocation	+= buffer_location;
+			normal_view.BufferLocation		+= buffer_location;
+		}
+	}
+}
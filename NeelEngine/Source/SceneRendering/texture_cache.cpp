@@ -0,0 +1,111 @@
+#include "neel_engine_pch.h"
+
+#include "texture_cache.h"
+#include "commandlist.h"
+#include "thread_pool.h"
+
+#include "DirectXTex.h"
+
+TextureCache::TextureCache()
+	: num_requested_(0)
+	, num_decoded_(0)
+	, num_created_(0)
+{
+}
+
+TextureCache::~TextureCache()
+{
+}
+
+void TextureCache::DecodeImages(const std::vector<TextureLoadRequest>& texture_requests, ThreadPool* thread_pool)
+{
+	std::vector<const TextureLoadRequest*> decode_requests;
+
+	for (const auto& request : texture_requests)
+	{
+		const std::string resolved_path = ResolvePath(request.Filename);
+
+		if (textures_.count(GetTextureKey(resolved_path, request.Usage)) || image_indices_.count(resolved_path))
+			continue;
+
+		image_indices_[resolved_path] = images_.size() + decode_requests.size();
+		decode_requests.push_back(&request);
+	}
+
+	const size_t first_image = images_.size();
+	images_.resize(first_image + decode_requests.size());
+
+	ParallelFor(thread_pool, decode_requests.size(), [&](size_t index)
+	{
+		const TextureLoadRequest& request = *decode_requests[index];
+
+		if (request.Data)
+		{
+			CommandList::DecodeTextureFromMemory(request.Data, request.DataSize, images_[first_image + index]);
+		}
+		else
+		{
+			CommandList::DecodeTextureFromFile(request.Filename, images_[first_image + index]);
+		}
+	});
+
+	num_decoded_ += static_cast<uint32_t>(decode_requests.size());
+}
+
+void TextureCache::CreateTextures(const std::vector<TextureLoadRequest>& texture_requests, CommandList& command_list, std::vector<Texture>& textures)
+{
+	for (const auto& request : texture_requests)
+	{
+		const std::string resolved_path = ResolvePath(request.Filename);
+		const std::string key = GetTextureKey(resolved_path, request.Usage);
+
+		auto iter = textures_.find(key);
+		if (iter == textures_.end())
+		{
+			const auto image = image_indices_.find(resolved_path);
+			if (image == image_indices_.end())
+			{
+				throw std::exception("Texture image has not been decoded.");
+			}
+
+			Texture texture;
+			command_list.LoadTextureFromScratchImage(texture, images_[image->second], request.Filename, request.Usage);
+
+			iter = textures_.emplace(key, texture).first;
+			num_created_++;
+		}
+
+		textures[request.TextureIndex] = iter->second;
+		num_requested_++;
+	}
+
+	// Pixels have been copied to the upload heap.
+	image_indices_.clear();
+	images_.clear();
+}
+
+void TextureCache::Clear()
+{
+	textures_.clear();
+	image_indices_.clear();
+	images_.clear();
+
+	num_requested_	= 0;
+	num_decoded_	= 0;
+	num_created_	= 0;
+}
+
+std::string TextureCache::ResolvePath(const std::string& filename)
+{
+	std::string path = std::filesystem::absolute(filename).lexically_normal().string();
+
+	// Paths are case insensitive on Windows.
+	std::transform(path.begin(), path.end(), path.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+	return path;
+}
+
+std::string TextureCache::GetTextureKey(const std::string& resolved_path, TextureUsage texture_usage)
+{
+	return resolved_path + "|" + std::to_string(static_cast<int>(texture_usage));
+}
@@ -0,0 +1,322 @@
+#include "neel_engine_pch.h"
+
+#include "transform_hierarchy.h"
+#include "thread_pool.h"
+
+// Local transform scale * rotation * translation of a single node.
+static XMMATRIX ComposeLocal(const std::array<std::vector<float>, 3>& translations, const std::array<std::vector<float>, 4>& rotations,
+	const std::array<std::vector<float>, 3>& scales, uint32_t node)
+{
+	const XMVECTOR translation	= XMVectorSet(translations[0][node], translations[1][node], translations[2][node], 0.0f);
+	const XMVECTOR rotation		= XMVectorSet(rotations[0][node], rotations[1][node], rotations[2][node], rotations[3][node]);
+	const XMVECTOR scale		= XMVectorSet(scales[0][node], scales[1][node], scales[2][node], 0.0f);
+
+	XMMATRIX local = XMMatrixRotationQuaternion(rotation);
+	local.r[0] = local.r[0] * XMVectorSplatX(scale);
+	local.r[1] = local.r[1] * XMVectorSplatY(scale);
+	local.r[2] = local.r[2] * XMVectorSplatZ(scale);
+	local.r[3] = XMVectorSetW(translation, 1.0f);
+
+	return local;
+}
+
+// Local transforms of the four nodes starting at first, every vector holds one component of all four nodes.
+static void ComposeLocal4(const std::array<std::vector<float>, 3>& translations, const std::array<std::vector<float>, 4>& rotations,
+	const std::array<std::vector<float>, 3>& scales, uint32_t first, XMMATRIX* locals)
+{
+	auto load = [first](const std::vector<float>& component)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&component[first]));
+	};
+
+	const XMVECTOR x = load(rotations[0]), y = load(rotations[1]), z = load(rotations[2]), w = load(rotations[3]);
+	const XMVECTOR two = XMVectorReplicate(2.0f);
+	const XMVECTOR one = XMVectorReplicate(1.0f);
+
+	const XMVECTOR xx = x * x * two, yy = y * y * two, zz = z * z * two;
+	const XMVECTOR xy = x * y * two, xz = x * z * two, yz = y * z * two;
+	const XMVECTOR xw = x * w * two, yw = y * w * two, zw = z * w * two;
+
+	// Rows of XMMatrixRotationQuaternion scaled by the scale of the node.
+	const XMVECTOR sx = load(scales[0]), sy = load(scales[1]), sz = load(scales[2]);
+
+	const XMMATRIX row0(sx * (one - yy - zz), sx * (xy + zw), sx * (xz - yw), XMVectorZero());
+	const XMMATRIX row1(sy * (xy - zw), sy * (one - xx - zz), sy * (yz + xw), XMVectorZero());
+	const XMMATRIX row2(sz * (xz + yw), sz * (yz - xw), sz * (one - xx - yy), XMVectorZero());
+	const XMMATRIX row3(load(translations[0]), load(translations[1]), load(translations[2]), one);
+
+	// Transposing turns the components of four nodes into one row of every node.
+	const XMMATRIX rows[4] = { XMMatrixTranspose(row0), XMMatrixTranspose(row1), XMMatrixTranspose(row2), XMMatrixTranspose(row3) };
+
+	for (size_t node = 0; node < 4; node++)
+	{
+		locals[node] = XMMATRIX(rows[0].r[node], rows[1].r[node], rows[2].r[node], rows[3].r[node]);
+	}
+}
+
+uint32_t TransformHierarchy::AddNode(int32_t parent, const XMFLOAT3& translation, const XMFLOAT4& rotation, const XMFLOAT3& scale)
+{
+	const uint32_t node = static_cast<uint32_t>(parents_.size());
+
+	if (parent != no_parent_)
+	{
+		// Depth first order: the parent is on the path from the last node to its root.
+		int32_t ancestor = static_cast<int32_t>(node) - 1;
+		while (ancestor != no_parent_ && ancestor != parent)
+		{
+			ancestor = parents_[ancestor];
+		}
+
+		if (ancestor == no_parent_)
+		{
+			throw std::invalid_argument("Transform hierarchy nodes have to be added in depth first order.");
+		}
+
+		for (ancestor = parent; ancestor != no_parent_; ancestor = parents_[ancestor])
+		{
+			subtree_sizes_[ancestor]++;
+		}
+	}
+
+	parents_.push_back(parent);
+	subtree_sizes_.push_back(1);
+
+	translations_[0].push_back(translation.x);
+	translations_[1].push_back(translation.y);
+	translations_[2].push_back(translation.z);
+	rotations_[0].push_back(rotation.x);
+	rotations_[1].push_back(rotation.y);
+	rotations_[2].push_back(rotation.z);
+	rotations_[3].push_back(rotation.w);
+	scales_[0].push_back(scale.x);
+	scales_[1].push_back(scale.y);
+	scales_[2].push_back(scale.z);
+
+	XMFLOAT4X4A identity;
+	XMStoreFloat4x4A(&identity, XMMatrixIdentity());
+	world_matrices_.push_back(identity);
+
+	dirty_.push_back(0);
+	MarkDirty(node);
+
+	return node;
+}
+
+uint32_t XM_CALLCONV TransformHierarchy::AddNode(int32_t parent, FXMMATRIX local_transform)
+{
+	XMVECTOR scale, rotation, translation;
+	if (!XMMatrixDecompose(&scale, &rotation, &translation, local_transform))
+	{
+		scale		= XMVectorReplicate(1.0f);
+		rotation	= XMQuaternionIdentity();
+		translation	= local_transform.r[3];
+	}
+
+	XMFLOAT3 t, s;
+	XMFLOAT4 r;
+	XMStoreFloat3(&t, translation);
+	XMStoreFloat4(&r, rotation);
+	XMStoreFloat3(&s, scale);
+
+	return AddNode(parent, t, r, s);
+}
+
+void TransformHierarchy::Reserve(size_t num_nodes)
+{
+	parents_.reserve(num_nodes);
+	subtree_sizes_.reserve(num_nodes);
+
+	for (auto& component : translations_) component.reserve(num_nodes);
+	for (auto& component : rotations_) component.reserve(num_nodes);
+	for (auto& component : scales_) component.reserve(num_nodes);
+
+	world_matrices_.reserve(num_nodes);
+	dirty_.reserve(num_nodes);
+}
+
+void TransformHierarchy::Clear()
+{
+	parents_.clear();
+	subtree_sizes_.clear();
+
+	for (auto& component : translations_) component.clear();
+	for (auto& component : rotations_) component.clear();
+	for (auto& component : scales_) component.clear();
+
+	world_matrices_.clear();
+	dirty_.clear();
+	dirty_nodes_.clear();
+}
+
+void TransformHierarchy::SetTranslation(uint32_t node, const XMFLOAT3& translation)
+{
+	translations_[0][node] = translation.x;
+	translations_[1][node] = translation.y;
+	translations_[2][node] = translation.z;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetRotation(uint32_t node, const XMFLOAT4& rotation)
+{
+	rotations_[0][node] = rotation.x;
+	rotations_[1][node] = rotation.y;
+	rotations_[2][node] = rotation.z;
+	rotations_[3][node] = rotation.w;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetScale(uint32_t node, const XMFLOAT3& scale)
+{
+	scales_[0][node] = scale.x;
+	scales_[1][node] = scale.y;
+	scales_[2][node] = scale.z;
+	MarkDirty(node);
+}
+
+XMFLOAT3 TransformHierarchy::GetTranslation(uint32_t node) const
+{
+	return XMFLOAT3(translations_[0][node], translations_[1][node], translations_[2][node]);
+}
+
+XMFLOAT4 TransformHierarchy::GetRotation(uint32_t node) const
+{
+	return XMFLOAT4(rotations_[0][node], rotations_[1][node], rotations_[2][node], rotations_[3][node]);
+}
+
+XMFLOAT3 TransformHierarchy::GetScale(uint32_t node) const
+{
+	return XMFLOAT3(scales_[0][node], scales_[1][node], scales_[2][node]);
+}
+
+void TransformHierarchy::MarkDirty(uint32_t node)
+{
+	if (!dirty_[node])
+	{
+		dirty_[node] = 1;
+		dirty_nodes_.push_back(node);
+	}
+}
+
+void TransformHierarchy::UpdateRange(uint32_t begin, uint32_t end)
+{
+	XMMATRIX locals[4];
+
+	for (uint32_t first = begin; first < end; first += 4)
+	{
+		const uint32_t count = std::min(end - first, 4u);
+
+		if (count == 4)
+		{
+			ComposeLocal4(translations_, rotations_, scales_, first, locals);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				locals[i] = ComposeLocal(translations_, rotations_, scales_, first + i);
+			}
+		}
+
+		// Parents come first, so a parent in the same batch is already stored.
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const int32_t parent = parents_[first + i];
+			const XMMATRIX world = parent == no_parent_ ? locals[i] : locals[i] * XMLoadFloat4x4A(&world_matrices_[parent]);
+
+			XMStoreFloat4x4A(&world_matrices_[first + i], world);
+		}
+	}
+}
+
+void TransformHierarchy::SplitRange(uint32_t begin, uint32_t end, std::vector<std::pair<uint32_t, uint32_t>>& ranges)
+{
+	if (end - begin <= parallel_grain_size_)
+	{
+		ranges.emplace_back(begin, end);
+		return;
+	}
+
+	// The root goes first, then its children's subtrees are independent of each other.
+	UpdateRange(begin, begin + 1);
+
+	uint32_t chunk_begin = begin + 1;
+	for (uint32_t child = begin + 1; child < end; child += subtree_sizes_[child])
+	{
+		const uint32_t child_end = child + subtree_sizes_[child];
+
+		if (child_end - child > parallel_grain_size_)
+		{
+			if (chunk_begin < child)
+			{
+				ranges.emplace_back(chunk_begin, child);
+			}
+
+			SplitRange(child, child_end, ranges);
+			chunk_begin = child_end;
+		}
+		else if (child_end - chunk_begin > parallel_grain_size_)
+		{
+			ranges.emplace_back(chunk_begin, child);
+			chunk_begin = child;
+		}
+	}
+
+	if (chunk_begin < end)
+	{
+		ranges.emplace_back(chunk_begin, end);
+	}
+}
+
+size_t TransformHierarchy::Update(ThreadPool* thread_pool)
+{
+	if (dirty_nodes_.empty())
+		return 0;
+
+	// Dirty nodes inside the subtree of another dirty node are covered by it.
+	std::sort(dirty_nodes_.begin(), dirty_nodes_.end());
+
+	std::vector<std::pair<uint32_t, uint32_t>> subtrees;
+	size_t num_updated = 0;
+
+	for (uint32_t node : dirty_nodes_)
+	{
+		dirty_[node] = 0;
+
+		if (!subtrees.empty() && node < subtrees.back().second)
+			continue;
+
+		subtrees.emplace_back(node, node + subtree_sizes_[node]);
+		num_updated += subtree_sizes_[node];
+	}
+
+	dirty_nodes_.clear();
+
+	if (!thread_pool || num_updated <= parallel_grain_size_)
+	{
+		for (const auto& subtree : subtrees)
+		{
+			UpdateRange(subtree.first, subtree.second);
+		}
+
+		return num_updated;
+	}
+
+	std::vector<std::pair<uint32_t, uint32_t>> ranges;
+	for (const auto& subtree : subtrees)
+	{
+		SplitRange(subtree.first, subtree.second, ranges);
+	}
+
+	// Many small subtrees are handed out in groups of about the grain size.
+	const size_t ranges_per_task = std::max<size_t>(1, ranges.size() * parallel_grain_size_ / num_updated);
+
+	thread_pool->ParallelForRange(ranges.size(), ranges_per_task, [this, &ranges](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			UpdateRange(ranges[i].first, ranges[i].second);
+		}
+	});
+
+	return num_updated;
+}
@@ -0,0 +1,276 @@
+#include "neel_engine_pch.h"
+
+#include "vertex_quantization.h"
+
+#include <DirectXPackedVector.h>
+
+template <typename T>
+static float ReadComponent(const uint8_t* data, bool normalized, float max_value)
+{
+	T value;
+	std::memcpy(&value, data, sizeof(T));
+
+	return normalized ? std::max(static_cast<float>(value) / max_value, -1.0f) : static_cast<float>(value);
+}
+
+void VertexQuantization::DecodeComponents(const uint8_t* data, uint32_t stride, size_t count, uint32_t num_components,
+	fx::gltf::Accessor::ComponentType component_type, bool normalized, float* output)
+{
+	using ComponentType = fx::gltf::Accessor::ComponentType;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint8_t* element = data + i * stride;
+
+		for (uint32_t c = 0; c < num_components; c++)
+		{
+			float& value = output[i * num_components + c];
+
+			switch (component_type)
+			{
+				case ComponentType::Byte:
+					value = ReadComponent<int8_t>(element + c, normalized, 127.0f);
+					break;
+				case ComponentType::UnsignedByte:
+					value = ReadComponent<uint8_t>(element + c, normalized, 255.0f);
+					break;
+				case ComponentType::Short:
+					value = ReadComponent<int16_t>(element + c * 2, normalized, 32767.0f);
+					break;
+				case ComponentType::UnsignedShort:
+					value = ReadComponent<uint16_t>(element + c * 2, normalized, 65535.0f);
+					break;
+				case ComponentType::UnsignedInt:
+					value = ReadComponent<uint32_t>(element + c * 4, false, 1.0f);
+					break;
+				case ComponentType::Float:
+					std::memcpy(&value, element + c * 4, sizeof(float));
+					break;
+				default:
+					throw std::runtime_error("Unsupported vertex attribute component type");
+			}
+		}
+	}
+}
+
+// Angle between two vectors in degrees.
+static double AngleDegrees(const float* a, const float* b)
+{
+	const double length_a = std::sqrt(static_cast<double>(a[0]) * a[0] + static_cast<double>(a[1]) * a[1] + static_cast<double>(a[2]) * a[2]);
+	const double length_b = std::sqrt(static_cast<double>(b[0]) * b[0] + static_cast<double>(b[1]) * b[1] + static_cast<double>(b[2]) * b[2]);
+
+	if (length_a == 0.0 || length_b == 0.0)
+		return 0.0;
+
+	const double cosine = (static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] + static_cast<double>(a[2]) * b[2]) / (length_a * length_b);
+
+	return std::acos(std::min(1.0, std::max(-1.0, cosine))) * 180.0 / XM_PI;
+}
+
+VertexQuantization::Stats VertexQuantization::QuantizeMesh(std::vector<Mesh::PrimitiveData>& primitives)
+{
+	Stats stats;
+
+	// Bounds of the whole mesh.
+	float bounds_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float bounds_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (const auto& primitive : primitives)
+	{
+		const float* positions = reinterpret_cast<const float*>(primitive.Streams[Mesh::vertex_slot_]);
+
+		for (size_t i = 0; i < primitive.NumElements[Mesh::vertex_slot_]; i++)
+		{
+			for (size_t c = 0; c < 3; c++)
+			{
+				bounds_min[c] = std::min(bounds_min[c], positions[i * 3 + c]);
+				bounds_max[c] = std::max(bounds_max[c], positions[i * 3 + c]);
+			}
+		}
+	}
+
+	float scale[3];
+	float offset[3];
+	for (size_t c = 0; c < 3; c++)
+	{
+		offset[c]	= bounds_min[c] <= bounds_max[c] ? (bounds_min[c] + bounds_max[c]) * 0.5f : 0.0f;
+		scale[c]	= bounds_min[c] < bounds_max[c] ? (bounds_max[c] - bounds_min[c]) * 0.5f : 1.0f;
+	}
+
+	for (auto& primitive : primitives)
+	{
+		const float* positions	= reinterpret_cast<const float*>(primitive.Streams[Mesh::vertex_slot_]);
+		const float* normals	= reinterpret_cast<const float*>(primitive.Streams[Mesh::normal_slot_]);
+		const float* tangents	= reinterpret_cast<const float*>(primitive.Streams[Mesh::tangent_slot_]);
+		const float* texcoords	= reinterpret_cast<const float*>(primitive.Streams[Mesh::texcoord0_slot_]);
+
+		const std::array<size_t, 4> element_size = { quantized_position_size_, quantized_normal_size_, quantized_tangent_size_, quantized_texcoord_size_ };
+
+		// Indices that were converted during import live in the storage that is replaced.
+		const bool indices_in_storage = primitive.Indices >= primitive.Storage.data() && primitive.Indices < primitive.Storage.data() + primitive.Storage.size();
+
+		std::array<size_t, 4> stream_offsets;
+		size_t storage_size = 0;
+		for (size_t slot = 0; slot < 4; slot++)
+		{
+			stream_offsets[slot] = storage_size;
+			storage_size += primitive.Streams[slot] ? primitive.NumElements[slot] * element_size[slot] : 0;
+		}
+
+		const size_t indices_offset = storage_size;
+		storage_size += indices_in_storage ? primitive.IndexDataSize() : 0;
+
+		std::vector<uint8_t> storage(storage_size);
+
+		int16_t* quantized_positions	= reinterpret_cast<int16_t*>(storage.data() + stream_offsets[Mesh::vertex_slot_]);
+		int16_t* quantized_normals		= reinterpret_cast<int16_t*>(storage.data() + stream_offsets[Mesh::normal_slot_]);
+		int16_t* quantized_tangents		= reinterpret_cast<int16_t*>(storage.data() + stream_offsets[Mesh::tangent_slot_]);
+		uint16_t* quantized_texcoords	= reinterpret_cast<uint16_t*>(storage.data() + stream_offsets[Mesh::texcoord0_slot_]);
+
+		for (size_t i = 0; i < primitive.NumElements[Mesh::vertex_slot_]; i++)
+		{
+			for (size_t c = 0; c < 3; c++)
+			{
+				const float position = positions[i * 3 + c];
+				quantized_positions[i * 4 + c] = EncodeSnorm16((position - offset[c]) / scale[c]);
+
+				const float decoded = offset[c] + DecodeSnorm16(quantized_positions[i * 4 + c]) * scale[c];
+				stats.MaxPositionError = std::max(stats.MaxPositionError, static_cast<double>(std::abs(decoded - position)));
+			}
+
+			// Bitangent sign.
+			const bool negative_sign = tangents && i < primitive.NumElements[Mesh::tangent_slot_] && tangents[i * 4 + 3] < 0.0f;
+			quantized_positions[i * 4 + 3] = EncodeSnorm16(negative_sign ? -1.0f : 1.0f);
+		}
+
+		if (normals)
+		{
+			for (size_t i = 0; i < primitive.NumElements[Mesh::normal_slot_]; i++)
+			{
+				EncodeOctahedral(&normals[i * 3], &quantized_normals[i * 2]);
+
+				float decoded[3];
+				DecodeOctahedral(&quantized_normals[i * 2], decoded);
+				stats.MaxNormalDegrees = std::max(stats.MaxNormalDegrees, AngleDegrees(decoded, &normals[i * 3]));
+			}
+		}
+
+		if (tangents)
+		{
+			for (size_t i = 0; i < primitive.NumElements[Mesh::tangent_slot_]; i++)
+			{
+				EncodeOctahedral(&tangents[i * 4], &quantized_tangents[i * 2]);
+
+				float decoded[3];
+				DecodeOctahedral(&quantized_tangents[i * 2], decoded);
+				stats.MaxTangentDegrees = std::max(stats.MaxTangentDegrees, AngleDegrees(decoded, &tangents[i * 4]));
+			}
+		}
+
+		if (texcoords)
+		{
+			for (size_t i = 0; i < primitive.NumElements[Mesh::texcoord0_slot_] * 2; i++)
+			{
+				quantized_texcoords[i] = PackedVector::XMConvertFloatToHalf(texcoords[i]);
+
+				const float decoded = PackedVector::XMConvertHalfToFloat(quantized_texcoords[i]);
+				stats.MaxTexCoordError = std::max(stats.MaxTexCoordError, static_cast<double>(std::abs(decoded - texcoords[i])));
+			}
+		}
+
+		if (indices_in_storage)
+		{
+			std::memcpy(storage.data() + indices_offset, primitive.Indices, primitive.IndexDataSize());
+		}
+
+		stats.NumVertices	+= primitive.NumElements[Mesh::vertex_slot_];
+		stats.FloatBytes	+= primitive.VertexDataSize();
+
+		for (size_t slot = 0; slot < 4; slot++)
+		{
+			if (primitive.Streams[slot])
+			{
+				primitive.Streams[slot]		= storage.data() + stream_offsets[slot];
+				primitive.ElementSize[slot]	= element_size[slot];
+			}
+		}
+
+		if (indices_in_storage)
+		{
+			primitive.Indices = storage.data() + indices_offset;
+		}
+
+		primitive.Storage.swap(storage);
+
+		primitive.Quantized			= true;
+		primitive.PositionScale		= XMFLOAT3(scale[0], scale[1], scale[2]);
+		primitive.PositionOffset	= XMFLOAT3(offset[0], offset[1], offset[2]);
+
+		stats.QuantizedBytes += primitive.VertexDataSize();
+	}
+
+	return stats;
+}
+
+int16_t VertexQuantization::EncodeSnorm16(float value)
+{
+	return static_cast<int16_t>(std::lround(std::min(1.0f, std::max(-1.0f, value)) * 32767.0f));
+}
+
+float VertexQuantization::DecodeSnorm16(int16_t value)
+{
+	return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+// Sign that maps 0 to +1.
+static float SignNotZero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+void VertexQuantization::EncodeOctahedral(const float* normal, int16_t* encoded)
+{
+	const float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+	if (length == 0.0f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float x = normal[0] / length;
+	float y = normal[1] / length;
+
+	// Fold the lower hemisphere over the diagonals.
+	if (normal[2] < 0.0f)
+	{
+		const float folded_x = (1.0f - std::abs(y)) * SignNotZero(x);
+		const float folded_y = (1.0f - std::abs(x)) * SignNotZero(y);
+		x = folded_x;
+		y = folded_y;
+	}
+
+	encoded[0] = EncodeSnorm16(x);
+	encoded[1] = EncodeSnorm16(y);
+}
+
+void VertexQuantization::DecodeOctahedral(const int16_t* encoded, float* normal)
+{
+	float x = DecodeSnorm16(encoded[0]);
+	float y = DecodeSnorm16(encoded[1]);
+	const float z = 1.0f - std::abs(x) - std::abs(y);
+
+	if (z < 0.0f)
+	{
+		const float unfolded_x = (1.0f - std::abs(y)) * SignNotZero(x);
+		const float unfolded_y = (1.0f - std::abs(x)) * SignNotZero(y);
+		x = unfolded_x;
+		y = unfolded_y;
+	}
+
+	const float length = std::sqrt(x * x + y * y + z * z);
+
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
@@ -0,0 +1,977 @@
+#include "neel_engine_pch.h"
+
+#include "wide_bvh.h"
+
+static float GetHalfArea(const Bvh::Node& node)
+{
+	const float x = node.BoundsMax.x - node.BoundsMin.x;
+	const float y = node.BoundsMax.y - node.BoundsMin.y;
+	const float z = node.BoundsMax.z - node.BoundsMin.z;
+
+	return x * y + y * z + z * x;
+}
+
+// Four rays of a packet, one per lane.
+struct RayLanes
+{
+	XMVECTOR	OriginX;
+	XMVECTOR	OriginY;
+	XMVECTOR	OriginZ;
+	XMVECTOR	DirectionX;
+	XMVECTOR	DirectionY;
+	XMVECTOR	DirectionZ;
+	XMVECTOR	InverseDirectionX;
+	XMVECTOR	InverseDirectionY;
+	XMVECTOR	InverseDirectionZ;
+	XMVECTOR	TMin;
+};
+
+// Bounds of the rays of a packet whose directions all point into the same octant.
+struct PacketFrustum
+{
+	XMVECTOR	OriginMin[3];
+	XMVECTOR	OriginMax[3];
+	XMVECTOR	InverseDirectionMin[3];
+	XMVECTOR	InverseDirectionMax[3];
+	bool		Positive[3];
+	XMVECTOR	TMin;
+	XMVECTOR	TMax;
+};
+
+// One bit per lane of a comparison mask.
+static uint32_t XM_CALLCONV GetLaneBits(FXMVECTOR mask)
+{
+	XMUINT4 lanes;
+	XMStoreUInt4(&lanes, mask);
+
+	return (lanes.x & 1) | (lanes.y & 2) | (lanes.z & 4) | (lanes.w & 8);
+}
+
+static XMVECTOR GetLaneMask(uint32_t bits)
+{
+	return XMVectorSetInt(bits & 1 ? 0xffffffff : 0, bits & 2 ? 0xffffffff : 0, bits & 4 ? 0xffffffff : 0, bits & 8 ? 0xffffffff : 0);
+}
+
+static float XM_CALLCONV GetMinComponent(FXMVECTOR vector)
+{
+	XMFLOAT4A components;
+	XMStoreFloat4A(&components, vector);
+
+	return std::min(std::min(components.x, components.y), std::min(components.z, components.w));
+}
+
+static float XM_CALLCONV GetMaxComponent(FXMVECTOR vector)
+{
+	XMFLOAT4A components;
+	XMStoreFloat4A(&components, vector);
+
+	return std::max(std::max(components.x, components.y), std::max(components.z, components.w));
+}
+
+/**
+* Bvh::IntersectTriangle for four rays. Every lane runs the same operations in the same order, so the hits are identical
+* to the ones of a single ray.
+* @return Mask of the lanes that hit within [TMin, t_max].
+*/
+static XMVECTOR XM_CALLCONV IntersectTriangle4(const XMFLOAT3* vertices, const RayLanes& rays, FXMVECTOR t_max, bool cull_back_faces, XMVECTOR& t,
+	XMVECTOR& u, XMVECTOR& v)
+{
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorReplicate(1.0f);
+
+	const XMVECTOR v0_x = XMVectorReplicate(vertices[0].x);
+	const XMVECTOR v0_y = XMVectorReplicate(vertices[0].y);
+	const XMVECTOR v0_z = XMVectorReplicate(vertices[0].z);
+	const XMVECTOR edge1_x = XMVectorReplicate(vertices[1].x - vertices[0].x);
+	const XMVECTOR edge1_y = XMVectorReplicate(vertices[1].y - vertices[0].y);
+	const XMVECTOR edge1_z = XMVectorReplicate(vertices[1].z - vertices[0].z);
+	const XMVECTOR edge2_x = XMVectorReplicate(vertices[2].x - vertices[0].x);
+	const XMVECTOR edge2_y = XMVectorReplicate(vertices[2].y - vertices[0].y);
+	const XMVECTOR edge2_z = XMVectorReplicate(vertices[2].z - vertices[0].z);
+
+	const XMVECTOR p_x = rays.DirectionY * edge2_z - rays.DirectionZ * edge2_y;
+	const XMVECTOR p_y = rays.DirectionZ * edge2_x - rays.DirectionX * edge2_z;
+	const XMVECTOR p_z = rays.DirectionX * edge2_y - rays.DirectionY * edge2_x;
+	const XMVECTOR determinant = (edge1_x * p_x + edge1_y * p_y) + edge1_z * p_z;
+
+	XMVECTOR mask = cull_back_faces ? XMVectorGreater(determinant, zero) : XMVectorNotEqual(determinant, zero);
+
+	const XMVECTOR inverse_determinant = XMVectorReciprocal(determinant);
+
+	const XMVECTOR s_x = rays.OriginX - v0_x;
+	const XMVECTOR s_y = rays.OriginY - v0_y;
+	const XMVECTOR s_z = rays.OriginZ - v0_z;
+	u = ((s_x * p_x + s_y * p_y) + s_z * p_z) * inverse_determinant;
+	mask = XMVectorAndCInt(mask, XMVectorOrInt(XMVectorLess(u, zero), XMVectorGreater(u, one)));
+
+	const XMVECTOR q_x = s_y * edge1_z - s_z * edge1_y;
+	const XMVECTOR q_y = s_z * edge1_x - s_x * edge1_z;
+	const XMVECTOR q_z = s_x * edge1_y - s_y * edge1_x;
+	v = ((rays.DirectionX * q_x + rays.DirectionY * q_y) + rays.DirectionZ * q_z) * inverse_determinant;
+	mask = XMVectorAndCInt(mask, XMVectorOrInt(XMVectorLess(v, zero), XMVectorGreater(u + v, one)));
+
+	t = ((edge2_x * q_x + edge2_y * q_y) + edge2_z * q_z) * inverse_determinant;
+
+	return XMVectorAndInt(mask, XMVectorAndInt(XMVectorGreaterOrEqual(t, rays.TMin), XMVectorLessOrEqual(t, t_max)));
+}
+
+/**
+* Mask of the four children of a group that a ray of a packet may hit. Per axis, the distances to the near and far
+* planes of every ray lie between the ones of the corners of the bounds of the origins and inverse directions.
+*/
+static XMVECTOR XM_CALLCONV TestFrustum(const PacketFrustum& frustum, const WideBvh::NodeGroup& group)
+{
+	const float* bounds_min[3] = { group.BoundsMinX, group.BoundsMinY, group.BoundsMinZ };
+	const float* bounds_max[3] = { group.BoundsMaxX, group.BoundsMaxY, group.BoundsMaxZ };
+
+	XMVECTOR t_entry = frustum.TMin;
+	XMVECTOR t_exit = frustum.TMax;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const XMVECTOR near_plane = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(frustum.Positive[axis] ? bounds_min[axis] : bounds_max[axis]));
+		const XMVECTOR far_plane = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(frustum.Positive[axis] ? bounds_max[axis] : bounds_min[axis]));
+
+		const XMVECTOR near_min_origin = near_plane - frustum.OriginMin[axis];
+		const XMVECTOR near_max_origin = near_plane - frustum.OriginMax[axis];
+		const XMVECTOR far_min_origin = far_plane - frustum.OriginMin[axis];
+		const XMVECTOR far_max_origin = far_plane - frustum.OriginMax[axis];
+
+		t_entry = XMVectorMax(t_entry, XMVectorMin(
+			XMVectorMin(near_min_origin * frustum.InverseDirectionMin[axis], near_min_origin * frustum.InverseDirectionMax[axis]),
+			XMVectorMin(near_max_origin * frustum.InverseDirectionMin[axis], near_max_origin * frustum.InverseDirectionMax[axis])));
+		t_exit = XMVectorMin(t_exit, XMVectorMax(
+			XMVectorMax(far_min_origin * frustum.InverseDirectionMin[axis], far_min_origin * frustum.InverseDirectionMax[axis]),
+			XMVectorMax(far_max_origin * frustum.InverseDirectionMin[axis], far_max_origin * frustum.InverseDirectionMax[axis])));
+	}
+
+	return XMVectorLessOrEqual(t_entry, t_exit);
+}
+
+void WideBvh::Build(const Bvh& bvh, uint32_t width)
+{
+	if (width != 4 && width != 8)
+	{
+		throw std::invalid_argument("Wide BVH nodes have 4 or 8 children.");
+	}
+
+	Clear();
+
+	width_ = width;
+	positions_ = bvh.GetPositions();
+	triangle_indices_ = bvh.GetTriangleIndices();
+
+	const std::vector<Bvh::Node>& nodes = bvh.GetNodes();
+	if (nodes.empty())
+		return;
+
+	const uint32_t groups_per_node = width_ / 4;
+
+	auto add_node = [this, groups_per_node]()
+	{
+		const uint32_t node_index = static_cast<uint32_t>(groups_.size() / groups_per_node);
+
+		groups_.resize(groups_.size() + groups_per_node);
+		for (uint32_t i = node_index * groups_per_node; i < groups_.size(); i++)
+		{
+			groups_[i] = {};
+			std::fill(std::begin(groups_[i].Children), std::end(groups_[i].Children), no_child_);
+		}
+
+		return node_index;
+	};
+
+	// Pairs of a binary inner node and the wide node it becomes.
+	std::vector<std::pair<uint32_t, uint32_t>> stack;
+
+	const uint32_t root = add_node();
+	if (nodes[0].NumTriangles > 0)
+	{
+		// A single leaf, the root holds it as its only child.
+		NodeGroup& group = groups_[0];
+		group.BoundsMinX[0]		= nodes[0].BoundsMin.x;
+		group.BoundsMinY[0]		= nodes[0].BoundsMin.y;
+		group.BoundsMinZ[0]		= nodes[0].BoundsMin.z;
+		group.BoundsMaxX[0]		= nodes[0].BoundsMax.x;
+		group.BoundsMaxY[0]		= nodes[0].BoundsMax.y;
+		group.BoundsMaxZ[0]		= nodes[0].BoundsMax.z;
+		group.Children[0]		= nodes[0].FirstChildOrTriangle;
+		group.NumTriangles[0]	= nodes[0].NumTriangles;
+		return;
+	}
+
+	stack.push_back({ 0, root });
+
+	while (!stack.empty())
+	{
+		const uint32_t binary_node = stack.back().first;
+		const uint32_t wide_node = stack.back().second;
+		stack.pop_back();
+
+		// Open the inner child with the largest area until the node is full.
+		uint32_t children[max_width_] = { nodes[binary_node].FirstChildOrTriangle, nodes[binary_node].FirstChildOrTriangle + 1 };
+		uint32_t num_children = 2;
+
+		while (num_children < width_)
+		{
+			int largest = -1;
+			float largest_area = -1.0f;
+
+			for (uint32_t i = 0; i < num_children; i++)
+			{
+				const Bvh::Node& child = nodes[children[i]];
+				if (child.NumTriangles == 0 && GetHalfArea(child) > largest_area)
+				{
+					largest = static_cast<int>(i);
+					largest_area = GetHalfArea(child);
+				}
+			}
+
+			if (largest < 0)
+				break;
+
+			const uint32_t first_grandchild = nodes[children[largest]].FirstChildOrTriangle;
+			children[largest] = first_grandchild;
+			children[num_children++] = first_grandchild + 1;
+		}
+
+		for (uint32_t i = 0; i < num_children; i++)
+		{
+			const Bvh::Node& child = nodes[children[i]];
+
+			// Wide nodes added below move the groups, look the group up for every child.
+			const uint32_t child_node = child.NumTriangles > 0 ? child.FirstChildOrTriangle : add_node();
+
+			NodeGroup& group = groups_[wide_node * groups_per_node + i / 4];
+			const uint32_t lane = i % 4;
+
+			group.BoundsMinX[lane]		= child.BoundsMin.x;
+			group.BoundsMinY[lane]		= child.BoundsMin.y;
+			group.BoundsMinZ[lane]		= child.BoundsMin.z;
+			group.BoundsMaxX[lane]		= child.BoundsMax.x;
+			group.BoundsMaxY[lane]		= child.BoundsMax.y;
+			group.BoundsMaxZ[lane]		= child.BoundsMax.z;
+			group.Children[lane]		= child_node;
+			group.NumTriangles[lane]	= child.NumTriangles;
+
+			if (child.NumTriangles == 0)
+			{
+				stack.push_back({ children[i], child_node });
+			}
+		}
+	}
+}
+
+void WideBvh::Clear()
+{
+	groups_.clear();
+	positions_.clear();
+	triangle_indices_.clear();
+}
+
+bool WideBvh::Intersect(const Bvh::Ray& ray, Bvh::Hit& hit, bool cull_back_faces) const
+{
+	return Traverse<false>(ray, hit, cull_back_faces);
+}
+
+bool WideBvh::Occluded(const Bvh::Ray& ray) const
+{
+	Bvh::Hit hit;
+	return Traverse<true>(ray, hit, false);
+}
+
+void WideBvh::Intersect(const Bvh::Ray* rays, size_t count, Bvh::Hit* hits, QueryMode mode, bool cull_back_faces) const
+{
+	Trace<false>(rays, count, hits, mode, cull_back_faces);
+}
+
+void WideBvh::Occluded(const Bvh::Ray* rays, size_t count, uint8_t* occluded, QueryMode mode) const
+{
+	Bvh::Hit hits[stream_size_];
+
+	for (size_t first = 0; first < count; first += stream_size_)
+	{
+		const size_t batch = std::min<size_t>(count - first, stream_size_);
+
+		Trace<true>(rays + first, batch, hits, mode, false);
+
+		for (size_t i = 0; i < batch; i++)
+		{
+			occluded[first + i] = hits[i].Triangle != Bvh::no_hit_ ? 1 : 0;
+		}
+	}
+}
+
+template <bool any_hit>
+bool WideBvh::Traverse(const Bvh::Ray& ray, Bvh::Hit& hit, bool cull_back_faces) const
+{
+	hit.Triangle = Bvh::no_hit_;
+
+	if (groups_.empty())
+		return false;
+
+	const XMVECTOR origin_x = XMVectorReplicate(ray.Origin.x);
+	const XMVECTOR origin_y = XMVectorReplicate(ray.Origin.y);
+	const XMVECTOR origin_z = XMVectorReplicate(ray.Origin.z);
+	const XMVECTOR inverse_direction_x = XMVectorReplicate(1.0f / ray.Direction.x);
+	const XMVECTOR inverse_direction_y = XMVectorReplicate(1.0f / ray.Direction.y);
+	const XMVECTOR inverse_direction_z = XMVectorReplicate(1.0f / ray.Direction.z);
+	const XMVECTOR t_min = XMVectorReplicate(ray.TMin);
+	const XMVECTOR no_child = XMVectorReplicateInt(no_child_);
+
+	const uint32_t groups_per_node = width_ / 4;
+	float t_max = ray.TMax;
+
+	struct Entry
+	{
+		uint32_t	Child;
+		uint32_t	NumTriangles;
+		float		TEntry;
+	};
+
+	// Every level of the binary hierarchy adds at most width - 1 entries.
+	Entry stack[Bvh::max_depth_ * (max_width_ - 1) + 1];
+	uint32_t stack_size = 0;
+
+	stack[stack_size++] = { 0, 0, ray.TMin };
+
+	while (stack_size > 0)
+	{
+		const Entry entry = stack[--stack_size];
+
+		// A closer hit was found after the child was pushed.
+		if (entry.TEntry > t_max)
+			continue;
+
+		if (entry.NumTriangles > 0)
+		{
+			for (uint32_t i = entry.Child; i < entry.Child + entry.NumTriangles; i++)
+			{
+				float t, u, v;
+				if (!Bvh::IntersectTriangle(&positions_[i * 3], ray, cull_back_faces, t_max, t, u, v))
+					continue;
+
+				hit.T			= t;
+				hit.U			= u;
+				hit.V			= v;
+				hit.Triangle	= triangle_indices_[i];
+
+				if (any_hit)
+					return true;
+
+				t_max = t;
+			}
+
+			continue;
+		}
+
+		// Slab test of four children at a time.
+		const XMVECTOR t_max_vector = XMVectorReplicate(t_max);
+
+		Entry hits[max_width_];
+		uint32_t num_hits = 0;
+
+		for (uint32_t g = 0; g < groups_per_node; g++)
+		{
+			const NodeGroup& group = groups_[entry.Child * groups_per_node + g];
+
+			const XMVECTOR tx0 = (XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMinX)) - origin_x) * inverse_direction_x;
+			const XMVECTOR tx1 = (XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMaxX)) - origin_x) * inverse_direction_x;
+			const XMVECTOR ty0 = (XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMinY)) - origin_y) * inverse_direction_y;
+			const XMVECTOR ty1 = (XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMaxY)) - origin_y) * inverse_direction_y;
+			const XMVECTOR tz0 = (XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMinZ)) - origin_z) * inverse_direction_z;
+			const XMVECTOR tz1 = (XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMaxZ)) - origin_z) * inverse_direction_z;
+
+			const XMVECTOR t_entry = XMVectorMax(XMVectorMax(XMVectorMin(tx0, tx1), XMVectorMin(ty0, ty1)), XMVectorMax(XMVectorMin(tz0, tz1), t_min));
+			const XMVECTOR t_exit = XMVectorMin(XMVectorMin(XMVectorMax(tx0, tx1), XMVectorMax(ty0, ty1)), XMVectorMin(XMVectorMax(tz0, tz1), t_max_vector));
+
+			const XMVECTOR children = XMLoadUInt4(reinterpret_cast<const XMUINT4*>(group.Children));
+			const XMVECTOR mask = XMVectorAndCInt(XMVectorLessOrEqual(t_entry, t_exit), XMVectorEqualInt(children, no_child));
+
+			XMUINT4 lanes;
+			XMStoreUInt4(&lanes, mask);
+
+			if ((lanes.x | lanes.y | lanes.z | lanes.w) == 0)
+				continue;
+
+			XMFLOAT4A t_entries;
+			XMStoreFloat4A(&t_entries, t_entry);
+
+			const uint32_t* lane_masks = &lanes.x;
+			const float* lane_entries = &t_entries.x;
+
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				if (lane_masks[lane])
+				{
+					hits[num_hits++] = { group.Children[lane], group.NumTriangles[lane], lane_entries[lane] };
+				}
+			}
+		}
+
+		// Farthest first, so the nearest child is on top of the stack.
+		for (uint32_t i = 1; i < num_hits; i++)
+		{
+			const Entry child = hits[i];
+
+			uint32_t j = i;
+			for (; j > 0 && hits[j - 1].TEntry < child.TEntry; j--)
+			{
+				hits[j] = hits[j - 1];
+			}
+
+			hits[j] = child;
+		}
+
+		for (uint32_t i = 0; i < num_hits; i++)
+		{
+			stack[stack_size++] = hits[i];
+		}
+	}
+
+	return hit.Triangle != Bvh::no_hit_;
+}
+
+template <bool any_hit>
+void WideBvh::Trace(const Bvh::Ray* rays, size_t count, Bvh::Hit* hits, QueryMode mode, bool cull_back_faces) const
+{
+	switch (mode)
+	{
+	case QueryMode::Single:
+		for (size_t i = 0; i < count; i++)
+		{
+			Traverse<any_hit>(rays[i], hits[i], cull_back_faces);
+		}
+		break;
+
+	case QueryMode::Packet8:
+		for (size_t first = 0; first < count; first += 8)
+		{
+			TracePacket<any_hit, 8>(rays + first, static_cast<uint32_t>(std::min<size_t>(count - first, 8)), hits + first, cull_back_faces);
+		}
+		break;
+
+	case QueryMode::Packet16:
+		for (size_t first = 0; first < count; first += 16)
+		{
+			TracePacket<any_hit, 16>(rays + first, static_cast<uint32_t>(std::min<size_t>(count - first, 16)), hits + first, cull_back_faces);
+		}
+		break;
+
+	case QueryMode::Stream:
+		for (size_t first = 0; first < count; first += stream_size_)
+		{
+			TraceStream<any_hit>(rays + first, static_cast<uint32_t>(std::min<size_t>(count - first, stream_size_)), hits + first, cull_back_faces);
+		}
+		break;
+	}
+}
+
+template <bool any_hit, uint32_t packet_size>
+void WideBvh::TracePacket(const Bvh::Ray* rays, uint32_t count, Bvh::Hit* hits, bool cull_back_faces) const
+{
+	static const uint32_t num_vectors = packet_size / 4;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		hits[i].Triangle = Bvh::no_hit_;
+	}
+
+	if (groups_.empty() || count == 0)
+		return;
+
+	// Components of the rays by lane, the lanes past count repeat the last ray and are never active.
+	alignas(16) float components[8][packet_size];
+	for (uint32_t i = 0; i < packet_size; i++)
+	{
+		const Bvh::Ray& ray = rays[std::min(i, count - 1)];
+
+		components[0][i] = ray.Origin.x;
+		components[1][i] = ray.Origin.y;
+		components[2][i] = ray.Origin.z;
+		components[3][i] = ray.Direction.x;
+		components[4][i] = ray.Direction.y;
+		components[5][i] = ray.Direction.z;
+		components[6][i] = ray.TMin;
+		components[7][i] = ray.TMax;
+	}
+
+	RayLanes lanes[num_vectors];
+	XMVECTOR t_max[num_vectors];
+	XMVECTOR u[num_vectors];
+	XMVECTOR v[num_vectors];
+	XMVECTOR triangles[num_vectors];
+
+	for (uint32_t j = 0; j < num_vectors; j++)
+	{
+		auto load = [&](int component) { return XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(&components[component][j * 4])); };
+
+		lanes[j].OriginX			= load(0);
+		lanes[j].OriginY			= load(1);
+		lanes[j].OriginZ			= load(2);
+		lanes[j].DirectionX			= load(3);
+		lanes[j].DirectionY			= load(4);
+		lanes[j].DirectionZ			= load(5);
+		lanes[j].InverseDirectionX	= XMVectorReciprocal(lanes[j].DirectionX);
+		lanes[j].InverseDirectionY	= XMVectorReciprocal(lanes[j].DirectionY);
+		lanes[j].InverseDirectionZ	= XMVectorReciprocal(lanes[j].DirectionZ);
+		lanes[j].TMin				= load(6);
+
+		t_max[j]		= load(7);
+		u[j]			= XMVectorZero();
+		v[j]			= XMVectorZero();
+		triangles[j]	= XMVectorReplicateInt(Bvh::no_hit_);
+	}
+
+	// The frustum needs finite inverse directions of the same sign on every axis.
+	PacketFrustum frustum;
+	bool has_frustum = true;
+
+	float packet_t_min = rays[0].TMin;
+	float packet_t_max = rays[0].TMax;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float inverse_direction = 1.0f / (&rays[0].Direction.x)[axis];
+
+		float origin_min = (&rays[0].Origin.x)[axis];
+		float origin_max = origin_min;
+		float inverse_direction_min = inverse_direction;
+		float inverse_direction_max = inverse_direction;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const float origin = (&rays[i].Origin.x)[axis];
+			const float ray_inverse_direction = 1.0f / (&rays[i].Direction.x)[axis];
+
+			has_frustum = has_frustum && std::isfinite(ray_inverse_direction) && (ray_inverse_direction > 0.0f) == (inverse_direction > 0.0f);
+
+			origin_min				= std::min(origin_min, origin);
+			origin_max				= std::max(origin_max, origin);
+			inverse_direction_min	= std::min(inverse_direction_min, ray_inverse_direction);
+			inverse_direction_max	= std::max(inverse_direction_max, ray_inverse_direction);
+		}
+
+		frustum.OriginMin[axis]				= XMVectorReplicate(origin_min);
+		frustum.OriginMax[axis]				= XMVectorReplicate(origin_max);
+		frustum.InverseDirectionMin[axis]	= XMVectorReplicate(inverse_direction_min);
+		frustum.InverseDirectionMax[axis]	= XMVectorReplicate(inverse_direction_max);
+		frustum.Positive[axis]				= inverse_direction > 0.0f;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		packet_t_min = std::min(packet_t_min, rays[i].TMin);
+		packet_t_max = std::max(packet_t_max, rays[i].TMax);
+	}
+
+	frustum.TMin = XMVectorReplicate(packet_t_min);
+	frustum.TMax = XMVectorReplicate(packet_t_max);
+
+	const XMVECTOR no_child = XMVectorReplicateInt(no_child_);
+	const XMVECTOR infinity = XMVectorSplatInfinity();
+	const uint32_t groups_per_node = width_ / 4;
+
+	// Rays without a hit, only any_hit retires rays.
+	uint32_t active = (1u << count) - 1;
+
+	struct Entry
+	{
+		uint32_t	Child;
+		uint32_t	NumTriangles;
+		// Closest entry distance of the rays.
+		float		TEntry;
+		// One bit per ray that hits the box.
+		uint32_t	Rays;
+	};
+
+	Entry stack[Bvh::max_depth_ * (max_width_ - 1) + 1];
+	uint32_t stack_size = 0;
+
+	stack[stack_size++] = { 0, 0, packet_t_min, active };
+
+	while (stack_size > 0)
+	{
+		Entry entry = stack[--stack_size];
+
+		if (any_hit)
+		{
+			entry.Rays &= active;
+			if (entry.Rays == 0)
+				continue;
+		}
+
+		// Closer hits were found for every ray after the child was pushed.
+		if (entry.TEntry > packet_t_max)
+			continue;
+
+		if (entry.NumTriangles > 0)
+		{
+			for (uint32_t i = entry.Child; i < entry.Child + entry.NumTriangles; i++)
+			{
+				const XMVECTOR triangle = XMVectorReplicateInt(triangle_indices_[i]);
+
+				for (uint32_t j = 0; j < num_vectors; j++)
+				{
+					const uint32_t vector_rays = (entry.Rays >> (j * 4)) & 0xf;
+					if (vector_rays == 0)
+						continue;
+
+					XMVECTOR t, hit_u, hit_v;
+					const XMVECTOR hit = XMVectorAndInt(IntersectTriangle4(&positions_[i * 3], lanes[j], t_max[j], cull_back_faces, t, hit_u, hit_v), GetLaneMask(vector_rays));
+
+					const uint32_t hit_rays = GetLaneBits(hit);
+					if (hit_rays == 0)
+						continue;
+
+					t_max[j]		= XMVectorSelect(t_max[j], t, hit);
+					u[j]			= XMVectorSelect(u[j], hit_u, hit);
+					v[j]			= XMVectorSelect(v[j], hit_v, hit);
+					triangles[j]	= XMVectorSelect(triangles[j], triangle, hit);
+
+					if (any_hit)
+					{
+						active &= ~(hit_rays << (j * 4));
+						entry.Rays &= ~(hit_rays << (j * 4));
+					}
+				}
+
+				if (any_hit && entry.Rays == 0)
+					break;
+			}
+
+			if (any_hit && active == 0)
+				break;
+
+			if (!any_hit)
+			{
+				XMVECTOR farthest = t_max[0];
+				for (uint32_t j = 1; j < num_vectors; j++)
+				{
+					farthest = XMVectorMax(farthest, t_max[j]);
+				}
+
+				packet_t_max = GetMaxComponent(farthest);
+			}
+
+			continue;
+		}
+
+		Entry hits_of_children[max_width_];
+		uint32_t num_hits = 0;
+
+		for (uint32_t g = 0; g < groups_per_node; g++)
+		{
+			const NodeGroup& group = groups_[entry.Child * groups_per_node + g];
+
+			const XMVECTOR children = XMLoadUInt4(reinterpret_cast<const XMUINT4*>(group.Children));
+			XMVECTOR candidates = XMVectorAndCInt(XMVectorTrueInt(), XMVectorEqualInt(children, no_child));
+
+			if (has_frustum)
+			{
+				candidates = XMVectorAndInt(candidates, TestFrustum(frustum, group));
+			}
+
+			const uint32_t candidate_lanes = GetLaneBits(candidates);
+
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				if (!(candidate_lanes & (1u << lane)))
+					continue;
+
+				const XMVECTOR bounds_min_x = XMVectorReplicate(group.BoundsMinX[lane]);
+				const XMVECTOR bounds_min_y = XMVectorReplicate(group.BoundsMinY[lane]);
+				const XMVECTOR bounds_min_z = XMVectorReplicate(group.BoundsMinZ[lane]);
+				const XMVECTOR bounds_max_x = XMVectorReplicate(group.BoundsMaxX[lane]);
+				const XMVECTOR bounds_max_y = XMVectorReplicate(group.BoundsMaxY[lane]);
+				const XMVECTOR bounds_max_z = XMVectorReplicate(group.BoundsMaxZ[lane]);
+
+				uint32_t child_rays = 0;
+				XMVECTOR child_entry = infinity;
+
+				// Slab test of the box against four rays at a time.
+				for (uint32_t j = 0; j < num_vectors; j++)
+				{
+					const uint32_t vector_rays = (entry.Rays >> (j * 4)) & 0xf;
+					if (vector_rays == 0)
+						continue;
+
+					const RayLanes& ray_lanes = lanes[j];
+
+					const XMVECTOR tx0 = (bounds_min_x - ray_lanes.OriginX) * ray_lanes.InverseDirectionX;
+					const XMVECTOR tx1 = (bounds_max_x - ray_lanes.OriginX) * ray_lanes.InverseDirectionX;
+					const XMVECTOR ty0 = (bounds_min_y - ray_lanes.OriginY) * ray_lanes.InverseDirectionY;
+					const XMVECTOR ty1 = (bounds_max_y - ray_lanes.OriginY) * ray_lanes.InverseDirectionY;
+					const XMVECTOR tz0 = (bounds_min_z - ray_lanes.OriginZ) * ray_lanes.InverseDirectionZ;
+					const XMVECTOR tz1 = (bounds_max_z - ray_lanes.OriginZ) * ray_lanes.InverseDirectionZ;
+
+					const XMVECTOR t_entry = XMVectorMax(XMVectorMax(XMVectorMin(tx0, tx1), XMVectorMin(ty0, ty1)), XMVectorMax(XMVectorMin(tz0, tz1), ray_lanes.TMin));
+					const XMVECTOR t_exit = XMVectorMin(XMVectorMin(XMVectorMax(tx0, tx1), XMVectorMax(ty0, ty1)), XMVectorMin(XMVectorMax(tz0, tz1), t_max[j]));
+
+					const uint32_t hit_rays = GetLaneBits(XMVectorLessOrEqual(t_entry, t_exit)) & vector_rays;
+					if (hit_rays == 0)
+						continue;
+
+					child_rays |= hit_rays << (j * 4);
+					child_entry = XMVectorMin(child_entry, XMVectorSelect(infinity, t_entry, GetLaneMask(hit_rays)));
+				}
+
+				if (child_rays != 0)
+				{
+					hits_of_children[num_hits++] = { group.Children[lane], group.NumTriangles[lane], GetMinComponent(child_entry), child_rays };
+				}
+			}
+		}
+
+		// Farthest first, so the nearest child is on top of the stack.
+		for (uint32_t i = 1; i < num_hits; i++)
+		{
+			const Entry child = hits_of_children[i];
+
+			uint32_t j = i;
+			for (; j > 0 && hits_of_children[j - 1].TEntry < child.TEntry; j--)
+			{
+				hits_of_children[j] = hits_of_children[j - 1];
+			}
+
+			hits_of_children[j] = child;
+		}
+
+		for (uint32_t i = 0; i < num_hits; i++)
+		{
+			stack[stack_size++] = hits_of_children[i];
+		}
+	}
+
+	alignas(16) float hit_t[packet_size];
+	alignas(16) float hit_u[packet_size];
+	alignas(16) float hit_v[packet_size];
+	alignas(16) uint32_t hit_triangles[packet_size];
+
+	for (uint32_t j = 0; j < num_vectors; j++)
+	{
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(&hit_t[j * 4]), t_max[j]);
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(&hit_u[j * 4]), u[j]);
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(&hit_v[j * 4]), v[j]);
+		XMStoreUInt4(reinterpret_cast<XMUINT4*>(&hit_triangles[j * 4]), triangles[j]);
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		hits[i].T			= hit_t[i];
+		hits[i].U			= hit_u[i];
+		hits[i].V			= hit_v[i];
+		hits[i].Triangle	= hit_triangles[i];
+	}
+}
+
+template <bool any_hit>
+void WideBvh::TraceStream(const Bvh::Ray* rays, uint32_t count, Bvh::Hit* hits, bool cull_back_faces) const
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		hits[i].Triangle = Bvh::no_hit_;
+	}
+
+	if (groups_.empty() || count == 0)
+		return;
+
+	XMFLOAT3 inverse_directions[stream_size_];
+	float t_max[stream_size_];
+	float stream_t_min = rays[0].TMin;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		inverse_directions[i]	= XMFLOAT3(1.0f / rays[i].Direction.x, 1.0f / rays[i].Direction.y, 1.0f / rays[i].Direction.z);
+		t_max[i]				= rays[i].TMax;
+		stream_t_min			= std::min(stream_t_min, rays[i].TMin);
+	}
+
+	const XMVECTOR no_child = XMVectorReplicateInt(no_child_);
+	const uint32_t groups_per_node = width_ / 4;
+
+	struct Entry
+	{
+		uint32_t	Child;
+		uint32_t	NumTriangles;
+		// Closest entry distance of the rays.
+		float		TEntry;
+		// Range of the rays that hit the box in ray_lists.
+		uint32_t	FirstRay;
+		uint32_t	NumRays;
+	};
+
+	// The rays of the entries on the stack, in the order they were pushed, so an entry is the last one in the list when
+	// it is popped.
+	std::vector<uint32_t> ray_lists(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		ray_lists[i] = i;
+	}
+
+	Entry stack[Bvh::max_depth_ * (max_width_ - 1) + 1];
+	uint32_t stack_size = 0;
+
+	stack[stack_size++] = { 0, 0, stream_t_min, 0, count };
+
+	while (stack_size > 0)
+	{
+		const Entry entry = stack[--stack_size];
+		const uint32_t list_end = entry.FirstRay + entry.NumRays;
+
+		if (entry.NumTriangles > 0)
+		{
+			for (uint32_t k = entry.FirstRay; k < list_end; k++)
+			{
+				const uint32_t r = ray_lists[k];
+				if (any_hit && hits[r].Triangle != Bvh::no_hit_)
+					continue;
+
+				for (uint32_t i = entry.Child; i < entry.Child + entry.NumTriangles; i++)
+				{
+					float t, u, v;
+					if (!Bvh::IntersectTriangle(&positions_[i * 3], rays[r], cull_back_faces, t_max[r], t, u, v))
+						continue;
+
+					hits[r].T			= t;
+					hits[r].U			= u;
+					hits[r].V			= v;
+					hits[r].Triangle	= triangle_indices_[i];
+
+					if (any_hit)
+						break;
+
+					t_max[r] = t;
+				}
+			}
+
+			continue;
+		}
+
+		// Boxes of the children, loaded once for all rays.
+		XMVECTOR bounds[max_width_ / 4][6];
+		XMVECTOR empty[max_width_ / 4];
+
+		for (uint32_t g = 0; g < groups_per_node; g++)
+		{
+			const NodeGroup& group = groups_[entry.Child * groups_per_node + g];
+
+			bounds[g][0] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMinX));
+			bounds[g][1] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMaxX));
+			bounds[g][2] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMinY));
+			bounds[g][3] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMaxY));
+			bounds[g][4] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMinZ));
+			bounds[g][5] = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(group.BoundsMaxZ));
+			empty[g] = XMVectorEqualInt(XMLoadUInt4(reinterpret_cast<const XMUINT4*>(group.Children)), no_child);
+		}
+
+		// Children hit by every ray, one bit per child.
+		uint8_t masks[stream_size_];
+		uint32_t child_counts[max_width_] = {};
+		float child_entries[max_width_];
+		std::fill(std::begin(child_entries), std::end(child_entries), FLT_MAX);
+
+		for (uint32_t k = 0; k < entry.NumRays; k++)
+		{
+			const uint32_t r = ray_lists[entry.FirstRay + k];
+			masks[k] = 0;
+
+			if (any_hit && hits[r].Triangle != Bvh::no_hit_)
+				continue;
+
+			const XMVECTOR origin_x = XMVectorReplicate(rays[r].Origin.x);
+			const XMVECTOR origin_y = XMVectorReplicate(rays[r].Origin.y);
+			const XMVECTOR origin_z = XMVectorReplicate(rays[r].Origin.z);
+			const XMVECTOR inverse_direction_x = XMVectorReplicate(inverse_directions[r].x);
+			const XMVECTOR inverse_direction_y = XMVectorReplicate(inverse_directions[r].y);
+			const XMVECTOR inverse_direction_z = XMVectorReplicate(inverse_directions[r].z);
+			const XMVECTOR t_min_vector = XMVectorReplicate(rays[r].TMin);
+			const XMVECTOR t_max_vector = XMVectorReplicate(t_max[r]);
+
+			for (uint32_t g = 0; g < groups_per_node; g++)
+			{
+				const XMVECTOR tx0 = (bounds[g][0] - origin_x) * inverse_direction_x;
+				const XMVECTOR tx1 = (bounds[g][1] - origin_x) * inverse_direction_x;
+				const XMVECTOR ty0 = (bounds[g][2] - origin_y) * inverse_direction_y;
+				const XMVECTOR ty1 = (bounds[g][3] - origin_y) * inverse_direction_y;
+				const XMVECTOR tz0 = (bounds[g][4] - origin_z) * inverse_direction_z;
+				const XMVECTOR tz1 = (bounds[g][5] - origin_z) * inverse_direction_z;
+
+				const XMVECTOR t_entry = XMVectorMax(XMVectorMax(XMVectorMin(tx0, tx1), XMVectorMin(ty0, ty1)), XMVectorMax(XMVectorMin(tz0, tz1), t_min_vector));
+				const XMVECTOR t_exit = XMVectorMin(XMVectorMin(XMVectorMax(tx0, tx1), XMVectorMax(ty0, ty1)), XMVectorMin(XMVectorMax(tz0, tz1), t_max_vector));
+
+				const uint32_t hit_lanes = GetLaneBits(XMVectorAndCInt(XMVectorLessOrEqual(t_entry, t_exit), empty[g]));
+				if (hit_lanes == 0)
+					continue;
+
+				masks[k] |= static_cast<uint8_t>(hit_lanes << (g * 4));
+
+				XMFLOAT4A t_entries;
+				XMStoreFloat4A(&t_entries, t_entry);
+
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					if (hit_lanes & (1u << lane))
+					{
+						child_counts[g * 4 + lane]++;
+						child_entries[g * 4 + lane] = std::min(child_entries[g * 4 + lane], (&t_entries.x)[lane]);
+					}
+				}
+			}
+		}
+
+		// Children with rays, farthest first so the nearest child is on top of the stack.
+		uint32_t slots[max_width_];
+		uint32_t num_slots = 0;
+
+		for (uint32_t slot = 0; slot < width_; slot++)
+		{
+			if (child_counts[slot] == 0)
+				continue;
+
+			uint32_t j = num_slots++;
+			for (; j > 0 && child_entries[slots[j - 1]] < child_entries[slot]; j--)
+			{
+				slots[j] = slots[j - 1];
+			}
+
+			slots[j] = slot;
+		}
+
+		if (num_slots == 0)
+			continue;
+
+		// The lists of the children follow the list of the node, in the order the children are pushed.
+		uint32_t cursors[max_width_];
+		uint32_t next_ray = list_end;
+
+		for (uint32_t i = 0; i < num_slots; i++)
+		{
+			const uint32_t slot = slots[i];
+			const NodeGroup& group = groups_[entry.Child * groups_per_node + slot / 4];
+
+			stack[stack_size++] = { group.Children[slot % 4], group.NumTriangles[slot % 4], child_entries[slot], next_ray, child_counts[slot] };
+
+			cursors[slot] = next_ray;
+			next_ray += child_counts[slot];
+		}
+
+		if (ray_lists.size() < next_ray)
+		{
+			ray_lists.resize(next_ray);
+		}
+
+		for (uint32_t k = 0; k < entry.NumRays; k++)
+		{
+			const uint32_t r = ray_lists[entry.FirstRay + k];
+
+			for (uint32_t slot = 0; slot < width_; slot++)
+			{
+				if (masks[k] & (1u << slot))
+				{
+					ray_lists[cursors[slot]++] = r;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#include "neel_engine_pch.h"
+
+#include "memory_mapped_file.h"
+
+MemoryMappedFile::MemoryMappedFile()
+	: file_(INVALID_HANDLE_VALUE)
+	, mapping_(nullptr)
+	, data_(nullptr)
+	, size_(0)
+{
+}
+
+MemoryMappedFile::MemoryMappedFile(const std::string& filename)
+	: MemoryMappedFile()
+{
+	Open(filename);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	Close();
+}
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other) noexcept
+	: file_(other.file_)
+	, mapping_(other.mapping_)
+	, data_(other.data_)
+	, size_(other.size_)
+{
+	other.file_		= INVALID_HANDLE_VALUE;
+	other.mapping_	= nullptr;
+	other.data_		= nullptr;
+	other.size_		= 0;
+}
+
+MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+
+		file_		= other.file_;
+		mapping_	= other.mapping_;
+		data_		= other.data_;
+		size_		= other.size_;
+
+		other.file_		= INVALID_HANDLE_VALUE;
+		other.mapping_	= nullptr;
+		other.data_		= nullptr;
+		other.size_		= 0;
+	}
+
+	return *this;
+}
+
+void MemoryMappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	const std::wstring wfilename = utf8_to_utf16(filename);
+
+	file_ = CreateFileW(wfilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open file for memory mapping: " + filename);
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0)
+	{
+		Close();
+		throw std::runtime_error("Cannot memory map an empty file: " + filename);
+	}
+
+	mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping_)
+	{
+		Close();
+		throw std::runtime_error("Failed to create file mapping: " + filename);
+	}
+
+	data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (!data_)
+	{
+		Close();
+		throw std::runtime_error("Failed to map view of file: " + filename);
+	}
+
+	size_ = static_cast<size_t>(file_size.QuadPart);
+}
+
+void MemoryMappedFile::Close()
+{
+	if (data_)
+	{
+		UnmapViewOfFile(data_);
+		data_ = nullptr;
+	}
+
+	if (mapping_)
+	{
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+	}
+
+	if (file_ != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+
+	size_ = 0;
+}
@@ -0,0 +1,150 @@
+#include "neel_engine_pch.h"
+
+#include "thread_pool.h"
+
+#include <objbase.h>
+
+ThreadPool::ThreadPool(uint32_t num_threads)
+	: stop_(false)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	threads_.reserve(num_threads);
+	for (uint32_t i = 0; i < num_threads; i++)
+	{
+		threads_.emplace_back(&ThreadPool::WorkerThread, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	condition_.notify_all();
+
+	for (auto& thread : threads_)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+}
+
+void ThreadPool::WorkerThread()
+{
+	// WIC decoders require COM to be initialized on the calling thread.
+	const HRESULT com_result = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+
+			if (stop_ && tasks_.empty())
+				break;
+
+			task = std::move(tasks_.front());
+			tasks_.pop();
+		}
+
+		task();
+	}
+
+	if (SUCCEEDED(com_result))
+	{
+		CoUninitialize();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& function)
+{
+	ParallelForRange(count, 1, [&function](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			function(i);
+		}
+	});
+}
+
+void ThreadPool::ParallelForRange(size_t count, size_t grain_size, const std::function<void(size_t, size_t)>& function)
+{
+	if (count == 0)
+		return;
+
+	grain_size = std::max<size_t>(1, grain_size);
+	const size_t num_ranges = (count + grain_size - 1) / grain_size;
+
+	// Shared between the calling thread and the helper tasks. Helper tasks may
+	// still be queued after the last range finished, so the state must outlive this call.
+	struct ParallelState
+	{
+		std::atomic<size_t>		NextRange{ 0 };
+		std::atomic<size_t>		FinishedRanges{ 0 };
+		std::exception_ptr		Exception;
+		std::mutex				Mutex;
+		std::condition_variable Done;
+	};
+
+	auto state = std::make_shared<ParallelState>();
+
+	// The function is only referenced while ranges are still being handed out,
+	// which is never the case after the calling thread returns.
+	auto run = [state, &function, count, grain_size, num_ranges]()
+	{
+		size_t range;
+		while ((range = state->NextRange.fetch_add(1)) < num_ranges)
+		{
+			const size_t begin = range * grain_size;
+			const size_t end = std::min(count, begin + grain_size);
+
+			try
+			{
+				function(begin, end);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(state->Mutex);
+				if (!state->Exception)
+					state->Exception = std::current_exception();
+			}
+
+			if (state->FinishedRanges.fetch_add(1) + 1 == num_ranges)
+			{
+				std::lock_guard<std::mutex> lock(state->Mutex);
+				state->Done.notify_all();
+			}
+		}
+	};
+
+	const size_t num_helpers = std::min<size_t>(threads_.size(), num_ranges - 1);
+	if (num_helpers > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t i = 0; i < num_helpers; i++)
+			{
+				tasks_.emplace(run);
+			}
+		}
+		condition_.notify_all();
+	}
+
+	run();
+
+	{
+		std::unique_lock<std::mutex> lock(state->Mutex);
+		state->Done.wait(lock, [&state, num_ranges]() { return state->FinishedRanges.load() == num_ranges; });
+	}
+
+	if (state->Exception)
+	{
+		std::rethrow_exception(state->Exception);
+	}
+}
@@ -1,8 +1,11 @@
 #include "neel_engine_pch.h"
 
 #include "commandlist.h"
+#include "commandlist_state_cache.h"
 #include "commandqueue.h"
 #include "generate_mips_pso.h"
+#include "geometry_layout.h"
+#include "image_decoder.h"
 
 #include "neel_engine.h"
 #include "dynamic_descriptor_heap.h"
@@ -31,6 +34,8 @@ CommandList::CommandList(D3D12_COMMAND_LIST_TYPE type)
 
 	resource_state_tracker_ = std::make_unique<ResourceStateTracker>();
 
+	state_cache_ = std::make_unique<CommandListStateCache>();
+
 	for (int i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; ++i)
 	{
 		dynamic_descriptor_heap_[i] = std::make_unique<DynamicDescriptorHeap>(
@@ -201,6 +206,19 @@ void CommandList::CopyBufferRegion(Buffer& dst_buffer, UINT64 dst_offset, Buffer
 	TrackResource(dst_buffer);
 }
 
+void CommandList::CopyBufferRegion(Buffer& dst_buffer, UINT64 dst_offset, const void* buffer_data, UINT64 num_bytes)
+{
+	auto heap_allocation = upload_buffer_->Allocate(num_bytes, 4);
+	memcpy(heap_allocation.CPU, buffer_data, num_bytes);
+
+	TransitionBarrier(dst_buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+	FlushResourceBarriers();
+
+	d3d12_command_list_->CopyBufferRegion(dst_buffer.GetD3D12Resource().Get(), dst_offset, heap_allocation.Resource, heap_allocation.Offset, num_bytes);
+
+	TrackResource(dst_buffer);
+}
+
 
 void CommandList::CopyBuffer(Buffer& buffer, size_t num_elements, size_t element_size, const void* buffer_data,
                              D3D12_RESOURCE_FLAGS flags)
@@ -313,6 +331,112 @@ void CommandList::CopyBuffer(Buffer& buffer, size_t buffer_size, const void* buf
 	buffer.SetD3D12Resource(d3d12_resource);
 }
 
+void CommandList::CopyGeometry(const GeometryLayout& layout, uint32_t first_sub_mesh, Buffer& vertex_buffer, Buffer& index_buffer, D3D12_RESOURCE_FLAGS flags)
+{
+	if (layout.GetVertexBuffers().size() > 1 || layout.GetIndexBuffers().size() > 1)
+	{
+		throw std::exception("Appending geometry requires a layout with a single vertex and index buffer.");
+	}
+
+	if (first_sub_mesh >= layout.GetNumSubMeshes())
+		return;
+
+	const GeometryLayout::SubMesh& first = layout.GetSubMesh(first_sub_mesh);
+
+	// Appended range of each buffer.
+	const uint64_t vertex_begin	= first.VertexOffset;
+	const uint64_t vertex_end	= layout.GetVertexBuffers()[0].Size;
+	const uint64_t index_begin	= first.IndexOffset;
+	const uint64_t index_end	= layout.GetIndexBuffers()[0].Size;
+
+	const uint64_t index_staging_offset = math::AlignUp(vertex_end - vertex_begin, 16);
+	const uint64_t staging_size = index_staging_offset + (index_end - index_begin);
+	if (staging_size == 0)
+		return;
+
+	auto device = NeelEngine::Get().GetDevice();
+
+	ComPtr<ID3D12Resource> upload_resource;
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(staging_size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&upload_resource)));
+
+	uint8_t* upload_data = nullptr;
+	const CD3DX12_RANGE read_range(0, 0);
+	ThrowIfFailed(upload_resource->Map(0, &read_range, reinterpret_cast<void**>(&upload_data)));
+
+	layout.WriteStaging(first_sub_mesh, upload_data, upload_data + index_staging_offset);
+
+	upload_resource->Unmap(0, nullptr);
+
+	auto append = [&](Buffer& buffer, uint64_t begin, uint64_t end, uint64_t staging_offset)
+	{
+		if (end == begin)
+			return;
+
+		ComPtr<ID3D12Resource> d3d12_resource = buffer.GetD3D12Resource();
+
+		// Raw (ByteAddressBuffer) views and loads cover whole 32-bit elements.
+		const uint64_t buffer_size = math::AlignUp(end, 4);
+
+		if (!d3d12_resource || d3d12_resource->GetDesc().Width < buffer_size)
+		{
+			// Grow geometrically, so appending many small batches copies the existing data a logarithmic number of times.
+			const uint64_t grown_size = d3d12_resource ? std::max(buffer_size, 2 * d3d12_resource->GetDesc().Width) : buffer_size;
+
+			ComPtr<ID3D12Resource> grown_resource;
+			ThrowIfFailed(device->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(grown_size, flags),
+				D3D12_RESOURCE_STATE_COMMON,
+				nullptr,
+				IID_PPV_ARGS(&grown_resource)));
+
+			// Add the resource to the global resource State tracker.
+			ResourceStateTracker::AddGlobalResourceState(grown_resource.Get(), D3D12_RESOURCE_STATE_COMMON);
+
+			resource_state_tracker_->TransitionResource(grown_resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+
+			// Keep the data of the submeshes that were appended before.
+			const uint64_t keep_size = d3d12_resource ? std::min(begin, d3d12_resource->GetDesc().Width) : 0;
+			if (keep_size > 0)
+			{
+				resource_state_tracker_->TransitionResource(d3d12_resource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+				FlushResourceBarriers();
+
+				d3d12_command_list_->CopyBufferRegion(grown_resource.Get(), 0, d3d12_resource.Get(), 0, keep_size);
+
+				// The old resource has to stay alive until the copy has executed.
+				TrackResource(d3d12_resource);
+			}
+
+			TrackResource(grown_resource);
+
+			buffer.SetD3D12Resource(grown_resource);
+			d3d12_resource = grown_resource;
+		}
+		else
+		{
+			resource_state_tracker_->TransitionResource(d3d12_resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+		}
+
+		FlushResourceBarriers();
+
+		d3d12_command_list_->CopyBufferRegion(d3d12_resource.Get(), begin, upload_resource.Get(), staging_offset, end - begin);
+	};
+
+	append(vertex_buffer, vertex_begin, vertex_end, 0);
+	append(index_buffer, index_begin, index_end, index_staging_offset);
+
+	// Add references to resources so they stay in scope until the command list is reset.
+	TrackResource(upload_resource);
+}
+
 void CommandList::CopyShaderTable(ShaderTable& shader_table, UINT shader_record_size, const std::string& resource_name)
 {
 	auto device = NeelEngine::Get().GetDevice();
@@ -396,10 +520,21 @@ void CommandList::CopyStructuredBuffer(StructuredBuffer& structured_buffer, size
 
 void CommandList::SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY primitive_topology)
 {
-	d3d12_command_list_->IASetPrimitiveTopology(primitive_topology);
+	if (state_cache_->SetPrimitiveTopology(primitive_topology))
+	{
+		d3d12_command_list_->IASetPrimitiveTopology(primitive_topology);
+	}
 }
 
 void CommandList::LoadTextureFromFile(Texture& texture, const std::string& filename, TextureUsage texture_usage)
+{
+	ScratchImage scratch_image;
+	DecodeTextureFromFile(filename, scratch_image);
+
+	LoadTextureFromScratchImage(texture, scratch_image, filename, texture_usage);
+}
+
+void CommandList::DecodeTextureFromFile(const std::string& filename, ScratchImage& scratch_image)
 {
 	std::filesystem::path file_path(filename);
 	
@@ -410,120 +545,185 @@ void CommandList::LoadTextureFromFile(Texture& texture, const std::string& filen
 
 	const std::wstring wfilename = utf8_to_utf16(filename);
 
-		TexMetadata metadata;
-		ScratchImage scratch_image;
+	if (file_path.extension() == ".dds")
+	{
+		ThrowIfFailed(LoadFromDDSFile(
+			wfilename.c_str(),
+			DDS_FLAGS_FORCE_RGB,
+			nullptr,
+			scratch_image));
+	}
+	else if (file_path.extension() == ".hdr")
+	{
+		ThrowIfFailed(LoadFromHDRFile(
+			wfilename.c_str(),
+			nullptr,
+			scratch_image));
+	}
+	else if (file_path.extension() == ".tga")
+	{
+		ThrowIfFailed(LoadFromTGAFile(
+			wfilename.c_str(),
+			nullptr,
+			scratch_image));
+	}
+	else
+	{
+		ThrowIfFailed(LoadFromWICFile(
+			file_path.c_str(),
+			WIC_FLAGS_FORCE_RGB,
+			nullptr,
+			scratch_image));
+	}
+}
 
-		if (file_path.extension() == ".dds")
-		{
-			ThrowIfFailed(LoadFromDDSFile(
-				wfilename.c_str(),
-				DDS_FLAGS_FORCE_RGB,
-				&metadata,
-				scratch_image));
-		}
-		else if (file_path.extension() == ".hdr")
-		{
-			ThrowIfFailed(LoadFromHDRFile(
-				wfilename.c_str(),
-				&metadata,
-				scratch_image));
-		}
-		else if (file_path.extension() == ".tga")
-		{
-			ThrowIfFailed(LoadFromTGAFile(
-				wfilename.c_str(),
-				&metadata,
-				scratch_image));
-		}
-		else
-		{
-			ThrowIfFailed(LoadFromWICFile(
-				file_path.c_str(),
-				WIC_FLAGS_FORCE_RGB,
-				&metadata,
-				scratch_image));
-		}
+void CommandList::LoadTextureFromMemory(Texture& texture, const void* data, size_t size, const std::string& name, TextureUsage texture_usage)
+{
+	ScratchImage scratch_image;
+	DecodeTextureFromMemory(data, size, scratch_image);
 
-		// Force albedo textures to use sRGB
-		if (texture_usage == TextureUsage::Albedo)
-		{
-			metadata.format = MakeSRGB(metadata.format);
-		}
-		// We need high precision normals for raytracing.
-		else if(texture_usage == TextureUsage::Normalmap)
-		{
-			//metadata.format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
+	LoadTextureFromScratchImage(texture, scratch_image, name, texture_usage);
+}
+
+void CommandList::DecodeTextureFromMemory(const void* data, size_t size, ScratchImage& scratch_image)
+{
+	if (!data || size == 0)
+	{
+		throw std::exception("Empty image data.");
+	}
+
+	// PNG and JPEG decode without WIC, which leaves the variants the portable decoder does not handle.
+	ImageDecoder::Image image;
+	if (ImageDecoder::Decode(data, size, image))
+	{
+		ThrowIfFailed(scratch_image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, image.Width, image.Height, 1, 1));
+
+		const Image* destination = scratch_image.GetImage(0, 0, 0);
+		const size_t row_size = static_cast<size_t>(image.Width) * 4;
 
-		D3D12_RESOURCE_DESC texture_desc = {};
-		switch (metadata.dimension)
+		for (uint32_t y = 0; y < image.Height; y++)
 		{
-		case TEX_DIMENSION_TEXTURE1D:
-			texture_desc = CD3DX12_RESOURCE_DESC::Tex1D(
-				metadata.format,
-				static_cast<UINT64>(metadata.width),
-				static_cast<UINT16>(metadata.arraySize));
-			break;
-		case TEX_DIMENSION_TEXTURE2D:
-			texture_desc = CD3DX12_RESOURCE_DESC::Tex2D(
-				metadata.format,
-				static_cast<UINT64>(metadata.width),
-				static_cast<UINT>(metadata.height),
-				static_cast<UINT16>(metadata.arraySize));
-			break;
-		case TEX_DIMENSION_TEXTURE3D:
-			texture_desc = CD3DX12_RESOURCE_DESC::Tex3D(
-				metadata.format,
-				static_cast<UINT64>(metadata.width),
-				static_cast<UINT>(metadata.height),
-				static_cast<UINT16>(metadata.depth));
-			break;
-		default:
-			throw std::exception("Invalid texture dimension.");
-			break;
+			std::memcpy(destination->pixels + y * destination->rowPitch, &image.Pixels[y * row_size], row_size);
 		}
 
-		auto device = NeelEngine::Get().GetDevice();
-		Microsoft::WRL::ComPtr<ID3D12Resource> texture_resource;
+		return;
+	}
 
-		ThrowIfFailed(device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&texture_desc,
-			D3D12_RESOURCE_STATE_COMMON,
+	// There is no file extension, detect the container from its signature.
+	const char* signature = static_cast<const char*>(data);
+
+	if (size >= 4 && std::memcmp(signature, "DDS ", 4) == 0)
+	{
+		ThrowIfFailed(LoadFromDDSMemory(
+			data,
+			size,
+			DDS_FLAGS_FORCE_RGB,
+			nullptr,
+			scratch_image));
+	}
+	else if (size >= 2 && std::memcmp(signature, "#?", 2) == 0)
+	{
+		ThrowIfFailed(LoadFromHDRMemory(
+			data,
+			size,
+			nullptr,
+			scratch_image));
+	}
+	else
+	{
+		ThrowIfFailed(LoadFromWICMemory(
+			data,
+			size,
+			WIC_FLAGS_FORCE_RGB,
 			nullptr,
-			IID_PPV_ARGS(&texture_resource)));
+			scratch_image));
+	}
+}
 
-		texture.SetTextureUsage(texture_usage);
-		texture.SetD3D12Resource(texture_resource);
-		texture.CreateViews();
-		texture.SetName(filename);
-		texture.SetFilename(filename);
+void CommandList::LoadTextureFromScratchImage(Texture& texture, const ScratchImage& scratch_image, const std::string& filename, TextureUsage texture_usage)
+{
+	TexMetadata metadata = scratch_image.GetMetadata();
 
-		// Update the global state tracker.
-		ResourceStateTracker::AddGlobalResourceState(
-			texture_resource.Get(), D3D12_RESOURCE_STATE_COMMON);
+	// Force albedo textures to use sRGB
+	if (texture_usage == TextureUsage::Albedo)
+	{
+		metadata.format = MakeSRGB(metadata.format);
+	}
+	// We need high precision normals for raytracing.
+	else if(texture_usage == TextureUsage::Normalmap)
+	{
+		//metadata.format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	}
 
-		std::vector<D3D12_SUBRESOURCE_DATA> subresources(scratch_image.GetImageCount());
-		const Image* p_images = scratch_image.GetImages();
-		for (int i = 0; i < scratch_image.GetImageCount(); ++i)
-		{
-			auto& subresource = subresources[i];
-			subresource.RowPitch = p_images[i].rowPitch;
-			subresource.SlicePitch = p_images[i].slicePitch;
-			subresource.pData = p_images[i].pixels;
-		}
+	D3D12_RESOURCE_DESC texture_desc = {};
+	switch (metadata.dimension)
+	{
+	case TEX_DIMENSION_TEXTURE1D:
+		texture_desc = CD3DX12_RESOURCE_DESC::Tex1D(
+			metadata.format,
+			static_cast<UINT64>(metadata.width),
+			static_cast<UINT16>(metadata.arraySize));
+		break;
+	case TEX_DIMENSION_TEXTURE2D:
+		texture_desc = CD3DX12_RESOURCE_DESC::Tex2D(
+			metadata.format,
+			static_cast<UINT64>(metadata.width),
+			static_cast<UINT>(metadata.height),
+			static_cast<UINT16>(metadata.arraySize));
+		break;
+	case TEX_DIMENSION_TEXTURE3D:
+		texture_desc = CD3DX12_RESOURCE_DESC::Tex3D(
+			metadata.format,
+			static_cast<UINT64>(metadata.width),
+			static_cast<UINT>(metadata.height),
+			static_cast<UINT16>(metadata.depth));
+		break;
+	default:
+		throw std::exception("Invalid texture dimension.");
+		break;
+	}
 
-		CopyTextureSubresource(
-			texture,
-			0,
-			static_cast<uint32_t>(subresources.size()),
-			subresources.data());
+	auto device = NeelEngine::Get().GetDevice();
+	Microsoft::WRL::ComPtr<ID3D12Resource> texture_resource;
 
-		if (subresources.size() < texture_resource->GetDesc().MipLevels)
-		{
-			GenerateMips(texture);
-		}
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&texture_desc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(&texture_resource)));
+
+	texture.SetTextureUsage(texture_usage);
+	texture.SetD3D12Resource(texture_resource);
+	texture.CreateViews();
+	texture.SetName(filename);
+	texture.SetFilename(filename);
+
+	// Update the global state tracker.
+	ResourceStateTracker::AddGlobalResourceState(
+		texture_resource.Get(), D3D12_RESOURCE_STATE_COMMON);
+
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources(scratch_image.GetImageCount());
+	const Image* p_images = scratch_image.GetImages();
+	for (int i = 0; i < scratch_image.GetImageCount(); ++i)
+	{
+		auto& subresource = subresources[i];
+		subresource.RowPitch = p_images[i].rowPitch;
+		subresource.SlicePitch = p_images[i].slicePitch;
+		subresource.pData = p_images[i].pixels;
+	}
+
+	CopyTextureSubresource(
+		texture,
+		0,
+		static_cast<uint32_t>(subresources.size()),
+		subresources.data());
+
+	if (subresources.size() < texture_resource->GetDesc().MipLevels)
+	{
+		GenerateMips(texture);
+	}
 }
 
 void CommandList::ClearTexture(const Texture& texture, const float clear_color[4])
@@ -672,7 +872,7 @@ void CommandList::GenerateMipsUAV(Texture& texture, bool is_srgb)
 		generate_mips_pso_ = std::make_unique<GenerateMipsPSO>();
 	}
 
-	d3d12_command_list_->SetPipelineState(generate_mips_pso_->GetPipelineState().Get());
+	SetPipelineState(generate_mips_pso_->GetPipelineState());
 	SetComputeRootSignature(generate_mips_pso_->GetRootSignature());
 
 	GenerateMipsCB generate_mips_cb;
@@ -801,6 +1001,10 @@ void CommandList::CopyTextureSubresource(Texture& texture, uint32_t first_subres
 void CommandList::SetGraphicsDynamicConstantBuffer(uint32_t root_parameter_index, size_t size_in_bytes,
                                                    const void* buffer_data)
 {
+	// Consecutive draws with the same material or mesh bind the same data.
+	if (!state_cache_->SetGraphicsConstantBuffer(root_parameter_index, size_in_bytes, buffer_data))
+		return;
+
 	// Constant buffers must be 256-byte aligned.
 	auto heap_allococation = upload_buffer_->Allocate(size_in_bytes, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
 	memcpy(heap_allococation.CPU, buffer_data, size_in_bytes);
@@ -941,13 +1145,19 @@ void CommandList::SetScissorRects(const std::vector<D3D12_RECT>& scissor_rects)
 
 void CommandList::SetPipelineState(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline_state)
 {
-	d3d12_command_list_->SetPipelineState(pipeline_state.Get());
+	if (state_cache_->SetPipelineState(pipeline_state.Get()))
+	{
+		d3d12_command_list_->SetPipelineState(pipeline_state.Get());
 
-	TrackResource(pipeline_state);
+		TrackResource(pipeline_state);
+	}
 }
 
 void CommandList::SetStateObject(Microsoft::WRL::ComPtr<ID3D12StateObject> state_object)
 {
+	// A state object replaces the pipeline State.
+	state_cache_->InvalidatePipelineState();
+
 	d3d12_command_list_->SetPipelineState1(state_object.Get());
 
 	TrackResource(state_object);
@@ -967,6 +1177,9 @@ void CommandList::SetGraphicsRootSignature(const RootSignature& rootSignature)
 
 		d3d12_command_list_->SetGraphicsRootSignature(root_signature_);
 
+		// Changing the root signature invalidates the root arguments.
+		state_cache_->InvalidateRootArguments();
+
 		TrackResource(root_signature_);
 	}
 }
@@ -1219,6 +1432,8 @@ void CommandList::Reset()
 	}
 
 	root_signature_ = nullptr;
+	state_cache_->Reset();
+
 	compute_command_list_ = nullptr;
 }
 
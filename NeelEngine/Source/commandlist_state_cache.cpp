@@ -0,0 +1,62 @@
+#include "commandlist_state_cache.h"
+
+#include <cstring>
+
+bool CommandListStateCache::SetPipelineState(const void* pipeline_state)
+{
+	if (pipeline_state_ == pipeline_state)
+		return false;
+
+	pipeline_state_ = pipeline_state;
+
+	return true;
+}
+
+bool CommandListStateCache::SetPrimitiveTopology(uint32_t primitive_topology)
+{
+	if (primitive_topology_ == primitive_topology)
+		return false;
+
+	primitive_topology_ = primitive_topology;
+
+	return true;
+}
+
+bool CommandListStateCache::SetGraphicsConstantBuffer(uint32_t root_parameter_index, size_t size_in_bytes,
+	const void* buffer_data)
+{
+	if (root_parameter_index >= graphics_constant_buffers_.size())
+	{
+		graphics_constant_buffers_.resize(root_parameter_index + 1);
+	}
+
+	std::vector<uint8_t>& bound_data = graphics_constant_buffers_[root_parameter_index];
+	if (!bound_data.empty() && bound_data.size() == size_in_bytes && memcmp(bound_data.data(), buffer_data, size_in_bytes) == 0)
+		return false;
+
+	const uint8_t* data = static_cast<const uint8_t*>(buffer_data);
+	bound_data.assign(data, data + size_in_bytes);
+
+	return true;
+}
+
+void CommandListStateCache::InvalidatePipelineState()
+{
+	pipeline_state_ = nullptr;
+}
+
+void CommandListStateCache::InvalidateRootArguments()
+{
+	for (auto& bound_data : graphics_constant_buffers_)
+	{
+		bound_data.clear();
+	}
+}
+
+void CommandListStateCache::Reset()
+{
+	pipeline_state_		= nullptr;
+	primitive_topology_	= 0;
+
+	InvalidateRootArguments();
+}
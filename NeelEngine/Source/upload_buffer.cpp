@@ -6,6 +6,7 @@
 UploadBuffer::UploadBuffer(size_t page_size)
 	: page_pool_({})
 	  , available_pages_({})
+	  , large_pages_({})
 	  , current_page_(nullptr)
 	  , page_size_(page_size)
 {
@@ -19,7 +20,8 @@ UploadBuffer::Allocation UploadBuffer::Allocate(size_t size_in_bytes, size_t ali
 {
 	if (size_in_bytes > page_size_)
 	{
-		throw std::bad_alloc();
+		large_pages_.push_back(std::make_shared<Page>(math::AlignUp(size_in_bytes, alignment)));
+		return large_pages_.back()->Allocate(size_in_bytes, alignment);
 	}
 
 	// If there is no current page, or the requested allocation exceeds the
@@ -53,6 +55,8 @@ std::shared_ptr<UploadBuffer::Page> UploadBuffer::RequestPage()
 void UploadBuffer::Reset()
 {
 	current_page_ = nullptr;
+	large_pages_.clear();
+
 	// Reset all available pages
 	available_pages_ = page_pool_;
 
@@ -106,6 +110,8 @@ UploadBuffer::Allocation UploadBuffer::Page::Allocate(size_t size_in_bytes, size
 	Allocation allocation;
 	allocation.CPU = static_cast<uint8_t*>(cpu_ptr_) + offset_;
 	allocation.GPU = gpu_ptr_ + offset_;
+	allocation.Resource = d3d12_resource_.Get();
+	allocation.Offset = offset_;
 
 	offset_ += aligned_size;
 
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mesh.h"
+
+/**
+* Primitives for the tests of the import stages. All streams are float streams (see Mesh::PrimitiveData) and
+* the streams and indices are stored in PrimitiveData::Storage.
+*/
+class MeshTestHelpers
+{
+public:
+	/**
+	* A grid of columns x rows quads in the xy plane, from (0, 0, 0) to (columns, rows, 0), facing +z. Every quad is split into
+	* two triangles. With shared_vertices false every triangle has vertices of its own, as exported without welding.
+	*/
+	static Mesh::PrimitiveData CreateGrid(uint32_t columns, uint32_t rows, bool shared_vertices = true);
+
+	/**
+	* A primitive with the given float3 positions and 32-bit indices. Normals point along +z, tangents along +x and the
+	* texcoords are the xy of the positions.
+	*/
+	static Mesh::PrimitiveData CreatePrimitive(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// Float3 position of a vertex of a primitive with float positions.
+	static const float* GetPosition(const Mesh::PrimitiveData& primitive, size_t vertex);
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+* Minimal unit test registry.
+*
+* Tests are registered with TEST(name) at static initialization and run by RunAll. A CHECK that
+* fails records the failure and lets the test continue, an exception that leaves the test fails
+* it as well. Failures are printed with their file and line.
+*/
+class TestRegistry
+{
+public:
+	using TestFunction = void(*)();
+
+	static bool Add(const char* name, TestFunction function);
+
+	// Record a failed check of the running test.
+	static void Fail(const char* file, int line, const std::string& message);
+
+	/**
+	* Run every test whose name contains filter (all tests for an empty filter).
+	* @returns The number of failed tests.
+	*/
+	static int RunAll(const std::string& filter);
+
+private:
+	struct Test
+	{
+		const char*		Name;
+		TestFunction	Function;
+	};
+
+	static std::vector<Test>& GetTests();
+
+	static uint32_t failed_checks_;
+};
+
+// Directory of the assets shipped with ReflectionsDemo, relative to NeelEngineTests where the tests run.
+std::string GetAssetDirectory();
+
+#define TEST(name) \
+	static void name(); \
+	static const bool name##_registered = TestRegistry::Add(#name, &name); \
+	static void name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+			TestRegistry::Fail(__FILE__, __LINE__, "CHECK(" #condition ")"); \
+	} while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+	do \
+	{ \
+		const auto& expected_value = (expected); \
+		const auto& actual_value = (actual); \
+		if (!(expected_value == actual_value)) \
+		{ \
+			std::ostringstream message; \
+			message << "CHECK_EQUAL(" #expected ", " #actual "): " << expected_value << " != " << actual_value; \
+			TestRegistry::Fail(__FILE__, __LINE__, message.str()); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(expression) \
+	do \
+	{ \
+		bool thrown = false; \
+		try \
+		{ \
+			expression; \
+		} \
+		catch (...) \
+		{ \
+			thrown = true; \
+		} \
+		if (!thrown) \
+			TestRegistry::Fail(__FILE__, __LINE__, "CHECK_THROWS(" #expression ")"); \
+	} while (false)
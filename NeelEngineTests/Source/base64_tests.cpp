@@ -0,0 +1,143 @@
+#include "test_framework.h"
+
+#include <gltf.h>
+
+#include <random>
+
+#if defined(FX_GLTF_BASE64_SIMD)
+// Every decoder the CPU can run, the scalar decoder first.
+static std::vector<fx::base64::detail::DecodeIsa> GetSupportedIsas()
+{
+	using fx::base64::detail::DecodeIsa;
+
+	std::vector<DecodeIsa> isas = { DecodeIsa::Scalar };
+	const DecodeIsa widest = fx::base64::detail::DetectDecodeIsa();
+
+	if (widest == DecodeIsa::SSE41 || widest == DecodeIsa::AVX2)
+	{
+		isas.push_back(DecodeIsa::SSE41);
+	}
+
+	if (widest == DecodeIsa::AVX2)
+	{
+		isas.push_back(DecodeIsa::AVX2);
+	}
+
+	return isas;
+}
+#endif
+
+// Decode with every decoder and check that they agree with the scalar decoder on the result and the output.
+static void CheckDecodersAgree(const std::string& in)
+{
+	std::vector<uint8_t> scalar;
+	const bool scalar_valid = fx::base64::TryDecodeScalar(in, scalar);
+
+	std::vector<uint8_t> dispatched;
+	CHECK_EQUAL(scalar_valid, fx::base64::TryDecode(in, dispatched));
+	CHECK(scalar == dispatched);
+
+#if defined(FX_GLTF_BASE64_SIMD)
+	for (const auto isa : GetSupportedIsas())
+	{
+		std::vector<uint8_t> decoded;
+		CHECK_EQUAL(scalar_valid, fx::base64::detail::TryDecodeWith(isa, in, decoded));
+		CHECK(scalar == decoded);
+	}
+#endif
+}
+
+TEST(Base64DecodesKnownValues)
+{
+	const std::pair<const char*, const char*> values[] =
+	{
+		{ "", "" }, { "TQ==", "M" }, { "TWE=", "Ma" }, { "TWFu", "Man" },
+		{ "VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZyD7777//w==", "The quick brown fox jumps over the lazy dog \xfb\xef\xbe\xff\xff" },
+	};
+
+	for (const auto& value : values)
+	{
+		std::vector<uint8_t> decoded;
+		CHECK(fx::base64::TryDecode(value.first, decoded));
+		CHECK_EQUAL(std::string(value.second), std::string(decoded.begin(), decoded.end()));
+
+		CheckDecodersAgree(value.first);
+	}
+}
+
+TEST(Base64SimdMatchesScalarForEveryTailLength)
+{
+	std::mt19937 random(1234);
+
+	// Up to 4 blocks of the widest decoder followed by every tail of 0 to 64 characters, with and without padding.
+	for (size_t num_blocks = 0; num_blocks <= 4; num_blocks++)
+	{
+		for (size_t tail = 0; tail <= 64; tail++)
+		{
+			for (size_t padding = 0; padding < 3; padding++)
+			{
+				const size_t num_characters = num_blocks * 32 + tail;
+				const size_t num_bytes = num_characters / 4 * 3 - (num_characters >= 4 ? padding : 0);
+
+				std::vector<uint8_t> bytes(num_bytes);
+				for (auto& byte : bytes)
+				{
+					byte = static_cast<uint8_t>(random());
+				}
+
+				const std::string encoded = fx::base64::Encode(bytes);
+
+				std::vector<uint8_t> decoded;
+				CHECK(fx::base64::TryDecode(encoded, decoded));
+				CHECK(decoded == bytes);
+
+				CheckDecodersAgree(encoded);
+			}
+		}
+	}
+}
+
+TEST(Base64SimdMatchesScalarOnInvalidInput)
+{
+	std::mt19937 random(5678);
+
+	const char invalid_characters[] = { '!', '-', '_', ' ', '\n', '\0', '=', '.', static_cast<char>(0x80), static_cast<char>(0xFF) };
+
+	for (size_t num_bytes = 0; num_bytes <= 96; num_bytes += 5)
+	{
+		std::vector<uint8_t> bytes(num_bytes);
+		for (auto& byte : bytes)
+		{
+			byte = static_cast<uint8_t>(random());
+		}
+
+		const std::string encoded = fx::base64::Encode(bytes);
+
+		// An invalid character at every position, inside and outside of the vectorized blocks.
+		for (size_t position = 0; position < encoded.size(); position++)
+		{
+			for (const char character : invalid_characters)
+			{
+				std::string corrupted = encoded;
+				corrupted[position] = character;
+				CheckDecodersAgree(corrupted);
+			}
+		}
+
+		// Lengths that are not a multiple of 4.
+		for (size_t cut = 1; cut < 4 && cut <= encoded.size(); cut++)
+		{
+			std::vector<uint8_t> decoded;
+			CHECK(!fx::base64::TryDecode(encoded.substr(0, encoded.size() - cut), decoded));
+			CheckDecodersAgree(encoded.substr(0, encoded.size() - cut));
+		}
+	}
+
+	for (const char* invalid : { "=", "====", "Q===", "QQ=A", "QQ==QUFB", "A!==", "TWFu\n" })
+	{
+		std::vector<uint8_t> decoded;
+		CHECK(!fx::base64::TryDecode(invalid, decoded));
+		CHECK(decoded.empty());
+		CheckDecodersAgree(invalid);
+	}
+}
@@ -0,0 +1,429 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "mesh_test_helpers.h"
+#include "bvh.h"
+#include "wide_bvh.h"
+#include "thread_pool.h"
+
+#include <random>
+
+// Random triangles of mixed sizes in a cube of size 100 around the origin, three vertices per triangle.
+static std::vector<XMFLOAT3> CreateTriangleSoup(size_t num_triangles, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f), offset(-1.0f, 1.0f), size(0.1f, 10.0f);
+
+	std::vector<XMFLOAT3> positions;
+	for (size_t i = 0; i < num_triangles; i++)
+	{
+		const XMFLOAT3 center(position(random), position(random), position(random));
+		const float scale = size(random);
+
+		for (size_t v = 0; v < 3; v++)
+		{
+			positions.emplace_back(center.x + offset(random) * scale, center.y + offset(random) * scale, center.z + offset(random) * scale);
+		}
+	}
+
+	return positions;
+}
+
+// Random rays from inside and outside of the soup, in every direction.
+static std::vector<Bvh::Ray> CreateRays(size_t num_rays, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-80.0f, 80.0f), direction(-1.0f, 1.0f), unit(0.0f, 1.0f);
+
+	std::vector<Bvh::Ray> rays(num_rays);
+	for (Bvh::Ray& ray : rays)
+	{
+		ray.Origin = XMFLOAT3(position(random), position(random), position(random));
+		XMStoreFloat3(&ray.Direction, XMVector3Normalize(XMVectorSet(direction(random), direction(random), direction(random), 0.0f)));
+
+		// Every few rays only accept hits in a part of the ray.
+		ray.TMin = unit(random) < 0.25f ? unit(random) * 20.0f : 0.0f;
+		ray.TMax = unit(random) < 0.25f ? ray.TMin + unit(random) * 60.0f : FLT_MAX;
+	}
+
+	return rays;
+}
+
+// Closest hit of a ray by testing every triangle.
+static bool IntersectBruteForce(const std::vector<XMFLOAT3>& positions, const Bvh::Ray& ray, bool cull_back_faces, Bvh::Hit& hit)
+{
+	hit.Triangle = Bvh::no_hit_;
+	float t_max = ray.TMax;
+
+	for (uint32_t i = 0; i < positions.size() / 3; i++)
+	{
+		float t, u, v;
+		if (Bvh::IntersectTriangle(&positions[i * 3], ray, cull_back_faces, t_max, t, u, v))
+		{
+			hit = { t, u, v, i };
+			t_max = t;
+		}
+	}
+
+	return hit.Triangle != Bvh::no_hit_;
+}
+
+// Intersect and Occluded return the same hits as testing every triangle, for a Bvh or a WideBvh.
+template <typename Hierarchy>
+static void CheckBvhMatchesBruteForce(const Hierarchy& bvh, const std::vector<XMFLOAT3>& positions, const std::vector<Bvh::Ray>& rays)
+{
+	size_t num_hits = 0;
+
+	for (const Bvh::Ray& ray : rays)
+	{
+		for (const bool cull_back_faces : { false, true })
+		{
+			Bvh::Hit hit, expected;
+			const bool hits = bvh.Intersect(ray, hit, cull_back_faces);
+
+			CHECK_EQUAL(IntersectBruteForce(positions, ray, cull_back_faces, expected), hits);
+			if (!hits)
+			{
+				CHECK_EQUAL(Bvh::no_hit_, hit.Triangle);
+				continue;
+			}
+
+			num_hits++;
+
+			// Triangles may tie at the same distance, the hit must be on the reported triangle.
+			CHECK_EQUAL(expected.T, hit.T);
+
+			float t, u, v;
+			CHECK(Bvh::IntersectTriangle(&positions[hit.Triangle * 3], ray, cull_back_faces, ray.TMax, t, u, v));
+			CHECK_EQUAL(hit.T, t);
+			CHECK_EQUAL(hit.U, u);
+			CHECK_EQUAL(hit.V, v);
+		}
+
+		Bvh::Hit any;
+		CHECK_EQUAL(IntersectBruteForce(positions, ray, false, any), bvh.Occluded(ray));
+	}
+
+	// The rays test hits and misses.
+	CHECK(num_hits > rays.size() / 10);
+	CHECK(num_hits < rays.size() * 2);
+}
+
+// The 4 and 8 wide hierarchies collapsed from bvh return the same hits as testing every triangle.
+static void CheckWideBvhsMatchBruteForce(const Bvh& bvh, const std::vector<XMFLOAT3>& positions, const std::vector<Bvh::Ray>& rays)
+{
+	for (const uint32_t width : { 4u, 8u })
+	{
+		WideBvh wide_bvh;
+		wide_bvh.Build(bvh, width);
+
+		CHECK_EQUAL(width, wide_bvh.GetWidth());
+		CHECK_EQUAL(positions.size() / 3, wide_bvh.GetNumTriangles());
+
+		CheckBvhMatchesBruteForce(wide_bvh, positions, rays);
+	}
+}
+
+// Rays of a pinhole camera in the corner of the soup, row by row, so neighbouring rays are coherent and point into one octant.
+static std::vector<Bvh::Ray> CreateCameraRays(uint32_t width, uint32_t height)
+{
+	const XMVECTOR origin = XMVectorSet(-100.0f, -100.0f, -150.0f, 1.0f);
+
+	std::vector<Bvh::Ray> rays;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const XMVECTOR target = XMVectorSet(-50.0f + 100.0f * (x + 0.5f) / width, -50.0f + 100.0f * (y + 0.5f) / height, 0.0f, 1.0f);
+
+			Bvh::Ray ray = { XMFLOAT3(), 0.0f, XMFLOAT3(), FLT_MAX };
+			XMStoreFloat3(&ray.Origin, origin);
+			XMStoreFloat3(&ray.Direction, XMVector3Normalize(target - origin));
+			rays.push_back(ray);
+		}
+	}
+
+	return rays;
+}
+
+// The batched queries of every QueryMode return the hits of the single ray queries. count is at most rays.size().
+static void CheckQueryModesMatchSingleRays(const WideBvh& wide_bvh, const std::vector<XMFLOAT3>& positions, const std::vector<Bvh::Ray>& rays,
+	size_t count)
+{
+	const WideBvh::QueryMode modes[] = { WideBvh::QueryMode::Single, WideBvh::QueryMode::Packet8, WideBvh::QueryMode::Packet16, WideBvh::QueryMode::Stream };
+
+	for (const WideBvh::QueryMode mode : modes)
+	{
+		for (const bool cull_back_faces : { false, true })
+		{
+			// The hit after the last ray must not be written.
+			const Bvh::Hit guard = { -1.0f, -1.0f, -1.0f, 12345 };
+			std::vector<Bvh::Hit> hits(count + 1, guard);
+
+			wide_bvh.Intersect(rays.data(), count, hits.data(), mode, cull_back_faces);
+			CHECK_EQUAL(guard.Triangle, hits[count].Triangle);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				Bvh::Hit expected;
+				const bool expected_hit = wide_bvh.Intersect(rays[i], expected, cull_back_faces);
+
+				CHECK_EQUAL(expected_hit, hits[i].Triangle != Bvh::no_hit_);
+				if (!expected_hit || hits[i].Triangle == Bvh::no_hit_)
+					continue;
+
+				// Triangles may tie at the same distance, the hit must be on the reported triangle.
+				CHECK_EQUAL(expected.T, hits[i].T);
+
+				float t, u, v;
+				CHECK(Bvh::IntersectTriangle(&positions[hits[i].Triangle * 3], rays[i], cull_back_faces, rays[i].TMax, t, u, v));
+				CHECK_EQUAL(hits[i].T, t);
+			}
+		}
+
+		std::vector<uint8_t> occluded(count + 1, 2);
+		wide_bvh.Occluded(rays.data(), count, occluded.data(), mode);
+		CHECK_EQUAL(uint8_t(2), occluded[count]);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			CHECK_EQUAL(wide_bvh.Occluded(rays[i]) ? uint8_t(1) : uint8_t(0), occluded[i]);
+		}
+	}
+}
+
+// Every node contains its children and triangles, every triangle is in one leaf.
+static void CheckBvhStructure(const Bvh& bvh, const std::vector<XMFLOAT3>& positions)
+{
+	const std::vector<Bvh::Node>& nodes = bvh.GetNodes();
+	const size_t num_triangles = positions.size() / 3;
+
+	CHECK_EQUAL(num_triangles, bvh.GetNumTriangles());
+
+	const auto contains = [](const Bvh::Node& node, const XMFLOAT3& point)
+	{
+		return point.x >= node.BoundsMin.x && point.y >= node.BoundsMin.y && point.z >= node.BoundsMin.z &&
+			point.x <= node.BoundsMax.x && point.y <= node.BoundsMax.y && point.z <= node.BoundsMax.z;
+	};
+
+	std::vector<uint32_t> leaf_triangles;
+	std::vector<uint32_t> parents(nodes.size(), Bvh::no_hit_);
+
+	for (uint32_t n = 0; n < nodes.size(); n++)
+	{
+		const Bvh::Node& node = nodes[n];
+
+		if (node.NumTriangles > 0)
+		{
+			CHECK(node.NumTriangles <= Bvh::max_leaf_triangles_);
+
+			for (uint32_t i = node.FirstChildOrTriangle; i < node.FirstChildOrTriangle + node.NumTriangles; i++)
+			{
+				leaf_triangles.push_back(i);
+
+				for (uint32_t v = 0; v < 3; v++)
+				{
+					CHECK(contains(node, bvh.GetPositions()[i * 3 + v]));
+					CHECK(std::memcmp(&bvh.GetPositions()[i * 3 + v], &positions[bvh.GetTriangleIndices()[i] * 3 + v], sizeof(XMFLOAT3)) == 0);
+				}
+			}
+
+			continue;
+		}
+
+		// Children follow their parent, every node but the root has one parent.
+		CHECK(node.FirstChildOrTriangle > n && node.FirstChildOrTriangle + 1 < nodes.size());
+
+		for (uint32_t c = node.FirstChildOrTriangle; c < node.FirstChildOrTriangle + 2; c++)
+		{
+			CHECK_EQUAL(Bvh::no_hit_, parents[c]);
+			parents[c] = n;
+
+			CHECK(contains(node, nodes[c].BoundsMin));
+			CHECK(contains(node, nodes[c].BoundsMax));
+		}
+	}
+
+	std::sort(leaf_triangles.begin(), leaf_triangles.end());
+	for (uint32_t i = 0; i < leaf_triangles.size(); i++)
+	{
+		CHECK_EQUAL(i, leaf_triangles[i]);
+	}
+	CHECK_EQUAL(num_triangles, leaf_triangles.size());
+
+	std::vector<uint32_t> triangle_indices = bvh.GetTriangleIndices();
+	std::sort(triangle_indices.begin(), triangle_indices.end());
+	for (uint32_t i = 0; i < triangle_indices.size(); i++)
+	{
+		CHECK_EQUAL(i, triangle_indices[i]);
+	}
+}
+
+TEST(BvhMatchesBruteForceOnTriangleSoup)
+{
+	const std::vector<XMFLOAT3> positions = CreateTriangleSoup(2000, 22);
+	const std::vector<Bvh::Ray> rays = CreateRays(2000, 23);
+
+	Bvh bvh;
+	bvh.Build(positions);
+
+	CheckBvhStructure(bvh, positions);
+	CheckBvhMatchesBruteForce(bvh, positions, rays);
+	CheckWideBvhsMatchBruteForce(bvh, positions, rays);
+}
+
+TEST(BvhMatchesBruteForceOnMesh)
+{
+	// A grid bent into a roof, with shared edges and vertices where hits tie.
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(40, 40);
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<uint32_t> indices;
+	const size_t num_triangles = Bvh::AppendTriangles(primitive, XMMatrixScaling(4.0f, 4.0f, 4.0f) * XMMatrixTranslation(-80.0f, -80.0f, 0.0f),
+		positions, &indices);
+
+	CHECK_EQUAL(size_t(40 * 40 * 2), num_triangles);
+	CHECK_EQUAL(num_triangles * 3, positions.size());
+	CHECK_EQUAL(positions.size(), indices.size());
+
+	for (XMFLOAT3& position : positions)
+	{
+		position.z = std::abs(position.x) * 0.5f;
+	}
+
+	const std::vector<Bvh::Ray> rays = CreateRays(2000, 24);
+
+	Bvh bvh;
+	bvh.Build(positions);
+
+	CheckBvhStructure(bvh, positions);
+	CheckBvhMatchesBruteForce(bvh, positions, rays);
+	CheckWideBvhsMatchBruteForce(bvh, positions, rays);
+}
+
+TEST(BvhHandlesDegenerateInput)
+{
+	Bvh bvh;
+	Bvh::Hit hit;
+	const Bvh::Ray ray = { XMFLOAT3(0.0f, 0.0f, -10.0f), 0.0f, XMFLOAT3(0.0f, 0.0f, 1.0f), FLT_MAX };
+
+	bvh.Build({});
+	CHECK(bvh.GetNodes().empty());
+	CHECK(!bvh.Intersect(ray, hit));
+	CHECK(!bvh.Occluded(ray));
+
+	WideBvh wide_bvh;
+	for (const uint32_t width : { 4u, 8u })
+	{
+		wide_bvh.Build(bvh, width);
+		CHECK_EQUAL(size_t(0), wide_bvh.GetNumNodes());
+		CHECK(!wide_bvh.Intersect(ray, hit));
+		CHECK(!wide_bvh.Occluded(ray));
+	}
+
+	// Copies of one triangle share their centroid, so no bin can split them.
+	std::vector<XMFLOAT3> positions;
+	for (size_t i = 0; i < 100; i++)
+	{
+		positions.insert(positions.end(), { XMFLOAT3(-1.0f, -1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, -1.0f, 0.0f) });
+	}
+
+	bvh.Build(positions);
+	CheckBvhStructure(bvh, positions);
+
+	CHECK(bvh.Intersect(ray, hit, true));
+	CHECK_EQUAL(10.0f, hit.T);
+	CHECK(bvh.Occluded(ray));
+
+	// Seen from behind the triangles are back facing.
+	const Bvh::Ray back_ray = { XMFLOAT3(0.0f, 0.0f, 10.0f), 0.0f, XMFLOAT3(0.0f, 0.0f, -1.0f), FLT_MAX };
+	CHECK(!bvh.Intersect(back_ray, hit, true));
+	CHECK(bvh.Intersect(back_ray, hit, false));
+
+	// The wide hierarchies keep the leaf that no bin could split, a single leaf becomes a root with one child.
+	for (const uint32_t width : { 4u, 8u })
+	{
+		wide_bvh.Build(bvh, width);
+		CHECK_EQUAL(positions.size() / 3, wide_bvh.GetNumTriangles());
+
+		CHECK(wide_bvh.Intersect(ray, hit, true));
+		CHECK_EQUAL(10.0f, hit.T);
+		CHECK(wide_bvh.Occluded(ray));
+
+		CHECK(!wide_bvh.Intersect(back_ray, hit, true));
+		CHECK(wide_bvh.Intersect(back_ray, hit, false));
+		CHECK_EQUAL(10.0f, hit.T);
+	}
+
+	CHECK_THROWS(wide_bvh.Build(bvh, 2));
+}
+
+TEST(WideBvhQueryModesMatchSingleRays)
+{
+	const std::vector<XMFLOAT3> positions = CreateTriangleSoup(2000, 27);
+
+	Bvh bvh;
+	bvh.Build(positions);
+
+	// Incoherent rays, coherent camera rays and rays that leave the soup without hitting anything.
+	std::vector<Bvh::Ray> rays = CreateRays(600, 28);
+
+	const std::vector<Bvh::Ray> camera_rays = CreateCameraRays(40, 25);
+	rays.insert(rays.end(), camera_rays.begin(), camera_rays.end());
+
+	for (size_t i = 0; i < 100; i++)
+	{
+		const float offset = static_cast<float>(i);
+		rays.push_back({ XMFLOAT3(100.0f + offset, 100.0f, 100.0f - offset), 0.0f, XMFLOAT3(0.6f, 0.64f, 0.48f), FLT_MAX });
+	}
+
+	for (const uint32_t width : { 4u, 8u })
+	{
+		WideBvh wide_bvh;
+		wide_bvh.Build(bvh, width);
+
+		// All rays end in partially filled packets and streams.
+		CheckQueryModesMatchSingleRays(wide_bvh, positions, rays, rays.size() - 3);
+
+		// Single partial packets, and a packet of rays that all miss.
+		CheckQueryModesMatchSingleRays(wide_bvh, positions, camera_rays, 5);
+		CheckQueryModesMatchSingleRays(wide_bvh, positions, rays, 1);
+
+		const std::vector<Bvh::Ray> miss_rays(rays.end() - 16, rays.end());
+		CheckQueryModesMatchSingleRays(wide_bvh, positions, miss_rays, miss_rays.size());
+
+		for (const Bvh::Ray& ray : miss_rays)
+		{
+			CHECK(!wide_bvh.Occluded(ray));
+		}
+	}
+}
+
+TEST(BvhSahCostIsFarBelowOneLeaf)
+{
+	const std::vector<XMFLOAT3> positions = CreateTriangleSoup(4000, 25);
+
+	Bvh bvh;
+	bvh.Build(positions);
+
+	// A single leaf costs 1 + 4000, a ray through the hierarchy visits a small part of the nodes and triangles.
+	CHECK(bvh.GetSahCost() > 1.0);
+	CHECK(bvh.GetSahCost() < 4001.0 / 20.0);
+}
+
+TEST(BvhBuildOnThreadPoolMatchesCallingThread)
+{
+	// Enough triangles to build children as separate tasks.
+	const std::vector<XMFLOAT3> positions = CreateTriangleSoup(Bvh::parallel_task_triangles_ * 4, 26);
+
+	Bvh bvh;
+	bvh.Build(positions);
+
+	Bvh parallel_bvh;
+	ThreadPool thread_pool(4);
+	parallel_bvh.Build(positions, &thread_pool);
+
+	CHECK_EQUAL(bvh.GetNodes().size(), parallel_bvh.GetNodes().size());
+	CHECK(std::memcmp(bvh.GetNodes().data(), parallel_bvh.GetNodes().data(), bvh.GetNodes().size() * sizeof(Bvh::Node)) == 0);
+	CHECK(bvh.GetTriangleIndices() == parallel_bvh.GetTriangleIndices());
+}
@@ -0,0 +1,155 @@
+#include "test_framework.h"
+
+#include "commandlist_state_cache.h"
+#include "render_queue.h"
+
+#include <random>
+
+// Material constant buffer data, compared byte wise like the data a draw binds.
+struct TestMaterial
+{
+	float		Color[4];
+	uint32_t	Id;
+	uint32_t	Padding[3];
+};
+
+static TestMaterial MakeMaterial(uint32_t id)
+{
+	TestMaterial material{};
+	material.Color[0]	= id * 0.25f;
+	material.Id			= id;
+
+	return material;
+}
+
+TEST(StateCacheSkipsBoundPipelineState)
+{
+	CommandListStateCache cache;
+	int pipelines[2] = {};
+
+	CHECK(cache.SetPipelineState(&pipelines[0]));
+	CHECK(!cache.SetPipelineState(&pipelines[0]));
+	CHECK(cache.SetPipelineState(&pipelines[1]));
+	CHECK(cache.SetPipelineState(&pipelines[0]));
+
+	// A state object replaced the pipeline state.
+	cache.InvalidatePipelineState();
+	CHECK(cache.SetPipelineState(&pipelines[0]));
+
+	// Unbinding is a change as well.
+	CHECK(cache.SetPipelineState(nullptr));
+	CHECK(!cache.SetPipelineState(nullptr));
+}
+
+TEST(StateCacheSkipsBoundTopology)
+{
+	CommandListStateCache cache;
+
+	// Nothing is set after creation, so undefined is the bound topology.
+	CHECK(!cache.SetPrimitiveTopology(0));
+	CHECK(cache.SetPrimitiveTopology(4));
+	CHECK(!cache.SetPrimitiveTopology(4));
+	CHECK(cache.SetPrimitiveTopology(5));
+}
+
+TEST(StateCacheSkipsBoundConstantBufferData)
+{
+	CommandListStateCache cache;
+
+	const TestMaterial first = MakeMaterial(1);
+	TestMaterial second = MakeMaterial(1);
+
+	CHECK(cache.SetGraphicsConstantBuffer(2, sizeof(first), &first));
+
+	// The same bytes from another address are skipped, the cache keeps a copy.
+	CHECK(!cache.SetGraphicsConstantBuffer(2, sizeof(second), &second));
+
+	// Root parameters are compared separately.
+	CHECK(cache.SetGraphicsConstantBuffer(0, sizeof(second), &second));
+
+	second.Color[3] = 1.0f;
+	CHECK(cache.SetGraphicsConstantBuffer(2, sizeof(second), &second));
+	CHECK(!cache.SetGraphicsConstantBuffer(2, sizeof(second), &second));
+
+	// A prefix of the bound data is a different size.
+	CHECK(cache.SetGraphicsConstantBuffer(2, sizeof(float) * 4, &second));
+}
+
+TEST(StateCacheBindsEmptyConstantBufferOnce)
+{
+	CommandListStateCache cache;
+	const uint8_t data = 0;
+
+	CHECK(cache.SetGraphicsConstantBuffer(0, 0, &data));
+	CHECK(cache.SetGraphicsConstantBuffer(0, 0, &data));
+}
+
+TEST(StateCacheForgetsRootArgumentsAndResets)
+{
+	CommandListStateCache cache;
+	int pipeline = 0;
+	const TestMaterial material = MakeMaterial(3);
+
+	CHECK(cache.SetPipelineState(&pipeline));
+	CHECK(cache.SetPrimitiveTopology(4));
+	CHECK(cache.SetGraphicsConstantBuffer(1, sizeof(material), &material));
+
+	// A new root signature keeps the pipeline state but needs the root arguments again.
+	cache.InvalidateRootArguments();
+	CHECK(!cache.SetPipelineState(&pipeline));
+	CHECK(cache.SetGraphicsConstantBuffer(1, sizeof(material), &material));
+
+	cache.Reset();
+	CHECK(cache.SetPipelineState(&pipeline));
+	CHECK(cache.SetPrimitiveTopology(4));
+	CHECK(cache.SetGraphicsConstantBuffer(1, sizeof(material), &material));
+}
+
+TEST(StateCacheBindsSortedDrawsOncePerState)
+{
+	const uint32_t num_pipelines	= 3;
+	const uint32_t num_materials	= 7;
+	const uint32_t num_draws		= 1000;
+
+	int pipelines[num_pipelines] = {};
+
+	std::mt19937 random(19);
+	std::vector<uint32_t> draw_pipelines(num_draws), draw_materials(num_draws);
+
+	RenderQueue queue;
+	for (uint32_t i = 0; i < num_draws; i++)
+	{
+		draw_pipelines[i] = random() % num_pipelines;
+		draw_materials[i] = random() % num_materials;
+
+		queue.Add(RenderQueue::MakeKey(0, draw_pipelines[i], draw_materials[i], random() % 100), i);
+	}
+
+	// Count the state the draws bind in the order of the queue.
+	const auto count_binds = [&](uint32_t& pipeline_binds, uint32_t& material_binds)
+	{
+		CommandListStateCache cache;
+		pipeline_binds = 0;
+		material_binds = 0;
+
+		for (uint32_t draw : queue.GetValues())
+		{
+			const TestMaterial material = MakeMaterial(draw_materials[draw]);
+
+			pipeline_binds += cache.SetPipelineState(&pipelines[draw_pipelines[draw]]) ? 1 : 0;
+			material_binds += cache.SetGraphicsConstantBuffer(1, sizeof(material), &material) ? 1 : 0;
+		}
+	};
+
+	uint32_t pipeline_binds, material_binds;
+	count_binds(pipeline_binds, material_binds);
+	CHECK(pipeline_binds > num_draws / 2);
+	CHECK(material_binds > num_draws / 2);
+
+	queue.Sort();
+
+	// Every pipeline is bound once and every material once per pipeline.
+	count_binds(pipeline_binds, material_binds);
+	CHECK_EQUAL(num_pipelines, pipeline_binds);
+	CHECK_EQUAL(num_pipelines * num_materials, material_binds);
+}
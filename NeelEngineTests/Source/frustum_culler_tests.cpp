@@ -0,0 +1,234 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "frustum_culler.h"
+#include "thread_pool.h"
+
+#include <random>
+
+// Camera at the origin looking down +z with a 90 degree field of view, so the side planes are x = +-z and y = +-z.
+static XMMATRIX GetViewProjection()
+{
+	return XMMatrixLookAtLH(XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+		XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 1.0f, 100.0f);
+}
+
+static bool IsInsideFrustum(const XMFLOAT3& point)
+{
+	return point.z >= 1.0f && point.z <= 100.0f && std::abs(point.x) <= point.z && std::abs(point.y) <= point.z;
+}
+
+// Cull a single box against the test camera.
+static bool IsBoxVisible(const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	FrustumCuller culler;
+	culler.SetFrustum(GetViewProjection());
+	culler.AddBox(center, extents);
+	culler.Cull();
+
+	return culler.IsVisible(0);
+}
+
+// Double precision test of a box against the planes, with the distance to the closest decision.
+static bool IsBoxVisibleReference(const XMFLOAT4 planes[6], const XMFLOAT3& center, const XMFLOAT3& extents, double& margin)
+{
+	bool visible = true;
+	margin = DBL_MAX;
+
+	for (size_t p = 0; p < 6; p++)
+	{
+		const double distance = double(planes[p].x) * center.x + double(planes[p].y) * center.y + double(planes[p].z) * center.z + planes[p].w;
+		const double radius = std::abs(double(planes[p].x)) * extents.x + std::abs(double(planes[p].y)) * extents.y +
+			std::abs(double(planes[p].z)) * extents.z;
+
+		visible = visible && distance + radius >= 0.0;
+		margin = std::min(margin, std::abs(distance + radius));
+	}
+
+	return visible;
+}
+
+TEST(FrustumPlanesMatchTheProjection)
+{
+	XMFLOAT4 planes[6];
+	FrustumCuller::ExtractPlanes(GetViewProjection(), planes);
+
+	// Normals point inside: left, right, bottom, top, near and far.
+	const float diagonal = 0.70710678f;
+	const XMFLOAT4 expected[6] =
+	{
+		{ diagonal, 0.0f, diagonal, 0.0f },
+		{ -diagonal, 0.0f, diagonal, 0.0f },
+		{ 0.0f, diagonal, diagonal, 0.0f },
+		{ 0.0f, -diagonal, diagonal, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, -1.0f },
+		{ 0.0f, 0.0f, -1.0f, 100.0f }
+	};
+
+	for (size_t p = 0; p < 6; p++)
+	{
+		CHECK(std::abs(planes[p].x - expected[p].x) < 1e-5f);
+		CHECK(std::abs(planes[p].y - expected[p].y) < 1e-5f);
+		CHECK(std::abs(planes[p].z - expected[p].z) < 1e-5f);
+		CHECK(std::abs(planes[p].w - expected[p].w) < 1e-3f * std::max(1.0f, std::abs(expected[p].w)));
+	}
+}
+
+TEST(FrustumCullingHandlesEdgeCases)
+{
+	const XMFLOAT3 unit(1.0f, 1.0f, 1.0f);
+
+	CHECK(IsBoxVisible(XMFLOAT3(0.0f, 0.0f, 10.0f), unit));
+	CHECK(!IsBoxVisible(XMFLOAT3(0.0f, 0.0f, -10.0f), unit));
+	CHECK(!IsBoxVisible(XMFLOAT3(0.0f, 0.0f, 200.0f), unit));
+
+	// Close to the near, far and left planes from either side.
+	CHECK(IsBoxVisible(XMFLOAT3(0.0f, 0.0f, 0.01f), unit));
+	CHECK(!IsBoxVisible(XMFLOAT3(0.0f, 0.0f, -0.01f), unit));
+	CHECK(IsBoxVisible(XMFLOAT3(0.0f, 0.0f, 100.99f), unit));
+	CHECK(!IsBoxVisible(XMFLOAT3(0.0f, 0.0f, 101.01f), unit));
+	CHECK(IsBoxVisible(XMFLOAT3(-11.99f, 0.0f, 10.0f), unit));
+	CHECK(!IsBoxVisible(XMFLOAT3(-12.01f, 0.0f, 10.0f), unit));
+
+	// A box around the whole frustum and boxes without size.
+	CHECK(IsBoxVisible(XMFLOAT3(0.0f, 0.0f, 50.0f), XMFLOAT3(1000.0f, 1000.0f, 1000.0f)));
+	CHECK(IsBoxVisible(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(0.0f, 0.0f, 0.0f)));
+	CHECK(!IsBoxVisible(XMFLOAT3(0.0f, 20.0f, 10.0f), XMFLOAT3(0.0f, 0.0f, 0.0f)));
+
+	// Outside of the edge between the left and the far plane, but crossing both: kept, culling is conservative.
+	CHECK(IsBoxVisible(XMFLOAT3(-108.0f, 0.0f, 104.0f), XMFLOAT3(4.5f, 4.5f, 4.5f)));
+}
+
+TEST(FrustumCullingMatchesScalarReference)
+{
+	FrustumCuller culler;
+	culler.SetFrustum(GetViewProjection());
+
+	XMFLOAT4 planes[6];
+	FrustumCuller::ExtractPlanes(GetViewProjection(), planes);
+
+	std::mt19937 random(20);
+	std::uniform_real_distribution<float> position(-120.0f, 120.0f), size(0.0f, 8.0f), unit(0.0f, 1.0f);
+
+	// Not a multiple of 4, the padding boxes must not count.
+	const size_t num_boxes = 5003;
+	std::vector<XMFLOAT3> centers, extents;
+
+	for (size_t i = 0; i < num_boxes; i++)
+	{
+		centers.emplace_back(position(random), position(random), position(random));
+		extents.emplace_back(size(random), size(random), size(random));
+		CHECK_EQUAL(uint32_t(i), culler.AddBox(centers.back(), extents.back()));
+	}
+
+	const size_t num_visible = culler.Cull();
+	CHECK_EQUAL(num_boxes, culler.GetNumBoxes());
+
+	size_t num_reference_visible = 0;
+	size_t num_checked = 0;
+
+	for (size_t i = 0; i < num_boxes; i++)
+	{
+		const bool visible = culler.IsVisible(static_cast<uint32_t>(i));
+		num_reference_visible += visible ? 1 : 0;
+
+		double margin;
+		const bool reference = IsBoxVisibleReference(planes, centers[i], extents[i], margin);
+
+		// Skip boxes that touch a plane within the float precision.
+		if (margin > 1e-3)
+		{
+			CHECK_EQUAL(reference, visible);
+			num_checked++;
+		}
+
+		// Never cull a box with a point in the frustum.
+		if (!visible)
+		{
+			for (size_t s = 0; s < 16; s++)
+			{
+				const XMFLOAT3 point(
+					centers[i].x + (unit(random) * 2.0f - 1.0f) * extents[i].x,
+					centers[i].y + (unit(random) * 2.0f - 1.0f) * extents[i].y,
+					centers[i].z + (unit(random) * 2.0f - 1.0f) * extents[i].z);
+
+				CHECK(!IsInsideFrustum(point));
+			}
+		}
+	}
+
+	CHECK_EQUAL(num_reference_visible, num_visible);
+	CHECK(num_checked > num_boxes * 99 / 100);
+	CHECK(num_visible > 0 && num_visible < num_boxes);
+}
+
+TEST(FrustumCullingOnThreadPoolMatchesCallingThread)
+{
+	FrustumCuller culler;
+	culler.SetFrustum(GetViewProjection());
+
+	std::mt19937 random(21);
+	std::uniform_real_distribution<float> position(-120.0f, 120.0f), size(0.0f, 4.0f);
+
+	for (size_t i = 0; i < FrustumCuller::parallel_grain_size_ * 3 + 1; i++)
+	{
+		culler.AddBox(XMFLOAT3(position(random), position(random), position(random)), XMFLOAT3(size(random), size(random), size(random)));
+	}
+
+	const size_t num_visible = culler.Cull();
+	const std::vector<uint8_t> visibility = culler.GetVisibility();
+
+	ThreadPool thread_pool(4);
+	CHECK_EQUAL(num_visible, culler.Cull(&thread_pool));
+	CHECK(visibility == culler.GetVisibility());
+}
+
+TEST(FrustumCullerBoundsContainTransformedBox)
+{
+	const Mesh::BoundingVolume bounds = { XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(0.5f, 1.0f, 2.0f), 0.0f };
+	const XMMATRIX model_matrix = XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixRotationRollPitchYaw(0.3f, 0.7f, -0.2f) *
+		XMMatrixTranslation(-3.0f, 4.0f, 20.0f);
+
+	FrustumCuller culler;
+	culler.SetFrustum(GetViewProjection());
+	culler.AddBounds(model_matrix, bounds);
+
+	XMFLOAT3 corner_min(FLT_MAX, FLT_MAX, FLT_MAX), corner_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (uint32_t c = 0; c < 8; c++)
+	{
+		const XMVECTOR corner = XMVectorSet(
+			bounds.Center.x + (c & 1 ? bounds.Extents.x : -bounds.Extents.x),
+			bounds.Center.y + (c & 2 ? bounds.Extents.y : -bounds.Extents.y),
+			bounds.Center.z + (c & 4 ? bounds.Extents.z : -bounds.Extents.z), 1.0f);
+
+		XMFLOAT3 world;
+		XMStoreFloat3(&world, XMVector3TransformCoord(corner, model_matrix));
+
+		corner_min = XMFLOAT3(std::min(corner_min.x, world.x), std::min(corner_min.y, world.y), std::min(corner_min.z, world.z));
+		corner_max = XMFLOAT3(std::max(corner_max.x, world.x), std::max(corner_max.y, world.y), std::max(corner_max.z, world.z));
+	}
+
+	// Every plane keeps the half space beyond a face of the box around the corners, shifted by offset. Planes are tested
+	// one by one, so the world box passes when it reaches past every shifted face.
+	const auto cull_against_box = [&](float offset)
+	{
+		const XMFLOAT4 planes[6] =
+		{
+			{ 1.0f, 0.0f, 0.0f, -(corner_max.x + offset) },
+			{ -1.0f, 0.0f, 0.0f, corner_min.x - offset },
+			{ 0.0f, 1.0f, 0.0f, -(corner_max.y + offset) },
+			{ 0.0f, -1.0f, 0.0f, corner_min.y - offset },
+			{ 0.0f, 0.0f, 1.0f, -(corner_max.z + offset) },
+			{ 0.0f, 0.0f, -1.0f, corner_min.z - offset }
+		};
+
+		culler.SetPlanes(planes);
+		culler.Cull();
+
+		return culler.IsVisible(0);
+	};
+
+	CHECK(cull_against_box(-1e-3f));
+	CHECK(!cull_against_box(1e-3f));
+}
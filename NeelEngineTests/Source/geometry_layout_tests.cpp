@@ -0,0 +1,227 @@
+#include "test_framework.h"
+
+#include "geometry_layout.h"
+
+#include <algorithm>
+#include <limits>
+
+// Source data of a submesh, the bytes of every stream and of the indices are filled with a value that identifies them.
+struct TestSubMesh
+{
+	std::array<std::vector<uint8_t>, GeometryLayout::num_streams_>	Streams;
+	std::vector<uint8_t>											Indices;
+
+	TestSubMesh(const std::array<uint64_t, GeometryLayout::num_streams_>& stream_sizes, uint64_t index_size, uint8_t id)
+	{
+		for (size_t slot = 0; slot < GeometryLayout::num_streams_; slot++)
+		{
+			Streams[slot].assign(static_cast<size_t>(stream_sizes[slot]), static_cast<uint8_t>(id * 16 + slot));
+		}
+
+		Indices.assign(static_cast<size_t>(index_size), static_cast<uint8_t>(id * 16 + 15));
+	}
+
+	uint32_t AddTo(GeometryLayout& layout) const
+	{
+		std::array<const void*, GeometryLayout::num_streams_> streams;
+		std::array<uint64_t, GeometryLayout::num_streams_> stream_sizes;
+
+		for (size_t slot = 0; slot < GeometryLayout::num_streams_; slot++)
+		{
+			streams[slot]		= Streams[slot].empty() ? nullptr : Streams[slot].data();
+			stream_sizes[slot]	= Streams[slot].size();
+		}
+
+		return layout.AddSubMesh(streams, stream_sizes, Indices.empty() ? nullptr : Indices.data(), Indices.size());
+	}
+};
+
+// Check that the vertex streams and indices of sub_mesh ended up at vertex_data and index_data.
+static void CheckSubMeshData(const TestSubMesh& sub_mesh, const uint8_t* vertex_data, const uint8_t* index_data)
+{
+	for (const auto& stream : sub_mesh.Streams)
+	{
+		CHECK(std::equal(stream.begin(), stream.end(), vertex_data));
+		vertex_data += stream.size();
+	}
+
+	CHECK(std::equal(sub_mesh.Indices.begin(), sub_mesh.Indices.end(), index_data));
+}
+
+TEST(GeometryLayoutAlignsSubMeshesInOneBuffer)
+{
+	GeometryLayout layout(1024, 16);
+
+	const TestSubMesh first({ 12, 8, 0, 4 }, 6, 1);
+	const TestSubMesh second({ 36, 24, 0, 0 }, 18, 2);
+
+	CHECK_EQUAL(0u, first.AddTo(layout));
+	CHECK_EQUAL(1u, second.AddTo(layout));
+	CHECK_EQUAL(size_t(2), layout.GetNumSubMeshes());
+
+	const auto& first_layout = layout.GetSubMesh(0);
+	CHECK_EQUAL(0u, first_layout.VertexBuffer);
+	CHECK_EQUAL(uint64_t(0), first_layout.VertexOffset);
+	CHECK_EQUAL(uint64_t(24), first_layout.VertexSize);
+	CHECK_EQUAL(0u, first_layout.IndexBuffer);
+	CHECK_EQUAL(uint64_t(0), first_layout.IndexOffset);
+	CHECK_EQUAL(uint64_t(6), first_layout.IndexSize);
+
+	// The second submesh starts at the next multiple of the alignment.
+	const auto& second_layout = layout.GetSubMesh(1);
+	CHECK_EQUAL(0u, second_layout.VertexBuffer);
+	CHECK_EQUAL(uint64_t(32), second_layout.VertexOffset);
+	CHECK_EQUAL(uint64_t(60), second_layout.VertexSize);
+	CHECK_EQUAL(0u, second_layout.IndexBuffer);
+	CHECK_EQUAL(uint64_t(16), second_layout.IndexOffset);
+
+	CHECK_EQUAL(size_t(1), layout.GetVertexBuffers().size());
+	CHECK_EQUAL(size_t(1), layout.GetIndexBuffers().size());
+	CHECK_EQUAL(uint64_t(92), layout.GetVertexBuffers()[0].Size);
+	CHECK_EQUAL(uint64_t(34), layout.GetIndexBuffers()[0].Size);
+}
+
+TEST(GeometryLayoutSplitsBuffersAtMaximumSize)
+{
+	GeometryLayout layout(64, 16);
+
+	const TestSubMesh first({ 40, 0, 0, 0 }, 8, 1);
+	const TestSubMesh second({ 20, 0, 0, 0 }, 8, 2);
+	const TestSubMesh oversized({ 100, 0, 0, 0 }, 8, 3);
+	const TestSubMesh last({ 4, 0, 0, 0 }, 8, 4);
+
+	first.AddTo(layout);
+	second.AddTo(layout);
+	oversized.AddTo(layout);
+	last.AddTo(layout);
+
+	// 48 + 20 exceeds the maximum, so the second submesh starts a new vertex buffer.
+	CHECK_EQUAL(0u, layout.GetSubMesh(0).VertexBuffer);
+	CHECK_EQUAL(1u, layout.GetSubMesh(1).VertexBuffer);
+	CHECK_EQUAL(uint64_t(0), layout.GetSubMesh(1).VertexOffset);
+
+	// A submesh larger than the maximum gets a buffer of its own, the next one starts another buffer.
+	CHECK_EQUAL(2u, layout.GetSubMesh(2).VertexBuffer);
+	CHECK_EQUAL(3u, layout.GetSubMesh(3).VertexBuffer);
+
+	const auto& vertex_buffers = layout.GetVertexBuffers();
+	CHECK_EQUAL(size_t(4), vertex_buffers.size());
+	CHECK_EQUAL(uint64_t(40), vertex_buffers[0].Size);
+	CHECK_EQUAL(uint64_t(20), vertex_buffers[1].Size);
+	CHECK_EQUAL(uint64_t(100), vertex_buffers[2].Size);
+	CHECK_EQUAL(uint64_t(4), vertex_buffers[3].Size);
+
+	// The indices of all submeshes fit in one buffer.
+	CHECK_EQUAL(size_t(1), layout.GetIndexBuffers().size());
+	CHECK_EQUAL(uint64_t(48), layout.GetSubMesh(3).IndexOffset);
+	CHECK_EQUAL(uint64_t(56), layout.GetIndexBuffers()[0].Size);
+}
+
+TEST(GeometryLayoutPlacesStagingBuffersBackToBack)
+{
+	GeometryLayout layout(64, 16);
+
+	TestSubMesh({ 40, 0, 0, 0 }, 8, 1).AddTo(layout);
+	TestSubMesh({ 20, 0, 0, 0 }, 70, 2).AddTo(layout);
+
+	// Vertex buffers first, then index buffers, every buffer starts aligned.
+	const auto& vertex_buffers	= layout.GetVertexBuffers();
+	const auto& index_buffers	= layout.GetIndexBuffers();
+	CHECK_EQUAL(uint64_t(0), vertex_buffers[0].StagingOffset);
+	CHECK_EQUAL(uint64_t(48), vertex_buffers[1].StagingOffset);
+	CHECK_EQUAL(uint64_t(80), index_buffers[0].StagingOffset);
+	CHECK_EQUAL(uint64_t(96), index_buffers[1].StagingOffset);
+
+	CHECK_EQUAL(uint64_t(96 + 70), layout.GetStagingSize());
+
+	// Two vertex buffers, two index buffers and the staging buffer.
+	CHECK_EQUAL(size_t(5), layout.GetNumAllocations());
+}
+
+TEST(GeometryLayoutCountsNoAllocationsWhenEmpty)
+{
+	GeometryLayout layout;
+	CHECK_EQUAL(uint64_t(0), layout.GetStagingSize());
+	CHECK_EQUAL(size_t(0), layout.GetNumAllocations());
+
+	// Submeshes without data do not need buffers either.
+	TestSubMesh({ 0, 0, 0, 0 }, 0, 1).AddTo(layout);
+	CHECK_EQUAL(size_t(0), layout.GetNumAllocations());
+}
+
+TEST(GeometryLayoutWritesStaging)
+{
+	GeometryLayout layout(64, 16);
+
+	const std::vector<TestSubMesh> sub_meshes =
+	{
+		TestSubMesh({ 12, 8, 0, 4 }, 6, 1),
+		TestSubMesh({ 20, 0, 8, 0 }, 12, 2),
+		TestSubMesh({ 100, 0, 0, 0 }, 30, 3),
+		TestSubMesh({ 4, 4, 4, 4 }, 40, 4),
+	};
+
+	for (const auto& sub_mesh : sub_meshes)
+	{
+		sub_mesh.AddTo(layout);
+	}
+
+	std::vector<uint8_t> staging(static_cast<size_t>(layout.GetStagingSize()), 0xcd);
+	layout.WriteStaging(staging.data());
+
+	for (uint32_t i = 0; i < sub_meshes.size(); i++)
+	{
+		const auto& sub_mesh = layout.GetSubMesh(i);
+		CheckSubMeshData(sub_meshes[i],
+			staging.data() + layout.GetVertexBuffers()[sub_mesh.VertexBuffer].StagingOffset + sub_mesh.VertexOffset,
+			staging.data() + layout.GetIndexBuffers()[sub_mesh.IndexBuffer].StagingOffset + sub_mesh.IndexOffset);
+	}
+}
+
+TEST(GeometryLayoutWritesStagingFromSubMesh)
+{
+	GeometryLayout layout(std::numeric_limits<uint64_t>::max(), 16);
+
+	const std::vector<TestSubMesh> sub_meshes =
+	{
+		TestSubMesh({ 12, 8, 0, 4 }, 6, 1),
+		TestSubMesh({ 20, 0, 8, 0 }, 12, 2),
+		TestSubMesh({ 4, 4, 4, 4 }, 40, 3),
+	};
+
+	for (const auto& sub_mesh : sub_meshes)
+	{
+		sub_mesh.AddTo(layout);
+	}
+
+	// Only the data from the second submesh on is written, relative to its offsets.
+	const auto& first = layout.GetSubMesh(1);
+	std::vector<uint8_t> vertex_data(static_cast<size_t>(layout.GetVertexBuffers()[0].Size - first.VertexOffset), 0xcd);
+	std::vector<uint8_t> index_data(static_cast<size_t>(layout.GetIndexBuffers()[0].Size - first.IndexOffset), 0xcd);
+	layout.WriteStaging(1, vertex_data.data(), index_data.data());
+
+	for (uint32_t i = 1; i < sub_meshes.size(); i++)
+	{
+		const auto& sub_mesh = layout.GetSubMesh(i);
+		CheckSubMeshData(sub_meshes[i],
+			vertex_data.data() + (sub_mesh.VertexOffset - first.VertexOffset),
+			index_data.data() + (sub_mesh.IndexOffset - first.IndexOffset));
+	}
+
+	// Starting past the last submesh writes nothing.
+	std::vector<uint8_t> untouched(16, 0xcd);
+	layout.WriteStaging(static_cast<uint32_t>(sub_meshes.size()), untouched.data(), untouched.data());
+	CHECK(std::all_of(untouched.begin(), untouched.end(), [](uint8_t byte) { return byte == 0xcd; }));
+}
+
+TEST(GeometryLayoutRejectsStagingFromSubMeshWithSeveralBuffers)
+{
+	GeometryLayout layout(64, 16);
+
+	TestSubMesh({ 40, 0, 0, 0 }, 8, 1).AddTo(layout);
+	TestSubMesh({ 40, 0, 0, 0 }, 8, 2).AddTo(layout);
+
+	std::vector<uint8_t> vertex_data(80);
+	std::vector<uint8_t> index_data(16);
+	CHECK_THROWS(layout.WriteStaging(0, vertex_data.data(), index_data.data()));
+}
@@ -0,0 +1,97 @@
+#include "test_framework.h"
+#include "gltf_sax_parser.h"
+
+#include <fstream>
+#include <iterator>
+
+static std::vector<uint8_t> ReadText(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("Could not open " + filename);
+	}
+
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static fx::gltf::Document ParseSax(const std::string& text)
+{
+	fx::gltf::Document document;
+	const uint8_t* begin = reinterpret_cast<const uint8_t*>(text.data());
+	SaxDocumentParser::Parse(begin, begin + text.size(), document);
+	return document;
+}
+
+// fx-gltf documents have no comparison operator, compare their serialized form instead.
+static bool SameDocument(const fx::gltf::Document& a, const fx::gltf::Document& b)
+{
+	return nlohmann::json(a) == nlohmann::json(b);
+}
+
+TEST(SaxParserMatchesDomOnBundledAssets)
+{
+	for (const char* asset : { "Sponza/Sponza.gltf", "SciFiHelmet/SciFiHelmet.gltf", "BasicGeometry/Cube.gltf", "BasicGeometry/Sphere.gltf",
+		"BasicGeometry/Cone.gltf" })
+	{
+		const std::vector<uint8_t> text = ReadText(GetAssetDirectory() + asset);
+
+		const fx::gltf::Document dom_document = nlohmann::json::parse(text.begin(), text.end());
+
+		fx::gltf::Document sax_document;
+		SaxDocumentParser::Parse(text.data(), text.data() + text.size(), sax_document);
+
+		CHECK(!sax_document.meshes.empty());
+		CHECK(SameDocument(dom_document, sax_document));
+	}
+}
+
+TEST(SaxParserMatchesDomOnNestedValues)
+{
+	const std::string text = R"({
+		"asset": { "version": "2.0", "generator": "test" },
+		"scene": 0,
+		"scenes": [ { "nodes": [ 0, 1 ] } ],
+		"nodes": [
+			{ "name": "root", "children": [ 1 ], "translation": [ 1.0, 2.0, 3.0 ], "extras": { "a": [ 1, { "b": null } ] } },
+			{ "mesh": 0, "matrix": [ 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 1 ] }
+		],
+		"meshes": [ { "primitives": [ { "attributes": { "POSITION": 0 }, "indices": 1, "mode": 4 } ] } ],
+		"accessors": [
+			{ "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 0, 0, 0 ], "max": [ 1, 1, 0 ] },
+			{ "bufferView": 1, "componentType": 5123, "count": 3, "type": "SCALAR" }
+		],
+		"bufferViews": [ { "buffer": 0, "byteLength": 36 }, { "buffer": 0, "byteOffset": 36, "byteLength": 6 } ],
+		"buffers": [ { "byteLength": 42, "uri": "triangle.bin" } ],
+		"extensionsUsed": [ "KHR_materials_unlit" ],
+		"extras": { "flag": true, "value": -1.5 }
+	})";
+
+	const fx::gltf::Document dom_document = nlohmann::json::parse(text);
+	const fx::gltf::Document sax_document = ParseSax(text);
+
+	CHECK_EQUAL(2u, sax_document.nodes.size());
+	CHECK_EQUAL(1u, sax_document.nodes[0].children.size());
+	CHECK_EQUAL(2u, sax_document.accessors.size());
+	CHECK_EQUAL(std::string("test"), sax_document.asset.generator);
+	CHECK(SameDocument(dom_document, sax_document));
+}
+
+TEST(SaxParserKeepsLastDuplicateCollection)
+{
+	const std::string text = R"({ "asset": { "version": "2.0" }, "nodes": [ { "name": "a" }, { "name": "b" } ], "nodes": [ { "name": "c" } ] })";
+
+	const fx::gltf::Document dom_document = nlohmann::json::parse(text);
+	const fx::gltf::Document sax_document = ParseSax(text);
+
+	CHECK_EQUAL(1u, sax_document.nodes.size());
+	CHECK(SameDocument(dom_document, sax_document));
+}
+
+TEST(SaxParserRejectsInvalidDocuments)
+{
+	// Malformed JSON, a top level value that is not an object and a document without an asset.
+	CHECK_THROWS(ParseSax(R"({ "asset": { "version": "2.0" }, "nodes": [ { "name": "a" } )"));
+	CHECK_THROWS(ParseSax(R"([ { "asset": { "version": "2.0" } } ])"));
+	CHECK_THROWS(ParseSax(R"({ "nodes": [] })"));
+}
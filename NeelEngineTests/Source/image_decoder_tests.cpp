@@ -0,0 +1,730 @@
+#include "test_framework.h"
+#include "image_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+// Baseline JPEGs of the gradients of ExpectedJpegColor at quality 90 with the tables of the JPEG standard: 37x27 YCbCr
+// 4:2:0 with a restart interval of 2 MCUs, 19x11 grayscale and 16x8 RGB 4:4:4 with an Adobe marker.
+static const uint8_t jpeg_ycbcr_420[] =
+{
+	0xff, 0xd8, 0xff, 0xdb, 0x00, 0x84, 0x00, 0x03, 0x02, 0x02, 0x03, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x04, 0x03, 0x03, 0x04, 0x05, 0x08, 0x05,
+	0x05, 0x04, 0x04, 0x05, 0x0a, 0x07, 0x07, 0x06, 0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d, 0x0e, 0x12, 0x10, 0x0d, 0x0e, 0x11,
+	0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10, 0x11, 0x13, 0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f, 0x17, 0x18, 0x16, 0x14, 0x18, 0x12, 0x14, 0x15, 0x14, 0x01,
+	0x03, 0x04, 0x04, 0x05, 0x04, 0x05, 0x09, 0x05, 0x05, 0x09, 0x14, 0x0d, 0x0b, 0x0d, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x1b, 0x00,
+	0x25, 0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff, 0xc4, 0x01, 0xa2, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x10, 0x00, 0x02, 0x01,
+	0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41,
+	0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62,
+	0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+	0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+	0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2,
+	0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8,
+	0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3,
+	0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04,
+	0x04, 0x00, 0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32,
+	0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1,
+	0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53,
+	0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82,
+	0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8,
+	0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5,
+	0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff,
+	0xdd, 0x00, 0x04, 0x00, 0x02, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00, 0xb1, 0xa7, 0xeb, 0xbd, 0x3e,
+	0x6a, 0xe9, 0x74, 0xfd, 0x77, 0xa7, 0xcd, 0x5e, 0x2d, 0xa7, 0xeb, 0xbd, 0x3e, 0x6a, 0xe9, 0x74, 0xfd, 0x77, 0xa7, 0xcd, 0x5f, 0x2a, 0xb8, 0x7f,
+	0xc8, 0xfc, 0x93, 0x2a, 0xca, 0xb6, 0xd0, 0xf6, 0x9d, 0x3f, 0x5d, 0xe9, 0xf3, 0x57, 0x4b, 0xa7, 0xeb, 0xbd, 0x3e, 0x6a, 0xf1, 0x6d, 0x3f, 0x5d,
+	0xe9, 0xf3, 0x57, 0x4b, 0xa7, 0xeb, 0xbd, 0x3e, 0x6a, 0xdd, 0x70, 0xff, 0x00, 0x91, 0xfb, 0x26, 0x55, 0x95, 0x6d, 0xa1, 0xff, 0xd0, 0xfa, 0x62,
+	0xdb, 0x5d, 0xfd, 0xdf, 0xde, 0xa9, 0xbf, 0xb7, 0x7f, 0xda, 0xaf, 0x35, 0xb6, 0xd7, 0x7f, 0x77, 0xf7, 0xaa, 0x6f, 0xed, 0xdf, 0xf6, 0xab, 0xc1,
+	0xff, 0x00, 0x57, 0xfc, 0x8f, 0xd4, 0xe9, 0xe5, 0x5e, 0xe2, 0xd0, 0xf8, 0x9b, 0x4f, 0xd7, 0x7a, 0x7c, 0xd5, 0xd2, 0x69, 0xfa, 0xef, 0x4f, 0x9a,
+	0xbc, 0x9f, 0x4f, 0x99, 0xf8, 0xf9, 0x8d, 0x74, 0x9a, 0x7c, 0xcf, 0xc7, 0xcc, 0x6b, 0xfa, 0x01, 0x65, 0x14, 0x8f, 0xcb, 0x32, 0xac, 0x04, 0x34,
+	0x3f, 0xff, 0xd1, 0xe2, 0x74, 0xfd, 0x77, 0xa7, 0xcd, 0x5d, 0x2e, 0x9f, 0xae, 0xf4, 0xf9, 0xab, 0xc9, 0xb4, 0xf9, 0x9f, 0x8f, 0x98, 0xd7, 0x4b,
+	0xa7, 0xcc, 0xfc, 0x7c, 0xc6, 0xbf, 0x69, 0x59, 0x45, 0x23, 0xf6, 0x4c, 0xab, 0x01, 0x0d, 0x0f, 0x55, 0xb6, 0xd7, 0x7f, 0x77, 0xf7, 0xaa, 0x6f,
+	0xed, 0xdf, 0xf6, 0xab, 0x85, 0xb6, 0x99, 0xfc, 0xbf, 0xbc, 0x6a, 0x6f, 0x39, 0xff, 0x00, 0xbc, 0x6b, 0x5f, 0xec, 0x8a, 0x47, 0xe9, 0x54, 0xf0,
+	0x10, 0xe4, 0x47, 0xff, 0xd9,
+};
+
+static const uint8_t jpeg_gray[] =
+{
+	0xff, 0xd8, 0xff, 0xdb, 0x00, 0x84, 0x00, 0x03, 0x02, 0x02, 0x03, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x04, 0x03, 0x03, 0x04, 0x05, 0x08, 0x05,
+	0x05, 0x04, 0x04, 0x05, 0x0a, 0x07, 0x07, 0x06, 0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d, 0x0e, 0x12, 0x10, 0x0d, 0x0e, 0x11,
+	0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10, 0x11, 0x13, 0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f, 0x17, 0x18, 0x16, 0x14, 0x18, 0x12, 0x14, 0x15, 0x14, 0x01,
+	0x03, 0x04, 0x04, 0x05, 0x04, 0x05, 0x09, 0x05, 0x05, 0x09, 0x14, 0x0d, 0x0b, 0x0d, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0xff, 0xc0, 0x00, 0x0b, 0x08, 0x00, 0x0b, 0x00,
+	0x13, 0x01, 0x01, 0x11, 0x00, 0xff, 0xc4, 0x01, 0xa2, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05,
+	0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22,
+	0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17,
+	0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a,
+	0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+	0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8,
+	0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5,
+	0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9,
+	0xfa, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+	0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77, 0x00,
+	0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1,
+	0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27,
+	0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+	0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88,
+	0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5,
+	0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2,
+	0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00,
+	0x00, 0x3f, 0x00, 0xf9, 0x1b, 0xe1, 0x25, 0xb7, 0xfa, 0x9e, 0x3d, 0x2b, 0xed, 0x5f, 0x84, 0x96, 0xdf, 0xea, 0x78, 0xf4, 0xaf, 0xa8, 0xf4, 0xbb,
+	0x6f, 0xf8, 0x97, 0xc1, 0xc7, 0xf0, 0xd7, 0xe4, 0xbf, 0xc2, 0x45, 0x1f, 0xb9, 0xe3, 0xd2, 0xbe, 0xd5, 0xf8, 0x48, 0xa3, 0xf7, 0x3c, 0x7a, 0x57,
+	0xd4, 0x9a, 0x5a, 0x8f, 0xec, 0xf8, 0x38, 0xfe, 0x1a, 0xff, 0xd9,
+};
+
+static const uint8_t jpeg_rgb_adobe[] =
+{
+	0xff, 0xd8, 0xff, 0xee, 0x00, 0x0e, 0x41, 0x64, 0x6f, 0x62, 0x65, 0x00, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x84, 0x00, 0x03,
+	0x02, 0x02, 0x03, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x04, 0x03, 0x03, 0x04, 0x05, 0x08, 0x05, 0x05, 0x04, 0x04, 0x05, 0x0a, 0x07, 0x07, 0x06,
+	0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d, 0x0e, 0x12, 0x10, 0x0d, 0x0e, 0x11, 0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10, 0x11, 0x13,
+	0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f, 0x17, 0x18, 0x16, 0x14, 0x18, 0x12, 0x14, 0x15, 0x14, 0x01, 0x03, 0x04, 0x04, 0x05, 0x04, 0x05, 0x09, 0x05,
+	0x05, 0x09, 0x14, 0x0d, 0x0b, 0x0d, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x08, 0x00, 0x10, 0x03, 0x01, 0x11, 0x00, 0x02, 0x11, 0x01,
+	0x03, 0x11, 0x01, 0xff, 0xc4, 0x01, 0xa2, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04,
+	0x04, 0x00, 0x00, 0x01, 0x7d, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14,
+	0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19,
+	0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54,
+	0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84,
+	0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa,
+	0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7,
+	0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0x01,
+	0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77, 0x00, 0x01, 0x02,
+	0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1,
+	0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29,
+	0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63,
+	0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a,
+	0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7,
+	0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4,
+	0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11,
+	0x03, 0x11, 0x00, 0x3f, 0x00, 0xf9, 0x0f, 0xc2, 0x3f, 0xc1, 0x5f, 0xd1, 0x1f, 0xdb, 0x7e, 0x67, 0xf3, 0xc6, 0x1b, 0x03, 0xe4, 0x7b, 0x5f, 0x84,
+	0x7f, 0x82, 0x8f, 0xed, 0xbf, 0x33, 0xea, 0xf0, 0xd8, 0x1f, 0x23, 0xff, 0xd9,
+};
+
+static uint32_t ComputeCrc(const uint8_t* data, size_t size)
+{
+	uint32_t crc = 0xffffffff;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		for (uint32_t bit = 0; bit < 8; bit++)
+		{
+			crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+		}
+	}
+
+	return ~crc;
+}
+
+static void AppendBigEndian32(std::vector<uint8_t>& data, uint32_t value)
+{
+	for (int32_t shift = 24; shift >= 0; shift -= 8)
+	{
+		data.push_back(static_cast<uint8_t>(value >> shift));
+	}
+}
+
+static void AppendPngChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& chunk)
+{
+	AppendBigEndian32(png, static_cast<uint32_t>(chunk.size()));
+
+	const size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), chunk.begin(), chunk.end());
+
+	AppendBigEndian32(png, ComputeCrc(&png[start], png.size() - start));
+}
+
+// zlib stream of stored deflate blocks of up to block_size bytes.
+static std::vector<uint8_t> StoreZlib(const std::vector<uint8_t>& data, size_t block_size)
+{
+	std::vector<uint8_t> stream = { 0x78, 0x01 };
+
+	size_t offset = 0;
+	do
+	{
+		const size_t size = std::min(block_size, data.size() - offset);
+		const bool final_block = offset + size == data.size();
+
+		stream.push_back(final_block ? 1 : 0);
+		stream.push_back(static_cast<uint8_t>(size));
+		stream.push_back(static_cast<uint8_t>(size >> 8));
+		stream.push_back(static_cast<uint8_t>(~size));
+		stream.push_back(static_cast<uint8_t>(~size >> 8));
+		stream.insert(stream.end(), data.begin() + offset, data.begin() + offset + size);
+
+		offset += size;
+	} while (offset < data.size());
+
+	uint32_t a = 1, b = 0;
+	for (uint8_t byte : data)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	AppendBigEndian32(stream, b << 16 | a);
+	return stream;
+}
+
+// Forward PNG filter of a row, the inverse of the decoder's.
+static void FilterPngRow(uint32_t filter, const std::vector<uint8_t>& row, const std::vector<uint8_t>& previous, size_t pixel_size,
+	std::vector<uint8_t>& output)
+{
+	output.push_back(static_cast<uint8_t>(filter));
+
+	for (size_t i = 0; i < row.size(); i++)
+	{
+		const int32_t left = i >= pixel_size ? row[i - pixel_size] : 0;
+		const int32_t up = previous[i];
+		const int32_t up_left = i >= pixel_size ? previous[i - pixel_size] : 0;
+
+		int32_t prediction = 0;
+		switch (filter)
+		{
+		case 1:
+			prediction = left;
+			break;
+		case 2:
+			prediction = up;
+			break;
+		case 3:
+			prediction = (left + up) >> 1;
+			break;
+		case 4:
+		{
+			const int32_t estimate = left + up - up_left;
+			const int32_t distance_left = std::abs(estimate - left);
+			const int32_t distance_up = std::abs(estimate - up);
+			const int32_t distance_up_left = std::abs(estimate - up_left);
+
+			prediction = distance_left <= distance_up && distance_left <= distance_up_left ? left : distance_up <= distance_up_left ? up : up_left;
+			break;
+		}
+		}
+
+		output.push_back(static_cast<uint8_t>(row[i] - prediction));
+	}
+}
+
+struct TestPng
+{
+	TestPng(uint32_t width, uint32_t height, uint32_t color_type, uint32_t bit_depth, bool interlaced = false)
+		: Width(width)
+		, Height(height)
+		, ColorType(color_type)
+		, BitDepth(bit_depth)
+		, Interlaced(interlaced)
+	{
+	}
+
+	uint32_t				Width;
+	uint32_t				Height;
+	uint32_t				ColorType;
+	uint32_t				BitDepth;
+	bool					Interlaced;
+
+	// RGB entries of the palette and alpha of its first entries, and the transparent gray or RGB samples.
+	std::vector<uint8_t>	Palette;
+	std::vector<uint8_t>	PaletteAlpha;
+	std::vector<uint32_t>	ColorKey;
+
+	uint32_t GetNumChannels() const
+	{
+		static const uint32_t num_channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+		return num_channels[ColorType];
+	}
+
+	// Sample of a channel of a pixel, palette indices stay within the palette.
+	uint32_t GetSample(uint32_t x, uint32_t y, uint32_t channel) const
+	{
+		const uint32_t sample = x * 7 + y * 13 + channel * 5 + x * y;
+		return ColorType == 3 ? sample % (Palette.size() / 3) : sample % (1u << BitDepth);
+	}
+
+	// Expected RGBA of a pixel, as the PNG specification defines it.
+	std::array<uint8_t, 4> GetPixel(uint32_t x, uint32_t y) const
+	{
+		const uint32_t max_sample = (1u << BitDepth) - 1;
+
+		uint32_t samples[4] = {};
+		for (uint32_t channel = 0; channel < GetNumChannels(); channel++)
+		{
+			samples[channel] = GetSample(x, y, channel);
+		}
+
+		switch (ColorType)
+		{
+		case 0:
+		{
+			const uint8_t gray = static_cast<uint8_t>(samples[0] * 255 / max_sample);
+			const bool transparent = !ColorKey.empty() && samples[0] == ColorKey[0];
+			return { gray, gray, gray, static_cast<uint8_t>(transparent ? 0 : 255) };
+		}
+		case 2:
+		{
+			const bool transparent = !ColorKey.empty() && samples[0] == ColorKey[0] && samples[1] == ColorKey[1] && samples[2] == ColorKey[2];
+			return { uint8_t(samples[0]), uint8_t(samples[1]), uint8_t(samples[2]), static_cast<uint8_t>(transparent ? 0 : 255) };
+		}
+		case 3:
+			return { Palette[samples[0] * 3], Palette[samples[0] * 3 + 1], Palette[samples[0] * 3 + 2],
+				static_cast<uint8_t>(samples[0] < PaletteAlpha.size() ? PaletteAlpha[samples[0]] : 255) };
+		case 4:
+			return { uint8_t(samples[0]), uint8_t(samples[0]), uint8_t(samples[0]), uint8_t(samples[1]) };
+		default:
+			return { uint8_t(samples[0]), uint8_t(samples[1]), uint8_t(samples[2]), uint8_t(samples[3]) };
+		}
+	}
+
+	// Encode with stored deflate blocks, cycling through the five filters from row to row.
+	std::vector<uint8_t> Encode() const
+	{
+		static const uint32_t adam7_passes[7][4] =
+		{
+			{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 }
+		};
+		static const uint32_t single_pass[1][4] = { { 0, 0, 1, 1 } };
+
+		const uint32_t bits_per_pixel = GetNumChannels() * BitDepth;
+		const size_t pixel_size = std::max(bits_per_pixel / 8, 1u);
+
+		std::vector<uint8_t> filtered;
+		uint32_t filter = 0;
+
+		for (uint32_t pass = 0; pass < (Interlaced ? 7u : 1u); pass++)
+		{
+			const uint32_t* pass_layout = Interlaced ? adam7_passes[pass] : single_pass[0];
+
+			std::vector<uint8_t> previous;
+			for (uint32_t y = pass_layout[1]; y < Height; y += pass_layout[3])
+			{
+				std::vector<uint8_t> row;
+				uint32_t bit = 0;
+
+				for (uint32_t x = pass_layout[0]; x < Width; x += pass_layout[2])
+				{
+					for (uint32_t channel = 0; channel < GetNumChannels(); channel++, bit += BitDepth)
+					{
+						if (bit % 8 == 0)
+						{
+							row.push_back(0);
+						}
+
+						row.back() |= static_cast<uint8_t>(GetSample(x, y, channel) << (8 - BitDepth - bit % 8));
+					}
+				}
+
+				if (row.empty())
+					break;
+
+				previous.resize(row.size(), 0);
+				FilterPngRow(filter++ % 5, row, previous, pixel_size, filtered);
+				previous = row;
+			}
+		}
+
+		std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+		std::vector<uint8_t> header;
+		AppendBigEndian32(header, Width);
+		AppendBigEndian32(header, Height);
+		header.insert(header.end(), { uint8_t(BitDepth), uint8_t(ColorType), 0, 0, uint8_t(Interlaced ? 1 : 0) });
+		AppendPngChunk(png, "IHDR", header);
+
+		if (!Palette.empty())
+		{
+			AppendPngChunk(png, "PLTE", Palette);
+		}
+
+		if (!PaletteAlpha.empty())
+		{
+			AppendPngChunk(png, "tRNS", PaletteAlpha);
+		}
+		else if (!ColorKey.empty())
+		{
+			std::vector<uint8_t> key;
+			for (uint32_t sample : ColorKey)
+			{
+				key.push_back(static_cast<uint8_t>(sample >> 8));
+				key.push_back(static_cast<uint8_t>(sample));
+			}
+
+			AppendPngChunk(png, "tRNS", key);
+		}
+
+		// Split the image data over two chunks, the decoder has to join them.
+		const std::vector<uint8_t> compressed = StoreZlib(filtered, 100);
+		const size_t split = compressed.size() / 2;
+		AppendPngChunk(png, "IDAT", std::vector<uint8_t>(compressed.begin(), compressed.begin() + split));
+		AppendPngChunk(png, "IDAT", std::vector<uint8_t>(compressed.begin() + split, compressed.end()));
+
+		AppendPngChunk(png, "IEND", {});
+		return png;
+	}
+};
+
+// Copy of a PNG with the data of every chunk of a type replaced.
+static std::vector<uint8_t> ReplacePngChunk(const std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& chunk)
+{
+	std::vector<uint8_t> result(png.begin(), png.begin() + 8);
+
+	for (size_t position = 8; position + 12 <= png.size();)
+	{
+		const size_t length = size_t(png[position]) << 24 | size_t(png[position + 1]) << 16 | size_t(png[position + 2]) << 8 | png[position + 3];
+		const char* chunk_type = reinterpret_cast<const char*>(&png[position + 4]);
+
+		if (std::memcmp(chunk_type, type, 4) == 0)
+		{
+			AppendPngChunk(result, type, chunk);
+		}
+		else
+		{
+			result.insert(result.end(), png.begin() + position, png.begin() + position + 12 + length);
+		}
+
+		position += 12 + length;
+	}
+
+	return result;
+}
+
+static void CheckPngDecodes(const TestPng& test)
+{
+	const std::vector<uint8_t> png = test.Encode();
+
+	ImageDecoder::Image image;
+	CHECK(ImageDecoder::Decode(png.data(), png.size(), image));
+	CHECK_EQUAL(test.Width, image.Width);
+	CHECK_EQUAL(test.Height, image.Height);
+
+	if (image.Width != test.Width || image.Height != test.Height)
+		return;
+
+	uint32_t num_mismatches = 0;
+	for (uint32_t y = 0; y < test.Height; y++)
+	{
+		for (uint32_t x = 0; x < test.Width; x++)
+		{
+			const std::array<uint8_t, 4> expected = test.GetPixel(x, y);
+			num_mismatches += std::memcmp(expected.data(), &image.Pixels[(y * size_t(test.Width) + x) * 4], 4) != 0;
+		}
+	}
+
+	CHECK_EQUAL(0u, num_mismatches);
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("Could not open " + filename);
+	}
+
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// FNV-1a hash of the decoded pixels.
+static uint32_t HashPixels(const std::vector<uint8_t>& pixels)
+{
+	uint32_t hash = 2166136261u;
+	for (uint8_t byte : pixels)
+	{
+		hash = (hash ^ byte) * 16777619u;
+	}
+
+	return hash;
+}
+
+// Size from the PNG header or the JPEG frame header, to check the decoder against.
+static bool ReadEncodedSize(const std::vector<uint8_t>& data, uint32_t& width, uint32_t& height)
+{
+	if (ImageDecoder::GetFormat(data.data(), data.size()) == ImageDecoder::Format::Png)
+	{
+		width = uint32_t(data[16]) << 24 | uint32_t(data[17]) << 16 | uint32_t(data[18]) << 8 | data[19];
+		height = uint32_t(data[20]) << 24 | uint32_t(data[21]) << 16 | uint32_t(data[22]) << 8 | data[23];
+		return true;
+	}
+
+	for (size_t i = 2; i + 8 < data.size(); i += 2 + (data[i + 2] << 8 | data[i + 3]))
+	{
+		if (data[i] == 0xff && (data[i + 1] == 0xc0 || data[i + 1] == 0xc1))
+		{
+			height = data[i + 5] << 8 | data[i + 6];
+			width = data[i + 7] << 8 | data[i + 8];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Analytic colors of the embedded JPEGs, the RGB gradient of the color images and the gray one.
+static std::array<int32_t, 3> ExpectedJpegColor(uint32_t x, uint32_t y, bool gray)
+{
+	if (gray)
+	{
+		const int32_t value = 20 + 10 * x + y;
+		return { value, value, value };
+	}
+
+	return { int32_t(40 + 5 * x), int32_t(200 - 6 * y), int32_t(60 + 2 * x + 3 * y) };
+}
+
+static void CheckJpegDecodes(const uint8_t* data, size_t size, uint32_t width, uint32_t height, bool gray, int32_t tolerance)
+{
+	ImageDecoder::Image image;
+	CHECK(ImageDecoder::Decode(data, size, image));
+	CHECK_EQUAL(width, image.Width);
+	CHECK_EQUAL(height, image.Height);
+
+	if (image.Width != width || image.Height != height)
+		return;
+
+	int32_t max_error = 0;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t* pixel = &image.Pixels[(y * size_t(width) + x) * 4];
+			const std::array<int32_t, 3> expected = ExpectedJpegColor(x, y, gray);
+
+			for (size_t channel = 0; channel < 3; channel++)
+			{
+				max_error = std::max(max_error, std::abs(pixel[channel] - expected[channel]));
+			}
+
+			CHECK_EQUAL(255, int32_t(pixel[3]));
+		}
+	}
+
+	CHECK(max_error <= tolerance);
+}
+
+TEST(ImageDecoderDetectsFormats)
+{
+	const std::vector<uint8_t> png = TestPng{ 1, 1, 0, 8 }.Encode();
+	const uint8_t unknown[] = { 'D', 'D', 'S', ' ', 0, 0, 0, 0 };
+
+	CHECK(ImageDecoder::GetFormat(png.data(), png.size()) == ImageDecoder::Format::Png);
+	CHECK(ImageDecoder::GetFormat(jpeg_gray, sizeof(jpeg_gray)) == ImageDecoder::Format::Jpeg);
+	CHECK(ImageDecoder::GetFormat(unknown, sizeof(unknown)) == ImageDecoder::Format::Unknown);
+	CHECK(ImageDecoder::GetFormat(png.data(), 4) == ImageDecoder::Format::Unknown);
+	CHECK(ImageDecoder::GetFormat(nullptr, 0) == ImageDecoder::Format::Unknown);
+
+	ImageDecoder::Image image;
+	CHECK(!ImageDecoder::Decode(unknown, sizeof(unknown), image));
+}
+
+TEST(ImageDecoderInflatesHuffmanBlocks)
+{
+	// zlib.compress at level 9, a block with the fixed codes and one with dynamic codes.
+	const uint8_t fixed[] =
+	{
+		0x78, 0xda, 0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0xf0, 0x40, 0xa2, 0x14, 0x01, 0x46, 0x3e, 0x06, 0x96
+	};
+	const uint8_t dynamic[] =
+	{
+		0x78, 0xda, 0xed, 0xcc, 0x31, 0x0e, 0xc0, 0x30, 0x08, 0x04, 0xc1, 0xb7, 0x02, 0x07, 0x9c, 0x31, 0xee, 0xf3, 0xfc, 0x38,
+		0x52, 0x1e, 0x90, 0xf4, 0x9e, 0x7a, 0xb5, 0x22, 0xa2, 0x86, 0x60, 0xb5, 0x3a, 0xdb, 0x72, 0x1a, 0x57, 0xb4, 0x4f, 0xef,
+		0x90, 0x81, 0x26, 0x56, 0x25, 0xa4, 0x8b, 0x19, 0x8e, 0xcd, 0x23, 0x77, 0x2b, 0xc8, 0x5a, 0x60, 0x63, 0xc8, 0x1b, 0x2f,
+		0xda, 0x4c, 0x6b, 0xba, 0xee, 0x36, 0x60, 0x2a, 0x8f, 0xb3, 0xfe, 0xbb, 0xbe, 0x8e, 0xcf, 0x6e, 0x89, 0x89, 0x2d, 0x31
+	};
+
+	const std::string hello = "Hello, Hello, Hello!";
+	CHECK(ImageDecoder::Inflate(fixed, sizeof(fixed)) == std::vector<uint8_t>(hello.begin(), hello.end()));
+
+	std::vector<uint8_t> expected;
+	for (uint32_t i = 0; i < 400; i++)
+	{
+		expected.push_back(static_cast<uint8_t>(i * i / 7 % 13 + 'a'));
+	}
+	expected.resize(700, 'x');
+
+	CHECK(ImageDecoder::Inflate(dynamic, sizeof(dynamic)) == expected);
+
+	// Stored blocks, including an empty one.
+	const std::vector<uint8_t> stored = StoreZlib(expected, 64);
+	CHECK(ImageDecoder::Inflate(stored.data(), stored.size()) == expected);
+
+	const std::vector<uint8_t> empty = StoreZlib({}, 64);
+	CHECK(ImageDecoder::Inflate(empty.data(), empty.size()).empty());
+}
+
+TEST(ImageDecoderRejectsCorruptDeflateData)
+{
+	const uint8_t bad_header[] = { 0x78, 0x9d, 0x03, 0x00 };
+	const uint8_t preset_dictionary[] = { 0x78, 0xbb, 0x03, 0x00 };
+	const uint8_t reserved_block[] = { 0x78, 0x01, 0x07, 0x00 };
+	const uint8_t bad_stored_length[] = { 0x78, 0x01, 0x01, 0x05, 0x00, 0x00, 0x00 };
+
+	// A fixed block with a distance before the start of the data: a single match of length 3 at distance 1.
+	const uint8_t bad_distance[] = { 0x78, 0x01, 0x03, 0x02, 0x00 };
+
+	CHECK_THROWS(ImageDecoder::Inflate(bad_header, sizeof(bad_header)));
+	CHECK_THROWS(ImageDecoder::Inflate(preset_dictionary, sizeof(preset_dictionary)));
+	CHECK_THROWS(ImageDecoder::Inflate(reserved_block, sizeof(reserved_block)));
+	CHECK_THROWS(ImageDecoder::Inflate(bad_stored_length, sizeof(bad_stored_length)));
+	CHECK_THROWS(ImageDecoder::Inflate(bad_distance, sizeof(bad_distance)));
+
+	const uint8_t dynamic_start[] = { 0x78, 0xda, 0xed, 0xcc, 0x31, 0x0e, 0xc0, 0x30 };
+	CHECK_THROWS(ImageDecoder::Inflate(dynamic_start, sizeof(dynamic_start)));
+}
+
+TEST(ImageDecoderDecodesPngColorTypes)
+{
+	for (bool interlaced : { false, true })
+	{
+		for (uint32_t bit_depth : { 1u, 2u, 4u, 8u })
+		{
+			TestPng gray = { 13, 11, 0, bit_depth, interlaced };
+			CheckPngDecodes(gray);
+
+			gray.ColorKey = { gray.GetSample(1, 1, 0) };
+			CheckPngDecodes(gray);
+
+			TestPng palette = { 13, 11, 3, bit_depth, interlaced };
+			for (uint32_t i = 0; i < std::min(1u << bit_depth, 200u); i++)
+			{
+				palette.Palette.insert(palette.Palette.end(), { uint8_t(i * 40), uint8_t(255 - i * 3), uint8_t(i * i) });
+			}
+			CheckPngDecodes(palette);
+
+			palette.PaletteAlpha = { 0, 17 };
+			CheckPngDecodes(palette);
+		}
+
+		TestPng rgb = { 17, 9, 2, 8, interlaced };
+		CheckPngDecodes(rgb);
+
+		rgb.ColorKey = { rgb.GetSample(2, 3, 0), rgb.GetSample(2, 3, 1), rgb.GetSample(2, 3, 2) };
+		CheckPngDecodes(rgb);
+
+		CheckPngDecodes({ 17, 9, 4, 8, interlaced });
+		CheckPngDecodes({ 17, 9, 6, 8, interlaced });
+
+		// Images smaller than the first Adam7 passes leave them empty.
+		CheckPngDecodes({ 1, 1, 6, 8, interlaced });
+		CheckPngDecodes({ 3, 2, 2, 8, interlaced });
+	}
+}
+
+TEST(ImageDecoderDecodesBundledPngs)
+{
+	// Hashes from an independent decode with Python's zlib.
+	const struct
+	{
+		const char*	Filename;
+		uint32_t	Width;
+		uint32_t	Height;
+		uint32_t	Hash;
+	} images[] =
+	{
+		{ "SciFiHelmet/SciFiHelmet_AmbientOcclusion.png", 2048, 2048, 0xf6d26c6a },
+		// Sponza has PNGs with a .jpg extension, the format comes from the signature.
+		{ "Sponza/16275776544635328252.jpg", 1024, 1024, 0x0039facb },
+		{ "Sponza/white.jpg", 4, 4, 0x3c55a585 }
+	};
+
+	for (const auto& expected : images)
+	{
+		const std::vector<uint8_t> data = ReadFile(GetAssetDirectory() + expected.Filename);
+		CHECK(ImageDecoder::GetFormat(data.data(), data.size()) == ImageDecoder::Format::Png);
+
+		ImageDecoder::Image image;
+		CHECK(ImageDecoder::Decode(data.data(), data.size(), image));
+		CHECK_EQUAL(expected.Width, image.Width);
+		CHECK_EQUAL(expected.Height, image.Height);
+		CHECK_EQUAL(expected.Hash, HashPixels(image.Pixels));
+	}
+}
+
+TEST(ImageDecoderDecodesJpegGradients)
+{
+	// 4:2:0 chroma is replicated from the average of 2x2 pixels, which costs a few levels on the steep gradient.
+	CheckJpegDecodes(jpeg_ycbcr_420, sizeof(jpeg_ycbcr_420), 37, 27, false, 8);
+	CheckJpegDecodes(jpeg_rgb_adobe, sizeof(jpeg_rgb_adobe), 16, 8, false, 2);
+	CheckJpegDecodes(jpeg_gray, sizeof(jpeg_gray), 19, 11, true, 2);
+}
+
+TEST(ImageDecoderDecodesSponzaTextures)
+{
+	uint32_t num_jpegs = 0;
+
+	for (const auto& entry : std::filesystem::directory_iterator(GetAssetDirectory() + "Sponza"))
+	{
+		if (entry.path().extension() != ".jpg")
+			continue;
+
+		const std::vector<uint8_t> data = ReadFile(entry.path().string());
+		num_jpegs += ImageDecoder::GetFormat(data.data(), data.size()) == ImageDecoder::Format::Jpeg;
+
+		uint32_t width = 0, height = 0;
+		CHECK(ReadEncodedSize(data, width, height));
+
+		ImageDecoder::Image image;
+		CHECK(ImageDecoder::Decode(data.data(), data.size(), image));
+		CHECK_EQUAL(width, image.Width);
+		CHECK_EQUAL(height, image.Height);
+		CHECK_EQUAL(size_t(width) * height * 4, image.Pixels.size());
+	}
+
+	CHECK(num_jpegs > 0);
+}
+
+TEST(ImageDecoderLeavesUnsupportedVariants)
+{
+	ImageDecoder::Image image;
+
+	// 16 bit PNGs and progressive JPEGs are left to DirectXTex.
+	const std::vector<uint8_t> png16 = TestPng{ 2, 2, 2, 16 }.Encode();
+	CHECK(!ImageDecoder::Decode(png16.data(), png16.size(), image));
+
+	const uint8_t baseline_frame[] = { 0xff, 0xc0 };
+	std::vector<uint8_t> progressive(jpeg_gray, jpeg_gray + sizeof(jpeg_gray));
+	const auto frame = std::search(progressive.begin(), progressive.end(), std::begin(baseline_frame), std::end(baseline_frame));
+	CHECK(frame != progressive.end());
+
+	frame[1] = 0xc2;
+	CHECK(!ImageDecoder::Decode(progressive.data(), progressive.size(), image));
+}
+
+TEST(ImageDecoderRejectsCorruptImages)
+{
+	ImageDecoder::Image image;
+
+	std::vector<uint8_t> png = TestPng{ 13, 11, 6, 8 }.Encode();
+	for (size_t size : { size_t(8), size_t(20), png.size() / 2, png.size() - 13 })
+	{
+		CHECK_THROWS(ImageDecoder::Decode(png.data(), size, image));
+	}
+
+	for (size_t size : { size_t(3), size_t(100), sizeof(jpeg_ycbcr_420) / 2, sizeof(jpeg_ycbcr_420) - 2 })
+	{
+		CHECK_THROWS(ImageDecoder::Decode(jpeg_ycbcr_420, size, image));
+	}
+
+	// Palette indices past the end of the palette.
+	TestPng palette = { 4, 4, 3, 8 };
+	palette.Palette = { 255, 0, 0, 0, 255, 0, 0, 0, 255 };
+
+	const std::vector<uint8_t> full_palette = palette.Encode();
+	CHECK(ImageDecoder::Decode(full_palette.data(), full_palette.size(), image));
+
+	const std::vector<uint8_t> short_palette = ReplacePngChunk(full_palette, "PLTE", { 255, 0, 0 });
+	CHECK_THROWS(ImageDecoder::Decode(short_palette.data(), short_palette.size(), image));
+
+	const std::vector<uint8_t> empty = TestPng{ 0, 4, 6, 8 }.Encode();
+	CHECK_THROWS(ImageDecoder::Decode(empty.data(), empty.size(), image));
+}
@@ -0,0 +1,211 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "instance_batcher.h"
+
+#include <map>
+#include <random>
+#include <tuple>
+
+// Transforms are translations along x by the index of the draw, so the instance data tells which draw it came from.
+static uint32_t GetDrawIndex(const InstanceData& instance)
+{
+	return static_cast<uint32_t>(XMVectorGetX(instance.ModelMatrix.r[3]));
+}
+
+struct TestDraw
+{
+	uint32_t	Mesh;
+	uint32_t	SubMesh;
+	uint32_t	Lod;
+};
+
+static std::vector<TestDraw> MakeRandomDraws(uint32_t num_draws, uint32_t seed)
+{
+	std::mt19937 random(seed);
+
+	std::vector<TestDraw> draws(num_draws);
+	for (auto& draw : draws)
+	{
+		draw.Mesh		= random() % 5;
+		draw.SubMesh	= random() % 3;
+		draw.Lod		= random() % 2;
+	}
+
+	return draws;
+}
+
+static void AddDraws(InstanceBatcher& batcher, const std::vector<TestDraw>& draws)
+{
+	for (uint32_t i = 0; i < draws.size(); i++)
+	{
+		const uint32_t transform = batcher.AddTransform(XMMatrixTranslation(static_cast<float>(i), 0.0f, 0.0f));
+		batcher.AddDraw(draws[i].Mesh, draws[i].SubMesh, draws[i].Lod, transform);
+	}
+}
+
+// Check the batches of the last Build against the visible draws grouped by mesh, submesh and level in the order they were added.
+static void CheckBatches(const InstanceBatcher& batcher, const std::vector<TestDraw>& draws, const std::vector<uint8_t>* visibility)
+{
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t>, std::vector<uint32_t>> expected;
+	for (uint32_t i = 0; i < draws.size(); i++)
+	{
+		if (!visibility || (*visibility)[i])
+		{
+			expected[std::make_tuple(draws[i].Mesh, draws[i].SubMesh, draws[i].Lod)].push_back(i);
+		}
+	}
+
+	const auto& batches = batcher.GetBatches();
+	const auto& instance_data = batcher.GetInstanceData();
+	CHECK_EQUAL(expected.size(), batches.size());
+
+	// The map and the batches are both ordered by mesh, submesh and level.
+	uint32_t next_instance = 0;
+	auto group = expected.begin();
+
+	for (size_t i = 0; i < batches.size() && group != expected.end(); i++, group++)
+	{
+		const InstanceBatcher::Batch& batch = batches[i];
+		CHECK(std::make_tuple(batch.Mesh, batch.SubMesh, batch.Lod) == group->first);
+
+		// Batches cover the instance data without gaps.
+		CHECK_EQUAL(next_instance, batch.FirstInstance);
+		CHECK_EQUAL(group->second.size(), size_t(batch.NumInstances));
+
+		for (uint32_t j = 0; j < batch.NumInstances && j < group->second.size(); j++)
+		{
+			CHECK_EQUAL(group->second[j], GetDrawIndex(instance_data[batch.FirstInstance + j]));
+		}
+
+		next_instance += batch.NumInstances;
+	}
+
+	CHECK_EQUAL(instance_data.size(), size_t(next_instance));
+}
+
+TEST(InstanceBatcherGroupsDrawsByMeshSubMeshAndLod)
+{
+	const std::vector<TestDraw> draws = MakeRandomDraws(1000, 7);
+
+	InstanceBatcher batcher;
+	AddDraws(batcher, draws);
+	CHECK_EQUAL(draws.size(), batcher.GetNumDraws());
+	CHECK_EQUAL(draws.size(), batcher.GetNumTransforms());
+
+	batcher.Build();
+	CheckBatches(batcher, draws, nullptr);
+
+	// Building again from the sorted draws gives the same batches.
+	batcher.Build();
+	CheckBatches(batcher, draws, nullptr);
+
+	batcher.Clear();
+	batcher.Build();
+	CHECK(batcher.GetBatches().empty());
+	CHECK(batcher.GetInstanceData().empty());
+}
+
+TEST(InstanceBatcherSharesTransformsBetweenSubMeshes)
+{
+	InstanceBatcher batcher;
+
+	const XMMATRIX model_matrix = XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(1.0f, 2.0f, 3.0f);
+	const uint32_t transform = batcher.AddTransform(model_matrix);
+
+	batcher.AddDraw(3, 1, 0, transform);
+	batcher.AddDraw(3, 0, 0, transform);
+	batcher.Build();
+
+	const auto& batches = batcher.GetBatches();
+	CHECK_EQUAL(size_t(2), batches.size());
+	CHECK_EQUAL(size_t(2), batcher.GetInstanceData().size());
+	CHECK_EQUAL(size_t(1), batcher.GetNumTransforms());
+
+	if (batches.size() == 2)
+	{
+		CHECK_EQUAL(0u, batches[0].SubMesh);
+		CHECK_EQUAL(1u, batches[1].SubMesh);
+	}
+
+	const XMMATRIX inverse_transpose = XMMatrixTranspose(XMMatrixInverse(nullptr, model_matrix));
+	for (const auto& instance : batcher.GetInstanceData())
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			CHECK(XMVector4NearEqual(model_matrix.r[row], instance.ModelMatrix.r[row], XMVectorReplicate(1e-5f)));
+			CHECK(XMVector4NearEqual(inverse_transpose.r[row], instance.InverseTransposeModelMatrix.r[row], XMVectorReplicate(1e-5f)));
+		}
+	}
+}
+
+TEST(InstanceBatcherSkipsInvisibleDraws)
+{
+	const std::vector<TestDraw> draws = MakeRandomDraws(1000, 11);
+
+	std::mt19937 random(13);
+
+	// Every draw of mesh 0 is culled, so its batches are left out entirely.
+	std::vector<uint8_t> visibility(draws.size());
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		visibility[i] = draws[i].Mesh != 0 && random() % 3 != 0;
+	}
+
+	InstanceBatcher batcher;
+	AddDraws(batcher, draws);
+
+	batcher.Build(&visibility);
+	CheckBatches(batcher, draws, &visibility);
+
+	for (const auto& batch : batcher.GetBatches())
+	{
+		CHECK(batch.Mesh != 0);
+		CHECK(batch.NumInstances > 0);
+	}
+
+	// The flags are in the order the draws were added, not in the order of the last Build.
+	batcher.Build(&visibility);
+	CheckBatches(batcher, draws, &visibility);
+
+	const std::vector<uint8_t> none_visible(draws.size(), 0);
+	batcher.Build(&none_visible);
+	CHECK(batcher.GetBatches().empty());
+	CHECK(batcher.GetInstanceData().empty());
+
+	batcher.Build();
+	CheckBatches(batcher, draws, nullptr);
+}
+
+TEST(InstanceBatcherRejectsInvalidDraws)
+{
+	InstanceBatcher batcher;
+
+	// No transform was added yet.
+	CHECK_THROWS(batcher.AddDraw(0, 0, 0, 0));
+
+	const uint32_t transform = batcher.AddTransform(XMMatrixIdentity());
+	CHECK_THROWS(batcher.AddDraw(0, 0, 0, transform + 1));
+
+	// Indices that do not fit into the sort key.
+	CHECK_THROWS(batcher.AddDraw(InstanceBatcher::max_meshes_ + 1, 0, 0, transform));
+	CHECK_THROWS(batcher.AddDraw(0, InstanceBatcher::max_sub_meshes_ + 1, 0, transform));
+	CHECK_THROWS(batcher.AddDraw(0, 0, InstanceBatcher::max_lods_ + 1, transform));
+	CHECK_EQUAL(size_t(0), batcher.GetNumDraws());
+
+	// The largest indices survive the round trip through the key.
+	batcher.AddDraw(InstanceBatcher::max_meshes_, InstanceBatcher::max_sub_meshes_, InstanceBatcher::max_lods_, transform);
+	batcher.Build();
+
+	const auto& batches = batcher.GetBatches();
+	CHECK_EQUAL(size_t(1), batches.size());
+
+	if (!batches.empty())
+	{
+		CHECK_EQUAL(uint32_t(InstanceBatcher::max_meshes_), batches[0].Mesh);
+		CHECK_EQUAL(uint32_t(InstanceBatcher::max_sub_meshes_), batches[0].SubMesh);
+		CHECK_EQUAL(uint32_t(InstanceBatcher::max_lods_), batches[0].Lod);
+		CHECK_EQUAL(0u, batches[0].FirstInstance);
+		CHECK_EQUAL(1u, batches[0].NumInstances);
+	}
+}
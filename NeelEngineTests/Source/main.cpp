@@ -0,0 +1,7 @@
+#include "test_framework.h"
+
+// Usage: NeelEngineTests [filter], runs the tests whose name contains filter.
+int main(int argc, char** argv)
+{
+	return TestRegistry::RunAll(argc > 1 ? argv[1] : "") > 0 ? 1 : 0;
+}
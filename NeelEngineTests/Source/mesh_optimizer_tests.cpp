@@ -0,0 +1,155 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "mesh_test_helpers.h"
+#include "mesh_optimizer.h"
+
+using Triangle = std::array<float, 9>;
+
+// Positions of the triangles of a primitive, every triangle rotated to start at its smallest vertex so the winding is kept.
+static std::vector<Triangle> GetTriangles(const Mesh::PrimitiveData& primitive)
+{
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+
+	std::vector<Triangle> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<std::array<float, 3>, 3> corners;
+		for (size_t k = 0; k < 3; k++)
+		{
+			const float* position = MeshTestHelpers::GetPosition(primitive, indices[i + k]);
+			corners[k] = { position[0], position[1], position[2] };
+		}
+
+		std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+
+		Triangle triangle;
+		for (size_t k = 0; k < 3; k++)
+		{
+			std::copy(corners[k].begin(), corners[k].end(), triangle.begin() + k * 3);
+		}
+
+		triangles.push_back(triangle);
+	}
+
+	return triangles;
+}
+
+static size_t CountUnique(const std::vector<uint32_t>& remap)
+{
+	size_t count = 0;
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		count += remap[v] == v ? 1 : 0;
+	}
+
+	return count;
+}
+
+TEST(WeldMergesIdenticalVertices)
+{
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(4, 3, false);
+	CHECK_EQUAL(size_t(4 * 3 * 6), primitive.NumElements[Mesh::vertex_slot_]);
+
+	const std::vector<uint32_t> remap = MeshOptimizer::WeldVertices(primitive);
+	CHECK_EQUAL(size_t(5 * 4), CountUnique(remap));
+
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		// Every vertex maps to the first vertex that is equal to it.
+		CHECK(remap[v] <= v);
+		CHECK(remap[remap[v]] == remap[v]);
+		CHECK(std::equal(MeshTestHelpers::GetPosition(primitive, v), MeshTestHelpers::GetPosition(primitive, v) + 3,
+			MeshTestHelpers::GetPosition(primitive, remap[v])));
+	}
+}
+
+TEST(WeldMergesVerticesWithinEpsilon)
+{
+	Mesh::PrimitiveData primitive = MeshTestHelpers::CreatePrimitive(
+		{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.00001f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.00001f, 0.0f },
+		{ 0, 1, 2, 3, 4, 5 });
+
+	// Bit identical welding keeps the slightly moved copies.
+	CHECK_EQUAL(size_t(6), CountUnique(MeshOptimizer::WeldVertices(primitive)));
+
+	const std::vector<uint32_t> remap = MeshOptimizer::WeldVertices(primitive, 1e-3f);
+	CHECK_EQUAL(size_t(4), CountUnique(remap));
+	CHECK_EQUAL(1u, remap[3]);
+	CHECK_EQUAL(2u, remap[5]);
+}
+
+TEST(WeldKeepsVerticesWithDifferentJoints)
+{
+	Mesh::PrimitiveData primitive = MeshTestHelpers::CreatePrimitive(
+		{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f }, { 0, 1, 2, 3, 1, 2 });
+
+	primitive.Skin.resize(4, { { 0, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } });
+	CHECK_EQUAL(size_t(3), CountUnique(MeshOptimizer::WeldVertices(primitive)));
+
+	primitive.Skin[3].Joints[0] = 1;
+	CHECK_EQUAL(size_t(4), CountUnique(MeshOptimizer::WeldVertices(primitive)));
+}
+
+TEST(OptimizeWeldsAndNarrowsIndices)
+{
+	Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(8, 8, false);
+	const std::vector<Triangle> triangles = GetTriangles(primitive);
+
+	std::vector<Mesh::PrimitiveData> chunks = MeshOptimizer::OptimizePrimitive(primitive);
+	CHECK_EQUAL(size_t(1), chunks.size());
+
+	const Mesh::PrimitiveData& chunk = chunks[0];
+	CHECK_EQUAL(DXGI_FORMAT_R16_UINT, chunk.IndexFormat);
+	CHECK_EQUAL(size_t(9 * 9), chunk.NumElements[Mesh::vertex_slot_]);
+	CHECK_EQUAL(size_t(9 * 9), chunk.NumElements[Mesh::texcoord0_slot_]);
+	CHECK_EQUAL(uint32_t(8 * 8 * 6), chunk.IndexCount);
+
+	// The triangles are reordered, but the same triangles with the same winding remain.
+	std::vector<Triangle> optimized = GetTriangles(chunk);
+	std::vector<Triangle> expected = triangles;
+	std::sort(optimized.begin(), optimized.end());
+	std::sort(expected.begin(), expected.end());
+	CHECK(optimized == expected);
+}
+
+TEST(SplitKeepsChunksWithin16BitIndices)
+{
+	// 301 x 301 vertices do not fit 16-bit indices.
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(300, 300);
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+
+	const std::vector<Mesh::PrimitiveData> chunks = MeshOptimizer::SplitPrimitive(primitive, indices);
+	CHECK_EQUAL(size_t(2), chunks.size());
+
+	std::vector<Triangle> split_triangles;
+	for (const auto& chunk : chunks)
+	{
+		const size_t vertex_count = chunk.NumElements[Mesh::vertex_slot_];
+		CHECK(vertex_count <= MeshOptimizer::max_chunk_vertices_);
+		CHECK_EQUAL(DXGI_FORMAT_R16_UINT, chunk.IndexFormat);
+
+		// Vertices are numbered by first use, so every vertex is referenced.
+		const std::vector<uint32_t> chunk_indices = MeshOptimizer::ReadIndices(chunk);
+		CHECK_EQUAL(vertex_count, size_t(*std::max_element(chunk_indices.begin(), chunk_indices.end()) + 1));
+
+		const std::vector<Triangle> triangles = GetTriangles(chunk);
+		split_triangles.insert(split_triangles.end(), triangles.begin(), triangles.end());
+	}
+
+	// Chunks are consecutive ranges of the triangle list.
+	CHECK(split_triangles == GetTriangles(primitive));
+}
+
+TEST(OptimizeSkipsOtherTopologies)
+{
+	Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(2, 2, false);
+	primitive.Topology = D3D_PRIMITIVE_TOPOLOGY_LINELIST;
+
+	const uint8_t* indices = primitive.Indices;
+
+	std::vector<Mesh::PrimitiveData> chunks = MeshOptimizer::OptimizePrimitive(primitive);
+	CHECK_EQUAL(size_t(1), chunks.size());
+	CHECK(chunks[0].Indices == indices);
+	CHECK_EQUAL(DXGI_FORMAT_R32_UINT, chunks[0].IndexFormat);
+}
@@ -0,0 +1,169 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "mesh_test_helpers.h"
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+#include "lod_selector.h"
+
+#include <set>
+
+// A grid that bulges along z, so collapses have a cost.
+static Mesh::PrimitiveData CreateBump(uint32_t size)
+{
+	Mesh::PrimitiveData grid = MeshTestHelpers::CreateGrid(size, size);
+
+	std::vector<float> positions(MeshTestHelpers::GetPosition(grid, 0), MeshTestHelpers::GetPosition(grid, 0) + grid.NumElements[Mesh::vertex_slot_] * 3);
+	for (size_t v = 0; v < positions.size(); v += 3)
+	{
+		positions[v + 2] = std::sin(positions[v] * XM_PI / size) * std::sin(positions[v + 1] * XM_PI / size) * size * 0.25f;
+	}
+
+	return MeshTestHelpers::CreatePrimitive(positions, MeshOptimizer::ReadIndices(grid));
+}
+
+TEST(SimplifyReachesTargetIndexCount)
+{
+	const Mesh::PrimitiveData primitive = CreateBump(16);
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	float error = -1.0f;
+	const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(indices, MeshTestHelpers::GetPosition(primitive, 0), vertex_count,
+		indices.size() / 4, FLT_MAX, &error);
+
+	CHECK(!simplified.empty());
+	CHECK(simplified.size() <= indices.size() / 4);
+	CHECK_EQUAL(size_t(0), simplified.size() % 3);
+	CHECK(error > 0.0f);
+
+	// Only vertices of the original are referenced, and all border vertices are kept.
+	const std::set<uint32_t> referenced(simplified.begin(), simplified.end());
+	CHECK(*referenced.rbegin() < vertex_count);
+
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		const float* position = MeshTestHelpers::GetPosition(primitive, v);
+		const bool border = position[0] == 0.0f || position[1] == 0.0f || position[0] == 16.0f || position[1] == 16.0f;
+
+		if (border)
+			CHECK(referenced.count(v) == 1);
+	}
+}
+
+TEST(SimplifyKeepsPlanarSurfaces)
+{
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(16, 16);
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+
+	float error = -1.0f;
+	const std::vector<uint32_t> simplified = MeshSimplifier::Simplify(indices, MeshTestHelpers::GetPosition(primitive, 0),
+		primitive.NumElements[Mesh::vertex_slot_], 0, FLT_MAX, &error);
+
+	// Collapses within the plane do not move the surface.
+	CHECK(simplified.size() < indices.size());
+	CHECK(error >= 0.0f && error < 1e-4f);
+}
+
+TEST(SimplifyStopsAtTargetError)
+{
+	const Mesh::PrimitiveData primitive = CreateBump(16);
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+	const float* positions = MeshTestHelpers::GetPosition(primitive, 0);
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	float coarse_error = 0.0f;
+	const std::vector<uint32_t> coarse = MeshSimplifier::Simplify(indices, positions, vertex_count, 0, FLT_MAX, &coarse_error);
+
+	// A target error below the error of the coarsest result keeps more triangles.
+	const float target_error = coarse_error * 0.1f;
+
+	float fine_error = 0.0f;
+	const std::vector<uint32_t> fine = MeshSimplifier::Simplify(indices, positions, vertex_count, 0, target_error, &fine_error);
+
+	CHECK(coarse_error > 0.0f);
+	CHECK(fine_error <= target_error);
+	CHECK(fine.size() > coarse.size());
+	CHECK(fine.size() < indices.size());
+}
+
+TEST(LodChainHalvesTrianglesWithGrowingErrors)
+{
+	Mesh::PrimitiveData primitive = CreateBump(32);
+	const uint32_t index_count = primitive.IndexCount;
+	const size_t vertex_count = primitive.NumElements[Mesh::vertex_slot_];
+
+	MeshSimplifier::BuildLodChain(primitive);
+
+	const auto& lods = primitive.Lods;
+	CHECK(lods.size() > 2 && lods.size() <= MeshSimplifier::max_lods_);
+	if (lods.empty())
+		return;
+
+	CHECK_EQUAL(0u, lods[0].FirstIndex);
+	CHECK_EQUAL(index_count, lods[0].IndexCount);
+	CHECK_EQUAL(0.0f, lods[0].Error);
+
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+	CHECK(std::all_of(indices.begin(), indices.end(), [vertex_count](uint32_t index) { return index < vertex_count; }));
+
+	for (size_t level = 1; level < lods.size(); level++)
+	{
+		// Levels are stored back to back.
+		CHECK_EQUAL(lods[level - 1].FirstIndex + lods[level - 1].IndexCount, lods[level].FirstIndex);
+		// Every level aims for half the triangles of the previous one, and is only kept when it drops at least 10%.
+		CHECK(lods[level].IndexCount * 10 <= lods[level - 1].IndexCount * 9);
+		CHECK(lods[level - 1].IndexCount / 6 >= MeshSimplifier::min_lod_triangles_);
+		CHECK(lods[level].Error >= lods[level - 1].Error);
+	}
+
+	CHECK_EQUAL(index_count / 2, lods[1].IndexCount);
+	CHECK_EQUAL(lods.back().FirstIndex + lods.back().IndexCount, primitive.IndexCount);
+}
+
+TEST(LodChainSkipsPrimitivesWithLevels)
+{
+	Mesh::PrimitiveData primitive = CreateBump(16);
+	primitive.Lods = { { 0, primitive.IndexCount, 0.0f } };
+
+	const uint8_t* indices = primitive.Indices;
+	MeshSimplifier::BuildLodChain(primitive);
+
+	CHECK_EQUAL(size_t(1), primitive.Lods.size());
+	CHECK(primitive.Indices == indices);
+}
+
+TEST(LodSelectionPicksCoarsestLevelWithinError)
+{
+	const std::vector<Mesh::LevelOfDetail> lods = { { 0, 300, 0.0f }, { 300, 150, 0.1f }, { 450, 72, 0.5f }, { 522, 36, 2.0f } };
+
+	CHECK_EQUAL(size_t(0), Mesh::SelectLodIndex(lods, 0.0f));
+	CHECK_EQUAL(size_t(0), Mesh::SelectLodIndex(lods, 0.05f));
+	CHECK_EQUAL(size_t(1), Mesh::SelectLodIndex(lods, 0.1f));
+	CHECK_EQUAL(size_t(2), Mesh::SelectLodIndex(lods, 1.0f));
+	CHECK_EQUAL(size_t(3), Mesh::SelectLodIndex(lods, FLT_MAX));
+
+	CHECK_EQUAL(100u, LodSelector::GetTriangleCount(lods, 558, 0.0f));
+	CHECK_EQUAL(24u, LodSelector::GetTriangleCount(lods, 558, 1.0f));
+	CHECK_EQUAL(186u, LodSelector::GetTriangleCount({}, 558, 1.0f));
+}
+
+TEST(LodSelectorProjectsErrorToPixels)
+{
+	// With a 90 degree field of view and 1000 pixels, a pixel at distance d covers 0.002 * d.
+	const LodSelector selector(90.0f, 1000.0f);
+	const XMFLOAT4 sphere(0.0f, 0.0f, 0.0f, 1.0f);
+
+	// The nearest point of the sphere is 9 units away.
+	CHECK(std::abs(selector.GetMaxError(XMMatrixIdentity(), sphere, XMVectorSet(0.0f, 0.0f, 10.0f, 1.0f)) - 0.018f) < 1e-5f);
+
+	// Scaling by 2 moves the nearest point to 8 units, and an error in mesh units covers twice the distance.
+	CHECK(std::abs(selector.GetMaxError(XMMatrixScaling(2.0f, 2.0f, 2.0f), sphere, XMVectorSet(0.0f, 0.0f, 10.0f, 1.0f)) - 0.008f) < 1e-5f);
+
+	// Inside the sphere the distance is clamped to the near clip.
+	CHECK(std::abs(selector.GetMaxError(XMMatrixIdentity(), sphere, XMVectorSet(0.0f, 0.0f, 0.5f, 1.0f), 0.1f) - 0.0002f) < 1e-6f);
+
+	// More pixels of error allow coarser levels.
+	const LodSelector coarse_selector(90.0f, 1000.0f, 4.0f);
+	CHECK(std::abs(coarse_selector.GetMaxError(XMMatrixIdentity(), sphere, XMVectorSet(0.0f, 0.0f, 10.0f, 1.0f)) - 0.072f) < 1e-5f);
+}
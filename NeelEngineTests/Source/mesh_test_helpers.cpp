@@ -0,0 +1,91 @@
+#include "neel_engine_pch.h"
+
+#include "mesh_test_helpers.h"
+
+Mesh::PrimitiveData MeshTestHelpers::CreateGrid(uint32_t columns, uint32_t rows, bool shared_vertices)
+{
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+
+	auto add_vertex = [&](uint32_t x, uint32_t y)
+	{
+		positions.insert(positions.end(), { static_cast<float>(x), static_cast<float>(y), 0.0f });
+		return static_cast<uint32_t>(positions.size() / 3 - 1);
+	};
+
+	if (shared_vertices)
+	{
+		for (uint32_t y = 0; y <= rows; y++)
+		{
+			for (uint32_t x = 0; x <= columns; x++)
+			{
+				add_vertex(x, y);
+			}
+		}
+	}
+
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		for (uint32_t x = 0; x < columns; x++)
+		{
+			const std::array<std::pair<uint32_t, uint32_t>, 6> corners =
+			{ {
+				{ x, y }, { x + 1, y }, { x + 1, y + 1 },
+				{ x, y }, { x + 1, y + 1 }, { x, y + 1 },
+			} };
+
+			for (const auto& corner : corners)
+			{
+				indices.push_back(shared_vertices ? corner.second * (columns + 1) + corner.first : add_vertex(corner.first, corner.second));
+			}
+		}
+	}
+
+	return CreatePrimitive(positions, indices);
+}
+
+Mesh::PrimitiveData MeshTestHelpers::CreatePrimitive(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+{
+	const size_t vertex_count = positions.size() / 3;
+
+	Mesh::PrimitiveData primitive;
+	primitive.ElementSize	= { 3 * sizeof(float), 3 * sizeof(float), 4 * sizeof(float), 2 * sizeof(float) };
+	primitive.NumElements	= { vertex_count, vertex_count, vertex_count, vertex_count };
+	primitive.IndexCount	= static_cast<uint32_t>(indices.size());
+	primitive.IndexFormat	= DXGI_FORMAT_R32_UINT;
+	primitive.HasTangents	= true;
+
+	primitive.Storage.resize(primitive.VertexDataSize() + primitive.IndexDataSize());
+
+	std::array<float*, 4> streams;
+	size_t offset = 0;
+	for (size_t slot = 0; slot < 4; slot++)
+	{
+		streams[slot] = reinterpret_cast<float*>(primitive.Storage.data() + offset);
+		primitive.Streams[slot] = primitive.Storage.data() + offset;
+		offset += primitive.StreamSize(slot);
+	}
+
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		const float* position = &positions[i * 3];
+
+		std::copy(position, position + 3, streams[Mesh::vertex_slot_] + i * 3);
+
+		const float normal[3]	= { 0.0f, 0.0f, 1.0f };
+		const float tangent[4]	= { 1.0f, 0.0f, 0.0f, 1.0f };
+		std::copy(normal, normal + 3, streams[Mesh::normal_slot_] + i * 3);
+		std::copy(tangent, tangent + 4, streams[Mesh::tangent_slot_] + i * 4);
+		std::copy(position, position + 2, streams[Mesh::texcoord0_slot_] + i * 2);
+	}
+
+	std::memcpy(primitive.Storage.data() + offset, indices.data(), primitive.IndexDataSize());
+	primitive.Indices = primitive.Storage.data() + offset;
+
+	return primitive;
+}
+
+const float* MeshTestHelpers::GetPosition(const Mesh::PrimitiveData& primitive, size_t vertex)
+{
+	return reinterpret_cast<const float*>(primitive.Streams[Mesh::vertex_slot_]) + vertex * 3;
+}
@@ -0,0 +1,145 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "mesh_test_helpers.h"
+#include "meshlet_builder.h"
+#include "mesh_optimizer.h"
+
+// Check the limits of every meshlet and that the meshlets hold the triangles of indices in order.
+static void CheckMeshlets(const MeshletData& data, const std::vector<uint32_t>& indices, size_t max_vertices, size_t max_triangles)
+{
+	CHECK_EQUAL(data.Meshlets.size(), data.Bounds.size());
+
+	std::vector<uint32_t> meshlet_indices;
+
+	for (const auto& meshlet : data.Meshlets)
+	{
+		CHECK(meshlet.VertexCount >= 3 && meshlet.VertexCount <= max_vertices);
+		CHECK(meshlet.TriangleCount >= 1 && meshlet.TriangleCount <= max_triangles);
+		CHECK_EQUAL(0u, meshlet.TriangleOffset % 4);
+		CHECK(meshlet.VertexOffset + meshlet.VertexCount <= data.Vertices.size());
+		CHECK(meshlet.TriangleOffset + meshlet.TriangleCount * 3 <= data.Triangles.size());
+
+		for (uint32_t i = 0; i < meshlet.TriangleCount * 3; i++)
+		{
+			const uint8_t local = data.Triangles[meshlet.TriangleOffset + i];
+			CHECK(local < meshlet.VertexCount);
+			meshlet_indices.push_back(data.Vertices[meshlet.VertexOffset + local]);
+		}
+	}
+
+	CHECK(meshlet_indices == indices);
+}
+
+TEST(MeshletsStayWithinDefaultLimits)
+{
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(40, 40);
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+
+	const MeshletData data = MeshletBuilder::Build(primitive);
+	CHECK(!data.Empty());
+	CheckMeshlets(data, indices, MeshletBuilder::max_vertices_, MeshletBuilder::max_triangles_);
+}
+
+TEST(MeshletsStayWithinCustomLimits)
+{
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(10, 10);
+	const std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+	const float* positions = MeshTestHelpers::GetPosition(primitive, 0);
+
+	for (const auto& limits : { std::make_pair(3, 1), std::make_pair(8, 5), std::make_pair(16, 124), std::make_pair(256, 4) })
+	{
+		const MeshletData data = MeshletBuilder::Build(indices, positions, primitive.NumElements[Mesh::vertex_slot_], limits.first, limits.second);
+		CheckMeshlets(data, indices, limits.first, limits.second);
+	}
+
+	// One triangle per meshlet.
+	CHECK_EQUAL(size_t(10 * 10 * 2), MeshletBuilder::Build(indices, positions, primitive.NumElements[Mesh::vertex_slot_], 3, 1).Meshlets.size());
+}
+
+TEST(MeshletsAreDeterministic)
+{
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(20, 20);
+
+	const MeshletData first = MeshletBuilder::Build(primitive);
+	const MeshletData second = MeshletBuilder::Build(primitive);
+
+	CHECK(first.Vertices == second.Vertices);
+	CHECK(first.Triangles == second.Triangles);
+	CHECK_EQUAL(first.Meshlets.size(), second.Meshlets.size());
+	CHECK(std::memcmp(first.Bounds.data(), second.Bounds.data(), first.Bounds.size() * sizeof(MeshletBounds)) == 0);
+}
+
+TEST(MeshletBoundsContainTheirVertices)
+{
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(16, 16);
+	const MeshletData data = MeshletBuilder::Build(primitive);
+
+	for (size_t m = 0; m < data.Meshlets.size(); m++)
+	{
+		const Meshlet& meshlet = data.Meshlets[m];
+		const MeshletBounds& bounds = data.Bounds[m];
+
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+		{
+			const XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(MeshTestHelpers::GetPosition(primitive, data.Vertices[meshlet.VertexOffset + i])));
+
+			CHECK(XMVectorGetX(XMVector3Length(position - XMLoadFloat3(&bounds.Center))) <= bounds.Radius * 1.0001f);
+			CHECK(!XMVector3Less(position, XMLoadFloat3(&bounds.AabbMin)));
+			CHECK(!XMVector3Greater(position, XMLoadFloat3(&bounds.AabbMax)));
+		}
+	}
+}
+
+TEST(MeshletConesCullBackFaces)
+{
+	// The grid faces +z.
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(4, 4);
+	const MeshletData data = MeshletBuilder::Build(primitive);
+	CHECK_EQUAL(size_t(1), data.Meshlets.size());
+
+	const MeshletBounds& bounds = data.Bounds[0];
+	CHECK(bounds.ConeCutoff <= 1.0f);
+	CHECK(MeshletBuilder::IsBackFacing(bounds, XMVectorSet(2.0f, 2.0f, -10.0f, 1.0f)));
+	CHECK(!MeshletBuilder::IsBackFacing(bounds, XMVectorSet(2.0f, 2.0f, 10.0f, 1.0f)));
+
+	// Seen at a grazing angle from the front the grid is not back facing.
+	CHECK(!MeshletBuilder::IsBackFacing(bounds, XMVectorSet(100.0f, 2.0f, 1.0f, 1.0f)));
+}
+
+TEST(MeshletConesAreDisabledForSpreadNormals)
+{
+	// Two triangles facing +z and -z.
+	const Mesh::PrimitiveData primitive = MeshTestHelpers::CreatePrimitive(
+		{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }, { 0, 1, 2, 0, 2, 1 });
+
+	const MeshletData data = MeshletBuilder::Build(primitive);
+	CHECK_EQUAL(size_t(1), data.Meshlets.size());
+	CHECK(data.Bounds[0].ConeCutoff > 1.0f);
+	CHECK(!MeshletBuilder::IsBackFacing(data.Bounds[0], XMVectorSet(0.0f, 0.0f, -10.0f, 1.0f)));
+	CHECK(!MeshletBuilder::IsBackFacing(data.Bounds[0], XMVectorSet(0.0f, 0.0f, 10.0f, 1.0f)));
+}
+
+TEST(MeshletsOnlyCoverFullResolution)
+{
+	Mesh::PrimitiveData primitive = MeshTestHelpers::CreateGrid(4, 4);
+	primitive.Lods = { { 0, 48, 0.0f }, { 48, 6, 1.0f } };
+
+	std::vector<uint32_t> indices = MeshOptimizer::ReadIndices(primitive);
+	indices.resize(48);
+
+	CheckMeshlets(MeshletBuilder::Build(primitive), indices, MeshletBuilder::max_vertices_, MeshletBuilder::max_triangles_);
+
+	primitive.Quantized = true;
+	CHECK(MeshletBuilder::Build(primitive).Empty());
+}
+
+TEST(MeshletBuilderRejectsInvalidLimits)
+{
+	const std::vector<uint32_t> indices = { 0, 1, 2 };
+	const float positions[9] = {};
+
+	CHECK_THROWS(MeshletBuilder::Build(indices, positions, 3, 2, 124));
+	CHECK_THROWS(MeshletBuilder::Build(indices, positions, 3, 257, 124));
+	CHECK_THROWS(MeshletBuilder::Build(indices, positions, 3, 64, 0));
+}
@@ -0,0 +1,96 @@
+#include "test_framework.h"
+
+#include "render_queue.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+// Sort random keys with RadixSort and check them against std::stable_sort.
+static void CheckRadixSortMatchesStableSort(size_t num_keys, uint64_t key_mask, uint32_t seed)
+{
+	std::mt19937_64 random(seed);
+
+	std::vector<uint64_t> keys(num_keys);
+	for (auto& key : keys)
+	{
+		key = random() & key_mask;
+	}
+
+	std::vector<uint32_t> values(num_keys);
+	std::iota(values.begin(), values.end(), 0);
+
+	std::vector<uint32_t> expected = values;
+	std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+	std::vector<uint64_t> temp_keys;
+	std::vector<uint32_t> temp_values;
+	RenderQueue::RadixSort(keys, values, temp_keys, temp_values);
+
+	CHECK(values == expected);
+	CHECK(std::is_sorted(keys.begin(), keys.end()));
+}
+
+TEST(RadixSortMatchesStableSort)
+{
+	CheckRadixSortMatchesStableSort(0, ~0ull, 1);
+	CheckRadixSortMatchesStableSort(1, ~0ull, 2);
+	CheckRadixSortMatchesStableSort(1000, ~0ull, 3);
+
+	// Few distinct keys test the stability, constant bytes are skipped.
+	CheckRadixSortMatchesStableSort(1000, 0x3, 4);
+	CheckRadixSortMatchesStableSort(1000, 0xff00000000ff0000ull, 5);
+	CheckRadixSortMatchesStableSort(1000, 0, 6);
+}
+
+TEST(RenderQueueSortsTwice)
+{
+	RenderQueue queue;
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		queue.Add(RenderQueue::MakeKey(0, (i * 7) % 5, (i * 13) % 11, i % 3), i);
+	}
+
+	queue.Sort();
+	const std::vector<uint32_t> values = queue.GetValues();
+
+	queue.Sort();
+	CHECK(values == queue.GetValues());
+	CHECK(std::is_sorted(queue.GetKeys().begin(), queue.GetKeys().end()));
+
+	queue.Clear();
+	CHECK_EQUAL(size_t(0), queue.GetSize());
+}
+
+TEST(RenderQueueKeysRoundTrip)
+{
+	const uint64_t key = RenderQueue::MakeKey(3, 1234, 567890, 4321);
+
+	CHECK_EQUAL(3u, RenderQueue::GetPass(key));
+	CHECK_EQUAL(1234u, RenderQueue::GetPipeline(key));
+	CHECK_EQUAL(567890u, RenderQueue::GetMaterial(key));
+	CHECK_EQUAL(4321u, RenderQueue::GetDepthBucket(key));
+
+	// The pass is the most significant field.
+	CHECK(RenderQueue::MakeKey(1, 0, 0, 0) > RenderQueue::MakeKey(0, RenderQueue::max_pipeline_, RenderQueue::max_material_,
+		RenderQueue::max_depth_bucket_));
+
+	CHECK_THROWS(RenderQueue::MakeKey(RenderQueue::max_pass_ + 1, 0, 0, 0));
+	CHECK_THROWS(RenderQueue::MakeKey(0, RenderQueue::max_pipeline_ + 1, 0, 0));
+	CHECK_THROWS(RenderQueue::MakeKey(0, 0, RenderQueue::max_material_ + 1, 0));
+	CHECK_THROWS(RenderQueue::MakeKey(0, 0, 0, RenderQueue::max_depth_bucket_ + 1));
+}
+
+TEST(RenderQueueDepthBucketsAreMonotonic)
+{
+	CHECK_EQUAL(0u, RenderQueue::QuantizeDepth(0.05f, 0.1f, 100.0f));
+	CHECK_EQUAL(size_t(RenderQueue::max_depth_bucket_), size_t(RenderQueue::QuantizeDepth(1000.0f, 0.1f, 100.0f)));
+
+	uint32_t previous = 0;
+	for (float depth = 0.1f; depth < 100.0f; depth *= 1.01f)
+	{
+		const uint32_t bucket = RenderQueue::QuantizeDepth(depth, 0.1f, 100.0f);
+		CHECK(bucket >= previous);
+		previous = bucket;
+	}
+}
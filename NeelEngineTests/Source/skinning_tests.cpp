@@ -0,0 +1,243 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "mesh_test_helpers.h"
+#include "skinning.h"
+#include "transform_hierarchy.h"
+#include "thread_pool.h"
+#include "vertex_quantization.h"
+
+// Rotation quaternion around z.
+static XMFLOAT4 RotationZ(float angle)
+{
+	return XMFLOAT4(0.0f, 0.0f, std::sin(angle * 0.5f), std::cos(angle * 0.5f));
+}
+
+/**
+* A grid of columns x rows quads bent by two joints: node 0 is the node of the instance, joint 0 (node 1) sits at
+* its origin and joint 1 (node 2) at x = columns / 2. The weight of joint 1 grows along x.
+*/
+struct SkinnedGrid
+{
+	TransformHierarchy				Transforms;
+	Skinning::Skin					Skin;
+	std::vector<Mesh::PrimitiveData>	Primitives;
+
+	SkinnedGrid(uint32_t columns, uint32_t rows, bool quantized)
+	{
+		const float bend = columns * 0.5f;
+
+		Transforms.AddNode(TransformHierarchy::no_parent_, XMFLOAT3(3.0f, -1.0f, 2.0f), RotationZ(0.3f));
+		Transforms.AddNode(0);
+		Transforms.AddNode(1, XMFLOAT3(bend, 0.0f, 0.0f));
+		Transforms.Update();
+
+		// The joints are placed in the bind pose, in the space of the node of the instance.
+		Skin.Joints = { 1, 2 };
+		Skin.InverseBindMatrices.resize(2);
+		XMStoreFloat4x4(&Skin.InverseBindMatrices[0], XMMatrixIdentity());
+		XMStoreFloat4x4(&Skin.InverseBindMatrices[1], XMMatrixTranslation(-bend, 0.0f, 0.0f));
+
+		Primitives.push_back(MeshTestHelpers::CreateGrid(columns, rows));
+
+		Mesh::PrimitiveData& primitive = Primitives.back();
+		for (size_t v = 0; v < primitive.NumElements[Mesh::vertex_slot_]; v++)
+		{
+			const float weight = MeshTestHelpers::GetPosition(primitive, v)[0] / columns;
+			primitive.Skin.push_back({ { 0, 1, 0, 0 }, { 1.0f - weight, weight, 0.0f, 0.0f } });
+		}
+
+		if (quantized)
+		{
+			VertexQuantization::QuantizeMesh(Primitives);
+		}
+	}
+
+	// Bind pose position and normal of a vertex.
+	void GetBindVertex(size_t v, XMFLOAT3& position, XMFLOAT3& normal) const
+	{
+		const Mesh::PrimitiveData& primitive = Primitives[0];
+
+		if (primitive.Quantized)
+		{
+			const int16_t* encoded = reinterpret_cast<const int16_t*>(primitive.Streams[Mesh::vertex_slot_]) + v * 4;
+			position.x = primitive.PositionOffset.x + VertexQuantization::DecodeSnorm16(encoded[0]) * primitive.PositionScale.x;
+			position.y = primitive.PositionOffset.y + VertexQuantization::DecodeSnorm16(encoded[1]) * primitive.PositionScale.y;
+			position.z = primitive.PositionOffset.z + VertexQuantization::DecodeSnorm16(encoded[2]) * primitive.PositionScale.z;
+
+			VertexQuantization::DecodeOctahedral(reinterpret_cast<const int16_t*>(primitive.Streams[Mesh::normal_slot_]) + v * 2, &normal.x);
+		}
+		else
+		{
+			std::memcpy(&position, primitive.Streams[Mesh::vertex_slot_] + v * sizeof(XMFLOAT3), sizeof(XMFLOAT3));
+			std::memcpy(&normal, primitive.Streams[Mesh::normal_slot_] + v * sizeof(XMFLOAT3), sizeof(XMFLOAT3));
+		}
+	}
+
+	// Scalar linear blend skinning of a vertex in the space of the node of the instance.
+	void SkinReference(size_t v, XMFLOAT3& position, XMFLOAT3& normal) const
+	{
+		XMFLOAT3 bind_position, bind_normal;
+		GetBindVertex(v, bind_position, bind_normal);
+
+		const Mesh::SkinVertex& influence = Primitives[0].Skin[v];
+		const XMMATRIX inverse_node = XMMatrixInverse(nullptr, Transforms.GetWorldMatrix(0));
+
+		double blended_position[3] = {};
+		double blended_normal[3] = {};
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			XMFLOAT4X4 joint;
+			XMStoreFloat4x4(&joint, XMLoadFloat4x4(&Skin.InverseBindMatrices[influence.Joints[i]]) *
+				Transforms.GetWorldMatrix(Skin.Joints[influence.Joints[i]]) * inverse_node);
+
+			for (size_t c = 0; c < 3; c++)
+			{
+				blended_position[c] += influence.Weights[i] *
+					(bind_position.x * joint.m[0][c] + bind_position.y * joint.m[1][c] + bind_position.z * joint.m[2][c] + joint.m[3][c]);
+				blended_normal[c] += influence.Weights[i] *
+					(bind_normal.x * joint.m[0][c] + bind_normal.y * joint.m[1][c] + bind_normal.z * joint.m[2][c]);
+			}
+		}
+
+		const double length = std::sqrt(blended_normal[0] * blended_normal[0] + blended_normal[1] * blended_normal[1] + blended_normal[2] * blended_normal[2]);
+
+		position	= XMFLOAT3(static_cast<float>(blended_position[0]), static_cast<float>(blended_position[1]), static_cast<float>(blended_position[2]));
+		normal		= XMFLOAT3(static_cast<float>(blended_normal[0] / length), static_cast<float>(blended_normal[1] / length), static_cast<float>(blended_normal[2] / length));
+	}
+};
+
+// Skinned position and normal of a vertex as of the last Update.
+static void GetSkinnedVertex(const Skinning& skinning, uint32_t instance, size_t v, XMFLOAT3& position, XMFLOAT3& normal)
+{
+	if (skinning.GetQuantized(instance))
+	{
+		const int16_t* encoded = reinterpret_cast<const int16_t*>(skinning.GetPositions(instance, 0)) + v * 4;
+		const XMVECTOR decoded = XMVectorSet(VertexQuantization::DecodeSnorm16(encoded[0]), VertexQuantization::DecodeSnorm16(encoded[1]),
+			VertexQuantization::DecodeSnorm16(encoded[2]), 1.0f);
+
+		XMStoreFloat3(&position, XMVector3TransformCoord(decoded, skinning.GetDequantizeTransform(instance)));
+		VertexQuantization::DecodeOctahedral(reinterpret_cast<const int16_t*>(skinning.GetNormals(instance, 0)) + v * 2, &normal.x);
+	}
+	else
+	{
+		std::memcpy(&position, skinning.GetPositions(instance, 0) + v * sizeof(XMFLOAT3), sizeof(XMFLOAT3));
+		std::memcpy(&normal, skinning.GetNormals(instance, 0) + v * sizeof(XMFLOAT3), sizeof(XMFLOAT3));
+	}
+}
+
+// Bend the grid, skin it and compare every vertex with the scalar reference.
+static void CheckSkinningMatchesReference(bool quantized, float max_position_error, float max_normal_error)
+{
+	SkinnedGrid grid(16, 4, quantized);
+
+	Skinning skinning;
+	const uint32_t instance = skinning.AddInstance(grid.Primitives, grid.Skin, 0);
+	CHECK_EQUAL(quantized, skinning.GetQuantized(instance));
+	CHECK_EQUAL(size_t(17 * 5), skinning.GetNumVertices());
+
+	for (const float angle : { 0.0f, 0.5f, 1.5f, -2.5f })
+	{
+		grid.Transforms.SetRotation(1, RotationZ(angle * 0.25f));
+		grid.Transforms.SetRotation(2, RotationZ(angle));
+		grid.Transforms.Update();
+
+		skinning.Update(grid.Transforms);
+
+		const XMFLOAT4& sphere = skinning.GetBoundingSphere(instance);
+
+		for (size_t v = 0; v < skinning.GetNumVertices(instance, 0); v++)
+		{
+			XMFLOAT3 position, normal, reference_position, reference_normal;
+			GetSkinnedVertex(skinning, instance, v, position, normal);
+			grid.SkinReference(v, reference_position, reference_normal);
+
+			CHECK(XMVectorGetX(XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&reference_position))) <= max_position_error);
+			CHECK(XMVectorGetX(XMVector3Length(XMLoadFloat3(&normal) - XMLoadFloat3(&reference_normal))) <= max_normal_error);
+
+			// The refit bounds hold the pose.
+			CHECK(XMVectorGetX(XMVector3Length(XMLoadFloat3(&reference_position) - XMLoadFloat4(&sphere))) <= sphere.w * 1.0001f);
+		}
+	}
+}
+
+TEST(SkinningMatchesScalarReference)
+{
+	CheckSkinningMatchesReference(false, 1e-4f, 1e-4f);
+}
+
+TEST(SkinningRefitsQuantizationBounds)
+{
+	// Half a step of the bind pose and of the skinned quantization grid of a pose that spans at most 20 units.
+	CheckSkinningMatchesReference(true, 2.0f * 20.0f / 32767.0f, 1e-3f);
+}
+
+TEST(SkinningKeepsBitangentSign)
+{
+	SkinnedGrid grid(4, 4, true);
+
+	// Flip the bitangent sign of every other vertex, the quantized streams point into Storage.
+	int16_t* positions = const_cast<int16_t*>(reinterpret_cast<const int16_t*>(grid.Primitives[0].Streams[Mesh::vertex_slot_]));
+	for (size_t v = 0; v < grid.Primitives[0].NumElements[Mesh::vertex_slot_]; v += 2)
+	{
+		positions[v * 4 + 3] = -32767;
+	}
+
+	Skinning skinning;
+	const uint32_t instance = skinning.AddInstance(grid.Primitives, grid.Skin, 0);
+	grid.Transforms.SetRotation(2, RotationZ(1.0f));
+	grid.Transforms.Update();
+	skinning.Update(grid.Transforms);
+
+	const int16_t* skinned = reinterpret_cast<const int16_t*>(skinning.GetPositions(instance, 0));
+	for (size_t v = 0; v < skinning.GetNumVertices(instance, 0); v++)
+	{
+		CHECK_EQUAL(v % 2 == 0 ? -32767 : 32767, static_cast<int>(skinned[v * 4 + 3]));
+	}
+}
+
+TEST(SkinningOnThreadPoolMatchesCallingThread)
+{
+	// More vertices than the grain size, so the instance is split into ranges.
+	SkinnedGrid grid(96, 64, false);
+
+	Skinning skinning;
+	const uint32_t instance = skinning.AddInstance(grid.Primitives, grid.Skin, 0);
+	skinning.AddInstance(grid.Primitives, grid.Skin, 1);
+	CHECK(skinning.GetNumVertices() > Skinning::parallel_grain_size_ * 2);
+
+	grid.Transforms.SetRotation(2, RotationZ(0.7f));
+	grid.Transforms.Update();
+
+	skinning.Update(grid.Transforms);
+	const std::vector<uint8_t> positions(skinning.GetPositions(instance, 0),
+		skinning.GetPositions(instance, 0) + skinning.GetNumVertices(instance, 0) * skinning.GetPositionStride(instance));
+
+	ThreadPool thread_pool(4);
+	skinning.Update(grid.Transforms, &thread_pool);
+
+	CHECK(std::memcmp(positions.data(), skinning.GetPositions(instance, 0), positions.size()) == 0);
+}
+
+TEST(SkinningRejectsInvalidInstances)
+{
+	SkinnedGrid grid(2, 2, false);
+	Skinning skinning;
+
+	// Influences of a joint that is not in the skin.
+	std::vector<Mesh::PrimitiveData> primitives;
+	primitives.push_back(MeshTestHelpers::CreateGrid(2, 2));
+	primitives[0].Skin = grid.Primitives[0].Skin;
+	primitives[0].Skin[0].Joints[0] = 2;
+	CHECK_THROWS(skinning.AddInstance(primitives, grid.Skin, 0));
+
+	// Missing influences.
+	primitives[0].Skin.pop_back();
+	CHECK_THROWS(skinning.AddInstance(primitives, grid.Skin, 0));
+
+	// A skin without joints.
+	CHECK_THROWS(skinning.AddInstance(grid.Primitives, Skinning::Skin(), 0));
+
+	CHECK_EQUAL(size_t(0), skinning.GetNumInstances());
+}
@@ -0,0 +1,61 @@
+#include "test_framework.h"
+
+#include <exception>
+#include <iostream>
+
+uint32_t TestRegistry::failed_checks_ = 0;
+
+std::vector<TestRegistry::Test>& TestRegistry::GetTests()
+{
+	static std::vector<Test> tests;
+	return tests;
+}
+
+bool TestRegistry::Add(const char* name, TestFunction function)
+{
+	GetTests().push_back({ name, function });
+	return true;
+}
+
+void TestRegistry::Fail(const char* file, int line, const std::string& message)
+{
+	std::cerr << file << "(" << line << "): " << message << "\n";
+	failed_checks_++;
+}
+
+int TestRegistry::RunAll(const std::string& filter)
+{
+	int num_run = 0;
+	int num_failed = 0;
+
+	for (const Test& test : GetTests())
+	{
+		if (std::string(test.Name).find(filter) == std::string::npos)
+			continue;
+
+		failed_checks_ = 0;
+
+		try
+		{
+			test.Function();
+		}
+		catch (const std::exception& exception)
+		{
+			std::cerr << test.Name << ": unexpected exception: " << exception.what() << "\n";
+			failed_checks_++;
+		}
+
+		num_run++;
+		num_failed += failed_checks_ > 0 ? 1 : 0;
+
+		std::cout << (failed_checks_ > 0 ? "[FAILED] " : "[PASSED] ") << test.Name << "\n";
+	}
+
+	std::cout << num_run - num_failed << " of " << num_run << " tests passed\n";
+	return num_failed;
+}
+
+std::string GetAssetDirectory()
+{
+	return "../ReflectionsDemo/Assets/";
+}
@@ -0,0 +1,179 @@
+#include "neel_engine_pch.h"
+
+#include "test_framework.h"
+#include "mesh_test_helpers.h"
+#include "vertex_quantization.h"
+
+#include <DirectXPackedVector.h>
+
+#include <random>
+
+TEST(QuantizationClampsSnorm16)
+{
+	CHECK_EQUAL(int16_t(32767), VertexQuantization::EncodeSnorm16(1.0f));
+	CHECK_EQUAL(int16_t(-32767), VertexQuantization::EncodeSnorm16(-1.0f));
+	CHECK_EQUAL(int16_t(32767), VertexQuantization::EncodeSnorm16(2.0f));
+	CHECK_EQUAL(int16_t(-32767), VertexQuantization::EncodeSnorm16(-2.0f));
+	CHECK_EQUAL(int16_t(0), VertexQuantization::EncodeSnorm16(0.0f));
+
+	// -32768 and -32767 both decode to -1.
+	CHECK_EQUAL(-1.0f, VertexQuantization::DecodeSnorm16(-32768));
+	CHECK_EQUAL(-1.0f, VertexQuantization::DecodeSnorm16(-32767));
+	CHECK_EQUAL(1.0f, VertexQuantization::DecodeSnorm16(32767));
+}
+
+// Angle between two unit vectors in degrees, accurate for small angles.
+static double AngleDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	const double cross = XMVectorGetX(XMVector3Length(XMVector3Cross(XMLoadFloat3(&a), XMLoadFloat3(&b))));
+	const double dot = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&a), XMLoadFloat3(&b)));
+
+	return std::atan2(cross, dot) * 180.0 / XM_PI;
+}
+
+TEST(QuantizationRoundTripsOctahedralNormals)
+{
+	std::mt19937 random(1234);
+	std::normal_distribution<float> distribution;
+
+	std::vector<XMFLOAT3> normals =
+	{
+		{ 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f },
+		{ -1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f },
+	};
+
+	for (int i = 0; i < 10000; i++)
+	{
+		XMFLOAT3 normal(distribution(random), distribution(random), distribution(random));
+		XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+		normals.push_back(normal);
+	}
+
+	double max_degrees = 0.0;
+
+	for (const auto& normal : normals)
+	{
+		int16_t encoded[2];
+		VertexQuantization::EncodeOctahedral(&normal.x, encoded);
+
+		XMFLOAT3 decoded;
+		VertexQuantization::DecodeOctahedral(encoded, &decoded.x);
+
+		max_degrees = std::max(max_degrees, AngleDegrees(normal, decoded));
+	}
+
+	// A step of SNORM16 on the octahedron is below 0.01 degrees on the sphere.
+	CHECK(max_degrees < 0.01);
+}
+
+TEST(QuantizationKeepsPositionsWithinBounds)
+{
+	// Positions are quantized relative to the bounds of both primitives.
+	std::vector<Mesh::PrimitiveData> primitives;
+	primitives.push_back(MeshTestHelpers::CreatePrimitive({ -3.0f, 1.0f, 10.0f, 5.0f, 2.0f, 10.0f, 1.0f, 4.0f, 10.0f }, { 0, 1, 2 }));
+	primitives.push_back(MeshTestHelpers::CreatePrimitive({ 0.5f, 1.5f, 12.0f, -1.0f, 3.0f, 12.0f, 2.0f, 1.0f, 12.0f }, { 0, 1, 2 }));
+
+	std::vector<Mesh::PrimitiveData> originals;
+	for (const auto& primitive : primitives)
+	{
+		originals.push_back(MeshTestHelpers::CreatePrimitive(
+			std::vector<float>(MeshTestHelpers::GetPosition(primitive, 0), MeshTestHelpers::GetPosition(primitive, 0) + 9), { 0, 1, 2 }));
+	}
+
+	const VertexQuantization::Stats stats = VertexQuantization::QuantizeMesh(primitives);
+
+	CHECK_EQUAL(uint64_t(6), stats.NumVertices);
+	CHECK_EQUAL(uint64_t(6 * 48), stats.FloatBytes);
+	CHECK_EQUAL(uint64_t(6 * 20), stats.QuantizedBytes);
+
+	// Bounds are x [-3, 5], y [1, 4] and z [10, 12].
+	const float scale[3]	= { 4.0f, 1.5f, 1.0f };
+	const float offset[3]	= { 1.0f, 2.5f, 11.0f };
+
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		const Mesh::PrimitiveData& primitive = primitives[p];
+
+		CHECK(primitive.Quantized);
+		CHECK_EQUAL(size_t(VertexQuantization::quantized_position_size_), primitive.ElementSize[Mesh::vertex_slot_]);
+		CHECK_EQUAL(size_t(VertexQuantization::quantized_normal_size_), primitive.ElementSize[Mesh::normal_slot_]);
+		CHECK_EQUAL(size_t(VertexQuantization::quantized_tangent_size_), primitive.ElementSize[Mesh::tangent_slot_]);
+		CHECK_EQUAL(size_t(VertexQuantization::quantized_texcoord_size_), primitive.ElementSize[Mesh::texcoord0_slot_]);
+
+		CHECK_EQUAL(scale[0], primitive.PositionScale.x);
+		CHECK_EQUAL(scale[1], primitive.PositionScale.y);
+		CHECK_EQUAL(scale[2], primitive.PositionScale.z);
+		CHECK_EQUAL(offset[0], primitive.PositionOffset.x);
+		CHECK_EQUAL(offset[1], primitive.PositionOffset.y);
+		CHECK_EQUAL(offset[2], primitive.PositionOffset.z);
+
+		const int16_t* positions = reinterpret_cast<const int16_t*>(primitive.Streams[Mesh::vertex_slot_]);
+
+		for (size_t i = 0; i < 3; i++)
+		{
+			const float* original = MeshTestHelpers::GetPosition(originals[p], i);
+
+			for (size_t c = 0; c < 3; c++)
+			{
+				// Half a step of the quantization grid.
+				const float decoded = offset[c] + VertexQuantization::DecodeSnorm16(positions[i * 4 + c]) * scale[c];
+				CHECK(std::abs(decoded - original[c]) <= scale[c] * (0.5f / 32767.0f) * 1.001f);
+			}
+
+			// Positive bitangent sign.
+			CHECK_EQUAL(int16_t(32767), positions[i * 4 + 3]);
+		}
+
+		// The indices that lived in the replaced storage moved along.
+		CHECK(primitive.Indices >= primitive.Storage.data() && primitive.Indices < primitive.Storage.data() + primitive.Storage.size());
+		CHECK_EQUAL(2u, reinterpret_cast<const uint32_t*>(primitive.Indices)[2]);
+	}
+
+	// The extremes of the bounds hit the end of the SNORM16 range.
+	CHECK_EQUAL(int16_t(-32767), reinterpret_cast<const int16_t*>(primitives[0].Streams[Mesh::vertex_slot_])[0]);
+	CHECK_EQUAL(int16_t(32767), reinterpret_cast<const int16_t*>(primitives[0].Streams[Mesh::vertex_slot_])[4]);
+
+	CHECK(stats.MaxPositionError <= 4.0 * 0.5 / 32767.0 * 1.001);
+	CHECK(stats.MaxNormalDegrees <= 0.01);
+	CHECK(stats.MaxTangentDegrees <= 0.01);
+	// Half a step of a half float in [0.5, 8).
+	CHECK(stats.MaxTexCoordError <= 8.0 / 2048.0);
+}
+
+TEST(QuantizationHandlesFlatBounds)
+{
+	// All positions lie in the z = 2 plane, the flat axis keeps a scale of 1.
+	std::vector<Mesh::PrimitiveData> primitives;
+	primitives.push_back(MeshTestHelpers::CreatePrimitive({ 0.0f, 0.0f, 2.0f, 1.0f, 0.0f, 2.0f, 0.0f, 1.0f, 2.0f }, { 0, 1, 2 }));
+
+	const VertexQuantization::Stats stats = VertexQuantization::QuantizeMesh(primitives);
+
+	CHECK_EQUAL(1.0f, primitives[0].PositionScale.z);
+	CHECK_EQUAL(2.0f, primitives[0].PositionOffset.z);
+	CHECK_EQUAL(int16_t(0), reinterpret_cast<const int16_t*>(primitives[0].Streams[Mesh::vertex_slot_])[2]);
+	CHECK(stats.MaxPositionError <= 0.5 * 0.5 / 32767.0 * 1.001);
+}
+
+TEST(QuantizationDecodesNormalizedComponents)
+{
+	const int8_t bytes[]		= { 127, -127, -128, 0 };
+	const uint16_t shorts[]		= { 65535, 0, 32768 };
+
+	float decoded[4];
+	VertexQuantization::DecodeComponents(reinterpret_cast<const uint8_t*>(bytes), 4, 1, 4, fx::gltf::Accessor::ComponentType::Byte, true, decoded);
+	CHECK_EQUAL(1.0f, decoded[0]);
+	CHECK_EQUAL(-1.0f, decoded[1]);
+	CHECK_EQUAL(-1.0f, decoded[2]);
+	CHECK_EQUAL(0.0f, decoded[3]);
+
+	// Stride of 2 bytes picks every element.
+	VertexQuantization::DecodeComponents(reinterpret_cast<const uint8_t*>(shorts), 2, 3, 1, fx::gltf::Accessor::ComponentType::UnsignedShort, true, decoded);
+	CHECK_EQUAL(1.0f, decoded[0]);
+	CHECK_EQUAL(0.0f, decoded[1]);
+	CHECK(std::abs(decoded[2] - 0.5f) < 1e-4f);
+
+	// Without normalization the values are converted as they are.
+	VertexQuantization::DecodeComponents(reinterpret_cast<const uint8_t*>(bytes), 4, 1, 2, fx::gltf::Accessor::ComponentType::Byte, false, decoded);
+	CHECK_EQUAL(127.0f, decoded[0]);
+	CHECK_EQUAL(-127.0f, decoded[1]);
+}
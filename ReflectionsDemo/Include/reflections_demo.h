@@ -8,6 +8,9 @@
 #include "shader_table.h"
 #include "acceleration_structure.h"
 #include "byte_address_buffer.h"
+#include "instance_batcher.h"
+#include "render_queue.h"
+#include "frustum_culler.h"
 
 class ReflectionsDemo : public Game
 {
@@ -54,6 +57,9 @@ protected:
 
 	void RescaleRenderTargets(float scale);
 
+	// Refit the bottom level acceleration structure to the skinned streams of the last Skinning::Upload and rebuild the top level.
+	void UpdateSkinnedAccelerationStructures(CommandList& command_list);
+
 private:
 	Scene scene_;
 
@@ -79,6 +85,23 @@ private:
 	AccelerationStructure bottom_level_acceleration_structure_;
 	AccelerationStructure top_level_acceleration_structure_;
 
+	// Kept to refit the bottom level with the skinned positions every frame.
+	std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometry_descs_;
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC bottom_level_build_desc_;
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC top_level_build_desc_;
+
+	// Mesh and skinned instance whose pose the bottom level uses, the first skinned instance of every mesh.
+	std::vector<std::pair<int32_t, uint32_t>> skinned_geometries_;
+	// First geometry desc of every mesh.
+	std::vector<uint32_t> first_geometry_descs_;
+
+	// Instanced draws of the rigid instances of the geometry pass, rebuilt every frame.
+	InstanceBatcher instance_batcher_;
+	// Order the batches are drawn in.
+	RenderQueue render_queue_;
+	// Boxes of the rigid draws followed by the skinned instances, culled against the camera every frame.
+	FrustumCuller frustum_culler_;
+
 	// Shader tables
 	static const wchar_t* c_raygen_shader_;
 	static const wchar_t* c_closesthit_shader_;
@@ -129,18 +152,6 @@ private:
 	/**
 	* Scene constant data.
 	*/
-
-	struct SceneConstantBuffer
-	{
-		DirectX::XMMATRIX InverseViewProj;
-		DirectX::XMMATRIX ViewProj;
-		DirectX::XMVECTOR CamPos;
-		float VFOV;
-		float PixelHeight;
-		int RayBounces = 2;
-		float Padding1;
-	};
-
 	SceneConstantBuffer scene_buffer_;
 
 	struct MeshInfoIndex
@@ -148,9 +159,6 @@ private:
 		int MeshId;
 	};
 
-	ByteAddressBuffer global_vertices_;
-	ByteAddressBuffer global_indices_;
-
 	struct MeshInfo
 	{
 		MeshInfo()
@@ -165,6 +173,7 @@ private:
 			, UvStride(0)
 			, HasTangents(false)
 			, MaterialId(-1)
+			, QuantizedVertices(0)
 		{}
 
 		UINT IndicesOffset;
@@ -180,6 +189,7 @@ private:
 		
 		bool HasTangents;
 		int MaterialId;
+		UINT QuantizedVertices;
 	};
 
 	std::vector<MeshInfo> mesh_infos_;
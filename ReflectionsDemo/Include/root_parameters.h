@@ -6,6 +6,7 @@ namespace GeometryPassRootSignatureParams
 	{
 		MaterialConstantBuffer = 0,	// ConstantBuffer<MaterialConstantBuffer> MaterialCB	: register( b0 );
 		MeshConstantBuffer,			// ConstantBuffer<Mat> MatCB							: register( b1 );			
+		Instances,					// StructuredBuffer<InstanceData> Instances				: register( t0, space1 );
 		Textures,					// Texture2D textures[5]								: register( t0 );
 		Materials,					// StructuredBuffer<MaterialData> Materials				: register( t5 );
 		NumRootParameters
@@ -163,4 +163,25 @@ float3 fresnelSchlick(float cosTheta, float3 F0)
 	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// Two SNORM16 values packed in a uint, x in the low 16 bits. Matches the R16G16_SNORM conversion of the Input Assembler.
+float2 DecodeSnorm16x2(uint packed)
+{
+	const int2 values = int2(packed << 16, packed) >> 16;
+
+	return max(float2(values) / 32767.0, -1.0);
+}
+
+// Unit vector from its octahedral encoding (VertexQuantization::EncodeOctahedral).
+float3 OctahedralDecode(float2 encoded)
+{
+	float3 n = float3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * (n.xy >= 0.0 ? 1.0 : -1.0);
+	}
+
+	return normalize(n);
+}
+
 
@@ -32,15 +32,17 @@ struct MaterialData
 
 struct MeshConstantData
 {
-	float4x4 ModelMatrix;
+	float4x4 ViewProjectionMatrix;
 	//----------------------------------- (64 byte boundary)
-	float4x4 ModelViewMatrix;
-	//----------------------------------- (64 byte boundary)
-	float4x4 InverseTransposeModelMatrix;
-	//----------------------------------- (64 byte boundary)
-	float4x4 ModelViewProjectionMatrix;
-	//----------------------------------- (64 byte boundary)
-	// Total:                              64 * 4 + 16 = 256 bytes
+	float4 PositionScale;
+	//----------------------------------- (16 byte boundary)
+	float4 PositionOffset;
+	//----------------------------------- (16 byte boundary)
+	uint QuantizedVertices;
+	uint FirstInstance;
+	uint2 Padding;
+	//----------------------------------- (16 byte boundary)
+	// Total:                              64 + 16 * 3 = 112 bytes
 };
 
 
@@ -1,20 +1,31 @@
+#include "Common.hlsli"
+
 //=============================================================================
 // CPU data.
 //=============================================================================
 
-struct MeshConstantData
+struct InstanceData
 {
 	float4x4 ModelMatrix;
 	//----------------------------------- (64 byte boundary)
-	float4x4 ModelViewMatrix;
-	//----------------------------------- (64 byte boundary)
 	float4x4 InverseTransposeModelMatrix;
 	//----------------------------------- (64 byte boundary)
-	float4x4 ModelViewProjectionMatrix;
+	// Total:                              64 * 2 = 128 bytes
+};
+
+struct MeshConstantData
+{
+	float4x4 ViewProjectionMatrix;
 	//----------------------------------- (64 byte boundary)
-	float4 CameraPosition;
+	float4 PositionScale;
+	//----------------------------------- (16 byte boundary)
+	float4 PositionOffset;
 	//----------------------------------- (16 byte boundary)
-	// Total:                              64 * 4 + 16 = 272 bytes
+	uint QuantizedVertices;
+	uint FirstInstance;
+	uint2 Padding;
+	//----------------------------------- (16 byte boundary)
+	// Total:                              64 + 16 * 3 = 112 bytes
 };
 
 
@@ -24,13 +35,15 @@ struct MeshConstantData
 
 ConstantBuffer<MeshConstantData>		MeshCB				: register(b1);
 
+StructuredBuffer<InstanceData>			Instances			: register(t0, space1);
+
 //=============================================================================
 // Vertex shader input/output.
 //=============================================================================
 
 struct VertexShaderInput
 {
-	float3 Position : POSITION;
+	float4 Position : POSITION;	// Quantized: bitangent sign in w.
 	float3 Normal   : NORMAL;
 	float4 Tangent	: TANGENT;
 	float2 TexCoord : TEXCOORD;
@@ -50,16 +63,32 @@ struct VertexShaderOutput
 // Shader code.
 //=============================================================================
 
-VertexShaderOutput main(VertexShaderInput IN)
+VertexShaderOutput main(VertexShaderInput IN, uint InstanceID : SV_InstanceID)
 {
 	VertexShaderOutput OUT;
 
-	OUT.Position	= mul(MeshCB.ModelViewProjectionMatrix, float4(IN.Position, 1.0f));
+	// SV_InstanceID starts at 0 for every draw, whatever its start instance.
+	const InstanceData instance = Instances[MeshCB.FirstInstance + InstanceID];
+
+	const float3 position = MeshCB.PositionOffset.xyz + IN.Position.xyz * MeshCB.PositionScale.xyz;
+
+	float3 normal	= IN.Normal;
+	float4 tangent	= IN.Tangent;
+
+	if (MeshCB.QuantizedVertices)
+	{
+		normal	= OctahedralDecode(IN.Normal.xy);
+		tangent	= float4(OctahedralDecode(IN.Tangent.xy), IN.Position.w);
+	}
+
+	const float4 position_w = mul(instance.ModelMatrix, float4(position, 1.0f));
+
+	OUT.Position	= mul(MeshCB.ViewProjectionMatrix, position_w);
 
-	OUT.PositionW	= mul((float3x3)MeshCB.ModelMatrix, IN.Position);
-	OUT.NormalW		= mul((float3x3)MeshCB.InverseTransposeModelMatrix, IN.Normal);
-	OUT.TangentW	= mul((float3x3)MeshCB.ModelMatrix, IN.Tangent.xyz);
-	OUT.BinormalW	= cross(OUT.NormalW, OUT.TangentW.xyz) * IN.Tangent.w;
+	OUT.PositionW	= mul((float3x3)instance.ModelMatrix, position);
+	OUT.NormalW		= mul((float3x3)instance.InverseTransposeModelMatrix, normal);
+	OUT.TangentW	= mul((float3x3)instance.ModelMatrix, tangent.xyz);
+	OUT.BinormalW	= cross(OUT.NormalW, OUT.TangentW.xyz) * tangent.w;
 	OUT.TexCoord	= IN.TexCoord;
 
 	return OUT;
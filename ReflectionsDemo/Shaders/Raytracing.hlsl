@@ -21,6 +21,8 @@ struct MeshInfo
 
 	bool HasTangents;
 	int MaterialId;
+	uint QuantizedVertices;
+	//----------------------------------- (16 byte boundary)
 };
 
 struct MaterialData
@@ -131,6 +133,46 @@ uint3 Load3x16BitIndices(uint offsetBytes)
 	return indices;
 }
 
+// Vertex attributes in the float or the quantized format (see VertexQuantization).
+float2 LoadUv(MeshInfo info, uint index)
+{
+	const uint offset = info.UvAttributeOffset + index * info.UvStride;
+
+	if (info.QuantizedVertices)
+	{
+		const uint packed = g_Attributes.Load(offset);
+		return f16tof32(uint2(packed, packed >> 16));
+	}
+
+	return asfloat(g_Attributes.Load2(offset));
+}
+
+float3 LoadNormal(MeshInfo info, uint index)
+{
+	const uint offset = info.NormalAttributeOffset + index * info.NormalStride;
+
+	if (info.QuantizedVertices)
+	{
+		return OctahedralDecode(DecodeSnorm16x2(g_Attributes.Load(offset)));
+	}
+
+	return asfloat(g_Attributes.Load3(offset));
+}
+
+float4 LoadTangent(MeshInfo info, uint index)
+{
+	const uint offset = info.TangentAttributeOffset + index * info.TangentStride;
+
+	if (info.QuantizedVertices)
+	{
+		// The bitangent sign is the w component of the position, stored next to z.
+		const float sign = DecodeSnorm16x2(g_Attributes.Load(info.PositionAttributeOffset + index * info.PositionStride + 4)).y;
+		return float4(OctahedralDecode(DecodeSnorm16x2(g_Attributes.Load(offset))), sign);
+	}
+
+	return asfloat(g_Attributes.Load4(offset));
+}
+
 //=============================================================================
 // Shader code.
 //=============================================================================
@@ -254,15 +296,15 @@ void ClosesthitShader(inout RayPayload payload, in MyAttributes attr)
 
 	// Calculate uv.
 	const uint3 ii = Load3x16BitIndices(info.IndicesOffset + PrimitiveIndex() * 3 * 2);
-	const float2 uv0 = asfloat(g_Attributes.Load2(info.UvAttributeOffset + ii.x * info.UvStride));
-	const float2 uv1 = asfloat(g_Attributes.Load2(info.UvAttributeOffset + ii.y * info.UvStride));
-	const float2 uv2 = asfloat(g_Attributes.Load2(info.UvAttributeOffset + ii.z * info.UvStride));
+	const float2 uv0 = LoadUv(info, ii.x);
+	const float2 uv1 = LoadUv(info, ii.y);
+	const float2 uv2 = LoadUv(info, ii.z);
 	float2 uv = bary.x * uv0 + bary.y * uv1 + bary.z * uv2;
 
 	// Calculate normal.
-	const float3 normal0 = asfloat(g_Attributes.Load3(info.NormalAttributeOffset + ii.x * info.NormalStride));
-	const float3 normal1 = asfloat(g_Attributes.Load3(info.NormalAttributeOffset + ii.y * info.NormalStride));
-	const float3 normal2 = asfloat(g_Attributes.Load3(info.NormalAttributeOffset + ii.z * info.NormalStride));
+	const float3 normal0 = LoadNormal(info, ii.x);
+	const float3 normal1 = LoadNormal(info, ii.y);
+	const float3 normal2 = LoadNormal(info, ii.z);
 
 	// Blender export uses +z as up.
 	const float3 correctnormal0 = float3(normal0.x, -normal0.z, normal0.y);
@@ -272,9 +314,9 @@ void ClosesthitShader(inout RayPayload payload, in MyAttributes attr)
 	float3 wsNormal = normalize(correctnormal0 * bary.x + correctnormal1 * bary.y + correctnormal2 * bary.z);
 
 	// Calculate tangent.
-	const float4 tangent0 = asfloat(g_Attributes.Load4(info.TangentAttributeOffset + ii.x * info.TangentStride));
-	const float4 tangent1 = asfloat(g_Attributes.Load4(info.TangentAttributeOffset + ii.y * info.TangentStride));
-	const float4 tangent2 = asfloat(g_Attributes.Load4(info.TangentAttributeOffset + ii.z * info.TangentStride));
+	const float4 tangent0 = LoadTangent(info, ii.x);
+	const float4 tangent1 = LoadTangent(info, ii.y);
+	const float4 tangent2 = LoadTangent(info, ii.z);
 
 	const float4 correcttangent0 = float4(tangent0.x, -tangent0.z, tangent0.y, tangent0.w);
 	const float4 correcttangent1 = float4(tangent1.x, -tangent1.z, tangent1.y, tangent1.w);
@@ -4,6 +4,7 @@
 #include "commandqueue.h"
 #include "window.h"
 #include "camera.h"
+#include "lod_selector.h"
 #include "helpers.h"
 #include "root_parameters.h"
 
@@ -140,7 +141,8 @@ bool ReflectionsDemo::LoadContent()
 	auto command_queue	= NeelEngine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
 	auto command_list	= command_queue->GetCommandList();
 
-	// Load scene from gltf file.
+	// Load scene from gltf file. Vertices are quantized to 20 bytes, the pipelines and acceleration structures below use the matching formats.
+	scene_.SetQuantizeVertices(true);
 	scene_.LoadFromFile("Assets/Sponza/Sponza.gltf", *command_list, false);
 
 	int width	= NeelEngine::Get().GetWindow()->GetClientWidth();
@@ -347,6 +349,7 @@ bool ReflectionsDemo::LoadContent()
 		CD3DX12_ROOT_PARAMETER1 root_parameters[GeometryPassRootSignatureParams::NumRootParameters];
 		root_parameters[GeometryPassRootSignatureParams::MaterialConstantBuffer].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL);
 		root_parameters[GeometryPassRootSignatureParams::MeshConstantBuffer].InitAsConstantBufferView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_ALL);
+		root_parameters[GeometryPassRootSignatureParams::Instances].InitAsShaderResourceView(0, 1, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
 		root_parameters[GeometryPassRootSignatureParams::Textures].InitAsDescriptorTable(1, &descriptor_range, D3D12_SHADER_VISIBILITY_PIXEL);
 		root_parameters[GeometryPassRootSignatureParams::Materials].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL);
 
@@ -508,13 +511,15 @@ bool ReflectionsDemo::LoadContent()
 			CD3DX12_PIPELINE_STATE_STREAM_RENDER_TARGET_FORMATS RTVFormats;
 		} geometry_pipeline_state_stream;
 
-		// Create input layout.
+		// Create input layout. Quantized vertices are decoded in the vertex shader.
+		const bool quantized = scene_.GetQuantizeVertices();
+
 		std::vector<D3D12_INPUT_ELEMENT_DESC> input_layout =
 		{
-			{	"POSITION",		0, DXGI_FORMAT_R32G32B32_FLOAT,		Mesh::vertex_slot_,		0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-			{	"NORMAL",		0, DXGI_FORMAT_R32G32B32_FLOAT,		Mesh::normal_slot_,		0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-			{	"TANGENT",		0, DXGI_FORMAT_R32G32B32A32_FLOAT,	Mesh::tangent_slot_,	0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-			{	"TEXCOORD",		0, DXGI_FORMAT_R32G32_FLOAT,		Mesh::texcoord0_slot_,	0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+			{	"POSITION",		0, quantized ? DXGI_FORMAT_R16G16B16A16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT,	Mesh::vertex_slot_,		0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+			{	"NORMAL",		0, quantized ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT,			Mesh::normal_slot_,		0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+			{	"TANGENT",		0, quantized ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32A32_FLOAT,		Mesh::tangent_slot_,	0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+			{	"TEXCOORD",		0, quantized ? DXGI_FORMAT_R16G16_FLOAT : DXGI_FORMAT_R32G32_FLOAT,				Mesh::texcoord0_slot_,	0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
 		};
 
 		// Load shaders.
@@ -671,39 +676,38 @@ bool ReflectionsDemo::LoadContent()
 
 	// Create Acceleration Structures.
 	{
-		std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometry_descs(scene_.GetTotalMeshes());
+		geometry_descs_.assign(scene_.GetTotalMeshes(), {});
+		first_geometry_descs_.clear();
+
+		// All submeshes are regions of the scene's geometry pool.
+		const GeometryPool& geometry_pool = scene_.GetGeometryPool();
 
-		// Variables to be used later.
-		size_t total_geometry_vertex_buffer_size = 0;
-		size_t total_geometry_index_buffer_size = 0;
+		// Transition buffers to D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE for building acceleration structures.
+		command_list->TransitionBarrier(geometry_pool.GetIndexBuffer(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		command_list->TransitionBarrier(geometry_pool.GetVertexBuffer(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 		
 		int index = 0;
 		for (auto& geometry : scene_.GetMeshes())
 		{
-			// Upload geometry base transform.
+			first_geometry_descs_.push_back(index);
+
+			// Upload geometry base transform, quantized positions are dequantized by the same transform.
 			XMFLOAT3X4 transform = {};
-			XMStoreFloat3x4(&transform, geometry.GetBaseTransform());
+			XMStoreFloat3x4(&transform, geometry.GetDequantizeTransform() * geometry.GetBaseTransform());
 			auto gpu_address = command_list->AllocateUploadBuffer(transform);
 
 			for (auto& submesh : geometry.GetSubMeshes())
 			{
-				// Transition buffers to D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE for building acceleration structures.
-				command_list->TransitionBarrier(submesh.IBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				command_list->TransitionBarrier(submesh.VBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-				geometry_descs[index].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-				geometry_descs[index].Triangles.IndexBuffer = submesh.IBuffer.GetIndexBufferView().BufferLocation;
-				geometry_descs[index].Triangles.IndexCount = submesh.IBuffer.GetNumIndicies();
-				geometry_descs[index].Triangles.IndexFormat = submesh.IBuffer.GetIndexBufferView().Format;
-				geometry_descs[index].Triangles.Transform3x4 = gpu_address;
-				geometry_descs[index].Triangles.VertexCount = submesh.VBuffer.GetNumVertices();
-				geometry_descs[index].Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-				geometry_descs[index].Triangles.VertexBuffer.StartAddress = submesh.VBuffer.GetVertexBufferViews()[0].BufferLocation;
-				geometry_descs[index].Triangles.VertexBuffer.StrideInBytes = submesh.VBuffer.GetVertexBufferViews()[0].StrideInBytes;
-				geometry_descs[index].Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-
-				total_geometry_vertex_buffer_size += submesh.VBuffer.GetD3D12Resource()->GetDesc().Width;
-				total_geometry_index_buffer_size += submesh.IBuffer.GetD3D12Resource()->GetDesc().Width;
+				geometry_descs_[index].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+				geometry_descs_[index].Triangles.IndexBuffer = submesh.IBuffer.GetIndexBufferView().BufferLocation;
+				geometry_descs_[index].Triangles.IndexCount = submesh.IndexCount;	// Full resolution level, coarser levels follow it in the index buffer.
+				geometry_descs_[index].Triangles.IndexFormat = submesh.IBuffer.GetIndexBufferView().Format;
+				geometry_descs_[index].Triangles.Transform3x4 = gpu_address;
+				geometry_descs_[index].Triangles.VertexCount = submesh.VBuffer.GetNumVertices();
+				geometry_descs_[index].Triangles.VertexFormat = scene_.GetQuantizeVertices() ? DXGI_FORMAT_R16G16B16A16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT;	// The w component is ignored.
+				geometry_descs_[index].Triangles.VertexBuffer.StartAddress = submesh.VBuffer.GetVertexBufferViews()[0].BufferLocation;
+				geometry_descs_[index].Triangles.VertexBuffer.StrideInBytes = submesh.VBuffer.GetVertexBufferViews()[0].StrideInBytes;
+				geometry_descs_[index].Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
 				
 				index++;
 			}
@@ -713,9 +717,27 @@ bool ReflectionsDemo::LoadContent()
 
 		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS build_flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
 
+		// The bottom level is refit to the pose of the first skinned instance of every skinned mesh.
+		skinned_geometries_.clear();
+		for (const auto& instance : scene_.GetInstances())
+		{
+			const bool mesh_taken = std::any_of(skinned_geometries_.begin(), skinned_geometries_.end(), [&instance](const std::pair<int32_t, uint32_t>& skinned)
+			{
+				return skinned.first == instance.MeshIndex;
+			});
+
+			if (instance.SkinnedIndex >= 0 && !mesh_taken)
+			{
+				skinned_geometries_.emplace_back(instance.MeshIndex, static_cast<uint32_t>(instance.SkinnedIndex));
+			}
+		}
+
+		const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS bottom_level_build_flags = skinned_geometries_.empty() ? build_flags :
+			build_flags | D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+
 		// Top level 
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC top_level_build_desc = {};
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& top_level_inputs = top_level_build_desc.Inputs;
+		top_level_build_desc_ = {};
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& top_level_inputs = top_level_build_desc_.Inputs;
 		top_level_inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 		top_level_inputs.Flags = build_flags;
 		top_level_inputs.NumDescs = 1;
@@ -723,12 +745,12 @@ bool ReflectionsDemo::LoadContent()
 		top_level_inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 
 		// Bottom level
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC bottom_level_build_desc = {};
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& bottom_level_inputs = bottom_level_build_desc.Inputs;
+		bottom_level_build_desc_ = {};
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& bottom_level_inputs = bottom_level_build_desc_.Inputs;
 		bottom_level_inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-		bottom_level_inputs.Flags = build_flags;
+		bottom_level_inputs.Flags = bottom_level_build_flags;
 		bottom_level_inputs.NumDescs = scene_.GetTotalMeshes();
-		bottom_level_inputs.pGeometryDescs = geometry_descs.data();
+		bottom_level_inputs.pGeometryDescs = geometry_descs_.data();
 		bottom_level_inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
 
 		// Allocate space on GPU to build acceleration structures
@@ -744,80 +766,60 @@ bool ReflectionsDemo::LoadContent()
 		auto gpu_adress = command_list->AllocateUploadBuffer(instance_desc);
 
 		{
-			bottom_level_build_desc.ScratchAccelerationStructureData = bottom_level_acceleration_structure_.GetScratchResource()->GetGPUVirtualAddress();
-			bottom_level_build_desc.DestAccelerationStructureData = bottom_level_acceleration_structure_.GetD3D12Resource()->GetGPUVirtualAddress();
+			bottom_level_build_desc_.ScratchAccelerationStructureData = bottom_level_acceleration_structure_.GetScratchResource()->GetGPUVirtualAddress();
+			bottom_level_build_desc_.DestAccelerationStructureData = bottom_level_acceleration_structure_.GetD3D12Resource()->GetGPUVirtualAddress();
 		}
 
 		{
-			top_level_build_desc.ScratchAccelerationStructureData = top_level_acceleration_structure_.GetScratchResource()->GetGPUVirtualAddress();
-			top_level_build_desc.DestAccelerationStructureData = top_level_acceleration_structure_.GetD3D12Resource()->GetGPUVirtualAddress();
-			top_level_build_desc.Inputs.InstanceDescs = gpu_adress;
+			top_level_build_desc_.ScratchAccelerationStructureData = top_level_acceleration_structure_.GetScratchResource()->GetGPUVirtualAddress();
+			top_level_build_desc_.DestAccelerationStructureData = top_level_acceleration_structure_.GetD3D12Resource()->GetGPUVirtualAddress();
+			top_level_build_desc_.Inputs.InstanceDescs = gpu_adress;
 		}
 
 		// Build ray tracing acceleration structures.
-		command_list->GetGraphicsCommandList()->BuildRaytracingAccelerationStructure(&bottom_level_build_desc, 0, nullptr);
+		command_list->GetGraphicsCommandList()->BuildRaytracingAccelerationStructure(&bottom_level_build_desc_, 0, nullptr);
 		command_list->UAVBarrier(bottom_level_acceleration_structure_, true);
-		command_list->GetGraphicsCommandList()->BuildRaytracingAccelerationStructure(&top_level_build_desc, 0, nullptr);
+		command_list->GetGraphicsCommandList()->BuildRaytracingAccelerationStructure(&top_level_build_desc_, 0, nullptr);
 
 
 		// Generate mesh shader data for raytracing.
+		// The closest hit shader reads the attributes and indices straight from the geometry pool.
+		for (auto& geometry : scene_.GetMeshes())
 		{
-			auto vertex_buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(total_geometry_vertex_buffer_size);
-			auto index_buffer_desc = CD3DX12_RESOURCE_DESC::Buffer(total_geometry_index_buffer_size);
-			
-			global_vertices_ = ByteAddressBuffer(vertex_buffer_desc, total_geometry_vertex_buffer_size, "Global Vertex Buffer Byte Address Buffer");
-			global_indices_ = ByteAddressBuffer(index_buffer_desc, total_geometry_index_buffer_size, "Global Index Buffer Byte Address Buffer");
-
-			UINT64 vertex_offset = 0;
-			UINT64 index_offset = 0;
-			
-			UINT attribute_offset = 0;
-			
-			for (auto& geometry : scene_.GetMeshes())
+			for (auto& submesh : geometry.GetSubMeshes())
 			{
-				for (auto& submesh : geometry.GetSubMeshes())
+				const uint32_t geometry_index = submesh.GeometryIndex;
+
+				// The closest hit shader only loads 16-bit indices, the mesh optimizer splits submeshes so they fit.
+				if (submesh.IBuffer.GetIndexBufferView().Format != DXGI_FORMAT_R16_UINT)
 				{
-					MeshInfo info;
-					info.IndicesOffset = index_offset;	// Start address of current mesh's index buffer in contiguous index buffer.
-					
-					info.PositionAttributeOffset = attribute_offset;
-					info.PositionStride = submesh.VBuffer.GetVertexBufferViews()[0].StrideInBytes;
-					attribute_offset += submesh.VBuffer.GetVertexBufferViews()[0].SizeInBytes; // Position attribute offset to normal.
-					
-					info.NormalAttributeOffset = attribute_offset;
-					info.NormalStride = submesh.VBuffer.GetVertexBufferViews()[1].StrideInBytes;
-					attribute_offset += submesh.VBuffer.GetVertexBufferViews()[1].SizeInBytes; // Normal attribute offset to tangent or uv.
-					
-					if(submesh.HasTangents)
-					{
-						info.HasTangents = true;
-						info.TangentAttributeOffset = attribute_offset;
-						info.TangentStride = submesh.VBuffer.GetVertexBufferViews()[2].StrideInBytes;
-						attribute_offset += submesh.VBuffer.GetVertexBufferViews()[2].SizeInBytes; // Tangent attribute offset to uv.
-					}
-					else
-					{
-						info.HasTangents = false;
-						info.TangentAttributeOffset = attribute_offset;
-					}
-
-					info.UvAttributeOffset = attribute_offset;
-					info.UvStride = submesh.VBuffer.GetVertexBufferViews()[3].StrideInBytes;
-					attribute_offset += submesh.VBuffer.GetVertexBufferViews()[3].SizeInBytes; // UV attribute offset to end of buffer / begin next buffer.
-
-					info.MaterialId = submesh.MaterialCB.MaterialIndex;
-									
-					mesh_infos_.emplace_back(info);
-
-					// Copy sumesh's buffers to the global contiguous buffers used for raytracing.
-					command_list->CopyBufferRegion(global_vertices_, vertex_offset, submesh.VBuffer, 0, submesh.VBuffer.GetD3D12Resource()->GetDesc().Width);
-					command_list->CopyBufferRegion(global_indices_, index_offset, submesh.IBuffer, 0, submesh.IBuffer.GetD3D12Resource()->GetDesc().Width);
-					
-					vertex_offset += submesh.VBuffer.GetD3D12Resource()->GetDesc().Width;
-					index_offset += submesh.IBuffer.GetD3D12Resource()->GetDesc().Width;
+					throw std::exception("Ray traced submeshes need 16-bit indices.");
 				}
+
+				MeshInfo info;
+				info.IndicesOffset = static_cast<UINT>(geometry_pool.GetIndexOffset(geometry_index));	// Start address of current mesh's indices in the pool's index buffer.
+				
+				info.PositionAttributeOffset = static_cast<UINT>(geometry_pool.GetStreamOffset(geometry_index, Mesh::vertex_slot_));
+				info.PositionStride = submesh.VBuffer.GetVertexBufferViews()[Mesh::vertex_slot_].StrideInBytes;
+				
+				info.NormalAttributeOffset = static_cast<UINT>(geometry_pool.GetStreamOffset(geometry_index, Mesh::normal_slot_));
+				info.NormalStride = submesh.VBuffer.GetVertexBufferViews()[Mesh::normal_slot_].StrideInBytes;
+
+				// Without tangents the tangent stream is empty and its offset equals the uv offset.
+				info.HasTangents = submesh.HasTangents;
+				info.TangentAttributeOffset = static_cast<UINT>(geometry_pool.GetStreamOffset(geometry_index, Mesh::tangent_slot_));
+				info.TangentStride = submesh.HasTangents ? submesh.VBuffer.GetVertexBufferViews()[Mesh::tangent_slot_].StrideInBytes : 0;
+
+				info.UvAttributeOffset = static_cast<UINT>(geometry_pool.GetStreamOffset(geometry_index, Mesh::texcoord0_slot_));
+				info.UvStride = submesh.VBuffer.GetVertexBufferViews()[Mesh::texcoord0_slot_].StrideInBytes;
+
+				info.MaterialId = submesh.MaterialCB.MaterialIndex;
+
+				info.QuantizedVertices = scene_.GetQuantizeVertices() ? 1 : 0;
+								
+				mesh_infos_.emplace_back(info);
 			}
-		}	
+		}
 	}
 	
 	// Create raytracing Shader Tables.
@@ -920,6 +922,11 @@ void ReflectionsDemo::OnUpdate(UpdateEventArgs& e)
 		total_time = 0.0;
 	}
 
+	// Play the scene animations, then apply changes to node transforms before the instances are drawn.
+	scene_.Animate(static_cast<float>(e.TotalTime));
+	scene_.UpdateTransforms();
+	scene_.UpdateSkinning();
+
 	Camera& camera = Camera::Get();
 	XMMATRIX view_matrix = camera.GetViewMatrix();
 
@@ -1080,6 +1087,48 @@ void ReflectionsDemo::OnGui()
 	}
 }
 
+void ReflectionsDemo::UpdateSkinnedAccelerationStructures(CommandList& command_list)
+{
+	const Skinning& skinning = scene_.GetSkinning();
+
+	// Skinned streams are in the mesh's vertex format, so only the vertex buffers and transforms of the geometries change.
+	for (const auto& skinned : skinned_geometries_)
+	{
+		const uint32_t skinned_instance = skinned.second;
+
+		XMFLOAT3X4 transform = {};
+		XMStoreFloat3x4(&transform, skinning.GetDequantizeTransform(skinned_instance) * scene_.GetTransforms().GetWorldMatrix(skinning.GetNode(skinned_instance)));
+		auto gpu_address = command_list.AllocateUploadBuffer(transform);
+
+		for (size_t i = 0; i < skinning.GetNumSubMeshes(skinned_instance); i++)
+		{
+			D3D12_RAYTRACING_GEOMETRY_DESC& geometry_desc = geometry_descs_[first_geometry_descs_[skinned.first] + i];
+			geometry_desc.Triangles.Transform3x4 = gpu_address;
+			geometry_desc.Triangles.VertexBuffer.StartAddress = skinning.GetPositionView(skinned_instance, i).BufferLocation;
+			geometry_desc.Triangles.VertexBuffer.StrideInBytes = skinning.GetPositionView(skinned_instance, i).StrideInBytes;
+		}
+	}
+
+	// The refit reads the skinned positions of this frame, Skinning::Upload left their buffer in the copy destination state.
+	command_list.TransitionBarrier(skinning.GetVertexBuffer(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, true);
+
+	// Refit in place, the topology is the one of the initial build.
+	bottom_level_build_desc_.Inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+	bottom_level_build_desc_.SourceAccelerationStructureData = bottom_level_build_desc_.DestAccelerationStructureData;
+
+	// The instance desc of the initial build lived in that frame's upload heap.
+	D3D12_RAYTRACING_INSTANCE_DESC instance_desc = {};
+	instance_desc.Transform[0][0] = instance_desc.Transform[1][1] = instance_desc.Transform[2][2] = 1;
+	instance_desc.InstanceMask = 1;
+	instance_desc.AccelerationStructure = bottom_level_acceleration_structure_.GetD3D12Resource()->GetGPUVirtualAddress();
+	top_level_build_desc_.Inputs.InstanceDescs = command_list.AllocateUploadBuffer(instance_desc);
+
+	command_list.GetGraphicsCommandList()->BuildRaytracingAccelerationStructure(&bottom_level_build_desc_, 0, nullptr);
+	command_list.UAVBarrier(bottom_level_acceleration_structure_, true);
+	command_list.GetGraphicsCommandList()->BuildRaytracingAccelerationStructure(&top_level_build_desc_, 0, nullptr);
+	command_list.UAVBarrier(top_level_acceleration_structure_, true);
+}
+
 void ReflectionsDemo::OnRender(RenderEventArgs& e)
 {
 	Game::OnRender(e);
@@ -1087,6 +1136,14 @@ void ReflectionsDemo::OnRender(RenderEventArgs& e)
 	auto command_queue = NeelEngine::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
 	auto command_list = command_queue->GetCommandList();
 
+	// Skinned positions and normals of this frame, for the geometry pass and the acceleration structures.
+	scene_.GetSkinning().Upload(*command_list);
+
+	if (!skinned_geometries_.empty())
+	{
+		UpdateSkinnedAccelerationStructures(*command_list);
+	}
+
 	// Geometry render pass.
 	{	
 		command_list->BeginRenderPass(geometry_pass_render_target_);
@@ -1104,12 +1161,109 @@ void ReflectionsDemo::OnRender(RenderEventArgs& e)
 			command_list->SetShaderResourceView(GeometryPassRootSignatureParams::Textures, i, scene_.GetTextures()[i], D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 		}
 
-		// Loop over all instances of meshes in the scene and render.
+		// Levels of detail are picked per instance by their projected error at the geometry pass resolution.
+		const LodSelector lod_selector(Camera::Get(), geometry_pass_render_target_.GetViewport().Height);
+		const XMVECTOR eye = Camera::Get().GetTranslation();
+
+		// Rigid instances are grouped by mesh, submesh and level of detail into instanced draws.
+		// Every draw gets the box of its submesh in the culler, in the same order, so the visibility of a box is the one of its draw.
+		const XMMATRIX view = Camera::Get().GetViewMatrix();
+		frustum_culler_.SetFrustum(view * Camera::Get().GetProjectionMatrix());
+		frustum_culler_.Clear();
+		instance_batcher_.Clear();
+
 		for (auto& instance : scene_.GetInstances())
 		{
+			if (instance.SkinnedIndex >= 0)
+				continue;
+
 			Mesh& mesh = scene_.GetMeshes()[instance.MeshIndex];
-			mesh.SetBaseTransform(instance.Transform);
-			mesh.Render(*command_list);
+			mesh.SetBaseTransform(scene_.GetTransforms().GetWorldMatrix(instance.NodeIndex));
+
+			const XMMATRIX model_matrix = mesh.GetModelMatrix();
+			const float max_error = lod_selector.GetMaxError(mesh, eye, Camera::Get().GetNearClip());
+			const uint32_t transform = instance_batcher_.AddTransform(model_matrix);
+
+			const auto& sub_meshes = mesh.GetSubMeshes();
+			for (size_t i = 0; i < sub_meshes.size(); i++)
+			{
+				const size_t lod = Mesh::SelectLodIndex(sub_meshes[i].Lods, max_error);
+				instance_batcher_.AddDraw(static_cast<uint32_t>(instance.MeshIndex), static_cast<uint32_t>(i), static_cast<uint32_t>(lod), transform);
+				frustum_culler_.AddBounds(model_matrix, sub_meshes[i].Bounds);
+			}
+		}
+
+		const uint32_t first_skinned_box = static_cast<uint32_t>(frustum_culler_.GetNumBoxes());
+
+		// Skinned instances are culled by the box around the bounding sphere of their pose.
+		for (auto& instance : scene_.GetInstances())
+		{
+			if (instance.SkinnedIndex < 0)
+				continue;
+
+			const XMFLOAT4& sphere = scene_.GetSkinning().GetBoundingSphere(static_cast<uint32_t>(instance.SkinnedIndex));
+
+			Mesh::BoundingVolume bounds;
+			bounds.Center	= XMFLOAT3(sphere.x, sphere.y, sphere.z);
+			bounds.Extents	= XMFLOAT3(sphere.w, sphere.w, sphere.w);
+			bounds.Radius	= sphere.w;
+
+			frustum_culler_.AddBounds(scene_.GetTransforms().GetWorldMatrix(instance.NodeIndex), bounds);
+		}
+
+		frustum_culler_.Cull(scene_.GetUpdateThreadPool());
+
+		instance_batcher_.Build(&frustum_culler_.GetVisibility());
+
+		const auto& batches = instance_batcher_.GetBatches();
+		const auto& instance_data = instance_batcher_.GetInstanceData();
+
+		// Batches of a material are drawn together, front to back by their nearest instance. The geometry pass has a single pipeline.
+		render_queue_.Clear();
+
+		for (size_t i = 0; i < batches.size(); i++)
+		{
+			const InstanceBatcher::Batch& batch = batches[i];
+
+			float depth = FLT_MAX;
+			for (uint32_t j = batch.FirstInstance; j < batch.FirstInstance + batch.NumInstances; j++)
+			{
+				depth = std::min(depth, XMVectorGetZ(XMVector3TransformCoord(instance_data[j].ModelMatrix.r[3], view)));
+			}
+
+			const auto& sub_mesh = scene_.GetMeshes()[batch.Mesh].GetSubMeshes()[batch.SubMesh];
+			const uint32_t material = static_cast<uint32_t>(std::max(sub_mesh.MaterialCB.MaterialIndex, 0));
+			const uint32_t depth_bucket = RenderQueue::QuantizeDepth(depth, Camera::Get().GetNearClip(), Camera::Get().GetFarClip());
+
+			render_queue_.Add(RenderQueue::MakeKey(0, 0, material, depth_bucket), static_cast<uint32_t>(i));
+		}
+
+		render_queue_.Sort();
+
+		if (!batches.empty())
+		{
+			command_list->SetGraphicsDynamicStructuredBuffer(GeometryPassRootSignatureParams::Instances, instance_data);
+
+			for (uint32_t i : render_queue_.GetValues())
+			{
+				const InstanceBatcher::Batch& batch = batches[i];
+				scene_.GetMeshes()[batch.Mesh].RenderInstances(*command_list, batch.SubMesh, batch.Lod, batch.FirstInstance, batch.NumInstances);
+			}
+		}
+
+		// Skinned instances have vertex streams of their own and are drawn one by one.
+		uint32_t skinned_box = first_skinned_box;
+
+		for (auto& instance : scene_.GetInstances())
+		{
+			if (instance.SkinnedIndex < 0 || !frustum_culler_.IsVisible(skinned_box++))
+				continue;
+
+			Mesh& mesh = scene_.GetMeshes()[instance.MeshIndex];
+			mesh.SetBaseTransform(scene_.GetTransforms().GetWorldMatrix(instance.NodeIndex));
+
+			const float max_error = lod_selector.GetMaxError(mesh, eye, Camera::Get().GetNearClip());
+			mesh.Render(*command_list, scene_.GetSkinning(), static_cast<uint32_t>(instance.SkinnedIndex), max_error);
 		}
 		command_list->EndRenderPass();
 	}
@@ -1152,8 +1306,13 @@ void ReflectionsDemo::OnRender(RenderEventArgs& e)
 		command_list->SetComputeDynamicStructuredBuffer(RtGlobalRootSignatureParams::Materials, scene_.GetMaterialData());
 		command_list->SetComputeDynamicStructuredBuffer(RtGlobalRootSignatureParams::MeshInfo, mesh_infos_);
 
-		command_list->SetComputeByteAddressBuffer(RtGlobalRootSignatureParams::Attributes, global_vertices_.GetD3D12Resource()->GetGPUVirtualAddress());
-		command_list->SetComputeByteAddressBuffer(RtGlobalRootSignatureParams::Indices, global_indices_.GetD3D12Resource()->GetGPUVirtualAddress());
+		// The geometry pool is also bound as vertex and index buffer by the geometry pass.
+		const GeometryPool& geometry_pool = scene_.GetGeometryPool();
+		command_list->TransitionBarrier(geometry_pool.GetVertexBuffer(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		command_list->TransitionBarrier(geometry_pool.GetIndexBuffer(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+		command_list->SetComputeByteAddressBuffer(RtGlobalRootSignatureParams::Attributes, geometry_pool.GetVertexBuffer().GetD3D12Resource()->GetGPUVirtualAddress());
+		command_list->SetComputeByteAddressBuffer(RtGlobalRootSignatureParams::Indices, geometry_pool.GetIndexBuffer().GetD3D12Resource()->GetGPUVirtualAddress());
 
 		command_list->SetShaderResourceView(RtGlobalRootSignatureParams::GBuffer, 0, geometry_pass_render_target_.GetTexture(AttachmentPoint::kColor0));	// Bind albedo.
 		command_list->SetShaderResourceView(RtGlobalRootSignatureParams::GBuffer, 1, geometry_pass_render_target_.GetTexture(AttachmentPoint::kColor1));	// Bind normal.